@@ -27,15 +27,125 @@
 #include "CL_layout_classes.h"
 #include "NL_genericinput.h"
 #include "NL_population.h"
+#include "SC_settings.h"
+#include "SC_projectobject.h"
+#include "SC_utilities.h"
+#include <QCryptographicHash>
+#include <limits>
+
+namespace {
+
+    /*
+     * The units and prefixes dim knows, in the order they are matched. The
+     * names are made once and shared, and the strings parsed by fromString
+     * are kept in a table shared by every component, so neither loading nor
+     * drawing a property parses or builds a unit string more than once.
+     */
+    struct unitInfo {
+        const char * name;
+        Unit unit;
+        int m, l, t, I, Cd, mol, temp;
+    };
+
+    const unitInfo units[] = {
+        { "V",    UNIT_V,     1,  2, -3, -1, 0, 0, 0 },
+        { "Ohm",  UNIT_Ohm,   1,  2, -3, -2, 0, 0, 0 },
+        { "g",    UNIT_g,     1,  0,  0,  0, 0, 0, 0 },
+        { "m",    UNIT_m,     0,  1,  0,  0, 0, 0, 0 },
+        { "s",    UNIT_s,     0,  0,  1,  0, 0, 0, 0 },
+        { "A",    UNIT_A,     0,  0,  0,  1, 0, 0, 0 },
+        { "cd",   UNIT_cd,    0,  0,  0,  0, 1, 0, 0 },
+        { "mol",  UNIT_mol,   0,  0,  0,  0, 0, 1, 0 },
+        { "degC", UNIT_degC,  0,  0,  0,  0, 0, 0, 1 },
+        { "S",    UNIT_S,    -1, -2,  3,  2, 0, 0, 0 },
+        { "F",    UNIT_F,    -1, -2,  4,  2, 0, 0, 0 },
+        { "Hz",   UNIT_Hz,    0,  0, -1,  0, 0, 0, 0 }
+    };
+    const int numUnits = sizeof(units) / sizeof(units[0]);
+
+    struct prefixInfo {
+        const char * name;
+        Prefix prefix;
+        int scale;
+    };
+
+    const prefixInfo prefixes[] = {
+        { "G", PREFIX_G,   9 },
+        { "M", PREFIX_M,   6 },
+        { "k", PREFIX_k,   3 },
+        { "c", PREFIX_c,   2 },
+        { "m", PREFIX_m,  -3 },
+        { "u", PREFIX_u,  -6 },
+        { "n", PREFIX_n,  -9 },
+        { "p", PREFIX_p, -12 },
+        { "f", PREFIX_f, -15 }
+    };
+    const int numPrefixes = sizeof(prefixes) / sizeof(prefixes[0]);
+
+    // numUnits for a dimension with no name ("?")
+    int unitIndex(const dim * d)
+    {
+        for (int i = 0; i < numUnits; ++i) {
+            const unitInfo &u = units[i];
+            if (d->m == u.m && d->l == u.l && d->t == u.t && d->I == u.I
+                && d->Cd == u.Cd && d->mol == u.mol && d->temp == u.temp) {
+                return i;
+            }
+        }
+        return numUnits;
+    }
+
+    // numPrefixes for no prefix
+    int prefixIndex(int scale)
+    {
+        for (int i = 0; i < numPrefixes; ++i) {
+            if (prefixes[i].scale == scale) {
+                return i;
+            }
+        }
+        return numPrefixes;
+    }
+
+    // every prefix and unit pair, the prefix index major
+    QVector <QString> makeUnitNames()
+    {
+        QVector <QString> names;
+        for (int p = 0; p <= numPrefixes; ++p) {
+            QString prefix = p < numPrefixes ? QString(prefixes[p].name) : QString();
+            for (int u = 0; u <= numUnits; ++u) {
+                names.push_back(prefix + (u < numUnits ? QString(units[u].name) : QString("?")));
+            }
+        }
+        return names;
+    }
+
+    const QVector <QString> &unitNames()
+    {
+        static const QVector <QString> names = makeUnitNames();
+        return names;
+    }
+
+    const QString &unitName(int prefix, int unit)
+    {
+        return unitNames()[prefix * (numUnits + 1) + unit];
+    }
+
+    // what parsing a string sets: a string may give a prefix, a unit, both or neither
+    struct parsedDim {
+        bool hasScale;
+        int scale;
+        bool hasUnit;
+        int m, l, t, I, Cd, mol, temp;
+    };
+
+    QMutex parsedDimsLock;
+    QHash <QString, parsedDim> parsedDims;
+
+} // namespace
 
 QString dim::toString()
 {
-    QString unit;
-    QString prefix;
-    unit = getUnitString();
-    prefix = getPrefixString();
-    unit = prefix + unit;
-    return unit;
+    return unitName(prefixIndex(scale), unitIndex(this));
 }
 
 void dim::fromString(QString in)
@@ -44,6 +154,42 @@ void dim::fromString(QString in)
         return;
     }
 
+    parsedDim parsed;
+    {
+        QMutexLocker locker(&parsedDimsLock);
+        QHash <QString, parsedDim>::const_iterator found = parsedDims.constFind(in);
+        if (found != parsedDims.constEnd()) {
+            parsed = found.value();
+        } else {
+            // parse into a dim marked so we can see what the string set
+            dim probe("");
+            probe.scale = std::numeric_limits<int>::min();
+            probe.m = std::numeric_limits<int>::min();
+            probe.parseString(in);
+            parsed.hasScale = probe.scale != std::numeric_limits<int>::min();
+            parsed.scale = probe.scale;
+            parsed.hasUnit = probe.m != std::numeric_limits<int>::min();
+            parsed.m = probe.m; parsed.l = probe.l; parsed.t = probe.t; parsed.I = probe.I;
+            parsed.Cd = probe.Cd; parsed.mol = probe.mol; parsed.temp = probe.temp;
+            parsedDims.insert(in, parsed);
+        }
+    }
+
+    if (parsed.hasScale) {
+        scale = parsed.scale;
+    }
+    if (parsed.hasUnit) {
+        m = parsed.m; l = parsed.l; t = parsed.t; I = parsed.I;
+        Cd = parsed.Cd; mol = parsed.mol; temp = parsed.temp;
+    }
+}
+
+void dim::parseString(QString in)
+{
+    if (in.size() == 0) {
+        return;
+    }
+
     if (in.size() > 1 && in.startsWith("G")) {
         scale = 9; in.remove(0,1);
     }
@@ -117,180 +263,52 @@ void dim::setPrefix(QString p)
 {
     if (p == "") {
         scale = 0;
-    } else if (p == "G") {
-        scale = 9;
-    } else if (p == "M") {
-        scale = 6;
-    } else if (p == "k") {
-        scale = 3;
-    } else if (p == "c") {
-        scale = 2;
-    } else if (p == "m") {
-        scale = -3;
-    } else if (p == "u") {
-        scale = -6;
-    } else if (p == "n") {
-        scale = -9;
-    } else if (p == "p") {
-        scale = -12;
-    } else if (p == "f") {
-        scale = -15;
+        return;
+    }
+    for (int i = 0; i < numPrefixes; ++i) {
+        if (p == QLatin1String(prefixes[i].name)) {
+            scale = prefixes[i].scale;
+            return;
+        }
     }
 }
 
 void dim::setUnit(QString u)
 {
-    if (u == "V") {
-        m=1; l=2; t=-3; I=-1; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "Ohm") {
-        m=1; l=2; t=-3; I=-2; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "g") {
-        m=1; l=0; t=0; I=0; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "m") {
-        m=0; l=1; t=0; I=0; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "s") {
-        m=0; l=0; t=1; I=0; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "A") {
-        m=0; l=0; t=0; I=1; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "cd") {
-        m=0; l=0; t=0; I=0; Cd = 1; mol = 0; temp = 0;
-    } else if (u == "mol") {
-        m=0; l=0; t=0; I=0; Cd = 0; mol = 1; temp = 0;
-    } else if (u == "degC") {
-        m=0; l=0; t=0; I=0; Cd = 0; mol = 0; temp = 1;
-    } else if (u == "S") {
-        m=-1; l=-2; t=3; I=2; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "F") {
-        m=-1; l=-2; t=4; I=2; Cd = 0; mol = 0; temp = 0;
-    } else if (u == "Hz") {
-        m=0; l=0; t=-1; I=0; Cd = 0; mol = 0; temp = 0;
-    } else{
-        m=0; l=0; t=0; I=0; Cd = 0; mol = 0; temp = 0;
+    for (int i = 0; i < numUnits; ++i) {
+        if (u == QLatin1String(units[i].name)) {
+            m = units[i].m; l = units[i].l; t = units[i].t; I = units[i].I;
+            Cd = units[i].Cd; mol = units[i].mol; temp = units[i].temp;
+            return;
+        }
     }
+    m=0; l=0; t=0; I=0; Cd = 0; mol = 0; temp = 0;
 }
 
 QString dim::getPrefixString()
 {
-    QString prefix;
-
-    if (scale==9) {
-        prefix = "G";
-    } else if (scale==6) {
-        prefix = "M";
-    } else if (scale==3) {
-        prefix = "k";
-    } else if (scale==2) {
-        prefix = "c";
-    } else if (scale==-3) {
-        prefix = "m";
-    } else if (scale==-6) {
-        prefix = "u";
-    } else if (scale==-9) {
-        prefix = "n";
-    } else if (scale==-12) {
-        prefix = "p";
-    } else if (scale==-15) {
-        prefix = "f";
-    } else {
-        prefix = "";
-    }
-
+    // the names with the "?" unit, less the "?"
+    QString prefix = unitName(prefixIndex(scale), numUnits);
+    prefix.chop(1);
     return prefix;
 }
 
 QString dim::getUnitString()
 {
-    QString unit;
-
-    if (m==1 && l==2 && t==-3 && I==-1 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "V";
-    } else if (m==1 && l==2 && t==-3 && I==-2 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "Ohm";
-    } else if (m==1 && l==0 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "g";
-    } else if (m==0 && l==1 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "m";
-    } else if (m==0 && l==0 && t==1 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "s";
-    } else if (m==0 && l==0 && t==0 && I==1 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "A";
-    } else if (m==0 && l==0 && t==0 && I==0 && Cd == 1 && mol == 0 && temp == 0) {
-        unit = "cd";
-    } else if (m==0 && l==0 && t==0 && I==0 && Cd == 0 && mol == 1 && temp == 0) {
-        unit = "mol";
-    } else if (m==0 && l==0 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 1) {
-        unit = "degC";
-    } else if (m==-1 && l==-2 && t==3 && I==2 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "S";
-    } else if (m==-1 && l==-2 && t==4 && I==2 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "F";
-    } else if (m==0 && l==0 && t==-1 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        unit = "Hz";
-    // default for dimensionless
-    //if (m==0 && l==0 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 0)
-    } else {
-        unit = "?";
-    }
-
-    return unit;
+    // default for dimensionless is "?"
+    return unitName(numPrefixes, unitIndex(this));
 }
 
 Prefix dim::getPrefix()
 {
-    if (scale==9) {
-        return PREFIX_G;
-    } else if (scale==6) {
-        return PREFIX_M;
-    } else if (scale==3) {
-        return PREFIX_k;
-    } else if (scale==2) {
-        return PREFIX_c;
-    } else if (scale==-3) {
-        return PREFIX_m;
-    } else if (scale==-6) {
-        return PREFIX_u;
-    } else if (scale==-9) {
-        return PREFIX_n;
-    } else if (scale==-12) {
-        return PREFIX_p;
-    } else if (scale==-15) {
-        return PREFIX_f;
-    } else {
-        return PREFIX_NONE;
-    }
+    int i = prefixIndex(scale);
+    return i < numPrefixes ? prefixes[i].prefix : PREFIX_NONE;
 }
 
 Unit dim::getUnit()
 {
-    if (m==1 && l==2 && t==-3 && I==-1 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_V;
-    } else if (m==1 && l==2 && t==-3 && I==-2 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_Ohm;
-    } else if (m==1 && l==0 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_g;
-    } else if (m==0 && l==1 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_m;
-    } else if (m==0 && l==0 && t==1 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_s;
-    } else if (m==0 && l==0 && t==0 && I==1 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_A;
-    } else if (m==0 && l==0 && t==0 && I==0 && Cd == 1 && mol == 0 && temp == 0) {
-        return UNIT_cd;
-    } else if (m==0 && l==0 && t==0 && I==0 && Cd == 0 && mol == 1 && temp == 0) {
-        return UNIT_mol;
-    } else if (m==0 && l==0 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 1) {
-        return UNIT_degC;
-    } else if (m==-1 && l==-2 && t==3 && I==2 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_S;
-    } else if (m==-1 && l==-2 && t==4 && I==2 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_F;
-    } else if (m==0 && l==0 && t==-1 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-        return UNIT_Hz;
-    // default for dimensionless
-    //if (m==0 && l==0 && t==0 && I==0 && Cd == 0 && mol == 0 && temp == 0) {
-    } else {
-        return UNIT_NONE;
-    }
+    int i = unitIndex(this);
+    return i < numUnits ? units[i].unit : UNIT_NONE;
 }
 
 void dim::reset()
@@ -497,7 +515,14 @@ void Component::load(QDomDocument *doc)
 #endif
 }
 
-void Component::write(QDomDocument *doc)
+void Component::write(QXmlStreamWriter &xmlOut)
+{
+    if (this->validateForWrite()) {
+        this->writeXML(xmlOut);
+    }
+}
+
+bool Component::validateForWrite()
 {
     // validate this (must be validated if is in memory)
     QStringList validated = validateComponent();
@@ -540,96 +565,99 @@ void Component::write(QDomDocument *doc)
 
     if (!errors.isEmpty()) {
         // display errors
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>" + this->name + ":Component validation failed</b></P>" + errors);
-        msgBox.setIcon(QMessageBox::Warning);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.setModal(false);
-        msgBox.exec();
-        return;
+        SCUtilities::showMessage("<P><b>" + this->name + ":Component validation failed</b></P>" + errors, QMessageBox::Warning, true);
+        return false;
     }
+    return true;
+}
 
+void Component::writeXML(QXmlStreamWriter &xmlOut)
+{
     // write out:
 
     // create the root of the file:
-    QDomElement root = doc->createElement ("SpineML");
-    QDomProcessingInstruction xmlDeclaration = doc->createProcessingInstruction("xml", "version=\"1.0\"");
-    doc->appendChild(xmlDeclaration);
-    doc->appendChild( root );
-    root.setAttribute("xmlns", "http://www.shef.ac.uk/SpineMLComponentLayer");
-    root.setAttribute("xmlns:xsi", "http://www.w3.org/2001/XMLSchema-instance");
-    root.setAttribute("xsi:schemaLocation", "http://www.shef.ac.uk/SpineMLComponentLayer SpineMLComponentLayer.xsd");
-    QDomElement CClass = doc->createElement ("ComponentClass");
-    CClass.setAttribute("name", this->name);
-    CClass.setAttribute("type", this->type);
+    xmlOut.writeStartDocument();
+    xmlOut.writeStartElement("SpineML");
+    xmlOut.writeAttribute("xmlns", "http://www.shef.ac.uk/SpineMLComponentLayer");
+    xmlOut.writeAttribute("xmlns:xsi", "http://www.w3.org/2001/XMLSchema-instance");
+    xmlOut.writeAttribute("xsi:schemaLocation", "http://www.shef.ac.uk/SpineMLComponentLayer SpineMLComponentLayer.xsd");
+    xmlOut.writeStartElement("ComponentClass");
+    xmlOut.writeAttribute("name", this->name);
+    xmlOut.writeAttribute("type", this->type);
     if (this->islearning) {
-        CClass.setAttribute("islearning", true);
+        xmlOut.writeAttribute("islearning", "1");
     }
-    root.appendChild(CClass);
 
     // Create component annotation element
-    QDomElement annot = doc->createElement("Annotation");
+    xmlOut.writeStartElement("Annotation");
 
-    // Add non-SpineCreator annotations
-    QDomDocument userannot("Userannotations");
-    if (userannot.setContent(this->annotation, false)) {
-        QDomElement uaroot = userannot.documentElement();
-        QDomElement n = uaroot.firstChildElement();
-        while (!n.isNull()) {
-            QDomElement nxt = n.nextSiblingElement();
-            annot.appendChild (n);
-            n = nxt;
+    // Add non-SpineCreator annotations, which are stored inside their own
+    // Annotation element
+    QXmlStreamReader userannot(this->annotation);
+    userannot.setNamespaceProcessing(false);
+    int depth = 0;
+    while (!userannot.atEnd()) {
+        userannot.readNext();
+        if (userannot.isStartElement()) {
+            ++depth;
+        }
+        if (depth > 1) {
+            xmlOut.writeCurrentToken(userannot);
+        }
+        if (userannot.isEndElement()) {
+            --depth;
         }
     }
 
     // Add SpineCreator-specific annotations
-    QDomElement spinecreator = doc->createElement("SpineCreator");
+    xmlOut.writeStartElement("SpineCreator");
     QMap<QString, QString>::const_iterator t = this->annotationTexts.constBegin();
     while (t != this->annotationTexts.constEnd()) {
-        QDomElement txte = doc->createElement("Text");
-        txte.setAttribute("key", t.key());
-        QDomText text = doc->createTextNode(t.value());
-        txte.appendChild(text);
-        spinecreator.appendChild(txte);
+        xmlOut.writeStartElement("Text");
+        xmlOut.writeAttribute("key", t.key());
+        xmlOut.writeCharacters(t.value());
+        xmlOut.writeEndElement(); // Text
         ++t;
     }
-    annot.appendChild(spinecreator);
+    xmlOut.writeEndElement(); // SpineCreator
 
-    // Append the component annotations onto the component class:
-    CClass.appendChild(annot);
+    xmlOut.writeEndElement(); // Annotation
 
-    QDomElement dynamics = doc->createElement("Dynamics");
+    xmlOut.writeStartElement("Dynamics");
     if (this->initial_regime != NULL) {
-        dynamics.setAttribute("initial_regime", this->initial_regime->name);
+        xmlOut.writeAttribute("initial_regime", this->initial_regime->name);
     } else {
-        dynamics.setAttribute("initial_regime", "Error: No initial regime!");
+        xmlOut.writeAttribute("initial_regime", "Error: No initial regime!");
     }
-    CClass.appendChild(dynamics);
+
+    // dynamics
+    for (int i = 0; i < this->RegimeList.size(); ++i) {
+        RegimeList[i]->writeOut(xmlOut);
+    }
+    for (int i = 0; i < this->AliasList.size(); ++i) {
+        AliasList[i]->writeOut(xmlOut);
+    }
+    for (int i = 0; i < this->StateVariableList.size(); ++i) {
+        StateVariableList[i]->writeOut(xmlOut);
+    }
+    xmlOut.writeEndElement(); // Dynamics
 
     // declarations
     for (int i = 0; i < this->AnalogPortList.size(); ++i) {
-        AnalogPortList[i]->writeOut(doc, CClass);
+        AnalogPortList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->EventPortList.size(); ++i) {
-        EventPortList[i]->writeOut(doc, CClass);
+        EventPortList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->ImpulsePortList.size(); ++i) {
-        ImpulsePortList[i]->writeOut(doc, CClass);
+        ImpulsePortList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->ParameterList.size(); ++i) {
-        ParameterList[i]->writeOut(doc, CClass);
+        ParameterList[i]->writeOut(xmlOut);
     }
 
-    // dynamics
-    for (int i = 0; i < this->RegimeList.size(); ++i) {
-        RegimeList[i]->writeOut(doc, dynamics);
-    }
-    for (int i = 0; i < this->AliasList.size(); ++i) {
-        AliasList[i]->writeOut(doc, dynamics);
-    }
-    for (int i = 0; i < this->StateVariableList.size(); ++i) {
-        StateVariableList[i]->writeOut(doc, dynamics);
-    }
+    xmlOut.writeEndElement(); // ComponentClass
+    xmlOut.writeEndDocument();
 }
 
 void ComponentRootInstance::write_node_xml(QXmlStreamWriter &xmlOut)
@@ -900,12 +928,11 @@ void Parameter::readIn(QDomElement e)
     this->dims->fromString(e.attribute("dimension",""));
 }
 
-void Parameter::writeOut(QDomDocument * doc, QDomElement &parent)
+void Parameter::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement parameter = doc->createElement ("Parameter");
-    parameter.setAttribute("name", this->name);
-    parameter.setAttribute("dimension", this->dims->toString());
-    parent.appendChild(parameter);
+    xmlOut.writeEmptyElement("Parameter");
+    xmlOut.writeAttribute("name", this->name);
+    xmlOut.writeAttribute("dimension", this->dims->toString());
 }
 
 QString Parameter::getName()
@@ -948,12 +975,12 @@ void StateAssignment::readIn(QDomElement e)
     }
 }
 
-void StateAssignment::writeOut(QDomDocument * doc, QDomElement &parent)
+void StateAssignment::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement StateAssignment = doc->createElement ("StateAssignment");
-    StateAssignment.setAttribute("variable", this->name);
-    parent.appendChild(StateAssignment);
-    this->maths->writeOut(doc, StateAssignment);
+    xmlOut.writeStartElement("StateAssignment");
+    xmlOut.writeAttribute("variable", this->name);
+    this->maths->writeOut(xmlOut);
+    xmlOut.writeEndElement(); // StateAssignment
 }
 
 void OnEvent::readIn(QDomElement e)
@@ -1013,31 +1040,31 @@ void OnEvent::readIn(QDomElement e)
     }
 }
 
-void OnEvent::writeOut(QDomDocument * doc, QDomElement &parent)
+void OnEvent::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement OnEvent = doc->createElement ("OnEvent");
-    parent.appendChild(OnEvent);
+    xmlOut.writeStartElement("OnEvent");
     if (target_regime != NULL) {
-        OnEvent.setAttribute("target_regime", this->target_regime->name);
+        xmlOut.writeAttribute("target_regime", this->target_regime->name);
     } else {
-        OnEvent.setAttribute("target_regime", "Error: No Synapse Regime!");
+        xmlOut.writeAttribute("target_regime", "Error: No Synapse Regime!");
     }
 
     if (src_port != NULL) {
-        OnEvent.setAttribute("src_port", this->src_port->getName());
+        xmlOut.writeAttribute("src_port", this->src_port->getName());
     } else {
-        OnEvent.setAttribute("src_port", "Error: No Source Event Port!");
+        xmlOut.writeAttribute("src_port", "Error: No Source Event Port!");
     }
 
     for (int i = 0; i < this->StateAssignList.size(); ++i) {
-        this->StateAssignList[i]->writeOut(doc, OnEvent);
+        this->StateAssignList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->eventOutList.size(); ++i) {
-        this->eventOutList[i]->writeOut(doc, OnEvent);
+        this->eventOutList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->impulseOutList.size(); ++i) {
-        this->impulseOutList[i]->writeOut(doc, OnEvent);
+        this->impulseOutList[i]->writeOut(xmlOut);
     }
+    xmlOut.writeEndElement(); // OnEvent
 }
 
 void OnImpulse::readIn(QDomElement e)
@@ -1097,31 +1124,31 @@ void OnImpulse::readIn(QDomElement e)
     }
 }
 
-void OnImpulse::writeOut(QDomDocument * doc, QDomElement &parent)
+void OnImpulse::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement OnImpulse = doc->createElement ("OnImpulse");
-    parent.appendChild(OnImpulse);
+    xmlOut.writeStartElement("OnImpulse");
     if (target_regime != NULL) {
-        OnImpulse.setAttribute("target_regime", this->target_regime->name);
+        xmlOut.writeAttribute("target_regime", this->target_regime->name);
     } else {
-        OnImpulse.setAttribute("target_regime", "");
+        xmlOut.writeAttribute("target_regime", "");
     }
 
     if (src_port != NULL) {
-        OnImpulse.setAttribute("src_port", this->src_port->getName());
+        xmlOut.writeAttribute("src_port", this->src_port->getName());
     } else {
-        OnImpulse.setAttribute("src_port", "");
+        xmlOut.writeAttribute("src_port", "");
     }
 
     for (int i = 0; i < this->StateAssignList.size(); ++i) {
-        this->StateAssignList[i]->writeOut(doc, OnImpulse);
+        this->StateAssignList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->eventOutList.size(); ++i) {
-        this->eventOutList[i]->writeOut(doc, OnImpulse);
+        this->eventOutList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->impulseOutList.size(); ++i) {
-        this->impulseOutList[i]->writeOut(doc, OnImpulse);
+        this->impulseOutList[i]->writeOut(xmlOut);
     }
+    xmlOut.writeEndElement(); // OnImpulse
 }
 
 void Trigger::readIn(QDomElement e)
@@ -1142,11 +1169,11 @@ void Trigger::readIn(QDomElement e)
     }
 }
 
-void Trigger::writeOut(QDomDocument * doc, QDomElement &parent)
+void Trigger::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement Trigger = doc->createElement ("Trigger");
-    parent.appendChild(Trigger);
-    this->maths->writeOut(doc, Trigger);
+    xmlOut.writeStartElement("Trigger");
+    this->maths->writeOut(xmlOut);
+    xmlOut.writeEndElement(); // Trigger
 }
 
 void OnCondition::readIn(QDomElement e)
@@ -1200,27 +1227,27 @@ void OnCondition::readIn(QDomElement e)
     }
 }
 
-void OnCondition::writeOut(QDomDocument * doc, QDomElement &parent)
+void OnCondition::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement OnCondition = doc->createElement ("OnCondition");
-    parent.appendChild(OnCondition);
+    xmlOut.writeStartElement("OnCondition");
     if (this->target_regime != NULL) {
-        OnCondition.setAttribute("target_regime", this->target_regime->name);
+        xmlOut.writeAttribute("target_regime", this->target_regime->name);
     } else {
-        OnCondition.setAttribute("target_regime", "Error: No Synapse Regime!");
+        xmlOut.writeAttribute("target_regime", "Error: No Synapse Regime!");
     }
 
     for (int i = 0; i < this->StateAssignList.size(); ++i) {
-        this->StateAssignList[i]->writeOut(doc, OnCondition);
+        this->StateAssignList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->eventOutList.size(); ++i) {
-        this->eventOutList[i]->writeOut(doc, OnCondition);
+        this->eventOutList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->impulseOutList.size(); ++i) {
-        this->impulseOutList[i]->writeOut(doc, OnCondition);
+        this->impulseOutList[i]->writeOut(xmlOut);
     }
 
-    this->trigger->writeOut(doc, OnCondition);
+    this->trigger->writeOut(xmlOut);
+    xmlOut.writeEndElement(); // OnCondition
 }
 
 void Alias::readIn(QDomElement e)
@@ -1254,13 +1281,13 @@ void Alias::readIn(QDomElement e)
     this->dims->fromString(e.attribute("dimension",""));
 }
 
-void Alias::writeOut(QDomDocument * doc, QDomElement &parent)
+void Alias::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement Alias = doc->createElement ("Alias");
-    parent.appendChild(Alias);
-    Alias.setAttribute("name", this->name);
-    Alias.setAttribute("dimension", this->dims->toString());
-    this->maths->writeOut(doc, Alias);
+    xmlOut.writeStartElement("Alias");
+    xmlOut.writeAttribute("name", this->name);
+    xmlOut.writeAttribute("dimension", this->dims->toString());
+    this->maths->writeOut(xmlOut);
+    xmlOut.writeEndElement(); // Alias
 }
 
 void StateVariable::readIn(QDomElement e)
@@ -1279,12 +1306,11 @@ void StateVariable::readIn(QDomElement e)
     this->dims->fromString(e.attribute("dimension",""));
 }
 
-void StateVariable::writeOut(QDomDocument * doc, QDomElement &parent)
+void StateVariable::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement StateVariable = doc->createElement ("StateVariable");
-    parent.appendChild(StateVariable);
-    StateVariable.setAttribute("name", this->name);
-    StateVariable.setAttribute("dimension", this->dims->toString());
+    xmlOut.writeEmptyElement("StateVariable");
+    xmlOut.writeAttribute("name", this->name);
+    xmlOut.writeAttribute("dimension", this->dims->toString());
 }
 
 void TimeDerivative::readIn(QDomElement e)
@@ -1315,16 +1341,16 @@ void TimeDerivative::readIn(QDomElement e)
     }
 }
 
-void TimeDerivative::writeOut(QDomDocument * doc, QDomElement &parent)
+void TimeDerivative::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement TimeDerivative = doc->createElement ("TimeDerivative");
+    xmlOut.writeStartElement("TimeDerivative");
     if (this->variable != NULL) {
-        TimeDerivative.setAttribute("variable", this->variable->getName());
+        xmlOut.writeAttribute("variable", this->variable->getName());
     } else {
-        TimeDerivative.setAttribute("variable", "Error: No variable!");
+        xmlOut.writeAttribute("variable", "Error: No variable!");
     }
-    parent.appendChild(TimeDerivative);
-    this->maths->writeOut(doc, TimeDerivative);
+    this->maths->writeOut(xmlOut);
+    xmlOut.writeEndElement(); // TimeDerivative
 }
 
 void MathInLine::readIn(QDomElement e)
@@ -1344,15 +1370,12 @@ void MathInLine::readIn(QDomElement e)
 #endif
 }
 
-void MathInLine::writeOut(QDomDocument * doc, QDomElement &parent)
+void MathInLine::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement MathInLine = doc->createElement ("MathInline");
-    parent.appendChild(MathInLine);
     QString out = this->equation;
     out.replace("&gt;", ">");
     out.replace("&lt;", "<");
-    QDomText text = doc->createTextNode(out);
-    MathInLine.appendChild(text);
+    xmlOut.writeTextElement("MathInline", out);
 }
 
 
@@ -1370,14 +1393,13 @@ void EventOut::readIn(QDomElement e)
     }
 }
 
-void EventOut::writeOut(QDomDocument * doc, QDomElement &parent)
+void EventOut::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement EventOut = doc->createElement ("EventOut");
-    parent.appendChild(EventOut);
+    xmlOut.writeEmptyElement("EventOut");
     if (this->port != NULL) {
-        EventOut.setAttribute("port", this->port->getName());
+        xmlOut.writeAttribute("port", this->port->getName());
     } else {
-        EventOut.setAttribute("port", "Error: No Event Port!");
+        xmlOut.writeAttribute("port", "Error: No Event Port!");
     }
 }
 
@@ -1395,22 +1417,21 @@ void ImpulseOut::readIn(QDomElement e)
     }
 }
 
-void ImpulseOut::writeOut(QDomDocument * doc, QDomElement &parent)
+void ImpulseOut::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement ImpulseOut = doc->createElement ("ImpulseOut");
-    parent.appendChild(ImpulseOut);
+    xmlOut.writeEmptyElement("ImpulseOut");
     if (this->port != NULL) {
         if (this->port->mode == ImpulseSendPort) {
             if (this->port->parameter != NULL) {
-                ImpulseOut.setAttribute("port", this->port->parameter->getName());
+                xmlOut.writeAttribute("port", this->port->parameter->getName());
             } else {
-                ImpulseOut.setAttribute("port", "Error: No Parameter in Impulse Send Port!");
+                xmlOut.writeAttribute("port", "Error: No Parameter in Impulse Send Port!");
             }
         } else {
-            ImpulseOut.setAttribute("port", this->port->getName());
+            xmlOut.writeAttribute("port", this->port->getName());
         }
     } else {
-        ImpulseOut.setAttribute("port", "Error: No Impulse Port!");
+        xmlOut.writeAttribute("port", "Error: No Impulse Port!");
     }
 }
 
@@ -1458,38 +1479,34 @@ void AnalogPort::readIn(QDomElement e)
     }
 }
 
-void AnalogPort::writeOut(QDomDocument * doc, QDomElement &parent)
+void AnalogPort::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement AnalogPort;
-
     if (this->mode == AnalogSendPort) {
-        AnalogPort = doc->createElement ("AnalogSendPort");
-        AnalogPort.setAttribute("name", this->getName());
+        xmlOut.writeEmptyElement("AnalogSendPort");
+        xmlOut.writeAttribute("name", this->getName());
         if (this->isPerConn) {
-            AnalogPort.setAttribute("perConn",true);
+            xmlOut.writeAttribute("perConn", "1");
         }
     }
     if (this->mode == AnalogRecvPort) {
-        AnalogPort = doc->createElement ("AnalogReceivePort");
-        AnalogPort.setAttribute("name", this->getName());
-        AnalogPort.setAttribute("dimension", this->dims->toString());
+        xmlOut.writeEmptyElement("AnalogReceivePort");
+        xmlOut.writeAttribute("name", this->getName());
+        xmlOut.writeAttribute("dimension", this->dims->toString());
     }
     if (this->mode == AnalogReducePort) {
-        AnalogPort = doc->createElement ("AnalogReducePort");
-        AnalogPort.setAttribute("name", this->getName());
+        xmlOut.writeEmptyElement("AnalogReducePort");
+        xmlOut.writeAttribute("name", this->getName());
         if (this->op == ReduceOperationNone) {
-            //AnalogPort.setAttribute("reduce_op", "");
+            //xmlOut.writeAttribute("reduce_op", "");
         }
         if (this->op == ReduceOperationAddition) {
-            AnalogPort.setAttribute("reduce_op", "+");
+            xmlOut.writeAttribute("reduce_op", "+");
         }
-        AnalogPort.setAttribute("dimension", this->dims->toString());
+        xmlOut.writeAttribute("dimension", this->dims->toString());
         if (this->isPost) {
-            AnalogPort.setAttribute("post",true);
+            xmlOut.writeAttribute("post", "1");
         }
     }
-    parent.appendChild(AnalogPort);
-
 }
 
 void EventPort::readIn(QDomElement e)
@@ -1520,23 +1537,19 @@ void EventPort::readIn(QDomElement e)
     }
 }
 
-void EventPort::writeOut(QDomDocument * doc, QDomElement &parent)
+void EventPort::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement EventPort;
-
     if (this->mode == EventSendPort) {
-        EventPort = doc->createElement ("EventSendPort");
-        EventPort.setAttribute ("name", this->getName());
+        xmlOut.writeEmptyElement("EventSendPort");
+        xmlOut.writeAttribute("name", this->getName());
     }
     if (this->mode == EventRecvPort) {
-        EventPort = doc->createElement ("EventReceivePort");
-        EventPort.setAttribute ("name", this->getName());
+        xmlOut.writeEmptyElement("EventReceivePort");
+        xmlOut.writeAttribute("name", this->getName());
         if (this->isPost) {
-            EventPort.setAttribute ("post", true);
+            xmlOut.writeAttribute("post", "1");
         }
     }
-
-    parent.appendChild(EventPort);
 }
 
 void ImpulsePort::readIn(QDomElement e)
@@ -1568,28 +1581,24 @@ void ImpulsePort::readIn(QDomElement e)
     }
 }
 
-void ImpulsePort::writeOut(QDomDocument * doc, QDomElement &parent)
+void ImpulsePort::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement ImpulsePort;
-
     if (this->mode == ImpulseSendPort) {
-        ImpulsePort = doc->createElement ("ImpulseSendPort");
+        xmlOut.writeEmptyElement("ImpulseSendPort");
         if (this->parameter != NULL) {
-            ImpulsePort.setAttribute("name", this->parameter->getName());
+            xmlOut.writeAttribute("name", this->parameter->getName());
         } else {
-            ImpulsePort.setAttribute("name", "Error: No paramater named!");
+            xmlOut.writeAttribute("name", "Error: No paramater named!");
         }
     }
     if (this->mode == ImpulseRecvPort) {
-        ImpulsePort = doc->createElement ("ImpulseReceivePort");
-        ImpulsePort.setAttribute("name", this->getName());
-        ImpulsePort.setAttribute("dimension", this->dims->toString());
+        xmlOut.writeEmptyElement("ImpulseReceivePort");
+        xmlOut.writeAttribute("name", this->getName());
+        xmlOut.writeAttribute("dimension", this->dims->toString());
         if (this->isPost) {
-            ImpulsePort.setAttribute("post",true);
+            xmlOut.writeAttribute("post", "1");
         }
     }
-
-    parent.appendChild(ImpulsePort);
 }
 
 void Regime::readIn(QDomElement e)
@@ -1635,25 +1644,25 @@ void Regime::readIn(QDomElement e)
     }
 }
 
-void Regime::writeOut(QDomDocument *doc, QDomElement &parent)
+void Regime::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement regime = doc->createElement("Regime");
-    regime.setAttribute("name", this->name);
-    parent.appendChild(regime);
+    xmlOut.writeStartElement("Regime");
+    xmlOut.writeAttribute("name", this->name);
 
     // write children
     for (int i = 0; i < this->TimeDerivativeList.size(); ++i) {
-        this->TimeDerivativeList[i]->writeOut(doc, regime);
+        this->TimeDerivativeList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->OnEventList.size(); ++i) {
-        this->OnEventList[i]->writeOut(doc, regime);
+        this->OnEventList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->OnConditionList.size(); ++i) {
-        this->OnConditionList[i]->writeOut(doc, regime);
+        this->OnConditionList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->OnImpulseList.size(); ++i) {
-        this->OnImpulseList[i]->writeOut(doc, regime);
+        this->OnImpulseList[i]->writeOut(xmlOut);
     }
+    xmlOut.writeEndElement(); // Regime
 }
 
 Parameter::Parameter(Parameter *data)
@@ -1682,11 +1691,227 @@ ParameterInstance::ParameterInstance(ParameterInstance *data)
     this->filename = data->filename;
 }
 
+namespace {
+    // The binary file holds, for each element, the int index followed by
+    // the double value, packed with no padding. This is the layout the
+    // simulators read, so it is kept; the reads and writes move whole
+    // blocks of pairs at a time rather than one field at a time.
+    const int explicitDataPairSize = sizeof(int) + sizeof(double);
+
+    // Where the search for an unused explicitDataBinaryFile name resumes
+    int nextExplicitFileIndex = 0;
+    QString explicitFileDir;
+
+    // Returns the first name at or after nextExplicitFileIndex that is
+    // neither on disk (or, when exporting, claimed by this export) nor
+    // already handed out since the last restartFileNames().
+    QString newExplicitFileName(const QDir& saveDir)
+    {
+        if (saveDir.absolutePath() != explicitFileDir) {
+            explicitFileDir = saveDir.absolutePath();
+            nextExplicitFileIndex = 0;
+        }
+        for (;;) {
+            QString name = "explicitDataBinaryFile" + QString::number(nextExplicitFileIndex++) + ".bin";
+            QString path = saveDir.absoluteFilePath(name);
+            // when exporting through the exportCache, the files left by
+            // the last export are not in the way of this one
+            bool taken = exportCache::isActive() ? exportCache::isClaimed(path) : QFile::exists(path);
+            if (!taken) {
+                return name;
+            }
+        }
+    }
+}
+
+void ParameterInstance::restartFileNames(void)
+{
+    nextExplicitFileIndex = 0;
+}
+
+bool ParameterInstance::isDense(void) const
+{
+    if (this->indices.size() != this->value.size()) {
+        return false;
+    }
+    const int* ind = this->indices.constData();
+    for (int i = 0; i < this->indices.size(); ++i) {
+        if (ind[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ParameterInstance::setDenseValues(const QVector<double>& vals)
+{
+    this->value = vals;
+    this->indices.resize(vals.size());
+    int* ind = this->indices.data();
+    for (int i = 0; i < vals.size(); ++i) {
+        ind[i] = i;
+    }
+}
+
+explicitValueLookup::explicitValueLookup(const ParameterInstance* par)
+{
+    this->values = NULL;
+    this->count = 0;
+    if (par == NULL) {
+        return;
+    }
+    this->values = par->value.constData();
+    this->count = qMin(par->value.size(), par->indices.size());
+    if (par->isDense()) {
+        return;
+    }
+
+    // where each index is held; a repeated index takes its last value,
+    // as when the list is read out in order
+    const int* ind = par->indices.constData();
+    int maxIndex = -1;
+    for (int i = 0; i < this->count; ++i) {
+        maxIndex = qMax(maxIndex, ind[i]);
+    }
+    this->position.fill(-1, maxIndex + 1);
+    for (int i = 0; i < this->count; ++i) {
+        if (ind[i] >= 0) {
+            this->position[ind[i]] = i;
+        }
+    }
+    // a non-empty list with no usable index must not read as dense
+    if (this->position.isEmpty()) {
+        this->count = 0;
+    }
+}
+
+bool explicitValueLookup::contains(int index) const
+{
+    if (index < 0) {
+        return false;
+    }
+    if (this->position.isEmpty()) {
+        return index < this->count;
+    }
+    return index < this->position.size() && this->position[index] >= 0;
+}
+
+double explicitValueLookup::at(int index, double fallback) const
+{
+    if (!this->contains(index)) {
+        return fallback;
+    }
+    if (this->position.isEmpty()) {
+        return this->values[index];
+    }
+    return this->values[this->position[index]];
+}
+
+namespace {
+    // the range and sum of values [first, end), then their histogram
+    class explicitStatsRunner : public QRunnable
+    {
+    public:
+        explicitStatsRunner(const double* values, int first, int end, explicitValueStatistics* part, const explicitValueStatistics* whole)
+            : values(values), first(first), end(end), part(part), whole(whole) {}
+        void run() {
+            if (this->whole == NULL) {
+                double lo = std::numeric_limits<double>::max();
+                double hi = -std::numeric_limits<double>::max();
+                double sum = 0.0;
+                for (int i = this->first; i < this->end; ++i) {
+                    lo = qMin(lo, this->values[i]);
+                    hi = qMax(hi, this->values[i]);
+                    sum += this->values[i];
+                }
+                this->part->min = lo;
+                this->part->max = hi;
+                this->part->mean = sum;
+                return;
+            }
+            int bins = this->whole->histogram.size();
+            this->part->histogram.fill(0, bins);
+            for (int i = this->first; i < this->end; ++i) {
+                int bin = (int) (this->whole->normalised(this->values[i]) * bins);
+                ++this->part->histogram[qBound(0, bin, bins - 1)];
+            }
+        }
+    private:
+        const double* values;
+        int first;
+        int end;
+        explicitValueStatistics* part;
+        const explicitValueStatistics* whole;
+    };
+}
+
+explicitValueStatistics::explicitValueStatistics()
+{
+    this->count = 0;
+    this->min = 0.0;
+    this->max = 0.0;
+    this->mean = 0.0;
+}
+
+void explicitValueStatistics::compute(const ParameterInstance* par, int numBins)
+{
+    *this = explicitValueStatistics();
+    if (par == NULL || numBins < 1) {
+        return;
+    }
+    this->count = qMin(par->value.size(), par->indices.size());
+    if (this->count == 0) {
+        return;
+    }
+    const double* values = par->value.constData();
+
+    int threads = qMax(1, qMin(QThread::idealThreadCount(), this->count / EXPLICIT_DATA_BLOCK_ELEMENTS + 1));
+    int blockSize = (this->count + threads - 1) / threads;
+    QVector<explicitValueStatistics> parts(threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    for (int t = 0; t < threads; ++t) {
+        pool.start(new explicitStatsRunner(values, t*blockSize, qMin(this->count, (t+1)*blockSize), &parts[t], NULL));
+    }
+    pool.waitForDone();
+    this->min = std::numeric_limits<double>::max();
+    this->max = -std::numeric_limits<double>::max();
+    double sum = 0.0;
+    for (int t = 0; t < threads; ++t) {
+        if (t*blockSize < this->count) {
+            this->min = qMin(this->min, parts[t].min);
+            this->max = qMax(this->max, parts[t].max);
+            sum += parts[t].mean;
+        }
+    }
+    this->mean = sum / this->count;
+
+    // the bins need the range, so are counted in a second pass
+    this->histogram.fill(0, numBins);
+    for (int t = 0; t < threads; ++t) {
+        pool.start(new explicitStatsRunner(values, t*blockSize, qMin(this->count, (t+1)*blockSize), &parts[t], this));
+    }
+    pool.waitForDone();
+    for (int t = 0; t < threads; ++t) {
+        for (int b = 0; b < numBins; ++b) {
+            this->histogram[b] += parts[t].histogram[b];
+        }
+    }
+}
+
+double explicitValueStatistics::normalised(double v) const
+{
+    if (this->max <= this->min) {
+        return 1.0;
+    }
+    return (v - this->min) / (this->max - this->min);
+}
+
 void ParameterInstance::writeExplicitListNodeData(QXmlStreamWriter &xmlOut)
 {
-    QSettings settings;
     // fetch the option for whether we write binary data for saving
-    bool writeBinary = settings.value("fileOptions/saveBinaryConnections", "error").toBool();
+    bool writeBinary = settingsCache::saveBinaryConnections();
 
     // if we have few indices, or we are forbidden from using binary data
     if (this->indices.size() <= MIN_CONNS_TO_FORCE_BINARY || !writeBinary) {
@@ -1703,7 +1928,7 @@ void ParameterInstance::writeExplicitListNodeData(QXmlStreamWriter &xmlOut)
         xmlOut.writeStartElement("ValueList");
 
         // Save as binary data
-        QString filePathString = settings.value("files/currentFileName", "error").toString();
+        QString filePathString = settingsCache::currentFileName("error");
 
         if (filePathString == "error") {
             qDebug() << "Error getting current project path - "
@@ -1719,29 +1944,8 @@ void ParameterInstance::writeExplicitListNodeData(QXmlStreamWriter &xmlOut)
 
         QString uniqueName;
         if (this->filename.isEmpty()) {
-
             //generate a unique filename to save the par or sv under
-            QStringList filters;
-            filters << "explicitDataBinaryFile*";
-            saveDir.setNameFilters(filters);
-
-            QStringList files = saveDir.entryList();
-
-            QString baseName = "explicitDataBinaryFile";
-            bool unique = false;
-            int index = 0;
-            while (!unique) {
-                uniqueName = baseName + QString::number(float(index)) + ".bin";
-                unique = true;
-                for (int i = 0; i < (int)files.count(); ++i) {
-                    // see if the new name is unique
-                    if (uniqueName == files[i]) {
-                        unique = false;
-                        ++index;
-                        break; // out of for
-                    }
-                }
-            }
+            uniqueName = newExplicitFileName(saveDir);
         } else {
             uniqueName = this->filename;
         }
@@ -1755,24 +1959,55 @@ void ParameterInstance::writeExplicitListNodeData(QXmlStreamWriter &xmlOut)
         xmlOut.writeAttribute("file_name", uniqueName);
         xmlOut.writeAttribute("num_elements", QString::number(this->value.size()));
 
+        // skip the write if an earlier export left this data in the file;
+        // a save has no earlier export, so the hash is not worked out
+        QByteArray exportKey;
+        if (exportCache::isActive()) {
+            QCryptographicHash hash(QCryptographicHash::Md5);
+            hash.addData((const char*) this->indices.constData(), this->indices.size()*sizeof(int));
+            hash.addData((const char*) this->value.constData(), this->value.size()*sizeof(double));
+            exportKey = hash.result().toHex();
+            if (exportCache::isCurrent(saveFileName, exportKey)) {
+                xmlOut.writeEndElement(); // valueList
+                return;
+            }
+        }
+
         // write out binary data
         QFile export_file(saveFileName);
 
         if (!export_file.open( QIODevice::WriteOnly | QIODevice::Truncate)) {
-            QMessageBox msgBox;
-            msgBox.setText("Error creating binary file '" + saveFileName
-                           + "' - is there sufficient disk space?");
-            msgBox.exec();
+            SCUtilities::showMessage("Error creating binary file '" + saveFileName
+                                     + "' - is there sufficient disk space?");
             return;
         }
 
         // write out the data to the save file, index first, then
         // value, then next index-value pair...
-        QDataStream access(&export_file);
-        for (int i = 0; i < this->value.size(); ++i) {
-            access.writeRawData((char*) &this->indices[i], sizeof(int));
-            access.writeRawData((char*) &this->value[i], sizeof(double));
+        int numElements = qMin(this->value.size(), this->indices.size());
+        QByteArray block;
+        block.resize(qMin(numElements, EXPLICIT_DATA_BLOCK_ELEMENTS) * explicitDataPairSize);
+        const int* ind = this->indices.constData();
+        const double* val = this->value.constData();
+        for (int start = 0; start < numElements; start += EXPLICIT_DATA_BLOCK_ELEMENTS) {
+            int n = qMin(EXPLICIT_DATA_BLOCK_ELEMENTS, numElements - start);
+            char* out = block.data();
+            for (int i = start; i < start + n; ++i) {
+                memcpy(out, &ind[i], sizeof(int));
+                memcpy(out + sizeof(int), &val[i], sizeof(double));
+                out += explicitDataPairSize;
+            }
+            qint64 bytes = qint64(n) * explicitDataPairSize;
+            if (export_file.write(block.constData(), bytes) != bytes) {
+                SCUtilities::showMessage("Error writing binary file '" + saveFileName
+                                         + "' - is there sufficient disk space?");
+                export_file.close();
+                export_file.remove();
+                return;
+            }
         }
+        export_file.close();
+        exportCache::written(saveFileName, exportKey);
 
         xmlOut.writeEndElement(); // valueList
     }
@@ -1796,8 +2031,7 @@ void ParameterInstance::readExplicitListNodeData(QDomNode &n)
         int num_elements = binaryValInst.at(0).toElement().attribute("num_elements").toUInt();
 
         // get a handle to the saved file
-        QSettings settings;
-        QString filePathString = settings.value("files/currentFileName", "error").toString();
+        QString filePathString = settingsCache::currentFileName("error");
 
         if (filePathString == "error") {
             qDebug() << "Error getting current project path - THIS SHOULD NEVER HAPPEN!";
@@ -1823,22 +2057,39 @@ void ParameterInstance::readExplicitListNodeData(QDomNode &n)
             return;
         }
 
-        this->value.clear();
-        this->indices.clear();
-
-        // get the count of the number of value-index pairs we have read in
-        int count = 0;
+        // the number of value-index pairs in the file, which sizes the
+        // lists up front
+        int count = int(fileIn.size() / explicitDataPairSize);
+        if (fileIn.size() % explicitDataPairSize != 0) {
+            qDebug() << "Binary file" << this->filename << "ends with a partial index-value pair";
+        }
+        this->value.resize(count);
+        this->indices.resize(count);
+        int* ind = this->indices.data();
+        double* val = this->value.data();
 
         // load in the binary packed data
-        while (!(fileIn.atEnd())) {
-            // read in the required values:
-            int index;
-            double value;
-            fileIn.read((char *) &index,sizeof(int));
-            fileIn.read((char *) &value,sizeof(double));
-            this->indices.push_back(index);
-            this->value.push_back(value);
-            ++count;
+        QByteArray block;
+        block.resize(qMin(count, EXPLICIT_DATA_BLOCK_ELEMENTS) * explicitDataPairSize);
+        int got = 0;
+        while (got < count) {
+            int n = qMin(EXPLICIT_DATA_BLOCK_ELEMENTS, count - got);
+            qint64 bytes = qint64(n) * explicitDataPairSize;
+            if (fileIn.read(block.data(), bytes) != bytes) {
+                break;
+            }
+            const char* in = block.constData();
+            for (int i = got; i < got + n; ++i) {
+                memcpy(&ind[i], in, sizeof(int));
+                memcpy(&val[i], in + sizeof(int), sizeof(double));
+                in += explicitDataPairSize;
+            }
+            got += n;
+        }
+        if (got != count) {
+            this->value.resize(got);
+            this->indices.resize(got);
+            count = got;
         }
 
         if (count != num_elements) {
@@ -1989,6 +2240,12 @@ int ImpulsePort::validateImpulsePort(Component * component, QStringList * )
 MathInLine::MathInLine(MathInLine *data)
 {
     equation = data->equation;
+    tokenisedEquation = data->tokenisedEquation;
+    tokens = data->tokens;
+    checkedEquation = data->checkedEquation;
+    checkedSymbols = data->checkedSymbols;
+    unrecognisedTokens = data->unrecognisedTokens;
+    bracketsMatch = data->bracketsMatch;
 }
 
 QString MathInLine::getHTMLSafeEquation()
@@ -2252,6 +2509,7 @@ Regime::~Regime()
 
 Component::Component()
 {
+    mathSymbolsHeld = false;
     initial_regime = NULL;
     editedVersion.clear();
     path = "temp";
@@ -2261,6 +2519,7 @@ Component::Component()
 
 Component::Component(QSharedPointer<Component>data)
 {
+    mathSymbolsHeld = false;
     name = data->name;
     this->type = data->type;
     this->islearning = data->islearning;
@@ -2487,12 +2746,7 @@ Component& Component::operator=(const Component& data)
 
     if (!errors.isEmpty()) {
         // display errors
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>Component validation failed</b></P>" + errors);
-        msgBox.setIcon(QMessageBox::Warning);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.setModal(false);
-        msgBox.exec();
+        SCUtilities::showMessage("<P><b>Component validation failed</b></P>" + errors, QMessageBox::Warning, true);
     }
 
     return *this;
@@ -2650,7 +2904,7 @@ ComponentInstance::ComponentInstance(QSharedPointer <ComponentInstance>data, boo
     this->component = data->component;
 }
 
-void ComponentInstance::remapPointers(QMap <systemObject *, QSharedPointer <systemObject> > pointerMap)
+void ComponentInstance::remapPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &pointerMap)
 {
 
     // first for the owner
@@ -2818,75 +3072,72 @@ void MathInLine::validateMathSetup(QString& testequation, QStringList& FuncList)
     FuncList.push_back("dt");
 }
 
+// append a warning to the list read back by the caller of the validation
+static void addMathWarning(QString text)
+{
+    QSettings settings;
+    int num_errs = settings.beginReadArray("warnings");
+    settings.endArray();
+    settings.beginWriteArray("warnings");
+        settings.setArrayIndex(num_errs + 1);
+        settings.setValue("warnText",  text);
+    settings.endArray();
+}
+
 int MathInLine::validateMathInLine(Component* component, QStringList * )
 {
     if (equation.size() == 0) {
         return 1;
     }
 
-    QString test = equation;
-    QStringList FuncList;
-    this->validateMathSetup (test, FuncList);
-
-    // tokenise
-    QStringList splitTest;
-    splitTest = test.split(' ');
+    static QSet < QString > functions;
+    if (functions.isEmpty()) {
+        QString test;
+        QStringList FuncList;
+        this->validateMathSetup (test, FuncList);
+        functions = QSet < QString >::fromList(FuncList);
+    }
 
-    // check each token...
-    for (int i = 0; i < (int) splitTest.count(); ++i) {
+    QString key;
+    const QSet < QString > & symbols = component->getMathSymbols(key);
 
-        bool recognised = false;
+    if (checkedEquation != equation || checkedSymbols != key) {
 
-        // see if it is in the component
-        for (int j = 0; j<component->ParameterList.size(); j++) {
-            if (component->ParameterList[j]->name.compare(splitTest[i]) == 0)
-                recognised = true;
-        }
-        for (int j = 0; j<component->StateVariableList.size(); j++) {
-            if (component->StateVariableList[j]->name.compare(splitTest[i]) == 0)
-                recognised = true;
-        }
-        for (int j = 0; j<component->AliasList.size(); j++) {
-            if (component->AliasList[j]->name.compare(splitTest[i]) == 0)
-                recognised = true;
-        }
-        for (int j = 0; j<component->AnalogPortList.size(); j++) {
-            if (component->AnalogPortList[j]->name.compare(splitTest[i]) == 0)
-                recognised = true;
-        }
-        for (int j = 0; j<component->ImpulsePortList.size(); j++) {
-            if (component->ImpulsePortList[j]->name.compare(splitTest[i]) == 0)
-                recognised = true;
-        }
-        for (int j = 0; j<(int)FuncList.size(); j++) {
-            if (FuncList[j].compare(splitTest[i]) == 0)
-                recognised = true;
-        }
-        // see if it is a number...
-        if (splitTest[i][0] > 47 && splitTest[i][0] < 58 && splitTest[i][0] != '.') {
-            recognised = true;
+        // tokenise
+        if (tokenisedEquation != equation) {
+            QString test;
+            QStringList FuncList;
+            this->validateMathSetup (test, FuncList);
+            tokens = test.split(' ', QString::SkipEmptyParts);
+            tokenisedEquation = equation;
         }
 
-        // if a token is not recognised, then let the user know - this may be better done elsewhere...
-        if (!recognised) {
-          QSettings settings;
-          int num_errs = settings.beginReadArray("warnings");
-          settings.endArray();
-          settings.beginWriteArray("warnings");
-              settings.setArrayIndex(num_errs + 1);
-              settings.setValue("warnText",  "Warning: MathInLine contains unrecognised token " + splitTest[i]);
-          settings.endArray();
+        // check each token...
+        unrecognisedTokens.clear();
+        for (int i = 0; i < (int) tokens.count(); ++i) {
+            // see if it is in the component, a function or a number...
+            const QString &token = tokens[i];
+            if (symbols.contains(token) || functions.contains(token)) {
+                continue;
+            }
+            if (token[0] > 47 && token[0] < 58 && token[0] != '.') {
+                continue;
+            }
+            unrecognisedTokens.push_back(token);
         }
+        bracketsMatch = (equation.count("(") == equation.count(")"));
+
+        checkedEquation = equation;
+        checkedSymbols = key;
     }
 
-    if (equation.count("(") != equation.count(")")) {
-        QSettings settings;
-        int num_errs = settings.beginReadArray("warnings");
-        settings.endArray();
-        settings.beginWriteArray("warnings");
-            settings.setArrayIndex(num_errs + 1);
-            settings.setValue("warnText",  "Warning: MathInLine contains mis-matched brackets");
-        settings.endArray();
+    // if a token is not recognised, then let the user know - this may be better done elsewhere...
+    for (int i = 0; i < unrecognisedTokens.size(); ++i) {
+        addMathWarning("Warning: MathInLine contains unrecognised token " + unrecognisedTokens[i]);
+    }
+
+    if (!bracketsMatch) {
+        addMathWarning("Warning: MathInLine contains mis-matched brackets");
     }
 
     return 0;
@@ -3200,6 +3451,40 @@ int Regime::validateRegime(Component * component, QStringList * errs)
     return failures;
 }
 
+const QSet < QString > & Component::getMathSymbols(QString &key)
+{
+    if (!mathSymbolsHeld) {
+        mathSymbols.clear();
+        mathSymbolsKey.clear();
+        for (int j = 0; j < ParameterList.size(); j++) {
+            mathSymbols.insert(ParameterList[j]->name);
+            mathSymbolsKey += ParameterList[j]->name + " ";
+        }
+        mathSymbolsKey += "|";
+        for (int j = 0; j < StateVariableList.size(); j++) {
+            mathSymbols.insert(StateVariableList[j]->name);
+            mathSymbolsKey += StateVariableList[j]->name + " ";
+        }
+        mathSymbolsKey += "|";
+        for (int j = 0; j < AliasList.size(); j++) {
+            mathSymbols.insert(AliasList[j]->name);
+            mathSymbolsKey += AliasList[j]->name + " ";
+        }
+        mathSymbolsKey += "|";
+        for (int j = 0; j < AnalogPortList.size(); j++) {
+            mathSymbols.insert(AnalogPortList[j]->name);
+            mathSymbolsKey += AnalogPortList[j]->name + " ";
+        }
+        mathSymbolsKey += "|";
+        for (int j = 0; j < ImpulsePortList.size(); j++) {
+            mathSymbols.insert(ImpulsePortList[j]->name);
+            mathSymbolsKey += ImpulsePortList[j]->name + " ";
+        }
+    }
+    key = mathSymbolsKey;
+    return mathSymbols;
+}
+
 QStringList Component::validateComponent()
 {
     QStringList errs;
@@ -3207,6 +3492,11 @@ QStringList Component::validateComponent()
     this->initial_regime = NULL;
     int failures = 0;
 
+    // the symbols are gathered once for all the equations checked below
+    QString key;
+    getMathSymbols(key);
+    mathSymbolsHeld = true;
+
     for(int i=0; i<RegimeList.size(); i++)
     {
         failures += RegimeList[i]->validateRegime(this, &errs);
@@ -3235,6 +3525,8 @@ QStringList Component::validateComponent()
         }
     }
 
+    mathSymbolsHeld = false;
+
     errs.push_back("Total errors: " + QString::number(float(failures)));
 
     return errs;
@@ -3624,18 +3916,21 @@ void ComponentInstance::migrateComponent(QSharedPointer<Component> newComponent)
     // clear parameter list ready for refilling
     this->ParameterList.clear();
 
+    // the old values by name, so that an instance of a component with many
+    // properties is not searched once for each of them
+    QHash <QString, int> oldPars;
+    for (int j = oldParList.size()-1; j >= 0; --j) {
+        oldPars.insert(oldParList[j]->name, j);
+    }
+
     // add new list - copying across as needed
     for (int i = 0; i < newComponent->ParameterList.size(); ++i) {
-        bool inNew = false;
-        for (int j = 0; j < oldParList.size(); ++j) {
-            if (newComponent->ParameterList[i]->name == oldParList[j]->name) {
-                this->ParameterList.push_back(new ParameterInstance(oldParList[j]));
-                // but may change dims!
-                this->ParameterList.back()->dims->fromString(newComponent->ParameterList[i]->dims->toString());
-                inNew = true;
-            }
-        }
-        if (!inNew) {
+        QHash <QString, int>::const_iterator old = oldPars.constFind(newComponent->ParameterList[i]->name);
+        if (old != oldPars.constEnd()) {
+            this->ParameterList.push_back(new ParameterInstance(oldParList[*old]));
+            // but may change dims!
+            this->ParameterList.back()->dims->fromString(newComponent->ParameterList[i]->dims->toString());
+        } else {
             ParameterList.push_back(new ParameterInstance(newComponent->ParameterList[i]));
         }
     }
@@ -3646,18 +3941,19 @@ void ComponentInstance::migrateComponent(QSharedPointer<Component> newComponent)
     // clear sv list ready for refilling
     this->StateVariableList.clear();
 
+    QHash <QString, int> oldSVs;
+    for (int j = oldSVList.size()-1; j >= 0; --j) {
+        oldSVs.insert(oldSVList[j]->name, j);
+    }
+
     // add new list - copying across as needed
     for (int i = 0; i < newComponent->StateVariableList.size(); ++i) {
-        bool inNew = false;
-        for (int j = 0; j < oldSVList.size(); ++j) {
-            if (newComponent->StateVariableList[i]->name == oldSVList[j]->name) {
-                this->StateVariableList.push_back(new StateVariableInstance(oldSVList[j]));
-                // but may change dims!
-                this->StateVariableList.back()->dims->fromString(newComponent->StateVariableList[i]->dims->toString());
-                inNew = true;
-            }
-        }
-        if (!inNew) {
+        QHash <QString, int>::const_iterator old = oldSVs.constFind(newComponent->StateVariableList[i]->name);
+        if (old != oldSVs.constEnd()) {
+            this->StateVariableList.push_back(new StateVariableInstance(oldSVList[*old]));
+            // but may change dims!
+            this->StateVariableList.back()->dims->fromString(newComponent->StateVariableList[i]->dims->toString());
+        } else {
             StateVariableList.push_back(new StateVariableInstance(newComponent->StateVariableList[i]));
         }
     }
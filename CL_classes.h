@@ -34,6 +34,13 @@
 // inline into the XML.
 #define MIN_CONNS_TO_FORCE_BINARY 30
 
+// Number of index-value pairs moved per read or write when explicit
+// list data are loaded from or saved to a binary file.
+#define EXPLICIT_DATA_BLOCK_ELEMENTS 65536
+
+// Number of bins in the histogram of explicitValueStatistics.
+#define EXPLICIT_STATS_BINS 64
+
 using namespace std;
 
 typedef enum
@@ -135,6 +142,10 @@ public:
     void reset();
 
     friend bool operator==(dim &dim1, dim &dim2);
+
+private:
+    // what fromString does for strings it has not seen
+    void parseString(QString);
 };
 
 /**************************** Linked items *****************************/
@@ -222,7 +233,7 @@ public:
     Parameter(){dims = new dim("?");}
     virtual ~Parameter(){delete dims;}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_PARAMETER;}
 
     /*!
@@ -260,7 +271,7 @@ public:
     ParameterInstance(QString dimString){dims = new dim(dimString);}
     ~ParameterInstance(){delete dims;}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     /*!
      * \brief writeExplicitListNodeData
      * \param xmlOut
@@ -277,6 +288,73 @@ public:
      * and State Variables, either as XML lists or binary data
      */
     void readExplicitListNodeData(QDomNode &n);
+    /*!
+     * Start choosing names for new explicitDataBinaryFiles from
+     * explicitDataBinaryFile0.bin again. Called at the start of each
+     * save, so that one save probes each existing name only once.
+     */
+    static void restartFileNames(void);
+    /*!
+     * True if indices are exactly 0..value.size()-1, so that value[i]
+     * is the value for index i.
+     */
+    bool isDense(void) const;
+    /*!
+     * Make this a list covering indices 0..vals.size()-1, taking its
+     * values from vals.
+     */
+    void setDenseValues(const QVector<double>& vals);
+};
+
+/*!
+ * \brief The explicitValueLookup class gives constant-time access to the
+ * value an explicit list ParameterInstance holds for a given index.
+ *
+ * A list covering every index in order is read straight from its value
+ * vector. Any other list is indexed once, when the lookup is made. The
+ * lookup must not outlive changes to the ParameterInstance.
+ */
+class explicitValueLookup
+{
+public:
+    explicitValueLookup(const ParameterInstance* par);
+    /*!
+     * The value for index, or fallback if the list has none.
+     */
+    double at(int index, double fallback = 0.0) const;
+    bool contains(int index) const;
+private:
+    const double* values;
+    int count;
+    /*!
+     * For sparse lists, the position in values of each index, or -1.
+     * Empty when the list is dense.
+     */
+    QVector<int> position;
+};
+
+/*!
+ * \brief The explicitValueStatistics class summarises the values of an
+ * explicit list ParameterInstance: their range, mean and a histogram over
+ * the range. The values are scanned in blocks on a thread pool, and the
+ * partial results of the blocks are then combined.
+ */
+class explicitValueStatistics
+{
+public:
+    explicitValueStatistics();
+    void compute(const ParameterInstance* par, int numBins = EXPLICIT_STATS_BINS);
+    /*!
+     * v scaled from 0 at min to 1 at max, or 1 if the values are all
+     * the same.
+     */
+    double normalised(double v) const;
+
+    int count;
+    double min;
+    double max;
+    double mean;
+    QVector<int> histogram;
 };
 
 /*!
@@ -297,7 +375,7 @@ public:
     Port(){dims = new dim("?"); isPost = false;}
     virtual ~Port(){delete dims;}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual bool isAnalog();
     bool isPost;
 signals:
@@ -317,7 +395,7 @@ public:
     AnalogPort() : Port() {variable=NULL; op = ReduceOperationAddition; isPerConn = false;}
     virtual ~AnalogPort(){}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     bool isAnalog();
     virtual ComponentObjectType Type(){return COMPONENT_ANALOG_PORT;}
     int validateAnalogPort(Component *component, QStringList *);
@@ -335,7 +413,7 @@ public:
     EventPort() : Port() {mode=EventSendPort;}
     virtual ~EventPort(){}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     bool isAnalog();
     virtual ComponentObjectType Type(){return COMPONENT_EVENT_PORT;}
 };
@@ -352,7 +430,7 @@ public:
     ImpulsePort() : Port() {parameter=NULL; mode=ImpulseSendPort;}
     virtual ~ImpulsePort(){}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     bool isAnalog();
     virtual ComponentObjectType Type(){return COMPONENT_IMPULSE_PORT;}
     int validateImpulsePort(Component *component, QStringList *);
@@ -367,13 +445,13 @@ class MathInLine: public ComponentModelObject
 public:
     QString equation;
     MathInLine(MathInLine *data);
-    MathInLine(){}
+    MathInLine(){bracketsMatch = true;}
     virtual ~MathInLine(){}
     QString getHTMLSafeEquation();
     int validateMathInLine(Component *component, QStringList * errs);
     int validateMathInLine(NineMLLayout * component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_MATHINLINE;}
 
 private:
@@ -384,6 +462,16 @@ private:
      * will validate.
      */
     void validateMathSetup(QString& testequation, QStringList& FuncList);
+
+    // the tokens of the equation, and those not recognised when it was last
+    // checked against a component's symbols, so that revalidating an
+    // unchanged equation in an unchanged component needs no lookups
+    QString tokenisedEquation;
+    QStringList tokens;
+    QString checkedEquation;
+    QString checkedSymbols;
+    QStringList unrecognisedTokens;
+    bool bracketsMatch;
 };
 
 /*!
@@ -398,7 +486,7 @@ public:
     virtual ~Trigger();
     int validateTrigger(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_TRIGGER;}
 };
 
@@ -413,7 +501,7 @@ public:
     StateVariable() : Parameter() {}
     virtual ~StateVariable();
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_STATE_VARIABLE;}
 };
 
@@ -431,7 +519,7 @@ public:
     //StateVariableData(){}
     virtual ~StateVariableInstance(){}
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
 };
 
 
@@ -450,7 +538,7 @@ public:
     int validateAlias(Component *component, QStringList * errs);
     int validateAlias(NineMLLayout *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_ALIAS;}
 };
 
@@ -471,7 +559,7 @@ public:
     virtual ~TimeDerivative();
     int validateTimeDerivative(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_TIME_DERIVATIVE;}
 };
 
@@ -493,7 +581,7 @@ public:
     int validateStateAssignment(Component *component, QStringList *);
     int validateStateAssignment(NineMLLayout *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_STATE_ASSIGNMENT;}
 };
 
@@ -512,7 +600,7 @@ public:
     virtual ~EventOut(){}
     int validateEventOut(Component *component, QStringList *);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_EVENT_OUT;}
 };
 
@@ -531,7 +619,7 @@ public:
     virtual ~ImpulseOut(){}
     int validateImpulseOut(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_IMPULSE_OUT;}
 };
 
@@ -555,7 +643,7 @@ public:
     virtual ~OnCondition();
     int validateOnCondition(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_ON_CONDITION;}
 };
 
@@ -580,7 +668,7 @@ public:
     virtual ~OnEvent();
     int validateOnEvent(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_ON_EVENT;}
 };
 
@@ -606,7 +694,7 @@ public:
     virtual ~OnImpulse();
     int validateOnImpulse(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_ON_IMPULSE;}
 };
 
@@ -627,7 +715,7 @@ public:
     virtual ~Regime();
     int validateRegime(Component *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT_REGIME;}
 };
 
@@ -659,11 +747,33 @@ public:
     void updateFrom(QSharedPointer<Component>data);
     QStringList validateComponent();
     void load(QDomDocument *doc);
-    void write(QDomDocument *doc);
+    /*!
+     * Validate the component and, if it is valid, write it out.
+     */
+    void write(QXmlStreamWriter &xmlOut);
+    /*!
+     * The two halves of write(). validateForWrite() reports any errors
+     * to the user, so is called on the GUI thread; writeXML() only reads
+     * the component, so may then be called on another.
+     */
+    bool validateForWrite();
+    void writeXML(QXmlStreamWriter &xmlOut);
     virtual ComponentObjectType Type(){return COMPONENT;}
     QUndoStack undoStack;
     QSharedPointer<Component> editedVersion;
     QString getXMLName();
+
+    /*!
+     * The names which the equations of this component may use, and in key
+     * a string which differs whenever they do. Built once for all the
+     * equations checked by validateComponent, and on each call otherwise.
+     */
+    const QSet < QString > & getMathSymbols(QString &key);
+
+private:
+    QSet < QString > mathSymbols;
+    QString mathSymbolsKey;
+    bool mathSymbolsHeld;
 };
 
 
@@ -702,7 +812,7 @@ public:
     QSharedPointer<Component> component;
     ComponentInstance(QSharedPointer<Component>data);
     ComponentInstance(QSharedPointer <ComponentInstance>data, bool copy_io = false);
-    void remapPointers(QMap <systemObject *, QSharedPointer <systemObject> > pointerMap);
+    void remapPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &pointerMap);
     void copyFrom(QSharedPointer <ComponentInstance>, QSharedPointer<Component>, QSharedPointer<ComponentInstance> thisSharedPointer);
     ComponentInstance& operator=(const ComponentInstance& data);
     ComponentInstance(){}
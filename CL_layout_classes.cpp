@@ -23,6 +23,15 @@
 ****************************************************************************/
 
 #include "CL_layout_classes.h"
+#include <QCryptographicHash>
+#include <algorithm>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include "SC_profiler.h"
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QStandardPaths>
+#endif
 
 NineMLLayout::NineMLLayout(QSharedPointer<NineMLLayout>data)
 {
@@ -251,7 +260,13 @@ void NineMLLayout::load(QDomDocument *doc)
     }
 }
 
-void NineMLLayout::write(QDomDocument *doc)
+void NineMLLayout::write(QXmlStreamWriter &xmlOut)
+{
+    this->validateForWrite();
+    this->writeXML(xmlOut);
+}
+
+bool NineMLLayout::validateForWrite()
 {
     // validate this
     QStringList validated = validateComponent();
@@ -265,39 +280,44 @@ void NineMLLayout::write(QDomDocument *doc)
         msgBox.exec();
     }
 
+    // a layout is written out even if it does not validate
+    return true;
+}
+
+void NineMLLayout::writeXML(QXmlStreamWriter &xmlOut)
+{
     // write out:
 
     // create the root of the file:
-    QDomElement root = doc->createElement( "SpineML" );
-    QDomProcessingInstruction xmlDeclaration = doc->createProcessingInstruction("xml", "version=\"1.0\"");
-    doc->appendChild(xmlDeclaration);
-    doc->appendChild( root );
-    root.setAttribute("xmlns", "http://nineml.org/9ML/0.1");
+    xmlOut.writeStartDocument();
+    xmlOut.writeStartElement("SpineML");
+    xmlOut.writeAttribute("xmlns", "http://nineml.org/9ML/0.1");
 
-    QDomElement CClass = doc->createElement( "LayoutClass" );
-    CClass.setAttribute("name", this->name);
-    //CClass.setAttribute("type", this->type);
-    root.appendChild(CClass);
+    xmlOut.writeStartElement("LayoutClass");
+    xmlOut.writeAttribute("name", this->name);
+    //xmlOut.writeAttribute("type", this->type);
 
     // declarations
     for (int i = 0; i < this->ParameterList.size(); ++i) {
-        ParameterList[i]->writeOut(doc, CClass);
+        ParameterList[i]->writeOut(xmlOut);
     }
 
-    QDomElement space = doc->createElement( "Spatial" );
-    CClass.appendChild(space);
+    xmlOut.writeStartElement("Spatial");
 
     // space
     for (int i = 0; i < this->RegimeList.size(); ++i) {
-        RegimeList[i]->writeOut(doc, space);
+        RegimeList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->AliasList.size(); ++i) {
-        AliasList[i]->writeOut(doc, space);
+        AliasList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->StateVariableList.size(); ++i) {
-        StateVariableList[i]->writeOut(doc, space);
+        StateVariableList[i]->writeOut(xmlOut);
     }
 
+    xmlOut.writeEndElement(); // Spatial
+    xmlOut.writeEndElement(); // LayoutClass
+    xmlOut.writeEndDocument();
 }
 
 QStringList NineMLLayout::validateComponent()
@@ -450,7 +470,210 @@ void rotateAxes(axisType axis, float angle, float x[3], float y[3], float z[3])
 }
 
 
+// uniform grid used to test the minimum distance constraint against nearby
+// locations only; cells are minimumDistance wide so any location closer than
+// that lies in one of the 27 cells around the candidate
+struct layoutGridCell {
+    int x;
+    int y;
+    int z;
+    bool operator==(const layoutGridCell &other) const {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+inline uint qHash(const layoutGridCell &cell) {
+    return uint(cell.x) * 73856093u ^ uint(cell.y) * 19349663u ^ uint(cell.z) * 83492791u;
+}
+
+static layoutGridCell layoutGridCellFor(const loc &l, double cellSize) {
+    layoutGridCell cell;
+    cell.x = (int) floor(l.x / cellSize);
+    cell.y = (int) floor(l.y / cellSize);
+    cell.z = (int) floor(l.z / cellSize);
+    return cell;
+}
+
+/*!
+ * Hash everything the generated locations depend on - the component's
+ * maths, the state variable and parameter values, the seed, the minimum
+ * distance and the number of neurons - so that an unchanged layout can be
+ * served from the cache.
+ */
+QByteArray NineMLLayoutData::getLayoutKey(int numNeurons)
+{
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+
+    stream << (quint64) (quintptr) this->component.data() << this->component->name;
+    this->streamLayoutInputs(stream, numNeurons);
+
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+}
+
+void NineMLLayoutData::streamLayoutInputs(QDataStream &stream, int numNeurons)
+{
+    stream << (qint32) this->seed << this->minimumDistance << (qint32) numNeurons;
+
+    for (int i = 0; i < this->StateVariableList.size(); ++i) {
+        stream << StateVariableList[i]->name << StateVariableList[i]->value;
+    }
+    for (int i = 0; i < this->ParameterList.size(); ++i) {
+        stream << ParameterList[i]->name << ParameterList[i]->value;
+    }
+    for (int i = 0; i < this->component->AliasList.size(); ++i) {
+        stream << this->component->AliasList[i]->name << this->component->AliasList[i]->maths->equation;
+    }
+    for (int r = 0; r < this->component->RegimeList.size(); ++r) {
+        RegimeSpace * regime = this->component->RegimeList[r];
+        for (int i = 0; i < regime->TransformList.size(); ++i) {
+            Transform * tr = regime->TransformList[i];
+            stream << (qint32) tr->order << (qint32) tr->type << tr->maths->equation;
+            stream << tr->variableName;
+        }
+    }
+}
+
+/*!
+ * As getLayoutKey, but with the whole of the component as written out in
+ * place of its address, so that the same layout has the same key in the
+ * next session, or another project.
+ */
+QByteArray NineMLLayoutData::getFileKey(int numNeurons)
+{
+    if (numNeurons < LAYOUT_FILE_MIN_NEURONS || this->component->name == "none") {
+        return QByteArray();
+    }
+
+    QByteArray componentXml;
+    QXmlStreamWriter xmlOut(&componentXml);
+    this->component->writeXML(xmlOut);
+
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << componentXml;
+    this->streamLayoutInputs(stream, numNeurons);
+
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+}
+
+QString NineMLLayoutData::getLocationsFileName(const QByteArray &fileKey)
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    QDir lib_dir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+    QDir lib_dir = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+    return lib_dir.absoluteFilePath(QString(LAYOUT_FILE_DIR) + "/" + QString(fileKey.toHex()) + ".loc");
+}
+
+bool NineMLLayoutData::loadLocations(const QByteArray &fileKey, int numNeurons, QVector <loc> *locations)
+{
+    PROFILE_SCOPE("NineMLLayoutData::loadLocations");
+    QFile f(getLocationsFileName(fileKey));
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // the name holds the key, but the file may be cut short or be of an
+    // older version
+    layoutFileHeader h;
+    bool ok = f.read((char *) &h, sizeof(h)) == (qint64) sizeof(h)
+        && memcmp(h.magic, LAYOUT_FILE_MAGIC, 4) == 0
+        && h.version == LAYOUT_FILE_VERSION
+        && fileKey.size() == (int) sizeof(h.key)
+        && memcmp(h.key, fileKey.constData(), sizeof(h.key)) == 0
+        && h.count == numNeurons
+        && f.size() == (qint64) sizeof(h) + (qint64) h.count * (qint64) sizeof(loc);
+    if (ok) {
+        QVector <loc> read(h.count);
+        qint64 bytes = (qint64) h.count * (qint64) sizeof(loc);
+        ok = f.read((char *) read.data(), bytes) == bytes;
+        if (ok) {
+            *locations = read;
+        }
+    }
+    f.close();
+    return ok;
+}
+
+void NineMLLayoutData::saveLocations(const QByteArray &fileKey, const QVector <loc> &locations)
+{
+    PROFILE_SCOPE("NineMLLayoutData::saveLocations");
+    QString fileName = getLocationsFileName(fileKey);
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) {
+        return;
+    }
+
+    // written under a name of its own and then moved into place, so that a
+    // file being read, or written for the same layout by another job, is
+    // never seen half written
+    QFile f(fileName + "." + QString::number((quint64) (quintptr) QThread::currentThreadId()) + ".part");
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    layoutFileHeader h;
+    memcpy(h.magic, LAYOUT_FILE_MAGIC, 4);
+    h.version = LAYOUT_FILE_VERSION;
+    memcpy(h.key, fileKey.constData(), qMin((int) sizeof(h.key), fileKey.size()));
+    h.count = locations.size();
+    h.reserved = 0;
+    qint64 bytes = (qint64) locations.size() * (qint64) sizeof(loc);
+    bool ok = f.write((const char *) &h, sizeof(h)) == (qint64) sizeof(h)
+        && f.write((const char *) locations.constData(), bytes) == bytes;
+    f.close();
+    if (ok) {
+        QFile::remove(fileName);
+        ok = f.rename(fileName);
+    }
+    if (!ok) {
+        f.remove();
+    }
+}
+
 void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet) {
+    PROFILE_SCOPE("NineMLLayoutData::generateLayout");
+
+    QByteArray key = this->getLayoutKey(numNeurons);
+
+    if (!this->cachedLayoutKey.isEmpty() && key == this->cachedLayoutKey) {
+        // implicitly shared, so this does not copy the locations
+        *locations = this->cachedLayout;
+        return;
+    }
+
+    // kept from an earlier session
+    QByteArray fileKey = this->getFileKey(numNeurons);
+    if (!fileKey.isEmpty() && loadLocations(fileKey, numNeurons, locations)) {
+        this->cachedLayoutKey = key;
+        this->cachedLayout = *locations;
+        return;
+    }
+
+    QString err;
+    this->generateLayoutUncached(numNeurons, locations, err);
+
+    if (err.isEmpty()) {
+        this->cachedLayoutKey = key;
+        this->cachedLayout = *locations;
+        if (!fileKey.isEmpty()) {
+            saveLocations(fileKey, *locations);
+        }
+    } else {
+        errRet = err;
+        this->cachedLayoutKey.clear();
+        this->cachedLayout.clear();
+    }
+}
+
+namespace {
+    // rand() is shared by the whole process, so the layouts which draw from
+    // it (only those with maths the compiler leaves to interpretMaths) are
+    // generated one at a time, to stay repeatable
+    QMutex sequentialLayoutLock;
+}
+
+void NineMLLayoutData::generateLayoutUncached(int numNeurons, QVector <loc> *locations, QString &errRet, bool threaded, layoutSink * sink) {
 
     float result = 0;
 
@@ -471,6 +694,9 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
             locations->push_back(newLoc);
 
         }
+        if (sink) {
+            sink->addLocations(locations->constData(), locations->size());
+        }
 
         return;
 
@@ -521,13 +747,14 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
 
         }
 
-        // create stacks:
-        vector < vector < valop > > trstacks;
+        // create stacks and compile them once, so the per-neuron loop below
+        // does not rebuild or copy them:
+        vector < compiledMaths > trstacks(order.size());
         for (int trans = 0; trans < order.size(); ++trans) {
             QString err;
             vector < valop > newStack;
-            trstacks.push_back(newStack);
-            err = createStack(regime->TransformList[order[trans]]->maths->equation, varList, &trstacks.back());
+            err = createStack(regime->TransformList[order[trans]]->maths->equation, varList, &newStack);
+            trstacks[trans].compile(newStack);
 
             // if error doing maths...
             if (err != "") {
@@ -539,12 +766,12 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
                 return;
            }
         }
-        vector < vector < valop > > alstacks;
+        vector < compiledMaths > alstacks(this->component->AliasList.size());
         for (int j = 0; j < this->component->AliasList.size(); ++j) {
             QString err;
             vector < valop > newStack;
-            alstacks.push_back(newStack);
-            err = createStack(this->component->AliasList[j]->maths->equation, varList, &alstacks.back());
+            err = createStack(this->component->AliasList[j]->maths->equation, varList, &newStack);
+            alstacks[j].compile(newStack);
 
             // if error doing maths...
             if (err != "") {
@@ -557,20 +784,186 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
            }
         }
 
-        srand(this->seed);
+        int numSV = this->StateVariableList.size();
+
+        // state variable written by each transform, and those holding the location
+        vector < int > trTarget(order.size(), -1);
+        for (int trans = 0; trans < order.size(); ++trans) {
+            if (regime->TransformList[order[trans]]->type == TRANSLATE) {
+                for (int j = 0; j < numSV; ++j) {
+                    if (varList[j].name == regime->TransformList[order[trans]]->variable->name) {
+                        trTarget[trans] = j;
+                    }
+                }
+            }
+        }
+        int xInd = -1, yInd = -1, zInd = -1;
+        for (int sv = 0; sv < numSV; ++sv) {
+            if (varList[sv].name == "x") xInd = sv;
+            if (varList[sv].name == "y") yInd = sv;
+            if (varList[sv].name == "z") zInd = sv;
+        }
+
+        // without a distance constraint, if no alias or transform reads a value
+        // left over from the previous neuron then each neuron is independent and
+        // the layout can be generated in parallel
+        bool independent = this->minimumDistance <= 0;
+        vector < bool > written(varList.size(), false);
+        vector < bool > fresh(varList.size(), false);
+        for (int j = 0; j < (int) alstacks.size(); ++j) {
+            written[numSV+j] = true;
+        }
+        for (int trans = 0; trans < (int) trTarget.size(); ++trans) {
+            if (trTarget[trans] >= 0) written[trTarget[trans]] = true;
+        }
+        for (int j = 0; j < (int) alstacks.size() && independent; ++j) {
+            if (!alstacks[j].isCompiled()) independent = false;
+            for (int k = 0; k < (int) varList.size(); ++k) {
+                if (written[k] && !fresh[k] && alstacks[j].reads(&(varList[k].value))) independent = false;
+            }
+            fresh[numSV+j] = true;
+        }
+        for (int trans = 0; trans < (int) trstacks.size() && independent; ++trans) {
+            if (!trstacks[trans].isCompiled()) independent = false;
+            for (int k = 0; k < (int) varList.size(); ++k) {
+                if (written[k] && !fresh[k] && trstacks[trans].reads(&(varList[k].value))) independent = false;
+            }
+            if (trTarget[trans] >= 0) fresh[trTarget[trans]] = true;
+        }
+
+        if (independent) {
+
+            locations->resize(numNeurons);
+            loc * out = locations->data();
+            quint32 seed = (quint32) this->seed;
+            int numVars = (int) varList.size();
+            int numBlocks = (numNeurons + MATHS_BLOCK_SIZE - 1) / MATHS_BLOCK_SIZE;
+
+            // streamed, the blocks are done a run at a time, in order
+            int runBlocks = sink ? LAYOUT_STREAM_FIRST_ROWS / MATHS_BLOCK_SIZE : numBlocks;
+            for (int firstBlock = 0; firstBlock < numBlocks; firstBlock += runBlocks) {
+                int endBlock = qMin(numBlocks, firstBlock + runBlocks);
+
+#pragma omp parallel if(threaded)
+                {
+                    // each thread evaluates blocks of neurons against its own copy
+                    // of the variables, held a block of values per variable
+                    vector < compiledMaths > threadAl = alstacks;
+                    vector < compiledMaths > threadTr = trstacks;
+                    for (uint j = 0; j < threadAl.size(); ++j) {
+                        threadAl[j].bindBlock(varList);
+                    }
+                    for (uint trans = 0; trans < threadTr.size(); ++trans) {
+                        threadTr[trans].bindBlock(varList);
+                    }
+                    vector < float > vars(numVars * MATHS_BLOCK_SIZE);
+                    vector < float > trResult(MATHS_BLOCK_SIZE);
+                    counterRandom rngs[MATHS_BLOCK_SIZE];
+
+#pragma omp for schedule(static)
+                    for (int b = firstBlock; b < endBlock; ++b) {
+
+                        int first = b * MATHS_BLOCK_SIZE;
+                        int n = qMin(MATHS_BLOCK_SIZE, numNeurons - first);
+
+                        // random numbers are keyed on the neuron index so the
+                        // result does not depend on the number of threads
+                        for (int j = 0; j < n; ++j) {
+                            counterRandom rng = {seed, (quint32) (first + j), 0};
+                            rngs[j] = rng;
+                        }
+                        // nothing is read before it is written for this neuron,
+                        // so every neuron starts from the initial values
+                        for (int k = 0; k < numVars; ++k) {
+                            std::fill(&vars[k * MATHS_BLOCK_SIZE], &vars[k * MATHS_BLOCK_SIZE] + n, varList[k].value);
+                        }
+
+                        for (uint j = 0; j < threadAl.size(); ++j) {
+                            threadAl[j].evaluateBlock(&vars[0], n, rngs, &vars[(numSV+j) * MATHS_BLOCK_SIZE]);
+                        }
+                        for (uint trans = 0; trans < threadTr.size(); ++trans) {
+                            threadTr[trans].evaluateBlock(&vars[0], n, rngs, &trResult[0]);
+                            if (trTarget[trans] >= 0) {
+                                std::copy(&trResult[0], &trResult[0] + n, &vars[trTarget[trans] * MATHS_BLOCK_SIZE]);
+                            }
+                        }
+
+                        for (int j = 0; j < n; ++j) {
+                            loc newLoc = {0,0,0};
+                            if (xInd >= 0) newLoc.x = vars[xInd * MATHS_BLOCK_SIZE + j];
+                            if (yInd >= 0) newLoc.y = vars[yInd * MATHS_BLOCK_SIZE + j];
+                            if (zInd >= 0) newLoc.z = vars[zInd * MATHS_BLOCK_SIZE + j];
+                            out[first + j] = newLoc;
+                        }
+                    }
+                }
+
+                if (sink) {
+                    int first = firstBlock * MATHS_BLOCK_SIZE;
+                    int end = qMin(numNeurons, endBlock * MATHS_BLOCK_SIZE);
+                    if (!sink->addLocations(out + first, end - first)) {
+                        errRet = LAYOUT_STOPPED;
+                        locations->clear();
+                        return;
+                    }
+                    runBlocks = qMin(runBlocks * 2, LAYOUT_STREAM_MAX_ROWS / MATHS_BLOCK_SIZE);
+                }
+            }
+
+            return;
+        }
+
+        // random numbers are keyed on the neuron index, and counted over
+        // the attempts at it, as in the parallel case
+        counterRandom rng = {(quint32) this->seed, 0, 0};
+        bool usesRand = false;
+        for (uint j = 0; j < alstacks.size(); ++j) {
+            usesRand = usesRand || !alstacks[j].isCompiled();
+        }
+        for (uint trans = 0; trans < trstacks.size(); ++trans) {
+            usesRand = usesRand || !trstacks[trans].isCompiled();
+        }
+        QMutexLocker randLocker(&sequentialLayoutLock);
+        if (usesRand) {
+            srand(this->seed);
+        } else {
+            randLocker.unlock();
+        }
 
         int loop = 0;
+        int rejected = 0;
+
+        // spatial index of accepted locations for the distance constraint
+        QHash < layoutGridCell, QVector <int> > grid;
+        double minDistSq = this->minimumDistance * this->minimumDistance;
+
+        // only the state variables carry over between neurons
+        vector < float > varListBack(StateVariableList.size());
+
+        // the locations passed to the sink so far, and when to next
+        int streamed = 0;
+        int streamRun = LAYOUT_STREAM_FIRST_ROWS;
 
         for (int i = 0; i < (int) numNeurons; ++i) {
 
             if (loop > 1000) {
-                errRet = "Cannot satisfy distance constraint";
+                errRet = "Cannot satisfy distance constraint (" + QString::number(rejected) + " locations rejected)";
                 locations->clear();
                 return;
             }
 
+            // a neuron tried again carries on from its last draw
+            if (rng.index != (quint32) i) {
+                rng.index = (quint32) i;
+                rng.counter = 0;
+            }
+
             // back up the variables in case we infringe minimum distance
-            vector < lookup > varListBack = varList;
+            if (this->minimumDistance > 0) {
+                for (int sv = 0; sv < this->StateVariableList.size(); ++sv) {
+                    varListBack[sv] = varList[sv].value;
+                }
+            }
 
             // do aliases:
             for (int j = 0; j < this->component->AliasList.size(); ++j) {
@@ -581,7 +974,7 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
 
                 //currAlias = this->component->AliasList[j];
 
-                result = interpretMaths(alstacks[j]);
+                result = alstacks[j].evaluate(&rng);
 
                 // assign back to the Alias:
                 varList[StateVariableList.size()+j].value = result;
@@ -591,7 +984,7 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
             // do translations
             for (int trans = 0; trans < order.size(); ++trans) {
 
-                result = interpretMaths(trstacks[trans]);
+                result = trstacks[trans].evaluate(&rng);
 
                 // assign result to the given statevariable
                 if (regime->TransformList[order[trans]]->type == TRANSLATE) {
@@ -623,28 +1016,177 @@ void NineMLLayoutData::generateLayout(int numNeurons, QVector <loc> *locations,
 
                 bool tooClose = false;
 
-                for (int l = 0; l < locations->size(); ++l) {
-                    if (pow((*locations)[l].x - newLoc.x,2) + pow((*locations)[l].y - newLoc.y, 2) + pow((*locations)[l].z - newLoc.z,2) < pow(this->minimumDistance,2)) {
-                        tooClose = true;
-                        break;
+                layoutGridCell cell = layoutGridCellFor(newLoc, this->minimumDistance);
+
+                for (int cx = cell.x - 1; cx <= cell.x + 1 && !tooClose; ++cx) {
+                    for (int cy = cell.y - 1; cy <= cell.y + 1 && !tooClose; ++cy) {
+                        for (int cz = cell.z - 1; cz <= cell.z + 1 && !tooClose; ++cz) {
+                            layoutGridCell nearCell = {cx, cy, cz};
+                            QHash < layoutGridCell, QVector <int> >::const_iterator it = grid.constFind(nearCell);
+                            if (it == grid.constEnd()) {
+                                continue;
+                            }
+                            const QVector <int> &nearLocs = it.value();
+                            for (int n = 0; n < nearLocs.size(); ++n) {
+                                const loc &l = (*locations)[nearLocs[n]];
+                                double dx = l.x - newLoc.x;
+                                double dy = l.y - newLoc.y;
+                                double dz = l.z - newLoc.z;
+                                if (dx*dx + dy*dy + dz*dz < minDistSq) {
+                                    tooClose = true;
+                                    break;
+                                }
+                            }
+                        }
                     }
                 }
                 if (!tooClose) {
+                    grid[cell].push_back(locations->size());
                     locations->push_back(newLoc);
                     loop = 0;
                 } else {
                     // do this iteration again!
                     --i;
-                    varList = varListBack;
+                    for (int sv = 0; sv < this->StateVariableList.size(); ++sv) {
+                        varList[sv].value = varListBack[sv];
+                    }
                     ++loop;
+                    ++rejected;
                 }
             } else
                 locations->push_back(newLoc);
 
+            if (sink && (locations->size() - streamed >= streamRun || locations->size() == numNeurons)
+                && locations->size() > streamed) {
+                if (!sink->addLocations(locations->constData() + streamed, locations->size() - streamed)) {
+                    errRet = LAYOUT_STOPPED;
+                    locations->clear();
+                    return;
+                }
+                streamed = locations->size();
+                streamRun = qMin(streamRun * 2, LAYOUT_STREAM_MAX_ROWS);
+            }
+
+        }
+    }
+
+
+}
+
+layoutJob::layoutJob(QSharedPointer<NineMLLayoutData> layout, int numNeurons) :
+    state(Pending),
+    shared(false),
+    layout(layout),
+    snapshot((NineMLLayoutData *) 0),
+    numNeurons(numNeurons)
+{
+    this->key = layout->getLayoutKey(numNeurons);
+    if (!layout->cachedLayoutKey.isEmpty() && this->key == layout->cachedLayoutKey) {
+        this->result = layout->cachedLayout;
+        this->state = Done;
+    } else {
+        // the layout may be edited while the job runs
+        this->snapshot = new NineMLLayoutData(layout);
+        this->fileKey = layout->getFileKey(numNeurons);
+    }
+}
+
+QSharedPointer<layoutJob> layoutJob::create(QSharedPointer<NineMLLayoutData> layout, int numNeurons)
+{
+    return QSharedPointer<layoutJob> (new layoutJob(layout, numNeurons), &QObject::deleteLater);
+}
+
+layoutJob::~layoutJob()
+{
+    if (this->snapshot) {
+        for (int i = 0; i < this->snapshot->StateVariableList.size(); ++i) {
+            delete this->snapshot->StateVariableList[i];
+        }
+        for (int i = 0; i < this->snapshot->ParameterList.size(); ++i) {
+            delete this->snapshot->ParameterList[i];
+        }
+        delete this->snapshot;
+    }
+}
+
+bool layoutJob::isDone()
+{
+    QMutexLocker locker(&this->lock);
+    return this->state == Done;
+}
+
+void layoutJob::runIfPending()
+{
+    QMutexLocker locker(&this->lock);
+    if (this->state != Pending) {
+        return;
+    }
+    this->state = Running;
+    locker.unlock();
+    PROFILE_SCOPE("layoutJob::run");
+    QVector < loc > locs;
+    QString errs;
+    if (this->fileKey.isEmpty() || !NineMLLayoutData::loadLocations(this->fileKey, this->numNeurons, &locs)) {
+        this->snapshot->generateLayoutUncached(this->numNeurons, &locs, errs, !this->shared);
+        if (errs.isEmpty() && !this->fileKey.isEmpty()) {
+            NineMLLayoutData::saveLocations(this->fileKey, locs);
         }
     }
+    locker.relock();
+    this->result = locs;
+    this->err = errs;
+    this->state = Done;
+    this->finished.wakeAll();
+    locker.unlock();
+    emit done();
+}
 
+void layoutJob::collect(QVector <loc> *locations, QString &errRet)
+{
+    this->runIfPending();
+    QMutexLocker locker(&this->lock);
+    while (this->state != Done) {
+        this->finished.wait(&this->lock);
+    }
+    *locations = this->result;
+    if (this->err.isEmpty()) {
+        this->layout->cachedLayoutKey = this->key;
+        this->layout->cachedLayout = this->result;
+    } else {
+        errRet = this->err;
+        this->layout->cachedLayoutKey.clear();
+        this->layout->cachedLayout.clear();
+    }
+}
+
+namespace {
+    class layoutJobRunner : public QRunnable
+    {
+    public:
+        layoutJobRunner(QSharedPointer<layoutJob> job) : job(job) {}
+        void run() {
+            this->job->runIfPending();
+        }
+    private:
+        QSharedPointer<layoutJob> job;
+    };
+}
 
+void layoutJob::startInBackground(const QVector < QSharedPointer<layoutJob> > &jobs)
+{
+    int pending = 0;
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (!jobs[i]->isDone()) {
+            ++pending;
+        }
+    }
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (!jobs[i]->isDone()) {
+            jobs[i]->shared = pending > 1;
+            // the pool deletes the runner when it is done
+            QThreadPool::globalInstance()->start(new layoutJobRunner(jobs[i]));
+        }
+    }
 }
 
 void RegimeSpace::readIn(QDomElement e)
@@ -678,21 +1220,21 @@ void RegimeSpace::readIn(QDomElement e)
 
 }
 
-void RegimeSpace::writeOut(QDomDocument *doc, QDomElement &parent)
+void RegimeSpace::writeOut(QXmlStreamWriter &xmlOut)
 {
 
-    QDomElement regime = doc->createElement( "Regime" );
-    regime.setAttribute("name", this->name);
-    parent.appendChild(regime);
+    xmlOut.writeStartElement("Regime");
+    xmlOut.writeAttribute("name", this->name);
 
     // write children
     for (int i = 0; i < this->TransformList.size(); ++i) {
-        this->TransformList[i]->writeOut(doc, regime);
+        this->TransformList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->OnConditionList.size(); ++i) {
-        this->OnConditionList[i]->writeOut(doc, regime);
+        this->OnConditionList[i]->writeOut(xmlOut);
     }
 
+    xmlOut.writeEndElement(); // Regime
 }
 
 RegimeSpace::RegimeSpace(RegimeSpace *data)
@@ -796,21 +1338,21 @@ void OnConditionSpace::readIn(QDomElement e) {
     }
 }
 
-void OnConditionSpace::writeOut(QDomDocument * doc, QDomElement &parent)
+void OnConditionSpace::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement OnCondition = doc->createElement( "OnCondition" );
-    parent.appendChild(OnCondition);
-    OnCondition.setAttribute("target_regime", this->target_regime_name);
+    xmlOut.writeStartElement("OnCondition");
+    xmlOut.writeAttribute("target_regime", this->target_regime_name);
 
     for (int i = 0; i < this->StateAssignList.size(); ++i) {
-        this->StateAssignList[i]->writeOut(doc, OnCondition);
+        this->StateAssignList[i]->writeOut(xmlOut);
     }
     for (int i = 0; i < this->TransformList.size(); ++i) {
-        this->TransformList[i]->writeOut(doc, OnCondition);
+        this->TransformList[i]->writeOut(xmlOut);
     }
 
-    this->trigger->writeOut(doc, OnCondition);
+    this->trigger->writeOut(xmlOut);
 
+    xmlOut.writeEndElement(); // OnCondition
 }
 
 OnConditionSpace::OnConditionSpace(OnConditionSpace *data)
@@ -909,30 +1451,30 @@ void Transform::readIn(QDomElement e)
 
 }
 
-void Transform::writeOut(QDomDocument * doc, QDomElement &parent)
+void Transform::writeOut(QXmlStreamWriter &xmlOut)
 {
-    QDomElement transform = doc->createElement( "Transform" );
-    transform.setAttribute("variable", this->variableName);
-    transform.setAttribute("order", QString::number(this->order));
-    transform.setAttribute("dimension", "??");
+    xmlOut.writeStartElement("Transform");
+    xmlOut.writeAttribute("variable", this->variableName);
+    xmlOut.writeAttribute("order", QString::number(this->order));
+    xmlOut.writeAttribute("dimension", "??");
     switch (this->type) {
     case IDENTITY:
-        transform.setAttribute("type", "identity");
+        xmlOut.writeAttribute("type", "identity");
         break;
     case TRANSLATE:
-        transform.setAttribute("type", "translate");
+        xmlOut.writeAttribute("type", "translate");
         break;
     case ROTATE:
-        transform.setAttribute("type", "rotate");
+        xmlOut.writeAttribute("type", "rotate");
         break;
     case SCALE:
-        transform.setAttribute("type", "scale");
+        xmlOut.writeAttribute("type", "scale");
         break;
     }
 
-    this->maths->writeOut(doc, transform);
+    this->maths->writeOut(xmlOut);
 
-    parent.appendChild(transform);
+    xmlOut.writeEndElement(); // Transform
     // we need dims in here too eventually
 
 }
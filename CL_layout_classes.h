@@ -28,6 +28,8 @@
 // include existing classes
 #include "CL_classes.h"
 #include "SC_layout_cinterpreter.h"
+#include <QMutex>
+#include <QWaitCondition>
 
 enum transformType {
     IDENTITY,
@@ -38,6 +40,51 @@ enum transformType {
 
 class RegimeSpace;
 
+/*!
+ * The first locations of a streamed layout are passed on once this many
+ * are ready, then twice as many each time up to LAYOUT_STREAM_MAX_ROWS.
+ */
+#define LAYOUT_STREAM_FIRST_ROWS 4096
+#define LAYOUT_STREAM_MAX_ROWS 262144
+#define LAYOUT_STOPPED "Stopped"
+
+/*!
+ * The locations of layouts of at least LAYOUT_FILE_MIN_NEURONS neurons are
+ * kept between sessions in files in LAYOUT_FILE_DIR, under the user's data
+ * location, named by the key of what they were generated from. Each is a
+ * layoutFileHeader followed by count float32 x, y, z triples, as a
+ * QVector <loc> holds them, so the file can also be mapped as an array
+ * (numpy.memmap with offset sizeof(layoutFileHeader)).
+ */
+#define LAYOUT_FILE_DIR "layouts"
+#define LAYOUT_FILE_MAGIC "SCLO"
+#define LAYOUT_FILE_VERSION 2
+#define LAYOUT_FILE_MIN_NEURONS 10000
+
+struct layoutFileHeader {
+    char magic[4];
+    quint32 version;
+    // the SHA1 of the component and parameters the locations are from
+    char key[20];
+    qint32 count;
+    quint32 reserved;
+};
+
+/*!
+ * Receives the locations of a layout as they are generated, in order; see
+ * NineMLLayoutData::generateLayoutUncached.
+ */
+class layoutSink
+{
+public:
+    virtual ~layoutSink() {}
+    /*!
+     * Called with each run of count new locations. Return false to stop
+     * the generation.
+     */
+    virtual bool addLocations (const loc * locs, int count) = 0;
+};
+
 class NineMLLayout: public ComponentRootObject
 {
 public:
@@ -54,7 +101,10 @@ public:
     ~NineMLLayout();
     QStringList validateComponent();
     void load(QDomDocument *doc);
-    void write(QDomDocument *doc);
+    void write(QXmlStreamWriter &xmlOut);
+    // as Component::validateForWrite and Component::writeXML
+    bool validateForWrite();
+    void writeXML(QXmlStreamWriter &xmlOut);
     QString getXMLName();
 
 };
@@ -72,7 +122,7 @@ public:
     Transform(){}
     ~Transform();
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
     int validateTransform(NineMLLayout *component, QStringList * errs);
 };
 
@@ -99,7 +149,7 @@ public:
     ~OnConditionSpace();
     int validateOnCondition(NineMLLayout *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
 };
 
 class RegimeSpace {
@@ -112,7 +162,7 @@ public:
     ~RegimeSpace();
     int validateRegime(NineMLLayout *component, QStringList * errs);
     void readIn(QDomElement e);
-    void writeOut(QDomDocument *doc, QDomElement &parent);
+    void writeOut(QXmlStreamWriter &xmlOut);
 };
 
 class NineMLLayoutData : public ComponentRootInstance
@@ -129,6 +179,93 @@ public:
     void import_parameters_from_xml(QDomNode &e);
     void generateLayout(int numNeurons, QVector <loc> *locations, QString &errRet);
     QVector < loc > locations;
+
+private:
+    friend class layoutJob;
+    friend class layoutPreviewJob;
+    QByteArray getLayoutKey(int numNeurons);
+    // the parameters, seed, maths and so on which the locations depend on
+    void streamLayoutInputs(QDataStream &stream, int numNeurons);
+    // the key of the file for the locations, which does not change between
+    // sessions as the key of the cache does; empty if the layout is too
+    // small to be worth a file
+    QByteArray getFileKey(int numNeurons);
+    static QString getLocationsFileName(const QByteArray &fileKey);
+    static bool loadLocations(const QByteArray &fileKey, int numNeurons, QVector <loc> *locations);
+    static void saveLocations(const QByteArray &fileKey, const QVector <loc> &locations);
+    // threaded is false for layouts generated alongside others, which
+    // share the cores between them already. With a sink, the locations are
+    // also passed to it as they are made, and if it stops the generation
+    // errRet is set to LAYOUT_STOPPED and locations is cleared
+    void generateLayoutUncached(int numNeurons, QVector <loc> *locations, QString &errRet, bool threaded = true,
+                                layoutSink * sink = (layoutSink *) 0);
+    // locations from the last successful generateLayout and the key of the
+    // inputs they were generated from
+    QByteArray cachedLayoutKey;
+    QVector < loc > cachedLayout;
+};
+
+/*!
+ * \brief The layoutJob class generates the locations of a layout on the
+ * global thread pool, so that the layouts of many populations are made at
+ * once rather than one after another. The job works from a copy of the
+ * layout taken when it is made, and a layout whose locations are cached
+ * already is done from the start. done() is emitted, from the pool thread,
+ * once the locations are ready.
+ */
+class layoutJob : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * A job for numNeurons locations of layout. It is deleted on the
+     * thread which made it, which the pool may not be.
+     */
+    static QSharedPointer<layoutJob> create(QSharedPointer<NineMLLayoutData> layout, int numNeurons);
+    ~layoutJob();
+
+    bool isDone();
+
+    /*!
+     * Generate the locations on this thread if the job has not been
+     * started, or wait for it if it has. Then, as
+     * NineMLLayoutData::generateLayout, set locations, and errRet if the
+     * layout failed, keeping the locations in the layout's cache. Call
+     * from the thread which made the job.
+     */
+    void collect(QVector <loc> *locations, QString &errRet);
+
+    /*!
+     * Generate the locations on this thread if the job has not been
+     * started. Used by the pool.
+     */
+    void runIfPending(void);
+
+    /*!
+     * Run jobs on the global thread pool, side by side.
+     */
+    static void startInBackground(const QVector < QSharedPointer<layoutJob> > &jobs);
+
+signals:
+    void done();
+
+private:
+    layoutJob(QSharedPointer<NineMLLayoutData> layout, int numNeurons);
+    enum jobState { Pending, Running, Done };
+
+    QMutex lock;
+    QWaitCondition finished;
+    jobState state;
+    // run alongside other jobs, so without threads of its own
+    bool shared;
+
+    QSharedPointer<NineMLLayoutData> layout;
+    NineMLLayoutData * snapshot;
+    int numNeurons;
+    QByteArray key;
+    QByteArray fileKey;
+    QVector < loc > result;
+    QString err;
 };
 
 
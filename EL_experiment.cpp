@@ -26,7 +26,9 @@
 #include "SC_network_layer_rootdata.h"
 #include "SC_projectobject.h"
 #include "SC_utilities.h"
+#include "SC_settings.h"
 #include <QRegularExpression>
+#include <QCryptographicHash>
 
 experiment::experiment()
 {
@@ -134,7 +136,9 @@ QAction* experiment::action (int i)
 
 /*!
  * \brief exptInput::exptInput
- * Create a new copy of an existing Input.
+ * Create a new copy of an existing Input. params is implicitly shared with
+ * the original until one of them is edited, which is why the code reading
+ * it uses at() rather than the detaching operator[].
  */
 exptInput::exptInput(exptInput * inToCopy)
 {
@@ -174,11 +178,21 @@ exptOutput::exptOutput(exptOutput * outToCopy)
 
 /*!
  * \brief exptChangeProp::exptChangeProp
- * Create a copy of an existing ChangeProp
+ * Create a copy of an existing ChangeProp. The copy has its own
+ * ParameterInstance, but the value and index lists are implicitly shared,
+ * so they are only copied if one of the two is changed.
  */
 exptChangeProp::exptChangeProp(exptChangeProp * cpToCopy)
 {
-    this->par = cpToCopy->par;
+    this->par = NULL;
+    if (cpToCopy->par != NULL) {
+        StateVariableInstance * sv = dynamic_cast<StateVariableInstance *> (cpToCopy->par);
+        if (sv != NULL) {
+            this->par = new StateVariableInstance(sv);
+        } else {
+            this->par = new ParameterInstance(cpToCopy->par);
+        }
+    }
     this->component = cpToCopy->component;
     this->edit = false;
     this->set = true;
@@ -348,6 +362,16 @@ exptBox * experiment::getBox(viewELExptPanelHandler * panel)
         run->setToolTip("Run the experiment in the chosen simulator");
         layout->addWidget(run,3,0,1,1);
 
+        // batch button, to sweep the property changes
+        QToolButton * batch = new QToolButton;
+        batch->setText("Run batch...");
+        batch->setEnabled(!this->subEdit && !this->running);
+        batch->setStyleSheet("QToolButton { color: black; border: 0px; background-color :transparent;}");
+        batch->setToolTip("Run the experiment for every combination of values of its property changes");
+        batch->setProperty("index", (int) index);
+        layout->addWidget(batch,3,1,1,3);
+        QObject::connect(batch, SIGNAL(clicked()), panel, SLOT(runBatch()));
+
         if (this->progressBar == NULL) {
            this->progressBar = new QLabel;
            this->progressBar->setMaximumHeight(10);
@@ -558,14 +582,22 @@ void experiment::purgeBadPointer(QSharedPointer<Component> ptr, QSharedPointer<C
 }
 
 void experiment::updateChanges(QSharedPointer <ComponentInstance> ptr)
+{
+    QSet <ComponentInstance *> migrated;
+    migrated.insert(ptr.data());
+    this->updateChanges(migrated);
+}
+
+void experiment::updateChanges(const QSet <ComponentInstance *> &migrated)
 {
     // par changes
     for (int i = 0; i < changes.size(); ++i) {
 
         exptChangeProp * change = changes[i];
+        QSharedPointer <ComponentInstance> ptr = change->component;
 
         // are we using the component?
-        if (change->component == ptr) {
+        if (!ptr.isNull() && migrated.contains(ptr.data())) {
 
             // if so, update
             // property
@@ -581,13 +613,12 @@ void experiment::updateChanges(QSharedPointer <ComponentInstance> ptr)
 
             // if not found
             if (!propFound) {
+                delete change->par;
                 change->par = NULL;
                 change->set = false;
                 change->edit = true;
             }
 
-            // component
-            change->component = ptr;
         }
     }
 }
@@ -613,7 +644,8 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
     bool portsExist = false;
 
     QStringList elementList;
-    for (int i = 0; i < data->populations.size(); ++i) {
+    // only the edit view completes from the list
+    for (int i = 0; edit && i < data->populations.size(); ++i) {
         portsExist = false;
         for (int p = 0; p < data->populations[i]->neuronType->component->AnalogPortList.size(); ++p) {
             if (data->populations[i]->neuronType->component->AnalogPortList[p]->mode== AnalogRecvPort \
@@ -812,7 +844,7 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
                 spin->setMinimum(-10000.0);
                 spin->setDecimals(6);
                 if (!this->params.empty()) {
-                    spin->setValue(this->params[0]);
+                    spin->setValue(this->params.at(0));
                 }
                 frameLay->addLayout(formLay);
                 if (this->portIsAnalog) {
@@ -842,7 +874,7 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
                 table->setRowCount(qCeil(params.size()/2));
                 for (int i = 0; i < params.size(); ++i) {
                     QTableWidgetItem * item = new QTableWidgetItem;
-                    item->setData(Qt::DisplayRole, params[i]);
+                    item->setData(Qt::DisplayRole, params.at(i));
                     table->setItem(qFloor(i/2), i%2, item);
                 }
 
@@ -904,7 +936,7 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
                 // add items from params
                 for (int i = 0; i < params.size(); ++i) {
                     QTableWidgetItem * item = new QTableWidgetItem;
-                    item->setData(Qt::DisplayRole, params[i]);
+                    item->setData(Qt::DisplayRole, params.at(i));
                     table->setItem(i, 0, item);
                 }
 
@@ -945,8 +977,8 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
                 int indexIndex = 0;
                 bool indexFound = false;
                 for (int i = 0; i < params.size(); i+=2) {
-                    if (params[i] == -1) {
-                        index = params[i+1];
+                    if (params.at(i) == -1) {
+                        index = params.at(i+1);
                         indexIndex = i;
                         if (index == currentIndex) {
                             indexFound = true;
@@ -956,10 +988,10 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
                     if (index == currentIndex) {
                         table->setRowCount(table->rowCount()+1);
                         QTableWidgetItem * item = new QTableWidgetItem;
-                        item->setData(Qt::DisplayRole, params[i]);
+                        item->setData(Qt::DisplayRole, params.at(i));
                         table->setItem(qFloor((i-indexIndex-2.0)/2.0), (i-indexIndex-2)%2, item);
                         item = new QTableWidgetItem;
-                        item->setData(Qt::DisplayRole, params[i+1]);
+                        item->setData(Qt::DisplayRole, params.at(i+1));
                         table->setItem(qFloor((i+1-indexIndex-2.0)/2.0), (i+1-indexIndex-2)%2, item);
                     }
                 }
@@ -972,10 +1004,10 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
                     params.push_back(1);
                     table->setRowCount(1);
                     QTableWidgetItem * item = new QTableWidgetItem;
-                    item->setData(Qt::DisplayRole, params[params.size()-2]);
+                    item->setData(Qt::DisplayRole, params.at(params.size()-2));
                     table->setItem(0, 0, item);
                     item = new QTableWidgetItem;
-                    item->setData(Qt::DisplayRole, params[params.size()-1]);
+                    item->setData(Qt::DisplayRole, params.at(params.size()-1));
                     table->setItem(0, 1, item);
                 }
 
@@ -1142,9 +1174,9 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
         if (this->inType == constant) {
             // FIXME: What if this->params is empty here?
             if (this->portIsAnalog) {
-                desc += "Constant analog input with a value of <b>" + QString::number(this->params[0]) + "</b>.";
+                desc += "Constant analog input with a value of <b>" + QString::number(this->params.at(0)) + "</b>.";
             } else {
-                desc += "Spiking input with a constant spike rate of <b>" + QString::number(this->params[0]) + "</b>.";
+                desc += "Spiking input with a constant spike rate of <b>" + QString::number(this->params.at(0)) + "</b>.";
             }
 
         } else if (this->inType == timevarying) {
@@ -1190,6 +1222,16 @@ QVBoxLayout * exptInput::drawInput(nl_rootdata * data, viewELExptPanelHandler *h
     return layout;
 }
 
+QByteArray exptInput::viewKey()
+{
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << this->name << this->target->getXMLName() << this->portName << (int) this->inType
+           << this->portIsAnalog << this->params << this->externalInput.host
+           << this->externalInput.port << this->externalInput.timestep;
+    return key;
+}
+
 
 
 // ################################### exptOut
@@ -1200,7 +1242,8 @@ QVBoxLayout * exptOutput::drawOutput(nl_rootdata * data, viewELExptPanelHandler
     bool portsExist = false;
 
     QStringList elementList;
-    for (int i = 0; i < data->populations.size(); ++i) {
+    // only the edit view completes from the list
+    for (int i = 0; edit && i < data->populations.size(); ++i) {
         portsExist = false;
         for (int p = 0; p < data->populations[i]->neuronType->component->AnalogPortList.size(); ++p) {
             if (data->populations[i]->neuronType->component->AnalogPortList[p]->mode == AnalogSendPort) {
@@ -1420,10 +1463,10 @@ QVBoxLayout * exptOutput::drawOutput(nl_rootdata * data, viewELExptPanelHandler
             QHBoxLayout * indices = new QHBoxLayout();
             indices->addWidget(new QLabel("Indices:"));
             QLineEdit * indicesString = new QLineEdit();
-            indicesString->setText(this->indices);
+            indicesString->setText(this->indices.toRangeString());
             indicesString->setMinimumWidth(200);
             indicesString->setProperty("ptr", qVariantFromValue((void *) this));
-            indicesString->setToolTip("Indices to log - 'all' for all indices or comma separated list of indices (first index is index 0)");
+            indicesString->setToolTip("Indices to log - 'all' for all indices or comma separated list of indices and ranges of indices, such as 0-99 (first index is index 0)");
             connect(indicesString, SIGNAL(editingFinished()), handler, SLOT(setOutputIndices()));
             indices->addWidget(indicesString);
             frameLay->addLayout(indices);
@@ -1561,12 +1604,13 @@ QVBoxLayout * exptOutput::drawOutput(nl_rootdata * data, viewELExptPanelHandler
         name->setFont(nameFont);
 
         QString inds;
-        if (indices == "all") {
+        QString range = indices.toRangeString();
+        if (indices.isAll()) {
             inds = " logging all indices";
-        } else if (indices.size() > 10) {
-            inds = " logging selected indices";
+        } else if (range.size() > 10) {
+            inds = " logging " + QString::number(indices.count()) + " selected indices";
         } else {
-            inds = " logging indices " + indices;
+            inds = " logging indices " + range;
         }
         QLabel * desc = new QLabel();
         if (!isExternal) {
@@ -1597,6 +1641,16 @@ QVBoxLayout * exptOutput::drawOutput(nl_rootdata * data, viewELExptPanelHandler
     return layout;
 }
 
+QByteArray exptOutput::viewKey()
+{
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << this->name << this->source->getXMLName() << this->portName << this->indices.toRangeString()
+           << this->isExternal << this->externalOutput.host << this->externalOutput.port
+           << this->externalOutput.timestep;
+    return key;
+}
+
 // ################# LESIONS and CHANGES TO PARAMETERS
 
 exptLesion::exptLesion(exptLesion* lToCopy)
@@ -1613,7 +1667,8 @@ QVBoxLayout* exptLesion::drawLesion(nl_rootdata* data, viewELExptPanelHandler* h
     QVBoxLayout* layout = new QVBoxLayout;
 
     QStringList elementList;
-    for (int i = 0; i < data->populations.size(); ++i) {
+    // only the edit view completes from the list
+    for (int i = 0; edit && i < data->populations.size(); ++i) {
         for (int p = 0; p < data->populations[i]->projections.size(); ++p) {
             elementList << data->populations[i]->projections[p]->getName();
         }
@@ -2101,7 +2156,8 @@ QVBoxLayout * exptChangeProp::drawChangeProp(nl_rootdata * data, viewELExptPanel
     QVBoxLayout * layout = new QVBoxLayout;
 
     QStringList elementList;
-    for (int i = 0; i < data->populations.size(); ++i) {
+    // only the edit view completes from the list
+    for (int i = 0; edit && i < data->populations.size(); ++i) {
         elementList << data->populations[i]->neuronType->getXMLName();
         for (int j = 0; j < data->populations[i]->projections.size(); ++j) {
             for (int k = 0; k < data->populations[i]->projections[j]->synapses.size(); ++k) {
@@ -2654,8 +2710,14 @@ void experiment::writeXML(QXmlStreamWriter * writer, projectObject *data)
 
     writer->writeEndElement(); // Simulation
 
+    // only simulators which say they read it get the binary form
+    bool binaryArrays;
+    {
+        QSettings settings;
+        binaryArrays = settings.value("simulators/" + this->setup.simType + "/" + ARRAY_INPUT_BINARY_SETTING, false).toBool();
+    }
     for (int i = 0; i < ins.size(); ++i) {
-        ins[i]->writeXML(writer, data);
+        ins[i]->writeXML(writer, data, binaryArrays);
     }
 
     for (int i = 0; i < outs.size(); ++i) {
@@ -2668,7 +2730,143 @@ void experiment::writeXML(QXmlStreamWriter * writer, projectObject *data)
 
 }
 
-void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
+namespace {
+    // The binary form of an array input holds, for ConstantArrayInput, an
+    // int index and a double value per element, as ParameterInstance
+    // writes explicit lists; for TimeVaryingArrayInput, an int index and
+    // double time and value per time point.
+
+    // The directory of the file an experiment is read from or written to,
+    // or false if it is not a file
+    bool experimentDir(QIODevice * device, QDir &dir)
+    {
+        QFile * file = qobject_cast <QFile *> (device);
+        if (file == (QFile *) 0 || file->fileName().isEmpty()) {
+            return false;
+        }
+        dir = QFileInfo(file->fileName()).absoluteDir();
+        return true;
+    }
+
+    // Write params out as the binary form of an array input, to a file
+    // named by its contents so that an unchanged array is not written
+    // again. Returns the file name, or an empty string to fall back to
+    // the XML form.
+    QString writeArrayInputFile(QXmlStreamWriter * writer, const QVector <float> &params, bool timeVarying, int &numElements)
+    {
+        QDir dir;
+        if (!experimentDir(writer->device(), dir)) {
+            return QString();
+        }
+
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(timeVarying ? "t" : "c", 1);
+        hash.addData((const char *) params.constData(), params.size()*sizeof(float));
+        QString name = QString("arrayInputData_") + hash.result().toHex() + ".bin";
+
+        int elementSize = timeVarying ? sizeof(qint32) + 2*sizeof(double) : sizeof(qint32) + sizeof(double);
+        numElements = 0;
+        QByteArray block;
+        block.reserve(EXPLICIT_DATA_BLOCK_ELEMENTS*elementSize);
+        QByteArray out;
+        int index = -1;
+        for (int i = 0; i < params.size(); ++i) {
+            char element[sizeof(qint32) + 2*sizeof(double)];
+            double vals[2];
+            if (timeVarying) {
+                if (i + 1 >= params.size()) {
+                    break;
+                }
+                // a time of -1 starts the points for the next index
+                if (params.at(i) == -1) {
+                    index = (int) params.at(i+1);
+                    ++i;
+                    continue;
+                }
+                vals[0] = params.at(i);
+                vals[1] = params.at(i+1);
+                ++i;
+            } else {
+                index = i;
+                vals[0] = params.at(i);
+            }
+            qint32 ind = index;
+            memcpy(element, &ind, sizeof(qint32));
+            memcpy(element + sizeof(qint32), vals, elementSize - sizeof(qint32));
+            block.append(element, elementSize);
+            ++numElements;
+            if (block.size() >= EXPLICIT_DATA_BLOCK_ELEMENTS*elementSize) {
+                out.append(block);
+                block.clear();
+            }
+        }
+        out.append(block);
+
+        QString fileName = dir.absoluteFilePath(name);
+        if (QFileInfo(fileName).size() == out.size() && QFile::exists(fileName)) {
+            // so that an export keeps the file
+            exportCache::written(fileName);
+            return name;
+        }
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(out) != out.size()) {
+            SCUtilities::storeError("Error writing binary file '" + fileName + "' - is there sufficient disk space?");
+            file.close();
+            file.remove();
+            return QString();
+        }
+        file.close();
+        exportCache::written(fileName);
+        return name;
+    }
+
+    // Read the binary form of an array input, referenced by the BinaryFile
+    // element the reader is on, into params
+    void readArrayInputFile(QXmlStreamReader * reader, QVector <float> &params, bool timeVarying)
+    {
+        QString name = reader->attributes().value("file_name").toString();
+        int numElements = reader->attributes().value("num_elements").toString().toInt();
+        QDir dir;
+        experimentDir(reader->device(), dir);
+        QFile file(dir.absoluteFilePath(name));
+        if (name.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+            SCUtilities::storeError("Error: Binary file referenced in experiment not found: " + name);
+            return;
+        }
+
+        int elementSize = timeVarying ? sizeof(qint32) + 2*sizeof(double) : sizeof(qint32) + sizeof(double);
+        QByteArray data = file.readAll();
+        file.close();
+        int count = data.size() / elementSize;
+        if (count != numElements) {
+            SCUtilities::storeError("Error in Experiment Input - binary file " + name + " holds the wrong number of elements");
+        }
+
+        params.reserve(params.size() + (timeVarying ? 2 : 1)*count);
+        const char * in = data.constData();
+        int lastIndex = -1;
+        for (int i = 0; i < count; ++i) {
+            qint32 ind;
+            double vals[2];
+            memcpy(&ind, in, sizeof(qint32));
+            memcpy(vals, in + sizeof(qint32), elementSize - sizeof(qint32));
+            in += elementSize;
+            if (timeVarying) {
+                if (i == 0 || ind != lastIndex) {
+                    params.push_back(-1);
+                    params.push_back(ind);
+                    lastIndex = ind;
+                }
+                params.push_back(vals[0]);
+                params.push_back(vals[1]);
+            } else {
+                params.push_back(vals[0]);
+            }
+        }
+    }
+}
+
+void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data, bool binaryArrays)
 {
     if (!data->isValidPointer(target)) {
         return;
@@ -2683,7 +2881,7 @@ void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
         writer->writeEmptyElement("ConstantInput");
         writer->writeAttribute("target", this->target->getXMLName());
         writer->writeAttribute("port", this->portName);
-        writer->writeAttribute("value", QString::number(float(this->params[0])));
+        writer->writeAttribute("value", QString::number(float(this->params.at(0))));
         writer->writeAttribute("name", this->name);
         if (!this->portIsAnalog) {
             if (this->rateDistribution == Regular) {
@@ -2709,24 +2907,31 @@ void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
         }
         for (int i = 0; i < this->params.size(); i+=2) {
             writer->writeEmptyElement("TimePointValue");
-            writer->writeAttribute("time", QString::number(float(this->params[i])));
-            writer->writeAttribute("value", QString::number(float(this->params[i+1])));
+            writer->writeAttribute("time", QString::number(float(this->params.at(i))));
+            writer->writeAttribute("value", QString::number(float(this->params.at(i+1))));
         }
         writer->writeEndElement(); // TimeVaryingInput
         break;
     case arrayConstant:
     {
-        writer->writeEmptyElement("ConstantArrayInput");
+        int numElements = 0;
+        QString binaryName;
+        if (binaryArrays && params.size() > ARRAY_INPUT_BINARY_ELEMENTS) {
+            binaryName = writeArrayInputFile(writer, params, false, numElements);
+        }
+        writer->writeStartElement("ConstantArrayInput");
         writer->writeAttribute("target", this->target->getXMLName());
         writer->writeAttribute("port", this->portName);
-        // construct string for array_value:
-        QString array = "";
-        for (int i = 0; i < params.size(); ++i) {
-            array += QString::number(params[i]) + ",";
+        writer->writeAttribute("array_size",QString::number(params.size()));
+        if (binaryName.isEmpty()) {
+            // construct string for array_value:
+            QString array = "";
+            for (int i = 0; i < params.size(); ++i) {
+                array += QString::number(params.at(i)) + ",";
+            }
+            array.chop(1);
+            writer->writeAttribute("array_value", array);
         }
-        array.chop(1);
-        writer->writeAttribute("array_size",QString::number(float(params.size())));
-        writer->writeAttribute("array_value", array);
         writer->writeAttribute("name", this->name);
         if (!this->portIsAnalog) {
             if (this->rateDistribution == Regular) {
@@ -2736,6 +2941,12 @@ void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
             }
             writer->writeAttribute("rate_seed", QString::number(this->rateSeed));
         }
+        if (!binaryName.isEmpty()) {
+            writer->writeEmptyElement("BinaryFile");
+            writer->writeAttribute("file_name", binaryName);
+            writer->writeAttribute("num_elements", QString::number(numElements));
+        }
+        writer->writeEndElement(); // ConstantArrayInput
     }
         break;
     case arrayTimevarying:
@@ -2752,16 +2963,28 @@ void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
             }
             writer->writeAttribute("rate_seed", QString::number(this->rateSeed));
         }
+        int numElements = 0;
+        QString binaryName;
+        if (binaryArrays && params.size() > 2*ARRAY_INPUT_BINARY_ELEMENTS) {
+            binaryName = writeArrayInputFile(writer, params, true, numElements);
+        }
+        if (!binaryName.isEmpty()) {
+            writer->writeEmptyElement("BinaryFile");
+            writer->writeAttribute("file_name", binaryName);
+            writer->writeAttribute("num_elements", QString::number(numElements));
+            writer->writeEndElement(); // TimeVaryingArrayInput
+            break;
+        }
         int index = -1;
         QString arrayT = "";
         QString arrayV = "";
         for (int n = 0; n < params.size(); n+=2) {
-            if (params[n] == -1 || n+1 == params.size()-1) {
+            if (params.at(n) == -1 || n+1 == params.size()-1) {
                 if (index != -1) {
                     if (n+1 == params.size()-1) {
                         // construct string for arrays:
-                        arrayT += QString::number(params[n]) + ",";
-                        arrayV += QString::number(params[n+1]) + ",";
+                        arrayT += QString::number(params.at(n)) + ",";
+                        arrayV += QString::number(params.at(n+1)) + ",";
                     }
                     arrayT.chop(1);
                     arrayV.chop(1);
@@ -2772,15 +2995,15 @@ void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
                         writer->writeAttribute("array_value", arrayV);
                     }
                 }
-                if (params[n] == -1) {
+                if (params.at(n) == -1) {
                     arrayV = "";
                     arrayT = "";
-                    index = params[n+1];
+                    index = params.at(n+1);
                 }
             } else {
                 // construct string for arrays:
-                arrayT += QString::number(params[n]) + ",";
-                arrayV += QString::number(params[n+1]) + ",";
+                arrayT += QString::number(params.at(n)) + ",";
+                arrayV += QString::number(params.at(n+1)) + ",";
             }
         }
         writer->writeEndElement(); // TimeVaryingArrayInput
@@ -2795,7 +3018,7 @@ void exptInput::writeXML(QXmlStreamWriter * writer, projectObject * data)
         // construct string for array_value:
         QString array = "";
         for (int i = 0; i < params.size(); ++i) {
-            array += QString::number(params[i]) + ",";
+            array += QString::number(params.at(i)) + ",";
         }
         array.chop(1);
         writer->writeAttribute("tcp_port",QString::number(this->externalInput.port));
@@ -2836,33 +3059,30 @@ void exptOutput::writeXML(QXmlStreamWriter * writer, projectObject * data)
         return;
     }
 
-    // check indices
-    if (indices != "all") {
-        QStringList inds = indices.split(",");
-        this->externalOutput.size = inds.size();
-        for (int i = 0; i < inds.size(); ++i) {
-            if (source->component->type == "neuron_body") {
-                QSharedPointer <population> pop = qSharedPointerDynamicCast<population> (source->owner);
-                CHECK_CAST(pop)
-                if (inds[i].toInt() < 0 || inds[i].toInt() > pop->numNeurons-1) {
-                    QMessageBox msgBox;
-                    msgBox.setIcon(QMessageBox::Critical);
-                    msgBox.setText("Output index out of range - indices must be between 0 and the number of neurons - 1. Output will not be logged.");
-                    msgBox.exec();
-                    return;
-                }
+    // check indices; the set is sorted, so only its last can be out of range
+    if (!indices.isAll()) {
+        this->externalOutput.size = indices.count();
+        if (source->component->type == "neuron_body") {
+            QSharedPointer <population> pop = qSharedPointerDynamicCast<population> (source->owner);
+            CHECK_CAST(pop)
+            if (indices.last() > pop->numNeurons-1) {
+                QMessageBox msgBox;
+                msgBox.setIcon(QMessageBox::Critical);
+                msgBox.setText("Output index out of range - indices must be between 0 and the number of neurons - 1. Output will not be logged.");
+                msgBox.exec();
+                return;
             }
-            if (source->component->type == "postsynapse") {
-                QSharedPointer <projection> proj = qSharedPointerDynamicCast<projection> (source->owner);
-                CHECK_CAST(proj)
-                QSharedPointer <population> pop = proj->destination;
-                if (inds[i].toInt() < 0 || inds[i].toInt() > pop->numNeurons-1) {
-                    QMessageBox msgBox;
-                    msgBox.setIcon(QMessageBox::Warning);
-                    msgBox.setText("Output index out of range - indices must be between 0 and the number of target neurons - 1. Output will not be logged.");
-                    msgBox.exec();
-                    return;
-                }
+        }
+        if (source->component->type == "postsynapse") {
+            QSharedPointer <projection> proj = qSharedPointerDynamicCast<projection> (source->owner);
+            CHECK_CAST(proj)
+            QSharedPointer <population> pop = proj->destination;
+            if (indices.last() > pop->numNeurons-1) {
+                QMessageBox msgBox;
+                msgBox.setIcon(QMessageBox::Warning);
+                msgBox.setText("Output index out of range - indices must be between 0 and the number of target neurons - 1. Output will not be logged.");
+                msgBox.exec();
+                return;
             }
         }
     } else {
@@ -2887,8 +3107,8 @@ void exptOutput::writeXML(QXmlStreamWriter * writer, projectObject * data)
     writer->writeAttribute("start_time", QString::number(this->startTime)); // add later
     writer->writeAttribute("end_time", QString::number(this->endTime)); // add later
 
-    if (indices != "all") {
-        writer->writeAttribute("indices",indices);
+    if (!indices.isAll()) {
+        writer->writeAttribute("indices",indices.toString());
     }
     if (isExternal) {
         writer->writeAttribute("tcp_port",QString::number(this->externalOutput.port));
@@ -3172,10 +3392,10 @@ void experiment::readXML(QXmlStreamReader * reader, projectObject * data)
                             newIn->readXML(reader, data);
                             this->ins.push_back(newIn);
                         } else if (reader->name() == "ConstantArrayInput") {
+                            // reads to the end of the element itself
                             exptInput * newIn = new exptInput;
                             newIn->readXML(reader, data);
                             this->ins.push_back(newIn);
-                            reader->skipCurrentElement();
                         } else if (reader->name() == "TimeVaryingArrayInput") {
                             exptInput * newIn = new exptInput;
                             newIn->readXML(reader, data);
@@ -3401,9 +3621,21 @@ void exptInput::readXML(QXmlStreamReader * reader, projectObject * data)
         }
 
         QString array;
-        if (reader->attributes().hasAttribute("array_value")) {
+        bool haveArray = reader->attributes().hasAttribute("array_value");
+        if (haveArray) {
             array = reader->attributes().value("array_value").toString();
-        } else {
+        }
+
+        // large arrays are held in a binary file instead
+        while (reader->readNextStartElement()) {
+            if (reader->name() == "BinaryFile" && !haveArray) {
+                readArrayInputFile(reader, params, false);
+                haveArray = true;
+            }
+            reader->skipCurrentElement();
+        }
+
+        if (!haveArray) {
             QSettings settings;
             int num_errs = settings.beginReadArray("errors");
             settings.endArray();
@@ -3413,10 +3645,12 @@ void exptInput::readXML(QXmlStreamReader * reader, projectObject * data)
             settings.endArray();
         }
 
-        QStringList arrayValues = array.split(",");
+        if (!array.isEmpty()) {
+            QStringList arrayValues = array.split(",");
 
-        for (int i = 0; i < (int) arrayValues.size(); ++i) {
-            params.push_back(arrayValues[i].toFloat());
+            for (int i = 0; i < (int) arrayValues.size(); ++i) {
+                params.push_back(arrayValues[i].toFloat());
+            }
         }
 
         if ((int) params.size() != array_size) {
@@ -3490,6 +3724,14 @@ void exptInput::readXML(QXmlStreamReader * reader, projectObject * data)
                 }
 
                 reader->skipCurrentElement();
+
+            } else if (reader->name() == "BinaryFile") {
+
+                readArrayInputFile(reader, params, true);
+                reader->skipCurrentElement();
+
+            } else {
+                reader->skipCurrentElement();
             }
         }
 
@@ -3622,10 +3864,16 @@ void exptOutput::readXML(QXmlStreamReader * reader, projectObject * data)
         }
         if (port != NULL) {
             // get indices
-            if (reader->attributes().hasAttribute("indices")) {
-                indices = reader->attributes().value("indices").toString();
-            } else {
-                indices = "all";
+            indices = indexSet::all();
+            if (reader->attributes().hasAttribute("indices")
+                && !indexSet::fromString(reader->attributes().value("indices").toString(), indices)) {
+                QSettings settings;
+                int num_errs = settings.beginReadArray("errors");
+                settings.endArray();
+                settings.beginWriteArray("errors");
+                settings.setArrayIndex(num_errs + 1);
+                settings.setValue("errorText", "Error in Experiment Output - indices are not a list of indices, so all are logged");
+                settings.endArray();
             }
             portName = port->name;
             portIsAnalog = port->isAnalog();
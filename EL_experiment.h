@@ -29,6 +29,12 @@
 #include "CL_classes.h"
 #include "SC_viewELexptpanelhandler.h"
 #include "SC_logged_data.h"
+#include "SC_indexset.h"
+
+// array inputs with more elements than this are written to a binary file
+// next to the experiment, rather than into the XML, if the experiment's
+// simulator reads that form (ARRAY_INPUT_BINARY_SETTING)
+#define ARRAY_INPUT_BINARY_ELEMENTS 1000
 
 class exptBox : public QFrame
 {
@@ -155,7 +161,16 @@ public:
     EventPort eventport;
 
     QVBoxLayout * drawInput(nl_rootdata *data, viewELExptPanelHandler * handler);
-    void writeXML(QXmlStreamWriter *, projectObject * data);
+    /*!
+     * What the view (not edit) mode of drawInput shows, so that the panel
+     * can keep the widgets drawn while this is unchanged.
+     */
+    QByteArray viewKey();
+    /*!
+     * Write the input; with binaryArrays, large array inputs go into a
+     * BinaryFile beside the experiment rather than into the XML.
+     */
+    void writeXML(QXmlStreamWriter *, projectObject * data, bool binaryArrays = false);
     void readXML(QXmlStreamReader * , projectObject *);
 };
 
@@ -176,7 +191,7 @@ public:
         isExternal = false;
         name = "New Output";
         portIsAnalog = true;
-        indices="all";
+        indices = indexSet::all();
         externalOutput.size=1;
         externalOutput.port = 50091;
         externalOutput.host = "127.0.0.1";
@@ -195,11 +210,13 @@ public:
     bool isExternal;
     QString name;
     externalObject externalOutput;
-    QString indices;
+    indexSet indices;
     double startTime;
     double endTime;
 
     QVBoxLayout * drawOutput(nl_rootdata *data, viewELExptPanelHandler * handler);
+    //! As exptInput::viewKey
+    QByteArray viewKey();
     void writeXML(QXmlStreamWriter *, projectObject * data);
     void readXML(QXmlStreamReader * , projectObject *);
 };
@@ -379,6 +396,7 @@ class exptChangeProp : QObject
 public:
     exptChangeProp() {edit = true; set=false; par = NULL; name = "New changed property";}
     exptChangeProp(exptChangeProp *);
+    ~exptChangeProp() {delete par;}
 
     ParameterInstance * par;
     QSharedPointer <ComponentInstance> component;
@@ -427,6 +445,8 @@ public:
     void purgeBadPointer(QSharedPointer <ComponentInstance>ptr);
     void purgeBadPointer(QSharedPointer<Component>ptr, QSharedPointer<Component>newPtr);
     void updateChanges(QSharedPointer <ComponentInstance> ptr);
+    //! As updateChanges, for all of the instances at once
+    void updateChanges(const QSet <ComponentInstance *> &migrated);
 
     /*!
      * Set up the action for this experiment.
@@ -41,14 +41,45 @@ get_caller_info (PyObject* self, PyObject* args)
 }
 #endif
 
+/*!
+ * Holds the Python GIL for as long as it is in scope. The main thread releases
+ * the GIL after initialising the interpreter, so every call into Python must
+ * take it, whichever thread it is made from.
+ */
+class pythonGILLock
+{
+public:
+    pythonGILLock() {SCUtilities::initPython(); state = PyGILState_Ensure(); held = true;}
+    ~pythonGILLock() {release();}
+    // give the GIL up early, once nothing more is needed from Python
+    void release() {if (held) {PyGILState_Release(state); held = false;}}
+private:
+    PyGILState_STATE state;
+    bool held;
+};
+
 #include <cmath>
+#include <cstring>
+#include <climits>
+#include <limits>
+#include <algorithm>
 #include <QUuid>
+#include <QCryptographicHash>
 #include <QSettings>
+#include <QtEndian>
+#include <QThreadPool>
+#include <QThread>
 
 #include "NL_connection.h"
 #include "SC_layout_cinterpreter.h"
+#include "NL_kernelconnectivity.h"
 #include "SC_python_connection_generate_dialog.h"
 #include "SC_viewVZlayoutedithandler.h"
+#include "SC_settings.h"
+#include "SC_projectobject.h"
+#include "SC_utilities.h"
+#include "SC_profiler.h"
+#include "SC_ioservice.h"
 #include "filteroutundoredoevents.h"
 
 connection::connection()
@@ -177,6 +208,296 @@ void connection::writeDelay(QXmlStreamWriter &xmlOut)
     xmlOut.writeEndElement(); // delay
 }
 
+/////////////////////////////// STATISTICS
+
+namespace {
+    // the range, mean and histogram of counts, as the degrees of each
+    // source or destination
+    void histogramOf(const QVector<int>& counts, connectionStatistics::distribution& d)
+    {
+        d = connectionStatistics::distribution();
+        d.histogram.fill(0.0, CONN_STATS_BINS);
+        if (counts.isEmpty()) {
+            return;
+        }
+        int lo = counts[0];
+        int hi = counts[0];
+        double sum = 0.0;
+        for (int i = 0; i < counts.size(); ++i) {
+            lo = qMin(lo, counts[i]);
+            hi = qMax(hi, counts[i]);
+            sum += counts[i];
+        }
+        d.min = lo;
+        d.max = hi;
+        d.mean = sum / counts.size();
+        for (int i = 0; i < counts.size(); ++i) {
+            int bin = hi > lo ? (int) ((double) (counts[i] - lo) / (hi - lo) * CONN_STATS_BINS) : CONN_STATS_BINS - 1;
+            d.histogram[qBound(0, bin, CONN_STATS_BINS - 1)] += 1.0;
+        }
+    }
+
+    // the expected degrees of num elements each connected to each of n
+    // others with probability p, which are binomial
+    void expectedBinomial(int n, double p, int num, connectionStatistics::distribution& d)
+    {
+        if (n <= 0 || p <= 0.0) {
+            d.setSingle(0.0, num);
+            return;
+        }
+        if (p >= 1.0) {
+            d.setSingle(n, num);
+            return;
+        }
+        double mean = n * p;
+        double sd = sqrt(mean * (1.0 - p));
+        int lo = qMax(0, (int) floor(mean - 5.0 * sd));
+        int hi = qMin(n, (int) ceil(mean + 5.0 * sd));
+        if (hi <= lo) {
+            d.setSingle(mean, num);
+            return;
+        }
+        d = connectionStatistics::distribution();
+        d.histogram.fill(0.0, CONN_STATS_BINS);
+        d.min = lo;
+        d.max = hi;
+        d.mean = mean;
+
+        // log P(k) for k from lo, each from the last
+        double logOdds = log(p / (1.0 - p));
+        double logP = n * log(1.0 - p);
+        for (int k = 0; k < lo; ++k) {
+            logP += log((double) (n - k) / (k + 1)) + logOdds;
+        }
+        for (int k = lo; k <= hi; ++k) {
+            int bin = (int) ((double) (k - lo) / (hi - lo) * CONN_STATS_BINS);
+            d.histogram[qBound(0, bin, CONN_STATS_BINS - 1)] += num * exp(logP);
+            logP += log((double) (n - k) / (k + 1)) + logOdds;
+        }
+    }
+
+    // the delays of count connections given by delay, if it is a fixed
+    // value or a distribution
+    void delaysOf(const ParameterInstance* delay, double count, connectionStatistics& stats)
+    {
+        connectionStatistics::distribution& d = stats.delay;
+        stats.hasDelays = false;
+        if (delay == NULL || delay->value.isEmpty()) {
+            return;
+        }
+        if (delay->currType == FixedValue) {
+            d.setSingle(delay->value[0], count);
+            stats.hasDelays = true;
+            return;
+        }
+        if (delay->currType != Statistical || delay->value.size() < 3) {
+            return;
+        }
+        int kind = int(round(delay->value[0]));
+        if (kind == 1) {
+            // uniform between the minimum and maximum
+            if (delay->value[2] <= delay->value[1]) {
+                d.setSingle(delay->value[1], count);
+            } else {
+                d = connectionStatistics::distribution();
+                d.min = delay->value[1];
+                d.max = delay->value[2];
+                d.mean = 0.5 * (d.min + d.max);
+                d.histogram.fill(count / CONN_STATS_BINS, CONN_STATS_BINS);
+            }
+            stats.hasDelays = true;
+        } else if (kind == 2) {
+            // normal, from the mean and variance, over three deviations
+            double mean = delay->value[1];
+            double sd = sqrt(qMax(0.0, (double) delay->value[2]));
+            if (sd <= 0.0) {
+                d.setSingle(mean, count);
+            } else {
+                d = connectionStatistics::distribution();
+                d.min = mean - 3.0 * sd;
+                d.max = mean + 3.0 * sd;
+                d.mean = mean;
+                d.histogram.fill(0.0, CONN_STATS_BINS);
+                double total = 0.0;
+                for (int b = 0; b < CONN_STATS_BINS; ++b) {
+                    double z = (d.min + (b + 0.5) * (d.max - d.min) / CONN_STATS_BINS - mean) / sd;
+                    d.histogram[b] = exp(-0.5 * z * z);
+                    total += d.histogram[b];
+                }
+                for (int b = 0; b < CONN_STATS_BINS; ++b) {
+                    d.histogram[b] *= count / total;
+                }
+            }
+            stats.hasDelays = true;
+        }
+    }
+
+    QString rangeText(const connectionStatistics::distribution& d)
+    {
+        if (d.min == d.max) {
+            return QString::number(d.min, 'g', 4);
+        }
+        return QString::number(d.min, 'g', 4) + " to " + QString::number(d.max, 'g', 4)
+            + ", mean " + QString::number(d.mean, 'g', 4);
+    }
+
+    // the histogram as a row of bars, from the Unicode block elements
+    QString barsText(const connectionStatistics::distribution& d)
+    {
+        double top = 0.0;
+        for (int b = 0; b < d.histogram.size(); ++b) {
+            top = qMax(top, d.histogram[b]);
+        }
+        QString bars;
+        for (int b = 0; b < d.histogram.size(); ++b) {
+            if (top <= 0.0 || d.histogram[b] <= 0.0) {
+                bars += QChar(' ');
+            } else {
+                bars += QChar(0x2581 + qBound(0, (int) (d.histogram[b] / top * 7.0 + 0.5), 7));
+            }
+        }
+        return QString::number(d.min, 'g', 4) + " " + bars + " " + QString::number(d.max, 'g', 4);
+    }
+
+    QDataStream& operator<<(QDataStream& s, const connectionStatistics::distribution& d)
+    {
+        return s << d.min << d.max << d.mean << d.histogram;
+    }
+
+    QDataStream& operator>>(QDataStream& s, connectionStatistics::distribution& d)
+    {
+        return s >> d.min >> d.max >> d.mean >> d.histogram;
+    }
+}
+
+connectionStatistics::connectionStatistics()
+{
+    this->count = 0;
+    this->srcSize = 0;
+    this->dstSize = 0;
+    this->exact = true;
+    this->minSrc = 0;
+    this->maxSrc = 0;
+    this->minDst = 0;
+    this->maxDst = 0;
+    this->outOfRange = 0;
+    this->hasDelays = false;
+}
+
+void connectionStatistics::distribution::setSingle(double v, double count)
+{
+    this->min = v;
+    this->max = v;
+    this->mean = v;
+    // as explicitValueStatistics, a single value falls in the last bin
+    this->histogram.fill(0.0, CONN_STATS_BINS);
+    this->histogram[CONN_STATS_BINS - 1] = count;
+}
+
+double connectionStatistics::density(void) const
+{
+    if (this->srcSize <= 0 || this->dstSize <= 0) {
+        return 0.0;
+    }
+    return (double) this->count / ((double) this->srcSize * this->dstSize);
+}
+
+QString connectionStatistics::summary(void) const
+{
+    QString s = (this->exact ? "" : "About ") + QString::number(this->count) + " connections, density "
+        + QString::number(this->density(), 'g', 3);
+    if (this->count > 0) {
+        s += "; out-degree " + rangeText(this->outDegree) + "; in-degree " + rangeText(this->inDegree);
+        if (this->hasDelays) {
+            s += "; delay " + rangeText(this->delay) + " ms";
+        }
+    }
+    if (this->outOfRange > 0) {
+        s += "; " + QString::number(this->outOfRange) + " connections out of range";
+    }
+    return s;
+}
+
+QString connectionStatistics::details(void) const
+{
+    if (this->count == 0) {
+        return QString();
+    }
+    QString s = "Out-degree: " + barsText(this->outDegree) + "\nIn-degree: " + barsText(this->inDegree);
+    if (this->hasDelays) {
+        s += "\nDelay (ms): " + barsText(this->delay);
+    }
+    return s;
+}
+
+void connectionStatistics::write(QDataStream& s) const
+{
+    s << (qint64) this->count << (qint32) this->srcSize << (qint32) this->dstSize << this->exact
+      << this->minSrc << this->maxSrc << this->minDst << this->maxDst << (qint64) this->outOfRange
+      << this->outDegree << this->inDegree << this->hasDelays << this->delay;
+}
+
+bool connectionStatistics::read(QDataStream& s)
+{
+    qint64 c, out;
+    qint32 src, dst;
+    s >> c >> src >> dst >> this->exact
+      >> this->minSrc >> this->maxSrc >> this->minDst >> this->maxDst >> out
+      >> this->outDegree >> this->inDegree >> this->hasDelays >> this->delay;
+    this->count = c;
+    this->srcSize = src;
+    this->dstSize = dst;
+    this->outOfRange = out;
+    return s.status() == QDataStream::Ok;
+}
+
+void connection::addStatisticsLabel(QBoxLayout * lay, nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler,
+                                    nl_rootlayout * rootLay, const connection * conn)
+{
+    if (conn == (connection *) 0) {
+        conn = this;
+    }
+
+    // the sizes, if this is the connection of what is selected
+    QSharedPointer <projection> proj = data->currentlySelectedProjection;
+    if (proj.isNull()) {
+        return;
+    }
+    int srcSize = -1;
+    int dstSize = -1;
+    QSharedPointer <genericInput> in = qSharedPointerDynamicCast <genericInput> (proj);
+    if (!in.isNull()) {
+        if (in->conn != NULL && (in->conn == this || in->conn->generator == this)) {
+            srcSize = in->getSrcSize();
+            dstSize = in->getDestSize();
+        }
+    } else if (!proj->source.isNull() && !proj->destination.isNull()) {
+        for (int i = 0; i < proj->synapses.size(); ++i) {
+            connection * c = proj->synapses[i]->connectionType;
+            if (c != NULL && (c == this || c->generator == this)) {
+                srcSize = proj->source->numNeurons;
+                dstSize = proj->destination->numNeurons;
+            }
+        }
+    }
+
+    connectionStatistics stats;
+    if (srcSize < 0 || !conn->getStatistics(srcSize, dstSize, stats)) {
+        return;
+    }
+
+    QLabel * label = new QLabel(stats.summary());
+    label->setWordWrap(true);
+    label->setToolTip(stats.details());
+    lay->addWidget(label);
+    if (viewVZhandler) {
+        connect(viewVZhandler, SIGNAL(deleteProperties()), label, SLOT(deleteLater()));
+    }
+    if (rootLay) {
+        connect(rootLay, SIGNAL(deleteProperties()), label, SLOT(deleteLater()));
+    }
+}
+
 /////////////////////////////// ALL TO ALL
 
 alltoAll_connection::alltoAll_connection()
@@ -189,7 +510,7 @@ alltoAll_connection::~alltoAll_connection()
 {
 }
 
-QLayout * alltoAll_connection::drawLayout(nl_rootdata *, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay)
+QLayout * alltoAll_connection::drawLayout(nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay)
 {
     QHBoxLayout * hlay = new QHBoxLayout();
     if (viewVZhandler) {
@@ -198,9 +519,24 @@ QLayout * alltoAll_connection::drawLayout(nl_rootdata *, viewVZLayoutEditHandler
     if (rootLay) {
         connect(rootLay, SIGNAL(deleteProperties()), hlay, SLOT(deleteLater()));
     }
+    this->addStatisticsLabel(hlay, data, viewVZhandler, rootLay);
     return hlay;
 }
 
+bool alltoAll_connection::getStatistics(int srcSize, int dstSize, connectionStatistics& stats) const
+{
+    stats = connectionStatistics();
+    stats.srcSize = srcSize;
+    stats.dstSize = dstSize;
+    stats.count = (qint64) srcSize * dstSize;
+    stats.maxSrc = srcSize - 1;
+    stats.maxDst = dstSize - 1;
+    stats.outDegree.setSingle(dstSize, srcSize);
+    stats.inDegree.setSingle(srcSize, dstSize);
+    delaysOf(this->delay, stats.count, stats);
+    return true;
+}
+
 void alltoAll_connection::write_node_xml(QXmlStreamWriter &xmlOut)
 {
     xmlOut.writeStartElement("AllToAllConnection");
@@ -256,7 +592,7 @@ onetoOne_connection::~onetoOne_connection()
 {
 }
 
-QLayout * onetoOne_connection::drawLayout(nl_rootdata *, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay)
+QLayout * onetoOne_connection::drawLayout(nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay)
 {
     QHBoxLayout * hlay = new QHBoxLayout();
     if (viewVZhandler) {
@@ -265,9 +601,32 @@ QLayout * onetoOne_connection::drawLayout(nl_rootdata *, viewVZLayoutEditHandler
     if (rootLay) {
         connect(rootLay, SIGNAL(deleteProperties()), hlay, SLOT(deleteLater()));
     }
+    this->addStatisticsLabel(hlay, data, viewVZhandler, rootLay);
     return hlay;
 }
 
+bool onetoOne_connection::getStatistics(int srcSize, int dstSize, connectionStatistics& stats) const
+{
+    stats = connectionStatistics();
+    stats.srcSize = srcSize;
+    stats.dstSize = dstSize;
+    // of different sizes, the extra sources or destinations have none
+    int n = qMin(srcSize, dstSize);
+    stats.count = n;
+    stats.maxSrc = n - 1;
+    stats.maxDst = n - 1;
+    QVector<int> out(srcSize, 0);
+    QVector<int> in(dstSize, 0);
+    for (int i = 0; i < n; ++i) {
+        out[i] = 1;
+        in[i] = 1;
+    }
+    histogramOf(out, stats.outDegree);
+    histogramOf(in, stats.inDegree);
+    delaysOf(this->delay, stats.count, stats);
+    return true;
+}
+
 void onetoOne_connection::write_node_xml(QXmlStreamWriter &xmlOut)
 {
     // Sanity check - if we are exporting for simulation, we want to make sure
@@ -277,7 +636,6 @@ void onetoOne_connection::write_node_xml(QXmlStreamWriter &xmlOut)
     int dstSize = -1;
     QString srcName = "";
     QString dstName = "";
-    QSettings settings;
     if (!this->parent.isNull()) {
         switch (this->parent->type) {
         case synapseObject:
@@ -329,7 +687,8 @@ void onetoOne_connection::write_node_xml(QXmlStreamWriter &xmlOut)
     }
     if (srcSize != dstSize && false) { // not used for now
 
-       int num_errs = settings.beginReadArray("errors");
+        QSettings settings;
+        int num_errs = settings.beginReadArray("errors");
         settings.endArray();
         settings.beginWriteArray("errors");
         settings.setArrayIndex(num_errs + 1);
@@ -396,6 +755,98 @@ fixedProb_connection::~fixedProb_connection()
 {
 }
 
+void fixedProb_connection::generateRow (int src, int numDst, QVector<qint32>& dsts) const
+{
+    dsts.clear();
+    if (this->p <= 0.0f || numDst <= 0) {
+        return;
+    }
+    if (this->p >= 1.0f) {
+        dsts.resize(numDst);
+        for (int j = 0; j < numDst; ++j) {
+            dsts[j] = j;
+        }
+        return;
+    }
+
+    counterRandom rng;
+    rng.seed = (quint32)this->seed;
+    rng.index = (quint32)src;
+    rng.counter = 0;
+
+    // skip ahead by the number of failures before the next success
+    double logq = log (1.0 - (double)this->p);
+    double j = -1.0;
+    for (;;) {
+        double u = counterRandomUniform (&rng);
+        j += 1.0 + floor (log (1.0 - u) / logq);
+        if (j >= numDst) {
+            break;
+        }
+        dsts.push_back ((qint32)j);
+    }
+}
+
+namespace {
+    // generates the connections of rows first, first+stride, ... below end into block
+    class fixedProbRowRunner : public QRunnable
+    {
+    public:
+        fixedProbRowRunner (const fixedProb_connection* fp, int first, int end, int stride, int numDst, connArrays* block)
+            : fp(fp), first(first), end(end), stride(stride), numDst(numDst), block(block) {}
+        void run() {
+            block->src.clear();
+            block->dst.clear();
+            QVector<qint32> row;
+            for (int i = first; i < end; i += stride) {
+                fp->generateRow (i, numDst, row);
+                for (int k = 0; k < row.size(); ++k) {
+                    block->src.push_back (i);
+                }
+                block->dst += row;
+            }
+        }
+    private:
+        const fixedProb_connection* fp;
+        int first;
+        int end;
+        int stride;
+        int numDst;
+        connArrays* block;
+    };
+}
+
+bool fixedProb_connection::generate (int numSrc, int numDst, fixedProbSink& sink, int rowStride) const
+{
+    int threads = qMax (1, QThread::idealThreadCount());
+    QVector<connArrays> blocks (threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount (threads);
+    rowStride = qMax (1, rowStride);
+    qint64 blockSpan = (qint64)rowStride*FIXEDPROB_BLOCK_ROWS;
+
+    // a batch of blocks at a time, so memory is bounded by the batch
+    for (qint64 first = 0; first < numSrc; first += threads*blockSpan) {
+        int used = 0;
+        for (int t = 0; t < threads; ++t) {
+            qint64 start = first + t*blockSpan;
+            if (start >= numSrc) {
+                break;
+            }
+            int end = (int) qMin ((qint64)numSrc, start + blockSpan);
+            pool.start (new fixedProbRowRunner (this, (int) start, end, rowStride, numDst, &blocks[t]));
+            ++used;
+        }
+        pool.waitForDone();
+        for (int t = 0; t < used; ++t) {
+            if (!sink.addConnections (blocks[t])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 /*!
  * \brief fixedProb_connection::drawLayout
  * \param data
@@ -441,10 +892,26 @@ QLayout * fixedProb_connection::drawLayout(nl_rootdata * data, viewVZLayoutEditH
         connect(rootLay, SIGNAL(deleteProperties()), hlay->itemAt(hlay->count()-1)->widget(), SLOT(deleteLater()));
     }
     hlay->addWidget(pSpin);
+    this->addStatisticsLabel(hlay, data, viewVZhandler, rootLay);
 
     return hlay;
 }
 
+bool fixedProb_connection::getStatistics(int srcSize, int dstSize, connectionStatistics& stats) const
+{
+    stats = connectionStatistics();
+    stats.srcSize = srcSize;
+    stats.dstSize = dstSize;
+    stats.exact = false;
+    stats.count = (qint64) floor((double) srcSize * dstSize * qBound(0.0f, this->p, 1.0f) + 0.5);
+    stats.maxSrc = srcSize - 1;
+    stats.maxDst = dstSize - 1;
+    expectedBinomial(dstSize, this->p, srcSize, stats.outDegree);
+    expectedBinomial(srcSize, this->p, dstSize, stats.inDegree);
+    delaysOf(this->delay, stats.count, stats);
+    return true;
+}
+
 void fixedProb_connection::write_node_xml(QXmlStreamWriter &xmlOut)
 {
     xmlOut.writeStartElement("FixedProbabilityConnection");
@@ -494,6 +961,270 @@ void fixedProb_connection::import_parameters_from_xml(QDomNode &e)
     }
 }
 
+/////////////////////////////////// ADJACENCY
+
+void connectionAdjacency::clear()
+{
+    outStart.clear();
+    outConns.clear();
+    inStart.clear();
+    inConns.clear();
+}
+
+void connectionAdjacency::build(const QVector <conn> &conns)
+{
+    if (conns.isEmpty()) {
+        this->clear();
+        return;
+    }
+    this->build(&conns[0].src, &conns[0].dst, sizeof(conn)/sizeof(int), conns.size());
+}
+
+void connectionAdjacency::build(const connArrays &arrays)
+{
+    int n = qMin(arrays.src.size(), arrays.dst.size());
+    if (n == 0) {
+        this->clear();
+        return;
+    }
+    this->build(arrays.src.constData(), arrays.dst.constData(), 1, n);
+}
+
+/*!
+ * Counting sort of the connection positions by source and by destination,
+ * reading every stride'th int from src and dst. Connections with negative
+ * indices are left out.
+ */
+void connectionAdjacency::build(const int * src, const int * dst, int stride, int n)
+{
+    this->clear();
+
+    int maxSrc = -1;
+    int maxDst = -1;
+    for (int i = 0; i < n; ++i) {
+        maxSrc = qMax(maxSrc, src[i*stride]);
+        maxDst = qMax(maxDst, dst[i*stride]);
+    }
+
+    outStart.fill(0, maxSrc+2);
+    inStart.fill(0, maxDst+2);
+    for (int i = 0; i < n; ++i) {
+        if (src[i*stride] >= 0 && dst[i*stride] >= 0) {
+            ++outStart[src[i*stride]+1];
+            ++inStart[dst[i*stride]+1];
+        }
+    }
+    for (int i = 1; i < outStart.size(); ++i) {
+        outStart[i] += outStart[i-1];
+    }
+    for (int i = 1; i < inStart.size(); ++i) {
+        inStart[i] += inStart[i-1];
+    }
+
+    outConns.resize(outStart.back());
+    inConns.resize(inStart.back());
+    QVector <int> outPos = outStart;
+    QVector <int> inPos = inStart;
+    for (int i = 0; i < n; ++i) {
+        if (src[i*stride] >= 0 && dst[i*stride] >= 0) {
+            outConns[outPos[src[i*stride]]++] = i;
+            inConns[inPos[dst[i*stride]]++] = i;
+        }
+    }
+}
+
+int connectionAdjacency::outDegree(int src) const
+{
+    if (src < 0 || src+1 >= outStart.size()) {
+        return 0;
+    }
+    return outStart[src+1] - outStart[src];
+}
+
+int connectionAdjacency::inDegree(int dst) const
+{
+    if (dst < 0 || dst+1 >= inStart.size()) {
+        return 0;
+    }
+    return inStart[dst+1] - inStart[dst];
+}
+
+const int * connectionAdjacency::outgoing(int src, int &count) const
+{
+    count = this->outDegree(src);
+    return count > 0 ? outConns.constData() + outStart[src] : NULL;
+}
+
+const int * connectionAdjacency::incoming(int dst, int &count) const
+{
+    count = this->inDegree(dst);
+    return count > 0 ? inConns.constData() + inStart[dst] : NULL;
+}
+
+// the four array sizes, then the arrays, in native byte order
+bool connectionAdjacency::write(QIODevice &out) const
+{
+    const QVector <int> * arrays[4] = {&outStart, &outConns, &inStart, &inConns};
+    qint32 sizes[4];
+    for (int a = 0; a < 4; ++a) {
+        sizes[a] = arrays[a]->size();
+    }
+    if (out.write((const char*)sizes, sizeof(sizes)) != (qint64)sizeof(sizes)) {
+        return false;
+    }
+    for (int a = 0; a < 4; ++a) {
+        qint64 bytes = (qint64)sizes[a] * sizeof(int);
+        if (bytes > 0 && out.write((const char*)arrays[a]->constData(), bytes) != bytes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool connectionAdjacency::read(QIODevice &in)
+{
+    this->clear();
+    QVector <int> * arrays[4] = {&outStart, &outConns, &inStart, &inConns};
+    qint32 sizes[4];
+    if (in.read((char*)sizes, sizeof(sizes)) != (qint64)sizeof(sizes)) {
+        return false;
+    }
+    for (int a = 0; a < 4; ++a) {
+        if (sizes[a] < 0) {
+            this->clear();
+            return false;
+        }
+        arrays[a]->resize(sizes[a]);
+        qint64 bytes = (qint64)sizes[a] * sizeof(int);
+        if (bytes > 0 && in.read((char*)arrays[a]->data(), bytes) != bytes) {
+            this->clear();
+            return false;
+        }
+    }
+    // the offsets must cover the position lists exactly
+    if ((!outStart.isEmpty() && outStart.back() != outConns.size())
+        || (!inStart.isEmpty() && inStart.back() != inConns.size())) {
+        this->clear();
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////// DEFERRED STORE IMPORT
+
+deferredStoreImport::deferredStoreImport(const QString& source, const QString& store)
+{
+    this->state = Pending;
+    this->ok = false;
+    this->source = source;
+    this->store = store;
+}
+
+bool deferredStoreImport::finish (void)
+{
+    QMutexLocker locker(&this->lock);
+    if (this->state == Pending) {
+        this->state = Running;
+        locker.unlock();
+        bool copied = this->copy();
+        locker.relock();
+        this->ok = copied;
+        this->state = Done;
+        this->finished.wakeAll();
+    }
+    while (this->state == Running) {
+        this->finished.wait(&this->lock);
+    }
+    return this->ok;
+}
+
+void deferredStoreImport::cancel (void)
+{
+    QMutexLocker locker(&this->lock);
+    if (this->state == Pending) {
+        this->state = Cancelled;
+        return;
+    }
+    while (this->state == Running) {
+        this->finished.wait(&this->lock);
+    }
+}
+
+void deferredStoreImport::runIfPending (void)
+{
+    QMutexLocker locker(&this->lock);
+    if (this->state != Pending) {
+        return;
+    }
+    this->state = Running;
+    locker.unlock();
+    bool copied = this->copy();
+    locker.relock();
+    this->ok = copied;
+    this->state = Done;
+    this->finished.wakeAll();
+}
+
+bool deferredStoreImport::copy (void)
+{
+    QFile fileIn(this->source);
+    if (!fileIn.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QFile fileOut(this->store);
+    if (!fileOut.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        return false;
+    }
+
+    // as csv_connection::import_packed_binary, without the progress
+    // signals, which would be emitted from the wrong thread here
+    connStoreHeader hdr;
+    memcpy (hdr.magic, CONN_STORE_MAGIC, 4);
+    hdr.version = CONN_STORE_VERSION;
+    hdr.flags = 0;
+    hdr.reserved = 0;
+    fileOut.write((const char*)&hdr, sizeof(hdr));
+
+    QByteArray block;
+    block.resize(CONN_STORE_BLOCK_ROWS*3*sizeof(qint32));
+    while (!fileIn.atEnd()) {
+        qint64 got = fileIn.read(block.data(), block.size());
+        if (got <= 0) {
+            break;
+        }
+        if (fileOut.write(block.constData(), got) != got) {
+            return false;
+        }
+    }
+    fileOut.flush();
+    return true;
+}
+
+namespace {
+    class deferredStoreImportRunner : public QRunnable
+    {
+    public:
+        deferredStoreImportRunner(const QVector<QSharedPointer<deferredStoreImport> >& jobs) : jobs(jobs) {}
+        void run() {
+            for (int i = 0; i < this->jobs.size(); ++i) {
+                this->jobs[i]->runIfPending();
+            }
+        }
+    private:
+        QVector<QSharedPointer<deferredStoreImport> > jobs;
+    };
+}
+
+void deferredStoreImport::startInBackground (const QVector<QSharedPointer<deferredStoreImport> >& jobs)
+{
+    if (jobs.isEmpty()) {
+        return;
+    }
+    // the pool deletes the runner when it is done; the jobs are shared
+    // with their connections, so outlive either
+    QThreadPool::globalInstance()->start(new deferredStoreImportRunner(jobs));
+}
+
 /////////////////////////////////// EXPLICIT LIST
 
 csv_connection::csv_connection()
@@ -514,8 +1245,22 @@ csv_connection::csv_connection()
 
     copiedFrom = NULL;
 
+    // The backing store is mapped on the first call to getData()
+    this->mappedData = NULL;
+    this->mappedSize = 0;
+    this->mappedLegacy = false;
+    this->storedSrcBytes = sizeof(qint32);
+    this->storedDstBytes = sizeof(qint32);
+
+    // The adjacency index is built on the first query
+    this->adjacencyValid = false;
+    this->storeGeneration = 0;
+    this->statsGeneration = 0;
+    this->statsValid = false;
+
     // Generate the unique UUID style filename here in the constructor.
     this->generateUUIDFilename();
+    this->storeShare = new connStoreShare;
 }
 
 QDir csv_connection::getLibDir (void) const
@@ -535,6 +1280,10 @@ QDir csv_connection::getLibDir (void) const
 
 csv_connection::~csv_connection()
 {
+    // a queued copy into the backing store is no longer wanted
+    this->discardImport();
+    this->unmapBackingStore();
+
     // remove generator
     if (this->generator) {
         delete this->generator;
@@ -603,6 +1352,7 @@ QLayout * csv_connection::drawLayout(nl_rootdata * data, viewVZLayoutEditHandler
         connect(globalDelay, SIGNAL(clicked()), this, SLOT(updateGlobalDelay()));
 
         vlay->addLayout(hlay);
+        this->addStatisticsLabel(vlay, data, viewVZhandler, rootLay);
 
         // set up GL:
         if (viewVZhandler) {
@@ -664,6 +1414,7 @@ QString csv_connection::getUUIDFileName()
 
 void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
 {
+    this->waitForImport();
     if (this->filename.isEmpty()) {
         this->generateFilename();
     }
@@ -672,13 +1423,10 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
     QDir lib_dir = this->getLibDir(); // This is the temporary location for conn data files
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
     if (!f.open( QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::write_node_xml(QXmlStreamWriter &xmlOut): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
-        msgBox.exec();
+        SCUtilities::showMessage("csv_connection::write_node_xml(QXmlStreamWriter &xmlOut): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
         return;
     }
-    f.seek(0);
-    QDataStream access(&f);
+    f.close();
 
     // ok, check if we have a generator, and if it is up-to-date
     if (this->generator) {
@@ -692,8 +1440,7 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
     }
 
     // get a handle to the saved file
-    QSettings settings;
-    QString filePathString = settings.value("files/currentFileName", "error").toString();
+    QString filePathString = settingsCache::currentFileName("error");
 
     if (filePathString == "error") {
         DBG() << "Error getting current project path - THIS SHOULD NEVER HAPPEN!";
@@ -702,7 +1449,7 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
 
     QDir saveDir(filePathString);
 
-    bool saveBinaryConnections = settings.value("fileOptions/saveBinaryConnections", "error").toBool();
+    bool saveBinaryConnections = settingsCache::saveBinaryConnections();
 
     // write containing tag
     xmlOut.writeStartElement("ConnectionList");
@@ -736,7 +1483,7 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
     QString saveFullFileName;
     if (saveBinaryConnections && this->getNumRows() > MIN_CONNS_TO_FORCE_BINARY) {
 
-        QString saveProjectName = settings.value("files/currentFileName").toString();
+        QString saveProjectName = settingsCache::currentFileName();
 
         QDir project_dir(saveProjectName);
 
@@ -744,10 +1491,8 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         project_dir.cdUp();
 
         if (this->filename.isEmpty()) {
-            QMessageBox msgBox;
-            msgBox.setText("Error creating exported binary connection file srcName/dstName:'" + this->srcName
-                           + "/" + this->dstName + "' (filename could not be generated from src/dest population names)");
-            msgBox.exec();
+            SCUtilities::showMessage("Error creating exported binary connection file srcName/dstName:'" + this->srcName
+                                     + "/" + this->dstName + "' (filename could not be generated from src/dest population names)");
             return;
         }
         saveFullFileName = QDir::toNativeSeparators(project_dir.absoluteFilePath(this->filename));
@@ -764,70 +1509,32 @@ void csv_connection::write_node_xml(QXmlStreamWriter &xmlOut)
         xmlOut.writeAttribute("explicit_delay_flag", QString::number(float(getNumCols()==3)));
         xmlOut.writeAttribute("packed_data", "true");
 
-        // re-write the data
-        if (getNumCols()==3) {
-            QVector <conn> conns;
-            this->getAllData(conns);
-
-            // write out
-            QFile export_file(saveFullFileName);
-
-            if (!export_file.open( QIODevice::WriteOnly)) {
-                QMessageBox msgBox;
-                msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
-                               + "' (Check disk space; permissions)");
-                msgBox.exec();
+        // stream the data across to the project's packed binary file,
+        // unless an earlier export already wrote this data there
+        QByteArray exportKey = this->getExportKey();
+        if (!exportCache::isCurrent (saveFullFileName, exportKey)) {
+            if (!this->exportPackedBinary (saveFullFileName)) {
                 return;
             }
-
-            QDataStream access2(&export_file);
-            for (int i = 0; i < conns.size(); ++i) {
-                access2.writeRawData((char*) &conns[i].src, sizeof(int));
-                access2.writeRawData((char*) &conns[i].dst, sizeof(int));
-                access2.writeRawData((char*) &conns[i].metric, sizeof(float));
-            }
-        }
-        if (getNumCols()==2) {
-            QVector <conn> conns;
-            this->getAllData(conns);
-
-            // write out
-            QFile export_file(saveFullFileName);
-
-            if (!export_file.open( QIODevice::WriteOnly)) {
-                QMessageBox msgBox;
-                msgBox.setText("Error creating exported binary connection file '" + saveFullFileName
-                               + "' (Check disk space; permissions)");
-                msgBox.exec();
-                return;
-            }
-
-            QDataStream access3(&export_file);
-            for (int i = 0; i < conns.size(); ++i) {
-                access3.writeRawData((char*) &conns[i].src, sizeof(int));
-                access3.writeRawData((char*) &conns[i].dst, sizeof(int));
-            }
+            exportCache::written (saveFullFileName, exportKey);
         }
 
 
     } else { // non-binary; write only into XML
 
+        QVector <conn> conns;
+        this->getAllData(conns);
+
         // loop through connections writing them out in XML format.
-        for (int i=0; i < this->getNumRows(); ++i) {
+        for (int i=0; i < conns.size(); ++i) {
 
             xmlOut.writeEmptyElement("Connection");
 
-            qint32 val;
-            access >> val;
-            xmlOut.writeAttribute("src_neuron", QString::number(float(val)));
-
-            access >> val;
-            xmlOut.writeAttribute("dst_neuron", QString::number(float(val)));
+            xmlOut.writeAttribute("src_neuron", QString::number(float(conns[i].src)));
+            xmlOut.writeAttribute("dst_neuron", QString::number(float(conns[i].dst)));
 
             if (this->getNumCols() == 3) {
-                float valf;
-                access >> valf;
-                xmlOut.writeAttribute("delay", QString::number(float(valf)));
+                xmlOut.writeAttribute("delay", QString::number(float(conns[i].metric)));
             }
         }
     }
@@ -856,6 +1563,11 @@ void csv_connection::read_metadata_xml(QDomNode &e)
 
 void csv_connection::import_parameters_from_xml(QDomNode &e)
 {
+    // The backing store is about to be rewritten
+    this->discardImport();
+    this->unmapBackingStore();
+    this->storeChanged(false);
+
     // check for annotations
     QDomNodeList anns = e.toElement().elementsByTagName("LL:Annotation");
 
@@ -907,8 +1619,7 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
         if (isPacked == "true") {
 
             // get a handle to the saved file
-            QSettings settings;
-            QString filePathString = settings.value("files/currentFileName", "error").toString();
+            QString filePathString = settingsCache::currentFileName("error");
 
             if (filePathString == "error") {
                 DBG() << "Error getting current project path - THIS SHOULD NEVER HAPPEN!";
@@ -924,7 +1635,7 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
             QFile savedData(filePath.absoluteFilePath(fileName));
 
             // check that the data file exists!
-            if (!savedData.open(QIODevice::ReadOnly)) {
+            if (!savedData.exists()) {
                 QSettings settings;
                 int num_errs = settings.beginReadArray("errors");
                 settings.endArray();
@@ -935,22 +1646,13 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
                 return;
             }
 
-            // Open the binary data file
+            // The copy into the backing store is put off until the data
+            // are first used, or until the background runner gets to it
+            // (see projectObject::open_project)
             QDir lib_dir = this->getLibDir();
-            QFile f;
-            f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-
-            // open the storage file
-            if( !f.open( QIODevice::ReadWrite | QIODevice::Truncate) ) {
-                QMessageBox msgBox;
-                msgBox.setText("csv_connection::import_parameters_from_xml(QDomNode &e): Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
-                msgBox.exec();
-                return;
-            }
-
-            // now we need to read from the savedData file and put this into a QDataStream...
-            this->import_packed_binary(savedData, f);
-            f.close();
+            this->changes.clear();
+            this->pendingImport = QSharedPointer<deferredStoreImport>
+                (new deferredStoreImport(savedData.fileName(), lib_dir.absoluteFilePath(this->uuidFilename)));
 
         } else {
             DBG() << "Old, non-packed data format is no longer supported";
@@ -968,12 +1670,10 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
         QDir lib_dir = this->getLibDir();
         f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
         if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
-            QMessageBox msgBox;
-            msgBox.setText("csv_connection::import_parameters_from_xml(QDomNode &e) [2]: Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
-            msgBox.exec();
+            SCUtilities::showMessage("csv_connection::import_parameters_from_xml(QDomNode &e) [2]: Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
             return;
         }
-        QDataStream access(&f);
+        this->writeStoreHeader (f);
 
         QDomNodeList connInstList = e.toElement().elementsByTagName("Connection");
 
@@ -982,15 +1682,15 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
         for (int i=0; i < (int)connInstList.size(); ++i) {
 
             qint32 val = connInstList.at(i).toElement().attribute("src_neuron").toUInt();
-            access << val;
+            f.write((const char*)&val, sizeof(qint32));
 
             val = connInstList.at(i).toElement().attribute("dst_neuron").toUInt();
-            access << val;
+            f.write((const char*)&val, sizeof(qint32));
 
             QString delayStr = connInstList.at(i).toElement().attribute("delay", "noDelay");
             if (delayStr != "noDelay") {
                 float val_f = delayStr.toFloat();
-                access << val_f;
+                f.write((const char*)&val_f, sizeof(float));
             } else {
                 if (this->values.size()> 2) {
                     this->values.removeLast();
@@ -1001,8 +1701,8 @@ void csv_connection::import_parameters_from_xml(QDomNode &e)
         f.close();
     }
 
-    // After loading, sort the connections.
-    this->sortData();
+    // The connections are not sorted here: the explicit list properties
+    // read after them index the rows in the order they were saved in.
 
     //// LOAD DELAY
 
@@ -1046,9 +1746,172 @@ void csv_connection::fetch_headings()
 {
 }
 
+namespace {
+    inline bool csvSpace (char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    /*
+     * The number of comma separated fields in the line [p, end), or 0 for
+     * a comment or blank line.
+     */
+    int csvFieldCount (const char* p, const char* end)
+    {
+        if (p < end && *p == '#') {
+            return 0;
+        }
+        bool blank = true;
+        int fields = 1;
+        for (; p < end; ++p) {
+            if (*p == ',') {
+                ++fields;
+            }
+            blank = blank && csvSpace (*p);
+        }
+        return blank ? 0 : fields;
+    }
+
+    /*
+     * The unsigned integer in [p, end), ignoring surrounding white space,
+     * or 0 if it is not one, as QString::toUInt gives.
+     */
+    quint32 csvParseUInt (const char* p, const char* end)
+    {
+        while (p < end && csvSpace (*p)) { ++p; }
+        while (end > p && csvSpace (*(end-1))) { --end; }
+        if (p == end) {
+            return 0;
+        }
+        quint64 v = 0;
+        for (; p < end; ++p) {
+            if (*p < '0' || *p > '9') {
+                return 0;
+            }
+            v = v*10 + (*p - '0');
+            if (v > 0xffffffffULL) {
+                return 0;
+            }
+        }
+        return (quint32)v;
+    }
+
+    /*
+     * The decimal number in [p, end), ignoring surrounding white space, or
+     * 0 if it is not one. Unlike strtod this does not depend on the locale.
+     */
+    float csvParseFloat (const char* p, const char* end)
+    {
+        while (p < end && csvSpace (*p)) { ++p; }
+        while (end > p && csvSpace (*(end-1))) { --end; }
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            ++p;
+        }
+        double mantissa = 0.0;
+        int exponent = 0;
+        int digits = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            mantissa = mantissa*10.0 + (*p - '0');
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+                mantissa = mantissa*10.0 + (*p - '0');
+                --exponent;
+            }
+        }
+        if (digits == 0) {
+            return 0.0f;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool negExp = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negExp = *p == '-';
+                ++p;
+            }
+            if (p == end) {
+                return 0.0f;
+            }
+            int e = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+                e = qMin (e*10 + (*p - '0'), 100000);
+            }
+            exponent += negExp ? -e : e;
+        }
+        if (p != end) {
+            return 0.0f;
+        }
+        double v = mantissa * pow (10.0, exponent);
+        return (float)(negative ? -v : v);
+    }
+
+    enum csvChunkError {
+        CSV_CHUNK_OK,
+        CSV_CHUNK_TOO_MANY_COLUMNS,
+        CSV_CHUNK_TOO_FEW_COLUMNS
+    };
+
+    struct csvChunk {
+        const char* begin;
+        const char* end;
+        connArrays rows;
+        csvChunkError error;
+    };
+
+    // parses the whole lines of one chunk of a CSV file into its rows
+    class csvChunkParser : public QRunnable
+    {
+    public:
+        csvChunkParser (csvChunk* chunk, int numFields) : chunk(chunk), numFields(numFields) {}
+        void run() {
+            connArrays& rows = chunk->rows;
+            rows.src.clear();
+            rows.dst.clear();
+            rows.delay.clear();
+            chunk->error = CSV_CHUNK_OK;
+            const char* p = chunk->begin;
+            while (p < chunk->end) {
+                const char* eol = (const char*) memchr (p, '\n', chunk->end - p);
+                if (eol == NULL) {
+                    eol = chunk->end;
+                }
+                int fields = csvFieldCount (p, eol);
+                if (fields > 3) {
+                    chunk->error = CSV_CHUNK_TOO_MANY_COLUMNS;
+                    return;
+                }
+                if (fields == 1) {
+                    chunk->error = CSV_CHUNK_TOO_FEW_COLUMNS;
+                    return;
+                }
+                // rows with a different number of columns from the first are skipped
+                if (fields == numFields) {
+                    const char* c1 = (const char*) memchr (p, ',', eol - p);
+                    const char* c2 = (const char*) memchr (c1 + 1, ',', eol - c1 - 1);
+                    if (c2 == NULL) {
+                        c2 = eol;
+                    }
+                    rows.src.push_back ((qint32) csvParseUInt (p, c1));
+                    rows.dst.push_back ((qint32) csvParseUInt (c1 + 1, c2));
+                    if (numFields == 3) {
+                        rows.delay.push_back (csvParseFloat (c2 + 1, eol));
+                    }
+                }
+                p = eol + 1;
+            }
+        }
+    private:
+        csvChunk* chunk;
+        int numFields;
+    };
+}
+
 bool csv_connection::import_csv (QString fileName)
 {
     DBG() << "csv_connection::import_csv(" << fileName << ") called.";
+    this->discardImport();
 
     if (fileName.isEmpty()) {
         DBG() << "No data to read, return false";
@@ -1061,148 +1924,290 @@ bool csv_connection::import_csv (QString fileName)
     // open the input csv file for reading
     QFile fileIn(fileName);
     if (!fileIn.open(QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("Could not open the selected CSV file");
-        msgBox.exec();
+        SCUtilities::showMessage("Could not open the selected CSV file");
         return import_worked;
     }
 
+    this->unmapBackingStore();
+    this->storeChanged(false);
+
     QFile f;
     QDir lib_dir = this->getLibDir();
     // Set up a temporary uuid
     f.setFileName(lib_dir.absoluteFilePath (this->uuidFilename));
     if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::import_csv(QString): Could not open temporary file '"
-                       + f.fileName() + "' for Explicit Connection");
-        msgBox.exec();
+        SCUtilities::showMessage("csv_connection::import_csv(QString): Could not open temporary file '"
+                                 + f.fileName() + "' for Explicit Connection");
         return import_worked;
     } // else the data file for this connection has now been truncated, so numRows can be set to 0.
 
     this->numRows = 0;
     this->changes.clear();
+    this->values.clear();
+    this->writeStoreHeader (f);
 
-    // use textstream so we can read lines into a QString
-    QTextStream stream(&fileIn);
-    QDataStream access(&f);
-
-    // test for consistency:
-    int numFields = -1;
-
-    // load in the csv line by line
-    while (!(stream.atEnd())) {
+    // the whole file is mapped if it can be; otherwise each batch is read in
+    qint64 size = fileIn.size();
+    const char* mapped = size > 0 ? (const char*) fileIn.map (0, size) : NULL;
 
-        // get a line
-        QString line = stream.readLine();
+    int threads = qMax (1, QThread::idealThreadCount());
+    QVector<csvChunk> chunks (threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount (threads);
+    QByteArray buffer;
+    QByteArray block;
 
-        // see if it is a comment:
-        if (line[0] == '#') {
-            continue;
+    // test for consistency: the number of columns of the first row
+    int numFields = -1;
+    int lastPercent = -1;
+    qint64 pos = 0;
+
+    while (pos < size) {
+
+        // the next batch, extended to the end of its last line
+        const char* data;
+        qint64 len;
+        if (mapped) {
+            data = mapped + pos;
+            len = qMin ((qint64)threads*CSV_IMPORT_CHUNK_BYTES, size - pos);
+            const char* eol = (const char*) memchr (data + len, '\n', size - pos - len);
+            len = eol ? eol - data + 1 : size - pos;
+        } else {
+            buffer = fileIn.read ((qint64)threads*CSV_IMPORT_CHUNK_BYTES);
+            if (buffer.isEmpty()) {
+                break;
+            }
+            if (!buffer.endsWith('\n')) {
+                buffer += fileIn.readLine();
+            }
+            data = buffer.constData();
+            len = buffer.size();
         }
+        pos += len;
 
-        // or a blank line
-        QString line2 = line;
-        line2.replace(" ", "");
-        if (line2 == "\n") {
-            continue;
+        if (numFields == -1) {
+            for (const char* p = data; p < data + len;) {
+                const char* eol = (const char*) memchr (p, '\n', data + len - p);
+                if (eol == NULL) {
+                    eol = data + len;
+                }
+                int fields = csvFieldCount (p, eol);
+                if (fields > 0) {
+                    numFields = fields;
+                    break;
+                }
+                p = eol + 1;
+            }
+            for (int i = 0; i < qMin (numFields, 3); ++i) {
+                if (i == 0) { this->values.push_back("src"); }
+                if (i == 1) { this->values.push_back("dst"); }
+                if (i == 2) { this->values.push_back("delay"); }
+            }
         }
 
-        // not a comment - so begin parsing and create an xml element
-        this->numRows++;
-
-        QStringList fields = line.split(",");
-
-        if (fields.size() > 3) {
-            QMessageBox msgBox;
-            msgBox.setText("CSV file has too many columns");
-            msgBox.exec();
-            return import_worked;
+        // split the batch into a chunk per thread at line ends
+        const char* start = data;
+        int used = 0;
+        for (int t = 0; t < threads && start < data + len; ++t) {
+            const char* stop = data + len;
+            if (t < threads - 1 && stop - start > CSV_IMPORT_CHUNK_BYTES) {
+                const char* eol = (const char*) memchr (start + CSV_IMPORT_CHUNK_BYTES, '\n', stop - start - CSV_IMPORT_CHUNK_BYTES);
+                if (eol != NULL) {
+                    stop = eol + 1;
+                }
+            }
+            chunks[t].begin = start;
+            chunks[t].end = stop;
+            pool.start (new csvChunkParser (&chunks[t], numFields));
+            start = stop;
+            ++used;
         }
+        pool.waitForDone();
 
-        if (fields.size() < 2) {
-            QMessageBox msgBox;
-            msgBox.setText("CSV file has too few columns");
-            msgBox.exec();
-            return import_worked;
+        for (int t = 0; t < used; ++t) {
+            if (chunks[t].error == CSV_CHUNK_TOO_MANY_COLUMNS) {
+                SCUtilities::showMessage("CSV file has too many columns");
+                return import_worked;
+            }
+            if (chunks[t].error == CSV_CHUNK_TOO_FEW_COLUMNS) {
+                SCUtilities::showMessage("CSV file has too few columns");
+                return import_worked;
+            }
+            this->writeStoreRows (f, chunks[t].rows, block);
+            this->numRows += chunks[t].rows.src.size();
         }
 
-        if (numFields == -1) {
-            numFields = fields.size();
-        } else if (numFields != fields.size()) {
-            DBG() << "something is wrong!";
-            --numRows;
-            continue;
-        }
-        // for each field
-        for (int i = 0; i < (int)fields.size(); ++i) {
-            if (i < 2) {
-                qint32 num = fields[i].toUInt();
-                access << num;
-            } else {
-                float num = fields[i].toFloat();
-                access << num;
-            }
+        int percent = (int)((100 * pos) / size);
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit progress (percent);
         }
     }
 
-    values.clear();
-    for (int i = 0; i < (int)numFields; ++i) {
-        if (i == 0) { this->values.push_back("src"); }
-        if (i == 1) { this->values.push_back("dst"); }
-        if (i == 2) { this->values.push_back("delay"); }
+    if (mapped) {
+        fileIn.unmap ((uchar*) mapped);
     }
 
     // flush out the output...
     f.flush();
     f.close();
 
-    // Sort the connection list now.
-    this->sortData();
+    // Sort the connection list now, moving the synapse's explicit
+    // values with the rows.
+    QVector<int> newRowOf;
+    if (this->sortData (&newRowOf)) {
+        this->permuteSynapseProperties (newRowOf);
+    }
 
     import_worked = true;
     return import_worked;
 }
 
+bool csv_connection::exportPackedBinary (const QString& exportFileName)
+{
+    // The backing store rows are already in the packed binary format,
+    // so the export is a block-wise copy of everything after the header,
+    // unless the delays are in a delay table and have to be written out.
+    this->waitForImport();
+    this->unmapBackingStore();
+    this->convertLegacyStore();
+
+    QFile f;
+    QDir lib_dir = this->getLibDir();
+    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
+    if (!f.open(QIODevice::ReadOnly)) {
+        SCUtilities::showMessage("csv_connection::exportPackedBinary: Could not open temporary file '" + f.fileName() + "' for Explicit Connection");
+        return false;
+    }
+    this->readStoreHeader (f);
+
+    QFile export_file(exportFileName);
+    if (!export_file.open( QIODevice::WriteOnly)) {
+        SCUtilities::showMessage("Error creating exported binary connection file '" + exportFileName
+                                 + "' (Check disk space; permissions)");
+        return false;
+    }
+
+    int stride = this->getStoredRowStride();
+    bool expand = this->isStoreCompact();
+    qint64 total = (qint64)this->getNumRows() * stride;
+    qint64 copied = 0;
+    int lastPercent = -1;
+    QByteArray block;
+    block.resize(CONN_STORE_BLOCK_ROWS*stride);
+    connArrays rows;
+    QByteArray packed;
+
+    while (copied < total) {
+        qint64 got = f.read(block.data(), qMin ((qint64)block.size(), total - copied));
+        if (got <= 0) {
+            DBG() << "Connection file is shorter than expected";
+            break;
+        }
+        if (expand) {
+            int n = (int)(got / stride);
+            rows.src.resize(n);
+            rows.dst.resize(n);
+            rows.delay.resize(n);
+            this->decodeStoredRows ((const uchar*)block.constData(), n, rows.src.data(), rows.dst.data(), rows.delay.data());
+            this->writeStoreRows (export_file, rows, packed);
+        }
+        if (expand ? export_file.error() != QFile::NoError : export_file.write(block.constData(), got) != got) {
+            SCUtilities::showMessage("Error writing exported binary connection file '" + exportFileName
+                                     + "' (Check disk space; permissions)");
+            return false;
+        }
+        copied += got;
+
+        int percent = (int)((100 * copied) / total);
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit progress (percent);
+        }
+    }
+
+    export_file.close();
+    f.close();
+    return true;
+}
+
+QSharedPointer<deferredStoreImport> csv_connection::getPendingImport (void) const
+{
+    return this->pendingImport;
+}
+
+void csv_connection::waitForImport (void) const
+{
+    if (!this->pendingImport) {
+        return;
+    }
+    QSharedPointer<deferredStoreImport> job = this->pendingImport;
+    this->pendingImport.clear();
+    if (!job->finish()) {
+        DBG() << "Could not copy the saved connection list into" << this->uuidFilename;
+    }
+}
+
+void csv_connection::discardImport (void) const
+{
+    if (this->pendingImport) {
+        this->pendingImport->cancel();
+        this->pendingImport.clear();
+    }
+}
+
 void csv_connection::import_packed_binary(QFile& fileIn, QFile& fileOut)
 {
+    this->unmapBackingStore();
+    this->storeChanged(false);
     this->changes.clear();
 
+    // fileOut may be a store this connection has just stopped sharing
+    QString store = this->getLibDir().absoluteFilePath (this->uuidFilename);
+    if (QFileInfo(fileOut.fileName()).absoluteFilePath() != store) {
+        fileOut.close();
+        fileOut.setFileName (store);
+        if (!fileOut.open (QIODevice::ReadWrite | QIODevice::Truncate)) {
+            DBG() << "Could not open" << store;
+            return;
+        }
+    }
+
     //wipe file;
     fileOut.resize(0);
 
     fileOut.seek(0);
 
-    QDataStream access(&fileOut);
+    // The packed binary format is the same as the rows of the
+    // backing store, so the data can be copied across block by block.
+    this->writeStoreHeader (fileOut);
 
-    int count = 0;
+    int stride = this->getRowStride();
+    QByteArray block;
+    block.resize(CONN_STORE_BLOCK_ROWS*stride);
 
-    // load in the binary packed data
+    qint64 bytes = 0;
+    qint64 total = fileIn.size();
+    int lastPercent = -1;
     while (!(fileIn.atEnd())) {
+        qint64 got = fileIn.read(block.data(), block.size());
+        if (got <= 0) {
+            break;
+        }
+        fileOut.write(block.constData(), got);
+        bytes += got;
 
-        // read in the required values:
-        // first two int32s
-        int srcVal, dstVal;
-        float delayVal;
-
-        fileIn.read((char *) &srcVal,sizeof(int));
-        fileIn.read((char *) &dstVal,sizeof(int));
-
-        // add the row...
-        qint32 num = srcVal;
-        access << num;
-        num = dstVal;
-        access << num;
-
-        // if we have a delay then read that too
-        if (this->values.size() == 3) {
-            // we have a delay
-            fileIn.read((char *) &delayVal,sizeof(float));
-            access << delayVal;
+        int percent = total > 0 ? (int)((100 * bytes) / total) : 100;
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit progress (percent);
         }
-        ++count;
     }
 
-    if (count != this->getNumRows()) {
+    if (bytes % stride != 0) {
+        DBG() << "Binary connection file does not contain a whole number of rows";
+    }
+    if (bytes / stride != this->getNumRows()) {
         DBG() << "Mismatch between the number of rows in the XML and in the binary file";
     }
 
@@ -1217,6 +2222,9 @@ int csv_connection::getNumRows() const
 
 void csv_connection::setNumRows(int num)
 {
+    if (num != this->numRows) {
+        this->storeChanged();
+    }
     this->numRows = num;
 }
 
@@ -1242,14 +2250,101 @@ void csv_connection::setNumCols(int num)
     }
 }
 
-void csv_connection::sortData (void)
+namespace {
+    // orders row numbers by the rows they refer to
+    class connRowOrder
+    {
+    public:
+        connRowOrder (const QVector<conn>& conns) : conns(conns) {}
+        bool operator() (int a, int b) const
+        {
+            // as csv_connection::sorttwo
+            if (conns[a].src != conns[b].src) {
+                return conns[a].src < conns[b].src;
+            }
+            return conns[a].dst < conns[b].dst;
+        }
+        const QVector<conn>& conns;
+    };
+}
+
+bool csv_connection::sortData (QVector<int>* newRowOf)
+{
+    // Sorting was once done unconditionally, which broke the alignment
+    // of Python generated weights with their connections; those who
+    // sort now move the weights with the rows, from newRowOf.
+    if (!settingsCache::sortConnections()) {
+        return false;
+    }
+
+    QVector<conn> conns;
+    this->getAllData (conns);
+
+    QVector<int> order(conns.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort (order.begin(), order.end(), connRowOrder (conns));
+
+    bool moved = false;
+    for (int i = 0; i < order.size() && !moved; ++i) {
+        moved = order[i] != i;
+    }
+    if (!moved) {
+        return false;
+    }
+
+    QVector<conn> sorted(conns.size());
+    if (newRowOf) {
+        newRowOf->resize(conns.size());
+    }
+    for (int i = 0; i < order.size(); ++i) {
+        sorted[i] = conns[order[i]];
+        if (newRowOf) {
+            (*newRowOf)[order[i]] = i;
+        }
+    }
+    // the delays are in the rows already
+    this->writeAllData (sorted, -1.0f);
+    return true;
+}
+
+void csv_connection::permuteSynapseProperties (const QVector<int>& newRowOf)
 {
-    // AJC 12/04/2017 - Disabled as conflicts with Python scripts that generate weights - this
-    // function causes the weights to not line up with the associated connection...
-    /*QVector<conn> clist;
-    this->getAllData (clist);
-    std::sort (clist.begin(), clist.end(), csv_connection::sorttwo);
-    this->setAllData (clist);*/
+    QSharedPointer<synapse> syn = qSharedPointerDynamicCast<synapse> (this->parent);
+    if (syn.isNull() || syn->weightUpdateCmpt.isNull()) {
+        return;
+    }
+
+    QVector<ParameterInstance*> pars;
+    for (int i = 0; i < syn->weightUpdateCmpt->ParameterList.size(); ++i) {
+        pars.push_back (syn->weightUpdateCmpt->ParameterList[i]);
+    }
+    for (int i = 0; i < syn->weightUpdateCmpt->StateVariableList.size(); ++i) {
+        pars.push_back (syn->weightUpdateCmpt->StateVariableList[i]);
+    }
+
+    for (int i = 0; i < pars.size(); ++i) {
+        ParameterInstance* par = pars[i];
+        if (par->currType != ExplicitList) {
+            continue;
+        }
+        if (par->isDense() && par->value.size() == newRowOf.size()) {
+            // a value for every row stays in row order
+            QVector<double> vals(par->value.size());
+            for (int r = 0; r < newRowOf.size(); ++r) {
+                vals[newRowOf[r]] = par->value[r];
+            }
+            par->setDenseValues (vals);
+        } else {
+            for (int k = 0; k < par->indices.size(); ++k) {
+                int r = par->indices[k];
+                if (r >= 0 && r < newRowOf.size()) {
+                    par->indices[k] = newRowOf[r];
+                }
+            }
+        }
+    }
 }
 
 bool csv_connection::sorttwo (conn a, conn b)
@@ -1259,25 +2354,102 @@ bool csv_connection::sorttwo (conn a, conn b)
     return false;
 }
 
-// Note that the connection file contains src, dst and delay. The
-// weights may be held in a separate file (an explicitDataBinaryFile).
-void csv_connection::getAllData(QVector<conn>& conns)
+bool csv_connection::readStoreHeader (QFile& f) const
 {
-    //DBG() << "csv_connection::getAllData called";
-    conns.clear();
+    connStoreHeader hdr;
+    f.seek(0);
+    this->setStoredLayout (0, NULL, 0);
+    if (f.read((char*)&hdr, sizeof(hdr)) == (qint64)sizeof(hdr)
+        && memcmp (hdr.magic, CONN_STORE_MAGIC, 4) == 0) {
+        if (hdr.version != CONN_STORE_VERSION) {
+            DBG() << "Unexpected connection store version " << hdr.version;
+        }
+        QVector<float> table;
+        if ((hdr.flags & CONN_STORE_DELAY_TABLE) && hdr.reserved <= CONN_STORE_DELAY_TABLE_MAX) {
+            table.resize(hdr.reserved);
+            qint64 bytes = (qint64)hdr.reserved * sizeof(float);
+            if (f.read((char*)table.data(), bytes) != bytes) {
+                DBG() << "Connection file delay table is shorter than expected";
+            }
+        }
+        this->setStoredLayout (hdr.flags, table.constData(), table.size());
+        return true;
+    }
+    f.seek(0);
+    return false;
+}
 
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadOnly)) {
-        return;
+namespace {
+    // the code for an index width in connStoreHeader::flags
+    quint32 storeWidthCode (int bytes)
+    {
+        return bytes == 1 ? 2 : (bytes == 2 ? 1 : 0);
+    }
+
+    int storeWidthBytes (quint32 code)
+    {
+        return code == 2 ? 1 : (code == 1 ? 2 : 4);
+    }
+
+    inline qint32 getStoredIndex (const uchar* p, int bytes)
+    {
+        if (bytes == 1) {
+            return *p;
+        } else if (bytes == 2) {
+            quint16 v;
+            memcpy (&v, p, sizeof(quint16));
+            return v;
+        }
+        qint32 v;
+        memcpy (&v, p, sizeof(qint32));
+        return v;
+    }
+
+    inline void putStoredIndex (char* p, qint32 v, int bytes)
+    {
+        if (bytes == 1) {
+            *p = (char)(quint8)v;
+        } else if (bytes == 2) {
+            quint16 w = (quint16)v;
+            memcpy (p, &w, sizeof(quint16));
+        } else {
+            memcpy (p, &v, sizeof(qint32));
+        }
+    }
+}
+
+void csv_connection::writeStoreHeader (QFile& f, const QVector<float>& table, int srcBytes, int dstBytes) const
+{
+    connStoreHeader hdr;
+    memcpy (hdr.magic, CONN_STORE_MAGIC, 4);
+    hdr.version = CONN_STORE_VERSION;
+    hdr.flags = (table.isEmpty() ? 0 : CONN_STORE_DELAY_TABLE)
+        | (storeWidthCode (srcBytes) << CONN_STORE_SRC_WIDTH_SHIFT)
+        | (storeWidthCode (dstBytes) << CONN_STORE_DST_WIDTH_SHIFT);
+    hdr.reserved = table.size();
+    f.write((const char*)&hdr, sizeof(hdr));
+    if (!table.isEmpty()) {
+        f.write((const char*)table.constData(), (qint64)table.size()*sizeof(float));
+    }
+    this->setStoredLayout (hdr.flags, table.constData(), table.size());
+}
+
+void csv_connection::setStoredLayout (quint32 flags, const float* table, int tableSize) const
+{
+    this->storedSrcBytes = storeWidthBytes ((flags >> CONN_STORE_SRC_WIDTH_SHIFT) & 3);
+    this->storedDstBytes = storeWidthBytes ((flags >> CONN_STORE_DST_WIDTH_SHIFT) & 3);
+    this->delayTable.clear();
+    if ((flags & CONN_STORE_DELAY_TABLE) && tableSize > 0) {
+        this->delayTable.resize(tableSize);
+        memcpy (this->delayTable.data(), table, tableSize*sizeof(float));
     }
+}
 
+void csv_connection::getAllDataLegacy (QFile& f, QVector<conn>& conns) const
+{
     QDataStream access(&f);
 
-    //DBG() << "There are " << this->getNumRows() << " rows and " << this->getNumCols() << " cols";
     conns.resize(this->getNumRows());
-    int counter = 0;
 
     for (int i = 0; i < this->getNumRows(); ++i) {
 
@@ -1297,100 +2469,294 @@ void csv_connection::getAllData(QVector<conn>& conns)
         newConn.src = src;
         newConn.dst = dst;
 
-        conns[counter] = (newConn);
-        ++counter;
+        conns[i] = newConn;
     }
-
-    f.close();
 }
 
-float csv_connection::getData(int rowV, int col) const
+// Note that the connection file contains src, dst and delay. The
+// weights may be held in a separate file (an explicitDataBinaryFile).
+void csv_connection::getAllData(QVector<conn>& conns) const
 {
+    PROFILE_SCOPE("csv_connection::getAllData");
+    this->waitForImport();
+    conns.clear();
+
     QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
     if (!f.open( QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::getData(int, int): Could not open file for Explicit Connection");
-        msgBox.exec();
-        return -0.1f;
+        return;
     }
 
-    // we multiply by cols +1 as QT seems to do some padding on the stream
-    int colVal = this->getNumCols();
-    if (colVal > 2) { ++colVal; }
-    int seekTo = rowV*(colVal)+col;
-
-    if (seekTo*4 > f.size()) {
-        return -1;
+    if (!this->readStoreHeader (f)) {
+        this->getAllDataLegacy (f, conns);
+        f.close();
+        return;
     }
 
-    f.seek(seekTo*4); // seek to location in bytes
+    Q_STATIC_ASSERT(sizeof(conn) == 3*sizeof(qint32));
 
-    // get a datastream to serialise the data
-    QDataStream access(&f);
-    if (col < 2) {
-        qint32 data;
-        access >> data;
-        f.close();
-        return float(data);
+    int nr = this->getNumRows();
+    if (this->isStoreCompact()) {
+        int stride = this->getStoredRowStride();
+        QByteArray rows = f.read((qint64)nr*stride);
+        int n = rows.size() / stride;
+        if (n < nr) {
+            DBG() << "Connection file is shorter than expected";
+        }
+        QVector<qint32> src(n);
+        QVector<qint32> dst(n);
+        QVector<float> del(n);
+        this->decodeStoredRows ((const uchar*)rows.constData(), n, src.data(), dst.data(), del.data());
+        conns.resize(n);
+        for (int i = 0; i < n; ++i) {
+            conns[i].src = src[i];
+            conns[i].dst = dst[i];
+            conns[i].metric = del[i];
+        }
+    } else if (this->getNumCols() > 2) {
+        // A row in the file has exactly the layout of a conn, so read
+        // the whole list in one go.
+        conns.resize(nr);
+        qint64 got = f.read((char*)conns.data(), (qint64)nr*sizeof(conn));
+        if (got < (qint64)nr*(qint64)sizeof(conn)) {
+            DBG() << "Connection file is shorter than expected";
+            conns.resize(got > 0 ? (int)(got/sizeof(conn)) : 0);
+        }
     } else {
-        float data;
-        access >> data;
-        f.close();
-        return data;
+        QVector<qint32> rows(2*nr);
+        qint64 got = f.read((char*)rows.data(), (qint64)rows.size()*sizeof(qint32));
+        int n = got > 0 ? (int)(got/(2*sizeof(qint32))) : 0;
+        if (n < nr) {
+            DBG() << "Connection file is shorter than expected";
+        }
+        conns.resize(n);
+        for (int i = 0; i < n; ++i) {
+            conns[i].src = rows[2*i];
+            conns[i].dst = rows[2*i+1];
+            conns[i].metric = 0.0f;
+        }
     }
 
-    return -0.1f;
+    f.close();
 }
 
-float csv_connection::getData(QModelIndex &index) const
+void csv_connection::getAllData (connArrays& arrays) const
 {
-    QFile f;
-    QDir lib_dir = this->getLibDir();
-    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::getData(QModelIndex&): Could not open file '"
-                       + this->uuidFilename + "' for Explicit Connection");
-        msgBox.exec();
-        return -0.1f;
-    }
+    PROFILE_SCOPE("csv_connection::getAllData");
+    arrays.src.clear();
+    arrays.dst.clear();
+    arrays.delay.clear();
 
-    int colVal = getNumCols();
-    if (colVal > 2) ++colVal;
-    // we multiply by cols +1 as QT seems to do some padding on the stream
-    int seekTo = index.row()*(colVal)+index.column();
+    if (!this->mapBackingStore()) {
+        return;
+    }
 
-    if (seekTo*4 > f.size()) {
-        return -1;
+    if (this->mappedLegacy) {
+        QVector<conn> conns;
+        this->getAllData (conns);
+        arrays.src.resize(conns.size());
+        arrays.dst.resize(conns.size());
+        if (this->getNumCols() > 2) {
+            arrays.delay.resize(conns.size());
+        }
+        for (int i = 0; i < conns.size(); ++i) {
+            arrays.src[i] = conns[i].src;
+            arrays.dst[i] = conns[i].dst;
+            if (!arrays.delay.isEmpty()) {
+                arrays.delay[i] = conns[i].metric;
+            }
+        }
+        return;
     }
 
-    f.seek(seekTo*4); // seek to location in bytes
+    int stride = this->getStoredRowStride();
+    qint64 avail = qMax ((qint64)0, this->mappedSize - this->getStoredRowsOffset()) / stride;
+    int nr = qMin ((qint64)this->getNumRows(), avail);
 
-    // get a datastream to serialise the data
-    QDataStream access(&f);
-    if (index.column() < 2) {
-        qint32 data;
-        access >> data;
-        f.close();
-        return float(data);
-    }
-    else {
-        float data;
-        access >> data;
-        f.close();
-        return data;
+    arrays.src.resize(nr);
+    arrays.dst.resize(nr);
+    bool hasDelay = this->getNumCols() > 2;
+    if (hasDelay) {
+        arrays.delay.resize(nr);
     }
 
-    return -0.1f;
+    // De-interleave straight from the mapped file
+    this->decodeStoredRows (this->mappedData + this->getStoredRowsOffset(), nr, arrays.src.data(),
+                            arrays.dst.data(), hasDelay ? arrays.delay.data() : NULL);
 }
 
-/*!
- * Character sets useful when calling sanitize function.
- *
- * These are ordered so that the most common chars appear earliest.
- */
+bool csv_connection::mapBackingStore (void) const
+{
+    residencyManager::touch (this);
+    if (this->mappedData != NULL) {
+        return true;
+    }
+
+    this->waitForImport();
+
+    QDir lib_dir = this->getLibDir();
+    this->mappedFile.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
+    if (!this->mappedFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    this->mappedSize = this->mappedFile.size();
+    if (this->mappedSize > 0) {
+        this->mappedData = this->mappedFile.map(0, this->mappedSize);
+    }
+    if (this->mappedData == NULL) {
+        // Nothing to map (empty file) or the map failed.
+        this->mappedSize = 0;
+        this->mappedFile.close();
+        return false;
+    }
+
+    this->mappedLegacy = !(this->mappedSize >= (qint64)sizeof(connStoreHeader)
+                           && memcmp (this->mappedData, CONN_STORE_MAGIC, 4) == 0);
+
+    this->setStoredLayout (0, NULL, 0);
+    if (!this->mappedLegacy) {
+        connStoreHeader hdr;
+        memcpy (&hdr, this->mappedData, sizeof(hdr));
+        bool tableFits = hdr.reserved <= CONN_STORE_DELAY_TABLE_MAX
+            && (qint64)sizeof(hdr) + (qint64)hdr.reserved*sizeof(float) <= this->mappedSize;
+        this->setStoredLayout (hdr.flags, (const float*)(this->mappedData + sizeof(hdr)), tableFits ? hdr.reserved : 0);
+    }
+
+    // The mapping remains valid after the file is closed.
+    this->mappedFile.close();
+    return true;
+}
+
+void csv_connection::unmapBackingStore (void) const
+{
+    if (this->mappedData != NULL) {
+        this->mappedFile.unmap(this->mappedData);
+        this->mappedData = NULL;
+    }
+    this->mappedSize = 0;
+    if (this->mappedFile.isOpen()) {
+        this->mappedFile.close();
+    }
+}
+
+int csv_connection::getRowStride (void) const
+{
+    return this->getNumCols() > 2 ? 3*sizeof(qint32) : 2*sizeof(qint32);
+}
+
+bool csv_connection::isStoreCompact (void) const
+{
+    return this->storedSrcBytes != (int)sizeof(qint32) || this->storedDstBytes != (int)sizeof(qint32)
+        || (this->getNumCols() > 2 && !this->delayTable.isEmpty());
+}
+
+int csv_connection::getStoredRowStride (void) const
+{
+    int delayBytes = 0;
+    if (this->getNumCols() > 2) {
+        if (this->delayTable.isEmpty()) {
+            delayBytes = sizeof(float);
+        } else if (this->delayTable.size() > 1) {
+            delayBytes = sizeof(quint16);
+        }
+    }
+    return this->storedSrcBytes + this->storedDstBytes + delayBytes;
+}
+
+qint64 csv_connection::getStoredRowsOffset (void) const
+{
+    return (qint64)sizeof(connStoreHeader) + (qint64)this->delayTable.size()*sizeof(float);
+}
+
+void csv_connection::decodeStoredRows (const uchar* p, int count, qint32* src, qint32* dst, float* del) const
+{
+    int stride = this->getStoredRowStride();
+    bool hasDelay = this->getNumCols() > 2;
+    int tableSize = this->delayTable.size();
+    const float* table = this->delayTable.constData();
+    int srcBytes = this->storedSrcBytes;
+    int dstBytes = this->storedDstBytes;
+    for (int i = 0; i < count; ++i, p += stride) {
+        src[i] = getStoredIndex (p, srcBytes);
+        dst[i] = getStoredIndex (p+srcBytes, dstBytes);
+        if (del == NULL) {
+            continue;
+        }
+        const uchar* d = p + srcBytes + dstBytes;
+        if (!hasDelay) {
+            del[i] = 0.0f;
+        } else if (tableSize == 0) {
+            memcpy (del+i, d, sizeof(float));
+        } else if (tableSize == 1) {
+            del[i] = table[0];
+        } else {
+            quint16 code;
+            memcpy (&code, d, sizeof(quint16));
+            del[i] = code < tableSize ? table[code] : 0.0f;
+        }
+    }
+}
+
+int csv_connection::getLegacyRowStride (void) const
+{
+    // src and dst are qint32; a delay is serialised as a double
+    return this->getNumCols() > 2 ? 16 : 8;
+}
+
+float csv_connection::getData(int rowV, int col) const
+{
+    if (!this->mapBackingStore()) {
+        ioService::reportError("csv_connection::getData(int, int): Could not open file for Explicit Connection");
+        return -0.1f;
+    }
+
+    if (this->mappedLegacy) {
+        qint64 offset = (qint64)rowV * this->getLegacyRowStride() + (qint64)col * 4;
+        qint64 width = (col < 2) ? sizeof(qint32) : sizeof(double);
+        if (offset + width > this->mappedSize) {
+            return -1;
+        }
+        // The data is big-endian, as written by QDataStream
+        const uchar* p = this->mappedData + offset;
+        if (col < 2) {
+            return float(qFromBigEndian<qint32>(p));
+        } else {
+            quint64 bits = qFromBigEndian<quint64>(p);
+            double data;
+            memcpy (&data, &bits, sizeof(double));
+            return float(data);
+        }
+    }
+
+    // the delay may be held in the delay table
+    qint64 offset = this->getStoredRowsOffset() + (qint64)rowV * this->getStoredRowStride();
+    if (offset + this->getStoredRowStride() > this->mappedSize) {
+        return -1;
+    }
+
+    qint32 src, dst;
+    float delay;
+    this->decodeStoredRows (this->mappedData + offset, 1, &src, &dst, &delay);
+    if (col == 0) {
+        return float(src);
+    } else if (col == 1) {
+        return float(dst);
+    }
+    return delay;
+}
+
+float csv_connection::getData(QModelIndex &index) const
+{
+    return this->getData (index.row(), index.column());
+}
+
+/*!
+ * Character sets useful when calling sanitize function.
+ *
+ * These are ordered so that the most common chars appear earliest.
+ */
 //@{
 #define CHARS_NUMERIC            "0123456789"
 #define CHARS_ALPHA              "etaoinshrdlcumwfgypbvkjxqzETAOINSHRDLCUMWFGYPBVKJXQZ"
@@ -1506,135 +2872,147 @@ void csv_connection::updateDataForNumCols (int num)
 
 void csv_connection::setData(const QModelIndex & index, float value)
 {
+    this->setData (index.row(), index.column(), value);
+}
+
+void csv_connection::convertLegacyStore (void)
+{
+    this->waitForImport();
     QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadWrite)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setData(const QModelIndex&, float): Could not open temporary file " + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
+    if (!f.open(QIODevice::ReadOnly)) {
         return;
     }
-
-    // get a datastream to serialise the data
-    f.seek(f.size());
-
-    QDataStream access(&f);
-
-    if (index.row() > this->getNumRows()) {
-        // resize
-        for (int i = getNumRows()*getNumCols(); i < getNumCols()*index.row(); ++i) {
-            qint32 num = 0;
-            access << num;
-        }
-    }
-
-    int colVal = getNumCols();
-    if (colVal > 2) ++colVal;
-    int seekTo = index.row()*(colVal)+index.column();
-
-    f.seek(seekTo*4); // seek to location in bytes
-
-    if (index.column() < 2) {
-        access << (qint32) value;
-    } else {
-        access << (float) value;
+    if (f.size() == 0 || this->readStoreHeader (f)) {
+        f.close();
+        return;
     }
-    f.flush();
+    QVector<conn> conns;
+    this->getAllDataLegacy (f, conns);
     f.close();
+    this->writeAllData (conns, -1.0f);
 }
 
-void
-csv_connection::setupDataStream (QFile& f, QDataStream& ds)
+void csv_connection::expandCompactStore (void)
 {
+    QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
-    if (!f.open( QIODevice::ReadWrite)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setupDataStream(QFile&): Could not open temporary file "
-                       + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
+    if (!f.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    if (!this->readStoreHeader (f) || !this->isStoreCompact()) {
+        f.close();
         return;
     }
-    // get a datastream to serialise the data
-    f.seek(f.size());
-    ds.setDevice(&f);
-    return;
-}
-
-void
-csv_connection::shutdownDataStream (QFile& f)
-{
-    f.flush();
     f.close();
+    QVector<conn> conns;
+    this->getAllData (conns);
+    this->writeAllData (conns, -1.0f, false);
 }
 
 void csv_connection::setData(int row, int col, float value)
 {
+    this->waitForImport();
+    this->unmapBackingStore();
+    this->storeChanged();
+    this->convertLegacyStore();
+    this->expandCompactStore();
+
     QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
     if (!f.open( QIODevice::ReadWrite)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setData(int, int, float): Could not open temporary file "
-                       + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
+        ioService::reportError("csv_connection::setData(int, int, float): Could not open temporary file "
+                               + this->uuidFilename + " for Explicit Connection");
         return;
     }
 
-    // get a datastream to serialise the data
-    f.seek(f.size());
-
-    QDataStream access(&f);
-
-    if (row > this->getNumRows()) {
-        // resize
-        for (int i = getNumRows()*getNumCols(); i < getNumCols()*row; ++i) {
-            qint32 num = 0;
-            access << num;
-        }
+    if (f.size() < (qint64)sizeof(connStoreHeader)) {
+        f.resize(0);
+        f.seek(0);
+        this->writeStoreHeader (f);
     }
 
-    int colVal = getNumCols();
-    if (colVal > 2) ++colVal;
-    int seekTo = row*(colVal)+col;
+    // Grow the file with zeros if row lies beyond the end
+    qint64 rowEnd = (qint64)sizeof(connStoreHeader) + (qint64)(row+1) * this->getRowStride();
+    if (f.size() < rowEnd) {
+        f.resize(rowEnd);
+    }
 
-    f.seek(seekTo*4); // seek to location in bytes
+    f.seek((qint64)sizeof(connStoreHeader) + (qint64)row * this->getRowStride() + (qint64)col * 4);
 
     if (col < 2) {
-        access << (qint32) value;
+        qint32 num = (qint32) value;
+        f.write((const char*)&num, sizeof(qint32));
     } else {
-        access << (float) value;
+        f.write((const char*)&value, sizeof(float));
     }
     f.flush();
     f.close();
 }
 
-void csv_connection::setAllData (QVector<conn>& conns)
+void csv_connection::writeAllData (const QVector<conn>& conns, float singleDelay, bool compact)
 {
+    this->discardImport();
+    this->unmapBackingStore();
+    this->storeChanged(false);
+
     QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
     if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
-        QMessageBox msgBox;
-        msgBox.setText("csv_connection::setAllData(QVector<conn>&): Could not open temporary file "
-                       + this->uuidFilename + " for Explicit Connection");
-        msgBox.exec();
+        ioService::reportError("csv_connection::setAllData(QVector<conn>&): Could not open temporary file "
+                               + this->uuidFilename + " for Explicit Connection");
         return;
     }
 
-    // get a datastream to serialise the data
-    f.seek(f.size());
+    int nc = this->getNumCols();
 
-    QDataStream access(&f);
+    Q_STATIC_ASSERT(sizeof(conn) == 3*sizeof(qint32));
+    if (compact && !conns.isEmpty()) {
+        const conn* c = conns.constData();
+        bool single = nc == 3 && singleDelay > 1.0;
+        if (this->writeCompactStore (f, conns.size(), &c->src, &c->dst,
+                                     single ? &singleDelay : &c->metric, 3, single ? 0 : 3)) {
+            f.close();
+            return;
+        }
+    }
 
-    int nc = this->getNumCols();
+    this->writeStoreHeader (f);
 
-    int seekTo = 0;
-    f.seek(seekTo*4);
+    if (nc == 3 && singleDelay <= 1.0) {
+        // The rows have the same layout as conn, so write them in one go
+        f.write((const char*)conns.constData(), (qint64)conns.size()*sizeof(conn));
+
+    } else {
+        int stride = this->getRowStride();
+        QByteArray block;
+        block.resize(CONN_STORE_BLOCK_ROWS*stride);
+        const conn* c = conns.constData();
+        for (int start = 0; start < conns.size(); start += CONN_STORE_BLOCK_ROWS) {
+            int count = qMin (CONN_STORE_BLOCK_ROWS, conns.size() - start);
+            char* p = block.data();
+            for (int i = start; i < start + count; ++i, p += stride) {
+                memcpy (p, &c[i].src, sizeof(qint32));
+                memcpy (p+sizeof(qint32), &c[i].dst, sizeof(qint32));
+                if (nc == 3) {
+                    memcpy (p+2*sizeof(qint32), &singleDelay, sizeof(float));
+                }
+            }
+            f.write(block.constData(), (qint64)count*stride);
+        }
+    }
 
+    f.close();
+}
+
+void csv_connection::setAllData (QVector<conn>& conns)
+{
     float singleDelay = -1.0;
-    if (nc == 3) {
+    if (this->getNumCols() == 3) {
         if (this->delay != (ParameterInstance*)0) {
             if (this->delay->currType == FixedValue) {
                 singleDelay = (float)this->delay->value[0];
@@ -1653,24 +3031,203 @@ void csv_connection::setAllData (QVector<conn>& conns)
         }
     }
 
-    for (int i = 0; i<conns.size(); ++i) {
-        access << (qint32) conns[i].src;
-        access << (qint32) conns[i].dst;
-        if (nc == 3) {
-            if (singleDelay > 1.0) {
-                access << (float) singleDelay;
-            } else {
-                access << (float) conns[i].metric;
+    this->writeAllData (conns, singleDelay);
+}
+
+void csv_connection::setAllData (const connArrays& arrays)
+{
+    this->discardImport();
+    this->unmapBackingStore();
+    this->storeChanged(false);
+
+    QFile f;
+    QDir lib_dir = this->getLibDir();
+    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
+    if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
+        ioService::reportError("csv_connection::setAllData(const connArrays&): Could not open temporary file "
+                               + this->uuidFilename + " for Explicit Connection");
+        return;
+    }
+
+    // missing delays are written as 0, as by writeStoreRows()
+    int n = qMin (arrays.src.size(), arrays.dst.size());
+    const float zero = 0.0f;
+    bool hasDelays = arrays.delay.size() >= n;
+    if (n > 0
+        && this->writeCompactStore (f, n, arrays.src.constData(), arrays.dst.constData(),
+                                    hasDelays ? arrays.delay.constData() : &zero, 1, hasDelays ? 1 : 0)) {
+        f.close();
+        return;
+    }
+
+    this->writeStoreHeader (f);
+
+    QByteArray block;
+    this->writeStoreRows (f, arrays, block);
+
+    f.close();
+}
+
+bool csv_connection::writeCompactStore (QFile& f, int n, const qint32* src, const qint32* dst,
+                                        const float* del, int stride, int delStride) const
+{
+    // the narrowest indices which hold every row; neuron indices are
+    // never negative, but a list which has them is kept as it is
+    qint32 minIndex = 0;
+    qint32 maxSrc = 0;
+    qint32 maxDst = 0;
+    for (int i = 0; i < n; ++i) {
+        qint32 s = src[(qint64)i*stride];
+        qint32 d = dst[(qint64)i*stride];
+        minIndex = qMin (minIndex, qMin (s, d));
+        maxSrc = qMax (maxSrc, s);
+        maxDst = qMax (maxDst, d);
+    }
+    int srcBytes = sizeof(qint32);
+    int dstBytes = sizeof(qint32);
+    if (minIndex >= 0) {
+        srcBytes = maxSrc <= 0xff ? 1 : (maxSrc <= 0xffff ? 2 : 4);
+        dstBytes = maxDst <= 0xff ? 1 : (maxDst <= 0xffff ? 2 : 4);
+    }
+
+    // number the distinct delays by their bits, so that the table holds
+    // exactly the values given; neighbouring rows often share a delay
+    bool hasDelay = this->getNumCols() > 2;
+    QVector<float> table;
+    QVector<quint16> codes;
+    if (hasDelay) {
+        codes.resize(n);
+        QHash<quint32, quint16> found;
+        quint32 lastBits = 0;
+        quint16 lastCode = 0;
+        for (int i = 0; i < n; ++i) {
+            const float* d = del + (qint64)i*delStride;
+            quint32 bits;
+            memcpy (&bits, d, sizeof(float));
+            if (i == 0 || bits != lastBits) {
+                QHash<quint32, quint16>::const_iterator it = found.constFind (bits);
+                if (it == found.constEnd()) {
+                    if (table.size() == CONN_STORE_DELAY_TABLE_MAX) {
+                        table.clear();
+                        codes.clear();
+                        break;
+                    }
+                    it = found.insert (bits, (quint16)table.size());
+                    table.push_back (*d);
+                }
+                lastBits = bits;
+                lastCode = it.value();
             }
+            codes[i] = lastCode;
         }
-        f.flush();
     }
 
+    if (srcBytes == (int)sizeof(qint32) && dstBytes == (int)sizeof(qint32) && table.isEmpty()) {
+        return false;
+    }
+
+    this->writeStoreHeader (f, table, srcBytes, dstBytes);
+
+    int rowStride = this->getStoredRowStride();
+    bool floatDelays = hasDelay && table.isEmpty();
+    bool indexed = table.size() > 1;
+    QByteArray block;
+    block.resize(CONN_STORE_BLOCK_ROWS*rowStride);
+    for (int start = 0; start < n; start += CONN_STORE_BLOCK_ROWS) {
+        int count = qMin (CONN_STORE_BLOCK_ROWS, n - start);
+        char* p = block.data();
+        for (int i = start; i < start + count; ++i, p += rowStride) {
+            putStoredIndex (p, src[(qint64)i*stride], srcBytes);
+            putStoredIndex (p+srcBytes, dst[(qint64)i*stride], dstBytes);
+            if (floatDelays) {
+                memcpy (p+srcBytes+dstBytes, del + (qint64)i*delStride, sizeof(float));
+            } else if (indexed) {
+                memcpy (p+srcBytes+dstBytes, codes.constData()+i, sizeof(quint16));
+            }
+        }
+        f.write(block.constData(), (qint64)count*rowStride);
+    }
+    return true;
+}
+
+void csv_connection::writeStoreRows (QFile& f, const connArrays& arrays, QByteArray& block) const
+{
+    int nc = this->getNumCols();
+    int stride = this->getRowStride();
+    int n = qMin (arrays.src.size(), arrays.dst.size());
+    const qint32* src = arrays.src.constData();
+    const qint32* dst = arrays.dst.constData();
+    const float* del = arrays.delay.size() >= n ? arrays.delay.constData() : NULL;
+    const float zero = 0.0f;
+
+    block.resize(CONN_STORE_BLOCK_ROWS*stride);
+    for (int start = 0; start < n; start += CONN_STORE_BLOCK_ROWS) {
+        int count = qMin (CONN_STORE_BLOCK_ROWS, n - start);
+        char* p = block.data();
+        for (int i = start; i < start + count; ++i, p += stride) {
+            memcpy (p, src+i, sizeof(qint32));
+            memcpy (p+sizeof(qint32), dst+i, sizeof(qint32));
+            if (nc == 3) {
+                memcpy (p+2*sizeof(qint32), del ? del+i : &zero, sizeof(float));
+            }
+        }
+        f.write(block.constData(), (qint64)count*stride);
+    }
+}
+
+namespace {
+    // appends each block of generated connections to a backing store
+    class storeRowWriter : public fixedProbSink
+    {
+    public:
+        storeRowWriter (const csv_connection* owner, QFile& f,
+                        void (csv_connection::*write)(QFile&, const connArrays&, QByteArray&) const)
+            : owner(owner), f(f), write(write), rows(0) {}
+        bool addConnections (const connArrays& block) {
+            (owner->*write) (f, block, buffer);
+            rows += block.src.size();
+            return f.error() == QFile::NoError;
+        }
+        const csv_connection* owner;
+        QFile& f;
+        void (csv_connection::*write)(QFile&, const connArrays&, QByteArray&) const;
+        QByteArray buffer;
+        qint64 rows;
+    };
+}
+
+void csv_connection::setAllData (const fixedProb_connection& fixedProb, int numSrc, int numDst)
+{
+    this->discardImport();
+    this->unmapBackingStore();
+    this->storeChanged(false);
+
+    QFile f;
+    QDir lib_dir = this->getLibDir();
+    f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
+    if (!f.open( QIODevice::ReadWrite | QIODevice::Truncate)) {
+        ioService::reportError("csv_connection::setAllData(const fixedProb_connection&): Could not open temporary file "
+                               + this->uuidFilename + " for Explicit Connection");
+        return;
+    }
+
+    this->writeStoreHeader (f);
+
+    storeRowWriter writer (this, f, &csv_connection::writeStoreRows);
+    if (!fixedProb.generate (numSrc, numDst, writer)) {
+        DBG() << "csv_connection::setAllData(const fixedProb_connection&): write failed after " << writer.rows << " rows";
+    }
+    this->numRows = (int)writer.rows;
+
     f.close();
 }
 
 void csv_connection::clearData()
 {
+    this->discardImport();
+    this->unmapBackingStore();
+    this->storeChanged(false);
+
     QFile f;
     QDir lib_dir = this->getLibDir();
     f.setFileName(lib_dir.absoluteFilePath(this->uuidFilename));
@@ -1683,6 +3240,7 @@ void csv_connection::clearData()
 
 void csv_connection::abortChanges()
 {
+    this->unmapBackingStore();
     this->changes.clear();
 }
 
@@ -1695,12 +3253,481 @@ void csv_connection::copyDataValues (const csv_connection* other)
         // Direct copy data...
         maxcol = other->getNumCols();
     } // else copy data cols 1 and 2 only - maxcols remains 2.
+    other->waitForImport();
+
+    QVector<conn> conns;
+    other->getAllData (conns);
+    if (maxcol == 2) {
+        for (int i = 0; i < conns.size(); ++i) {
+            conns[i].metric = 0.0f;
+        }
+    }
+    this->writeAllData (conns, -1.0f);
+    this->numRows = conns.size();
+}
+
+const connectionAdjacency& csv_connection::getAdjacency (void) const
+{
+    residencyManager::touch (this);
+    if (this->adjacencyValid) {
+        return this->adjacency;
+    }
+    this->adjacencyValid = true;
+
+    if (!this->loadAdjacency()) {
+        connArrays arrays;
+        this->getAllData (arrays);
+        this->adjacency.build (arrays);
+        this->saveAdjacency();
+    }
+    return this->adjacency;
+}
+
+qint64 csv_connection::getResidentBytes (void) const
+{
+    return this->adjacency.bytes() + this->mappedSize
+        + (qint64)this->changes.size() * sizeof(change);
+}
+
+qint64 csv_connection::residentBytes (void) const
+{
+    return this->adjacency.bytes() + this->mappedSize;
+}
+
+void csv_connection::evictResident (void)
+{
+    this->releaseResident();
+}
+
+void csv_connection::releaseResident (void) const
+{
+    if (this->adjacencyValid && !this->adjacency.isEmpty()) {
+        // so that it is read back rather than rebuilt
+        this->saveAdjacency();
+    }
+    this->adjacency.clear();
+    this->adjacencyValid = false;
+    this->unmapBackingStore();
+}
+
+int csv_connection::getOutDegree (int src) const
+{
+    return this->getAdjacency().outDegree (src);
+}
+
+int csv_connection::getInDegree (int dst) const
+{
+    return this->getAdjacency().inDegree (dst);
+}
+
+const int* csv_connection::getOutgoing (int src, int& count) const
+{
+    return this->getAdjacency().outgoing (src, count);
+}
+
+const int* csv_connection::getIncoming (int dst, int& count) const
+{
+    return this->getAdjacency().incoming (dst, count);
+}
+
+void csv_connection::storeChanged (bool keepContents)
+{
+    if (this->storeShare->ref.fetchAndAddOrdered(0) > 1) {
+        // leave the shared store, and its index, to the other connections
+        this->unmapBackingStore();
+        this->adjacency.clear();
+        this->adjacencyValid = false;
+        QDir lib_dir = this->getLibDir();
+        QString shared = lib_dir.absoluteFilePath (this->uuidFilename);
+        this->generateUUIDFilename();
+        if (keepContents && !QFile::copy (shared, lib_dir.absoluteFilePath (this->uuidFilename))) {
+            DBG() << "Could not copy the shared connection list" << shared;
+        }
+        this->storeShare = new connStoreShare;
+    }
+    ++this->storeGeneration;
+    this->invalidateAdjacency();
+    if (!this->uuidFilename.isEmpty()) {
+        QFile::remove (this->getLibDir().absoluteFilePath (this->getStatisticsFileName()));
+    }
+}
+
+QByteArray csv_connection::getExportKey (void) const
+{
+    return (this->uuidFilename + ":" + QString::number(this->storeGeneration)
+            + ":" + QString::number(this->getNumRows()) + ":" + QString::number(this->getNumCols())).toUtf8();
+}
+
+void csv_connection::invalidateAdjacency (void)
+{
+    this->adjacency.clear();
+    this->adjacencyValid = false;
+    if (this->uuidFilename.isEmpty()) {
+        return;
+    }
+    QDir lib_dir = this->getLibDir();
+    QFile::remove (lib_dir.absoluteFilePath (this->getAdjacencyFileName()));
+}
+
+QString csv_connection::getAdjacencyFileName (void) const
+{
+    QString name = this->uuidFilename;
+    if (name.endsWith (".bin")) {
+        name.chop (4);
+    }
+    return name + ".adj";
+}
+
+bool csv_connection::loadAdjacency (void) const
+{
+    this->waitForImport();
+    QDir lib_dir = this->getLibDir();
+    QFileInfo storeInfo (lib_dir.absoluteFilePath (this->uuidFilename));
+    QFile f (lib_dir.absoluteFilePath (this->getAdjacencyFileName()));
+    if (!storeInfo.exists() || !f.open (QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // written before the backing store last changed
+    if (QFileInfo(f).lastModified() < storeInfo.lastModified()) {
+        f.close();
+        return false;
+    }
+
+    connAdjacencyHeader h;
+    bool ok = f.read ((char*)&h, sizeof(h)) == (qint64)sizeof(h)
+        && memcmp (h.magic, CONN_ADJACENCY_MAGIC, 4) == 0
+        && h.version == CONN_ADJACENCY_VERSION
+        && h.storeSize == storeInfo.size()
+        && h.numRows == this->numRows
+        && this->adjacency.read (f);
+    f.close();
+    if (!ok) {
+        this->adjacency.clear();
+    }
+    return ok;
+}
+
+void csv_connection::saveAdjacency (void) const
+{
+    this->waitForImport();
+    QDir lib_dir = this->getLibDir();
+    QFileInfo storeInfo (lib_dir.absoluteFilePath (this->uuidFilename));
+    if (!storeInfo.exists()) {
+        return;
+    }
+    QFile f (lib_dir.absoluteFilePath (this->getAdjacencyFileName()));
+    if (!f.open (QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+
+    connAdjacencyHeader h;
+    memcpy (h.magic, CONN_ADJACENCY_MAGIC, 4);
+    h.version = CONN_ADJACENCY_VERSION;
+    h.storeSize = storeInfo.size();
+    h.numRows = this->numRows;
+    h.reserved = 0;
+    bool ok = f.write ((const char*)&h, sizeof(h)) == (qint64)sizeof(h)
+        && this->adjacency.write (f);
+    f.close();
+    if (!ok) {
+        f.remove();
+    }
+}
+
+namespace {
+    // what one block of rows of a csv_connection adds to its statistics
+    struct connStatsPart {
+        QVector<int> out;
+        QVector<int> in;
+        qint32 minSrc;
+        qint32 maxSrc;
+        qint32 minDst;
+        qint32 maxDst;
+        qint64 outOfRange;
+        double minDelay;
+        double maxDelay;
+        double sumDelay;
+        QVector<double> delayHistogram;
+    };
+}
+
+// counts rows [first, end) into part, then with whole set, once the range
+// of the delays is known, bins their delays
+class connStatsRunner : public QRunnable
+{
+public:
+    connStatsRunner(const csv_connection* conn, const connArrays* arrays, int first, int end,
+                    connStatsPart* part, const connectionStatistics* whole)
+        : conn(conn), arrays(arrays), first(first), end(end), part(part), whole(whole) {}
+    void run() {
+        bool delays = this->arrays ? !this->arrays->delay.isEmpty() : this->conn->getNumCols() > 2;
+        int block = qMin(CONN_STATS_BLOCK_ROWS, this->end - this->first);
+        QVector<qint32> srcBlock(this->arrays ? 0 : block);
+        QVector<qint32> dstBlock(srcBlock.size());
+        QVector<float> delBlock(delays && !this->arrays ? block : 0);
+        const uchar* rows = this->arrays ? NULL : this->conn->mappedData + this->conn->getStoredRowsOffset();
+        int stride = this->arrays ? 0 : this->conn->getStoredRowStride();
+
+        connStatsPart& p = *this->part;
+        if (this->whole == NULL) {
+            p.out.fill(0, this->conn->stats.srcSize);
+            p.in.fill(0, this->conn->stats.dstSize);
+            p.minSrc = p.minDst = INT_MAX;
+            p.maxSrc = p.maxDst = INT_MIN;
+            p.outOfRange = 0;
+            p.minDelay = std::numeric_limits<double>::max();
+            p.maxDelay = -std::numeric_limits<double>::max();
+            p.sumDelay = 0.0;
+        } else {
+            p.delayHistogram.fill(0.0, CONN_STATS_BINS);
+        }
+
+        for (int b = this->first; b < this->end; b += block) {
+            int n = qMin(block, this->end - b);
+            const qint32* src;
+            const qint32* dst;
+            const float* del = NULL;
+            if (this->arrays) {
+                src = this->arrays->src.constData() + b;
+                dst = this->arrays->dst.constData() + b;
+                if (delays) {
+                    del = this->arrays->delay.constData() + b;
+                }
+            } else {
+                this->conn->decodeStoredRows(rows + (qint64) b * stride, n, srcBlock.data(), dstBlock.data(),
+                                             delays ? delBlock.data() : NULL);
+                src = srcBlock.constData();
+                dst = dstBlock.constData();
+                if (delays) {
+                    del = delBlock.constData();
+                }
+            }
+
+            if (this->whole == NULL) {
+                int srcSize = p.out.size();
+                int dstSize = p.in.size();
+                for (int i = 0; i < n; ++i) {
+                    p.minSrc = qMin(p.minSrc, src[i]);
+                    p.maxSrc = qMax(p.maxSrc, src[i]);
+                    p.minDst = qMin(p.minDst, dst[i]);
+                    p.maxDst = qMax(p.maxDst, dst[i]);
+                    if (src[i] < 0 || src[i] >= srcSize || dst[i] < 0 || dst[i] >= dstSize) {
+                        ++p.outOfRange;
+                    } else {
+                        ++p.out[src[i]];
+                        ++p.in[dst[i]];
+                    }
+                }
+                for (int i = 0; del != NULL && i < n; ++i) {
+                    p.minDelay = qMin(p.minDelay, (double) del[i]);
+                    p.maxDelay = qMax(p.maxDelay, (double) del[i]);
+                    p.sumDelay += del[i];
+                }
+            } else {
+                const connectionStatistics::distribution& d = this->whole->delay;
+                for (int i = 0; del != NULL && i < n; ++i) {
+                    int bin = d.max > d.min ? (int) ((del[i] - d.min) / (d.max - d.min) * CONN_STATS_BINS) : CONN_STATS_BINS - 1;
+                    p.delayHistogram[qBound(0, bin, CONN_STATS_BINS - 1)] += 1.0;
+                }
+            }
+        }
+    }
+private:
+    const csv_connection* conn;
+    const connArrays* arrays;
+    int first;
+    int end;
+    connStatsPart* part;
+    const connectionStatistics* whole;
+};
+
+bool csv_connection::getStatistics (int srcSize, int dstSize, connectionStatistics& stats) const
+{
+    QMutexLocker locker (&this->statsLock);
+    if (!this->statsValid || this->statsGeneration != this->storeGeneration
+        || this->stats.srcSize != srcSize || this->stats.dstSize != dstSize) {
+        this->stats = connectionStatistics();
+        this->stats.srcSize = qMax (0, srcSize);
+        this->stats.dstSize = qMax (0, dstSize);
+        if (!this->loadStatistics()) {
+            this->countStatistics();
+            this->saveStatistics();
+        }
+        this->stats.srcSize = srcSize;
+        this->stats.dstSize = dstSize;
+        this->statsGeneration = this->storeGeneration;
+        this->statsValid = true;
+    }
+    stats = this->stats;
+    return true;
+}
 
-    for (this->numRows = 0; this->numRows < other->getNumRows(); ++this->numRows) {
-        for (int j = 0; j < maxcol; j++) {
-            float d = other->getData(this->numRows,j);
-            this->setData (this->numRows, j, d);
+void csv_connection::countStatistics (void) const
+{
+    PROFILE_SCOPE("csv_connection::countStatistics");
+    connectionStatistics& st = this->stats;
+
+    connArrays arrays;
+    const connArrays* legacy = NULL;
+    int nr = 0;
+    bool delays = false;
+    if (this->mapBackingStore()) {
+        if (this->mappedLegacy) {
+            this->getAllData (arrays);
+            legacy = &arrays;
+            nr = arrays.src.size();
+            delays = !arrays.delay.isEmpty();
+        } else {
+            qint64 avail = qMax ((qint64)0, this->mappedSize - this->getStoredRowsOffset()) / this->getStoredRowStride();
+            nr = qMin ((qint64)this->getNumRows(), avail);
+            delays = this->getNumCols() > 2;
+        }
+    }
+    st.count = nr;
+
+    int threads = qMax (1, qMin (QThread::idealThreadCount(), nr / CONN_STATS_BLOCK_ROWS + 1));
+    int blockSize = (nr + threads - 1) / threads;
+    QVector<connStatsPart> parts (threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount (threads);
+    int used = 0;
+    for (int t = 0; t < threads && t*blockSize < nr; ++t) {
+        pool.start (new connStatsRunner (this, legacy, t*blockSize, qMin (nr, (t+1)*blockSize), &parts[t], NULL));
+        ++used;
+    }
+    pool.waitForDone();
+
+    QVector<int> out (st.srcSize, 0);
+    QVector<int> in (st.dstSize, 0);
+    double delayMin = std::numeric_limits<double>::max();
+    double delayMax = -std::numeric_limits<double>::max();
+    double delaySum = 0.0;
+    if (used > 0) {
+        st.minSrc = st.minDst = INT_MAX;
+        st.maxSrc = st.maxDst = INT_MIN;
+    }
+    for (int t = 0; t < used; ++t) {
+        const connStatsPart& p = parts[t];
+        for (int i = 0; i < out.size(); ++i) {
+            out[i] += p.out[i];
         }
+        for (int i = 0; i < in.size(); ++i) {
+            in[i] += p.in[i];
+        }
+        st.minSrc = qMin (st.minSrc, p.minSrc);
+        st.maxSrc = qMax (st.maxSrc, p.maxSrc);
+        st.minDst = qMin (st.minDst, p.minDst);
+        st.maxDst = qMax (st.maxDst, p.maxDst);
+        st.outOfRange += p.outOfRange;
+        delayMin = qMin (delayMin, p.minDelay);
+        delayMax = qMax (delayMax, p.maxDelay);
+        delaySum += p.sumDelay;
+    }
+    parts.resize (used);
+    histogramOf (out, st.outDegree);
+    histogramOf (in, st.inDegree);
+
+    if (!delays) {
+        // one delay for the whole list
+        delaysOf (this->delay, nr, st);
+        return;
+    }
+    st.hasDelays = nr > 0;
+    if (nr == 0) {
+        return;
+    }
+    st.delay.min = delayMin;
+    st.delay.max = delayMax;
+    st.delay.mean = delaySum / nr;
+
+    // the bins need the range, so are counted in a second pass
+    st.delay.histogram.fill (0.0, CONN_STATS_BINS);
+    for (int t = 0; t < used; ++t) {
+        pool.start (new connStatsRunner (this, legacy, t*blockSize, qMin (nr, (t+1)*blockSize), &parts[t], &st));
+    }
+    pool.waitForDone();
+    for (int t = 0; t < used; ++t) {
+        for (int b = 0; b < CONN_STATS_BINS; ++b) {
+            st.delay.histogram[b] += parts[t].delayHistogram[b];
+        }
+    }
+}
+
+QString csv_connection::getStatisticsFileName (void) const
+{
+    QString name = this->uuidFilename;
+    if (name.endsWith (".bin")) {
+        name.chop (4);
+    }
+    return name + ".stats";
+}
+
+bool csv_connection::loadStatistics (void) const
+{
+    this->waitForImport();
+    QDir lib_dir = this->getLibDir();
+    QFileInfo storeInfo (lib_dir.absoluteFilePath (this->uuidFilename));
+    QFile f (lib_dir.absoluteFilePath (this->getStatisticsFileName()));
+    if (!storeInfo.exists() || !f.open (QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // written before the backing store last changed
+    if (QFileInfo(f).lastModified() < storeInfo.lastModified()) {
+        f.close();
+        return false;
+    }
+
+    connStatsHeader h;
+    connectionStatistics loaded;
+    bool ok = f.read ((char*)&h, sizeof(h)) == (qint64)sizeof(h)
+        && memcmp (h.magic, CONN_STATS_MAGIC, 4) == 0
+        && h.version == CONN_STATS_VERSION
+        && h.storeSize == storeInfo.size()
+        && h.numRows == this->numRows
+        && h.srcSize == this->stats.srcSize
+        && h.dstSize == this->stats.dstSize;
+    if (ok) {
+        QDataStream s (&f);
+        ok = loaded.read (s);
+    }
+    f.close();
+    if (ok) {
+        this->stats = loaded;
+    }
+    return ok;
+}
+
+void csv_connection::saveStatistics (void) const
+{
+    QDir lib_dir = this->getLibDir();
+    QFileInfo storeInfo (lib_dir.absoluteFilePath (this->uuidFilename));
+    if (!storeInfo.exists()) {
+        return;
+    }
+    QFile f (lib_dir.absoluteFilePath (this->getStatisticsFileName()));
+    if (!f.open (QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+
+    connStatsHeader h;
+    memcpy (h.magic, CONN_STATS_MAGIC, 4);
+    h.version = CONN_STATS_VERSION;
+    h.storeSize = storeInfo.size();
+    h.numRows = this->numRows;
+    h.srcSize = this->stats.srcSize;
+    h.dstSize = this->stats.dstSize;
+    h.reserved = 0;
+    bool ok = f.write ((const char*)&h, sizeof(h)) == (qint64)sizeof(h);
+    if (ok) {
+        QDataStream s (&f);
+        this->stats.write (s);
+        ok = s.status() == QDataStream::Ok;
+    }
+    f.close();
+    if (!ok) {
+        f.remove();
     }
 }
 
@@ -1720,8 +3747,13 @@ connection * csv_connection::newFromExisting()
 
     c->copiedFrom = this;
 
-    // now copy the data... (do this later)
-    //c->copyDataValues(this);
+    // share the data, rather than copy it; whichever of the two is
+    // written to first moves on to a copy of its own
+    this->waitForImport();
+    c->uuidFilename = this->uuidFilename;
+    c->storeShare = this->storeShare;
+    c->numRows = this->numRows;
+    c->storeGeneration = this->storeGeneration;
 
     // now, do we have a generator?
     if (this->generator != NULL) {
@@ -1742,9 +3774,13 @@ pythonscript_connection::pythonscript_connection(QSharedPointer <population> src
     this->scriptValidates = false;
     this->hasWeight = false;
     this->hasDelay = false;
+    this->locationsAsArrays = false;
     this->srcPop = src;
     this->dstPop = dst;
     this->connection_target = conn_targ;
+    this->conns = (QVector <conn> *) 0;
+    this->generationSerial = 0;
+    this->generationsRunning = 0;
 }
 
 pythonscript_connection::~pythonscript_connection()
@@ -2127,6 +4163,11 @@ QLayout * pythonscript_connection::drawLayout(nl_rootdata * data, viewVZLayoutEd
                 }
             } // else parNames[i] HAS position
         }
+
+        // of the list last generated, while it is up to date
+        if (!this->hasChanged) {
+            this->addStatisticsLabel(vlay, data, viewVZhandler, rootLay, this->connection_target);
+        }
     }
 
     return vlay;
@@ -2207,6 +4248,7 @@ void pythonscript_connection::configureFromScript(QString script)
     this->parPos.clear();
     this->hasWeight = false;
     this->hasDelay = false;
+    this->locationsAsArrays = false;
     // parse the script for parameter lines
     QStringList lines = script.split("\n");
     for (int i = 0; i < lines.size(); ++i) {
@@ -2240,6 +4282,9 @@ void pythonscript_connection::configureFromScript(QString script)
         if (lines[i].contains("#HASWEIGHT")) {
             this->hasWeight = true;
         }
+        if (lines[i].contains("#LOCARRAYS")) {
+            this->locationsAsArrays = true;
+        }
     }
     // clear the last par vals
     this->lastGeneratedParValues.clear();
@@ -2261,6 +4306,7 @@ void pythonscript_connection::configureFromScript(QString script, const QMap<QSt
     this->parPos.clear();
     this->hasWeight = false;
     this->hasDelay = false;
+    this->locationsAsArrays = false;
     // parse the script for parameter lines
     QStringList lines = script.split("\n");
     for (int i = 0; i < lines.size(); ++i) {
@@ -2300,6 +4346,9 @@ void pythonscript_connection::configureFromScript(QString script, const QMap<QSt
         if (lines[i].contains("#HASWEIGHT")) {
             this->hasWeight = true;
         }
+        if (lines[i].contains("#LOCARRAYS")) {
+            this->locationsAsArrays = true;
+        }
     }
     // clear the last par vals
     this->lastGeneratedParValues.clear();
@@ -2307,7 +4356,12 @@ void pythonscript_connection::configureFromScript(QString script, const QMap<QSt
     this->lastGeneratedParValues.fill(0);
 }
 
-void pythonscript_connection::regenerateConnections()
+/*!
+ * \brief pythonscript_connection::refetchScript
+ * Update scriptText from the copy of the script held in the settings, or put
+ * it back there if it has been deleted.
+ */
+void pythonscript_connection::refetchScript()
 {
     // refetch the script text
     QSettings settings;
@@ -2323,12 +4377,93 @@ void pythonscript_connection::regenerateConnections()
         this->scriptText = script;
     }
     settings.endGroup();
+}
+
+namespace {
+    // runs one connection's script on a pool thread
+    class pythonGenerationRunner : public QRunnable
+    {
+    public:
+        pythonGenerationRunner (connectionGeneration* job) : job(job) {}
+        void run() {
+            pythonscript_connection::runGeneration (*job);
+        }
+    private:
+        connectionGeneration* job;
+    };
+}
+
+void pythonscript_connection::regenerateChanged (const QVector<pythonscript_connection*>& pyConns)
+{
+    QThreadPool pool;
+    QVector<pythonscript_connection*> started;
+    // not resized once the runs start, as they hold pointers into it
+    QVector<connectionGeneration> jobs(pyConns.size());
+
+    for (int i = 0; i < pyConns.size(); ++i) {
+        pythonscript_connection* pyConn = pyConns[i];
+        // the 3D view may be generating it already; its result will do
+        if (pyConn->isGenerating()) {
+            continue;
+        }
+        pyConn->refetchScript();
+        if (!pyConn->changed() || pyConn->srcPop.isNull() || pyConn->dstPop.isNull()) {
+            continue;
+        }
+
+        // layouts are made here, so the scripts only see copies
+        QString errorLog;
+        pyConn->srcPop->layoutType->generateLayout(pyConn->srcPop->numNeurons, &pyConn->srcPop->layoutType->locations, errorLog);
+        if (errorLog.isEmpty()) {
+            pyConn->dstPop->layoutType->generateLayout(pyConn->dstPop->numNeurons, &pyConn->dstPop->layoutType->locations, errorLog);
+        }
+        if (!errorLog.isEmpty()) {
+            continue;
+        }
+
+        // start Python here rather than on a pool thread; kernels do not need it
+        if (!kernelConnectivity::isKernelScript(pyConn->scriptText)) {
+            SCUtilities::initPython();
+        }
+        connectionGeneration* job = &jobs[started.size()];
+        pyConn->beginGeneration (*job, pyConn->srcPop->layoutType->locations, pyConn->dstPop->layoutType->locations);
+        pool.start (new pythonGenerationRunner (job));
+        started.push_back (pyConn);
+    }
+    pool.waitForDone();
+
+    // store the results here, and move the weights across, as generate_dialog does
+    for (int i = 0; i < started.size(); ++i) {
+        pythonscript_connection* pyConn = started[i];
+        pyConn->connections.clear();
+        pyConn->conns = &pyConn->connections;
+        if (pyConn->applyGeneration (jobs[i]) && pyConn->errorLog.isEmpty() && pyConn->pythonErrors.isEmpty()) {
+            ParameterInstance * par = pyConn->getPropPointer();
+            if (par && pyConn->hasWeight) {
+                par->currType = ExplicitList;
+                par->setDenseValues(pyConn->weights);
+            }
+        }
+    }
+}
+
+void pythonscript_connection::regenerateConnections()
+{
+    this->refetchScript();
 
     // test if required
     if (!this->changed()) {
         return;
     }
 
+    // without a GUI there is no dialog to run the script in, and
+    // regenerateChanged() has already tried it while saving
+    if (!SCUtilities::haveGui()) {
+        SCUtilities::storeError("Connectivity could not be generated for Python Script Connection '"
+                                + this->scriptName + "': " + this->errorLog + this->pythonErrors);
+        return;
+    }
+
     // generate connections:
     QMutex * connGenerationMutex = new QMutex();
 
@@ -2342,9 +4477,7 @@ void pythonscript_connection::regenerateConnections()
     if (connections.size() == 0) {
         if (this->connection_target) {
             if (this->connection_target->getNumRows() == 0) {
-                QMessageBox msgBox;
-                msgBox.setText("Error: no connections generated for Python Script Connection");
-                msgBox.exec();
+                SCUtilities::showMessage("Error: no connections generated for Python Script Connection");
                 delete connGenerationMutex;
                 return;
             }
@@ -2676,7 +4809,7 @@ PyObject * vectorToList(QVector <float> * vect)
  * A simple function to take a vector of locations and pack them into a Python list of Python tuples
  * each containing the three values (x,y,z)
  */
-PyObject * vectorLocToList(QVector <loc> * vect)
+PyObject * vectorLocToList(const QVector <loc> * vect)
 {
     // create the new PyList
     PyObject * vectList = PyList_New(vect->size());
@@ -2687,7 +4820,68 @@ PyObject * vectorLocToList(QVector <loc> * vect)
                                                  PyFloat_FromDouble((double) (*vect)[i].y),
                                                  PyFloat_FromDouble((double) (*vect)[i].z)));
     }
-    return vectList;
+    return vectList;
+}
+
+/*!
+ * \brief vectorLocToArray
+ * \param vect
+ * \param base set to the object the returned view is taken from, which must
+ * be released along with it
+ * \return
+ * Expose a vector of locations to Python without copying. On Python 3 this is
+ * a read-only (N,3) float32 memoryview, which numpy.asarray() wraps
+ * directly; on Python 2 it is a flat float32 buffer for numpy.frombuffer().
+ * The view points into vect, so it is only valid for the duration of the
+ * call it is passed to - see releaseLocArray.
+ */
+PyObject * vectorLocToArray(const QVector <loc> &vect, PyObject * &base)
+{
+#if PY_MAJOR_VERSION >= 3
+    base = PyMemoryView_FromMemory((char *) vect.constData(), (Py_ssize_t) vect.size()*sizeof(loc), PyBUF_READ);
+    if (!base) {
+        return NULL;
+    }
+    PyObject * view;
+    if (vect.isEmpty()) {
+        // cast() will not take a zero length shape
+        view = PyObject_CallMethod(base, (char *) "cast", (char *) "s", "f");
+    } else {
+        view = PyObject_CallMethod(base, (char *) "cast", (char *) "s(ii)", "f", vect.size(), 3);
+    }
+    return view;
+#else
+    base = NULL;
+    return PyBuffer_FromMemory((void *) vect.constData(), (Py_ssize_t) vect.size()*sizeof(loc));
+#endif
+}
+
+/*!
+ * \brief releaseLocArray
+ * Drop the locations passed to a script. Views made by vectorLocToArray are
+ * first detached from the locations they point into, so a script that kept a
+ * reference cannot read freed memory; on Python 2 the buffer cannot be
+ * detached and is just dropped, as are lists from vectorLocToList.
+ */
+void releaseLocArray(PyObject * view, PyObject * base)
+{
+#if PY_MAJOR_VERSION >= 3
+    if (base) {
+        PyObject * res = view ? PyObject_CallMethod(view, (char *) "release", NULL) : NULL;
+        if (!res) {
+            // still exported (e.g. held by a numpy array the script kept)
+            PyErr_Clear();
+        }
+        Py_XDECREF(res);
+        res = PyObject_CallMethod(base, (char *) "release", NULL);
+        if (!res) {
+            PyErr_Clear();
+        }
+        Py_XDECREF(res);
+    }
+#endif
+    Py_XDECREF(view);
+    Py_XDECREF(base);
 }
 
 /*!
@@ -2710,11 +4904,119 @@ QVector <float> listToVector(PyObject * list)
     return vect;
 }
 
-struct outputUnPackaged
+/*!
+ * \brief bufferToVector
+ * \param view a C contiguous buffer with its format
+ * \param vect
+ * \return false if the buffer does not hold signed integers or floats
+ * Copy a one dimensional buffer into a QVector, with a single memcpy when the
+ * element types already match.
+ */
+template <typename T>
+bool bufferToVector(const Py_buffer &view, QVector <T> &vect)
 {
-    QVector <conn> connections;
-    QVector <double> weights;
-};
+    const char * fmt = view.format ? view.format : "B";
+    // native and standard little endian sizes are the same on our platforms
+    if (*fmt == '@' || *fmt == '=' || *fmt == '<') {
+        ++fmt;
+    }
+    bool isFloat = (*fmt == 'f' || *fmt == 'd');
+    bool isInt = (*fmt == 'b' || *fmt == 'h' || *fmt == 'i' || *fmt == 'l' || *fmt == 'q' || *fmt == 'n');
+    if ((!isFloat && !isInt) || fmt[1] != '\0' || view.itemsize <= 0) {
+        return false;
+    }
+    Py_ssize_t n = view.len / view.itemsize;
+    vect.resize(n);
+    if (isFloat == !std::numeric_limits<T>::is_integer && view.itemsize == (Py_ssize_t) sizeof(T)) {
+        memcpy(vect.data(), view.buf, n*sizeof(T));
+        return true;
+    }
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        const char * p = (const char *) view.buf + i*view.itemsize;
+        if (isFloat) {
+            vect[i] = view.itemsize == (Py_ssize_t) sizeof(float) ? (T) *(const float *) p : (T) *(const double *) p;
+        } else {
+            switch (view.itemsize) {
+            case 1: vect[i] = (T) *(const qint8 *) p; break;
+            case 2: vect[i] = (T) *(const qint16 *) p; break;
+            case 4: vect[i] = (T) *(const qint32 *) p; break;
+            case 8: vect[i] = (T) *(const qint64 *) p; break;
+            default: return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief isArrayOutput
+ * \param output
+ * \return
+ * True if the script returned a tuple of arrays (src, dst[, delay[, weight]])
+ * rather than a list of connections
+ */
+bool isArrayOutput(PyObject * output)
+{
+    if (!PyTuple_Check(output) || PyTuple_Size(output) < 2 || PyTuple_Size(output) > 4) {
+        return false;
+    }
+    for (int i = 0; i < PyTuple_Size(output); ++i) {
+        if (!PyObject_CheckBuffer(PyTuple_GetItem(output, i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief extractArrayOutput
+ * \param output a tuple for which isArrayOutput is true
+ * \param errs
+ * \return
+ * Unpack the arrays returned by a connection function. Source and destination
+ * indices go into connArrays, which csv_connection writes out in blocks, so no
+ * value is boxed as a Python object on the way.
+ */
+outputUnPackaged extractArrayOutput(PyObject * output, bool hasDelay, bool hasWeight, QString &errs)
+{
+    outputUnPackaged outUnPacked;
+    outUnPacked.isArrays = true;
+
+    static const char * names[4] = {"source", "destination", "delay", "weight"};
+    int numArrays = PyTuple_Size(output);
+    for (int i = 0; i < numArrays; ++i) {
+        if ((i == 2 && !hasDelay) || (i == 3 && !hasWeight)) {
+            continue;
+        }
+        Py_buffer view;
+        if (PyObject_GetBuffer(PyTuple_GetItem(output, i), &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+            PyErr_Clear();
+            errs = QString("Python Error: the ") + names[i] + " array returned by the script is not contiguous.";
+            return outputUnPackaged();
+        }
+        bool ok;
+        switch (i) {
+        case 0: ok = bufferToVector(view, outUnPacked.arrays.src); break;
+        case 1: ok = bufferToVector(view, outUnPacked.arrays.dst); break;
+        case 2: ok = bufferToVector(view, outUnPacked.arrays.delay); break;
+        default: ok = bufferToVector(view, outUnPacked.weights); break;
+        }
+        PyBuffer_Release(&view);
+        if (!ok) {
+            errs = QString("Python Error: the ") + names[i] + " array returned by the script must hold integers or floats.";
+            return outputUnPackaged();
+        }
+    }
+
+    int n = outUnPacked.arrays.src.size();
+    if (outUnPacked.arrays.dst.size() != n
+        || (!outUnPacked.arrays.delay.isEmpty() && outUnPacked.arrays.delay.size() != n)
+        || (!outUnPacked.weights.isEmpty() && outUnPacked.weights.size() != n)) {
+        errs = "Python Error: the arrays returned by the script are not all the same length.";
+        return outputUnPackaged();
+    }
+    return outUnPacked;
+}
 
 /*!
  * \brief listToVector
@@ -2790,51 +5092,145 @@ outputUnPackaged extractOutput(PyObject * output, bool hasDelay, bool hasWeight)
     return outUnPacked;
 }
 
+/*!
+ * \brief fetchPyRunError
+ * \param where the call that failed
+ * Take the error set by compiling or running a script and append it to errs
+ */
+static void fetchPyRunError(const QString &where, QString &errs)
+{
+    PyObject * errtype, * errval, * errtrace;
+    PyErr_Fetch(&(errtype), &(errval), &(errtrace));
+
+    errs.append("ERROR in " + where + " ");
+    cerr << "Error in " << where.toStdString() << "()" << endl;
+
+    if (errtype) {
+        errs.append(PyBytes_AsString(errtype) + QString("(errtype). "));
+    }
+    if (errval) {
+        errs.append(PyBytes_AsString(errval) + QString("(errval). "));
+    }
+    if (errtrace) {
+        PyTracebackObject * errtraceObj = (PyTracebackObject *) errtrace;
+        while (errtraceObj->tb_next) {
+            errtraceObj = errtraceObj->tb_next;
+        }
+        errs.append("Line no: " + QString::number(errtraceObj->tb_lineno));
+    }
+}
+
 /*!
  * \brief createPyFunc
- * \param pymod
+ * \param code a compiled script
  * \return
- * A simple function to take a string and make it into a Python function which can then be called
+ * Run a compiled script in a module of its own, with a fresh copy of the
+ * globals, and return the Python function it defines, which can then be
+ * called. So nothing a run of a script sets is seen by the next.
  */
-PyObject* createPyFunc(PyObject* pymod, QString text, QString &errs)
+PyObject* createPyFunc(PyObject* code, QString &errs)
 {
-    // get the default dict, so we have access to the built in modules
+    // copy the default dict, so we have access to the built in modules
     PyObject* main = PyImport_AddModule ("__main__");
-    PyObject* pGlobal = PyModule_GetDict (main);
+    PyObject* pGlobal = PyDict_Copy (PyModule_GetDict (main));
+    if (!pGlobal) {
+        fetchPyRunError ("PyDict_Copy", errs);
+        return NULL;
+    }
 
+    PyObject* pymod = PyModule_New ("mymod");
     PyModule_AddStringConstant (pymod, "__file__", "");
 
-    // Get the dictionary object from my module so I can pass this to PyRun_String
+    // Get the dictionary object from my module so I can pass this to PyEval_EvalCode
     PyObject* pLocal = PyModule_GetDict (pymod);
 
     // Define my function in the newly created module
-    PyObject * pValue = PyRun_String ((char*)text.toStdString().c_str(), Py_file_input, pGlobal, pLocal);
+    PyObject * pValue = PyEval_EvalCode (code, pGlobal, pLocal);
+    PyObject * pyFunc = NULL;
     if (!pValue) {
-        PyObject * errtype, * errval, * errtrace;
-        PyErr_Fetch(&(errtype), &(errval), &(errtrace));
+        fetchPyRunError ("PyEval_EvalCode", errs);
+    } else {
+        Py_DECREF(pValue);
+        // Get a pointer to the function I just defined; it keeps its globals
+        pyFunc = PyObject_GetAttrString (pymod, "connectionFunc");
+    }
+    Py_DECREF(pymod);
+    Py_DECREF(pGlobal);
+    return pyFunc;
+}
 
-        errs.append("ERROR in PyRun_String ");
-        cerr << "Error in PyRun_String()" << endl;
+// the run each thread is running a script for; only used with the GIL held
+static QHash<PyThreadState*, connectionGenerationControl*> runningScripts;
 
-        if (errtype) {
-            errs.append(PyBytes_AsString(errtype) + QString("(errtype). "));
+#define CONNECTION_CANCELLED_TEXT "Connection generation was cancelled."
+
+/*!
+ * connectionProgress(fraction) in scripts: report how far the script has
+ * got, from 0 to 1. Raises KeyboardInterrupt if the run has been cancelled,
+ * so long scripts should call it now and then.
+ */
+static PyObject* pyConnectionProgress(PyObject*, PyObject* args)
+{
+    double fraction;
+    if (!PyArg_ParseTuple(args, "d", &fraction)) {
+        return NULL;
+    }
+    connectionGenerationControl * control = runningScripts.value(PyThreadState_Get(), (connectionGenerationControl *) 0);
+    if (control) {
+        control->setProgress(fraction);
+        if (control->cancelled()) {
+            PyErr_SetString(PyExc_KeyboardInterrupt, CONNECTION_CANCELLED_TEXT);
+            return NULL;
         }
-        if (errval) {
-            errs.append(PyBytes_AsString(errval) + QString("(errval). "));
+    }
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef connectionProgressDef = {
+    "connectionProgress", pyConnectionProgress, METH_VARARGS,
+    "Report the fraction of the connections generated so far."
+};
+
+/*!
+ * The connectionFunc of a script. The script is compiled the first time it
+ * is seen, and the code is kept so that later runs of the same text only
+ * run it, each in a module and globals of its own. Returns a new reference,
+ * or NULL with errs set. The GIL must be held, which also serialises use of
+ * the cache.
+ */
+static PyObject* getCachedPyFunc(const QString& text, QString& errs)
+{
+    static QHash<QString, PyObject*> codes;
+
+    // the functions of scripts see __main__ as their globals
+    static bool progressAdded = false;
+    if (!progressAdded) {
+        PyObject* progressFunc = PyCFunction_New (&connectionProgressDef, NULL);
+        PyDict_SetItemString (PyModule_GetDict (PyImport_AddModule ("__main__")), "connectionProgress", progressFunc);
+        Py_XDECREF(progressFunc);
+        progressAdded = true;
+    }
+
+    PyObject* code = codes.value(text, (PyObject*) 0);
+    if (!code) {
+        code = Py_CompileString (text.toStdString().c_str(), "<string>", Py_file_input);
+        if (!code) {
+            fetchPyRunError ("Py_CompileString", errs);
+            return NULL;
         }
-        if (errtrace) {
-            PyTracebackObject * errtraceObj = (PyTracebackObject *) errtrace;
-            while (errtraceObj->tb_next) {
-                errtraceObj = errtraceObj->tb_next;
+
+        // scripts edited many times leave old versions behind; start afresh
+        // rather than let them build up
+        if (codes.size() >= PYTHON_SCRIPT_CACHE_SIZE) {
+            QHash<QString, PyObject*>::iterator it;
+            for (it = codes.begin(); it != codes.end(); ++it) {
+                Py_DECREF(it.value());
             }
-            errs.append("Line no: " + QString::number(errtraceObj->tb_lineno));
+            codes.clear();
         }
-        return NULL;
+        codes.insert(text, code);
     }
-    Py_DECREF(pValue);
-
-    // Get a pointer to the function I just defined
-    return PyObject_GetAttrString (pymod, "connectionFunc");
+    return createPyFunc (code, errs);
 }
 
 /*!
@@ -2844,8 +5240,7 @@ PyObject* createPyFunc(PyObject* pymod, QString text, QString &errs)
  */
 void pythonscript_connection::generate_connections()
 {
-    QTime qtimer;
-    qtimer.start();
+    PROFILE_SCOPE("pythonscript_connection::generate_connections");
     conns->clear();
 
     this->pythonErrors.clear();
@@ -2863,23 +5258,49 @@ void pythonscript_connection::generate_connections()
         return;
     }
 
-    // a tuple to hold the arguments to the Python Script - size of the scripts pars + the src and dst locations
-    PyObject * argsPy = PyTuple_New(this->parNames.size()+2/* 2 for the src and dst locations*/);
+    this->generate_connections(srcPop->layoutType->locations, dstPop->layoutType->locations);
+}
+
+/*!
+ * Run the script of job on its locations and unpack its output into
+ * job.output. Returns false, with job.errors set, if the script failed.
+ */
+static bool runConnectionScript(connectionGeneration &job, QTime &qtimer)
+{
+    // the interpreter may be in use by another thread
+    pythonGILLock gil;
 
-    // convert the locations into Python Objects:
-    PyObject * srcPy = vectorLocToList(&srcPop->layoutType->locations);
-    PyObject * dstPy = vectorLocToList(&dstPop->layoutType->locations);
+    // a tuple to hold the arguments to the Python Script - size of the scripts pars + the src and dst locations
+    PyObject * argsPy = PyTuple_New(job.parNames.size()+2/* 2 for the src and dst locations*/);
+
+    // convert the locations into Python Objects - scripts tagged #LOCARRAYS
+    // get views of the locations rather than lists of tuples
+    PyObject * srcBase = NULL;
+    PyObject * dstBase = NULL;
+    PyObject * srcPy = job.locationsAsArrays ? vectorLocToArray(job.srcLocs, srcBase) : vectorLocToList(&job.srcLocs);
+    PyObject * dstPy = job.locationsAsArrays ? vectorLocToArray(job.dstLocs, dstBase) : vectorLocToList(&job.dstLocs);
+    if (!srcPy || !dstPy) {
+        PyErr_Clear();
+        job.errors = "Python Error: could not pass the locations to the script.";
+        Py_XDECREF(argsPy);
+        releaseLocArray(srcPy, srcBase);
+        releaseLocArray(dstPy, dstBase);
+        return false;
+    }
+    // PyTuple_SetItem steals the references, keep our own for the release
+    Py_INCREF(srcPy);
+    Py_INCREF(dstPy);
 
     // add them to the tuple
     PyTuple_SetItem(argsPy,0,srcPy);
     PyTuple_SetItem(argsPy,1,dstPy);
 
     // convert the parameters into Python Objects and add them to the tuple
-    for (int i = 0; i < this->parNames.size(); ++i) {
-        if (this->parNames[i].endsWith("_string")) {
-            PyTuple_SetItem(argsPy,i+2,PyUnicode_FromString(parText[i].toStdString().c_str()));
+    for (int i = 0; i < job.parNames.size(); ++i) {
+        if (job.parNames[i].endsWith("_string")) {
+            PyTuple_SetItem(argsPy,i+2,PyUnicode_FromString(job.parText[i].toStdString().c_str()));
         } else {
-            PyTuple_SetItem(argsPy,i+2,PyFloat_FromDouble(parValues[i]));
+            PyTuple_SetItem(argsPy,i+2,PyFloat_FromDouble(job.parValues[i]));
         }
     }
 
@@ -2887,46 +5308,48 @@ void pythonscript_connection::generate_connections()
     if (!argsPy) {
         DBG() << "Bad args tuple";
         Py_XDECREF(argsPy);
-        Py_XDECREF(srcPy);
-        Py_XDECREF(dstPy);
-        return;
+        releaseLocArray(srcPy, srcBase);
+        releaseLocArray(dstPy, dstBase);
+        return false;
     }
 
-    // Create a new module object
-    PyObject* pymod = PyModule_New ("mymod");
-
-    // add the function to Python, and get a PyObject for it
-    PyObject* pyFunc = createPyFunc (pymod, this->scriptText, this->pythonErrors);
+    // get the function for the script, compiled when it was first run
+    PyObject* pyFunc = getCachedPyFunc (job.scriptText, job.errors);
 
     // check that function creation worked
     if (!pyFunc) {
         cerr << "createPyFunc returned null" << endl;
-        if (pythonErrors.isEmpty()) {
-            pythonErrors = "Python Error: Script function is not named connectionFunc.";
+        if (job.errors.isEmpty()) {
+            job.errors = "Python Error: Script function is not named connectionFunc.";
         }
         Py_XDECREF(argsPy);
-        Py_XDECREF(srcPy);
-        Py_XDECREF(dstPy);
-        Py_XDECREF(pyFunc);
-        Py_XDECREF(pymod);
-        return;
+        releaseLocArray(srcPy, srcBase);
+        releaseLocArray(dstPy, dstBase);
+        return false;
     }
 
     DBG() << "Set up the python function in " << qtimer.restart() << " ms";
     // Call my function
     DBG() << "Calling the function";
+    runningScripts.insert(PyThreadState_Get(), job.control.data());
     PyObject* output = PyObject_CallObject (pyFunc, argsPy);
+    runningScripts.remove(PyThreadState_Get());
     DBG() << "Script call returned in " << qtimer.restart() << " ms";
     Py_XDECREF(argsPy);
-    Py_XDECREF(srcPy);
-    Py_XDECREF(dstPy);
+    releaseLocArray(srcPy, srcBase);
+    releaseLocArray(dstPy, dstBase);
 
     Py_XDECREF(pyFunc);
-    Py_XDECREF(pymod);
+
+    if (!output && job.control->cancelled()) {
+        PyErr_Clear();
+        job.errors = CONNECTION_CANCELLED_TEXT;
+        return false;
+    }
 
     if (!output) {
 
-        this->pythonErrors = "Python Error:";
+        job.errors = "Python Error:";
 
         PyObject *pyExcType;
         PyObject *pyExcValue;
@@ -2936,19 +5359,19 @@ void pythonscript_connection::generate_connections()
 
         PyObject* str_exc_type = PyObject_Repr(pyExcType);
         PyObject* pyStr = PyUnicode_AsEncodedString(str_exc_type, "utf-8", "Error ~");
-        pythonErrors += "\nException type: ";
+        job.errors += "\nException type: ";
         if (pyStr != (PyObject*)0) {
-            pythonErrors += PyBytes_AS_STRING(pyStr);
+            job.errors += PyBytes_AS_STRING(pyStr);
         } else {
-            pythonErrors += "unknown";
+            job.errors += "unknown";
         }
         PyObject* str_exc_value = PyObject_Repr(pyExcValue);
         PyObject* pyExcValueStr = PyUnicode_AsEncodedString(str_exc_value, "utf-8", "Error ~");
-        pythonErrors += "\nException value: ";
+        job.errors += "\nException value: ";
         if (pyExcValueStr != (PyObject*)0) {
-            pythonErrors += PyBytes_AsString(pyExcValueStr);
+            job.errors += PyBytes_AsString(pyExcValueStr);
         } else {
-            pythonErrors += "unkown";
+            job.errors += "unkown";
         }
 
         if (pyExcTraceback) {
@@ -2965,9 +5388,9 @@ void pythonscript_connection::generate_connections()
                     e1 = "<string>";
                 }
                 if (e1 == "<string>") {
-                    pythonErrors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of the connection script");
+                    job.errors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of the connection script");
                 } else {
-                    pythonErrors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of ") + e1;
+                    job.errors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno) + QString(" of ") + e1;
                 }
                 Py_XDECREF(tfnStr);
             }
@@ -2985,13 +5408,13 @@ void pythonscript_connection::generate_connections()
                 PyObject* _tn = errtraceObj->tb_frame->f_code->co_name;
                 PyObject* _tnStr = PyUnicode_AsEncodedString(tfn, "utf-8", "Error ~");
 
-                pythonErrors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno);
+                job.errors += QString("\nError on line: ") + QString::number(errtraceObj->tb_lineno);
 
                 if (_tfnStr != (PyObject*)0) {
-                    pythonErrors += QString(" of ") + QString (PyBytes_AsString(_tfnStr)) + QString(", ");
+                    job.errors += QString(" of ") + QString (PyBytes_AsString(_tfnStr)) + QString(", ");
                 }
                 if (_tnStr != (PyObject*)0) {
-                    pythonErrors += QString("function ") + QString (PyBytes_AsString(_tnStr));
+                    job.errors += QString("function ") + QString (PyBytes_AsString(_tnStr));
                 }
 
                 Py_XDECREF(_tfn);
@@ -3013,19 +5436,316 @@ void pythonscript_connection::generate_connections()
         Py_XDECREF(str_exc_value);
         Py_XDECREF(pyExcValueStr);
 
-        return;
+        return false;
     }
 
     DBG() << "Checked exceptions in " << qtimer.restart() << " ms";
     // unpack the output into C++ forms
-    outputUnPackaged unpacked = extractOutput (output, this->hasDelay, this->hasWeight);
+    if (isArrayOutput(output)) {
+        job.output = extractArrayOutput (output, job.hasDelay, job.hasWeight, job.errors);
+    } else {
+        job.output = extractOutput (output, job.hasDelay, job.hasWeight);
+    }
+    Py_DECREF(output);
+    if (!job.errors.isEmpty()) {
+        return false;
+    }
+
+    // the rest is C++ only, so other scripts can run while it is stored
+    gil.release();
+    return true;
+}
+
+namespace {
+    // reports a kernel's progress as the script's, stopping on a cancel
+    class kernelScriptProgress : public kernelProgress
+    {
+    public:
+        kernelScriptProgress (connectionGenerationControl* control) : control(control) {}
+        bool report (double fraction) {
+            control->setProgress (fraction);
+            return !control->cancelled();
+        }
+    private:
+        connectionGenerationControl* control;
+    };
+}
+
+/*!
+ * Generate the connections of the #KERNEL script of job natively, as
+ * runConnectionScript would run it. Returns false, with job.errors set, if
+ * the kernel is not valid or the generation was cancelled.
+ */
+static bool runConnectionKernel(connectionGeneration &job)
+{
+    kernelConnectivity kernel;
+    if (!kernel.configure(job.scriptText, job.parNames, job.parValues, job.errors)) {
+        return false;
+    }
+    job.output = outputUnPackaged();
+    job.output.isArrays = true;
+    kernelScriptProgress progress(job.control.data());
+    if (!kernel.generate(job.srcLocs, job.dstLocs, job.samePopulation, job.hasDelay, job.hasWeight,
+                         job.output.arrays, job.output.weights, &progress)) {
+        job.errors = CONNECTION_CANCELLED_TEXT;
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * The file in the project's cache directory for the output of the script
+ * of job, named by a hash of everything the output depends on. Empty if the
+ * project has not been saved yet.
+ */
+static QString generatedCacheFile(const connectionGeneration &job)
+{
+    QString projectFile = settingsCache::currentFileName();
+    if (projectFile.isEmpty()) {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(job.scriptText.toUtf8());
+    for (int i = 0; i < job.parNames.size(); ++i) {
+        hash.addData(job.parNames[i].toUtf8());
+        if (i < job.parValues.size()) {
+            hash.addData((const char *) &job.parValues[i], sizeof(double));
+        }
+        if (i < job.parText.size()) {
+            hash.addData(job.parText[i].toUtf8());
+        }
+    }
+    hash.addData(job.weightProp.toUtf8());
+    qint32 flags[4] = { job.hasDelay, job.hasWeight, job.srcLocs.size(), job.dstLocs.size() };
+    hash.addData((const char *) flags, sizeof(flags));
+    hash.addData((const char *) job.srcLocs.constData(), job.srcLocs.size()*sizeof(loc));
+    hash.addData((const char *) job.dstLocs.constData(), job.dstLocs.size()*sizeof(loc));
+
+    QDir dir = QFileInfo(projectFile).absoluteDir();
+    if (!dir.exists(PYTHON_CONN_CACHE_DIR) && !dir.mkdir(PYTHON_CONN_CACHE_DIR)) {
+        return QString();
+    }
+    dir.cd(PYTHON_CONN_CACHE_DIR);
+    return dir.absoluteFilePath(QString(hash.result().toHex()) + ".bin");
+}
+
+/*!
+ * Read back output saved by saveGeneratedOutput. Returns false if there is
+ * none or the file is not complete.
+ */
+static bool loadGeneratedOutput(const QString &fileName, outputUnPackaged &unpacked)
+{
+    if (fileName.isEmpty()) {
+        return false;
+    }
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    char magic[4];
+    quint32 version;
+    qint64 n, numWeights;
+    qint32 hasDelay;
+    if (f.read(magic, 4) != 4 || memcmp(magic, PYTHON_CONN_CACHE_MAGIC, 4) != 0
+        || f.read((char *) &version, sizeof(version)) != sizeof(version) || version != PYTHON_CONN_CACHE_VERSION
+        || f.read((char *) &n, sizeof(n)) != sizeof(n)
+        || f.read((char *) &hasDelay, sizeof(hasDelay)) != sizeof(hasDelay)
+        || f.read((char *) &numWeights, sizeof(numWeights)) != sizeof(numWeights)) {
+        return false;
+    }
+    qint64 expected = f.pos() + n*(qint64)(2*sizeof(qint32) + (hasDelay ? sizeof(float) : 0)) + numWeights*(qint64)sizeof(double);
+    if (n < 0 || numWeights < 0 || n > INT_MAX || numWeights > INT_MAX || f.size() != expected) {
+        return false;
+    }
+
+    unpacked = outputUnPackaged();
+    unpacked.isArrays = true;
+    unpacked.arrays.src.resize((int) n);
+    unpacked.arrays.dst.resize((int) n);
+    f.read((char *) unpacked.arrays.src.data(), n*sizeof(qint32));
+    f.read((char *) unpacked.arrays.dst.data(), n*sizeof(qint32));
+    if (hasDelay) {
+        unpacked.arrays.delay.resize((int) n);
+        f.read((char *) unpacked.arrays.delay.data(), n*sizeof(float));
+    }
+    unpacked.weights.resize((int) numWeights);
+    f.read((char *) unpacked.weights.data(), numWeights*sizeof(double));
+    return f.error() == QFile::NoError;
+}
+
+/*!
+ * Keep the output of a script run, so that the same inputs later (after
+ * reopening the project, say) are not run again. The oldest files beyond
+ * PYTHON_CONN_CACHE_FILES are removed.
+ */
+static void saveGeneratedOutput(const QString &fileName, const outputUnPackaged &unpacked, bool hasDelay)
+{
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    // write under another name, so no other run reads it half written
+    QString tmpName = fileName + "." + QUuid::createUuid().toString().mid(1, 8);
+    QFile f(tmpName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+
+    connArrays copied;
+    const connArrays * arrays = &unpacked.arrays;
+    if (!unpacked.isArrays) {
+        copied.src.resize(unpacked.connections.size());
+        copied.dst.resize(unpacked.connections.size());
+        if (hasDelay) {
+            copied.delay.resize(unpacked.connections.size());
+        }
+        for (int i = 0; i < unpacked.connections.size(); ++i) {
+            copied.src[i] = unpacked.connections[i].src;
+            copied.dst[i] = unpacked.connections[i].dst;
+            if (hasDelay) {
+                copied.delay[i] = unpacked.connections[i].metric;
+            }
+        }
+        arrays = &copied;
+    }
+
+    qint64 n = qMin(arrays->src.size(), arrays->dst.size());
+    qint32 withDelay = arrays->delay.size() >= n && n > 0 ? 1 : 0;
+    qint64 numWeights = unpacked.weights.size();
+    quint32 version = PYTHON_CONN_CACHE_VERSION;
+    f.write(PYTHON_CONN_CACHE_MAGIC, 4);
+    f.write((const char *) &version, sizeof(version));
+    f.write((const char *) &n, sizeof(n));
+    f.write((const char *) &withDelay, sizeof(withDelay));
+    f.write((const char *) &numWeights, sizeof(numWeights));
+    f.write((const char *) arrays->src.constData(), n*sizeof(qint32));
+    f.write((const char *) arrays->dst.constData(), n*sizeof(qint32));
+    if (withDelay) {
+        f.write((const char *) arrays->delay.constData(), n*sizeof(float));
+    }
+    f.write((const char *) unpacked.weights.constData(), numWeights*sizeof(double));
+    bool ok = f.error() == QFile::NoError;
+    f.close();
+
+    if (!ok) {
+        QFile::remove(tmpName);
+        return;
+    }
+    QFile::remove(fileName);
+    if (!QFile::rename(tmpName, fileName)) {
+        QFile::remove(tmpName);
+        return;
+    }
+
+    QDir dir = QFileInfo(fileName).absoluteDir();
+    QFileInfoList files = dir.entryInfoList(QStringList() << "*.bin", QDir::Files, QDir::Time);
+    for (int i = PYTHON_CONN_CACHE_FILES; i < files.size(); ++i) {
+        dir.remove(files[i].fileName());
+    }
+}
+
+/*!
+ * \brief pythonscript_connection::generate_connections
+ * Run the script on locations that have already been generated, and store
+ * the result. This does not touch the populations' layouts.
+ */
+void pythonscript_connection::generate_connections(const QVector <loc> &srcLocs, const QVector <loc> &dstLocs)
+{
+    connectionGeneration job;
+    this->beginGeneration(job, srcLocs, dstLocs);
+    runGeneration(job);
+    this->applyGeneration(job);
+}
+
+void pythonscript_connection::beginGeneration(connectionGeneration &job, const QVector <loc> &srcLocs, const QVector <loc> &dstLocs)
+{
+    job.serial = ++this->generationSerial;
+    job.control = QSharedPointer <connectionGenerationControl> (new connectionGenerationControl);
+    this->generationControl = job.control;
+    ++this->generationsRunning;
+
+    job.scriptText = this->scriptText;
+    job.parNames = this->parNames;
+    job.parValues = this->parValues;
+    job.parText = this->parText;
+    job.weightProp = this->weightProp;
+    job.hasWeight = this->hasWeight;
+    job.hasDelay = this->hasDelay;
+    job.locationsAsArrays = this->locationsAsArrays;
+    job.samePopulation = !this->srcPop.isNull() && this->srcPop == this->dstPop;
+    job.srcLocs = srcLocs;
+    job.dstLocs = dstLocs;
+    job.output = outputUnPackaged();
+    job.errors.clear();
+}
+
+void pythonscript_connection::runGeneration(connectionGeneration &job)
+{
+    PROFILE_SCOPE("pythonscript_connection::generate_connections");
+    QTime qtimer;
+    qtimer.start();
+
+    job.output = outputUnPackaged();
+    job.errors.clear();
+    connectionGenerationControl * control = job.control.data();
+
+    bool ran;
+    if (kernelConnectivity::isKernelScript(job.scriptText)) {
+        // kernels are generated natively, which is quicker than keeping them
+        ran = !control->cancelled() && runConnectionKernel(job);
+    } else {
+        // reuse the output of an earlier run on the same inputs, if it was kept
+        QString cacheFile = generatedCacheFile(job);
+        if (loadGeneratedOutput(cacheFile, job.output)) {
+            DBG() << "Reused the connections generated earlier in " << cacheFile;
+            ran = true;
+        } else {
+            ran = !control->cancelled() && runConnectionScript(job, qtimer);
+            if (ran && !control->cancelled()) {
+                saveGeneratedOutput(cacheFile, job.output, job.hasDelay);
+            }
+        }
+    }
+
+    // a cancel asked for before the script started still counts
+    if (control->cancelled()) {
+        job.errors = CONNECTION_CANCELLED_TEXT;
+        ran = false;
+    }
+    if (!ran) {
+        if (job.errors.isEmpty()) {
+            job.errors = "Python Error: the script could not be run.";
+        }
+        job.output = outputUnPackaged();
+        return;
+    }
+    control->setProgress(1.0);
 
     DBG() << "Unpacked output in " << qtimer.restart() << " ms";
+}
+
+bool pythonscript_connection::applyGeneration(connectionGeneration &job)
+{
+    if (this->generationsRunning > 0) {
+        --this->generationsRunning;
+    }
+    if (job.serial != this->generationSerial) {
+        // a later run has been begun, and its result is the one wanted
+        return false;
+    }
+    this->pythonErrors = job.errors;
+    if (!job.errors.isEmpty()) {
+        return true;
+    }
+
+    outputUnPackaged &unpacked = job.output;
 
     // transfer the unpacked output to the local storage location for connections
     if (this->connection_target != NULL) {
 
-        DBG() << "pythonscript_connection::generate_connections: setting src/dst popn names in connection_target";
+        DBG() << "pythonscript_connection::applyGeneration: setting src/dst popn names in connection_target";
         this->connection_target->setSrcName (this->srcPop->name);
         this->connection_target->setDstName (this->dstPop->name);
         QTime subtimer;
@@ -3034,10 +5754,12 @@ void pythonscript_connection::generate_connections()
         this->connection_target->clearData();
         DBG() << "Cleared target data in " << subtimer.restart() << " ms";
 
+        int numConns = unpacked.isArrays ? unpacked.arrays.src.size() : unpacked.connections.size();
+
         // if no connections are returned
-        if (unpacked.connections.size() > 0) {
+        if (numConns > 0) {
             // otherwise...
-            if (this->hasDelay) {
+            if (job.hasDelay) {
                 // if we have delays, resize
                 this->connection_target->setNumCols(3);
             } else {
@@ -3047,24 +5769,40 @@ void pythonscript_connection::generate_connections()
         }
 
         // Transfer the connection to the local file copy
-        QFile f;
-        QDataStream ds;
-        this->connection_target->setupDataStream (f, ds);
-        for (int i = 0; i < unpacked.connections.size(); ++i) {
-            ds << (qint32)unpacked.connections[i].src
-               << (qint32)unpacked.connections[i].dst;
-            if (unpacked.connections[0].metric != NO_DELAY) {
-                ds << (float)unpacked.connections[i].metric;
-            }
+        if (unpacked.isArrays) {
+            this->connection_target->setAllData (unpacked.arrays);
+        } else {
+            this->connection_target->setAllData (unpacked.connections);
         }
-        this->connection_target->shutdownDataStream (f);
         DBG() << "Transferred connection data in " << subtimer.restart() << " ms";
-        this->connection_target->setNumRows(unpacked.connections.size());
+        this->connection_target->setNumRows(numConns);
+
+        // the weights are in the order the script gave the connections in
+        QVector<int> newRowOf;
+        if (this->connection_target->sortData (&newRowOf)
+            && unpacked.weights.size() == newRowOf.size()) {
+            QVector<double> sorted(unpacked.weights.size());
+            for (int i = 0; i < newRowOf.size(); ++i) {
+                sorted[newRowOf[i]] = unpacked.weights[i];
+            }
+            unpacked.weights = sorted;
+        }
 
     } else {
         DBG() << "connection_target is null";
+        if (unpacked.isArrays) {
+            const connArrays &arrays = unpacked.arrays;
+            unpacked.connections.resize(arrays.src.size());
+            for (int i = 0; i < arrays.src.size(); ++i) {
+                unpacked.connections[i].src = arrays.src[i];
+                unpacked.connections[i].dst = arrays.dst[i];
+                unpacked.connections[i].metric = arrays.delay.isEmpty() ? NO_DELAY : arrays.delay[i];
+            }
+        }
         this->connections = unpacked.connections;
-        (*this->conns) = unpacked.connections;
+        if (this->conns) {
+            (*this->conns) = unpacked.connections;
+        }
     }
 
     // transfer the unpacked output to the local storage location for weights
@@ -3073,8 +5811,65 @@ void pythonscript_connection::generate_connections()
     // if we get to the end then that's good enough
     this->scriptValidates = true;
     this->setUnchanged(true);
+    // but it is what was run that has been generated, so that edits made
+    // while it ran still count as changes
+    for (int i = 0; i < this->lastGeneratedParValues.size() && i < job.parValues.size(); ++i) {
+        this->lastGeneratedParValues[i] = job.parValues[i];
+    }
+    this->lastGeneratedWeightProp = job.weightProp;
+    this->lastGeneratedScriptText = job.scriptText;
 
     DBG() << "Returning";
+    return true;
+}
+
+bool pythonscript_connection::isGenerating()
+{
+    return this->generationsRunning > 0;
+}
+
+int pythonscript_connection::generationProgress()
+{
+    if (this->generationControl.isNull()) {
+        return -1;
+    }
+    return this->generationControl->progress();
+}
+
+void pythonscript_connection::setGenerationProgress(double fraction)
+{
+    if (!this->generationControl.isNull()) {
+        this->generationControl->setProgress(fraction);
+    }
+}
+
+void pythonscript_connection::cancelGeneration()
+{
+    if (this->generationControl.isNull()) {
+        // no run has been begun
+        return;
+    }
+    connectionGenerationControl * control = this->generationControl.data();
+    control->cancel();
+    if (!SCUtilities::pythonStarted()) {
+        // no script has run
+        return;
+    }
+
+    // interrupt the script, in case it does not call connectionProgress.
+    // Taking the GIL waits for the script thread to give it up
+    pythonGILLock gil;
+    QHash<PyThreadState*, connectionGenerationControl*>::const_iterator it;
+    for (it = runningScripts.constBegin(); it != runningScripts.constEnd(); ++it) {
+        if (it.value() == control) {
+            PyThreadState_SetAsyncExc (it.key()->thread_id, PyExc_KeyboardInterrupt);
+        }
+    }
+}
+
+bool pythonscript_connection::generationCancelled()
+{
+    return !this->generationControl.isNull() && this->generationControl->cancelled();
 }
 
 connection * pythonscript_connection::newFromExisting()
@@ -3091,6 +5886,7 @@ connection * pythonscript_connection::newFromExisting()
     c->scriptValidates = this->scriptValidates;
     c->hasWeight = this->hasWeight;
     c->hasDelay = this->hasDelay;
+    c->locationsAsArrays = this->locationsAsArrays;
     c->connection_target = this->connection_target;
     c->scriptName = this->scriptName;
     c->scriptText = this->scriptText;
@@ -31,6 +31,10 @@
 #include "CL_classes.h"
 #include "NL_population.h"
 #include "NL_systemobject.h"
+#include "SC_residency.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QRunnable>
 
 
 #define NO_DELAY -1 // used to determine if Python Scripts have delay data
@@ -41,6 +45,184 @@ struct change {
     float value;
 };
 
+/*!
+ * The csv_connection backing store (the uuid .bin file) starts with
+ * this header. The rows which follow are packed, native-endian
+ * (qint32 src)(qint32 dst)(opt float delay) - the same layout as the
+ * packed binary files written into a saved project, unless the store
+ * is compact, with a delay table (CONN_STORE_DELAY_TABLE) or narrower
+ * indices (CONN_STORE_SRC_WIDTH_SHIFT). Files which do not start with this
+ * header are legacy, big-endian QDataStream files, in which the delay
+ * was serialised as a double.
+ */
+struct connStoreHeader {
+    char magic[4];
+    quint32 version;
+    quint32 flags;
+    quint32 reserved;
+};
+
+#define CONN_STORE_MAGIC "SCCL"
+#define CONN_STORE_VERSION 1
+
+/*!
+ * Set in connStoreHeader::flags when the delays are held as a table
+ * of their distinct values, reserved floats long, which follows the
+ * header. Each row then holds the quint16 index of its delay in the
+ * table in place of the float, or nothing at all if there is only
+ * one delay. Rows with more distinct delays than this are stored
+ * with float delays.
+ */
+#define CONN_STORE_DELAY_TABLE 0x1
+#define CONN_STORE_DELAY_TABLE_MAX 65536
+
+/*!
+ * The width of the src and dst indices of the rows is held in two bits
+ * of connStoreHeader::flags each, from these shifts: 0 for qint32, 1
+ * for quint16 and 2 for quint8, chosen from the largest index when a
+ * whole list is written.
+ */
+#define CONN_STORE_SRC_WIDTH_SHIFT 1
+#define CONN_STORE_DST_WIDTH_SHIFT 3
+
+/*!
+ * Number of rows packed into each block when the backing store has to
+ * be written piecewise.
+ */
+#define CONN_STORE_BLOCK_ROWS 65536
+
+/*!
+ * Bytes of a CSV file parsed by each thread at a time on import. A
+ * batch of one such chunk per thread is held in memory at once.
+ */
+#define CSV_IMPORT_CHUNK_BYTES (8 << 20)
+
+/*!
+ * Distinct connection scripts whose compiled functions are kept.
+ */
+#define PYTHON_SCRIPT_CACHE_SIZE 64
+
+/*!
+ * The output of connection scripts is kept in this directory beside the
+ * project file, one file per distinct set of script inputs, and at most
+ * PYTHON_CONN_CACHE_FILES files are kept.
+ */
+#define PYTHON_CONN_CACHE_DIR ".conncache"
+#define PYTHON_CONN_CACHE_FILES 256
+#define PYTHON_CONN_CACHE_MAGIC "SCPC"
+#define PYTHON_CONN_CACHE_VERSION 1
+
+/*!
+ * Header at the start of the file holding a csv_connection's adjacency
+ * index, which is kept next to the backing store with the extension
+ * .adj. The index is only used while storeSize and numRows match the
+ * backing store.
+ */
+struct connAdjacencyHeader {
+    char magic[4];
+    quint32 version;
+    qint64 storeSize;
+    qint32 numRows;
+    quint32 reserved;
+};
+
+#define CONN_ADJACENCY_MAGIC "SCAJ"
+#define CONN_ADJACENCY_VERSION 1
+
+/*!
+ * Header at the start of the file holding a csv_connection's statistics,
+ * kept next to the backing store with the extension .stats. They are
+ * only used while storeSize and numRows match the backing store, and for
+ * the sizes of source and destination they were counted for.
+ */
+struct connStatsHeader {
+    char magic[4];
+    quint32 version;
+    qint64 storeSize;
+    qint32 numRows;
+    qint32 srcSize;
+    qint32 dstSize;
+    quint32 reserved;
+};
+
+#define CONN_STATS_MAGIC "SCST"
+#define CONN_STATS_VERSION 1
+
+/*!
+ * Bins of the degree and delay histograms of connectionStatistics, and
+ * the rows of a csv_connection decoded by each thread at a time while
+ * they are counted.
+ */
+#define CONN_STATS_BINS 32
+#define CONN_STATS_BLOCK_ROWS 65536
+
+/*!
+ * \brief The connectionStatistics class summarises the connectivity of a
+ * connection from srcSize sources to dstSize destinations: the number of
+ * connections and their density, and the range, mean and a histogram of
+ * the out-degrees (the connections from each source), the in-degrees and
+ * the delays. Explicit lists are counted; for the other connections they
+ * follow from the rule, and for fixed probability connections they are
+ * what is expected (exact is false).
+ */
+class connectionStatistics
+{
+public:
+    connectionStatistics();
+
+    /*!
+     * The range, mean and histogram over the range of a set of values.
+     * The histogram holds counts, or expected counts.
+     */
+    struct distribution {
+        distribution() : min(0.0), max(0.0), mean(0.0) {}
+        /*!
+         * All count values are v.
+         */
+        void setSingle (double v, double count);
+        double min;
+        double max;
+        double mean;
+        QVector<double> histogram;
+    };
+
+    qint64 count;
+    int srcSize;
+    int dstSize;
+    bool exact;
+
+    /*!
+     * The index range of an explicit list, and the number of its
+     * connections whose source or destination is out of range, which
+     * are not counted in the degrees.
+     */
+    //@{
+    qint32 minSrc;
+    qint32 maxSrc;
+    qint32 minDst;
+    qint32 maxDst;
+    qint64 outOfRange;
+    //@}
+
+    distribution outDegree;
+    distribution inDegree;
+    // false if the delays are not known, as for an explicit list delay
+    bool hasDelays;
+    distribution delay;
+
+    double density (void) const;
+
+    /*!
+     * A line for the connection panel, and the histograms for its tool
+     * tip.
+     */
+    QString summary (void) const;
+    QString details (void) const;
+
+    void write (QDataStream& s) const;
+    bool read (QDataStream& s);
+};
+
 class connection: public QObject
 {
     Q_OBJECT
@@ -59,6 +241,13 @@ public:
     virtual void writeDelay(QXmlStreamWriter &xmlOut);
     virtual QLayout * drawLayout(nl_rootdata * , viewVZLayoutEditHandler * , nl_rootlayout * ) {return new QHBoxLayout();}
 
+    /*!
+     * The statistics of this connection from srcSize sources to dstSize
+     * destinations. Returns false if they are not known for this kind of
+     * connection, or could not be read.
+     */
+    virtual bool getStatistics (int, int, connectionStatistics&) const { return false; }
+
     virtual connection * newFromExisting() {return new connection;}
     virtual int getIndex();
 
@@ -160,6 +349,14 @@ private:
     QString filename;
 
 protected:
+    /*!
+     * Add the summary of the statistics of conn (by default this
+     * connection), for the projection or generic input selected in data,
+     * to lay. The label is deleted with the other properties.
+     */
+    void addStatisticsLabel (QBoxLayout * lay, nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler,
+                             nl_rootlayout * rootLay, const connection * conn = (connection *) 0);
+
     /*!
      * The name of the source population for this connection. This may
      * be used where it is inconvenient to set the
@@ -193,6 +390,7 @@ public:
     void write_node_xml(QXmlStreamWriter &xmlOut);
     void import_parameters_from_xml(QDomNode &);
     QLayout * drawLayout(nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay);
+    bool getStatistics (int srcSize, int dstSize, connectionStatistics& stats) const;
     connection * newFromExisting() {alltoAll_connection * c = new alltoAll_connection; c->delay = new ParameterInstance(this->delay); return c;}
 
 private:
@@ -208,11 +406,32 @@ public:
     void write_node_xml(QXmlStreamWriter &xmlOut);
     void import_parameters_from_xml(QDomNode &);
     QLayout * drawLayout(nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay);
+    bool getStatistics (int srcSize, int dstSize, connectionStatistics& stats) const;
     connection * newFromExisting() {onetoOne_connection * c = new onetoOne_connection; c->delay = new ParameterInstance(this->delay); c->parent = this->parent; return c;}
 
 private:
 };
 
+/*!
+ * Rows of a fixed probability connection generated together, per thread.
+ */
+#define FIXEDPROB_BLOCK_ROWS 256
+
+/*!
+ * Receives the connections of a fixed probability connection as they are
+ * generated, a block at a time; see fixedProb_connection::generate.
+ */
+class fixedProbSink
+{
+public:
+    virtual ~fixedProbSink() {}
+    /*!
+     * Called for each block of connections, in source order. Return
+     * false to stop the generation.
+     */
+    virtual bool addConnections (const connArrays& block) = 0;
+};
+
 class fixedProb_connection : public connection
 {
         Q_OBJECT
@@ -224,6 +443,7 @@ public:
     void write_node_xml(QXmlStreamWriter &xmlOut);
     void import_parameters_from_xml(QDomNode &);
     QLayout * drawLayout(nl_rootdata * data, viewVZLayoutEditHandler * viewVZhandler, nl_rootlayout * rootLay);
+    bool getStatistics (int srcSize, int dstSize, connectionStatistics& stats) const;
     connection * newFromExisting() {
         fixedProb_connection * c = new fixedProb_connection;
         c->p = this->p;
@@ -237,15 +457,102 @@ public:
     float p;
     int seed;
 
+    /*!
+     * The destinations, in order, which source src connects to out of
+     * numDst. Each row is drawn from its own counter based stream keyed
+     * on seed and src, and the gap to the next connection is taken from
+     * a geometric distribution, so a row costs time in proportion to
+     * its connections and is the same whatever order rows are made in.
+     */
+    void generateRow (int src, int numDst, QVector<qint32>& dsts) const;
+
+    /*!
+     * Generate all the connections from numSrc sources to numDst
+     * destinations, blocks of rows being made in parallel and handed to
+     * sink in source order, so the whole list is never held at once.
+     * Returns false if sink stopped the generation. With a rowStride
+     * above 1 only every rowStride-th source is generated, each row in
+     * full and exactly as it would be otherwise, so a sample of the
+     * connections costs time in proportion to its size.
+     */
+    bool generate (int numSrc, int numDst, fixedProbSink& sink, int rowStride = 1) const;
+
 private:
 };
 
+/*!
+ * \brief The copy of a saved explicit connection list into a
+ * csv_connection's backing store, put off so that a project opens
+ * without reading every connection list first.
+ *
+ * The copy is run by whichever comes first: the background runner
+ * started once the project has loaded, or the connection itself on
+ * the first access to its backing store, which then waits for a copy
+ * already under way. The job holds no pointer to the connection, so a
+ * connection deleted while its job is queued just cancels it.
+ */
+class deferredStoreImport
+{
+public:
+    deferredStoreImport(const QString& source, const QString& store);
+
+    /*!
+     * Run the copy on this thread if it has not been started, or wait
+     * for it if it has. Returns false if the copy failed.
+     */
+    bool finish (void);
+
+    /*!
+     * Drop the copy if it has not been started, or wait for it if it
+     * has.
+     */
+    void cancel (void);
+
+    /*!
+     * Run the copy on this thread if it has not been started. Used by
+     * the background runner.
+     */
+    void runIfPending (void);
+
+    /*!
+     * Run the copies of jobs on the global thread pool, in order.
+     */
+    static void startInBackground (const QVector<QSharedPointer<deferredStoreImport> >& jobs);
+
+private:
+    enum importState { Pending, Running, Done, Cancelled };
+
+    /*!
+     * Copy source into store, after the store header. Called without
+     * the lock held.
+     */
+    bool copy (void);
+
+    QMutex lock;
+    QWaitCondition finished;
+    importState state;
+    bool ok;
+    QString source;
+    QString store;
+};
+
+/*!
+ * \brief The connStoreShare class marks a backing store which is shared
+ * by the csv_connections copied from one another (see
+ * csv_connection::newFromExisting), so that copying a connection does
+ * not copy its list. A connection moves on to a store of its own before
+ * it writes to one which is still shared.
+ */
+class connStoreShare : public QSharedData
+{
+};
+
 /*!
  * \brief The csv_connection class
  * This class is a subclass of connection. It allows the use of explicit connection lists
  * in the form of source-destination pairs, with an optional individual or global delay.
  */
-class csv_connection : public connection
+class csv_connection : public connection, public residentData
 {
     Q_OBJECT
 public:
@@ -264,6 +571,11 @@ public:
      * This format consists of ASCII text data written as S,D,L/n where S is the source index,
      * D is the destination index and L (optional) is the delay.
      *
+     * The file is memory mapped where possible and parsed in chunks, split
+     * at line ends, on a thread pool; the rows of each batch of chunks are
+     * then written to the backing store in order. Emits progress() as the
+     * import proceeds.
+     *
      * Returns false if the import failed for any reason, otherwise returns true.
      */
     bool import_csv (QString filename);
@@ -278,11 +590,32 @@ public:
      */
     void import_packed_binary (QFile &fileIn, QFile& fileOut);
 
+    /*!
+     * Copy the connection data into the file exportFileName in the
+     * packed binary format, in fixed size blocks. Emits progress() as
+     * the copy proceeds. Returns false if the export failed.
+     */
+    bool exportPackedBinary (const QString& exportFileName);
+
+    /*!
+     * Identifies the content exportPackedBinary() would write: which
+     * backing store, how many times it has been written, and its shape.
+     */
+    QByteArray getExportKey (void) const;
+
     /*!
      * Gets data from the file "backing store" in this->uuidFilename
-     * and puts it in the QVector<conn>& conns.
+     * and puts it in the QVector<conn>& conns. For a native format
+     * backing store with delays this is a single read() straight
+     * into the memory of conns.
      */
-    void getAllData (QVector<conn>& conns);
+    void getAllData (QVector<conn>& conns) const;
+
+    /*!
+     * Gets data from the backing store in struct-of-arrays form. The
+     * arrays are filled directly from the memory mapped file.
+     */
+    void getAllData (connArrays& arrays) const;
 
     float getData (int, int) const;
     float getData (QModelIndex &index) const;
@@ -307,11 +640,6 @@ public:
      */
     void updateDataForNumCols (int num);
 
-    //! Setup, and return a datastream for the given QFile object.
-    void setupDataStream (QFile& f, QDataStream& ds);
-    //! Shutdown the datastream/QFile.
-    void shutdownDataStream (QFile& f);
-
     void setData (const QModelIndex& index, float value);
     void setData (int, int, float);
 
@@ -322,6 +650,19 @@ public:
      */
     void setAllData (QVector<conn>& conns);
 
+    /*!
+     * Write out the connection data from struct-of-arrays form. If
+     * arrays.delay is empty, delays are written as 0 when numCols is 3.
+     */
+    void setAllData (const connArrays& arrays);
+
+    /*!
+     * Write out the connections of a fixed probability connection from
+     * numSrc to numDst neurons, streamed into the backing store as they
+     * are generated. Delays are written as 0 when numCols is 3.
+     */
+    void setAllData (const fixedProb_connection& fixedProb, int numSrc, int numDst);
+
     void clearData (void);
     void flushChangesToDisk (void);
     void abortChanges (void);
@@ -332,6 +673,17 @@ public:
      */
     void write_node_xml (QXmlStreamWriter& xmlOut);
     void import_parameters_from_xml (QDomNode&);
+    /*!
+     * The copy of this connection's saved list which is still to be
+     * made, or null. projectObject hands these to
+     * deferredStoreImport::startInBackground() after loading.
+     */
+    QSharedPointer<deferredStoreImport> getPendingImport (void) const;
+    /*!
+     * Complete the deferred copy, if there is one. Everything that reads
+     * or modifies the backing store calls this first.
+     */
+    void waitForImport (void) const;
     void read_metadata_xml (QDomNode&);
     void setFileName (QString name);
     QString getFileName (void);
@@ -348,8 +700,288 @@ public:
      */
     void copyDataValues (const csv_connection* other);
 
+    /*!
+     * Sort the connection data by src and then dst index, keeping the
+     * order of equal rows, if settingsCache::sortConnections() is on.
+     * newRowOf, if given, is set to the row each row has moved to.
+     * Returns true if any row moved. Nothing else is moved with the
+     * rows; see permuteSynapseProperties().
+     */
+    bool sortData (QVector<int>* newRowOf = NULL);
+
+    /*!
+     * Move the values of the explicit list properties of the weight
+     * update of the synapse this connection belongs to, which are
+     * indexed by row, to follow rows which have moved to newRowOf.
+     */
+    void permuteSynapseProperties (const QVector<int>& newRowOf);
+
+    /*!
+     * The connections indexed by source and by destination. The index
+     * is built on first use, or read back from the file kept next to
+     * the backing store, and discarded whenever the data is written.
+     */
+    const connectionAdjacency& getAdjacency (void) const;
+
+    /*!
+     * The memory held for this connection besides its backing store:
+     * the adjacency index and the mapped view of the store.
+     */
+    qint64 getResidentBytes (void) const;
+
+    /*!
+     * Let go of the adjacency index and the mapped view of the backing
+     * store. Both are read back from disk when next needed. Used for
+     * connections which are only kept for an undo, and for those which
+     * the residencyManager finds least recently used.
+     */
+    void releaseResident (void) const;
+
+    /*!
+     * The residentData view of the above, for the residencyManager. The
+     * changes not yet written are not counted, as they can't be let go.
+     */
+    qint64 residentBytes (void) const;
+    void evictResident (void);
+
+    /*!
+     * The statistics are counted in one pass over the backing store, and
+     * a second for the delay histogram if there are per-connection
+     * delays, shared between threads a block of rows at a time. They are
+     * kept with the list, in memory and in a file next to the backing
+     * store, until it is next written. May be called from any thread.
+     */
+    bool getStatistics (int srcSize, int dstSize, connectionStatistics& stats) const;
+
+    /*!
+     * The number of connections from src, or to dst.
+     */
+    int getOutDegree (int src) const;
+    int getInDegree (int dst) const;
+
+    /*!
+     * The rows of the connections from src, or to dst. count is set to
+     * the number of rows.
+     */
+    const int* getOutgoing (int src, int& count) const;
+    const int* getIncoming (int dst, int& count) const;
+
 private:
 
+    /*!
+     * Called whenever the backing store is about to be written. Discards
+     * the adjacency index and moves the store on to a new generation. If
+     * the store is shared with a copy of this connection, this connection
+     * is first given a store of its own, holding the same rows unless
+     * keepContents is false because the store is about to be rewritten.
+     */
+    void storeChanged (bool keepContents = true);
+
+    /*!
+     * Shared by the connections using the same backing store.
+     */
+    QExplicitlySharedDataPointer<connStoreShare> storeShare;
+
+    /*!
+     * Discard the adjacency index and remove its file.
+     */
+    void invalidateAdjacency (void);
+
+    /*!
+     * Counts the writes to the backing store, so that an exported copy
+     * can be recognised as current; see getExportKey.
+     */
+    quint64 storeGeneration;
+
+    /*!
+     * Read the index from its file, returning false if there is none or
+     * it does not match the backing store.
+     */
+    bool loadAdjacency (void) const;
+
+    /*!
+     * Write the index to its file.
+     */
+    void saveAdjacency (void) const;
+
+    /*!
+     * The index file's name; uuidFilename with the extension .adj.
+     */
+    QString getAdjacencyFileName (void) const;
+
+    mutable connectionAdjacency adjacency;
+    mutable bool adjacencyValid;
+
+    /*!
+     * Count the statistics into stats, or read them back from their file,
+     * returning false if there is none or it does not match the backing
+     * store and the sizes in stats.
+     */
+    void countStatistics (void) const;
+    bool loadStatistics (void) const;
+    void saveStatistics (void) const;
+    QString getStatisticsFileName (void) const;
+    friend class connStatsRunner;
+
+    // the statistics last asked for, and the storeGeneration they are of
+    mutable connectionStatistics stats;
+    mutable quint64 statsGeneration;
+    mutable bool statsValid;
+    mutable QMutex statsLock;
+
+    /*!
+     * Map the uuidFilename backing store into memory, if it isn't
+     * already mapped. Returns false if the file could not be opened
+     * or mapped. The mapping is used by getData() so that per-cell
+     * reads (as made by csv_connectionModel::data) don't have to open,
+     * seek and close the file each time.
+     */
+    bool mapBackingStore (void) const;
+
+    /*!
+     * Release the memory mapped view of the backing store. Must be
+     * called before the backing store is written to, truncated or
+     * removed.
+     */
+    void unmapBackingStore (void) const;
+
+    /*!
+     * The number of bytes occupied by one row in the backing store,
+     * when its delays are held as floats.
+     */
+    int getRowStride (void) const;
+
+    /*!
+     * The number of bytes occupied by one row in a legacy backing
+     * store. The QDataStream writes floats as doubles, so a delay
+     * column takes 8 bytes.
+     */
+    int getLegacyRowStride (void) const;
+
+    /*!
+     * Read the header from the start of f. Returns true if f is a
+     * native format backing store, leaving f positioned at the first
+     * row. Returns false for a legacy file, leaving f at position 0.
+     */
+    bool readStoreHeader (QFile& f) const;
+
+    /*!
+     * Write the native format header at the current position of f,
+     * followed by table if it is not empty, in which case the rows
+     * which follow must be written with delay table indices, and with
+     * src and dst indices srcBytes and dstBytes wide.
+     */
+    void writeStoreHeader (QFile& f, const QVector<float>& table = QVector<float>(),
+                           int srcBytes = sizeof(qint32), int dstBytes = sizeof(qint32)) const;
+
+    /*!
+     * Set the layout of the backing store from the flags and delay
+     * table of its header.
+     */
+    void setStoredLayout (quint32 flags, const float* table, int tableSize) const;
+
+    /*!
+     * The delay table of the backing store, read with its header or
+     * when it is mapped, and empty if the delays are held as floats
+     * (or there are none).
+     */
+    mutable QVector<float> delayTable;
+
+    /*!
+     * The width in bytes of the src and dst indices in the backing
+     * store, read with the delay table.
+     */
+    mutable int storedSrcBytes;
+    mutable int storedDstBytes;
+
+    /*!
+     * Is the backing store laid out other than as packed binary rows,
+     * with narrow indices or a delay table?
+     */
+    bool isStoreCompact (void) const;
+
+    /*!
+     * The number of bytes occupied by one row in the backing store as
+     * it is, which is less than getRowStride() if it is compact.
+     */
+    int getStoredRowStride (void) const;
+
+    /*!
+     * The offset of the first row in the backing store, past the
+     * header and any delay table.
+     */
+    qint64 getStoredRowsOffset (void) const;
+
+    /*!
+     * Unpack count rows of the backing store, as it is laid out, from
+     * p. del may be NULL if the delays are not wanted.
+     */
+    void decodeStoredRows (const uchar* p, int count, qint32* src, qint32* dst, float* del) const;
+
+    /*!
+     * Try to write the n rows given by src, dst and del (each read
+     * every stride elements; a stride of 0 repeats the first) to f,
+     * from its start, with the narrowest indices that hold them and a
+     * delay table if there are few enough distinct delays. del is
+     * ignored without a delay column. Returns false, having written
+     * nothing, if the rows can't be stored any smaller.
+     */
+    bool writeCompactStore (QFile& f, int n, const qint32* src, const qint32* dst,
+                            const float* del, int stride, int delStride) const;
+
+    /*!
+     * Rewrite a compact backing store as packed binary rows, so that
+     * it can be modified in place.
+     */
+    void expandCompactStore (void);
+
+    /*!
+     * Read every row of a legacy, big-endian QDataStream backing
+     * store.
+     */
+    void getAllDataLegacy (QFile& f, QVector<conn>& conns) const;
+
+    /*!
+     * Rewrite a legacy backing store in the native format, so that
+     * it can be modified in place.
+     */
+    void convertLegacyStore (void);
+
+    /*!
+     * Write conns out to a freshly truncated backing store. If
+     * singleDelay is greater than 1, it is written as the delay for
+     * each row in place of conns[i].metric. The store is written
+     * compact where that is smaller, unless compact is false.
+     */
+    void writeAllData (const QVector<conn>& conns, float singleDelay, bool compact = true);
+
+    /*!
+     * Pack the rows of arrays into block and append them to f. Delays
+     * are written as 0 if arrays.delay is short.
+     */
+    void writeStoreRows (QFile& f, const connArrays& arrays, QByteArray& block) const;
+
+    /*!
+     * Is the currently mapped backing store in the legacy format?
+     */
+    mutable bool mappedLegacy;
+
+    /*!
+     * The file which is mapped by mapBackingStore().
+     */
+    mutable QFile mappedFile;
+
+    /*!
+     * Pointer to the start of the mapped backing store, or NULL if
+     * it is not currently mapped.
+     */
+    mutable uchar* mappedData;
+
+    /*!
+     * The size in bytes of the mapped region.
+     */
+    mutable qint64 mappedSize;
+
     /*!
      * If the connection has explicit data which needs to be stored in
      * a binary file, then it needs a filename into which that data is
@@ -407,6 +1039,19 @@ private:
      */
     QDir getLibDir (void) const;
 
+    /*!
+     * The deferred copy of the saved connection list into the backing
+     * store, if import_parameters_from_xml() put one off and it has not
+     * yet been waited for.
+     */
+    mutable QSharedPointer<deferredStoreImport> pendingImport;
+
+    /*!
+     * Drop the deferred copy, if there is one, before the backing store
+     * is rewritten from scratch.
+     */
+    void discardImport (void) const;
+
     /*!
      * Replace chars in str which are not in the string allowed with
      * replaceChar.
@@ -415,11 +1060,6 @@ private:
                           const QString& allowed,
                           const char replaceChar);
 
-    /*!
-     * Sort connection data by src and dst indices.
-     */
-    void sortData (void);
-
     /*!
      * Function to be used with std::sort to sort connections.
      */
@@ -430,6 +1070,74 @@ public slots:
      * Called when the "Global delay" checkbox is changed.
      */
     void updateGlobalDelay (void);
+
+signals:
+    /*!
+     * Percentage progress through a long running copy of the
+     * connection data, such as exportPackedBinary() or import_csv().
+     */
+    void progress (int);
+};
+
+/*!
+ * \brief The connectionGenerationControl class is how a run of a connection
+ * script reports its progress and is told to stop. Each run has its own,
+ * shared by the run and its connection, so that a run on another thread
+ * never needs the connection itself.
+ */
+class connectionGenerationControl
+{
+public:
+    connectionGenerationControl() { this->progressPercent.fetchAndStoreOrdered(-1); }
+    int progress() { return this->progressPercent.fetchAndAddOrdered(0); }
+    void setProgress(double fraction) { this->progressPercent.fetchAndStoreOrdered(qBound(0, (int) (fraction*100.0), 100)); }
+    void cancel() { this->cancelRequested.fetchAndStoreOrdered(1); }
+    bool cancelled() { return this->cancelRequested.fetchAndAddOrdered(0) != 0; }
+private:
+    QAtomicInt progressPercent;
+    QAtomicInt cancelRequested;
+};
+
+/*!
+ * The output of a connection script, unpacked into C++ forms.
+ */
+struct outputUnPackaged
+{
+    outputUnPackaged() : isArrays(false) {}
+    QVector <conn> connections;
+    QVector <double> weights;
+    // filled instead of connections when the script returns arrays
+    connArrays arrays;
+    bool isArrays;
+};
+
+/*!
+ * \brief The connectionGeneration struct is one run of a connection script:
+ * copies of everything the run reads, taken on the GUI thread by
+ * pythonscript_connection::beginGeneration(), and what the script made.
+ */
+struct connectionGeneration
+{
+    connectionGeneration() : serial(0), hasWeight(false), hasDelay(false), locationsAsArrays(false), samePopulation(false) {}
+
+    int serial;
+    QSharedPointer <connectionGenerationControl> control;
+
+    QString scriptText;
+    QStringList parNames;
+    QVector <double> parValues;
+    QVector <QString> parText;
+    QString weightProp;
+    bool hasWeight;
+    bool hasDelay;
+    bool locationsAsArrays;
+    bool samePopulation;
+    QVector <loc> srcLocs;
+    QVector <loc> dstLocs;
+
+    outputUnPackaged output;
+    // set if the script failed or the run was cancelled
+    QString errors;
 };
 
 class pythonscript_connection : public connection
@@ -446,6 +1154,10 @@ public:
         this->scriptValidates = false;
         this->hasWeight = false;
         this->hasDelay = false;
+        this->locationsAsArrays = false;
+        this->conns = (QVector <conn> *) 0;
+        this->generationSerial = 0;
+        this->generationsRunning = 0;
     }
 
     ~pythonscript_connection();
@@ -488,6 +1200,8 @@ public:
     bool scriptValidates;
     bool hasWeight;
     bool hasDelay;
+    // the script is tagged #LOCARRAYS: pass it views of the locations, not lists
+    bool locationsAsArrays;
 
     ParameterInstance *getPropPointer();
     QStringList getPropList();
@@ -498,9 +1212,69 @@ public:
 
     connection * newFromExisting();
 
+    /*!
+     * Run the script on locations that have already been generated and
+     * store the result, all on the calling thread: beginGeneration(),
+     * runGeneration() and applyGeneration() in turn.
+     */
+    void generate_connections(const QVector <loc> &srcLocs, const QVector <loc> &dstLocs);
+    void refetchScript();
+
+    /*!
+     * Set up job to run the script on these locations, on the GUI thread.
+     * A run begun later supersedes it, so its result is then dropped.
+     */
+    void beginGeneration(connectionGeneration &job, const QVector <loc> &srcLocs, const QVector <loc> &dstLocs);
+
+    /*!
+     * Run the script of job. This reads and writes only job, so it may be
+     * called on any thread, and the connection may be deleted meanwhile.
+     */
+    static void runGeneration(connectionGeneration &job);
 
+    /*!
+     * Store the result of job in the connection, its explicit list target
+     * and its weights, on the GUI thread. Returns false if the result was
+     * dropped as a later run has been begun.
+     */
+    bool applyGeneration(connectionGeneration &job);
+
+    /*!
+     * Whether a run begun for this connection has not been applied yet.
+     */
+    bool isGenerating();
+
+    /*!
+     * Regenerate each of pyConns which has changed, running the scripts
+     * on a pool of threads. They share the interpreter, so they overlap
+     * where a script releases the GIL (as numpy does). The results are
+     * stored on the calling thread once all have run. Connections which
+     * are being generated elsewhere (by the 3D view, say) are skipped. A
+     * script which fails is left changed, so that regenerateConnections()
+     * reports the error when the list is next needed.
+     */
+    static void regenerateChanged(const QVector<pythonscript_connection*>& pyConns);
+
+    /*!
+     * How far the running script has got, as a percentage, from its calls
+     * to connectionProgress(fraction); -1 if it has not said.
+     */
+    int generationProgress();
+    void setGenerationProgress(double fraction);
+
+    /*!
+     * Stop the latest run of the script, which may be on another thread.
+     * The script is interrupted, or stopped at its next call to
+     * connectionProgress, and the run returns with its errors set.
+     */
+    void cancelGeneration();
+    bool generationCancelled();
 
 private:
+    // the control of the latest run begun
+    QSharedPointer <connectionGenerationControl> generationControl;
+    int generationSerial;
+    int generationsRunning;
 
     csv_connection * explicitList;
     bool isAList;
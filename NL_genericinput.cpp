@@ -27,6 +27,7 @@
 #include "NL_connection.h"
 #include "NL_projection_and_synapse.h"
 #include "EL_experiment.h"
+#include "SC_settings.h"
 
 genericInput::genericInput()
 {
@@ -318,8 +319,7 @@ void genericInput::draw(QPainter *painter, float GLscale, float viewX, float vie
             // draw end marker
             QPainterPath endPoint;
 
-            QSettings settings;
-            float dpi_ratio = settings.value("dpi", 1.0).toFloat();
+            float dpi_ratio = settingsCache::dpiRatio();
             if (style == saveNetworkImageDrawStyle) {
                 // Ensure image output isn't affected by dpi_ratio:
                 dpi_ratio = 1;
@@ -859,7 +859,7 @@ QSharedPointer <systemObject> genericInput::newFromExisting(QMap<systemObject *,
     return qSharedPointerCast <systemObject> (newIn);
 }
 
-void genericInput::remapSharedPointers(QMap<systemObject *, QSharedPointer<systemObject> > objectMap)
+void genericInput::remapSharedPointers(const QMap<systemObject *, QSharedPointer<systemObject> > &objectMap)
 {
 
     // connection, if it has a generator
@@ -120,7 +120,7 @@ public:
 
     QSharedPointer <systemObject> newFromExisting(QMap<systemObject *, QSharedPointer<systemObject> > &objectMap);
 
-    void remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> >);
+    void remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &);
 };
 
 #endif // GENERICINPUT_H
@@ -0,0 +1,320 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "NL_kernelconnectivity.h"
+#include "SC_layout_cinterpreter.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+
+locationGrid::locationGrid(const QVector <loc> &locations, float radius)
+{
+    this->locations = locations;
+    this->radius = radius;
+    cellSize = 1;
+    mins.x = 0; mins.y = 0; mins.z = 0;
+    dims[0] = 0; dims[1] = 0; dims[2] = 0;
+    if (locations.isEmpty()) {
+        return;
+    }
+
+    loc maxes = locations[0];
+    mins = locations[0];
+    for (int i = 1; i < locations.size(); ++i) {
+        mins.x = qMin(mins.x, locations[i].x); maxes.x = qMax(maxes.x, locations[i].x);
+        mins.y = qMin(mins.y, locations[i].y); maxes.y = qMax(maxes.y, locations[i].y);
+        mins.z = qMin(mins.z, locations[i].z); maxes.z = qMax(maxes.z, locations[i].z);
+    }
+
+    // cells as wide as the radius, so a query tests at most 27 of them,
+    // unless that makes many more cells than locations
+    float extent[3] = {maxes.x - mins.x, maxes.y - mins.y, maxes.z - mins.z};
+    cellSize = radius;
+    if (!(cellSize > 0)) {
+        cellSize = qMax(qMax(extent[0], extent[1]), qMax(extent[2], 1.0f));
+    }
+    for (;;) {
+        qint64 numCells = 1;
+        for (int d = 0; d < 3; ++d) {
+            dims[d] = qMax(1, int(floor(extent[d]/cellSize)) + 1);
+            numCells *= dims[d];
+        }
+        if (numCells <= 8 * (qint64) locations.size() + 64) {
+            break;
+        }
+        cellSize *= 2;
+    }
+    int numCells = dims[0]*dims[1]*dims[2];
+
+    // count then fill the cell of each location, so each cell lists its
+    // locations in increasing order
+    QVector <int> cellOf(locations.size());
+    cellStart.fill(0, numCells+1);
+    for (int i = 0; i < locations.size(); ++i) {
+        int x = qBound(0, int((locations[i].x - mins.x)/cellSize), dims[0]-1);
+        int y = qBound(0, int((locations[i].y - mins.y)/cellSize), dims[1]-1);
+        int z = qBound(0, int((locations[i].z - mins.z)/cellSize), dims[2]-1);
+        cellOf[i] = (z*dims[1] + y)*dims[0] + x;
+        ++cellStart[cellOf[i]+1];
+    }
+    for (int c = 0; c < numCells; ++c) {
+        cellStart[c+1] += cellStart[c];
+    }
+    cellItems.resize(locations.size());
+    QVector <int> fillPos = cellStart;
+    for (int i = 0; i < locations.size(); ++i) {
+        cellItems[fillPos[cellOf[i]]++] = i;
+    }
+}
+
+void locationGrid::within(const loc &p, QVector <qint32> &found) const
+{
+    found.clear();
+    if (locations.isEmpty()) {
+        return;
+    }
+    int lo[3], hi[3];
+    float c[3] = {p.x - mins.x, p.y - mins.y, p.z - mins.z};
+    for (int d = 0; d < 3; ++d) {
+        lo[d] = qBound(0, int(floor((c[d] - radius)/cellSize)), dims[d]-1);
+        hi[d] = qBound(0, int(floor((c[d] + radius)/cellSize)), dims[d]-1);
+    }
+    float r2 = radius*radius;
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            for (int x = lo[0]; x <= hi[0]; ++x) {
+                int cell = (z*dims[1] + y)*dims[0] + x;
+                for (int k = cellStart[cell]; k < cellStart[cell+1]; ++k) {
+                    const loc &q = locations[cellItems[k]];
+                    float dx = q.x - p.x, dy = q.y - p.y, dz = q.z - p.z;
+                    if (dx*dx + dy*dy + dz*dz <= r2) {
+                        found.push_back(cellItems[k]);
+                    }
+                }
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+}
+
+kernelConnectivity::kernelConnectivity()
+{
+    shape = gaussianKernel;
+    pMax = 1.0;
+    sigma = 1.0;
+    radius = KERNEL_DEFAULT_SUPPORT;
+    wMax = 1.0;
+    delayMin = 0.0;
+    delayScale = 0.0;
+    seed = 123;
+    allowSelf = false;
+}
+
+bool kernelConnectivity::isKernelScript(const QString &script)
+{
+    return script.contains(KERNEL_TAG);
+}
+
+bool kernelConnectivity::configure(const QString &script, const QStringList &parNames, const QVector <double> &parValues, QString &error)
+{
+    // the shape is the word after the tag
+    QString tagged = script.mid(script.indexOf(KERNEL_TAG) + QString(KERNEL_TAG).size());
+    QString shapeName = tagged.section(QRegExp("\\s"), 0, 0, QString::SectionSkipEmpty).toLower();
+    if (shapeName == "gaussian") {
+        shape = gaussianKernel;
+    } else if (shapeName == "exponential") {
+        shape = exponentialKernel;
+    } else if (shapeName == "uniform") {
+        shape = uniformKernel;
+    } else {
+        error = "Kernel Error: unknown kernel '" + shapeName + "'; use gaussian, exponential or uniform.";
+        return false;
+    }
+
+    QMap <QString, double> pars;
+    for (int i = 0; i < parNames.size() && i < parValues.size(); ++i) {
+        pars[parNames[i]] = parValues[i];
+    }
+    pMax = pars.value("p_max", 1.0);
+    sigma = pars.value("sigma", 0.0);
+    wMax = pars.value("w_max", 1.0);
+    delayMin = pars.value("delay_min", 0.0);
+    delayScale = pars.value("delay_scale", 0.0);
+    seed = (quint32) pars.value("seed", 123.0);
+    allowSelf = pars.value("allow_self", 0.0) != 0.0;
+
+    if (shape != uniformKernel && !(sigma > 0.0)) {
+        error = "Kernel Error: sigma must be more than 0.";
+        return false;
+    }
+    if (pars.contains("radius")) {
+        radius = (float) pars["radius"];
+    } else if (shape == uniformKernel) {
+        error = "Kernel Error: a uniform kernel needs a radius parameter.";
+        return false;
+    } else {
+        radius = (float) (KERNEL_DEFAULT_SUPPORT * sigma);
+    }
+    if (!(radius > 0.0f)) {
+        error = "Kernel Error: radius must be more than 0.";
+        return false;
+    }
+    if (pMax < 0.0 || pMax > 1.0) {
+        error = "Kernel Error: p_max must be between 0 and 1.";
+        return false;
+    }
+    return true;
+}
+
+double kernelConnectivity::shapeAt(double d2) const
+{
+    switch (shape) {
+    case gaussianKernel:
+        return exp(-d2/(2.0*sigma*sigma));
+    case exponentialKernel:
+        return exp(-sqrt(d2)/sigma);
+    case uniformKernel:
+        break;
+    }
+    return 1.0;
+}
+
+void kernelConnectivity::generateRow(int s, const loc &p, const QVector <loc> &dst, const QVector <qint32> &candidates,
+                                     bool samePopulation, bool withDelay, bool withWeight,
+                                     connArrays &out, QVector <double> &weights) const
+{
+    counterRandom rng;
+    rng.seed = this->seed;
+    rng.index = (quint32) s;
+    rng.counter = 0;
+
+    for (int k = 0; k < candidates.size(); ++k) {
+        int d = candidates[k];
+        if (samePopulation && d == s && !allowSelf) {
+            continue;
+        }
+        double dx = dst[d].x - p.x, dy = dst[d].y - p.y, dz = dst[d].z - p.z;
+        double d2 = dx*dx + dy*dy + dz*dz;
+        double strength = shapeAt(d2);
+        double prob = pMax*strength;
+        if (prob < 1.0 && counterRandomUniform(&rng) >= prob) {
+            continue;
+        }
+        out.src.push_back(s);
+        out.dst.push_back(d);
+        if (withDelay) {
+            out.delay.push_back((float) (delayMin + delayScale*sqrt(d2)));
+        }
+        if (withWeight) {
+            weights.push_back(wMax*strength);
+        }
+    }
+}
+
+namespace {
+    // the connections and weights of one block of sources
+    struct kernelBlock {
+        connArrays arrays;
+        QVector <double> weights;
+    };
+
+    // generates the connections of sources first to end-1 into block
+    class kernelRowRunner : public QRunnable
+    {
+    public:
+        kernelRowRunner (const kernelConnectivity* kernel, const locationGrid* grid, const QVector <loc>* src, const QVector <loc>* dst,
+                         int first, int end, bool samePopulation, bool withDelay, bool withWeight, kernelBlock* block)
+            : kernel(kernel), grid(grid), src(src), dst(dst), first(first), end(end),
+              samePopulation(samePopulation), withDelay(withDelay), withWeight(withWeight), block(block) {}
+        void run() {
+            block->arrays.src.clear();
+            block->arrays.dst.clear();
+            block->arrays.delay.clear();
+            block->weights.clear();
+            QVector <qint32> candidates;
+            for (int s = first; s < end; ++s) {
+                grid->within((*src)[s], candidates);
+                kernel->generateRow(s, (*src)[s], *dst, candidates, samePopulation, withDelay, withWeight,
+                                    block->arrays, block->weights);
+            }
+        }
+    private:
+        const kernelConnectivity* kernel;
+        const locationGrid* grid;
+        const QVector <loc>* src;
+        const QVector <loc>* dst;
+        int first;
+        int end;
+        bool samePopulation;
+        bool withDelay;
+        bool withWeight;
+        kernelBlock* block;
+    };
+}
+
+bool kernelConnectivity::generate(const QVector <loc> &src, const QVector <loc> &dst, bool samePopulation,
+                                  bool withDelay, bool withWeight, connArrays &out, QVector <double> &weights,
+                                  kernelProgress * progress) const
+{
+    out.src.clear();
+    out.dst.clear();
+    out.delay.clear();
+    weights.clear();
+
+    locationGrid grid(dst, this->radius);
+
+    int threads = qMax (1, QThread::idealThreadCount());
+    QVector <kernelBlock> blocks (threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount (threads);
+
+    // a batch of blocks at a time, appended in source order
+    for (qint64 first = 0; first < src.size(); first += (qint64)threads*KERNEL_BLOCK_SOURCES) {
+        int used = 0;
+        for (int t = 0; t < threads; ++t) {
+            qint64 start = first + (qint64)t*KERNEL_BLOCK_SOURCES;
+            if (start >= src.size()) {
+                break;
+            }
+            int end = (int) qMin ((qint64)src.size(), start + KERNEL_BLOCK_SOURCES);
+            pool.start (new kernelRowRunner (this, &grid, &src, &dst, (int) start, end,
+                                             samePopulation, withDelay, withWeight, &blocks[t]));
+            ++used;
+        }
+        pool.waitForDone();
+        for (int t = 0; t < used; ++t) {
+            out.src += blocks[t].arrays.src;
+            out.dst += blocks[t].arrays.dst;
+            out.delay += blocks[t].arrays.delay;
+            weights += blocks[t].weights;
+        }
+        double done = (double) qMin ((qint64)src.size(), first + (qint64)threads*KERNEL_BLOCK_SOURCES) / src.size();
+        if (progress && !progress->report(done)) {
+            return false;
+        }
+    }
+    return true;
+}
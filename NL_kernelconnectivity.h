@@ -0,0 +1,154 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef NL_KERNELCONNECTIVITY_H
+#define NL_KERNELCONNECTIVITY_H
+
+#include "globalHeader.h"
+
+// the tag which marks a script connection as a kernel generated natively
+#define KERNEL_TAG "#KERNEL="
+// source neurons generated together by one pool job
+#define KERNEL_BLOCK_SOURCES 512
+// the reach of a Gaussian or exponential kernel, in sigmas, if it has no radius
+#define KERNEL_DEFAULT_SUPPORT 3.0
+
+/*!
+ * \brief The locationGrid class buckets locations into a uniform grid of
+ * cells about as wide as a query radius, so that the locations within that
+ * radius of a point are found by testing only the cells around it.
+ */
+class locationGrid
+{
+public:
+    locationGrid(const QVector <loc> &locations, float radius);
+    /*!
+     * Set found to the indices of the locations within the radius of p, in
+     * increasing order.
+     */
+    void within(const loc &p, QVector <qint32> &found) const;
+
+private:
+    QVector <loc> locations;
+    float radius;
+    loc mins;
+    float cellSize;
+    int dims[3];
+    // locations of cell c are cellItems[cellStart[c]] to cellItems[cellStart[c+1]-1]
+    QVector <int> cellStart;
+    QVector <int> cellItems;
+};
+
+/*!
+ * Told how far a kernelConnectivity::generate has got.
+ */
+class kernelProgress
+{
+public:
+    virtual ~kernelProgress() {}
+    /*!
+     * Called after each batch of source neurons. Return false to stop the
+     * generation.
+     */
+    virtual bool report(double fraction) = 0;
+};
+
+/*!
+ * \brief The kernelConnectivity class generates distance dependent
+ * connectivity natively, for the Python script connections whose script is
+ * tagged #KERNEL=gaussian, #KERNEL=exponential or #KERNEL=uniform. The script
+ * is not run; its #PARNAME parameters configure the kernel:
+ *
+ *   p_max       the probability of a connection at distance 0 (default 1)
+ *   sigma       the width of a Gaussian or exponential kernel
+ *   radius      the distance beyond which there are no connections (by
+ *               default KERNEL_DEFAULT_SUPPORT sigmas; needed for uniform)
+ *   w_max       with #HASWEIGHT, the weight at distance 0, falling off with
+ *               the kernel (default 1)
+ *   delay_min, delay_scale
+ *               with #HASDELAY, the delay is delay_min + delay_scale*distance
+ *   seed        the random seed (default 123)
+ *   allow_self  if not 0, a population connected to itself may connect a
+ *               neuron to itself
+ *
+ * Only the destination neurons within the radius of each source are
+ * tested, found through a locationGrid, and the sources are shared between
+ * a pool of threads. Each source draws from its own counterRandom stream, so
+ * the connections do not depend on the number of threads.
+ */
+class kernelConnectivity
+{
+public:
+    enum kernelShape {
+        gaussianKernel,
+        exponentialKernel,
+        uniformKernel
+    };
+
+    kernelConnectivity();
+
+    static bool isKernelScript(const QString &script);
+
+    /*!
+     * Set the kernel from a tagged script and the values of its parameters.
+     * Returns false, with error set, if they do not make a kernel.
+     */
+    bool configure(const QString &script, const QStringList &parNames, const QVector <double> &parValues, QString &error);
+
+    /*!
+     * Connect src to dst, in source then destination order, filling out and,
+     * if withWeight, weights. samePopulation says src and dst are the same
+     * neurons. Returns false if progress stopped the generation.
+     */
+    bool generate(const QVector <loc> &src, const QVector <loc> &dst, bool samePopulation,
+                  bool withDelay, bool withWeight, connArrays &out, QVector <double> &weights,
+                  kernelProgress * progress = 0) const;
+
+    /*!
+     * Generate the connections of source neuron s, at p, into out and
+     * weights, from candidates, the destinations within the radius of p.
+     */
+    void generateRow(int s, const loc &p, const QVector <loc> &dst, const QVector <qint32> &candidates,
+                     bool samePopulation, bool withDelay, bool withWeight,
+                     connArrays &out, QVector <double> &weights) const;
+
+    float getRadius() const {return radius;}
+
+private:
+    // the kernel at squared distance d2, 1 at distance 0
+    double shapeAt(double d2) const;
+
+    kernelShape shape;
+    double pMax;
+    double sigma;
+    float radius;
+    double wMax;
+    double delayMin;
+    double delayScale;
+    quint32 seed;
+    bool allowSelf;
+};
+
+#endif // NL_KERNELCONNECTIVITY_H
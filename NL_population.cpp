@@ -610,6 +610,10 @@ void population::animate(QSharedPointer<population>thisSharedPointer)
     float delta[2];
     delta[HORIZ] = this->animspeed*(this->targx - this->x);
     delta[VERT] = this->animspeed*(this->targy - this->y);
+    if (fabs(this->targx - this->x) < POPULATION_ANIM_SNAP && fabs(this->targy - this->y) < POPULATION_ANIM_SNAP) {
+        delta[HORIZ] = this->targx - this->x;
+        delta[VERT] = this->targy - this->y;
+    }
 
     this->x = this->x + delta[HORIZ];
     this->y = this->y + delta[VERT];
@@ -618,6 +622,11 @@ void population::animate(QSharedPointer<population>thisSharedPointer)
     this->top = this->y+this->size/2.0;
     this->bottom = this->y-this->size/2.0;
 
+    // nothing attached has moved
+    if (delta[HORIZ] == 0 && delta[VERT] == 0) {
+        return;
+    }
+
     // update projections:
     for (int i = 0; i < this->projections.size(); ++i) {
         this->projections[i]->animate(thisSharedPointer, QPointF(delta[HORIZ], delta[VERT]), this->projections[i]);
@@ -1173,7 +1182,7 @@ QSharedPointer <systemObject> population::newFromExisting(QMap <systemObject *,
     return newPop;
 }
 
-void population::remapSharedPointers(QMap<systemObject *, QSharedPointer<systemObject> > pointerMap)
+void population::remapSharedPointers(const QMap<systemObject *, QSharedPointer<systemObject> > &pointerMap)
 {
     // let's do this!
     this->neuronType->remapPointers(pointerMap);
@@ -1181,7 +1190,6 @@ void population::remapSharedPointers(QMap<systemObject *, QSharedPointer<systemO
     // and update any projections:
     for (int i = 0; i < this->projections.size(); ++i) {
         // if the proj is in the pointermap...
-        DBG() << pointerMap << this->projections[i].data();
         if (pointerMap.contains(this->projections[i].data())) {
             // remap input
             this->projections[i] = qSharedPointerDynamicCast <projection> (pointerMap[this->projections[i].data()]);
@@ -37,6 +37,10 @@
 #define LOWER 0
 #define UPPER 1
 
+// a population this close to where it is going is put there, so that the
+// animation ends rather than creeping on for ever
+#define POPULATION_ANIM_SNAP 0.0005f
+
 class population : public systemObject
 {
 public:
@@ -84,7 +88,7 @@ public:
     void setupBounds();
     void makeSpikeSource(QSharedPointer<population> thisSharedPointer);
     QSharedPointer <systemObject> newFromExisting(QMap<systemObject *, QSharedPointer<systemObject> > &);
-    void remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> >);
+    void remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &);
 
     QColor colour;
 
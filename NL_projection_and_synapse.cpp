@@ -27,6 +27,7 @@
 #include "NL_connection.h"
 #include "EL_experiment.h"
 #include "SC_projectobject.h"
+#include "SC_settings.h"
 #include <sstream>
 #include <iomanip>
 #include "globalHeader.h"
@@ -219,7 +220,7 @@ QSharedPointer < systemObject > synapse::newFromExisting(QMap<systemObject *, QS
     return qSharedPointerCast <systemObject> (newSyn);
 }
 
-void synapse::remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> > objectMap)
+void synapse::remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &objectMap)
 {
     this->weightUpdateCmpt->remapPointers(objectMap);
     this->postSynapseCmpt->remapPointers(objectMap);
@@ -295,6 +296,10 @@ projection::projection()
 
     this->projDrawStyle = standardDrawStyleExcitatory;
     this->showLabel = false;
+
+    this->cache.styleValid = false;
+    this->cache.pathValid = false;
+    this->cache.labelGLscale = -1;
 }
 
 projection::~projection()
@@ -516,83 +521,9 @@ void projection::draw(QPainter *painter, float GLscale,
 
         // Colour definitions and line width factor for this
         // projection, dependent upon the connection type.
-        QColor colour = QCOL_BASICBLUE;
-        float connTypeWidthFactor = 1.0;
-        if (this->multipleConnTypes()) {
-            colour = QCOL_PURPLE1;
-            connTypeWidthFactor = WIDTHFACTOR_MULTIPLE;
-        } else {
-            // Set colour based on first synapse connection type.
-            colour = QCOL_BASICBLUE;
-            QString ctype("");
-            if (!this->synapses.isEmpty() && !this->synapses[0]->connectionTypeStr.isEmpty()) {
-
-
-                if (this->synapses[0]->connectionType->hasGenerator()) {
-                    csv_connection* cn = (csv_connection*)this->synapses[0]->connectionType;
-                    ctype += cn->generator->scriptText;
-                } else {
-                    // Make colour vary based on md5sum of the text in ctype:
-                    ctype += this->synapses[0]->connectionTypeStr;
-                }
-
-                QString result(QCryptographicHash::hash(ctype.toStdString().c_str(),
-                                                        QCryptographicHash::Md5).toHex());
-                QByteArray r2(result.toStdString().c_str(),2);
-                bool ok = false;
-                // Vary the hue in the colour
-                colour.setHsl(r2.toInt(&ok, 16),0xff,0x40);
-
-                connTypeWidthFactor = WIDTHFACTOR_PYTHONCONN;
-
-            } else if (!this->synapses.isEmpty()) {
-                // No connectionTypeStr, so use type
-                switch (this->synapses[0]->connectionType->type) {
-                case AlltoAll:
-                    colour = QCOL_BLUE1;
-                    connTypeWidthFactor = WIDTHFACTOR_ALLTOALL;
-                    break;
-                case OnetoOne:
-                    colour = QCOL_RED1;
-                    connTypeWidthFactor = WIDTHFACTOR_ONETOONE;
-                    break;
-                case FixedProb:
-                    colour = QCOL_GREEN1;
-                    connTypeWidthFactor = WIDTHFACTOR_FIXEDPROB;
-                    break;
-                case CSV:
-                    // if it has a Script Annotation, then need to colour it later based on this information:
-                    if (this->synapses[0]->connectionType->hasGenerator()) {
-
-                        // Make colour vary based on md5sum of the text in ctype:
-                        csv_connection* cn = (csv_connection*)this->synapses[0]->connectionType;
-                        ctype += cn->generator->scriptText;
-
-                        QString result(QCryptographicHash::hash(ctype.toStdString().c_str(),
-                                                                QCryptographicHash::Md5).toHex());
-                        QByteArray r2(result.toStdString().c_str(),2);
-                        bool ok = false;
-                        // Vary the hue in the colour
-                        colour.setHsl(r2.toInt(&ok, 16),0xff,0x40);
-                        connTypeWidthFactor = WIDTHFACTOR_PYTHONCONN;
-
-                    } else {
-                        colour = QCOL_GREEN3;
-                        connTypeWidthFactor = WIDTHFACTOR_CSV;
-                    }
-                    break;
-                case Python:
-                case CSA:
-                default:
-                    colour = QCOL_BLACK;
-                    connTypeWidthFactor = WIDTHFACTOR_OTHER;
-                    break;
-                }
-
-            } else {
-                // No Synapses?
-            }
-        }
+        this->updateDrawStyle();
+        QColor colour = this->cache.colour;
+        float connTypeWidthFactor = this->cache.connTypeWidthFactor;
 
         // In some cases, the colour for the projection is passed
         // in. In most cases we want to choose the colour here. This
@@ -700,8 +631,7 @@ void projection::draw(QPainter *painter, float GLscale,
             start = this->start;
             end = this->curves.back().end;
 
-            QSettings settings;
-            float dpi_ratio = settings.value("dpi", 1.0).toFloat();
+            float dpi_ratio = settingsCache::dpiRatio();
             if (saveNetworkImage) {
                 // Ensure image output isn't affected by dpi_ratio:
                 dpi_ratio = 1;
@@ -729,22 +659,21 @@ void projection::draw(QPainter *painter, float GLscale,
             linePen.setColor(colour);
             painter->setPen(linePen);
 
-            QPainterPath path;
-            // start curve drawing
-            path.moveTo(this->transformPoint(start));
-
-            // draw curves
-            for (int i = 0; i < this->curves.size(); ++i) {
-                if (this->curves.size()-1 == i) {
-                    path.cubicTo(this->transformPoint(this->curves[i].C1),
-                                 this->transformPoint(this->curves[i].C2),
-                                 this->transformPoint(end));
-                } else {
-                    path.cubicTo(this->transformPoint(this->curves[i].C1),
-                                 this->transformPoint(this->curves[i].C2),
-                                 this->transformPoint(this->curves[i].end));
-                }
+            // how big the projection is on screen decides how much of it
+            // is worth drawing
+            float extent = this->screenExtent(GLscale);
+            if (!saveNetworkImage && extent < PROJECTION_LOD_LINE_PIXELS) {
+                painter->drawLine(this->transformPoint(start), this->transformPoint(end));
+                painter->setPen(oldPen);
+                break;
             }
+            bool showDetail = saveNetworkImage || extent >= PROJECTION_LOD_DETAIL_PIXELS;
+
+            // the cached curves, moved into the view as transformPoint does
+            QTransform toView(GLscale/2.0, 0, 0, -GLscale/2.0,
+                              (this->tempTrans.viewX*GLscale + this->tempTrans.width)/2.0,
+                              (this->tempTrans.viewY*GLscale + this->tempTrans.height)/2.0);
+            QPainterPath path = toView.map(this->cache.path);
 
             // only draw number of synapses for Projections
             if (this->type == projectionObject) {
@@ -786,7 +715,7 @@ void projection::draw(QPainter *painter, float GLscale,
                 painter->fillPath(endPoint, colour);
             }
 
-            if (this->showLabel) {
+            if (this->showLabel && showDetail) {
                 this->drawLabel(painter, linePen, pointerLinePen, labelPen, GLscale, scale);
             }
 
@@ -851,15 +780,129 @@ projection::multipleConnTypes(void)
     return manyConnTypes;
 }
 
+namespace {
+    // the script a connection is generated from, which its colour is made from
+    QString generatorScript(connection * conn)
+    {
+        if (conn->hasGenerator()) {
+            return ((csv_connection *) conn)->generator->scriptText;
+        }
+        return QString();
+    }
+}
+
 void
-projection::drawLabel (QPainter* painter, QPen& linePen, QPen& pointerLinePen, QPen& labelPen,
-                       const float GLscale, const float scale)
+projection::updateDrawStyle(void)
 {
+    bool same = this->cache.styleValid && this->cache.connections.size() == this->synapses.size();
+    for (int i = 0; i < this->synapses.size() && same; ++i) {
+        connection * conn = this->synapses[i]->connectionType;
+        same = this->cache.connections[i] == conn
+            && this->cache.connectionTypes[i] == (int) conn->type
+            && this->cache.connectionTypeStrs[i] == this->synapses[i]->connectionTypeStr
+            && this->cache.scripts[i] == generatorScript(conn);
+    }
+    if (same) {
+        return;
+    }
+
+    this->cache.connections.clear();
+    this->cache.connectionTypes.clear();
+    this->cache.connectionTypeStrs.clear();
+    this->cache.scripts.clear();
+    for (int i = 0; i < this->synapses.size(); ++i) {
+        connection * conn = this->synapses[i]->connectionType;
+        this->cache.connections.push_back(conn);
+        this->cache.connectionTypes.push_back((int) conn->type);
+        this->cache.connectionTypeStrs.push_back(this->synapses[i]->connectionTypeStr);
+        this->cache.scripts.push_back(generatorScript(conn));
+    }
+
+    QColor colour = QCOL_BASICBLUE;
+    float connTypeWidthFactor = 1.0;
+    if (this->multipleConnTypes()) {
+        colour = QCOL_PURPLE1;
+        connTypeWidthFactor = WIDTHFACTOR_MULTIPLE;
+    } else {
+        // Set colour based on first synapse connection type.
+        colour = QCOL_BASICBLUE;
+        QString ctype("");
+        if (!this->synapses.isEmpty() && !this->synapses[0]->connectionTypeStr.isEmpty()) {
+
+
+            if (this->synapses[0]->connectionType->hasGenerator()) {
+                csv_connection* cn = (csv_connection*)this->synapses[0]->connectionType;
+                ctype += cn->generator->scriptText;
+            } else {
+                // Make colour vary based on md5sum of the text in ctype:
+                ctype += this->synapses[0]->connectionTypeStr;
+            }
+
+            QString result(QCryptographicHash::hash(ctype.toStdString().c_str(),
+                                                    QCryptographicHash::Md5).toHex());
+            QByteArray r2(result.toStdString().c_str(),2);
+            bool ok = false;
+            // Vary the hue in the colour
+            colour.setHsl(r2.toInt(&ok, 16),0xff,0x40);
+
+            connTypeWidthFactor = WIDTHFACTOR_PYTHONCONN;
+
+        } else if (!this->synapses.isEmpty()) {
+            // No connectionTypeStr, so use type
+            switch (this->synapses[0]->connectionType->type) {
+            case AlltoAll:
+                colour = QCOL_BLUE1;
+                connTypeWidthFactor = WIDTHFACTOR_ALLTOALL;
+                break;
+            case OnetoOne:
+                colour = QCOL_RED1;
+                connTypeWidthFactor = WIDTHFACTOR_ONETOONE;
+                break;
+            case FixedProb:
+                colour = QCOL_GREEN1;
+                connTypeWidthFactor = WIDTHFACTOR_FIXEDPROB;
+                break;
+            case CSV:
+                // if it has a Script Annotation, then need to colour it later based on this information:
+                if (this->synapses[0]->connectionType->hasGenerator()) {
+
+                    // Make colour vary based on md5sum of the text in ctype:
+                    csv_connection* cn = (csv_connection*)this->synapses[0]->connectionType;
+                    ctype += cn->generator->scriptText;
+
+                    QString result(QCryptographicHash::hash(ctype.toStdString().c_str(),
+                                                            QCryptographicHash::Md5).toHex());
+                    QByteArray r2(result.toStdString().c_str(),2);
+                    bool ok = false;
+                    // Vary the hue in the colour
+                    colour.setHsl(r2.toInt(&ok, 16),0xff,0x40);
+                    connTypeWidthFactor = WIDTHFACTOR_PYTHONCONN;
+
+                } else {
+                    colour = QCOL_GREEN3;
+                    connTypeWidthFactor = WIDTHFACTOR_CSV;
+                }
+                break;
+            case Python:
+            case CSA:
+            default:
+                colour = QCOL_BLACK;
+                connTypeWidthFactor = WIDTHFACTOR_OTHER;
+                break;
+            }
+
+        } else {
+            // No Synapses?
+        }
+    }
+
+    this->cache.colour = colour;
+    this->cache.connTypeWidthFactor = connTypeWidthFactor;
+
     // Are all synapse connection types the same? If so we
     // don't need to list them all.
     bool manyConnTypes = this->multipleConnTypes();
-
-    // Now draw the synapse labels
+    this->cache.labels.clear();
     for (int i = 0; i < this->synapses.size(); ++i) {
         QString ctype("");
         if (manyConnTypes) {
@@ -879,37 +922,100 @@ projection::drawLabel (QPainter* painter, QPen& linePen, QPen& pointerLinePen, Q
         } else {
             ctype += this->synapses[i]->connectionTypeStr;
         }
+        this->cache.labels.push_back(ctype);
+    }
 
-        // Set a suitable font for the projection labels
-        QFont oldFont = painter->font();
-        QFont font = painter->font();
-        font.setPointSizeF(1.6*GLscale/20.0);
-        painter->setFont(font);
+    this->cache.styleValid = true;
+    this->cache.labelGLscale = -1;
+}
 
-        // Call getLabelPos for the position of the label and
-        // its "pointer line". Note I'm passing the *unscaled*
-        // font to this.
-        QPointF startLinePos(0,0);
-        QPointF labelPos = this->transformPoint(this->getLabelPos (font, i, ctype, scale, startLinePos));
-        startLinePos = this->transformPoint(startLinePos);
-        // Find a point for the end of the pointer line:
-        QPointF endLinePos = this->transformPoint(this->getBezierPos (this->curves.size()-1, 0.95f));
+void
+projection::updateDrawPath(void)
+{
+    bool same = this->cache.pathValid && this->cache.start == this->start
+        && this->cache.curves.size() == this->curves.size();
+    for (int i = 0; i < this->curves.size() && same; ++i) {
+        same = this->cache.curves[i].C1 == this->curves[i].C1
+            && this->cache.curves[i].C2 == this->curves[i].C2
+            && this->cache.curves[i].end == this->curves[i].end;
+    }
+    if (same) {
+        return;
+    }
+
+    this->cache.start = this->start;
+    this->cache.curves = this->curves;
+    this->cache.path = QPainterPath();
+    this->cache.path.moveTo(this->start);
+    for (int i = 0; i < this->curves.size(); ++i) {
+        this->cache.path.cubicTo(this->curves[i].C1, this->curves[i].C2, this->curves[i].end);
+    }
+    this->cache.bounds = this->cache.path.controlPointRect();
+    this->cache.pathValid = true;
 
-        // Text first in same colour as projection line
-        painter->setPen(labelPen);
-        painter->drawText(labelPos, ctype);
+    // the labels are placed against the curves
+    this->cache.labelGLscale = -1;
+}
 
-        if (i == 0) { // only one pointer line per projection
-            painter->setPen(pointerLinePen);
-            QPainterPath pointerLine;
-            pointerLine.moveTo(startLinePos);
-            pointerLine.lineTo(endLinePos);
-            painter->drawPath(pointerLine);
+float
+projection::screenExtent(float GLscale)
+{
+    this->updateDrawPath();
+    return qMax(this->cache.bounds.width(), this->cache.bounds.height())*GLscale/2.0;
+}
+
+void
+projection::drawLabel (QPainter* painter, QPen& linePen, QPen& pointerLinePen, QPen& labelPen,
+                       const float GLscale, const float scale)
+{
+    // Set a suitable font for the projection labels
+    QFont oldFont = painter->font();
+    QFont font = painter->font();
+    font.setPointSizeF(1.6*GLscale/20.0);
+    painter->setFont(font);
+
+    // The labels are laid out again only when the zoom, the curves or the
+    // texts have changed, and kept in model coordinates so that panning
+    // does not lay them out.
+    if (this->cache.labelGLscale != GLscale || !(this->cache.labelFont == font)) {
+        this->cache.labelGLscale = GLscale;
+        this->cache.labelFont = font;
+        this->cache.labelTexts.clear();
+        this->cache.labelPositions.clear();
+        for (int i = 0; i < this->cache.labels.size(); ++i) {
+            // Call getLabelPos for the position of the label and
+            // its "pointer line". Note I'm passing the *unscaled*
+            // font to this.
+            QPointF startLinePos(0,0);
+            this->cache.labelPositions.push_back(this->getLabelPos (font, i, this->cache.labels[i], scale, startLinePos));
+            if (i == 0) {
+                this->cache.pointerStart = startLinePos;
+            }
+            QStaticText text(this->cache.labels[i]);
+            text.setTextFormat(Qt::PlainText);
+            text.prepare(QTransform(), font);
+            this->cache.labelTexts.push_back(text);
         }
+        // Find a point for the end of the pointer line:
+        this->cache.pointerEnd = this->getBezierPos (this->curves.size()-1, 0.95f);
+    }
 
-        painter->setFont(oldFont);
-        painter->setPen(linePen);
+    // Text first in same colour as projection line. The label positions
+    // are baselines, as for drawText, and static text is placed by its top
+    painter->setPen(labelPen);
+    QPointF toTop(0, painter->fontMetrics().ascent());
+    for (int i = 0; i < this->cache.labelTexts.size(); ++i) {
+        painter->drawStaticText(this->transformPoint(this->cache.labelPositions[i]) - toTop, this->cache.labelTexts[i]);
     }
+
+    // only one pointer line per projection
+    if (!this->cache.labelTexts.isEmpty()) {
+        painter->setPen(pointerLinePen);
+        painter->drawLine(this->transformPoint(this->cache.pointerStart), this->transformPoint(this->cache.pointerEnd));
+    }
+
+    painter->setFont(oldFont);
+    painter->setPen(linePen);
 }
 
 QPointF
@@ -1055,14 +1161,14 @@ QPointF projection::transformPoint(QPointF point)
 void projection::drawHandles(QPainter *painter, float GLscale,
                              float viewX, float viewY, int width, int height)
 {
-    if (curves.size()>0) {
+    // handles crowd out a projection which is small on screen
+    if (curves.size()>0 && this->screenExtent(GLscale) >= PROJECTION_LOD_DETAIL_PIXELS) {
         this->setupTrans(GLscale, viewX, viewY, width, height);
 
         QPainterPath path;
         QPainterPath lines;
 
-        QSettings settings;
-        float dpi_ratio = settings.value("dpi", 1.0).toFloat();
+        float dpi_ratio = settingsCache::dpiRatio();
 
 #ifdef Q_OS_MAC
         dpi_ratio *= 0.5;
@@ -1174,17 +1280,23 @@ bool projection::is_clicked(float xGL, float yGL, float GLscale)
     return false;
 }
 
+// true if the handle at point is under the cursor: the handle is a circle of
+// the given radius, so compare distances rather than building a path for it
+static bool handleContains(const QPointF &point, const QPointF &cursor, float radius)
+{
+    QPointF d = cursor - point;
+    return d.x()*d.x() + d.y()*d.y() < radius*radius;
+}
+
 bool projection::selectControlPoint(float xGL, float yGL, float GLscale)
 {
     QPointF cursor(xGL, yGL);
 
-    QSettings settings;
-    float dpi_ratio = settings.value("dpi", 1.0).toFloat();
+    float dpi_ratio = settingsCache::dpiRatio();
+    float radius = 10.0/GLscale*dpi_ratio;
 
     // test start:
-    QPainterPath test;
-    test.addEllipse(this->start, 10.0/GLscale*dpi_ratio, 10.0/GLscale*dpi_ratio);
-    if (test.contains(cursor)) {
+    if (handleContains(this->start, cursor, radius)) {
         this->selectedControlPoint.start = true;
         // NB: What happends to selectedControlPoint.ind here?
         return true;
@@ -1192,25 +1304,19 @@ bool projection::selectControlPoint(float xGL, float yGL, float GLscale)
 
     // now check all the bezierCurves in turn:
     for (int i = 0; i < this->curves.size(); ++i) {
-        QPainterPath testEnd;
-        testEnd.addEllipse(this->curves[i].end, 10.0/GLscale*dpi_ratio, 10.0/GLscale*dpi_ratio);
-        if (testEnd.contains(cursor)) {
+        if (handleContains(this->curves[i].end, cursor, radius)) {
             this->selectedControlPoint.start = false;
             this->selectedControlPoint.type = p_end;
             this->selectedControlPoint.ind = i;
             return true;
         }
-        QPainterPath testC1;
-        testC1.addEllipse(this->curves[i].C1, 10.0/GLscale*dpi_ratio, 10.0/GLscale*dpi_ratio);
-        if (testC1.contains(cursor)) {
+        if (handleContains(this->curves[i].C1, cursor, radius)) {
             this->selectedControlPoint.start = false;
             this->selectedControlPoint.type = C1;
             this->selectedControlPoint.ind = i;
             return true;
         }
-        QPainterPath testC2;
-        testC2.addEllipse(this->curves[i].C2, 10.0/GLscale*dpi_ratio, 10.0/GLscale*dpi_ratio);
-        if (testC2.contains(cursor)) {
+        if (handleContains(this->curves[i].C2, cursor, radius)) {
             this->selectedControlPoint.start = false;
             this->selectedControlPoint.type = C2;
             this->selectedControlPoint.ind = i;
@@ -2436,7 +2542,7 @@ QSharedPointer < systemObject > projection::newFromExisting(QMap <systemObject *
     return qSharedPointerCast <systemObject> (newProj);
 }
 
-void projection::remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> > objectMap)
+void projection::remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &objectMap)
 {
     // remap src and dst:
     this->source = qSharedPointerDynamicCast <population> (objectMap[this->source.data()]);
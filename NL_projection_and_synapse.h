@@ -33,6 +33,12 @@
 #define HORIZ 0
 #define VERT 1
 
+// projections smaller than this on screen, in pixels, are drawn as a
+// straight line, and those smaller than the second without their labels
+// or handles
+#define PROJECTION_LOD_LINE_PIXELS 8
+#define PROJECTION_LOD_DETAIL_PIXELS 40
+
 struct bezierCurve {
     QPointF C1;
     QPointF C2;
@@ -82,7 +88,7 @@ public:
     int getSynapseIndex();
     virtual void delAll(nl_rootdata *);
     QSharedPointer < systemObject > newFromExisting(QMap <systemObject *, QSharedPointer <systemObject> > &);
-    void remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> >);
+    void remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &);
 
     /*!
      * This copies the pointers to source and destination populations
@@ -163,7 +169,7 @@ public:
     }
 
     QSharedPointer < systemObject > newFromExisting(QMap<systemObject *, QSharedPointer<systemObject> > &);
-    void remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> >);
+    void remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &);
 
     trans tempTrans;
     void setupTrans(float GLscale, float viewX, float viewY, int width, int height);
@@ -236,6 +242,52 @@ private:
      */
     QPointF getBezierPos (int curveIndex, float t);
 
+    /*!
+     * What draw() works out for a projection, kept until what it was
+     * worked out from changes: the colour, line width and label texts from
+     * the synapses' connections, the curves as a path in model
+     * coordinates, and the labels laid out for the zoom last drawn at.
+     */
+    struct drawCache {
+        // the connections the style was worked out from
+        bool styleValid;
+        QVector < connection * > connections;
+        QVector < int > connectionTypes;
+        QStringList connectionTypeStrs;
+        QStringList scripts;
+        QColor colour;
+        float connTypeWidthFactor;
+        QStringList labels;
+
+        // the curves the path was built from
+        bool pathValid;
+        QPointF start;
+        QVector < bezierCurve > curves;
+        QPainterPath path;
+        QRectF bounds;
+
+        // labels laid out at labelGLscale, in model coordinates
+        float labelGLscale;
+        QFont labelFont;
+        QVector < QStaticText > labelTexts;
+        QVector < QPointF > labelPositions;
+        QPointF pointerStart;
+        QPointF pointerEnd;
+    };
+    drawCache cache;
+
+    /*!
+     * Bring the cached colour and labels, or the cached path, up to date.
+     */
+    void updateDrawStyle(void);
+    void updateDrawPath(void);
+
+    /*!
+     * The size of the projection on screen, in pixels, for choosing how
+     * much of it to draw. Brings the cached path up to date.
+     */
+    float screenExtent(float GLscale);
+
     int srcPos;
     int dstPos;
     drawStyle projDrawStyle;
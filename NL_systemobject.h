@@ -65,7 +65,7 @@ public:
      * Takes a map from old shared pointers to new ones - used
      * to update references when copy / pasting systemObjects
      */
-    virtual void remapSharedPointers(QMap <systemObject *, QSharedPointer <systemObject> >) {return;}
+    virtual void remapSharedPointers(const QMap <systemObject *, QSharedPointer <systemObject> > &) {return;}
 
 
     /*!
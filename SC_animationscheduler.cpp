@@ -0,0 +1,83 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_animationscheduler.h"
+#include "SC_profiler.h"
+#include <QCoreApplication>
+
+animationScheduler::animationScheduler(QObject * parent) :
+    QObject(parent)
+{
+    this->timer.setInterval(ANIMATION_FRAME_INTERVAL_MS);
+    connect(&this->timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+animationScheduler * animationScheduler::instance(void)
+{
+    // owned by the application, so its timer goes with the event loop
+    static animationScheduler * scheduler = (animationScheduler *) 0;
+    if (scheduler == (animationScheduler *) 0) {
+        scheduler = new animationScheduler(QCoreApplication::instance());
+    }
+    return scheduler;
+}
+
+void animationScheduler::requestFrames(animatedView * view)
+{
+    animationScheduler * scheduler = instance();
+    if (!scheduler->views.contains(view)) {
+        scheduler->views.push_back(view);
+    }
+    if (!scheduler->timer.isActive()) {
+        scheduler->timer.start();
+    }
+}
+
+void animationScheduler::remove(animatedView * view)
+{
+    animationScheduler * scheduler = instance();
+    scheduler->views.removeAll(view);
+    if (scheduler->views.isEmpty()) {
+        scheduler->timer.stop();
+    }
+}
+
+void animationScheduler::tick()
+{
+    PROFILE_SCOPE("animationScheduler::tick");
+
+    // a view may ask for more frames, or be removed, while it animates
+    QList <animatedView *> animating = this->views;
+    for (int i = 0; i < animating.size(); ++i) {
+        if (!this->views.contains(animating[i])) {
+            continue;
+        }
+        if (!animating[i]->animateFrame()) {
+            this->views.removeAll(animating[i]);
+        }
+    }
+    if (this->views.isEmpty()) {
+        this->timer.stop();
+    }
+}
@@ -0,0 +1,78 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef SC_ANIMATIONSCHEDULER_H
+#define SC_ANIMATIONSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QList>
+
+// the time between animation frames (ms)
+#define ANIMATION_FRAME_INTERVAL_MS 30
+
+/*!
+ * A view which is animated by the animationScheduler.
+ */
+class animatedView
+{
+public:
+    virtual ~animatedView() {}
+    /*!
+     * Advance the animation by a frame, redrawing what has changed.
+     * Return true if there is more to do, or false once everything has
+     * arrived (or the view is hidden) so that no more frames are needed.
+     */
+    virtual bool animateFrame() = 0;
+};
+
+/*!
+ * \brief The animationScheduler class runs one animation timer for all the
+ * views. A view calls requestFrames() when something in it starts to move
+ * or needs redrawing, and is then given a frame every
+ * ANIMATION_FRAME_INTERVAL_MS until its animateFrame() returns false. The
+ * timer only runs while some view is animating, so an idle application is
+ * not woken up at all.
+ */
+class animationScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static void requestFrames(animatedView * view);
+    /*!
+     * Stop animating view; called as it is destroyed.
+     */
+    static void remove(animatedView * view);
+
+private:
+    explicit animationScheduler(QObject * parent);
+    static animationScheduler * instance(void);
+    QTimer timer;
+    QList <animatedView *> views;
+
+private slots:
+    void tick();
+};
+
+#endif // SC_ANIMATIONSCHEDULER_H
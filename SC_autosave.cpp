@@ -0,0 +1,553 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_autosave.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "SC_settings.h"
+#include "SC_profiler.h"
+#include "NL_population.h"
+#include "NL_projection_and_synapse.h"
+#include "NL_genericinput.h"
+#include "NL_connection.h"
+#include "CL_classes.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QUndoStack>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QStandardPaths>
+#endif
+
+namespace {
+    QDir recoveryRoot()
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+        QDir lib_dir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+        QDir lib_dir = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+        // a directory, so the files removed from lib_dir at exit are not its
+        return QDir(lib_dir.absoluteFilePath(AUTOSAVE_RECOVERY_DIR));
+    }
+
+    QString hashOf(const QByteArray &bytes)
+    {
+        return QString(QCryptographicHash::hash(bytes, QCryptographicHash::Md5).toHex());
+    }
+
+    // write through a temporary file, so that a crash part way through
+    // never leaves a file with a good name and bad content
+    bool writeArtefact(const QDir &dir, const QString &name, const QByteArray &bytes)
+    {
+        QString path = dir.absoluteFilePath(name);
+        QFile f(path + ".tmp");
+        if (!f.open(QIODevice::WriteOnly) || f.write(bytes) != bytes.size()) {
+            DBG() << "Could not write the recovery file" << f.fileName();
+            f.remove();
+            return false;
+        }
+        f.close();
+        QFile::remove(path);
+        return f.rename(path);
+    }
+
+    bool readArtefact(const QDir &dir, const QString &name, QByteArray &bytes)
+    {
+        QFile f(dir.absoluteFilePath(name));
+        if (!f.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        bytes = f.readAll();
+        return true;
+    }
+
+    /*!
+     * Writes a journal from a snapshot, on the autosaver's thread.
+     */
+    class journalWriter : public QRunnable
+    {
+    public:
+        journalWriter(QSharedPointer <const modelSnapshot> snapshot, const QString &dirPath,
+                      const QString &projectFile, const QStringList &commands) :
+            snapshot(snapshot), dir(dirPath), projectFile(projectFile), commands(commands), ok(true) {}
+
+        void run()
+        {
+            PROFILE_SCOPE("autosaver::writeJournal");
+            if (!this->dir.exists() && !QDir().mkpath(this->dir.absolutePath())) {
+                DBG() << "Could not create the recovery directory" << this->dir.absolutePath();
+                return;
+            }
+
+            QByteArray journal;
+            QDataStream out(&journal, QIODevice::WriteOnly);
+            out.setVersion(QDataStream::Qt_4_6);
+            out << (quint32) AUTOSAVE_MAGIC << (qint32) AUTOSAVE_VERSION;
+            out << this->projectFile << this->snapshot->projectName << QDateTime::currentDateTime();
+            out << (qint32) this->snapshot->undoIndex << this->commands;
+
+            const QVector <populationSnapshot> &pops = this->snapshot->populations;
+            out << (qint32) pops.size();
+            for (int i = 0; i < pops.size(); ++i) {
+                out << pops[i].name;
+                this->writeComponent(out, pops[i].neuron);
+                out << (qint32) pops[i].projections.size();
+                for (int j = 0; j < pops[i].projections.size(); ++j) {
+                    const projectionSnapshot &pr = pops[i].projections[j];
+                    out << pr.source << pr.destination << (qint32) pr.synapses.size();
+                    for (int k = 0; k < pr.synapses.size(); ++k) {
+                        this->writeComponent(out, pr.synapses[k].weightUpdate);
+                        this->writeComponent(out, pr.synapses[k].postSynapse);
+                        this->writeConnection(out, pr.synapses[k].connectivity);
+                    }
+                }
+            }
+
+            // an earlier journal stays until this one is complete
+            if (!this->ok || !writeArtefact(this->dir, AUTOSAVE_JOURNAL_FILE, journal)) {
+                return;
+            }
+
+            // and the artefacts it no longer uses go
+            QStringList filters;
+            filters << "p-*.bin" << "c-*.bin" << "*.tmp";
+            QStringList files = this->dir.entryList(filters, QDir::Files);
+            for (int i = 0; i < files.size(); ++i) {
+                if (!this->used.contains(files[i])) {
+                    this->dir.remove(files[i]);
+                }
+            }
+        }
+
+    private:
+        // an artefact named for its content is already current if it exists
+        void writeOnce(const QString &name, const QByteArray &bytes)
+        {
+            this->used.insert(name);
+            if (!this->dir.exists(name) && !writeArtefact(this->dir, name, bytes)) {
+                this->ok = false;
+            }
+        }
+
+        void writeProperty(QDataStream &out, const propertySnapshot &p)
+        {
+            out << p.name << p.isStateVariable << (qint32) p.type;
+            if (p.value.size() + p.indices.size() <= AUTOSAVE_INLINE_VALUES) {
+                out << QString() << p.value << p.indices;
+                return;
+            }
+            QByteArray bytes;
+            QDataStream values(&bytes, QIODevice::WriteOnly);
+            values.setVersion(QDataStream::Qt_4_6);
+            values << p.value << p.indices;
+            QString name = "p-" + hashOf(bytes) + ".bin";
+            this->writeOnce(name, bytes);
+            out << name;
+        }
+
+        void writeComponent(QDataStream &out, const componentSnapshot &c)
+        {
+            out << c.name << c.type << (qint32) c.properties.size();
+            for (int i = 0; i < c.properties.size(); ++i) {
+                this->writeProperty(out, c.properties[i]);
+            }
+            out << (qint32) c.inputs.size();
+            for (int i = 0; i < c.inputs.size(); ++i) {
+                const inputSnapshot &in = c.inputs[i];
+                out << in.source << in.destination << in.srcPort << in.dstPort;
+                this->writeConnection(out, in.connectivity);
+            }
+        }
+
+        void writeConnection(QDataStream &out, const connectionSnapshot &c)
+        {
+            out << (qint32) c.type << c.probability << (qint32) c.seed;
+            this->writeProperty(out, c.delay);
+            if (c.list.isNull()) {
+                out << QString();
+                return;
+            }
+            // the export key changes whenever the list is written to
+            QString name = "c-" + hashOf(c.list->getExportKey()) + ".bin";
+            this->used.insert(name);
+            if (!this->dir.exists(name)) {
+                connArrays arrays;
+                c.list->getAllData(arrays);
+                QByteArray bytes;
+                QDataStream rows(&bytes, QIODevice::WriteOnly);
+                rows.setVersion(QDataStream::Qt_4_6);
+                rows << arrays.src << arrays.dst << arrays.delay;
+                if (!writeArtefact(this->dir, name, bytes)) {
+                    this->ok = false;
+                }
+            }
+            out << name;
+        }
+
+        QSharedPointer <const modelSnapshot> snapshot;
+        QDir dir;
+        QString projectFile;
+        QStringList commands;
+        QSet <QString> used;
+        bool ok;
+    };
+
+    /*!
+     * Reads a journal back into the live network, skipping the values
+     * whose component or connection is no longer there.
+     */
+    class journalReader
+    {
+    public:
+        journalReader(QDataStream &in, const QDir &dir) : in(in), dir(dir) {}
+
+        QStringList missing;
+
+        void readProperty(QSharedPointer <ComponentInstance> cmpt, ParameterInstance * delay)
+        {
+            QString name;
+            bool isStateVariable;
+            qint32 type;
+            QString artefact;
+            QVector <double> value;
+            QVector <int> indices;
+            this->in >> name >> isStateVariable >> type >> artefact;
+            if (artefact.isEmpty()) {
+                this->in >> value >> indices;
+            } else {
+                QByteArray bytes;
+                if (!readArtefact(this->dir, artefact, bytes)) {
+                    this->missing.push_back(artefact);
+                    return;
+                }
+                QDataStream values(bytes);
+                values.setVersion(QDataStream::Qt_4_6);
+                values >> value >> indices;
+            }
+
+            // a property of cmpt, or else the delay of a connection
+            ParameterInstance * par = delay;
+            if (!cmpt.isNull()) {
+                par = (ParameterInstance *) 0;
+                if (isStateVariable) {
+                    for (int i = 0; i < cmpt->StateVariableList.size(); ++i) {
+                        if (cmpt->StateVariableList[i]->name == name) {
+                            par = cmpt->StateVariableList[i];
+                        }
+                    }
+                } else {
+                    for (int i = 0; i < cmpt->ParameterList.size(); ++i) {
+                        if (cmpt->ParameterList[i]->name == name) {
+                            par = cmpt->ParameterList[i];
+                        }
+                    }
+                }
+            }
+            if (par == (ParameterInstance *) 0 || name.isEmpty()) {
+                return;
+            }
+            par->currType = (ParameterType) type;
+            par->value = value;
+            par->indices = indices;
+        }
+
+        void readComponent(QSharedPointer <ComponentInstance> cmpt)
+        {
+            QString name, type;
+            qint32 count;
+            this->in >> name >> type >> count;
+            // a component swapped for another has different properties
+            if (!cmpt.isNull() && cmpt->component->name != name) {
+                cmpt.clear();
+            }
+            for (int i = 0; i < count; ++i) {
+                this->readProperty(cmpt, (ParameterInstance *) 0);
+            }
+            this->in >> count;
+            for (int i = 0; i < count; ++i) {
+                QString source, destination, srcPort, dstPort;
+                this->in >> source >> destination >> srcPort >> dstPort;
+                connection * conn = (connection *) 0;
+                for (int j = 0; !cmpt.isNull() && j < cmpt->inputs.size(); ++j) {
+                    QSharedPointer <genericInput> input = cmpt->inputs[j];
+                    if (!input->isDeleted && input->getSrcName() == source && input->getDestName() == destination
+                        && input->srcPort == srcPort && input->dstPort == dstPort) {
+                        conn = input->conn;
+                    }
+                }
+                this->readConnection(conn);
+            }
+        }
+
+        void readConnection(connection * conn)
+        {
+            qint32 type, seed;
+            float probability;
+            this->in >> type >> probability >> seed;
+
+            // as modelSnapshot, Python script connections are told apart
+            // from the explicit lists they are held in
+            csv_connection * csv = dynamic_cast<csv_connection *> (conn);
+            connectionType liveType = conn ? conn->type : none;
+            if (csv && dynamic_cast<pythonscript_connection *> (csv->generator)) {
+                liveType = Python;
+            }
+            // a change of connection type is an undo command, not a value
+            if (liveType != (connectionType) type) {
+                conn = (connection *) 0;
+                csv = (csv_connection *) 0;
+            }
+
+            if (conn) {
+                this->readProperty(QSharedPointer <ComponentInstance> (), conn->delay);
+            } else {
+                this->readProperty(QSharedPointer <ComponentInstance> (), (ParameterInstance *) 0);
+            }
+
+            fixedProb_connection * fixedProb = dynamic_cast<fixedProb_connection *> (conn);
+            if (fixedProb) {
+                fixedProb->p = probability;
+                fixedProb->seed = seed;
+            }
+
+            QString artefact;
+            this->in >> artefact;
+            if (artefact.isEmpty() || !csv) {
+                return;
+            }
+            QByteArray bytes;
+            if (!readArtefact(this->dir, artefact, bytes)) {
+                this->missing.push_back(artefact);
+                return;
+            }
+            connArrays arrays;
+            QDataStream rows(bytes);
+            rows.setVersion(QDataStream::Qt_4_6);
+            rows >> arrays.src >> arrays.dst >> arrays.delay;
+            csv->setAllData(arrays);
+        }
+
+    private:
+        QDataStream &in;
+        QDir dir;
+    };
+
+    bool readHeader(QDataStream &in, recoveryJournal &journal)
+    {
+        quint32 magic;
+        qint32 version, undoIndex;
+        in.setVersion(QDataStream::Qt_4_6);
+        in >> magic >> version;
+        if (magic != AUTOSAVE_MAGIC || version != AUTOSAVE_VERSION) {
+            return false;
+        }
+        in >> journal.projectFile >> journal.projectName >> journal.written;
+        in >> undoIndex >> journal.commands;
+        return in.status() == QDataStream::Ok;
+    }
+}
+
+autosaver::autosaver(nl_rootdata * data, QObject *parent) :
+    QObject(parent)
+{
+    this->data = data;
+    this->writers.setMaxThreadCount(1);
+    connect(&this->timer, SIGNAL(timeout()), this, SLOT(check()));
+    this->timer.start(AUTOSAVE_CHECK_MS);
+}
+
+autosaver::~autosaver()
+{
+    this->timer.stop();
+    this->writers.waitForDone();
+}
+
+QString autosaver::recoveryDirFor(const QString &projectFile)
+{
+    return recoveryRoot().absoluteFilePath(hashOf(QFileInfo(projectFile).absoluteFilePath().toUtf8()));
+}
+
+void autosaver::check()
+{
+    int minutes = settingsCache::autosaveMinutes();
+    if (minutes <= 0 || this->writers.activeThreadCount() > 0) {
+        return;
+    }
+    if (this->lastStarted.isValid() && this->lastStarted.secsTo(QDateTime::currentDateTime()) < minutes * 60) {
+        return;
+    }
+
+    // an untitled project has no saved copy to recover into
+    projectObject * project = this->data->currProject;
+    if (project == (projectObject *) 0 || project->filePath.isEmpty() || !project->isChanged(this->data)) {
+        return;
+    }
+    QUndoStack * stack = project->undoStack;
+    QPair <const void *, int> state(stack, stack->index());
+    if (this->journalled.contains(project->filePath) && this->journalled[project->filePath] == state) {
+        return;
+    }
+    this->journalled[project->filePath] = state;
+    this->lastStarted = QDateTime::currentDateTime();
+
+    // what has been done, or undone, since the project was saved
+    QStringList commands;
+    int clean = stack->cleanIndex();
+    if (clean >= 0 && stack->index() < clean) {
+        for (int i = stack->index(); i < clean; ++i) {
+            commands.push_back("Undo " + stack->text(i));
+        }
+    } else {
+        for (int i = qMax(0, clean); i < stack->index(); ++i) {
+            commands.push_back(stack->text(i));
+        }
+    }
+
+    QSharedPointer <const modelSnapshot> snapshot = modelSnapshot::take(this->data);
+    this->writers.start(new journalWriter(snapshot, recoveryDirFor(project->filePath), project->filePath, commands));
+}
+
+QVector <recoveryJournal> autosaver::findJournals()
+{
+    QVector <recoveryJournal> journals;
+    QDir root = recoveryRoot();
+    QStringList dirs = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (int i = 0; i < dirs.size(); ++i) {
+        QFile f(QDir(root.absoluteFilePath(dirs[i])).absoluteFilePath(AUTOSAVE_JOURNAL_FILE));
+        if (!f.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QDataStream in(&f);
+        recoveryJournal journal;
+        journal.dirPath = root.absoluteFilePath(dirs[i]);
+        if (readHeader(in, journal)) {
+            journals.push_back(journal);
+        }
+    }
+    return journals;
+}
+
+bool autosaver::recover(const recoveryJournal &journal, nl_rootdata * data, QString &error)
+{
+    QDir dir(journal.dirPath);
+    QFile f(dir.absoluteFilePath(AUTOSAVE_JOURNAL_FILE));
+    if (!f.open(QIODevice::ReadOnly)) {
+        error = "Could not open the journal '" + f.fileName() + "'.";
+        return false;
+    }
+    QDataStream in(&f);
+    recoveryJournal header;
+    if (!readHeader(in, header)) {
+        error = "The journal '" + f.fileName() + "' could not be read.";
+        return false;
+    }
+
+    journalReader reader(in, dir);
+    qint32 numPops;
+    in >> numPops;
+    for (int i = 0; i < numPops && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        in >> name;
+        QSharedPointer <population> pop;
+        for (int p = 0; p < data->populations.size(); ++p) {
+            if (data->populations[p]->name == name && !data->populations[p]->isDeleted) {
+                pop = data->populations[p];
+            }
+        }
+        reader.readComponent(pop.isNull() ? QSharedPointer <ComponentInstance> () : pop->neuronType);
+
+        qint32 numProjs;
+        in >> numProjs;
+        for (int j = 0; j < numProjs; ++j) {
+            QString source, destination;
+            qint32 numSyns;
+            in >> source >> destination >> numSyns;
+            QSharedPointer <projection> proj;
+            for (int p = 0; !pop.isNull() && p < pop->projections.size(); ++p) {
+                QSharedPointer <projection> candidate = pop->projections[p];
+                if (!candidate->isDeleted && candidate->source->name == source
+                    && candidate->destination->name == destination) {
+                    proj = candidate;
+                }
+            }
+            // the synapses are matched in order, as written
+            QVector < QSharedPointer <synapse> > syns;
+            for (int s = 0; !proj.isNull() && s < proj->synapses.size(); ++s) {
+                if (!proj->synapses[s]->isDeleted) {
+                    syns.push_back(proj->synapses[s]);
+                }
+            }
+            for (int k = 0; k < numSyns; ++k) {
+                QSharedPointer <synapse> syn;
+                if (k < syns.size()) {
+                    syn = syns[k];
+                }
+                reader.readComponent(syn.isNull() ? QSharedPointer <ComponentInstance> () : syn->weightUpdateCmpt);
+                reader.readComponent(syn.isNull() ? QSharedPointer <ComponentInstance> () : syn->postSynapseCmpt);
+                reader.readConnection(syn.isNull() ? (connection *) 0 : syn->connectionType);
+            }
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        error = "The journal '" + f.fileName() + "' is incomplete.";
+        return false;
+    }
+    if (!reader.missing.isEmpty()) {
+        error = "Some recovered lists were missing: " + reader.missing.join(", ");
+    }
+
+    // there are no undo commands for what was recovered, so the project
+    // has to be told it is changed
+    if (data->currProject) {
+        data->currProject->recoveredChanges = true;
+        data->currProject->markChanged();
+    }
+    return true;
+}
+
+void autosaver::discard(const QString &projectFile)
+{
+    if (projectFile.isEmpty()) {
+        return;
+    }
+    // a journal being written now would otherwise be left behind
+    this->writers.waitForDone();
+    this->journalled.remove(projectFile);
+
+    QDir dir(recoveryDirFor(projectFile));
+    QStringList files = dir.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); ++i) {
+        dir.remove(files[i]);
+    }
+    recoveryRoot().rmdir(dir.dirName());
+}
+
+void autosaver::discardAll()
+{
+    for (int i = 0; i < this->data->projects.size(); ++i) {
+        this->discard(this->data->projects[i]->filePath);
+    }
+}
@@ -0,0 +1,131 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_AUTOSAVE_H
+#define SC_AUTOSAVE_H
+
+#include "globalHeader.h"
+#include "SC_modelsnapshot.h"
+#include <QThreadPool>
+
+class nl_rootdata;
+
+// the directory, within the application's data directory, holding a
+// recovery directory for each project with journalled changes
+#define AUTOSAVE_RECOVERY_DIR "recovery"
+#define AUTOSAVE_JOURNAL_FILE "journal.bin"
+#define AUTOSAVE_MAGIC 0x53434a4e
+#define AUTOSAVE_VERSION 1
+// how often (ms) the timer looks for changes to journal
+#define AUTOSAVE_CHECK_MS 30000
+// value lists no longer than this go in the journal itself rather than in
+// an artefact file of their own
+#define AUTOSAVE_INLINE_VALUES 64
+
+/*!
+ * What a journal left in the recovery directory says about the changes it
+ * holds, as read by autosaver::findJournals().
+ */
+struct recoveryJournal {
+    QString dirPath;
+    QString projectFile;
+    QString projectName;
+    QDateTime written;
+    // the text of the undo commands made since the project was saved
+    QStringList commands;
+};
+
+/*!
+ * \brief The autosaver class writes the unsaved changes to the current
+ * project into a recovery directory every settingsCache::autosaveMinutes(),
+ * so that they can be offered back if SpineCreator does not close cleanly.
+ *
+ * A journal is only written when the project's undo index has moved since
+ * the last one. A modelSnapshot is taken on the GUI thread, and everything
+ * else is done on a thread of the autosaver's own: the journal holds the
+ * text of the undo commands made since the last save and, for every
+ * component and connection in the network, its property values and
+ * connectivity. Value lists and explicit connection lists are written into
+ * artefact files named by their content, so an unchanged list is never
+ * written twice and a journal only costs the lists that have changed.
+ *
+ * Recovery opens the project as it was last saved and puts the journalled
+ * property values and connectivity back into the parts of the network
+ * which are still there by name. Changes to the structure of the network
+ * (adding, removing or renaming populations, projections and inputs) are
+ * not replayed; their commands are listed for the user to redo.
+ */
+class autosaver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit autosaver(nl_rootdata * data, QObject *parent = 0);
+    ~autosaver();
+
+    /*!
+     * The journals in the recovery directory, as left by a session which
+     * did not close cleanly.
+     */
+    static QVector <recoveryJournal> findJournals();
+
+    /*!
+     * Put the values in journal back into the current project, which must
+     * be journal.projectFile newly opened. Returns false, with the reason
+     * in error, if the journal could not be read; values which no longer
+     * have a place in the network are skipped.
+     */
+    static bool recover(const recoveryJournal &journal, nl_rootdata * data, QString &error);
+
+    /*!
+     * Remove the journal, if any, held for projectFile; called once the
+     * project is saved, or its changes have been recovered or turned down.
+     */
+    void discard(const QString &projectFile);
+
+    /*!
+     * Remove the journals of every open project, on closing cleanly.
+     */
+    void discardAll();
+
+public slots:
+    /*!
+     * Start writing a journal of the current project if it is due and the
+     * project has changed since the last one.
+     */
+    void check();
+
+private:
+    static QString recoveryDirFor(const QString &projectFile);
+
+    nl_rootdata * data;
+    QTimer timer;
+    // one writer at a time
+    QThreadPool writers;
+    QDateTime lastStarted;
+    // the undo stack and its index when its project was last journalled
+    QMap <QString, QPair <const void *, int> > journalled;
+};
+
+#endif // SC_AUTOSAVE_H
@@ -0,0 +1,470 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_batchexperimentrunner.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "SC_settings.h"
+#include "SC_modelvalidator.h"
+#include "EL_experiment.h"
+#include "CL_classes.h"
+#include "SC_executionbackend.h"
+#include <QThread>
+
+batchExperimentRunner::batchExperimentRunner(nl_rootdata * data, QObject *parent) :
+    QObject(parent)
+{
+    this->data = data;
+    this->expt = NULL;
+    this->exptNum = -1;
+    this->nextRun = 0;
+    this->runningRuns = 0;
+    this->finishedRuns = 0;
+    this->maxRuns = 1;
+    this->cancelled = false;
+    this->rebuild = false;
+}
+
+batchExperimentRunner::~batchExperimentRunner()
+{
+    for (int i = 0; i < this->runs.size(); ++i) {
+        QProcess * process = this->runs[i].process;
+        if (process) {
+            process->disconnect(this);
+            process->kill();
+            process->waitForFinished(1000);
+        }
+    }
+}
+
+int batchExperimentRunner::maxConcurrentRuns()
+{
+    QSettings settings;
+    int n = settings.value("batch/maxConcurrentRuns", 0).toInt();
+    if (n < 1) {
+        n = QThread::idealThreadCount();
+    }
+    return qMax(n, 1);
+}
+
+bool batchExperimentRunner::isRunning() const
+{
+    return this->runningRuns > 0 || (!this->cancelled && this->nextRun < this->runs.size());
+}
+
+bool batchExperimentRunner::start(experiment * expt, const QVector <exptSweep> &sweeps, QString &error)
+{
+    if (this->isRunning()) {
+        error = "A batch is already running.";
+        return false;
+    }
+
+    this->expt = expt;
+    this->exptNum = this->data->experiments.indexOf(expt);
+    if (this->exptNum == -1) {
+        error = "The experiment is not part of the current project.";
+        return false;
+    }
+
+    // the sweeps are written out by exptChangeProp::writeXML, which only
+    // writes changes that are set, and they must be a single value
+    for (int i = 0; i < sweeps.size(); ++i) {
+        exptChangeProp * change = sweeps[i].change;
+        if (change == NULL || change->par == NULL || !change->set || change->edit) {
+            error = "Swept properties must be set in the experiment.";
+            return false;
+        }
+        if (change->par->currType != FixedValue || change->par->value.isEmpty()) {
+            error = "Swept property '" + change->name + "' is not a fixed value.";
+            return false;
+        }
+        if (sweeps[i].values.isEmpty()) {
+            error = "Swept property '" + change->name + "' has no values.";
+            return false;
+        }
+    }
+    this->sweeps = sweeps;
+
+    QStringList problems = modelValidator::validate(this->data, expt);
+    if (!problems.isEmpty()) {
+        error = "The model has errors:\n" + problems.join("\n");
+        return false;
+    }
+
+    // the simulator, set up as for viewELExptPanelHandler::run()
+    QString simName = expt->setup.simType;
+    QSettings settings;
+    settings.beginGroup("simulators/" + simName);
+    QString path = settings.value("path").toString();
+    this->workingDir = QDir(QDir::toNativeSeparators(settings.value("working_dir").toString())).absolutePath();
+    bool rebuild = settings.value("envVar/REBUILD").toString() == "true";
+    settings.endGroup();
+
+#ifdef Q_OS_WIN
+    if (simName == "BRAHMS") {
+        // BRAHMS is run synchronously through bash on Windows
+        error = "Batches of BRAHMS runs are not supported on Windows.";
+        return false;
+    }
+#endif
+    this->simName = simName;
+    this->rebuild = rebuild;
+    // a remote convert_script is on the host it runs on
+    executionBackend backend(simName);
+    QFileInfo simInfo(path);
+    if (backend.isLocal() && (!simInfo.exists() || !simInfo.isExecutable())) {
+        error = "The simulator '" + path + "' does not exist or is not executable.";
+        return false;
+    }
+
+    this->simulatorArgs.clear();
+    if (path.contains("python")) {
+        QStringList pathbits = path.split("python ");
+        if (pathbits.size() > 1) {
+            path = pathbits[0] + QString("python");
+            this->simulatorArgs << QDir::toNativeSeparators(pathbits[1]);
+        }
+    }
+    this->simulatorPath = path;
+    if (rebuild) {
+        this->simulatorArgs << "-r";
+    }
+
+    this->env = QProcessEnvironment::systemEnvironment();
+    settings.beginGroup("simulators/" + simName + "/envVar");
+    QStringList keys = settings.childKeys();
+    for (int i = 0; i < keys.size(); ++i) {
+        this->env.insert(keys[i], settings.value(keys[i]).toString());
+    }
+    settings.endGroup();
+    this->env.insert("PATH", this->env.value("PATH", "") + ":" + this->workingDir);
+
+    // export the shared model once; its files may change from the last batch
+    this->resultCache = runResultCache();
+    this->batchDir = this->workingDir + QDir::separator() + "temp" + QDir::separator()
+            + this->data->currProject->getFilenameFriendlyName() + "_e" + QString::number(this->exptNum) + "_batch";
+    QString baseDir = this->batchDir + QDir::separator() + "model";
+    if (!this->exportBaseModel(baseDir, error)) {
+        return false;
+    }
+
+    // expand the sweeps into runs, the last sweep varying fastest
+    int numRuns = 1;
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        numRuns *= this->sweeps[i].values.size();
+    }
+    this->runs.clear();
+    this->runs.resize(numRuns);
+    for (int r = 0; r < numRuns; ++r) {
+        batchRun &run = this->runs[r];
+        run.values.resize(this->sweeps.size());
+        int rem = r;
+        for (int i = this->sweeps.size() - 1; i >= 0; --i) {
+            int n = this->sweeps[i].values.size();
+            run.values[i] = this->sweeps[i].values[rem % n];
+            rem /= n;
+        }
+        QString runDir = this->batchDir + QDir::separator() + "run" + QString::number(r);
+        run.modelDir = runDir + QDir::separator() + "model";
+        run.outDir = runDir + QDir::separator() + "out";
+        run.process = NULL;
+        run.backend = NULL;
+        run.started = false;
+        run.ok = false;
+        if (!this->setUpRun(run, baseDir, error)) {
+            this->runs.clear();
+            return false;
+        }
+    }
+
+    this->nextRun = 0;
+    this->runningRuns = 0;
+    this->finishedRuns = 0;
+    this->cancelled = false;
+    this->maxRuns = maxConcurrentRuns();
+    this->writeSummary();
+    this->launchRuns();
+    return true;
+}
+
+bool batchExperimentRunner::exportBaseModel(const QString &baseDir, QString &error)
+{
+    if (!QDir().mkpath(baseDir)) {
+        error = "Could not create the batch directory '" + baseDir + "'.";
+        return false;
+    }
+
+    QString previousFilePath = this->data->currProject->filePath;
+    QString previousFileName = settingsCache::currentFileName();
+    QString projFilePath = baseDir + QDir::separator() + "temp.proj";
+
+    exportCache::begin(baseDir);
+    settingsCache::setCurrentFileName(projFilePath);
+    bool saved = this->data->currProject->save_project(projFilePath, this->data);
+    exportCache::end();
+
+    // save_project changes the project's file path
+    this->data->currProject->filePath = previousFilePath;
+    if (!previousFileName.isEmpty()) {
+        settingsCache::setCurrentFileName(previousFileName);
+    }
+
+    if (!saved) {
+        error = "The model could not be saved into the batch directory.";
+        return false;
+    }
+    return true;
+}
+
+bool batchExperimentRunner::setUpRun(batchRun &run, const QString &baseDir, QString &error)
+{
+    QDir modelDir(run.modelDir);
+    if (!QDir().mkpath(run.modelDir)) {
+        error = "Could not create the run directory '" + run.modelDir + "'.";
+        return false;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    // logs from an earlier batch
+    QDir(run.outDir).removeRecursively();
+#endif
+
+    // share everything but the experiment file with the base model
+    QString exptFileName = "experiment" + QString::number(this->exptNum) + ".xml";
+    QStringList files = modelDir.entryList(QDir::Files | QDir::System);
+    for (int i = 0; i < files.size(); ++i) {
+        modelDir.remove(files[i]);
+    }
+    QDir base(baseDir);
+    files = base.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); ++i) {
+        if (files[i] == exptFileName) {
+            continue;
+        }
+#ifdef Q_OS_WIN
+        // QFile::link makes shortcuts on Windows, which simulators can't read
+        bool shared = QFile::copy(base.absoluteFilePath(files[i]), modelDir.absoluteFilePath(files[i]));
+#else
+        bool shared = QFile::link(base.absoluteFilePath(files[i]), modelDir.absoluteFilePath(files[i]));
+#endif
+        if (!shared) {
+            error = "Could not share '" + files[i] + "' with the run directory '" + run.modelDir + "'.";
+            return false;
+        }
+    }
+
+    // write the experiment with this run's values
+    QVector <double> oldValues(this->sweeps.size());
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        oldValues[i] = this->sweeps[i].change->par->value[0];
+        this->sweeps[i].change->par->value[0] = run.values[i];
+    }
+
+    QFile exptFile(modelDir.absoluteFilePath(exptFileName));
+    bool written = exptFile.open(QIODevice::WriteOnly);
+    if (written) {
+        QXmlStreamWriter xmlOut(&exptFile);
+        this->expt->writeXML(&xmlOut, this->data->currProject);
+        exptFile.close();
+    }
+
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        this->sweeps[i].change->par->value[0] = oldValues[i];
+    }
+
+    if (!written) {
+        error = "Could not write the experiment file for '" + run.modelDir + "'.";
+        return false;
+    }
+    return true;
+}
+
+void batchExperimentRunner::launchRuns()
+{
+    while (!this->cancelled && this->runningRuns < this->maxRuns && this->nextRun < this->runs.size()) {
+        int r = this->nextRun++;
+        batchRun &run = this->runs[r];
+        QDir().mkpath(run.outDir);
+
+        // an identical earlier run's logs are as good as running it again
+        run.cacheKey.clear();
+        if (runResultCache::isEnabled()) {
+            run.cacheKey = this->resultCache.keyFor(run.modelDir, this->exptNum, this->expt->setup.simType);
+        }
+        QString output;
+        if (runResultCache::restore(run.cacheKey, run.outDir + QDir::separator() + "log", output)) {
+            QFile stdoutFile(run.outDir + QDir::separator() + "stdout.txt");
+            if (stdoutFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                stdoutFile.write(output.toUtf8());
+            }
+            run.started = true;
+            run.ok = true;
+            ++this->finishedRuns;
+            emit runFinished(r, true);
+            emit progress(this->finishedRuns, this->runs.size());
+            continue;
+        }
+
+        QProcess * simulator = new QProcess(this);
+        simulator->setWorkingDirectory(this->workingDir);
+        simulator->setProcessEnvironment(this->env);
+        simulator->setStandardOutputFile(run.outDir + QDir::separator() + "stdout.txt");
+        simulator->setStandardErrorFile(run.outDir + QDir::separator() + "stderr.txt");
+        simulator->setProperty("run", r);
+        connect(simulator, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(processFinished(int,QProcess::ExitStatus)));
+
+        QString program = this->simulatorPath;
+        QStringList al = this->simulatorArgs;
+        al << "-m" << run.modelDir
+           << "-w" << this->workingDir
+           << "-o" << run.outDir
+           << "-e" << QString::number(this->exptNum);
+
+        // elsewhere, a local shell sends the model, runs it there and fetches the logs
+        bool launched = true;
+        executionBackend * backend = new executionBackend(this->simName, simulator);
+        if (!backend->isLocal()) {
+            QString error;
+            QString runName = QFileInfo(this->batchDir).fileName() + "/run" + QString::number(r);
+            if (!backend->prepare(run.modelDir, run.outDir, this->exptNum, this->rebuild, runName, program, al, error)) {
+                DBG() << "Batch run " << r << ": " << error;
+                launched = false;
+            }
+        }
+
+        run.started = true;
+        if (launched) {
+            run.process = simulator;
+            run.backend = backend;
+            ++this->runningRuns;
+            DBG() << "Batch run " << r << " on " << backend->describe() << ": " << program << " " << al;
+            simulator->start(program, al);
+            launched = simulator->waitForStarted(10000);
+            if (!launched) {
+                // finished() is not emitted for a process that never started
+                run.process = NULL;
+                run.backend = NULL;
+                --this->runningRuns;
+            }
+        }
+        if (!launched) {
+            simulator->deleteLater();
+            ++this->finishedRuns;
+            emit runFinished(r, false);
+            emit progress(this->finishedRuns, this->runs.size());
+        }
+    }
+
+    if (this->runningRuns == 0 && (this->cancelled || this->nextRun >= this->runs.size())) {
+        this->writeSummary();
+        emit finished();
+    }
+}
+
+void batchExperimentRunner::processFinished(int exitCode, QProcess::ExitStatus status)
+{
+    QProcess * simulator = qobject_cast<QProcess *> (sender());
+    if (!simulator) {
+        return;
+    }
+    int r = simulator->property("run").toInt();
+    batchRun &run = this->runs[r];
+    run.ok = (status == QProcess::NormalExit && exitCode == 0);
+    run.process = NULL;
+    if (run.backend) {
+        run.backend->runFinished();
+        run.backend = NULL;
+    }
+    simulator->deleteLater();
+
+    // keep the logs for the next identical run, unless it was cut short
+    if (run.ok && !this->cancelled) {
+        QFile stdoutFile(run.outDir + QDir::separator() + "stdout.txt");
+        QString output;
+        if (stdoutFile.open(QIODevice::ReadOnly)) {
+            output = QString::fromUtf8(stdoutFile.readAll());
+        }
+        runResultCache::store(run.cacheKey, run.outDir + QDir::separator() + "log", output);
+    }
+
+    --this->runningRuns;
+    ++this->finishedRuns;
+    emit runFinished(r, run.ok);
+    emit progress(this->finishedRuns, this->runs.size());
+
+    this->launchRuns();
+}
+
+void batchExperimentRunner::cancel()
+{
+    if (!this->isRunning()) {
+        return;
+    }
+    this->cancelled = true;
+    // the same stop file as viewELExptPanelHandler::cancelRun()
+    for (int i = 0; i < this->runs.size(); ++i) {
+        if (this->runs[i].process) {
+            QFile stopFile(this->runs[i].outDir + QDir::separator() + "model" + QDir::separator() + "stop.txt");
+            stopFile.open(QFile::WriteOnly);
+            stopFile.close();
+            if (this->runs[i].backend) {
+                this->runs[i].backend->cancel();
+            }
+        }
+    }
+    if (this->runningRuns == 0) {
+        this->writeSummary();
+        emit finished();
+    }
+}
+
+void batchExperimentRunner::writeSummary()
+{
+    QFile summary(this->batchDir + QDir::separator() + "runs.txt");
+    if (!summary.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        DBG() << "Could not write the batch summary " << summary.fileName();
+        return;
+    }
+    QTextStream out(&summary);
+    out << "run";
+    for (int i = 0; i < this->sweeps.size(); ++i) {
+        out << "\t" << this->sweeps[i].change->name;
+    }
+    out << "\tstatus\tlogs\n";
+    for (int r = 0; r < this->runs.size(); ++r) {
+        const batchRun &run = this->runs[r];
+        out << r;
+        for (int i = 0; i < run.values.size(); ++i) {
+            out << "\t" << run.values[i];
+        }
+        QString status;
+        if (!run.started) {
+            status = "not run";
+        } else if (run.process) {
+            status = "running";
+        } else {
+            status = run.ok ? "ok" : "failed";
+        }
+        out << "\t" << status << "\t" << run.outDir + QDir::separator() + "log" << "\n";
+    }
+}
@@ -0,0 +1,138 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef BATCHEXPERIMENTRUNNER_H
+#define BATCHEXPERIMENTRUNNER_H
+
+#include "globalHeader.h"
+#include "SC_runcache.h"
+#include <QProcess>
+
+class exptChangeProp;
+class executionBackend;
+
+/*!
+ * One swept property of a batch: each value is set in turn on the
+ * property's FixedValue.
+ */
+struct exptSweep {
+    exptChangeProp * change;
+    QVector <double> values;
+};
+
+/*!
+ * \brief The batchExperimentRunner class runs an experiment once for every
+ * combination of the values of a set of exptSweeps, with up to
+ * maxConcurrentRuns() simulator processes at a time.
+ *
+ * The model is exported once, through the exportCache, into a base directory
+ * in the simulator's working directory (temp/<project>_e<N>_batch/model).
+ * The swept properties only change the experiment file, so each run gets a
+ * directory whose model links to the base files, its own experiment file and
+ * its own output folder (run<i>/out, with the logs in run<i>/out/log).
+ * runs.txt in the batch directory lists the values used by each run.
+ * A run identical to an earlier one has its logs restored from the
+ * runResultCache rather than being simulated again. The runs go to the
+ * simulator's executionBackend, which may be another machine.
+ */
+class batchExperimentRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit batchExperimentRunner(nl_rootdata * data, QObject *parent = 0);
+    ~batchExperimentRunner();
+
+    /*!
+     * Export the model and start the runs. Returns false, with a reason
+     * in error, if the batch could not be set up.
+     */
+    bool start(experiment * expt, const QVector <exptSweep> &sweeps, QString &error);
+    /*!
+     * Ask the running simulators to stop, and don't start any more.
+     */
+    void cancel();
+    bool isRunning() const;
+
+    int numRuns() const {return runs.size();}
+    int numFinished() const {return finishedRuns;}
+    QString getBatchDir() const {return batchDir;}
+    QString getLogDir(int run) const {return runs[run].outDir + QDir::separator() + "log";}
+
+    /*!
+     * The worker limit, from the batch/maxConcurrentRuns setting; the
+     * number of cores if that is not set.
+     */
+    static int maxConcurrentRuns();
+
+signals:
+    void runFinished(int run, bool ok);
+    void progress(int finished, int total);
+    void finished();
+
+private slots:
+    void processFinished(int, QProcess::ExitStatus);
+
+private:
+    struct batchRun {
+        QVector <double> values;
+        QString modelDir;
+        QString outDir;
+        QProcess * process;
+        bool started;
+        bool ok;
+        // its runResultCache key, if it can be cached
+        QByteArray cacheKey;
+        // while running, where it runs; owned by process
+        executionBackend * backend;
+    };
+
+    bool exportBaseModel(const QString &baseDir, QString &error);
+    bool setUpRun(batchRun &run, const QString &baseDir, QString &error);
+    void launchRuns();
+    void writeSummary();
+
+    nl_rootdata * data;
+    experiment * expt;
+    int exptNum;
+    QVector <exptSweep> sweeps;
+    QVector <batchRun> runs;
+    int nextRun;
+    int runningRuns;
+    int finishedRuns;
+    int maxRuns;
+    bool cancelled;
+
+    // the hashes of the model files shared by the runs of this batch
+    runResultCache resultCache;
+
+    QString batchDir;
+    QString simName;
+    bool rebuild;
+    QString simulatorPath;
+    QStringList simulatorArgs;
+    QString workingDir;
+    QProcessEnvironment env;
+};
+
+#endif // BATCHEXPERIMENTRUNNER_H
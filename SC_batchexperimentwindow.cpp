@@ -0,0 +1,214 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_batchexperimentwindow.h"
+#include "ui_batchexperimentwindow.h"
+#include "EL_experiment.h"
+#include "CL_classes.h"
+#include <QSettings>
+#include <QHeaderView>
+
+BatchExperimentWindow::BatchExperimentWindow(nl_rootdata * data, experiment * expt, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::BatchExperimentWindow)
+{
+    ui->setupUi(this);
+
+    this->data = data;
+    this->expt = expt;
+    this->runner = new batchExperimentRunner(data, this);
+    this->failedRuns = 0;
+    this->closing = false;
+
+    this->setWindowTitle("Batch launch: " + expt->name);
+    ui->caption->setText("Give the values to run each property change with, separated by commas or as start:step:end. "
+                         "Every combination is run; a change with no values keeps its own.");
+
+    // list the changes which can be swept, with their current value
+    ui->sweepTable->setColumnCount(2);
+    ui->sweepTable->setHorizontalHeaderLabels(QStringList() << "Property change" << "Values");
+    ui->sweepTable->horizontalHeader()->setStretchLastSection(true);
+    ui->sweepTable->verticalHeader()->hide();
+    for (int i = 0; i < expt->changes.size(); ++i) {
+        exptChangeProp * change = expt->changes[i];
+        if (change->par == NULL || !change->set || change->edit
+            || change->par->currType != FixedValue || change->par->value.isEmpty()) {
+            continue;
+        }
+        int row = ui->sweepTable->rowCount();
+        ui->sweepTable->insertRow(row);
+        QTableWidgetItem * name = new QTableWidgetItem(change->name + " (" + change->par->name + ")");
+        name->setFlags(name->flags() & ~Qt::ItemIsEditable);
+        ui->sweepTable->setItem(row, 0, name);
+        ui->sweepTable->setItem(row, 1, new QTableWidgetItem(QString::number(change->par->value[0])));
+        this->changes.push_back(change);
+    }
+    ui->sweepTable->resizeColumnToContents(0);
+    if (this->changes.isEmpty()) {
+        ui->status->setText("The experiment has no property changes to sweep; Run All runs it once.");
+    }
+
+    ui->maxRuns->setValue(batchExperimentRunner::maxConcurrentRuns());
+    ui->progressBar->setValue(0);
+
+    connect(ui->run_but, SIGNAL(clicked()), this, SLOT(runOrCancel()));
+    connect(ui->close_but, SIGNAL(clicked()), this, SLOT(reject()));
+    connect(this->runner, SIGNAL(runFinished(int,bool)), this, SLOT(runFinished(int,bool)));
+    connect(this->runner, SIGNAL(progress(int,int)), this, SLOT(showProgress(int,int)));
+    connect(this->runner, SIGNAL(finished()), this, SLOT(batchFinished()));
+}
+
+BatchExperimentWindow::~BatchExperimentWindow()
+{
+    delete ui;
+}
+
+bool BatchExperimentWindow::parseSweepValues(const QString &text, QVector <double> &values)
+{
+    values.clear();
+    QString trimmed = text.trimmed();
+    if (trimmed.isEmpty()) {
+        return true;
+    }
+
+    QStringList range = trimmed.split(":");
+    if (range.size() == 3) {
+        bool ok0, ok1, ok2;
+        double start = range[0].trimmed().toDouble(&ok0);
+        double step = range[1].trimmed().toDouble(&ok1);
+        double end = range[2].trimmed().toDouble(&ok2);
+        if (!ok0 || !ok1 || !ok2 || step == 0.0 || (end - start) / step < 0.0) {
+            return false;
+        }
+        // allow for rounding in the last step
+        int n = (int) floor((end - start) / step + 1e-9) + 1;
+        for (int i = 0; i < n; ++i) {
+            values.push_back(start + i*step);
+        }
+        return true;
+    } else if (range.size() != 1) {
+        return false;
+    }
+
+    QStringList list = trimmed.split(QRegExp("[,\\s]+"), QString::SkipEmptyParts);
+    for (int i = 0; i < list.size(); ++i) {
+        bool ok;
+        values.push_back(list[i].toDouble(&ok));
+        if (!ok) {
+            values.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void BatchExperimentWindow::runOrCancel()
+{
+    if (this->runner->isRunning()) {
+        ui->status->setText("Cancelling...");
+        ui->run_but->setEnabled(false);
+        this->runner->cancel();
+        return;
+    }
+
+    QVector <exptSweep> sweeps;
+    for (int i = 0; i < this->changes.size(); ++i) {
+        exptSweep sweep;
+        sweep.change = this->changes[i];
+        QTableWidgetItem * item = ui->sweepTable->item(i, 1);
+        if (!parseSweepValues(item ? item->text() : QString(), sweep.values)) {
+            ui->status->setText("The values for '" + this->changes[i]->name + "' are not understood.");
+            return;
+        }
+        if (!sweep.values.isEmpty()) {
+            sweeps.push_back(sweep);
+        }
+    }
+
+    // the runner reads the worker limit from the settings
+    QSettings settings;
+    settings.setValue("batch/maxConcurrentRuns", ui->maxRuns->value());
+
+    this->failedRuns = 0;
+    QString error;
+    if (!this->runner->start(this->expt, sweeps, error)) {
+        ui->status->setText(error);
+        return;
+    }
+
+    ui->sweepTable->setEnabled(false);
+    ui->maxRuns->setEnabled(false);
+    ui->progressBar->setRange(0, this->runner->numRuns());
+    ui->progressBar->setValue(this->runner->numFinished());
+    ui->status->setText("Running in " + this->runner->getBatchDir());
+    ui->run_but->setText("Cancel");
+
+    // the runner may have failed to start the simulator already
+    if (!this->runner->isRunning()) {
+        this->batchFinished();
+    }
+}
+
+void BatchExperimentWindow::runFinished(int, bool ok)
+{
+    if (!ok) {
+        ++this->failedRuns;
+    }
+}
+
+void BatchExperimentWindow::showProgress(int finished, int total)
+{
+    ui->progressBar->setRange(0, total);
+    ui->progressBar->setValue(finished);
+}
+
+void BatchExperimentWindow::batchFinished()
+{
+    if (this->closing) {
+        QDialog::reject();
+        return;
+    }
+
+    ui->sweepTable->setEnabled(true);
+    ui->maxRuns->setEnabled(true);
+    ui->run_but->setEnabled(true);
+    ui->run_but->setText("Run All");
+
+    QString text = QString::number(this->runner->numFinished()) + " of " + QString::number(this->runner->numRuns()) + " runs done";
+    if (this->failedRuns > 0) {
+        text += ", " + QString::number(this->failedRuns) + " failed";
+    }
+    ui->status->setText(text + "; the results are in " + this->runner->getBatchDir());
+}
+
+void BatchExperimentWindow::reject()
+{
+    if (this->runner->isRunning()) {
+        this->closing = true;
+        this->runOrCancel();
+        return;
+    }
+    QDialog::reject();
+}
@@ -0,0 +1,80 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef BATCHEXPERIMENTWINDOW_H
+#define BATCHEXPERIMENTWINDOW_H
+
+#include <QDialog>
+#include "globalHeader.h"
+#include "SC_batchexperimentrunner.h"
+
+namespace Ui {
+class BatchExperimentWindow;
+}
+
+/*!
+ * \brief The BatchExperimentWindow class launches a batch of runs of an
+ * experiment. Each property change set in the experiment is listed with the
+ * values to sweep it through, and the batchExperimentRunner runs every
+ * combination of them, several at a time.
+ */
+class BatchExperimentWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit BatchExperimentWindow(nl_rootdata * data, experiment * expt, QWidget *parent = 0);
+    ~BatchExperimentWindow();
+
+    /*!
+     * Read the values of a sweep from text, separated by commas or spaces,
+     * or as a range start:step:end. Returns false if text is not understood.
+     */
+    static bool parseSweepValues(const QString &text, QVector <double> &values);
+
+public slots:
+    /*!
+     * Close stops a running batch first; the window closes once it has.
+     */
+    void reject();
+
+private slots:
+    void runOrCancel();
+    void runFinished(int run, bool ok);
+    void showProgress(int finished, int total);
+    void batchFinished();
+
+private:
+    Ui::BatchExperimentWindow *ui;
+    nl_rootdata * data;
+    experiment * expt;
+    // the changes listed, in the order of the rows
+    QVector <exptChangeProp *> changes;
+    batchExperimentRunner * runner;
+    int failedRuns;
+    bool closing;
+};
+
+#endif // BATCHEXPERIMENTWINDOW_H
@@ -0,0 +1,268 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_clipboard.h"
+#include "CL_classes.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QMimeData>
+#include <QDataStream>
+
+QString propertyClipboard::bufferFile;
+QString propertyClipboard::owner;
+
+namespace {
+    // the payload describes each list; the values are in the buffer file
+    struct clipboardEntry {
+        QString name;
+        qint32 isStateVariable;
+        qint32 currType;
+        qint32 seed;
+        qint64 valueOffset;
+        qint32 valueCount;
+        qint64 indexOffset;
+        qint32 indexCount;
+    };
+
+    QDataStream& operator<<(QDataStream& s, const clipboardEntry& e)
+    {
+        return s << e.name << e.isStateVariable << e.currType << e.seed
+                 << e.valueOffset << e.valueCount << e.indexOffset << e.indexCount;
+    }
+
+    QDataStream& operator>>(QDataStream& s, clipboardEntry& e)
+    {
+        return s >> e.name >> e.isStateVariable >> e.currType >> e.seed
+                 >> e.valueOffset >> e.valueCount >> e.indexOffset >> e.indexCount;
+    }
+
+    bool writeList(QFile& f, ParameterInstance* par, bool isStateVariable, clipboardEntry& e)
+    {
+        e.name = par->name;
+        e.isStateVariable = isStateVariable ? 1 : 0;
+        e.currType = par->currType;
+        e.seed = par->seed;
+        e.valueOffset = f.pos();
+        e.valueCount = par->value.size();
+        qint64 bytes = (qint64)e.valueCount * sizeof(double);
+        if (bytes > 0 && f.write((const char*)par->value.constData(), bytes) != bytes) {
+            return false;
+        }
+        e.indexOffset = f.pos();
+        e.indexCount = par->indices.size();
+        bytes = (qint64)e.indexCount * sizeof(int);
+        if (bytes > 0 && f.write((const char*)par->indices.constData(), bytes) != bytes) {
+            return false;
+        }
+        return true;
+    }
+
+    bool inBuffer(qint64 offset, qint64 count, qint64 elementSize, qint64 size)
+    {
+        return offset >= 0 && count >= 0 && offset + count * elementSize <= size;
+    }
+
+    void removeClipboardBuffers()
+    {
+        propertyClipboard::removeBuffers();
+    }
+
+    int copySerial = 0;
+}
+
+void propertyClipboard::removeBuffers()
+{
+    if (!bufferFile.isEmpty()) {
+        QFile::remove(bufferFile);
+        bufferFile.clear();
+    }
+}
+
+void propertyClipboard::copy(QSharedPointer<ComponentInstance> data)
+{
+    if (data.isNull()) {
+        return;
+    }
+    if (owner.isEmpty()) {
+        qAddPostRoutine(removeClipboardBuffers);
+    }
+    removeBuffers();
+
+    qint64 pid = QCoreApplication::applicationPid();
+    owner = QString::number(pid) + ":" + QString::number(++copySerial);
+    bufferFile = QDir::temp().absoluteFilePath(QString("spinecreator-clipboard-%1-%2.bin").arg(pid).arg(copySerial));
+
+    QFile f(bufferFile);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        DBG() << "Could not create the clipboard file" << bufferFile;
+        bufferFile.clear();
+        return;
+    }
+    QVector<clipboardEntry> entries;
+    bool ok = true;
+    for (int i = 0; ok && i < data->ParameterList.size(); ++i) {
+        clipboardEntry e;
+        ok = writeList(f, data->ParameterList[i], false, e);
+        entries.push_back(e);
+    }
+    for (int i = 0; ok && i < data->StateVariableList.size(); ++i) {
+        clipboardEntry e;
+        ok = writeList(f, data->StateVariableList[i], true, e);
+        entries.push_back(e);
+    }
+    ok = f.flush() && ok;
+    f.close();
+    if (!ok) {
+        DBG() << "Could not write the clipboard file" << bufferFile;
+        removeBuffers();
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream s(&payload, QIODevice::WriteOnly);
+    s.setVersion(QDataStream::Qt_4_6);
+    s << (quint32)CLIPBOARD_MAGIC << (quint32)CLIPBOARD_VERSION << owner
+      << data->component->name << bufferFile << (qint32)entries.size();
+    for (int i = 0; i < entries.size(); ++i) {
+        s << entries[i];
+    }
+
+    QMimeData* mime = new QMimeData;
+    mime->setData(CLIPBOARD_PROPERTIES_MIME, payload);
+    QApplication::clipboard()->setMimeData(mime);
+}
+
+bool propertyClipboard::hasForeignData()
+{
+    const QMimeData* mime = QApplication::clipboard()->mimeData();
+    if (mime == (const QMimeData*)0 || !mime->hasFormat(CLIPBOARD_PROPERTIES_MIME)) {
+        return false;
+    }
+    QByteArray payload = mime->data(CLIPBOARD_PROPERTIES_MIME);
+    QDataStream s(payload);
+    s.setVersion(QDataStream::Qt_4_6);
+    quint32 magic, version;
+    QString from;
+    s >> magic >> version >> from;
+    return s.status() == QDataStream::Ok && magic == CLIPBOARD_MAGIC && from != owner;
+}
+
+QSharedPointer<ComponentInstance> propertyClipboard::paste(QSharedPointer<ComponentInstance> dest)
+{
+    QSharedPointer<ComponentInstance> result;
+    const QMimeData* mime = QApplication::clipboard()->mimeData();
+    if (dest.isNull() || mime == (const QMimeData*)0 || !mime->hasFormat(CLIPBOARD_PROPERTIES_MIME)) {
+        return result;
+    }
+
+    QByteArray payload = mime->data(CLIPBOARD_PROPERTIES_MIME);
+    QDataStream s(payload);
+    s.setVersion(QDataStream::Qt_4_6);
+    quint32 magic, version;
+    QString from, componentName, fileName;
+    qint32 count;
+    s >> magic >> version;
+    if (s.status() != QDataStream::Ok || magic != CLIPBOARD_MAGIC || version != CLIPBOARD_VERSION) {
+        DBG() << "The clipboard holds Properties in an unknown format";
+        return result;
+    }
+    s >> from >> componentName >> fileName >> count;
+    QVector<clipboardEntry> entries;
+    for (int i = 0; s.status() == QDataStream::Ok && i < count; ++i) {
+        clipboardEntry e;
+        s >> e;
+        entries.push_back(e);
+    }
+    if (s.status() != QDataStream::Ok) {
+        DBG() << "The Properties on the clipboard are incomplete";
+        return result;
+    }
+
+    // the buffers are only mapped, and copied straight into the lists
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        DBG() << "The Properties on the clipboard are no longer available";
+        return result;
+    }
+    qint64 size = f.size();
+    const uchar* buffer = (const uchar*)0;
+    if (size > 0) {
+        buffer = f.map(0, size);
+        if (buffer == (const uchar*)0) {
+            DBG() << "Could not map the clipboard file" << fileName;
+            return result;
+        }
+    }
+
+    if (componentName != dest->component->name) {
+        DBG() << "Pasting the Properties of" << componentName << "into" << dest->component->name;
+    }
+
+    result = QSharedPointer<ComponentInstance> (new ComponentInstance(dest));
+    for (int i = 0; i < entries.size(); ++i) {
+        const clipboardEntry& e = entries[i];
+        if (e.currType < FixedValue || e.currType > Undefined
+            || !inBuffer(e.valueOffset, e.valueCount, sizeof(double), size)
+            || !inBuffer(e.indexOffset, e.indexCount, sizeof(int), size)) {
+            DBG() << "Skipping the damaged clipboard entry" << e.name;
+            continue;
+        }
+        ParameterInstance* par = (ParameterInstance*)0;
+        if (e.isStateVariable) {
+            for (int j = 0; j < result->StateVariableList.size(); ++j) {
+                if (result->StateVariableList[j]->name == e.name) {
+                    par = result->StateVariableList[j];
+                }
+            }
+        } else {
+            for (int j = 0; j < result->ParameterList.size(); ++j) {
+                if (result->ParameterList[j]->name == e.name) {
+                    par = result->ParameterList[j];
+                }
+            }
+        }
+        if (par == (ParameterInstance*)0) {
+            continue;
+        }
+        par->currType = (ParameterType)e.currType;
+        par->seed = e.seed;
+        par->value.resize(e.valueCount);
+        if (e.valueCount > 0) {
+            memcpy(par->value.data(), buffer + e.valueOffset, (size_t)e.valueCount * sizeof(double));
+        }
+        par->indices.resize(e.indexCount);
+        if (e.indexCount > 0) {
+            memcpy(par->indices.data(), buffer + e.indexOffset, (size_t)e.indexCount * sizeof(int));
+        }
+        // any binary file named belongs to the other project
+        par->filename.clear();
+    }
+
+    if (buffer != (const uchar*)0) {
+        f.unmap((uchar*)buffer);
+    }
+    f.close();
+    return result;
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_CLIPBOARD_H
+#define SC_CLIPBOARD_H
+
+#include "globalHeader.h"
+
+class ComponentInstance;
+
+/*!
+ * The MIME type of the binary property clipboard. The version in the
+ * payload, not the type, changes with the format.
+ */
+#define CLIPBOARD_PROPERTIES_MIME "application/x-spinecreator-properties"
+#define CLIPBOARD_MAGIC 0x53434342 // "SCCB"
+#define CLIPBOARD_VERSION 1
+
+/*!
+ * \brief The propertyClipboard class puts copied Properties on the system
+ * clipboard, so that they can be pasted into another SpineCreator.
+ *
+ * The clipboard holds a short, versioned QDataStream payload: the name of
+ * the component, and for each Property and State Variable its type, seed
+ * and where its values and indices are. The values and indices themselves
+ * are written, as raw doubles and ints, to a temporary file named in the
+ * payload, which the pasting process maps rather than reads, so large
+ * explicit lists never pass through the clipboard or through text. The
+ * file is replaced by the next copy and removed when this process exits.
+ */
+class propertyClipboard
+{
+public:
+    /*!
+     * Put the Properties of data on the system clipboard.
+     */
+    static void copy(QSharedPointer<ComponentInstance> data);
+    /*!
+     * True if the system clipboard holds Properties copied by another
+     * process, which paste() should be used for. Otherwise the in process
+     * copy, if there is one, is the one to paste.
+     */
+    static bool hasForeignData();
+    /*!
+     * Properties from the system clipboard, as a copy of dest with the
+     * Properties of the same name replaced. Null if there are none, or they
+     * could not be read.
+     */
+    static QSharedPointer<ComponentInstance> paste(QSharedPointer<ComponentInstance> dest);
+    /*!
+     * Remove the file holding the values of the last copy. Called on exit.
+     */
+    static void removeBuffers();
+
+private:
+    static QString bufferFile;
+    static QString owner;
+};
+
+#endif // SC_CLIPBOARD_H
@@ -166,7 +166,7 @@ void NineMLNodeItem::updateAnnotationText(void)
     }
 }
 
-NineMLTransitionItem::NineMLTransitionItem(GVLayout *layout, Agnode_t *src, Agnode_t *dst, QGraphicsScene *scene)
+NineMLTransitionItem::NineMLTransitionItem(GVLayout *layout, GVNode *src, GVNode *dst, QGraphicsScene *scene)
     : TextItemGroup(), GVEdge(layout, src, dst)
 {
     arrow = new ArrowItem();
@@ -197,6 +197,11 @@ void NineMLTransitionItem::updateLayout()
 
     //update curve points and set arrow path
     QPainterPath path = QPainterPath();
+    if (GVEdge::getGVEdgeSplinesCount() == 0) {
+        // not laid out yet
+        arrow->setPath(path);
+        return;
+    }
     QPointF spline_start = GVEdge::getGVEdgeSplinesPoint(0);
     path.moveTo(spline_start.x(), spline_start.y());
     for(int i=1; i<GVEdge::getGVEdgeSplinesCount(); i+=3) {
@@ -280,8 +285,17 @@ NineMLTextItem::~NineMLTextItem()
 
 void NineMLTextItem::setPlainText(const QString &text)
 {
+    // the text is set again on each character typed; the graph only needs
+    // laying out again when that changes the size of the item's box
+    if (text == this->toPlainText()) {
+        return;
+    }
+    TextItemGroup * group = (TextItemGroup *) this->parentItem();
+    QSizeF oldSize = group ? group->boundingRect().size() : QSizeF();
     GroupedTextItem::setPlainText(text);
-    gv_item->updateGVData();
+    if (!group || group->boundingRect().size() != oldSize) {
+        gv_item->updateGVData();
+    }
 }
 
 QString NineMLTextItem::getAnnotationText(void)
@@ -338,12 +352,9 @@ void RegimeGraphicsItem::setRegimeName(QString n)
     regime->name = n;
 
     // rename the gv node which is a parent class of
-    // RegimeGraphicsItem.  Shouldn't be required - NineMLNodeItem
-    // already set name. Nonetheless, if compiling for libgraph, we'll
-    // call this, as the old implementation of the function works.
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
+    // RegimeGraphicsItem. The layout doesn't use the name, so this
+    // doesn't cause the graph to be laid out again.
     renameGVNode(n);
-#endif
 
     //update the dst regime name in any onconditions
     for (int i=0; i < root->al->RegimeList.size(); i++) {
@@ -455,7 +466,12 @@ void TimeDerivativeTextItem::setVariable(QString p)
 
 void TimeDerivativeTextItem::setMaths(QString m)
 {
-    QSharedPointer<Component> oldComponent = QSharedPointer<Component> (new Component(root->al));
+    // the characters typed into the box one after another are one change
+    bool newEdit = qobject_cast < QLineEdit *> (sender()) && root->isNewEdit(this, "Set TD maths");
+    QSharedPointer<Component> oldComponent;
+    if (newEdit) {
+        oldComponent = QSharedPointer<Component> (new Component(root->al));
+    }
     // if the sender is a QLineEdit
     QLineEdit * source = qobject_cast < QLineEdit *> (sender());
 
@@ -487,11 +503,9 @@ void TimeDerivativeTextItem::setMaths(QString m)
     }
 
     updateContent();
-    root->notifyDataChange();
-    if (qobject_cast < QLineEdit *> (sender())) {
-        root->alPtr->undoStack.push(new changeComponent(root, oldComponent, "Set TD maths"));
-    } else {
-        oldComponent.clear();
+    root->notifyMathsChange(time_derivative);
+    if (newEdit) {
+        root->pushEdit(this, new changeComponent(root, oldComponent, "Set TD maths"));
     }
 }
 
@@ -561,7 +575,12 @@ MathInLine * OnConditionGraphicsItem::getTriggerMaths()
 
 void OnConditionGraphicsItem::setTriggerMaths(QString m)
 {
-    QSharedPointer<Component> oldComponent = QSharedPointer<Component> (new Component(root->al));
+    // the characters typed into the box one after another are one change
+    bool newEdit = qobject_cast < QLineEdit *> (sender()) && root->isNewEdit(this, "Set OC trigger");
+    QSharedPointer<Component> oldComponent;
+    if (newEdit) {
+        oldComponent = QSharedPointer<Component> (new Component(root->al));
+    }
     // if the sender is a QLineEdit
     QLineEdit * source = qobject_cast < QLineEdit *> (sender());
 
@@ -591,10 +610,8 @@ void OnConditionGraphicsItem::setTriggerMaths(QString m)
     }
 
     root->notifyDataChange();
-    if (qobject_cast < QLineEdit *> (sender())) {
-        root->alPtr->undoStack.push(new changeComponent(root, oldComponent, "Set OC trigger"));
-    } else {
-        oldComponent.clear();
+    if (newEdit) {
+        root->pushEdit(this, new changeComponent(root, oldComponent, "Set OC trigger"));
     }
 }
 
@@ -745,7 +762,12 @@ void StateAssignmentTextItem::setVariable(QString p)
 
 void StateAssignmentTextItem::setMaths(QString m)
 {
-    QSharedPointer<Component> oldComponent = QSharedPointer<Component> (new Component(root->al));
+    // the characters typed into the box one after another are one change
+    bool newEdit = qobject_cast < QLineEdit *> (sender()) && root->isNewEdit(this, "Set SA maths");
+    QSharedPointer<Component> oldComponent;
+    if (newEdit) {
+        oldComponent = QSharedPointer<Component> (new Component(root->al));
+    }
     // if the sender is a QLineEdit
     QLineEdit * source = qobject_cast < QLineEdit *> (sender());
 
@@ -778,10 +800,8 @@ void StateAssignmentTextItem::setMaths(QString m)
 
     updateContent();
     root->notifyDataChange();
-    if (qobject_cast < QLineEdit *> (sender())) {
-        root->alPtr->undoStack.push(new changeComponent(root, oldComponent, "Set SA maths"));
-    } else {
-        oldComponent.clear();
+    if (newEdit) {
+        root->pushEdit(this, new changeComponent(root, oldComponent, "Set SA maths"));
     }
 }
 
@@ -1203,7 +1223,12 @@ MathInLine * AliasTextItem::getMaths()
 
 void AliasTextItem::setMaths(QString m)
 {
-    QSharedPointer<Component> oldComponent = QSharedPointer<Component>(new Component(root->al));
+    // the characters typed into the box one after another are one change
+    bool newEdit = qobject_cast < QLineEdit *> (sender()) && root->isNewEdit(this, "Set Alias maths");
+    QSharedPointer<Component> oldComponent;
+    if (newEdit) {
+        oldComponent = QSharedPointer<Component> (new Component(root->al));
+    }
     // if the sender is a QLineEdit
     QLineEdit * source = qobject_cast < QLineEdit *> (sender());
 
@@ -1235,11 +1260,9 @@ void AliasTextItem::setMaths(QString m)
     }
 
     updateContent();
-    root->notifyDataChange();
-    if (qobject_cast < QLineEdit *> (sender())) {
-        root->alPtr->undoStack.push(new changeComponent(root, oldComponent, "Set Alias maths"));
-    } else {
-        oldComponent.clear();
+    root->notifyMathsChange(alias);
+    if (newEdit) {
+        root->pushEdit(this, new changeComponent(root, oldComponent, "Set Alias maths"));
     }
 }
 
@@ -114,7 +114,7 @@ class NineMLTransitionItem: public TextItemGroup, public GVEdge
 {
     Q_OBJECT
 public:
-    NineMLTransitionItem(GVLayout *layout, Agnode_t *src, Agnode_t *dst, QGraphicsScene *scene = 0);
+    NineMLTransitionItem(GVLayout *layout, GVNode *src, GVNode *dst, QGraphicsScene *scene = 0);
     ~NineMLTransitionItem();
     virtual void updateLayout();
     void updateGVData();
@@ -32,6 +32,8 @@ GroupedTextItem::GroupedTextItem(TextItemGroup *parent)
     : QGraphicsTextItem(parent)
 {
     group = parent;
+    plainTextWidth = 20;
+    staticTextValid = false;
     setFlag(QGraphicsItem::ItemIsSelectable);
     colour = Qt::white;
     setDefaultTextColor(Qt::black);
@@ -65,7 +67,32 @@ void GroupedTextItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
     painter->setPen(colour);
     painter->setBrush(colour);
     painter->drawRect(text_rect);
-    QGraphicsTextItem::paint(painter, option, widget);
+
+    // the document draws the selection frame, and the text of several lines
+    if ((option->state & QStyle::State_Selected) || textInteractionFlags() != Qt::NoTextInteraction
+        || plainText.contains('\n')) {
+        QGraphicsTextItem::paint(painter, option, widget);
+        return;
+    }
+
+    // as the document lays it out, within its margin. Scrolling only moves
+    // the glyphs, so it is the zoom which has the text laid out again
+    qreal margin = document()->documentMargin();
+    QTransform t = painter->worldTransform();
+    QTransform zoom(t.m11(), t.m12(), t.m13(), t.m21(), t.m22(), t.m23(), 0, 0, t.m33());
+    if (!staticTextValid || staticTextTransform != zoom || !(staticTextFont == font())) {
+        staticText.setText(plainText);
+        staticText.setTextFormat(Qt::PlainText);
+        staticText.setTextOption(document()->defaultTextOption());
+        staticText.setTextWidth(textWidth() < 0 ? -1 : qMax((qreal) 0, textWidth() - 2*margin));
+        staticTextTransform = zoom;
+        staticTextFont = font();
+        staticText.prepare(staticTextTransform, staticTextFont);
+        staticTextValid = true;
+    }
+    painter->setFont(staticTextFont);
+    painter->setPen(defaultTextColor());
+    painter->drawStaticText(QPointF(margin, margin), staticText);
 }
 
 
@@ -89,8 +116,9 @@ QRectF GroupedTextItem::boundingRect() const
 
 int GroupedTextItem::physicalTextWidth()
 {
-    QFontMetricsF fm(this->font());
-    return fm.width(toPlainText())+20;
+    // measured when the text is set, as every member of a group is
+    // measured each time one of them changes
+    return plainTextWidth;
 }
 
 void GroupedTextItem::setColour(QColor c)
@@ -101,9 +129,21 @@ void GroupedTextItem::setColour(QColor c)
 void GroupedTextItem::setPlainText(const QString &text)
 {
     QGraphicsTextItem::setPlainText(text);
+    plainText = text;
+    QFontMetricsF fm(this->font());
+    plainTextWidth = fm.width(text)+20;
+    staticTextValid = false;
     group->updateItemDimensions();
 }
 
+void GroupedTextItem::setTextWidth(qreal width)
+{
+    if (width != textWidth()) {
+        QGraphicsTextItem::setTextWidth(width);
+        staticTextValid = false;
+    }
+}
+
 TextItemGroup * GroupedTextItem::getTextItemGroup()
 {
     if (parentItem() != NULL)
@@ -28,6 +28,7 @@
 #include <QtGui>
 #include <QGraphicsScene>
 #include "QGraphicsTextItem"
+#include <QStaticText>
 
 #define TEXT_PADDING 8
 #define PADDING 10
@@ -59,6 +60,7 @@ public:
     virtual void updateContent() = 0;
     void setColour(QColor c);
     void setPlainText (const QString &text); //overwrites QGraphicsTextItem
+    void setTextWidth(qreal width); //overwrites QGraphicsTextItem, to drop the laid out text
     TextItemGroup *getTextItemGroup();
     int getIndexPosition();
 
@@ -72,6 +74,14 @@ protected:
 
 private:
     TextItemGroup* group;
+    // the text laid out for the transform and font it was last painted
+    // with, so that a repaint or zoom does not lay out the document again
+    QString plainText;
+    int plainTextWidth;
+    QStaticText staticText;
+    QTransform staticTextTransform;
+    QFont staticTextFont;
+    bool staticTextValid;
 };
 
 
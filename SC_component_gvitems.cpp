@@ -23,60 +23,314 @@
 ****************************************************************************/
 
 #include "SC_component_gvitems.h"
+// By default, use libcgraph from Graphviz, but if the user requests,
+// use the deprecated libgraph.
+#include <graphviz/gvc.h>
+#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
+# include <graphviz/graph.h>
+#else
+# define WITH_CGRAPH 1
+# include <graphviz/cgraph.h>
+#endif
 
 
 // Debugging define here, as we don't include globalHeader.h
 #define DBG() qDebug() << __FUNCTION__ << ": "
 
-/* GVLayout */
-GVLayout::GVLayout()
+// Graphviz keeps global state, so only one graph is laid out at a time
+static QMutex gvLayoutLock;
+
+/* gvLayoutWorker */
+gvLayoutWorker::gvLayoutWorker(const gvGraphData &graph, int serial)
+{
+    this->graph = graph;
+    this->serial = serial;
+}
+
+void gvLayoutWorker::run()
 {
-    this->gvc = gvContext();
+    layOut(this->graph);
+    emit finished();
+}
+
+void gvLayoutWorker::layOut(gvGraphData &graph)
+{
+    QMutexLocker locker(&gvLayoutLock);
+
+    // A graph and context are made for each run and freed afterwards, so
+    // gvLayout() is never called twice on the same graph; with cgraph that
+    // crashes in Graphviz 2.26.3 and 2.30.1 due to a bug fixed in 2.32.
+    // See http://www.graphviz.org/mantisbt/view.php?id=2467
+    GVC_t* gvc = gvContext();
+#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
+    Agraph_t* gvgraph = agopen((char*)"g", AGDIGRAPH);
+#else
+    Agraph_t* gvgraph = agopen((char*)"g", Agdirected, NULL);
+#endif
+
+    agsafeset(gvgraph, (char*)"splines", (char*)"true", (char*)"");
+    agsafeset(gvgraph, (char*)"overlap", (char*)"false", (char*)"");
+    agsafeset(gvgraph, (char*)"rankdir", (char*)"LR", (char*)"");
+    agsafeset(gvgraph, (char*)"nodesep", (char*)"2.0", (char*)"");
+    agsafeset(gvgraph, (char*)"labelloc", (char*)"t", (char*)"");
+
+    // nodes are named by index, so that names shared by two items or
+    // changed since the copy was made do not matter
+    QVector < Agnode_t* > nodes(graph.nodes.size());
+    for (int i = 0; i < graph.nodes.size(); ++i) {
+        char name[16];
+        sprintf(name, "n%d", i);
+#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
+        nodes[i] = agnode(gvgraph, name);
+#else
+        nodes[i] = agnode(gvgraph, name, TRUE);
+#endif
+        agsafeset(nodes[i], (char*)"fixedsize", (char*)"true", (char*)"");
+        agsafeset(nodes[i], (char*)"shape", (char*)"rectangle", (char*)"");
+        if (graph.nodes[i].width >= 0) {
+            char w[16];
+            char h[16];
+            sprintf(w,"%f", graph.nodes[i].width);
+            sprintf(h,"%f", graph.nodes[i].height);
+            agsafeset(nodes[i], (char*)"width", w, (char*)"");
+            agsafeset(nodes[i], (char*)"height", h, (char*)"");
+        }
+    }
 
+    QVector < Agedge_t* > edges(graph.edges.size());
+    for (int i = 0; i < graph.edges.size(); ++i) {
+        gvEdgeData &e = graph.edges[i];
 #ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-    this->gvgraph = agopen((char*)"g", AGDIGRAPH);
+        edges[i] = agedge(gvgraph, nodes[e.src], nodes[e.dst]);
 #else
-    this->gvgraph = agopen((char*)"g", Agdirected, NULL);
+        edges[i] = agedge(gvgraph, nodes[e.src], nodes[e.dst], NULL, 1);
 #endif
+        if (e.labelWidth >= 0) {
+            char label[256];
+            sprintf(label,"<table width=\"%d\" height=\"%d\"><tr><td>Label</td></tr></table>", e.labelWidth, e.labelHeight);
+#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
+            char* html = agstrdup_html(label);
+            agsafeset(edges[i], (char*)"label", html, (char*)"html");
+            agstrfree(html);
+#else
+            char* html = agstrdup_html(gvgraph, label);
+            agsafeset(edges[i], (char*)"label", html, (char*)"html");
+            agstrfree(gvgraph, html);
+#endif
+        }
+    }
+
+    gvLayout (gvc, gvgraph, "dot");
 
-    agsafeset(this->gvgraph, (char*)"splines", (char*)"true", (char*)"");
-    agsafeset(this->gvgraph, (char*)"overlap", (char*)"false", (char*)"");
-    agsafeset(this->gvgraph, (char*)"rankdir", (char*)"LR", (char*)"");
-    agsafeset(this->gvgraph, (char*)"nodesep", (char*)"2.0", (char*)"");
-    agsafeset(this->gvgraph, (char*)"labelloc", (char*)"t", (char*)"");
+    // For debugging, this shows the content of the graph (ok for libgraph and libcgraph):
+    //gvRender (gvc, gvgraph, "dot", stdout);
+
+    qreal top = GD_bb(gvgraph).UR.y;
+    for (int i = 0; i < graph.nodes.size(); ++i) {
+        graph.nodes[i].pos = QPointF(ND_coord(nodes[i]).x, top - ND_coord(nodes[i]).y);
+    }
+    for (int i = 0; i < graph.edges.size(); ++i) {
+        gvEdgeData &e = graph.edges[i];
+        textlabel_t* edgelabel = ED_label(edges[i]);
+        if (edgelabel != NULL) {
+            e.labelPos = QPointF(edgelabel->pos.x, top - edgelabel->pos.y);
+        } else if (e.labelWidth >= 0) {
+            DBG() << "Warning: edge label doesn't exist after layout...";
+        }
+        e.splines.clear();
+        if (ED_spl(edges[i]) != NULL && ED_spl(edges[i])->size > 0) {
+            bezier &bz = ED_spl(edges[i])->list[0];
+            for (int j = 0; j < bz.size; ++j) {
+                e.splines.push_back(QPointF(bz.list[j].x, top - bz.list[j].y));
+            }
+            e.splineEnd = QPointF(bz.ep.x, top - bz.ep.y);
+        }
+    }
+
+    gvFreeLayout (gvc, gvgraph);
+    agclose(gvgraph);
+    gvFreeContext (gvc);
+}
+
+/* GVLayout */
+GVLayout::GVLayout()
+{
+    this->haveLayout = false;
+    this->layoutQueued = false;
+    this->layoutRunning = false;
+    this->layoutAgain = false;
+    this->layoutSerial = 0;
 }
 
 GVLayout::~GVLayout()
 {
-    agclose(this->gvgraph);
-    gvFreeContext (this->gvc);
+    // a worker still running finishes before the layout goes
+    layoutThread.quit();
+    layoutThread.wait();
 }
 
 void GVLayout::updateLayout()
 {
-    gvLayout (this->gvc, this->gvgraph, "dot");
-    //update all graphviz items in the layout
-    for (int i=0; i<this->items.size(); i++)
-    {
-        GVItem *gv_item = this->items[i];
-        gv_item->updateLayout();
+    // the items are usually changed several at a time, so the layout is
+    // made once control returns to the event loop
+    if (!this->layoutQueued) {
+        this->layoutQueued = true;
+        QMetaObject::invokeMethod(this, "startLayout", Qt::QueuedConnection);
     }
+}
 
-    // For debugging, this shows the content of the graph (ok for libgraph and libcgraph):
-    //gvRender (this->gvc, this->gvgraph, "dot", stdout);
+void GVLayout::updateLayoutNow()
+{
+    gvGraphData graph;
+    describe(graph);
+    if (needsLayout(graph)) {
+        // any run in progress is now out of date
+        ++this->layoutSerial;
+        this->layoutAgain = false;
+        gvLayoutWorker::layOut(graph);
+        apply(graph);
+    }
+    placeItems();
+    emit layoutChanged();
+}
 
-    // The original comment for gvFreeLayout() was:
-    // free after update to avoid crashes when node are removed!
-    // When gvc is used with cgraph, this actually causes a crash in Graphviz
-    // 2.26.3 and 2.30.1, due to bug (in Graphviz) 2.32+ are immune.
-    // The crash occurs on a subsequent call to gvLayout().
-    // See http://www.graphviz.org/mantisbt/view.php?id=2467
-    gvFreeLayout (this->gvc, this->gvgraph);
+void GVLayout::startLayout()
+{
+    this->layoutQueued = false;
+    if (this->layoutRunning) {
+        this->layoutAgain = true;
+        return;
+    }
+
+    gvGraphData graph;
+    describe(graph);
+    if (!needsLayout(graph)) {
+        placeItems();
+        emit layoutChanged();
+        return;
+    }
+
+    gvLayoutWorker * worker = new gvLayoutWorker(graph, ++this->layoutSerial);
+    worker->moveToThread(&layoutThread);
+    connect(worker, SIGNAL(finished()), this, SLOT(layoutFinished()));
+
+    if (!layoutThread.isRunning()) {
+        layoutThread.start();
+    }
+    this->layoutRunning = true;
+    QMetaObject::invokeMethod(worker, "run", Qt::QueuedConnection);
+}
+
+void GVLayout::layoutFinished()
+{
+    gvLayoutWorker * worker = qobject_cast <gvLayoutWorker *> (sender());
+    if (!worker) {
+        return;
+    }
+    worker->deleteLater();
+    this->layoutRunning = false;
+
+    // results overtaken by updateLayoutNow() are dropped
+    if (worker->serial == this->layoutSerial) {
+        apply(worker->graph);
+        placeItems();
+        emit layoutChanged();
+    }
+
+    if (this->layoutAgain) {
+        this->layoutAgain = false;
+        startLayout();
+    }
+}
+
+void GVLayout::describe(gvGraphData &graph)
+{
+    QHash < GVNode*, int > nodeIndex;
+    for (int i = 0; i < this->items.size(); ++i) {
+        GVNode * node = dynamic_cast < GVNode * > (this->items[i]);
+        if (node && !nodeIndex.contains(node)) {
+            gvNodeData n;
+            n.item = node;
+            n.width = node->gv_size.width();
+            n.height = node->gv_size.height();
+            nodeIndex[node] = graph.nodes.size();
+            graph.nodes.push_back(n);
+        }
+    }
+    for (int i = 0; i < this->items.size(); ++i) {
+        GVEdge * edge = dynamic_cast < GVEdge * > (this->items[i]);
+        // edges to a node not in the layout are left out
+        if (edge && nodeIndex.contains(edge->gv_src) && nodeIndex.contains(edge->gv_dst)) {
+            gvEdgeData e;
+            e.item = edge;
+            e.src = nodeIndex[edge->gv_src];
+            e.dst = nodeIndex[edge->gv_dst];
+            e.labelWidth = edge->gv_label_size.width();
+            e.labelHeight = edge->gv_label_size.height();
+            graph.edges.push_back(e);
+        }
+    }
 }
 
-Agraph_t *GVLayout::getGVGraph()
+bool GVLayout::needsLayout(const gvGraphData &graph)
 {
-    return this->gvgraph;
+    if (!this->haveLayout) {
+        return true;
+    }
+    const gvGraphData &old = this->laidOut;
+    if (graph.nodes.size() != old.nodes.size() || graph.edges.size() != old.edges.size()) {
+        return true;
+    }
+    // a box which has shrunk, or grown a little, still fits where it was
+    qreal slack = GV_LAYOUT_SLACK / GV_DPI;
+    for (int i = 0; i < graph.nodes.size(); ++i) {
+        const gvNodeData &n = graph.nodes[i];
+        const gvNodeData &o = old.nodes[i];
+        if (n.item != o.item || n.width > o.width + slack || n.height > o.height + slack) {
+            return true;
+        }
+    }
+    for (int i = 0; i < graph.edges.size(); ++i) {
+        const gvEdgeData &e = graph.edges[i];
+        const gvEdgeData &o = old.edges[i];
+        if (e.item != o.item || e.src != o.src || e.dst != o.dst
+                || (e.labelWidth < 0) != (o.labelWidth < 0)
+                || e.labelWidth > o.labelWidth + GV_LAYOUT_SLACK
+                || e.labelHeight > o.labelHeight + GV_LAYOUT_SLACK) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GVLayout::apply(const gvGraphData &graph)
+{
+    // items removed while dot was running are skipped
+    for (int i = 0; i < graph.nodes.size(); ++i) {
+        if (this->items.contains(graph.nodes[i].item)) {
+            graph.nodes[i].item->gv_pos = graph.nodes[i].pos;
+        }
+    }
+    for (int i = 0; i < graph.edges.size(); ++i) {
+        const gvEdgeData &e = graph.edges[i];
+        if (this->items.contains(e.item)) {
+            e.item->gv_label_pos = e.labelPos;
+            e.item->gv_splines = e.splines;
+            e.item->gv_spline_end = e.splineEnd;
+        }
+    }
+    this->laidOut = graph;
+    this->haveLayout = true;
+}
+
+void GVLayout::placeItems()
+{
+    //update all graphviz items in the layout
+    for (int i=0; i<this->items.size(); i++)
+    {
+        GVItem *gv_item = this->items[i];
+        gv_item->updateLayout();
+    }
 }
 
 void GVLayout::addGVItem(GVItem *item)
@@ -100,35 +354,17 @@ GVItem::GVItem(GVLayout *l)
 GVNode::GVNode(GVLayout *l, QString name)
     : GVItem(l)
 {
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-    this->gv_node = agnode(this->layout->getGVGraph(), name.toUtf8().data());
-#else
-    this->gv_node = agnode(this->layout->getGVGraph(), name.toUtf8().data(), TRUE);
-#endif
-    agsafeset(this->gv_node, (char*)"fixedsize", (char*)"true", (char*)"");
-    agsafeset(this->gv_node, (char*)"shape", (char*)"rectangle", (char*)"");
+    this->gv_name = name;
 }
 
 GVNode::~GVNode()
 {
-    agdelete(this->layout->getGVGraph(), this->gv_node);
-}
-
-Agnode_t * GVNode::getGVNode()
-{
-    return this->gv_node;
+    this->layout->removeGVItem(this);
 }
 
 void GVNode::setGVNodeSize(qreal width_inches, qreal height_inches)
 {
-    //update GV node size
-    char w[16];
-    char h[16];
-    sprintf(w,"%f", width_inches);
-    sprintf(h,"%f", height_inches);
-    agsafeset(this->gv_node, (char*)"width", w, (char*)"");
-    agsafeset(this->gv_node, (char*)"height", h, (char*)"");
-    //DBG() << "setGVNodeSize (" << w << ", " << h << ") in inches for node " << ND_id(this->gv_node);
+    this->gv_size = QSizeF(width_inches, height_inches);
 }
 
 // used in nineml_graphicsitems.cpp:122 or thereabouts.  This method
@@ -136,103 +372,52 @@ void GVNode::setGVNodeSize(qreal width_inches, qreal height_inches)
 // make this a pure position accessor.
 QPointF GVNode::getGVNodePosition(QPointF offset)
 {
-    QPointF position;
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-    position = QPointF((gv_node->u.coord.x), (layout->getGVGraph()->u.bb.UR.y - gv_node->u.coord.y));
-#else
-    position = QPointF(ND_coord(this->gv_node).x,
-                               (GD_bb(this->layout->getGVGraph()).UR.y - ND_coord(this->gv_node).y));
-#endif
-    //DBG() << "getGVNodePosition: actual position: " << position
-    //      << " for node ID " << ND_id(this->gv_node);
-    position -= offset;
-    return position;
+    return this->gv_pos - offset;
 }
 
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
 void GVNode::renameGVNode(QString name)
 {
-    QString temp(gv_node->name);
-    agstrfree(gv_node->name);
-    gv_node->name = agstrdup(name.toUtf8().data());
+    this->gv_name = name;
 }
-#endif
 
 /* GVEdge */
-GVEdge::GVEdge(GVLayout *l, Agnode_t *src, Agnode_t *dst)
+GVEdge::GVEdge(GVLayout *l, GVNode *src, GVNode *dst)
     : GVItem(l)
 {
-    //get src regime
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-    this->gv_edge = agedge(this->layout->getGVGraph(), src, dst);
-#else
-    this->gv_edge = agedge(this->layout->getGVGraph(), src, dst, NULL, 1);
-#endif
+    this->gv_src = src;
+    this->gv_dst = dst;
 }
 
 GVEdge::~GVEdge()
 {
-    agdelete(this->layout->getGVGraph(), this->gv_edge);
+    this->layout->removeGVItem(this);
 }
 
 
 void GVEdge::setGVEdgeLabelSize(int width_pixels, int height_pixels)
 {
-    //update GV l width
-    char label[256];
-    sprintf(label,"<table width=\"%d\" height=\"%d\"><tr><td>Label</td></tr></table>", width_pixels, height_pixels);
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-    char* html = agstrdup_html(label);
-    agsafeset(this->gv_edge, (char*)"label", html, (char*)"html");
-    agstrfree(html);
-#else
-    char* html = agstrdup_html(this->layout->getGVGraph(), label);
-    agsafeset(this->gv_edge, (char*)"label", html, (char*)"html");
-    agstrfree(this->layout->getGVGraph(), html);
-#endif
-    //DBG() << "(" << width_pixels<< ", " << height_pixels << ") for label '" << agget (this->gv_edge, (char*)"label") << "'";
+    this->gv_label_size = QSize(width_pixels, height_pixels);
 }
 
 QPointF GVEdge::getGVEdgeLabelPosition(QPointF offset)
 {
-    QPointF position(0,0);
-
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-    position = QPointF(this->gv_edge->u.label->pos.x,
-                       this->layout->getGVGraph()->u.bb.UR.y - this->gv_edge->u.label->pos.y);
-#else
-    qreal a = 0;
-    qreal b = 0;
-    textlabel_t* edgelabel = ED_label(this->gv_edge);
-    if (edgelabel != NULL) {
-        a = edgelabel->pos.x;
-    } else {
-        DBG() << "Warning: edge label doesn't exist in this->gv_edge...";
-    }
-    //char* l = agget (this->gv_edge, (char*)"label");
-    b = (GD_bb(this->layout->getGVGraph()).UR.y - ED_label(this->gv_edge)->pos.y);
-    position = QPointF(a,b);
-#endif
-
-    position -= offset;
-    return position;
+    return this->gv_label_pos - offset;
 }
 
 int GVEdge::getGVEdgeSplinesCount()
 {
-    return ED_spl(this->gv_edge)->list->size;
+    return this->gv_splines.size();
 }
 
 QPointF GVEdge::getGVEdgeSplinesPoint(int i)
 {
-    QPointF spline = QPointF(ED_spl(this->gv_edge)->list->list[i].x,
-                             GD_bb(this->layout->getGVGraph()).UR.y - ED_spl(this->gv_edge)->list->list[i].y);
-    return spline;
+    if (i < 0 || i >= this->gv_splines.size()) {
+        return QPointF();
+    }
+    return this->gv_splines[i];
 }
 
 QPointF GVEdge::getGVEdgeSplinesEndPoint()
 {
-    QPointF spline = QPointF(ED_spl(this->gv_edge)->list->ep.x,
-                             GD_bb(this->layout->getGVGraph()).UR.y - ED_spl(this->gv_edge)->list->ep.y);
-    return spline;
+    return this->gv_spline_end;
 }
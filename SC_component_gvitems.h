@@ -34,15 +34,6 @@
 #define GVITEMS_H
 
 #include <QtGui>
-// By default, use libcgraph from Graphviz, but if the user requests,
-// use the deprecated libgraph.
-#include <graphviz/gvc.h>
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
-# include <graphviz/graph.h>
-#else
-# define WITH_CGRAPH 1
-# include <graphviz/cgraph.h>
-#endif
 #include <vector>
 #include <algorithm>
 #include "SC_component_grouptextitems.h"
@@ -51,12 +42,19 @@ using namespace std;
 
 #define GV_DPI 72.0
 
+// a box may grow by this many points before the graph is laid out again; a
+// smaller change keeps the positions from the last layout
+#define GV_LAYOUT_SLACK 12.0
+
 class GVLayout;
+class GVNode;
+class GVEdge;
 
 class GVItem
 {
 public:
     GVItem(GVLayout *l);
+    virtual ~GVItem() {}
     virtual void updateLayout() = 0;
     virtual void updateGVData() = 0;
 
@@ -64,20 +62,96 @@ protected:
     GVLayout *layout;
 };
 
+/*!
+ * A copy of the graph to be laid out, made on the GUI thread so that dot can
+ * be run on another thread, with the positions read back filled in. Points
+ * are in Graphviz points with y measured down from the top of the graph.
+ */
+struct gvNodeData
+{
+    GVNode *item;
+    qreal width;    // inches, or < 0 for the dot default
+    qreal height;
+    QPointF pos;
+};
 
-class GVLayout
+struct gvEdgeData
+{
+    GVEdge *item;
+    int src;        // index into nodes
+    int dst;
+    int labelWidth; // pixels, or < 0 for no label
+    int labelHeight;
+    QPointF labelPos;
+    QVector < QPointF > splines;
+    QPointF splineEnd;
+};
+
+struct gvGraphData
+{
+    QVector < gvNodeData > nodes;
+    QVector < gvEdgeData > edges;
+};
+
+/*!
+ * \brief The gvLayoutWorker class runs dot over a gvGraphData on the layout
+ * thread, building a graph for the run and freeing it afterwards.
+ */
+class gvLayoutWorker : public QObject
 {
+    Q_OBJECT
+public:
+    gvLayoutWorker(const gvGraphData &graph, int serial);
+    gvGraphData graph;
+    int serial;
+    static void layOut(gvGraphData &graph);
+
+public slots:
+    void run();
+
+signals:
+    void finished();
+};
+
+/*!
+ * \brief The GVLayout class lays out the items of the component editor with
+ * dot. The positions from the last layout are kept, and dot is only run again
+ * when items are added or removed or a box grows by more than GV_LAYOUT_SLACK;
+ * the run is made on a worker thread and the items are moved when it ends.
+ */
+class GVLayout : public QObject
+{
+    Q_OBJECT
 public:
     GVLayout();
     ~GVLayout();
+    // request a layout; calls made together are handled as one
     void updateLayout();
-    Agraph_t *getGVGraph();
+    // lay the items out before returning, for when the positions are needed
+    void updateLayoutNow();
     void addGVItem(GVItem *item);
     void removeGVItem(GVItem *item);
+
+signals:
+    void layoutChanged();
+
+private slots:
+    void startLayout();
+    void layoutFinished();
+
 private:
-    Agraph_t *gvgraph;
-    GVC_t* gvc;
+    void describe(gvGraphData &graph);
+    bool needsLayout(const gvGraphData &graph);
+    void apply(const gvGraphData &graph);
+    void placeItems();
     QVector <GVItem*> items;
+    gvGraphData laidOut;
+    bool haveLayout;
+    bool layoutQueued;
+    bool layoutRunning;
+    bool layoutAgain;
+    int layoutSerial;
+    QThread layoutThread;
 };
 
 
@@ -86,21 +160,21 @@ class GVNode : public GVItem
 public:
     GVNode(GVLayout *layout, QString name);
     ~GVNode();
-    Agnode_t* getGVNode();
     void setGVNodeSize(qreal width_inches, qreal height_inches);
     QPointF getGVNodePosition(QPointF offset);
-#ifdef USE_LIBGRAPH_NOT_LIBCGRAPH
     void renameGVNode(QString name);
-#endif
 protected:
-    Agnode_t *gv_node;
+    friend class GVLayout;
+    QString gv_name;
+    QSizeF gv_size;
+    QPointF gv_pos;
 };
 
 
 class GVEdge :  public GVItem
 {
 public:
-    GVEdge(GVLayout *layout, Agnode_t *src, Agnode_t *dst);
+    GVEdge(GVLayout *layout, GVNode *src, GVNode *dst);
     ~GVEdge();
     void setGVEdgeLabelSize(int width_pixels, int height_pixels);
     QPointF getGVEdgeLabelPosition(QPointF offset);
@@ -108,7 +182,13 @@ public:
     QPointF getGVEdgeSplinesPoint(int item);
     QPointF getGVEdgeSplinesEndPoint();
 protected:
-    Agedge_t *gv_edge;
+    friend class GVLayout;
+    GVNode *gv_src;
+    GVNode *gv_dst;
+    QSize gv_label_size;
+    QPointF gv_label_pos;
+    QVector < QPointF > gv_splines;
+    QPointF gv_spline_end;
 };
 
 #endif // GVITEMS_H
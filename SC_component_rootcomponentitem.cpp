@@ -195,6 +195,67 @@ void RootComponentItem::notifyDataChange()
     emit unsavedChange(true);
 }
 
+void RootComponentItem::notifyMathsChange(TimeDerivative * td)
+{
+    // the library copy has the same regimes, in the same order, unless it
+    // has been changed by something else
+    if (this->alPtr != NULL && this->al != NULL && this->alPtr->RegimeList.size() == this->al->RegimeList.size()) {
+        for (int i = 0; i < this->al->RegimeList.size(); ++i) {
+            int j = this->al->RegimeList[i]->TimeDerivativeList.indexOf(td);
+            if (j < 0) {
+                continue;
+            }
+            if (j < this->alPtr->RegimeList[i]->TimeDerivativeList.size()) {
+                TimeDerivative * copy = this->alPtr->RegimeList[i]->TimeDerivativeList[j];
+                if (copy->variable_name == td->variable_name) {
+                    copy->maths->equation = td->maths->equation;
+                    this->alPtr->editedVersion.clear();
+                    emit unsavedChange(true);
+                    return;
+                }
+            }
+            break;
+        }
+    }
+    this->notifyDataChange();
+}
+
+void RootComponentItem::notifyMathsChange(Alias * alias)
+{
+    if (this->alPtr != NULL && this->al != NULL && this->alPtr->AliasList.size() == this->al->AliasList.size()) {
+        int i = this->al->AliasList.indexOf(alias);
+        if (i >= 0 && this->alPtr->AliasList[i]->getName() == alias->getName()) {
+            this->alPtr->AliasList[i]->maths->equation = alias->maths->equation;
+            this->alPtr->editedVersion.clear();
+            emit unsavedChange(true);
+            return;
+        }
+    }
+    this->notifyDataChange();
+}
+
+bool RootComponentItem::isNewEdit(const void * item, const QString &what)
+{
+    if (item != this->lastEditItem || this->lastEditChange == (const changeComponent *)0 || this->alPtr == NULL) {
+        return true;
+    }
+    // only while that change is the newest on the stack and has not been
+    // undone, so that it still takes the component as it is now
+    QUndoStack * stack = &this->alPtr->undoStack;
+    if (stack->index() == 0 || stack->index() != stack->count()) {
+        return true;
+    }
+    const changeComponent * last = dynamic_cast <const changeComponent *> (stack->command(stack->index()-1));
+    return last != this->lastEditChange || last->text() != what || !last->isOpen();
+}
+
+void RootComponentItem::pushEdit(const void * item, changeComponent * change)
+{
+    this->alPtr->undoStack.push(change);
+    this->lastEditItem = item;
+    this->lastEditChange = change;
+}
+
 
 void RootComponentItem::requestLayoutUpdate()
 {
@@ -404,6 +465,8 @@ void RootComponentItem::deleteComponent()
 
 void RootComponentItem::init()
 {
+    lastEditItem = (const void *)0;
+    lastEditChange = (const changeComponent *)0;
 
     // add actions and toolbars:
     toolbar = new QToolBar("Component main toolbar");
@@ -37,6 +37,7 @@ enum ALSceneMode { ModeSelect, ModeInsertOnCondition, ModeInsertOnEvent, ModeIns
 class PropertiesManager;
 class NineMLALScene;
 class nl_rootdata;
+class changeComponent;
 
 class RootComponentItem: public QObject
 {
@@ -49,6 +50,24 @@ public:
     void setSelectionMode(ALSceneMode mode);
     void clearSelection();
     void notifyDataChange();
+    /*!
+     * As notifyDataChange(), for a change to the maths of one
+     * TimeDerivative or Alias of al. Only its counterpart in alPtr is
+     * updated, rather than alPtr being copied again from all of al.
+     */
+    void notifyMathsChange(TimeDerivative * td);
+    void notifyMathsChange(Alias * alias);
+    /*!
+     * True if an edit named what, of the field of item, should be pushed as
+     * a new change. An edit which follows on from the last one pushed for
+     * the same field, as each character typed into its box does, is part
+     * of that change, so only the first takes a snapshot of the component.
+     */
+    bool isNewEdit(const void * item, const QString &what);
+    /*!
+     * Push the change made by a new edit of item.
+     */
+    void pushEdit(const void * item, changeComponent * change);
     QAction * actionSelectMode;
     QToolBar * addItemsToolbar;
     QToolBar * toolbar;
@@ -120,6 +139,10 @@ public:
 private:
     void init();
 
+    // the last edit pushed, which later edits of the same field join
+    const void * lastEditItem;
+    const changeComponent * lastEditChange;
+
 signals:
     void unsavedChange(bool unsaved);
     void initialRegimeChanged();
@@ -110,6 +110,9 @@ void NineMLALScene::initialiseScene(QSharedPointer<Component>al)
         }
     }
 
+    // the scene rect is taken from where the items are laid out
+    root->gvlayout->updateLayoutNow();
+
     QRectF sceneRect = this->itemsBoundingRect();
     sceneRect.setX(sceneRect.x()-NINEMLALSCENE_SIZE);
     sceneRect.setY(sceneRect.y()-NINEMLALSCENE_SIZE);
@@ -119,13 +122,13 @@ void NineMLALScene::initialiseScene(QSharedPointer<Component>al)
 }
 
 
-Agnode_t * NineMLALScene::getRegimeGVNode(Regime *r)
+GVNode * NineMLALScene::getRegimeGVNode(Regime *r)
 {
     for (int i=0; i<rg_items.size(); i++)
     {
         RegimeGraphicsItem *rg = rg_items[i];
         if (rg->isRegime(r))
-            return rg->getGVNode();
+            return rg;
     }
     qDebug() << "Regime not found in rg items whilst looking for gv node";
     return NULL;
@@ -52,7 +52,7 @@ public:
     void removeOnEvent(OnEventGraphicsItem* oei);
     void removeOnImpulse(OnImpulseGraphicsItem* oei);
 
-    Agnode_t* getRegimeGVNode(Regime* r);
+    GVNode* getRegimeGVNode(Regime* r);
 
     void setParamsVisibility(bool visible);
     void setPortsVisibility(bool visible);
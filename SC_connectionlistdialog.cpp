@@ -34,9 +34,8 @@ connectionListDialog::connectionListDialog (csv_connection* c, QWidget* parent)
     this->ui->setupUi (this);
 
     this->conn = c;
+    // newConn shares the data values until they are edited in the dialog
     this->newConn = (csv_connection*)this->conn->newFromExisting();
-    // Copy data values in so that they appear in the dialog:
-    this->newConn->copyDataValues (this->conn);
 
     ui->spinBox->setRange (0, INT_MAX); // set max from the component
     ui->spinBox->setValue (this->conn->getNumRows());
@@ -91,7 +90,20 @@ void connectionListDialog::importCSV (void)
                                                      qgetenv("HOME"),
                                                      tr("CSV files (*.csv *.txt);; All files (*.*)"));
 
-    if (this->newConn->import_csv (fileName) == true) {
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    // large lists take a while to parse
+    QProgressDialog progress ("Importing " + QFileInfo(fileName).fileName(), QString(), 0, 100, this);
+    progress.setWindowModality (Qt::WindowModal);
+    progress.setMinimumDuration (500);
+    connect (this->newConn, SIGNAL(progress(int)), &progress, SLOT(setValue(int)));
+    bool imported = this->newConn->import_csv (fileName);
+    disconnect (this->newConn, SIGNAL(progress(int)), &progress, SLOT(setValue(int)));
+    progress.setValue (100);
+
+    if (imported == true) {
         // Import was successful
         this->vModel->deleteLater();
         this->vModel = new csv_connectionModel();
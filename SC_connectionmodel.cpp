@@ -28,16 +28,46 @@ csv_connectionModel::csv_connectionModel(QObject *parent) :
     QAbstractTableModel(parent)
 {
     this->currentConnection = (csv_connection *)0;
+    this->fetchedRows = 0;
 }
 
+ int csv_connectionModel::listRows() const
+ {
+     if (!(this->currentConnection == (csv_connection *)0)) {
+         return this->currentConnection->getNumRows();
+     }
+     return 0;
+ }
+
  int csv_connectionModel::rowCount(const QModelIndex & /*parent*/) const
  {
      if (!(this->currentConnection == (csv_connection *)0)) {
+         if (this->fetchedRows < this->listRows()) {
+             return this->fetchedRows;
+         }
          return this->currentConnection->getNumRows() + 1;
      }
      return 0;
  }
 
+ bool csv_connectionModel::canFetchMore(const QModelIndex &parent) const
+ {
+     return !parent.isValid() && this->fetchedRows < this->listRows();
+ }
+
+ void csv_connectionModel::fetchMore(const QModelIndex &parent)
+ {
+     if (!this->canFetchMore(parent)) {
+         return;
+     }
+     int more = qMin(LIST_MODEL_PAGE_ROWS, this->listRows() - this->fetchedRows);
+     // the last page brings the empty row with it
+     int last = this->fetchedRows + more < this->listRows() ? this->fetchedRows + more - 1 : this->fetchedRows + more;
+     beginInsertRows(QModelIndex(), this->fetchedRows, last);
+     this->fetchedRows += more;
+     endInsertRows();
+ }
+
  int csv_connectionModel::columnCount(const QModelIndex & /*parent*/) const
  {
      if (!(this->currentConnection == (csv_connection *)0)) {
@@ -69,7 +99,10 @@ csv_connectionModel::csv_connectionModel(QObject *parent) :
  }
 
  void csv_connectionModel::setConnection(csv_connection * currConn) {
+     beginResetModel();
      this->currentConnection = currConn;
+     this->fetchedRows = qMin(LIST_MODEL_PAGE_ROWS, this->listRows());
+     endResetModel();
  }
 
  csv_connection * csv_connectionModel::getConnection() {
@@ -105,6 +138,7 @@ csv_connectionModel::csv_connectionModel(QObject *parent) :
                     for (int i = 0; i < currentConnection->getNumCols(); ++i) {
                         currentConnection->setData(this->createIndex(currentConnection->getNumRows()-1,i), 0);
                     }
+                    this->fetchedRows = this->listRows();
                 endInsertRows();
                 setSpinBoxVal(currentConnection->getNumRows());
          }
@@ -121,8 +155,10 @@ csv_connectionModel::csv_connectionModel(QObject *parent) :
  }
 
  void csv_connectionModel::emitDataChanged() {
-    QModelIndex index = this->createIndex(0,0);
-    emit dataChanged(index, index);
+    // the list may have been replaced, so start again from the first page
+    beginResetModel();
+    this->fetchedRows = qMin(LIST_MODEL_PAGE_ROWS, this->listRows());
+    endResetModel();
  }
 
  Qt::ItemFlags csv_connectionModel::flags(const QModelIndex & /*index*/) const
@@ -132,27 +168,25 @@ csv_connectionModel::csv_connectionModel(QObject *parent) :
 
  bool csv_connectionModel::insertConnRows(int row) {
 
-     if (row > currentConnection->getNumRows()) {
-         beginInsertRows(this->createIndex(currentConnection->getNumRows()-1, 0).parent(),currentConnection->getNumRows(),row-1);
+     if (row == currentConnection->getNumRows()) {
+         return true;
+     }
 
+     bool allShown = this->fetchedRows >= this->listRows();
+     beginResetModel();
+     if (row > currentConnection->getNumRows()) {
          int start = currentConnection->getNumRows();
          currentConnection->setNumRows(row);
          // and fill in extra rows
          for (int i = start; i < currentConnection->getNumRows(); ++i)
              for (int j = 0; j < currentConnection->getNumCols(); ++j)
                 currentConnection->setData(this->createIndex(i,j), 0);
-
-         endInsertRows();
-         setSpinBoxVal(currentConnection->getNumRows());
-     }
-     if (row < currentConnection->getNumRows()) {
-         beginRemoveRows(this->createIndex(currentConnection->getNumRows()-1, 0).parent(),row, currentConnection->getNumRows()-1);
-
+     } else {
          currentConnection->setNumRows(row);
-
-         endRemoveRows();
-         setSpinBoxVal(currentConnection->getNumRows());
      }
+     this->fetchedRows = allShown ? row : qMin(this->fetchedRows, row);
+     endResetModel();
+     setSpinBoxVal(currentConnection->getNumRows());
 
      return true;
 
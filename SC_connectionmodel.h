@@ -45,9 +45,16 @@ public:
     Qt::ItemFlags flags(const QModelIndex & /*index*/) const;
     bool insertConnRows(int);
     void emitDataChanged();
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
 
 private:
     csv_connection * currentConnection;
+    // the rows shown so far; the empty row for adding a connection
+    // follows them once the whole list is shown. The rows are read from
+    // the memory mapped backing store as they are drawn
+    int fetchedRows;
+    int listRows() const;
 
 signals:
     void editCompleted(const QString &);
@@ -0,0 +1,104 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_counterrandom.h"
+
+namespace {
+
+const quint32 philoxMultiplier = 0xD256D193u;
+const quint32 philoxWeyl = 0x9E3779B9u;
+
+// Philox 2x32 with 10 rounds of the counter (ctr0, ctr1) under key
+inline void philox(quint32 key, quint32 &ctr0, quint32 &ctr1)
+{
+    for (int round = 0; round < 10; ++round) {
+        quint64 product = quint64(philoxMultiplier) * ctr0;
+        quint32 hi = quint32(product >> 32);
+        quint32 lo = quint32(product);
+        ctr0 = hi ^ key ^ ctr1;
+        ctr1 = lo;
+        key += philoxWeyl;
+    }
+}
+
+// top 24 bits give a float in [0,1)
+inline float uniformOf(quint32 bits)
+{
+    return float(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+} // namespace
+
+quint32 counterRandomKey(quint32 seed, quint32 object)
+{
+    if (object == 0) {
+        return seed;
+    }
+    // the object counted under the seed, so that nearby objects get
+    // unrelated keys
+    quint32 ctr0 = object;
+    quint32 ctr1 = 0xFFFFFFFFu;
+    philox(seed, ctr0, ctr1);
+    return ctr0;
+}
+
+float counterRandomUniform(counterRandom * state)
+{
+    // keyed on the seed, counting over (index, counter)
+    quint32 ctr0 = state->index;
+    quint32 ctr1 = state->counter++;
+    philox(state->seed, ctr0, ctr1);
+    return uniformOf(ctr0);
+}
+
+void counterRandomUniformBlock(counterRandom * states, int n, float * out)
+{
+    for (int first = 0; first < n; first += COUNTER_RANDOM_LANES) {
+        int m = qMin(COUNTER_RANDOM_LANES, n - first);
+        quint32 ctr0[COUNTER_RANDOM_LANES];
+        quint32 ctr1[COUNTER_RANDOM_LANES];
+        quint32 key[COUNTER_RANDOM_LANES];
+        for (int j = 0; j < m; ++j) {
+            ctr0[j] = states[first + j].index;
+            ctr1[j] = states[first + j].counter++;
+            key[j] = states[first + j].seed;
+        }
+
+        // the rounds of every lane at once, with no branches between them
+        for (int round = 0; round < 10; ++round) {
+            for (int j = 0; j < m; ++j) {
+                quint64 product = quint64(philoxMultiplier) * ctr0[j];
+                quint32 lo = quint32(product);
+                ctr0[j] = quint32(product >> 32) ^ key[j] ^ ctr1[j];
+                ctr1[j] = lo;
+                key[j] += philoxWeyl;
+            }
+        }
+
+        for (int j = 0; j < m; ++j) {
+            out[first + j] = uniformOf(ctr0[j]);
+        }
+    }
+}
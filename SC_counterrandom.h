@@ -0,0 +1,69 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_COUNTERRANDOM_H
+#define SC_COUNTERRANDOM_H
+
+#include <QtGlobal>
+
+/*!
+ * Counter based random numbers, shared by the layouts, the fixed
+ * probability and kernel connections and their previews in the 3D view.
+ * Each draw is a pure function of (key, index, counter), Philox 2x32 with
+ * 10 rounds, so the work can be split across threads, or done in any
+ * order, and still give the serial result bit for bit.
+ *
+ * The key is the object's seed; objects which share a seed but must not
+ * share their numbers take counterRandomKey(seed, object). The index is
+ * the neuron, or the row of a connection, and the counter counts the
+ * draws made for it.
+ */
+struct counterRandom {
+    quint32 seed;
+    quint32 index;
+    quint32 counter;
+};
+
+// the lanes of counterRandomUniformBlock computed side by side
+#define COUNTER_RANDOM_LANES 16
+
+/*!
+ * The key for numbers of object drawn from seed. Object 0 keeps the seed
+ * as it is, as the connections and layouts use it.
+ */
+quint32 counterRandomKey(quint32 seed, quint32 object);
+
+/*!
+ * The next number of state, in [0,1).
+ */
+float counterRandomUniform(counterRandom * state);
+
+/*!
+ * As counterRandomUniform for each of the n states, into out, the lanes
+ * computed together so that the compiler can vectorise them.
+ */
+void counterRandomUniformBlock(counterRandom * states, int n, float * out);
+
+#endif // SC_COUNTERRANDOM_H
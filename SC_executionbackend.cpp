@@ -0,0 +1,298 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_executionbackend.h"
+
+namespace {
+    // quoted for a POSIX shell
+    QString q(const QString &s)
+    {
+        QString quoted = s;
+        quoted.replace("'", "'\\''");
+        return "'" + quoted + "'";
+    }
+}
+
+executionBackend::executionBackend(const QString &simName, QObject *parent) :
+    QObject(parent)
+{
+    QSettings settings;
+    settings.beginGroup("simulators/" + simName);
+    QString typeName = settings.value("backend/type", "local").toString().toLower();
+    if (typeName == "ssh") {
+        this->type = sshBackend;
+    } else if (typeName == "slurm") {
+        this->type = slurmBackend;
+    } else if (typeName == "pbs") {
+        this->type = pbsBackend;
+    } else {
+        this->type = localBackend;
+    }
+    this->host = settings.value("backend/host").toString();
+    this->sshOptions = settings.value("backend/sshOptions").toString().split(" ", QString::SkipEmptyParts);
+    this->remoteDir = settings.value("backend/remoteDir").toString();
+    this->remotePath = settings.value("backend/remotePath", settings.value("path")).toString();
+    this->remoteWorkingDir = settings.value("backend/remoteWorkingDir", settings.value("working_dir")).toString();
+    this->submitOptions = settings.value("backend/submitOptions").toString();
+    settings.beginGroup("envVar");
+    QStringList keys = settings.childKeys();
+    for (int i = 0; i < keys.size(); ++i) {
+        this->envVars[keys[i]] = settings.value(keys[i]).toString();
+    }
+    settings.endGroup();
+    settings.endGroup();
+
+    this->progressReader = (QProcess *) 0;
+    connect(&this->progressTimer, SIGNAL(timeout()), this, SLOT(pollProgress()));
+}
+
+QString executionBackend::describe() const
+{
+    switch (this->type) {
+    case sshBackend:
+        return this->host + " (ssh)";
+    case slurmBackend:
+        return this->host + " (SLURM)";
+    case pbsBackend:
+        return this->host + " (PBS)";
+    default:
+        return "this computer";
+    }
+}
+
+QStringList executionBackend::sshArgs() const
+{
+    // never wait on a password prompt nobody can see
+    QStringList args;
+    args << "-o" << "BatchMode=yes" << this->sshOptions;
+    return args;
+}
+
+QString executionBackend::remoteOutDir() const
+{
+    return this->remoteDir + "/" + this->runName + "/out";
+}
+
+bool executionBackend::prepare(const QString &modelDir, const QString &outDir, int exptNum, bool rebuild,
+                               const QString &runName, QString &program, QStringList &args, QString &error)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(modelDir); Q_UNUSED(outDir); Q_UNUSED(exptNum); Q_UNUSED(rebuild);
+    Q_UNUSED(runName); Q_UNUSED(program); Q_UNUSED(args);
+    error = "Running the simulator on " + this->describe() + " needs a POSIX shell, so is not supported on Windows.";
+    return false;
+#else
+    if (this->host.isEmpty()) {
+        error = "No backend/host is set for running the simulator remotely.";
+        return false;
+    }
+    if (!this->remoteDir.startsWith("/") || !this->remoteWorkingDir.startsWith("/")) {
+        error = "backend/remoteDir and backend/remoteWorkingDir must be absolute directories on " + this->host + ".";
+        return false;
+    }
+    this->runName = runName;
+    QString store = this->remoteDir + "/store";
+    QString remoteModel = this->remoteDir + "/" + runName + "/model";
+    QString remoteOut = this->remoteOutDir();
+
+    // what the host has been sent already
+    QProcess list;
+    list.start("ssh", this->sshArgs() << this->host << "mkdir -p " + q(store) + " && ls " + q(store));
+    if (!list.waitForFinished(REMOTE_LIST_TIMEOUT_MS) || list.exitStatus() != QProcess::NormalExit || list.exitCode() != 0) {
+        error = "Could not reach " + this->host + ": " + QString::fromLocal8Bit(list.readAllStandardError());
+        list.kill();
+        return false;
+    }
+    QSet <QString> present;
+    QStringList listed = QString::fromLocal8Bit(list.readAllStandardOutput()).split("\n", QString::SkipEmptyParts);
+    for (int i = 0; i < listed.size(); ++i) {
+        present.insert(listed[i].trimmed());
+    }
+
+    // the files it doesn't have are sent under the name of their content
+    QDir out(outDir);
+    QDir upload(out.absoluteFilePath("upload"));
+    if (!QDir().mkpath(upload.absolutePath()) || !QDir().mkpath(out.absoluteFilePath("log"))) {
+        error = "Could not create the output directory '" + outDir + "'.";
+        return false;
+    }
+    QStringList stale = upload.entryList(QDir::Files | QDir::System);
+    for (int i = 0; i < stale.size(); ++i) {
+        upload.remove(stale[i]);
+    }
+
+    QDir model(modelDir);
+    QStringList files = model.entryList(QDir::Files, QDir::Name);
+    QStringList sends;
+    QStringList links;
+    for (int i = 0; i < files.size(); ++i) {
+        QString filePath = model.absoluteFilePath(files[i]);
+        QString hash(this->hashes.hashOfFile(filePath).toHex());
+        if (!present.contains(hash)) {
+            present.insert(hash);
+            if (!QFile::link(QFileInfo(filePath).canonicalFilePath(), upload.absoluteFilePath(hash))) {
+                error = "Could not stage '" + files[i] + "' to be sent to " + this->host + ".";
+                return false;
+            }
+            sends << q(upload.absoluteFilePath(hash));
+        }
+        links << "ln -f " + q(store + "/" + hash) + " " + q(remoteModel + "/" + files[i]);
+    }
+
+    // the simulator, run as it would be here
+    QString simCommand = "cd " + q(this->remoteWorkingDir) + " && ";
+    QMap <QString, QString>::const_iterator env = this->envVars.constBegin();
+    for (; env != this->envVars.constEnd(); ++env) {
+        simCommand += "export " + env.key() + "=" + q(env.value()) + "; ";
+    }
+    // remotePath may be a command with arguments, such as "python script.py"
+    simCommand += this->remotePath + " -m " + q(remoteModel) + " -w " + q(this->remoteWorkingDir)
+            + " -o " + q(remoteOut) + " -e " + QString::number(exptNum) + (rebuild ? " -r" : "");
+
+    QString setup = "mkdir -p " + q(remoteModel) + " " + q(remoteOut + "/model") + " " + q(remoteOut + "/log")
+            + " && rm -f " + q(remoteModel) + "/* " + q(remoteOut + "/model/stop.txt") + " " + q(remoteOut + "/model/time.txt")
+            + " " + q(remoteOut) + "/log/*";
+    if (!links.isEmpty()) {
+        setup += " && " + links.join(" && ");
+    }
+
+    QString run;
+    QString jobFile;
+    if (this->type == sshBackend) {
+        run = simCommand;
+    } else {
+        // the batch systems run a job script, sent with the model
+        jobFile = out.absoluteFilePath(REMOTE_JOB_SCRIPT);
+        QFile job(jobFile);
+        if (!job.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            error = "Could not write the job script '" + jobFile + "'.";
+            return false;
+        }
+        job.write(("#!/bin/sh\n" + simCommand + "\n").toLocal8Bit());
+        job.close();
+        if (this->type == slurmBackend) {
+            run = "cd " + q(remoteOut) + " && sbatch --wait -J spinecreator -o stdout.txt -e stderr.txt "
+                    + this->submitOptions + " " + REMOTE_JOB_SCRIPT;
+        } else {
+            run = "cd " + q(remoteOut) + " && qsub -W block=true -N spinecreator -o " + q(remoteOut + "/stdout.txt")
+                    + " -e " + q(remoteOut + "/stderr.txt") + " " + this->submitOptions + " " + REMOTE_JOB_SCRIPT;
+        }
+        // the job's output only comes back once it has finished
+        run += "; rc=$?; cat stdout.txt; cat stderr.txt >&2; exit $rc";
+    }
+
+    QString ssh = "ssh";
+    QString scp = "scp -q";
+    QStringList opts = this->sshArgs();
+    for (int i = 0; i < opts.size(); ++i) {
+        ssh += " " + q(opts[i]);
+        scp += " " + q(opts[i]);
+    }
+    QString target = q(this->host);
+
+    QStringList script;
+    if (!sends.isEmpty()) {
+        script << scp + " " + sends.join(" ") + " " + q(this->host + ":" + store + "/") + " &&";
+    }
+    script << ssh + " " + target + " " + q(setup) + " &&";
+    if (!jobFile.isEmpty()) {
+        script << scp + " " + q(jobFile) + " " + q(this->host + ":" + remoteOut + "/") + " &&";
+    }
+    script << ssh + " " + target + " " + q(run);
+    script << "rc=$?";
+    // the logs, whether or not the run finished cleanly
+    script << scp + " -r " + q(this->host + ":" + remoteOut + "/log/*") + " " + q(out.absoluteFilePath("log") + "/") + " 2>/dev/null";
+    script << "rm -rf " + q(upload.absolutePath());
+    script << "exit $rc";
+
+    program = "/bin/sh";
+    args.clear();
+    args << "-c" << script.join("\n");
+    DBG() << "Running on" << this->describe() << "sending" << sends.size() << "of" << files.size() << "model files";
+    return true;
+#endif
+}
+
+void executionBackend::followProgress(const QString &localTimeFile)
+{
+    this->localTimeFile = localTimeFile;
+    this->lastProgress.clear();
+    this->progressTimer.start(REMOTE_PROGRESS_POLL_MS);
+}
+
+void executionBackend::pollProgress()
+{
+    // one read at a time, however slow the host is
+    if (this->progressReader) {
+        return;
+    }
+    this->progressReader = new QProcess(this);
+    connect(this->progressReader, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(progressRead(int,QProcess::ExitStatus)));
+    this->progressReader->start("ssh", this->sshArgs() << this->host << "cat " + q(this->remoteOutDir() + "/model/time.txt"));
+}
+
+void executionBackend::progressRead(int exitCode, QProcess::ExitStatus status)
+{
+    QProcess * reader = this->progressReader;
+    this->progressReader = (QProcess *) 0;
+    if (!reader) {
+        return;
+    }
+    reader->deleteLater();
+    if (status != QProcess::NormalExit || exitCode != 0 || this->localTimeFile.isEmpty()) {
+        return;
+    }
+    QByteArray progress = reader->readAllStandardOutput();
+    if (progress.isEmpty() || progress == this->lastProgress) {
+        return;
+    }
+    this->lastProgress = progress;
+
+    // where the local simulator would have written it, to be picked up there
+    QDir().mkpath(QFileInfo(this->localTimeFile).absolutePath());
+    QFile f(this->localTimeFile);
+    if (f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        f.write(progress);
+    }
+}
+
+void executionBackend::cancel()
+{
+    if (this->isLocal() || this->runName.isEmpty()) {
+        return;
+    }
+    QProcess::startDetached("ssh", this->sshArgs() << this->host << "touch " + q(this->remoteOutDir() + "/model/stop.txt"));
+}
+
+void executionBackend::runFinished()
+{
+    this->progressTimer.stop();
+    if (this->progressReader) {
+        this->progressReader->disconnect(this);
+        this->progressReader->kill();
+        this->progressReader->deleteLater();
+        this->progressReader = (QProcess *) 0;
+    }
+}
@@ -0,0 +1,133 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_EXECUTIONBACKEND_H
+#define SC_EXECUTIONBACKEND_H
+
+#include "globalHeader.h"
+#include "SC_runcache.h"
+#include <QProcess>
+
+// the remote time file is copied back this often (ms) while a run goes on
+#define REMOTE_PROGRESS_POLL_MS 2000
+// how long (ms) the remote store may take to list what it holds
+#define REMOTE_LIST_TIMEOUT_MS 30000
+// the job script written for the batch systems, sent with the model
+#define REMOTE_JOB_SCRIPT "spinecreator_job.sh"
+
+/*!
+ * \brief The executionBackend class says where the simulator for an
+ * experiment runs: as a local process, which is the default, or on another
+ * machine reached over ssh, either directly or through a SLURM or PBS
+ * submission made there. It is set up from the settings of the simulator:
+ *
+ *   simulators/<name>/backend/type           local, ssh, slurm or pbs
+ *   simulators/<name>/backend/host           [user@]host, as given to ssh
+ *   simulators/<name>/backend/sshOptions     more options for ssh and scp
+ *   simulators/<name>/backend/remoteDir      an absolute directory on host
+ *   simulators/<name>/backend/remotePath     the convert_script on host
+ *                                            (by default path)
+ *   simulators/<name>/backend/remoteWorkingDir  (by default working_dir)
+ *   simulators/<name>/backend/submitOptions  more options for sbatch/qsub
+ *
+ * A remote run is a local /bin/sh process, so it is started, followed and
+ * ended just as a local simulator is. It sends the model files the host
+ * does not have yet into a store under remoteDir named by their SHA-1, so
+ * an unchanged file is only ever sent once, links them into the run's model
+ * directory there, runs the convert_script (for the batch systems, submits
+ * a job and waits for it), and copies the logs back into the local output
+ * directory. The simulator's output comes back on the process's standard
+ * output and error, and its time file is copied back as it changes, so the
+ * progress is shown as for a local run.
+ */
+class executionBackend : public QObject
+{
+    Q_OBJECT
+public:
+    enum backendType {
+        localBackend,
+        sshBackend,
+        slurmBackend,
+        pbsBackend
+    };
+
+    explicit executionBackend(const QString &simName, QObject *parent = 0);
+
+    bool isLocal() const {return type == localBackend;}
+    // for messages, such as "user@host (SLURM)"
+    QString describe() const;
+
+    /*!
+     * Set program and args to the local command which runs experiment
+     * exptNum of the model in modelDir on the host, under remoteDir/runName,
+     * leaving its logs in outDir/log. Only for a remote backend; returns
+     * false, with the reason in error, if the run can't be made.
+     */
+    bool prepare(const QString &modelDir, const QString &outDir, int exptNum, bool rebuild,
+                 const QString &runName, QString &program, QStringList &args, QString &error);
+
+    /*!
+     * Copy the run's time file back to localTimeFile every
+     * REMOTE_PROGRESS_POLL_MS until runFinished().
+     */
+    void followProgress(const QString &localTimeFile);
+
+    /*!
+     * Ask the simulator on the host to stop, as with a local stop file.
+     */
+    void cancel();
+
+    /*!
+     * Called once the command from prepare() has finished.
+     */
+    void runFinished();
+
+private slots:
+    void pollProgress();
+    void progressRead(int exitCode, QProcess::ExitStatus status);
+
+private:
+    QStringList sshArgs() const;
+    QString remoteOutDir() const;
+
+    backendType type;
+    QString host;
+    QStringList sshOptions;
+    QString remoteDir;
+    QString remotePath;
+    QString remoteWorkingDir;
+    QString submitOptions;
+    // the simulator's environment variables, from simulators/<name>/envVar
+    QMap <QString, QString> envVars;
+
+    QString runName;
+    QString localTimeFile;
+    QTimer progressTimer;
+    QProcess * progressReader;
+    QByteArray lastProgress;
+    runResultCache hashes;
+};
+
+#endif // SC_EXECUTIONBACKEND_H
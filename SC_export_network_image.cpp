@@ -27,6 +27,145 @@
 #include "SC_network_layer_rootdata.h"
 #include "SC_network_3d_visualiser_panel.h"
 
+namespace {
+
+/*!
+ * Writes an RGBA TIFF a tile at a time, each tile Deflate compressed as it
+ * is written, so that only one tile of the image is ever held. Tiles are
+ * EXPORT_TILE_SIZE square and are given in rows from the top left; those on
+ * the right and bottom edges are cropped by readers.
+ */
+class tiledTiffWriter
+{
+public:
+    bool open(const QString &fileName, QSize size, QString &error)
+    {
+        if (size.isEmpty()) {
+            error = "The image would be empty.";
+            return false;
+        }
+        this->size = size;
+        this->file.setFileName(fileName);
+        if (!this->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            error = "Could not open '" + fileName + "' for writing.";
+            return false;
+        }
+        this->out.setDevice(&this->file);
+        this->out.setByteOrder(QDataStream::LittleEndian);
+        // the offset of the directory is filled in by finish()
+        this->out.writeRawData("II", 2);
+        this->out << quint16(42) << quint32(0);
+        return true;
+    }
+
+    bool writeTile(const QImage &tile, QString &error)
+    {
+        QImage argb = tile.convertToFormat(QImage::Format_ARGB32);
+        QByteArray raw(EXPORT_TILE_SIZE * EXPORT_TILE_SIZE * 4, 0);
+        uchar * dst = (uchar *) raw.data();
+        for (int y = 0; y < argb.height() && y < EXPORT_TILE_SIZE; ++y) {
+            const QRgb * src = (const QRgb *) argb.constScanLine(y);
+            uchar * row = dst + y * EXPORT_TILE_SIZE * 4;
+            for (int x = 0; x < argb.width() && x < EXPORT_TILE_SIZE; ++x) {
+                row[4*x] = qRed(src[x]);
+                row[4*x+1] = qGreen(src[x]);
+                row[4*x+2] = qBlue(src[x]);
+                row[4*x+3] = qAlpha(src[x]);
+            }
+        }
+
+        // qCompress() gives a zlib stream after a four byte length, and the
+        // zlib stream is what TIFF Deflate compression holds
+        QByteArray packed = qCompress(raw).mid(4);
+        if (this->file.pos() + packed.size() + 1 > Q_INT64_C(0xffffffff)) {
+            error = "The image is too large for a TIFF file; try a PNG, or a smaller scale.";
+            return false;
+        }
+        this->offsets.push_back(quint32(this->file.pos()));
+        this->counts.push_back(quint32(packed.size()));
+        this->out.writeRawData(packed.constData(), packed.size());
+        this->align();
+        return this->check(error);
+    }
+
+    bool finish(QString &error)
+    {
+        int tiles = this->offsets.size();
+        quint32 bitsAt = quint32(this->file.pos());
+        this->out << quint16(8) << quint16(8) << quint16(8) << quint16(8);
+        quint32 offsetsAt = this->offsets[0];
+        quint32 countsAt = this->counts[0];
+        if (tiles > 1) {
+            offsetsAt = quint32(this->file.pos());
+            for (int i = 0; i < tiles; ++i) {
+                this->out << this->offsets[i];
+            }
+            countsAt = quint32(this->file.pos());
+            for (int i = 0; i < tiles; ++i) {
+                this->out << this->counts[i];
+            }
+        }
+
+        quint32 directoryAt = quint32(this->file.pos());
+        this->out << quint16(12);
+        this->entry(256, TIFF_LONG, 1, this->size.width());     // ImageWidth
+        this->entry(257, TIFF_LONG, 1, this->size.height());    // ImageLength
+        this->entry(258, TIFF_SHORT, 4, bitsAt);                // BitsPerSample
+        this->entry(259, TIFF_SHORT, 1, 8);                     // Compression: Deflate
+        this->entry(262, TIFF_SHORT, 1, 2);                     // Photometric: RGB
+        this->entry(277, TIFF_SHORT, 1, 4);                     // SamplesPerPixel
+        this->entry(284, TIFF_SHORT, 1, 1);                     // PlanarConfiguration: chunky
+        this->entry(322, TIFF_LONG, 1, EXPORT_TILE_SIZE);       // TileWidth
+        this->entry(323, TIFF_LONG, 1, EXPORT_TILE_SIZE);       // TileLength
+        this->entry(324, TIFF_LONG, tiles, offsetsAt);          // TileOffsets
+        this->entry(325, TIFF_LONG, tiles, countsAt);           // TileByteCounts
+        this->entry(338, TIFF_SHORT, 1, 2);                     // ExtraSamples: unassociated alpha
+        this->out << quint32(0);
+
+        this->file.seek(4);
+        this->out << directoryAt;
+        if (!this->check(error)) {
+            return false;
+        }
+        this->file.close();
+        return true;
+    }
+
+private:
+    enum { TIFF_SHORT = 3, TIFF_LONG = 4 };
+
+    void entry(quint16 tag, quint16 type, quint32 count, quint32 value)
+    {
+        // a single SHORT sits in the low bytes of the value field
+        this->out << tag << type << count << value;
+    }
+
+    void align()
+    {
+        // offsets in a TIFF file should be even
+        if (this->file.pos() % 2) {
+            this->out << quint8(0);
+        }
+    }
+
+    bool check(QString &error)
+    {
+        if (this->out.status() != QDataStream::Ok) {
+            error = "Could not write to '" + this->file.fileName() + "'.";
+            return false;
+        }
+        return true;
+    }
+
+    QFile file;
+    QDataStream out;
+    QSize size;
+    QVector <quint32> offsets;
+    QVector <quint32> counts;
+};
+
+} // namespace
+
 saveNetworkImageDialog::saveNetworkImageDialog(nl_rootdata * data, QString fileName, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::saveNetworkImageDialog)
@@ -62,7 +201,7 @@ saveNetworkImageDialog::saveNetworkImageDialog(nl_rootdata * data, QString fileN
     // setup listView
 
     // setup preview
-    QPixmap pix = drawPixMap();
+    QPixmap pix = QPixmap::fromImage(drawImage());
 
     // width and height:
     ui->height_label->setText("Height = " + QString::number(pix.height()));
@@ -145,7 +284,7 @@ void saveNetworkImageDialog::reDrawPreview()
     if (height > 0)
         pix = drawPixMapVis();
     else {
-        pix = drawPixMap();
+        pix = QPixmap::fromImage(drawImage());
         ui->height_label->setText("Height = " + QString::number(pix.height()));
         ui->width_label->setText("Width = " + QString::number(pix.width()));
     }
@@ -230,36 +369,154 @@ void saveNetworkImageDialog::setupPainter (QPainter* painter)
     painter->setFont(font);
 }
 
-QPixmap saveNetworkImageDialog::drawPixMap()
+QSize saveNetworkImageDialog::imageSize (const QRectF& bounds)
+{
+    return QSize(bounds.width()*100*scale, bounds.height()*100*scale);
+}
+
+void saveNetworkImageDialog::indexDrawables (QVector <QSharedPointer<systemObject> >& list,
+                                             const QRectF& bounds, sceneIndex& index)
+{
+    index.clear();
+    for (int i = 0; i < list.size(); ++i) {
+        QRectF region = nl_rootdata::sceneBounds(list[i]);
+        if (region.isNull()) {
+            // the bounds are flipped in y; anything else is drawn everywhere
+            region = QRectF(QPointF(bounds.left(), -bounds.bottom()), QPointF(bounds.right(), -bounds.top()));
+        }
+        index.add(region, list[i]);
+    }
+    index.build();
+}
+
+void saveNetworkImageDialog::renderTile (QPainter* painter, const sceneIndex& index,
+                                         const QRectF& bounds, const QRect& tile)
+{
+    QSize size = this->imageSize(bounds);
+    float pixels = 100.0*scale;
+
+    // the model region under the tile, as in nl_rootdata::drawScene() with
+    // room for pen widths; the bounds are flipped in y
+    float pad = 20.0/pixels;
+    float left = bounds.center().x() + (tile.left() - size.width()/2.0)/pixels;
+    float right = bounds.center().x() + (tile.left() + tile.width() - size.width()/2.0)/pixels;
+    float top = bounds.center().y() + (tile.top() - size.height()/2.0)/pixels;
+    float bottom = bounds.center().y() + (tile.top() + tile.height() - size.height()/2.0)/pixels;
+    QRectF region(QPointF(left - pad, -bottom - pad), QPointF(right + pad, -top + pad));
+
+    QVector <int> visible = index.query(region);
+    for (int i = 0; i < visible.size(); ++i) {
+        index.object(visible[i])->draw(painter, 200.0*scale,
+                                       -bounds.center().x(), -bounds.center().y(), size.width(),
+                                       size.height(), data->popImage, this->style);
+    }
+}
+
+QImage saveNetworkImageDialog::drawImage()
 {
     QVector <QSharedPointer<systemObject> > list = this->getDrawableList();
     QRectF bounds = this->calculateBoundingBox (list);
-    QPixmap outPix(bounds.width()*100*scale, bounds.height()*100*scale);
+    QImage outIm(this->imageSize(bounds), QImage::Format_ARGB32_Premultiplied);
+    if (outIm.isNull()) {
+        QMessageBox::warning(this, QString("Image too large"),
+                             QString("There is not enough memory for an image this size. "
+                                     "Please reduce the scale, or save the image as a TIFF."));
+        return outIm;
+    }
 
     if (ui->checkBox->isChecked()) {
-        outPix.fill(Qt::transparent);
+        outIm.fill(Qt::transparent);
     } else {
-        outPix.fill();// white
+        outIm.fill(Qt::white);
     }
 
     if (list.empty()) {
         // User hasn't made a selection, so open a dialog to hint that
         // a selection is required for an image. (tested here so that
-        // we can return a null QPixmap)
+        // we can return a blank image)
         QMessageBox::warning(this, QString("No populations selected"),
                              QString("The image will be blank as no populations have been selected. "
                                      "Please select at least one population for the image."));
 
-        return outPix;
+        return outIm;
     }
 
-    QPainter *painter = new QPainter(&outPix);
+    sceneIndex index;
+    this->indexDrawables (list, bounds, index);
+
+    // draw a tile at a time, clipped, so that each object is only drawn
+    // where it is seen
+    QPainter *painter = new QPainter(&outIm);
     this->setupPainter (painter);
-    this->renderDrawables (painter, list, bounds);
+    for (int y = 0; y < outIm.height(); y += EXPORT_TILE_SIZE) {
+        for (int x = 0; x < outIm.width(); x += EXPORT_TILE_SIZE) {
+            QRect tile(x, y, EXPORT_TILE_SIZE, EXPORT_TILE_SIZE);
+            painter->setClipRect(tile);
+            this->renderTile (painter, index, bounds, tile);
+        }
+    }
     painter->end();
     delete painter;
 
-    return outPix;
+    return outIm;
+}
+
+bool saveNetworkImageDialog::saveTIFF(QString& error)
+{
+    tiledTiffWriter writer;
+    QImage tile(EXPORT_TILE_SIZE, EXPORT_TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+
+    if (height > 0) {
+        // the visualiser is rendered whole by GL, then written in tiles
+        QImage image = drawPixMapVis().toImage();
+        if (!writer.open(this->fileName, image.size(), error)) {
+            return false;
+        }
+        for (int y = 0; y < image.height(); y += EXPORT_TILE_SIZE) {
+            for (int x = 0; x < image.width(); x += EXPORT_TILE_SIZE) {
+                if (!writer.writeTile(image.copy(x, y, EXPORT_TILE_SIZE, EXPORT_TILE_SIZE), error)) {
+                    return false;
+                }
+            }
+        }
+        return writer.finish(error);
+    }
+
+    QVector <QSharedPointer<systemObject> > list = this->getDrawableList();
+    if (list.empty()) {
+        error = "No populations have been selected. Please select at least one population for the image.";
+        return false;
+    }
+    QRectF bounds = this->calculateBoundingBox (list);
+    QSize size = this->imageSize(bounds);
+
+    sceneIndex index;
+    this->indexDrawables (list, bounds, index);
+    if (!writer.open(this->fileName, size, error)) {
+        return false;
+    }
+
+    // each tile is drawn on its own with the painter moved so that the
+    // tile's corner is at its origin
+    for (int y = 0; y < size.height(); y += EXPORT_TILE_SIZE) {
+        for (int x = 0; x < size.width(); x += EXPORT_TILE_SIZE) {
+            if (ui->checkBox->isChecked()) {
+                tile.fill(Qt::transparent);
+            } else {
+                tile.fill(Qt::white);
+            }
+            QPainter *painter = new QPainter(&tile);
+            this->setupPainter (painter);
+            painter->translate(-x, -y);
+            this->renderTile (painter, index, bounds, QRect(x, y, EXPORT_TILE_SIZE, EXPORT_TILE_SIZE));
+            painter->end();
+            delete painter;
+            if (!writer.writeTile(tile, error)) {
+                return false;
+            }
+        }
+    }
+    return writer.finish(error);
 }
 
 QVector <QSharedPointer<systemObject> >
@@ -360,7 +617,7 @@ void saveNetworkImageDialog::changeDrawStyle(int index)
 
 void saveNetworkImageDialog::save()
 {
-    this->fileName = QFileDialog::getSaveFileName(this, tr("Export As Image"), qgetenv("HOME"), tr("SVG (*.svg);;PNG (*.png)"));
+    this->fileName = QFileDialog::getSaveFileName(this, tr("Export As Image"), qgetenv("HOME"), tr("SVG (*.svg);;PNG (*.png);;TIFF (*.tif *.tiff)"));
 
     if (this->fileName.isEmpty()) {
         return;
@@ -368,15 +625,23 @@ void saveNetworkImageDialog::save()
 
     if (fileName.endsWith("png", Qt::CaseInsensitive)) {
         // PNG Save
-        QPixmap pix;
+        QImage outIm;
         if (height > 0) {
-            pix = drawPixMapVis();
+            outIm = drawPixMapVis().toImage();
         } else {
-            pix = drawPixMap();
+            outIm = drawImage();
+        }
+
+        if (!outIm.isNull()) {
+            outIm.save(fileName,"png");
         }
 
-        QImage outIm = pix.toImage();
-        outIm.save(fileName,"png");
+    } else if (fileName.endsWith("tif", Qt::CaseInsensitive) || fileName.endsWith("tiff", Qt::CaseInsensitive)) {
+        // TIFF Save, a tile at a time
+        QString error;
+        if (!this->saveTIFF(error)) {
+            QMessageBox::warning(this, QString("Image not saved"), error);
+        }
 
     } else {
         // SVG Save by default
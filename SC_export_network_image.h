@@ -28,6 +28,12 @@
 #include <QDialog>
 #include "globalHeader.h"
 #include <QSvgGenerator>
+#include "SC_network_2d_sceneindex.h"
+
+// raster exports are drawn a square of this many pixels at a time, only the
+// objects in each square being drawn into it; TIFF files are written a tile
+// at a time, so this bounds the memory they need whatever the image size
+#define EXPORT_TILE_SIZE 1024
 
 namespace Ui {
 class saveNetworkImageDialog;
@@ -49,7 +55,7 @@ private:
     /*!
      * A sorting algorithm for a list of system objects. This orders
      * the members so that projections are drawn upon populations and
-     * generic inputs are drawn upon everything. Used in drawPixMap().
+     * generic inputs are drawn upon everything. Used in drawImage().
      */
     static bool drawOrderLessThan (const QSharedPointer<systemObject>& o1,
                                    const QSharedPointer<systemObject>& o2);
@@ -79,8 +85,28 @@ private:
                           QVector <QSharedPointer<systemObject> >& list,
                           const QRectF& bounds);
 
+    /*!
+     * The size in pixels of the image of the objects within bounds.
+     */
+    QSize imageSize (const QRectF& bounds);
+
+    /*!
+     * Index the drawables by the region each draws, in drawing order, so
+     * that a tile is drawn with just the objects which may touch it.
+     */
+    void indexDrawables (QVector <QSharedPointer<systemObject> >& list,
+                         const QRectF& bounds, sceneIndex& index);
+
+    /*!
+     * Draw the indexed objects which may touch tile (in pixels of the whole
+     * image) with the painter's origin at the top left of the whole image.
+     */
+    void renderTile (QPainter* painter, const sceneIndex& index,
+                     const QRectF& bounds, const QRect& tile);
+
     void drawSVG(QSvgGenerator& svg);
-    QPixmap drawPixMap();
+    QImage drawImage();
+    bool saveTIFF(QString& error);
     QPixmap drawPixMapVis();
     float scale;
     float border;
@@ -0,0 +1,558 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_hdf5store.h"
+#include "SC_projectobject.h"
+#include "SC_logged_data.h"
+#include "NL_connection.h"
+#include "NL_population.h"
+#include "NL_projection_and_synapse.h"
+#include "NL_genericinput.h"
+#include "CL_classes.h"
+
+#ifdef USE_HDF5
+#include <hdf5.h>
+#endif
+
+#ifdef USE_HDF5
+
+namespace {
+
+struct namedConnection {
+    QString name;
+    csv_connection * conn;
+};
+
+struct namedProperty {
+    QString component;
+    ParameterInstance * par;
+};
+
+// '/' would nest the name in groups
+QString storeName(QString name)
+{
+    return name.replace('/', '_');
+}
+
+void collectComponent(QSharedPointer <ComponentInstance> cmpt, QVector <namedProperty> &props)
+{
+    if (cmpt.isNull()) {
+        return;
+    }
+    QString name = storeName(cmpt->getXMLName());
+    for (int i = 0; i < cmpt->ParameterList.size(); ++i) {
+        namedProperty prop = {name, cmpt->ParameterList[i]};
+        props.push_back(prop);
+    }
+    for (int i = 0; i < cmpt->StateVariableList.size(); ++i) {
+        namedProperty prop = {name, cmpt->StateVariableList[i]};
+        props.push_back(prop);
+    }
+}
+
+/*!
+ * The explicit connections of the project, as projectObject::getExplicitConnections
+ * finds them, and the properties of all its components, with their names
+ * in the store.
+ */
+void collectProject(projectObject * project, QVector <namedConnection> &conns, QVector <namedProperty> &props)
+{
+    for (int i = 0; i < project->network.size(); ++i) {
+
+        QSharedPointer <population> pop = project->network[i];
+        collectComponent(pop->neuronType, props);
+        QVector < QSharedPointer<genericInput> > inputs = pop->neuronType->inputs;
+
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            for (int k = 0; k < pop->projections[j]->synapses.size(); ++k) {
+                QSharedPointer<synapse> syn = pop->projections[j]->synapses[k];
+                if (syn->connectionType->type == CSV) {
+                    namedConnection conn = {storeName(syn->getName()), (csv_connection *) syn->connectionType};
+                    conns.push_back(conn);
+                }
+                collectComponent(syn->weightUpdateCmpt, props);
+                collectComponent(syn->postSynapseCmpt, props);
+                inputs += syn->weightUpdateCmpt->inputs;
+                inputs += syn->postSynapseCmpt->inputs;
+            }
+        }
+
+        for (int j = 0; j < inputs.size(); ++j) {
+            if (inputs[j]->conn != NULL && inputs[j]->conn->type == CSV) {
+                namedConnection conn = {storeName(inputs[j]->getName()), (csv_connection *) inputs[j]->conn};
+                conns.push_back(conn);
+            }
+        }
+    }
+}
+
+/*!
+ * Closes an HDF5 object when it goes out of scope.
+ */
+class hdf5Handle
+{
+public:
+    hdf5Handle(hid_t id, herr_t (*closeFn)(hid_t)) : id(id), closeFn(closeFn) {}
+    ~hdf5Handle() { if (this->id >= 0) this->closeFn(this->id); }
+    operator hid_t() const { return this->id; }
+    bool isValid() const { return this->id >= 0; }
+
+private:
+    hdf5Handle(const hdf5Handle &);
+    hdf5Handle &operator=(const hdf5Handle &);
+    hid_t id;
+    herr_t (*closeFn)(hid_t);
+};
+
+bool hasLink(hid_t parent, const QString &name)
+{
+    return H5Lexists(parent, name.toUtf8().constData(), H5P_DEFAULT) > 0;
+}
+
+hid_t openGroup(hid_t parent, const QString &name, bool create)
+{
+    QByteArray n = name.toUtf8();
+    if (hasLink(parent, name)) {
+        return H5Gopen2(parent, n.constData(), H5P_DEFAULT);
+    }
+    if (!create) {
+        return -1;
+    }
+    return H5Gcreate2(parent, n.constData(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+}
+
+/*!
+ * Create a chunked, deflated dataset in parent from the n elements of memType
+ * at data, written a block at a time.
+ */
+bool writeArray(hid_t parent, const char * name, hid_t fileType, hid_t memType, const void * data, qint64 n)
+{
+    hsize_t dims[1] = {(hsize_t) n};
+    hdf5Handle space(H5Screate_simple(1, dims, NULL), H5Sclose);
+    hdf5Handle dcpl(H5Pcreate(H5P_DATASET_CREATE), H5Pclose);
+    if (!space.isValid() || !dcpl.isValid()) {
+        return false;
+    }
+    if (n > 0) {
+        hsize_t chunk[1] = {(hsize_t) qMin(n, (qint64) HDF5_CHUNK_ELEMENTS)};
+        H5Pset_chunk(dcpl, 1, chunk);
+        H5Pset_shuffle(dcpl);
+        H5Pset_deflate(dcpl, HDF5_DEFLATE_LEVEL);
+    }
+    hdf5Handle set(H5Dcreate2(parent, name, fileType, space, H5P_DEFAULT, dcpl, H5P_DEFAULT), H5Dclose);
+    if (!set.isValid()) {
+        return false;
+    }
+
+    size_t elementSize = H5Tget_size(memType);
+    for (qint64 first = 0; first < n; first += HDF5_IO_BLOCK) {
+        hsize_t start[1] = {(hsize_t) first};
+        hsize_t count[1] = {(hsize_t) qMin(n - first, (qint64) HDF5_IO_BLOCK)};
+        hdf5Handle memSpace(H5Screate_simple(1, count, NULL), H5Sclose);
+        if (H5Sselect_hyperslab(space, H5S_SELECT_SET, start, NULL, count, NULL) < 0
+            || H5Dwrite(set, memType, memSpace, space, H5P_DEFAULT, (const char *) data + first*elementSize) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * Read the 1D dataset name in parent into out, a block at a time.
+ */
+template <typename T>
+bool readArray(hid_t parent, const char * name, hid_t memType, QVector <T> &out)
+{
+    out.clear();
+    hdf5Handle set(H5Dopen2(parent, name, H5P_DEFAULT), H5Dclose);
+    if (!set.isValid()) {
+        return false;
+    }
+    hdf5Handle space(H5Dget_space(set), H5Sclose);
+    if (!space.isValid() || H5Sget_simple_extent_ndims(space) != 1) {
+        return false;
+    }
+    hsize_t dims[1];
+    H5Sget_simple_extent_dims(space, dims, NULL);
+    if (dims[0] > (hsize_t) std::numeric_limits<int>::max()) {
+        return false;
+    }
+    qint64 n = (qint64) dims[0];
+    out.resize((int) n);
+
+    for (qint64 first = 0; first < n; first += HDF5_IO_BLOCK) {
+        hsize_t start[1] = {(hsize_t) first};
+        hsize_t count[1] = {(hsize_t) qMin(n - first, (qint64) HDF5_IO_BLOCK)};
+        hdf5Handle memSpace(H5Screate_simple(1, count, NULL), H5Sclose);
+        if (H5Sselect_hyperslab(space, H5S_SELECT_SET, start, NULL, count, NULL) < 0
+            || H5Dread(set, memType, memSpace, space, H5P_DEFAULT, out.data() + first) < 0) {
+            out.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeConnection(hid_t parent, const namedConnection &named)
+{
+    connArrays arrays;
+    named.conn->getAllData(arrays);
+
+    hdf5Handle group(openGroup(parent, named.name, true), H5Gclose);
+    if (!group.isValid()) {
+        return false;
+    }
+    if (!writeArray(group, "src", H5T_STD_I32LE, H5T_NATIVE_INT32, arrays.src.constData(), arrays.src.size())
+        || !writeArray(group, "dst", H5T_STD_I32LE, H5T_NATIVE_INT32, arrays.dst.constData(), arrays.dst.size())) {
+        return false;
+    }
+    if (!arrays.delay.isEmpty()
+        && !writeArray(group, "delay", H5T_IEEE_F32LE, H5T_NATIVE_FLOAT, arrays.delay.constData(), arrays.delay.size())) {
+        return false;
+    }
+    return true;
+}
+
+bool readConnection(hid_t parent, const namedConnection &named)
+{
+    hdf5Handle group(openGroup(parent, named.name, false), H5Gclose);
+    if (!group.isValid()) {
+        return false;
+    }
+    connArrays arrays;
+    if (!readArray(group, "src", H5T_NATIVE_INT32, arrays.src)
+        || !readArray(group, "dst", H5T_NATIVE_INT32, arrays.dst)
+        || arrays.src.size() != arrays.dst.size()) {
+        return false;
+    }
+    if (hasLink(group, "delay")) {
+        if (!readArray(group, "delay", H5T_NATIVE_FLOAT, arrays.delay) || arrays.delay.size() != arrays.src.size()) {
+            return false;
+        }
+        if (named.conn->getNumCols() != 3) {
+            named.conn->setNumCols(3);
+        }
+    }
+    named.conn->setAllData(arrays);
+    return true;
+}
+
+bool writeProperty(hid_t parent, const namedProperty &named)
+{
+    hdf5Handle component(openGroup(parent, named.component, true), H5Gclose);
+    if (!component.isValid()) {
+        return false;
+    }
+    hdf5Handle group(openGroup(component, storeName(named.par->name), true), H5Gclose);
+    if (!group.isValid()) {
+        return false;
+    }
+
+    QVector <qint32> indices(named.par->indices.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        indices[i] = named.par->indices[i];
+    }
+    return writeArray(group, "indices", H5T_STD_I32LE, H5T_NATIVE_INT32, indices.constData(), indices.size())
+        && writeArray(group, "values", H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, named.par->value.constData(), named.par->value.size());
+}
+
+bool readProperty(hid_t parent, const namedProperty &named)
+{
+    if (!hasLink(parent, named.component)) {
+        return true;
+    }
+    hdf5Handle component(openGroup(parent, named.component, false), H5Gclose);
+    if (!component.isValid()) {
+        return false;
+    }
+    if (!hasLink(component, storeName(named.par->name))) {
+        return true;
+    }
+    hdf5Handle group(openGroup(component, storeName(named.par->name), false), H5Gclose);
+    if (!group.isValid()) {
+        return false;
+    }
+
+    QVector <qint32> indices;
+    QVector <double> values;
+    if (!readArray(group, "indices", H5T_NATIVE_INT32, indices)
+        || !readArray(group, "values", H5T_NATIVE_DOUBLE, values)
+        || indices.size() != values.size()) {
+        return false;
+    }
+    named.par->indices.resize(indices.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        named.par->indices[i] = indices[i];
+    }
+    named.par->value = values;
+    named.par->currType = ExplicitList;
+    return true;
+}
+
+bool writeLog(hid_t parent, logData * log, QString &error)
+{
+    QString name = storeName(QFileInfo(log->logName).completeBaseName());
+    QByteArray n = name.toUtf8();
+
+    // the space of a replaced log is not reclaimed until the file is repacked
+    if (hasLink(parent, name) && H5Ldelete(parent, n.constData(), H5P_DEFAULT) < 0) {
+        error = "Could not replace the log " + name + ".";
+        return false;
+    }
+    hdf5Handle group(openGroup(parent, name, true), H5Gclose);
+    if (!group.isValid()) {
+        error = "Could not write the log " + name + ".";
+        return false;
+    }
+
+    hdf5Handle scalar(H5Screate(H5S_SCALAR), H5Sclose);
+    hdf5Handle dt(H5Acreate2(group, "dt", H5T_IEEE_F64LE, scalar, H5P_DEFAULT, H5P_DEFAULT), H5Aclose);
+    if (!dt.isValid() || H5Awrite(dt, H5T_NATIVE_DOUBLE, &log->timeStep) < 0) {
+        error = "Could not write the timestep of the log " + name + ".";
+        return false;
+    }
+
+    if (log->dataClass == EVENTDATA) {
+        QVector <double> times;
+        QVector <double> indices;
+        if (!log->getEvents(-Q_INFINITY, Q_INFINITY, times, indices)) {
+            error = "Could not read the log " + name + ".";
+            return false;
+        }
+        QVector <qint32> neurons(indices.size());
+        for (int i = 0; i < indices.size(); ++i) {
+            neurons[i] = (qint32) indices[i];
+        }
+        if (!writeArray(group, "times", H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, times.constData(), times.size())
+            || !writeArray(group, "indices", H5T_STD_I32LE, H5T_NATIVE_INT32, neurons.constData(), neurons.size())) {
+            error = "Could not write the log " + name + ".";
+            return false;
+        }
+        return true;
+    }
+
+    qint64 rows = log->numRows();
+    if (rows < 0) {
+        error = "The log " + name + " is not binary, so is not exported.";
+        return false;
+    }
+    int cols = log->columns.size();
+
+    QVector <qint32> neurons(cols);
+    for (int c = 0; c < cols; ++c) {
+        neurons[c] = log->columns[c].index;
+    }
+    if (!writeArray(group, "neurons", H5T_STD_I32LE, H5T_NATIVE_INT32, neurons.constData(), neurons.size())) {
+        error = "Could not write the log " + name + ".";
+        return false;
+    }
+
+    // a neuron's values are a row, so its trace is read as one hyperslab
+    hsize_t dims[2] = {(hsize_t) cols, (hsize_t) rows};
+    hdf5Handle space(H5Screate_simple(2, dims, NULL), H5Sclose);
+    hdf5Handle dcpl(H5Pcreate(H5P_DATASET_CREATE), H5Pclose);
+    if (cols > 0 && rows > 0) {
+        hsize_t chunk[2] = {(hsize_t) qMin(cols, HDF5_LOG_CHUNK_COLUMNS), (hsize_t) qMin(rows, (qint64) HDF5_LOG_CHUNK_ROWS)};
+        H5Pset_chunk(dcpl, 2, chunk);
+        H5Pset_shuffle(dcpl);
+        H5Pset_deflate(dcpl, HDF5_DEFLATE_LEVEL);
+    }
+    hdf5Handle set(H5Dcreate2(group, "values", H5T_IEEE_F64LE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT), H5Dclose);
+    if (!set.isValid()) {
+        error = "Could not write the log " + name + ".";
+        return false;
+    }
+
+    QVector <double> block;
+    for (int c = 0; c < cols; ++c) {
+        for (qint64 first = 0; first < rows; first += HDF5_IO_BLOCK) {
+            qint64 n = qMin(rows - first, (qint64) HDF5_IO_BLOCK);
+            if (!log->getColumn(c, block, first, n) || block.size() != n) {
+                error = "Could not read the log " + name + ".";
+                return false;
+            }
+            hsize_t start[2] = {(hsize_t) c, (hsize_t) first};
+            hsize_t count[2] = {1, (hsize_t) n};
+            hsize_t memCount[1] = {(hsize_t) n};
+            hdf5Handle memSpace(H5Screate_simple(1, memCount, NULL), H5Sclose);
+            if (H5Sselect_hyperslab(space, H5S_SELECT_SET, start, NULL, count, NULL) < 0
+                || H5Dwrite(set, H5T_NATIVE_DOUBLE, memSpace, space, H5P_DEFAULT, block.constData()) < 0) {
+                error = "Could not write the log " + name + ".";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+#endif // USE_HDF5
+
+bool hdf5Store::isAvailable()
+{
+#ifdef USE_HDF5
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef USE_HDF5
+
+bool hdf5Store::exportProject(projectObject * project, const QString &fileName, QString &error)
+{
+    // errors are reported here rather than printed by the library
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    QVector <namedConnection> conns;
+    QVector <namedProperty> props;
+    collectProject(project, conns, props);
+
+    hdf5Handle file(H5Fcreate(fileName.toUtf8().constData(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT), H5Fclose);
+    if (!file.isValid()) {
+        error = "Could not create the HDF5 file '" + fileName + "'.";
+        return false;
+    }
+
+    hdf5Handle connGroup(openGroup(file, "connections", true), H5Gclose);
+    for (int i = 0; i < conns.size(); ++i) {
+        conns[i].conn->waitForImport();
+        if (!connGroup.isValid() || !writeConnection(connGroup, conns[i])) {
+            error = "Could not write the connections of " + conns[i].name + ".";
+            return false;
+        }
+    }
+
+    hdf5Handle propGroup(openGroup(file, "properties", true), H5Gclose);
+    for (int i = 0; i < props.size(); ++i) {
+        if (props[i].par->currType != ExplicitList) {
+            continue;
+        }
+        if (!propGroup.isValid() || !writeProperty(propGroup, props[i])) {
+            error = "Could not write the property " + props[i].par->name + " of " + props[i].component + ".";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hdf5Store::exportLogs(const QString &logDir, const QString &fileName, QString &error)
+{
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    QFileInfo info(fileName);
+    hdf5Handle file(info.exists() ? H5Fopen(fileName.toUtf8().constData(), H5F_ACC_RDWR, H5P_DEFAULT)
+                                  : H5Fcreate(fileName.toUtf8().constData(), H5F_ACC_EXCL, H5P_DEFAULT, H5P_DEFAULT),
+                    H5Fclose);
+    if (!file.isValid()) {
+        error = "Could not open the HDF5 file '" + fileName + "'.";
+        return false;
+    }
+    hdf5Handle logGroup(openGroup(file, "logs", true), H5Gclose);
+    if (!logGroup.isValid()) {
+        error = "Could not write the logs to '" + fileName + "'.";
+        return false;
+    }
+
+    // as viewGVpropertieslayout finds them
+    QDir logs(logDir);
+    QStringList reports = logs.entryList(QStringList() << "*.xml", QDir::Files);
+    for (int i = 0; i < reports.size(); ++i) {
+        logData log;
+        log.logFileXMLname = logs.absoluteFilePath(reports[i]);
+        if (!log.setupFromXML()) {
+            continue;
+        }
+        if (!writeLog(logGroup, &log, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hdf5Store::importProject(projectObject * project, const QString &fileName, QString &error)
+{
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    QVector <namedConnection> conns;
+    QVector <namedProperty> props;
+    collectProject(project, conns, props);
+
+    hdf5Handle file(H5Fopen(fileName.toUtf8().constData(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose);
+    if (!file.isValid()) {
+        error = "Could not open the HDF5 file '" + fileName + "'.";
+        return false;
+    }
+
+    if (hasLink(file, "connections")) {
+        hdf5Handle connGroup(openGroup(file, "connections", false), H5Gclose);
+        for (int i = 0; i < conns.size(); ++i) {
+            if (!connGroup.isValid()) {
+                break;
+            }
+            if (!hasLink(connGroup, conns[i].name)) {
+                continue;
+            }
+            conns[i].conn->waitForImport();
+            if (!readConnection(connGroup, conns[i])) {
+                error = "Could not read the connections of " + conns[i].name + ".";
+                return false;
+            }
+        }
+    }
+
+    if (hasLink(file, "properties")) {
+        hdf5Handle propGroup(openGroup(file, "properties", false), H5Gclose);
+        for (int i = 0; i < props.size() && propGroup.isValid(); ++i) {
+            if (!readProperty(propGroup, props[i])) {
+                error = "Could not read the property " + props[i].par->name + " of " + props[i].component + ".";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#else
+
+bool hdf5Store::exportProject(projectObject *, const QString &, QString &error)
+{
+    error = "SpineCreator was built without HDF5 support (qmake \"CONFIG+=use_hdf5\").";
+    return false;
+}
+
+bool hdf5Store::exportLogs(const QString &, const QString &, QString &error)
+{
+    error = "SpineCreator was built without HDF5 support (qmake \"CONFIG+=use_hdf5\").";
+    return false;
+}
+
+bool hdf5Store::importProject(projectObject *, const QString &, QString &error)
+{
+    error = "SpineCreator was built without HDF5 support (qmake \"CONFIG+=use_hdf5\").";
+    return false;
+}
+
+#endif // USE_HDF5
@@ -0,0 +1,88 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef HDF5STORE_H
+#define HDF5STORE_H
+
+#include "globalHeader.h"
+
+class projectObject;
+
+// elements in each chunk of a 1D dataset, and rows by columns in each chunk
+// of a log's values; chunks are deflated at HDF5_DEFLATE_LEVEL
+#define HDF5_CHUNK_ELEMENTS 65536
+#define HDF5_LOG_CHUNK_ROWS 4096
+#define HDF5_LOG_CHUNK_COLUMNS 16
+#define HDF5_DEFLATE_LEVEL 4
+
+// elements read or written in one hyperslab
+#define HDF5_IO_BLOCK (1 << 20)
+
+/*!
+ * \brief The hdf5Store class keeps the explicit data of a project, and the
+ * logs of its runs, in one HDF5 file, so that analysis tools can read any
+ * part of it without first converting SpineCreator's own binary files:
+ *
+ *   /connections/<synapse or input>/src, dst     (int32)
+ *                                  /delay        (float32, if it has delays)
+ *   /properties/<component>/<property>/indices   (int32)
+ *                                     /values    (float64)
+ *   /logs/<log>/values     (float64, a row per logged neuron by timestep)
+ *              /neurons    (int32, the neuron of each row of values)
+ *   /logs/<log>/times, indices   (float64 and int32, for event logs)
+ *
+ * Components are named as in the exported model (their XML names) and
+ * synapses and inputs as in the GUI, with any '/' replaced by '_'. Log
+ * groups have a dt attribute, the timestep in ms. The datasets are chunked
+ * and deflated, and are read and written a hyperslab at a time.
+ *
+ * HDF5 is optional: build with qmake "CONFIG+=use_hdf5" to enable it.
+ * Without it every call fails with an error saying so.
+ */
+class hdf5Store
+{
+public:
+    static bool isAvailable();
+
+    /*!
+     * Write the explicit connection lists and explicit property lists of
+     * project to fileName, replacing the file.
+     */
+    static bool exportProject(projectObject * project, const QString &fileName, QString &error);
+
+    /*!
+     * Add the binary and event logs described by the logreps in logDir to
+     * fileName, replacing any logs of the same name already there.
+     */
+    static bool exportLogs(const QString &logDir, const QString &fileName, QString &error);
+
+    /*!
+     * Set the explicit connection lists and explicit property lists of
+     * project which are found in fileName from it; anything not in the
+     * file is left as it is.
+     */
+    static bool importProject(projectObject * project, const QString &fileName, QString &error);
+};
+
+#endif // HDF5STORE_H
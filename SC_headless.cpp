@@ -0,0 +1,363 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_headless.h"
+#include "SC_batchexperimentrunner.h"
+#include "SC_hdf5store.h"
+#include "SC_modelsnapshot.h"
+#include "SC_networkgraphwriter.h"
+#include "SC_projectobject.h"
+#include "SC_settings.h"
+#include "SC_utilities.h"
+#include "EL_experiment.h"
+#include "NL_connection.h"
+#include <QCoreApplication>
+#include <iostream>
+
+headlessRunner::headlessRunner(QObject *parent) :
+    QObject(parent)
+{
+    this->data.main = (MainWindow *) 0;
+    this->data.currProject = (projectObject *) 0;
+    this->project = (projectObject *) 0;
+    this->runner = (batchExperimentRunner *) 0;
+    this->runOk = false;
+    this->regenerate = false;
+    this->run = false;
+    this->help = false;
+}
+
+headlessRunner::~headlessRunner()
+{
+    delete this->runner;
+    if (this->project) {
+        this->project->copy_back_data(&this->data);
+        delete this->project;
+    }
+}
+
+bool headlessRunner::isRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        QString arg(argv[i]);
+        if (arg == "--project" || arg.startsWith("--project=")
+            || arg == "--help" || arg == "-h") {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool headlessRunner::parseArguments(QString &error)
+{
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        QString arg = args[i];
+        QString value;
+        bool hasValue = false;
+        if (arg.startsWith("--") && arg.contains("=")) {
+            value = arg.mid(arg.indexOf("=") + 1);
+            arg = arg.left(arg.indexOf("="));
+            hasValue = true;
+        }
+
+        if (arg == "--regenerate-connections") {
+            this->regenerate = true;
+        } else if (arg == "--run") {
+            this->run = true;
+        } else if (arg == "--help" || arg == "-h") {
+            this->help = true;
+        } else if (arg == "--project" || arg == "--experiment" || arg == "--export-dir"
+                   || arg == "--export-hdf5" || arg == "--import-hdf5" || arg == "--export-graph") {
+            if (!hasValue) {
+                if (i + 1 >= args.size()) {
+                    error = arg + " needs a value.";
+                    return false;
+                }
+                value = args[++i];
+            }
+            if (arg == "--project") {
+                this->projectFile = value;
+            } else if (arg == "--experiment") {
+                this->experimentName = value;
+            } else if (arg == "--export-hdf5") {
+                this->hdf5Export = value;
+            } else if (arg == "--import-hdf5") {
+                this->hdf5Import = value;
+            } else if (arg == "--export-graph") {
+                this->graphExport = value;
+            } else {
+                this->exportDir = value;
+            }
+        } else {
+            error = "Unknown argument '" + args[i] + "'.";
+            return false;
+        }
+    }
+
+    if (!this->help && this->projectFile.isEmpty()) {
+        error = "No --project given.";
+        return false;
+    }
+    return true;
+}
+
+void headlessRunner::printUsage()
+{
+    std::cout << "Usage: spinecreator --project <file.proj> [options]\n"
+              << "\n"
+              << "Opens the project without a GUI, reporting any errors found in it.\n"
+              << "\n"
+              << "  --regenerate-connections  rerun every Python script connection and save\n"
+              << "                            the project (in place, or into --export-dir)\n"
+              << "  --export-dir <dir>        save the project into <dir>\n"
+              << "  --experiment <n|name>     the experiment to run, by index from 0 or name\n"
+              << "  --run                     run the experiment with its simulator\n"
+              << "  --import-hdf5 <file>      set the explicit connections and property values\n"
+              << "                            found in <file>, and save the project\n"
+              << "  --export-hdf5 <file>      write the explicit connections and property values\n"
+              << "                            to <file>, and with --run the logs of the run\n"
+              << "  --export-graph <file>     write the populations and projections as a graph,\n"
+              << "                            GraphML for .graphml or .xml, else DOT\n"
+              << std::endl;
+}
+
+int headlessRunner::exec()
+{
+    QCoreApplication::setOrganizationName("SpineML");
+    QCoreApplication::setOrganizationDomain("sheffield.ac.uk");
+    QCoreApplication::setApplicationName("SpineCreator");
+
+    QString error;
+    if (!this->parseArguments(error)) {
+        std::cerr << error.toStdString() << std::endl;
+        this->printUsage();
+        return 2;
+    }
+    if (this->help) {
+        this->printUsage();
+        return 0;
+    }
+
+    bool ok = this->openProject();
+    if (ok && !this->hdf5Import.isEmpty()) {
+        ok = hdf5Store::importProject(this->project, this->hdf5Import, error);
+        if (ok) {
+            std::cout << "Imported '" << this->hdf5Import.toStdString() << "'." << std::endl;
+        } else {
+            std::cerr << error.toStdString() << std::endl;
+        }
+    }
+    if (ok && this->regenerate) {
+        ok = this->regenerateConnections();
+    }
+    if (ok && (this->regenerate || !this->exportDir.isEmpty() || !this->hdf5Import.isEmpty())) {
+        QString fileName = QFileInfo(this->projectFile).absoluteFilePath();
+        if (!this->exportDir.isEmpty()) {
+            if (!QDir().mkpath(this->exportDir)) {
+                std::cerr << "Could not create the directory '" << this->exportDir.toStdString() << "'." << std::endl;
+                ok = false;
+            }
+            fileName = QDir(this->exportDir).absoluteFilePath(QFileInfo(this->projectFile).fileName());
+        }
+        ok = ok && this->saveProject(fileName);
+    }
+    if (ok && !this->hdf5Export.isEmpty()) {
+        ok = hdf5Store::exportProject(this->project, this->hdf5Export, error);
+        if (ok) {
+            std::cout << "Exported the explicit data to '" << this->hdf5Export.toStdString() << "'." << std::endl;
+        } else {
+            std::cerr << error.toStdString() << std::endl;
+        }
+    }
+    if (ok && !this->graphExport.isEmpty()) {
+        ok = networkGraphWriter::write(modelSnapshot::take(&this->data), this->graphExport,
+                                       networkGraphWriter::formatFor(this->graphExport), error);
+        if (ok) {
+            std::cout << "Exported the network graph to '" << this->graphExport.toStdString() << "'." << std::endl;
+        } else {
+            std::cerr << error.toStdString() << std::endl;
+        }
+    }
+    if (ok && this->run) {
+        ok = this->runExperiment();
+        if (ok && !this->hdf5Export.isEmpty()) {
+            ok = hdf5Store::exportLogs(this->runner->getLogDir(0), this->hdf5Export, error);
+            if (ok) {
+                std::cout << "Exported the logs to '" << this->hdf5Export.toStdString() << "'." << std::endl;
+            } else {
+                std::cerr << error.toStdString() << std::endl;
+            }
+        }
+    }
+
+    // the project holds Python objects for its script connections
+    if (this->project) {
+        this->project->copy_back_data(&this->data);
+        delete this->project;
+        this->project = (projectObject *) 0;
+    }
+    SCUtilities::finalizePython();
+
+    return ok ? 0 : 1;
+}
+
+bool headlessRunner::openProject()
+{
+    QFileInfo info(this->projectFile);
+    if (!info.exists()) {
+        std::cerr << "The project '" << this->projectFile.toStdString() << "' does not exist." << std::endl;
+        return false;
+    }
+
+    this->project = new projectObject();
+    if (!this->project->open_project(info.absoluteFilePath())) {
+        delete this->project;
+        this->project = (projectObject *) 0;
+        return false;
+    }
+
+    // as projectObject::select_project, without the views
+    this->data.projects.push_back(this->project);
+    this->project->copy_out_data(&this->data);
+    this->data.currProject = this->project;
+    settingsCache::setCurrentFileName(this->project->filePath);
+
+    if (this->project->errorsShown > 0) {
+        std::cerr << "Errors were found in the project." << std::endl;
+        return false;
+    }
+    std::cout << "Opened project '" << this->project->name.toStdString() << "'." << std::endl;
+    return true;
+}
+
+bool headlessRunner::regenerateConnections()
+{
+    QVector<csv_connection*> conns = this->project->getExplicitConnections();
+    QVector<pythonscript_connection*> scripted;
+    for (int i = 0; i < conns.size(); ++i) {
+        pythonscript_connection * pyConn = dynamic_cast<pythonscript_connection *> (conns[i]->generator);
+        if (pyConn) {
+            // regenerateChanged() only reruns scripts which have changed
+            pyConn->setUnchanged(false);
+            scripted.push_back(pyConn);
+        }
+    }
+
+    std::cout << "Regenerating " << scripted.size() << " Python script connection(s)." << std::endl;
+    pythonscript_connection::regenerateChanged(scripted);
+
+    bool ok = true;
+    for (int i = 0; i < scripted.size(); ++i) {
+        pythonscript_connection * pyConn = scripted[i];
+        if (!pyConn->errorLog.isEmpty() || !pyConn->pythonErrors.isEmpty()) {
+            std::cerr << "Python script connection '" << pyConn->scriptName.toStdString() << "' failed: "
+                      << (pyConn->errorLog + pyConn->pythonErrors).toStdString() << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool headlessRunner::saveProject(const QString &fileName)
+{
+    // as MainWindow::export_project
+    settingsCache::setCurrentFileName(fileName);
+    if (!this->project->save_project(fileName, &this->data)) {
+        std::cerr << "The project could not be saved to '" << fileName.toStdString() << "'." << std::endl;
+        return false;
+    }
+    std::cout << "Saved the project to '" << fileName.toStdString() << "'." << std::endl;
+    return true;
+}
+
+experiment * headlessRunner::findExperiment(QString &error)
+{
+    if (this->data.experiments.isEmpty()) {
+        error = "The project has no experiments.";
+        return (experiment *) 0;
+    }
+
+    if (this->experimentName.isEmpty()) {
+        for (int i = 0; i < this->data.experiments.size(); ++i) {
+            if (this->data.experiments[i]->selected) {
+                return this->data.experiments[i];
+            }
+        }
+        return this->data.experiments[0];
+    }
+
+    for (int i = 0; i < this->data.experiments.size(); ++i) {
+        if (this->data.experiments[i]->name == this->experimentName) {
+            return this->data.experiments[i];
+        }
+    }
+    bool isIndex;
+    int index = this->experimentName.toInt(&isIndex);
+    if (isIndex && index >= 0 && index < this->data.experiments.size()) {
+        return this->data.experiments[index];
+    }
+
+    error = "The project has no experiment '" + this->experimentName + "'.";
+    return (experiment *) 0;
+}
+
+bool headlessRunner::runExperiment()
+{
+    QString error;
+    experiment * expt = this->findExperiment(error);
+    if (expt == (experiment *) 0) {
+        std::cerr << error.toStdString() << std::endl;
+        return false;
+    }
+
+    // a batch with no swept properties is a single run
+    this->runner = new batchExperimentRunner(&this->data);
+    connect(this->runner, SIGNAL(runFinished(int,bool)), this, SLOT(runFinished(int,bool)));
+    connect(this->runner, SIGNAL(finished()), this, SLOT(batchFinished()));
+    this->runOk = false;
+    if (!this->runner->start(expt, QVector <exptSweep> (), error)) {
+        std::cerr << error.toStdString() << std::endl;
+        return false;
+    }
+    std::cout << "Running experiment '" << expt->name.toStdString() << "' in "
+              << this->runner->getBatchDir().toStdString() << std::endl;
+
+    // the runner may have failed to start the simulator already
+    if (this->runner->isRunning()) {
+        QCoreApplication::exec();
+    }
+    return this->runOk;
+}
+
+void headlessRunner::runFinished(int, bool ok)
+{
+    this->runOk = ok;
+    std::cout << "The simulator " << (ok ? "finished." : "failed; see stderr.txt in the run directory.") << std::endl;
+}
+
+void headlessRunner::batchFinished()
+{
+    QCoreApplication::quit();
+}
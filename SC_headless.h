@@ -0,0 +1,101 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include "globalHeader.h"
+#include "SC_network_layer_rootdata.h"
+
+class batchExperimentRunner;
+
+/*!
+ * \brief The headlessRunner class drives a project from the command line,
+ * under a QCoreApplication, with no widgets or GL:
+ *
+ *   spinecreator --project model.proj [--regenerate-connections]
+ *                [--export-dir dir] [--experiment n|name] [--run]
+ *                [--import-hdf5 file] [--export-hdf5 file] [--export-graph file]
+ *
+ * The project is opened (and so validated, with errors and warnings written
+ * to stderr). --regenerate-connections reruns every Python script
+ * connection and saves the project in place, unless --export-dir is given,
+ * in which case the project is written there instead. --run runs the
+ * experiment given by --experiment (its index from 0, or its name; by
+ * default the selected one) through the batchExperimentRunner, with the
+ * simulator settings used by the GUI. --import-hdf5 first sets the explicit
+ * data found in an hdf5Store file, and the project is then saved, and
+ * --export-hdf5 writes the explicit data, and the logs of the run if there
+ * is one, to a new one. --export-graph writes the network as a DOT or
+ * GraphML graph (see networkGraphWriter). The exit status is 0 if all of this
+ * succeeded, 1 if it did not and 2 for bad arguments.
+ */
+class headlessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit headlessRunner(QObject *parent = 0);
+    ~headlessRunner();
+
+    /*!
+     * True if the command line asks for headless mode, so that main() can
+     * choose the kind of application to create.
+     */
+    static bool isRequested(int argc, char *argv[]);
+
+    /*!
+     * Do what QCoreApplication::arguments() ask, and return the exit status.
+     */
+    int exec();
+
+private slots:
+    void runFinished(int run, bool ok);
+    void batchFinished();
+
+private:
+    bool parseArguments(QString &error);
+    void printUsage();
+    bool openProject();
+    bool regenerateConnections();
+    bool saveProject(const QString &fileName);
+    bool runExperiment();
+    experiment * findExperiment(QString &error);
+
+    nl_rootdata data;
+    projectObject * project;
+    batchExperimentRunner * runner;
+    bool runOk;
+
+    QString projectFile;
+    QString exportDir;
+    QString experimentName;
+    QString hdf5Import;
+    QString hdf5Export;
+    QString graphExport;
+    bool regenerate;
+    bool run;
+    bool help;
+};
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,283 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_indexset.h"
+#include <limits.h>
+#include <algorithm>
+
+namespace {
+
+struct rangeLess {
+    template <class T>
+    bool operator() (const T& a, const T& b) const { return a.first < b.first; }
+};
+
+void skipSpaces (const QChar *& c, const QChar * end)
+{
+    while (c < end && c->isSpace()) {
+        ++c;
+    }
+}
+
+/*
+ * Read the digits at c into index, leaving c after them. False if there are
+ * none or they overflow an int.
+ */
+bool readIndex (const QChar *& c, const QChar * end, int& index)
+{
+    const QChar * start = c;
+    qint64 value = 0;
+    for (; c < end && c->isDigit(); ++c) {
+        value = value * 10 + c->digitValue();
+        if (value > INT_MAX) {
+            return false;
+        }
+    }
+    index = (int) value;
+    return c > start;
+}
+
+} // namespace
+
+indexSet::indexSet() :
+    everything(false),
+    num(0)
+{
+}
+
+indexSet indexSet::all()
+{
+    indexSet set;
+    set.everything = true;
+    return set;
+}
+
+bool indexSet::fromString(const QString &text, indexSet &set)
+{
+    QString t = text.trimmed();
+    if (t == "all") {
+        set = indexSet::all();
+        return true;
+    }
+    if (t.isEmpty()) {
+        return false;
+    }
+
+    // read each item, "n" or "n-m", a character at a time
+    indexSet parsed;
+    const QChar * c = t.constData();
+    const QChar * end = c + t.size();
+    for (;;) {
+        range r;
+        skipSpaces(c, end);
+        if (!readIndex(c, end, r.first)) {
+            return false;
+        }
+        r.last = r.first;
+        skipSpaces(c, end);
+        if (c < end && *c == QChar('-')) {
+            ++c;
+            skipSpaces(c, end);
+            if (!readIndex(c, end, r.last) || r.last < r.first) {
+                return false;
+            }
+            skipSpaces(c, end);
+        }
+        parsed.ranges.push_back(r);
+        if (c == end) {
+            break;
+        }
+        if (*c != QChar(',')) {
+            return false;
+        }
+        ++c;
+    }
+
+    parsed.normalise();
+    set = parsed;
+    return true;
+}
+
+indexSet indexSet::fromIndices(const QVector <int> &indices)
+{
+    indexSet set;
+    set.ranges.reserve(indices.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        // runs of consecutive indices, as logs usually list them
+        if (!set.ranges.isEmpty() && set.ranges.last().last + 1 == indices[i]) {
+            ++set.ranges.last().last;
+        } else if (indices[i] >= 0) {
+            range r;
+            r.first = indices[i];
+            r.last = indices[i];
+            set.ranges.push_back(r);
+        }
+    }
+    set.normalise();
+    return set;
+}
+
+void indexSet::normalise()
+{
+    // as typed, indices are nearly always in order already
+    bool sorted = true;
+    for (int i = 1; i < this->ranges.size() && sorted; ++i) {
+        sorted = this->ranges[i-1].first <= this->ranges[i].first;
+    }
+    if (!sorted) {
+        std::sort(this->ranges.begin(), this->ranges.end(), rangeLess());
+    }
+
+    // merge the ranges which overlap or touch
+    int kept = 0;
+    for (int i = 0; i < this->ranges.size(); ++i) {
+        if (kept > 0 && (qint64) this->ranges[i].first <= (qint64) this->ranges[kept-1].last + 1) {
+            this->ranges[kept-1].last = qMax(this->ranges[kept-1].last, this->ranges[i].last);
+        } else {
+            this->ranges[kept++] = this->ranges[i];
+        }
+    }
+    this->ranges.resize(kept);
+    this->ranges.squeeze();
+
+    qint64 n = 0;
+    for (int i = 0; i < this->ranges.size(); ++i) {
+        n += (qint64) this->ranges[i].last - this->ranges[i].first + 1;
+    }
+    this->num = (int) qMin(n, (qint64) INT_MAX);
+
+    this->bitmap.clear();
+    if (this->ranges.size() > INDEXSET_BITMAP_MIN_RANGES && this->last() < INDEXSET_BITMAP_MAX_BITS) {
+        this->bitmap.resize(this->last() + 1);
+        for (int i = 0; i < this->ranges.size(); ++i) {
+            this->bitmap.fill(true, this->ranges[i].first, this->ranges[i].last + 1);
+        }
+    }
+}
+
+int indexSet::first() const
+{
+    return this->ranges.isEmpty() ? -1 : this->ranges.first().first;
+}
+
+int indexSet::last() const
+{
+    return this->ranges.isEmpty() ? -1 : this->ranges.last().last;
+}
+
+bool indexSet::contains(int index) const
+{
+    if (this->everything) {
+        return index >= 0;
+    }
+    if (!this->bitmap.isEmpty()) {
+        return index >= 0 && index < this->bitmap.size() && this->bitmap.testBit(index);
+    }
+    // the last range starting at or before index
+    int lo = 0;
+    int hi = this->ranges.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (this->ranges[mid].first <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 && index <= this->ranges[lo-1].last;
+}
+
+QString indexSet::toString() const
+{
+    if (this->everything) {
+        return "all";
+    }
+    QString text;
+    text.reserve(this->num * 7);
+    for (int i = 0; i < this->ranges.size(); ++i) {
+        for (int n = this->ranges[i].first; n <= this->ranges[i].last; ++n) {
+            if (!text.isEmpty()) {
+                text += QChar(',');
+            }
+            text += QString::number(n);
+            if (n == INT_MAX) {
+                break;
+            }
+        }
+    }
+    return text;
+}
+
+QString indexSet::toRangeString() const
+{
+    if (this->everything) {
+        return "all";
+    }
+    QString text;
+    for (int i = 0; i < this->ranges.size(); ++i) {
+        if (i > 0) {
+            text += QChar(',');
+        }
+        text += QString::number(this->ranges[i].first);
+        if (this->ranges[i].last > this->ranges[i].first) {
+            // a pair is as short written out
+            text += (this->ranges[i].last == this->ranges[i].first + 1 ? QChar(',') : QChar('-'));
+            text += QString::number(this->ranges[i].last);
+        }
+    }
+    return text;
+}
+
+QVector <int> indexSet::toVector() const
+{
+    QVector <int> indices;
+    if (this->everything) {
+        return indices;
+    }
+    indices.resize(this->num);
+    int * out = indices.data();
+    for (int i = 0; i < this->ranges.size(); ++i) {
+        for (int n = this->ranges[i].first; ; ++n) {
+            *out++ = n;
+            if (n == this->ranges[i].last) {
+                break;
+            }
+        }
+    }
+    return indices;
+}
+
+bool indexSet::operator==(const indexSet &other) const
+{
+    if (this->everything != other.everything || this->ranges.size() != other.ranges.size()) {
+        return false;
+    }
+    for (int i = 0; i < this->ranges.size(); ++i) {
+        if (this->ranges[i].first != other.ranges[i].first || this->ranges[i].last != other.ranges[i].last) {
+            return false;
+        }
+    }
+    return true;
+}
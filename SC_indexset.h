@@ -0,0 +1,105 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_INDEXSET_H
+#define SC_INDEXSET_H
+
+#include <QString>
+#include <QVector>
+#include <QBitArray>
+
+// sets of more ranges than this also keep a bitmap of their indices, up to
+// this many bits, for contains()
+#define INDEXSET_BITMAP_MIN_RANGES 64
+#define INDEXSET_BITMAP_MAX_BITS (1 << 27)
+
+/*!
+ * \brief The indexSet class is a set of neuron indices, such as those an
+ * experiment output logs: either all of them, or a sorted list of disjoint
+ * ranges, so that a selection of many neurons costs only as much as its
+ * ranges. It is parsed once, from the comma separated text used in the
+ * SpineML and typed by the user, and formatted back either as that text
+ * or as the shorter ranges ("0-99,150").
+ */
+class indexSet
+{
+public:
+    // the empty set
+    indexSet();
+
+    static indexSet all();
+
+    /*!
+     * The set of indices in text: "all", or a comma separated list of
+     * indices and ranges of indices from 0 ("3,5,10-20"). Returns false,
+     * leaving set as it was, if text is not one.
+     */
+    static bool fromString(const QString &text, indexSet &set);
+
+    /*!
+     * The set of the indices (in any order, with any repeats) in indices.
+     */
+    static indexSet fromIndices(const QVector <int> &indices);
+
+    bool isAll() const { return everything; }
+    bool isEmpty() const { return !everything && ranges.isEmpty(); }
+    // the number of indices in the set, if it is not all()
+    int count() const { return num; }
+    // the lowest and highest index, or -1 if the set is empty or all()
+    int first() const;
+    int last() const;
+    bool contains(int index) const;
+
+    /*!
+     * "all", or every index in order separated by commas, as the SpineML
+     * indices attribute holds them.
+     */
+    QString toString() const;
+    /*!
+     * "all", or the ranges of the set separated by commas, for display.
+     */
+    QString toRangeString() const;
+    // the indices of the set in order; empty if it is all()
+    QVector <int> toVector() const;
+
+    bool operator==(const indexSet &other) const;
+    bool operator!=(const indexSet &other) const { return !(*this == other); }
+
+private:
+    struct range {
+        int first;
+        int last;
+    };
+
+    // sort and merge ranges, and count and map them
+    void normalise();
+
+    bool everything;
+    QVector <range> ranges;
+    int num;
+    QBitArray bitmap;
+};
+
+#endif // SC_INDEXSET_H
@@ -0,0 +1,338 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_ioservice.h"
+#include "SC_utilities.h"
+#include "SC_profiler.h"
+#include <QRunnable>
+#include <QUuid>
+#include <cstdio>
+#include <iostream>
+
+ioService * ioService::service = (ioService *) 0;
+
+namespace {
+    QMutex serviceLock;
+}
+
+/*!
+ * A read, read ahead or write, and its result.
+ */
+class ioRequest
+{
+public:
+    enum kind { readFile, readAheadFile, writeFile };
+
+    ioRequest(kind k, const QString &fileName) :
+        k(k), fileName(fileName), offset(0), size(-1), done(false), succeeded(false) {}
+
+    void run()
+    {
+        QString err;
+        QByteArray result;
+        bool ok;
+        if (this->k == writeFile) {
+            PROFILE_SCOPE("ioRequest::write");
+            ok = this->doWrite(err);
+        } else if (this->k == readFile) {
+            PROFILE_SCOPE("ioRequest::read");
+            ok = this->doRead(result, err);
+        } else {
+            PROFILE_SCOPE("ioRequest::readAhead");
+            ok = this->doReadAhead();
+        }
+
+        QMutexLocker locker(&this->lock);
+        this->data = result;
+        // what was written is not wanted once it is
+        this->toWrite.clear();
+        this->error = err;
+        this->succeeded = ok;
+        this->done = true;
+        this->finished.wakeAll();
+    }
+
+    // for the runner, which is not a friend of the service
+    static void notify(ioService * service, ioRequest * request)
+    {
+        service->finished(request);
+    }
+
+    kind k;
+    QString fileName;
+    qint64 offset;
+    qint64 size;
+    QByteArray toWrite;
+
+    mutable QMutex lock;
+    QWaitCondition finished;
+    bool done;
+    bool succeeded;
+    QByteArray data;
+    QString error;
+
+private:
+    bool doRead(QByteArray &result, QString &err)
+    {
+        QFile f(this->fileName);
+        if (!f.open(QIODevice::ReadOnly)) {
+            err = "Could not open '" + this->fileName + "': " + f.errorString();
+            return false;
+        }
+        if (this->offset > 0 && !f.seek(this->offset)) {
+            err = "Could not read '" + this->fileName + "': " + f.errorString();
+            return false;
+        }
+        result = this->size < 0 ? f.readAll() : f.read(this->size);
+        if (f.error() != QFile::NoError) {
+            err = "Could not read '" + this->fileName + "': " + f.errorString();
+            result.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool doWrite(QString &err)
+    {
+        QString tmpName = ioService::temporaryFileName(this->fileName);
+        QFile f(tmpName);
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err = "Could not write '" + this->fileName + "': " + f.errorString();
+            return false;
+        }
+        bool ok = f.write(this->toWrite) == (qint64) this->toWrite.size() && f.flush();
+        if (!ok) {
+            err = "Could not write '" + this->fileName + "': " + f.errorString();
+        }
+        f.close();
+        if (!ok) {
+            QFile::remove(tmpName);
+            return false;
+        }
+        if (!ioService::replaceFile(tmpName, this->fileName)) {
+            err = "Could not replace '" + this->fileName + "'.";
+            return false;
+        }
+        return true;
+    }
+
+    // read the file through, so that its data is in the system's cache
+    bool doReadAhead()
+    {
+        QFile f(this->fileName);
+        if (f.open(QIODevice::ReadOnly)) {
+            QByteArray block(IO_READAHEAD_BLOCK, 0);
+            qint64 total = 0;
+            qint64 got;
+            while (total < IO_READAHEAD_MAX_BYTES && (got = f.read(block.data(), block.size())) > 0) {
+                total += got;
+            }
+        }
+        return true;
+    }
+};
+
+namespace {
+    // runs a request on the pool, which deletes the runner when it is done
+    class ioRequestRunner : public QRunnable
+    {
+    public:
+        ioRequestRunner(QSharedPointer <ioRequest> request, ioService * service) :
+            request(request), service(service) {}
+        void run() {
+            this->request->run();
+            ioRequest::notify(this->service, this->request.data());
+        }
+    private:
+        QSharedPointer <ioRequest> request;
+        ioService * service;
+    };
+}
+
+bool ioFuture::isFinished() const
+{
+    if (this->d.isNull()) {
+        return true;
+    }
+    QMutexLocker locker(&this->d->lock);
+    return this->d->done;
+}
+
+bool ioFuture::waitForFinished() const
+{
+    if (this->d.isNull()) {
+        return false;
+    }
+    QMutexLocker locker(&this->d->lock);
+    while (!this->d->done) {
+        this->d->finished.wait(&this->d->lock);
+    }
+    return this->d->succeeded;
+}
+
+bool ioFuture::ok() const
+{
+    if (this->d.isNull()) {
+        return false;
+    }
+    QMutexLocker locker(&this->d->lock);
+    return this->d->done && this->d->succeeded;
+}
+
+QByteArray ioFuture::data() const
+{
+    if (this->d.isNull()) {
+        return QByteArray();
+    }
+    QMutexLocker locker(&this->d->lock);
+    return this->d->data;
+}
+
+QString ioFuture::error() const
+{
+    if (this->d.isNull()) {
+        return "No request was made.";
+    }
+    QMutexLocker locker(&this->d->lock);
+    return this->d->error;
+}
+
+ioService::ioService() :
+    numPending(0)
+{
+    this->pool.setMaxThreadCount(IO_SERVICE_THREADS);
+}
+
+ioService * ioService::instance()
+{
+    QMutexLocker locker(&serviceLock);
+    if (service == (ioService *) 0) {
+        service = new ioService();
+    }
+    return service;
+}
+
+ioFuture ioService::read(const QString &fileName, priority p, qint64 offset, qint64 size)
+{
+    QSharedPointer <ioRequest> request(new ioRequest(ioRequest::readFile, fileName));
+    request->offset = offset;
+    request->size = size;
+    instance()->start(request, p);
+    return ioFuture(request);
+}
+
+ioFuture ioService::write(const QString &fileName, const QByteArray &data, priority p)
+{
+    QSharedPointer <ioRequest> request(new ioRequest(ioRequest::writeFile, fileName));
+    request->toWrite = data;
+    instance()->start(request, p);
+    return ioFuture(request);
+}
+
+void ioService::hintReadAhead(const QString &fileName)
+{
+    ioService * s = instance();
+    {
+        QMutexLocker locker(&s->lock);
+        if (s->readingAhead.contains(fileName)) {
+            return;
+        }
+        s->readingAhead.insert(fileName);
+    }
+    s->start(QSharedPointer <ioRequest> (new ioRequest(ioRequest::readAheadFile, fileName)), readAhead);
+}
+
+void ioService::reportError(const QString &text)
+{
+    ioService * s = instance();
+    {
+        QMutexLocker locker(&s->lock);
+        // as from a loop over the rows of a connection list
+        if (text == s->lastError && s->lastErrorTime.isValid()
+            && s->lastErrorTime.elapsed() < IO_ERROR_REPEAT_MS) {
+            return;
+        }
+        s->lastError = text;
+        s->lastErrorTime.start();
+    }
+    DBG() << text;
+    if (SCUtilities::haveGui()) {
+        emit s->errorReported(text, IO_ERROR_REPEAT_MS * 2);
+    } else {
+        std::cerr << text.toStdString() << std::endl;
+    }
+}
+
+int ioService::pending()
+{
+    QMutexLocker locker(&this->lock);
+    return this->numPending;
+}
+
+void ioService::start(QSharedPointer <ioRequest> request, priority p)
+{
+    int n;
+    {
+        QMutexLocker locker(&this->lock);
+        n = ++this->numPending;
+    }
+    emit pendingChanged(n);
+    this->pool.start(new ioRequestRunner(request, this), (int) p);
+}
+
+void ioService::finished(ioRequest * request)
+{
+    int n;
+    {
+        QMutexLocker locker(&this->lock);
+        n = --this->numPending;
+        if (request->k == ioRequest::readAheadFile) {
+            this->readingAhead.remove(request->fileName);
+        }
+    }
+    emit pendingChanged(n);
+}
+
+QString ioService::temporaryFileName(const QString &fileName)
+{
+    return fileName + "." + QUuid::createUuid().toString().mid(1, 8);
+}
+
+bool ioService::replaceFile(const QString &tmpName, const QString &fileName)
+{
+#ifdef Q_OS_UNIX
+    // rename() replaces fileName in one step
+    if (std::rename(QFile::encodeName(tmpName).constData(), QFile::encodeName(fileName).constData()) == 0) {
+        return true;
+    }
+#else
+    QFile::remove(fileName);
+    if (QFile::rename(tmpName, fileName)) {
+        return true;
+    }
+#endif
+    QFile::remove(tmpName);
+    return false;
+}
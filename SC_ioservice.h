@@ -0,0 +1,154 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_IOSERVICE_H
+#define SC_IOSERVICE_H
+
+#include "globalHeader.h"
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSet>
+#include <QTime>
+
+// the most files read or written at once
+#define IO_SERVICE_THREADS 4
+// read ahead hints are read in blocks of this many bytes, and at most this
+// many bytes of a file are read ahead
+#define IO_READAHEAD_BLOCK (1 << 20)
+#define IO_READAHEAD_MAX_BYTES (256 << 20)
+// the same error reported again within this time (ms) is not shown again
+#define IO_ERROR_REPEAT_MS 5000
+
+class ioRequest;
+
+/*!
+ * \brief The ioFuture class is the result of a read or write queued with
+ * the ioService. It may be copied, and waited on from any thread.
+ */
+class ioFuture
+{
+public:
+    ioFuture() {}
+
+    bool isFinished() const;
+    // wait for the request, returning true if it succeeded
+    bool waitForFinished() const;
+    bool ok() const;
+    // what was read; empty for a write
+    QByteArray data() const;
+    // why the request failed
+    QString error() const;
+
+private:
+    friend class ioService;
+    explicit ioFuture(QSharedPointer <ioRequest> d) : d(d) {}
+    QSharedPointer <ioRequest> d;
+};
+
+/*!
+ * \brief The ioService class reads and writes the files of the model (the
+ * component and experiment XML, explicit data and logs) on a small pool of
+ * threads of its own, so that file I/O neither blocks the GUI nor takes
+ * the cores of the global pool used for computing.
+ *
+ * Requests are queued by priority: interactive reads, which something is
+ * waiting for, go before read ahead hints, which go before background
+ * saves. A read ahead hint reads a file which will be wanted soon, so that
+ * its data is in the system's cache when it is. Writes replace the file
+ * in one step, through a temporary file beside it.
+ *
+ * Errors are reported without a modal dialog: reportError() emits
+ * errorReported(), which the main window shows in its status bar, or
+ * writes to stderr when there is no GUI.
+ */
+class ioService : public QObject
+{
+    Q_OBJECT
+public:
+    enum priority {
+        background = 0,
+        readAhead = 1,
+        interactive = 2
+    };
+
+    static ioService * instance();
+
+    /*!
+     * Read size bytes of fileName (all of it, if size is negative) from
+     * offset.
+     */
+    static ioFuture read(const QString &fileName, priority p = interactive,
+                         qint64 offset = 0, qint64 size = -1);
+
+    /*!
+     * Replace fileName with data.
+     */
+    static ioFuture write(const QString &fileName, const QByteArray &data, priority p = background);
+
+    /*!
+     * fileName will be read soon. Hints for a file already being read
+     * ahead are dropped.
+     */
+    static void hintReadAhead(const QString &fileName);
+
+    /*!
+     * Report an error without stopping for the user.
+     */
+    static void reportError(const QString &text);
+
+    // the requests queued or running
+    int pending();
+
+    /*!
+     * Files are written under a temporary name beside the file they
+     * replace, and moved over it once complete, so that a save which is
+     * interrupted leaves the old file whole. replaceFile removes tmpName if
+     * it fails.
+     */
+    static QString temporaryFileName(const QString &fileName);
+    static bool replaceFile(const QString &tmpName, const QString &fileName);
+
+signals:
+    void errorReported(QString text, int timeout);
+    // emitted as requests are queued and finish, with the number pending
+    void pendingChanged(int pending);
+
+private:
+    friend class ioRequest;
+    ioService();
+    static ioService * service;
+    void start(QSharedPointer <ioRequest> request, priority p);
+    void finished(ioRequest * request);
+
+    QThreadPool pool;
+    QMutex lock;
+    int numPending;
+    QSet <QString> readingAhead;
+    QString lastError;
+    QTime lastErrorTime;
+};
+
+#endif // SC_IOSERVICE_H
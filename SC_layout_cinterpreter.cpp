@@ -753,7 +753,7 @@ QString doBoolBrackets(int startInd, int endInd, vector <valop> opstackIn, float
 
 }
 */
-float interpretMaths(vector <valop> stack) {
+float interpretMaths(const vector <valop> &stack) {
 
     // evaluate the stack:
     vector <valop> tempStack;
@@ -884,6 +884,405 @@ float interpretMaths(vector <valop> stack) {
     return 0.0;
 }
 
+void compiledMaths::compile(const vector <valop> &stack) {
+
+    program.clear();
+    source.clear();
+    fallback = false;
+
+    // track the stack depth so the register file can be sized up front
+    int depth = 0;
+    int maxDepth = 0;
+
+    for (uint i = 0; i < stack.size(); ++i) {
+
+        instr in;
+        in.val = stack[i].val;
+        in.ptr = NULL;
+        in.slot = -1;
+
+        switch (stack[i].op) {
+        case VAL:
+            if (stack[i].ptr != NULL) {
+                in.code = C_LOAD;
+                in.ptr = stack[i].ptr;
+            } else {
+                in.code = C_CONST;
+            }
+            ++depth;
+            break;
+        case FUNC:
+            if (stack[i].isUnary) {
+                // a unary function with nothing to consume (e.g. rand())
+                if (int(stack[i].val) == 19) {
+                    in.code = depth ? C_RAND1 : C_RAND0;
+                } else {
+                    in.code = depth ? C_FUNC1 : C_FUNC0;
+                }
+                if (!depth) ++depth;
+            } else {
+                if (depth < 2) fallback = true;
+                in.code = C_FUNC2;
+                --depth;
+            }
+            break;
+        case OP:
+            if (stack[i].isUnary) {
+                if (depth < 1) fallback = true;
+                // interpretMaths applies unary operators against a zero
+                switch (int(stack[i].val)) {
+                case ADD:
+                    // leaves the operand as it is
+                    if (!fallback) continue;
+                    break;
+                case SUB:
+                    in.code = C_NEG;
+                    break;
+                case MULT:
+                    in.code = C_ZERO_MULT;
+                    break;
+                default:
+                    in.code = C_ZERO_DIV;
+                    break;
+                }
+            } else {
+                if (depth < 2) fallback = true;
+                switch (int(stack[i].val)) {
+                case ADD:
+                    in.code = C_ADD;
+                    break;
+                case SUB:
+                    in.code = C_SUB;
+                    break;
+                case MULT:
+                    in.code = C_MULT;
+                    break;
+                default:
+                    in.code = C_DIV;
+                    break;
+                }
+                --depth;
+            }
+            break;
+        default:
+            // not evaluated by interpretMaths either
+            continue;
+        }
+
+        if (fallback) {
+            program.clear();
+            source = stack;
+            return;
+        }
+
+        program.push_back(in);
+        if (depth > maxDepth) maxDepth = depth;
+    }
+
+    regs.resize(maxDepth + 1);
+
+}
+
+bool compiledMaths::reads(const float * ptr) const {
+
+    if (fallback) {
+        for (uint i = 0; i < source.size(); ++i) {
+            if (source[i].op == VAL && source[i].ptr == ptr) return true;
+        }
+        return false;
+    }
+
+    for (uint i = 0; i < program.size(); ++i) {
+        if (program[i].code == C_LOAD && program[i].ptr == ptr) return true;
+    }
+    return false;
+}
+
+void compiledMaths::rebind(vector <lookup> &from, vector <lookup> &to) {
+
+    // point the variable loads at the same slots in another variable list
+    for (uint i = 0; i < program.size(); ++i) {
+        if (program[i].code != C_LOAD) continue;
+        for (uint j = 0; j < from.size() && j < to.size(); ++j) {
+            if (program[i].ptr == &(from[j].value)) {
+                program[i].ptr = &(to[j].value);
+                break;
+            }
+        }
+    }
+    for (uint i = 0; i < source.size(); ++i) {
+        if (source[i].ptr == NULL) continue;
+        for (uint j = 0; j < from.size() && j < to.size(); ++j) {
+            if (source[i].ptr == &(from[j].value)) {
+                source[i].ptr = &(to[j].value);
+                break;
+            }
+        }
+    }
+}
+
+float compiledMaths::evaluate() {
+
+    return this->evaluate(NULL);
+}
+
+/*!
+ * Evaluate the compiled stack. If rng is given, rand() is drawn from the
+ * counter based generator rather than the C library's shared state.
+ */
+float compiledMaths::evaluate(counterRandom * rng) {
+
+    if (fallback) {
+        return interpretMaths(source);
+    }
+
+    if (program.empty()) {
+        return 0.0;
+    }
+
+    float * sp = &regs[0];
+    const instr * in = &program[0];
+    const instr * end = in + program.size();
+
+    // sp points one past the top of the stack
+    for (; in != end; ++in) {
+
+        switch (in->code) {
+        case C_CONST:
+            *sp++ = in->val;
+            break;
+        case C_LOAD:
+            *sp++ = *in->ptr;
+            break;
+        case C_ADD:
+            --sp;
+            sp[-1] = sp[-1] + sp[0];
+            break;
+        case C_SUB:
+            --sp;
+            sp[-1] = sp[-1] - sp[0];
+            break;
+        case C_MULT:
+            --sp;
+            sp[-1] = sp[-1] * sp[0];
+            break;
+        case C_DIV:
+            --sp;
+            sp[-1] = sp[-1] / sp[0];
+            break;
+        case C_NEG:
+            sp[-1] = 0 - sp[-1];
+            break;
+        case C_ZERO_MULT:
+            sp[-1] = 0 * sp[-1];
+            break;
+        case C_ZERO_DIV:
+            sp[-1] = 0 / sp[-1];
+            break;
+        case C_FUNC0:
+            *sp++ = doFunction(INFINITY, INFINITY, in->val);
+            break;
+        case C_FUNC1:
+            sp[-1] = doFunction(sp[-1], INFINITY, in->val);
+            break;
+        case C_FUNC2:
+            --sp;
+            sp[-1] = doFunction(sp[-1], sp[0], in->val);
+            break;
+        case C_RAND0:
+            *sp++ = rng ? counterRandomUniform(rng) : float(rand())/RAND_MAX;
+            break;
+        case C_RAND1:
+            sp[-1] = rng ? counterRandomUniform(rng) : float(rand())/RAND_MAX;
+            break;
+        }
+
+    }
+
+    if (sp != &regs[0]) {
+        return sp[-1];
+    }
+
+    return 0.0;
+}
+
+void compiledMaths::bindBlock(vector <lookup> &vars) {
+
+    // find the slot each load reads, as rebind() does
+    for (uint i = 0; i < program.size(); ++i) {
+        if (program[i].code != C_LOAD) continue;
+        program[i].slot = -1;
+        for (uint j = 0; j < vars.size(); ++j) {
+            if (program[i].ptr == &(vars[j].value)) {
+                program[i].slot = j;
+                break;
+            }
+        }
+    }
+    blockRegs.resize(regs.size() * MATHS_BLOCK_SIZE);
+}
+
+// the functions of doFunction() applied across a block, with the operator
+// chosen once rather than per neuron; the results are the same as calling
+// doFunction() for each. Those not given a loop of their own fall back to it
+static void blockFunction1(int op, float * a, int n) {
+
+    switch (op) {
+    case 0:
+    case 16:
+    case 20:
+        // these need a second operand
+        for (int j = 0; j < n; ++j) a[j] = INFINITY;
+        break;
+    case 1:
+        for (int j = 0; j < n; ++j) a[j] = exp(a[j]);
+        break;
+    case 2:
+        for (int j = 0; j < n; ++j) a[j] = sin(a[j]);
+        break;
+    case 3:
+        for (int j = 0; j < n; ++j) a[j] = cos(a[j]);
+        break;
+    case 4:
+        for (int j = 0; j < n; ++j) a[j] = log(a[j]);
+        break;
+    case 9:
+        for (int j = 0; j < n; ++j) a[j] = sqrt(a[j]);
+        break;
+    default:
+        for (int j = 0; j < n; ++j) a[j] = doFunction(a[j], INFINITY, op);
+        break;
+    }
+}
+
+static void blockFunction2(int op, float * a, const float * b, int n) {
+
+    switch (op) {
+    case 0:
+        for (int j = 0; j < n; ++j) a[j] = b[j] == INFINITY ? INFINITY : float(pow(a[j], b[j]));
+        break;
+    case 16:
+        for (int j = 0; j < n; ++j) a[j] = b[j] == INFINITY ? INFINITY : float(atan2(a[j], b[j]));
+        break;
+    case 20:
+        for (int j = 0; j < n; ++j) a[j] = b[j] == INFINITY ? INFINITY : float(fmod(a[j], b[j]));
+        break;
+    default:
+        for (int j = 0; j < n; ++j) a[j] = doFunction(a[j], b[j], op);
+        break;
+    }
+}
+
+/*!
+ * Evaluate the compiled stack for n (up to MATHS_BLOCK_SIZE) neurons at
+ * once, giving the same results as n calls to evaluate(). The variables are
+ * laid out by slot, with slot k of neuron j at vars[k*MATHS_BLOCK_SIZE+j],
+ * in the order of the list given to bindBlock(); loads from anywhere else
+ * read the same value for every neuron. rngs holds each neuron's random
+ * state. Each instruction is applied across the block in a simple loop, so
+ * that the compiler can vectorise it.
+ */
+void compiledMaths::evaluateBlock(const float * vars, int n, counterRandom * rngs, float * out) {
+
+    if (fallback) {
+        // only compiled stacks are evaluated by block
+        for (int j = 0; j < n; ++j) out[j] = interpretMaths(source);
+        return;
+    }
+
+    if (program.empty() || blockRegs.empty()) {
+        for (int j = 0; j < n; ++j) out[j] = 0.0;
+        return;
+    }
+
+    float * base = &blockRegs[0];
+    float * sp = base;
+    const instr * in = &program[0];
+    const instr * end = in + program.size();
+
+    // as evaluate(), but each register holds a block of values
+    for (; in != end; ++in) {
+
+        float * top = sp - MATHS_BLOCK_SIZE;
+
+        switch (in->code) {
+        case C_CONST:
+            for (int j = 0; j < n; ++j) sp[j] = in->val;
+            sp += MATHS_BLOCK_SIZE;
+            break;
+        case C_LOAD:
+            if (in->slot >= 0) {
+                const float * src = vars + in->slot * MATHS_BLOCK_SIZE;
+                for (int j = 0; j < n; ++j) sp[j] = src[j];
+            } else {
+                float val = *in->ptr;
+                for (int j = 0; j < n; ++j) sp[j] = val;
+            }
+            sp += MATHS_BLOCK_SIZE;
+            break;
+        case C_ADD:
+            sp = top;
+            top -= MATHS_BLOCK_SIZE;
+            for (int j = 0; j < n; ++j) top[j] = top[j] + sp[j];
+            break;
+        case C_SUB:
+            sp = top;
+            top -= MATHS_BLOCK_SIZE;
+            for (int j = 0; j < n; ++j) top[j] = top[j] - sp[j];
+            break;
+        case C_MULT:
+            sp = top;
+            top -= MATHS_BLOCK_SIZE;
+            for (int j = 0; j < n; ++j) top[j] = top[j] * sp[j];
+            break;
+        case C_DIV:
+            sp = top;
+            top -= MATHS_BLOCK_SIZE;
+            for (int j = 0; j < n; ++j) top[j] = top[j] / sp[j];
+            break;
+        case C_NEG:
+            for (int j = 0; j < n; ++j) top[j] = 0 - top[j];
+            break;
+        case C_ZERO_MULT:
+            for (int j = 0; j < n; ++j) top[j] = 0 * top[j];
+            break;
+        case C_ZERO_DIV:
+            for (int j = 0; j < n; ++j) top[j] = 0 / top[j];
+            break;
+        case C_FUNC0:
+            {
+                float val = doFunction(INFINITY, INFINITY, in->val);
+                for (int j = 0; j < n; ++j) sp[j] = val;
+                sp += MATHS_BLOCK_SIZE;
+            }
+            break;
+        case C_FUNC1:
+            blockFunction1(int(in->val), top, n);
+            break;
+        case C_FUNC2:
+            sp = top;
+            top -= MATHS_BLOCK_SIZE;
+            blockFunction2(int(in->val), top, sp, n);
+            break;
+        case C_RAND0:
+            counterRandomUniformBlock(rngs, n, sp);
+            sp += MATHS_BLOCK_SIZE;
+            break;
+        case C_RAND1:
+            counterRandomUniformBlock(rngs, n, top);
+            break;
+        }
+
+    }
+
+    if (sp != base) {
+        const float * top = sp - MATHS_BLOCK_SIZE;
+        for (int j = 0; j < n; ++j) out[j] = top[j];
+    } else {
+        for (int j = 0; j < n; ++j) out[j] = 0.0;
+    }
+}
+
 QString createStack(QString equation, vector <lookup> &varList, vector <valop> * returnStack) {
 
     vector < valop > opstack;
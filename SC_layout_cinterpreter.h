@@ -26,6 +26,7 @@
 #define CINTERPRETER_H
 
 #include "globalHeader.h"
+#include "SC_counterrandom.h"
 
 #include <vector>
 using namespace std;
@@ -76,6 +77,57 @@ struct valop {
     bool isUnary;
 };
 
+// neurons evaluated together by compiledMaths::evaluateBlock()
+#define MATHS_BLOCK_SIZE 16
+
+// a valop stack flattened into straight-line code with the variable slots
+// already resolved, so it can be evaluated many times without rebuilding
+// or copying anything
+class compiledMaths {
+
+public:
+    compiledMaths() {fallback = false;}
+    void compile(const vector <valop> &stack);
+    float evaluate();
+    float evaluate(counterRandom * rng);
+    bool isCompiled() const {return !fallback;}
+    bool reads(const float * ptr) const;
+    void rebind(vector <lookup> &from, vector <lookup> &to);
+    void bindBlock(vector <lookup> &vars);
+    void evaluateBlock(const float * vars, int n, counterRandom * rngs, float * out);
+
+private:
+    enum opcode {
+        C_CONST,
+        C_LOAD,
+        C_ADD,
+        C_SUB,
+        C_MULT,
+        C_DIV,
+        C_NEG,
+        C_ZERO_MULT,
+        C_ZERO_DIV,
+        C_FUNC0,
+        C_FUNC1,
+        C_FUNC2,
+        C_RAND0,
+        C_RAND1
+    };
+    struct instr {
+        opcode code;
+        float val;
+        float * ptr;
+        // the variable loaded, by index, for evaluateBlock()
+        int slot;
+    };
+    vector <instr> program;
+    vector <float> regs;
+    vector <float> blockRegs;
+    // stacks that underflow are left to interpretMaths
+    vector <valop> source;
+    bool fallback;
+};
+
 
 bool isOperation(QString in);
 
@@ -117,7 +169,7 @@ QString doBoolean(int startInd, int endInd, vector <valop> opstackIn, float * ou
 
 QString doBoolBrackets(int startInd, int endInd, vector <valop> opstackIn, float * outVal);
 */
-float interpretMaths(vector <valop>);
+float interpretMaths(const vector <valop> &stack);
 
 QString createStack(QString equation, vector <lookup> &varList, vector <valop> * returnStack);
 
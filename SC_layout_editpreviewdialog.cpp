@@ -23,6 +23,102 @@
 ****************************************************************************/
 
 #include "SC_layout_editpreviewdialog.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+
+/*!
+ * The generation of a preview, on the thread pool. The locations are
+ * gathered as the layout passes them on, for the dialog to take, and the
+ * layout stops at its next run of locations once the job is cancelled.
+ */
+class layoutPreviewJob : public layoutSink
+{
+public:
+    layoutPreviewJob(QSharedPointer<NineMLLayoutData> layout, int numNeurons) :
+        layout(layout), numNeurons(numNeurons), cancelled(false), finished(false) {}
+
+    ~layoutPreviewJob()
+    {
+        // as layoutJob, the values are the job's own
+        for (int i = 0; i < this->layout->StateVariableList.size(); ++i) {
+            delete this->layout->StateVariableList[i];
+        }
+        for (int i = 0; i < this->layout->ParameterList.size(); ++i) {
+            delete this->layout->ParameterList[i];
+        }
+    }
+
+    void run()
+    {
+        QVector <loc> locs;
+        QString errs;
+        this->layout->generateLayoutUncached(this->numNeurons, &locs, errs, true, this);
+        QMutexLocker locker(&this->lock);
+        this->err = errs;
+        this->finished = true;
+    }
+
+    bool addLocations(const loc * locs, int count)
+    {
+        QMutexLocker locker(&this->lock);
+        if (this->cancelled) {
+            return false;
+        }
+        int first = this->arrived.size();
+        this->arrived.resize(first + count);
+        std::copy(locs, locs + count, this->arrived.data() + first);
+        return true;
+    }
+
+    void cancel()
+    {
+        QMutexLocker locker(&this->lock);
+        this->cancelled = true;
+    }
+
+    /*!
+     * Add the locations which have arrived since the last call to shown.
+     * Returns true once the layout is done, with errRet set if it failed.
+     */
+    bool take(QVector <loc> &shown, QString &errRet)
+    {
+        QMutexLocker locker(&this->lock);
+        if (shown.isEmpty()) {
+            // implicitly shared, so this does not copy the locations
+            shown = this->arrived;
+            this->arrived.clear();
+        } else if (!this->arrived.isEmpty()) {
+            shown += this->arrived;
+            this->arrived.clear();
+        }
+        errRet = this->err;
+        return this->finished;
+    }
+
+private:
+    QSharedPointer<NineMLLayoutData> layout;
+    int numNeurons;
+
+    QMutex lock;
+    QVector <loc> arrived;
+    bool cancelled;
+    bool finished;
+    QString err;
+};
+
+namespace {
+    class layoutPreviewRunner : public QRunnable
+    {
+    public:
+        layoutPreviewRunner(QSharedPointer<layoutPreviewJob> job) : job(job) {}
+        void run() {
+            this->job->run();
+        }
+    private:
+        QSharedPointer<layoutPreviewJob> job;
+    };
+}
 
 layoutEditPreviewDialog::layoutEditPreviewDialog(QSharedPointer<NineMLLayout> inSrcNineMLLayout, glConnectionWidget * glConn, QWidget *parent) :
     QDialog(parent)
@@ -32,6 +128,10 @@ layoutEditPreviewDialog::layoutEditPreviewDialog(QSharedPointer<NineMLLayout> in
     glView = glConn;
     QObject::connect(this, SIGNAL(drawLayout(QVector <loc>)), glView, SLOT(drawLocations(QVector <loc>)));
 
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(LAYOUT_PREVIEW_POLL_MS);
+    QObject::connect(pollTimer, SIGNAL(timeout()), this, SLOT(showProgress()));
+
     this->setModal(true);
     this->setMinimumSize(200, 400);
     this->setWindowTitle("Preview layout");
@@ -152,22 +252,53 @@ void layoutEditPreviewDialog::reDraw(QString) {
     }
 
 
-    // ok, data is filled in, now to get the locations
-    QVector <loc> locations;
+    // ok, data is filled in; the job generating the last edit is no
+    // longer wanted
+    if (this->job) {
+        this->job->cancel();
+    }
+    this->job = QSharedPointer<layoutPreviewJob> (new layoutPreviewJob(data, numNeurons));
+    this->shown.clear();
+    // the pool deletes the runner when it is done
+    QThreadPool::globalInstance()->start(new layoutPreviewRunner(this->job));
+    this->pollTimer->start();
+}
 
+layoutEditPreviewDialog::~layoutEditPreviewDialog()
+{
+    if (this->job) {
+        this->job->cancel();
+    }
+}
+
+void layoutEditPreviewDialog::showProgress()
+{
+    if (!this->job) {
+        this->pollTimer->stop();
+        return;
+    }
+
+    int before = this->shown.size();
     QString err;
-    data->generateLayout(numNeurons, &locations, err);
+    bool done = this->job->take(this->shown, err);
+    if (!err.isEmpty()) {
+        // as a layout which fails has no locations
+        this->shown.clear();
+    }
+    if (this->shown.size() != before || done) {
+        emit drawLayout(this->shown);
+    }
+    if (!done) {
+        return;
+    }
 
-    if (err.size() == 0) {
-        emit drawLayout(locations);
-    } else
-    {
-        emit drawLayout(locations);
+    this->pollTimer->stop();
+    this->job.clear();
+    if (!err.isEmpty()) {
         QMessageBox msgBox;
         msgBox.setText(err);
         msgBox.exec();
     }
-
 }
 
 
@@ -30,11 +30,27 @@
 #include "CL_layout_classes.h"
 #include "SC_network_3d_visualiser_panel.h"
 
+class layoutPreviewJob;
+
+/*!
+ * Interval, in ms, at which the locations of a layout being generated for
+ * the preview are shown as they arrive.
+ */
+#define LAYOUT_PREVIEW_POLL_MS 40
+
+/*!
+ * \brief The layoutEditPreviewDialog class previews a layout with values
+ * for its parameters and state variables. The layout is generated on the
+ * thread pool, and its locations are drawn as they arrive, so that a large
+ * layout does not hold up the edits; an edit made while one is being
+ * generated stops it and starts another.
+ */
 class layoutEditPreviewDialog : public QDialog
 {
     Q_OBJECT
 public:
     explicit layoutEditPreviewDialog(QSharedPointer<NineMLLayout>, glConnectionWidget *glConn, QWidget *parent = 0);
+    ~layoutEditPreviewDialog();
 
     
 private:
@@ -42,11 +58,19 @@ private:
     QFormLayout * contentLayoutRef;
     glConnectionWidget * glView;
 
+    // the layout being generated, and the locations of it shown so far
+    QSharedPointer<layoutPreviewJob> job;
+    QVector <loc> shown;
+    QTimer * pollTimer;
+
 signals:
     void drawLayout(QVector <loc>);
     
 public slots:
     void reDraw(QString);
+
+private slots:
+    void showProgress();
     
 };
 
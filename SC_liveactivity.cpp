@@ -0,0 +1,231 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_liveactivity.h"
+#ifdef USE_LIVE_ACTIVITY
+#include "networkserver/cpp/spinemlasyncserver.h"
+#endif
+#include <cstring>
+
+liveActivityReceiver::liveActivityReceiver() :
+    QObject()
+{
+}
+
+liveActivityReceiver::~liveActivityReceiver()
+{
+    for (int i = 0; i < streams.size(); ++i) {
+        delete streams[i];
+    }
+}
+
+int liveActivityReceiver::addStream(const QString &name, int port, int size)
+{
+    stream * s = new stream;
+    s->name = name;
+    s->port = port;
+    s->size = size;
+    s->back.resize(size);
+    s->front.resize(size);
+    s->fresh = false;
+    s->min = 0;
+    s->max = 0;
+    s->steps = 0;
+    s->connected = false;
+    streams.push_back(s);
+    return streams.size()-1;
+}
+
+int liveActivityReceiver::numStreams()
+{
+    return streams.size();
+}
+
+bool liveActivityReceiver::takeFrame(int index, QVector <double> &values, double &min, double &max)
+{
+    stream * s = streams[index];
+    QMutexLocker locker(&lock);
+    if (!s->fresh) {
+        return false;
+    }
+    values.swap(s->front);
+    if (s->front.size() != s->size) {
+        s->front.resize(s->size);
+    }
+    s->fresh = false;
+    min = s->min;
+    max = s->max;
+    return true;
+}
+
+QStringList liveActivityReceiver::status()
+{
+    QMutexLocker locker(&lock);
+    QStringList lines;
+    for (int i = 0; i < streams.size(); ++i) {
+        stream * s = streams[i];
+        QString line = "Live: " + s->name + " ";
+        if (!s->error.isEmpty()) {
+            line += s->error;
+        } else if (s->connected) {
+            line += QString::number(s->steps) + " timesteps received";
+        } else if (s->steps > 0) {
+            line += "finished after " + QString::number(s->steps) + " timesteps";
+        } else {
+            line += "waiting on port " + QString::number(s->port);
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void liveActivityReceiver::start()
+{
+#ifdef USE_LIVE_ACTIVITY
+    for (int i = 0; i < streams.size(); ++i) {
+        int port = streams[i]->port;
+        if (servers.contains(port)) {
+            continue;
+        }
+        spineMLAsyncServer * server = new spineMLAsyncServer(this);
+        connect(server, SIGNAL(connectionReady(spineMLAsyncConnection*)), this, SLOT(connectionReady(spineMLAsyncConnection*)));
+        connect(server, SIGNAL(connectionFinished(spineMLAsyncConnection*)), this, SLOT(connectionFinished(spineMLAsyncConnection*)));
+        servers[port] = server;
+        if (!server->listen(port)) {
+            QMutexLocker locker(&lock);
+            for (int j = 0; j < streams.size(); ++j) {
+                if (streams[j]->port == port) {
+                    streams[j]->error = "could not listen on port " + QString::number(port);
+                }
+            }
+        }
+    }
+#else
+    QMutexLocker locker(&lock);
+    for (int i = 0; i < streams.size(); ++i) {
+        streams[i]->error = "is not available in this build";
+    }
+#endif
+}
+
+void liveActivityReceiver::stop()
+{
+#ifdef USE_LIVE_ACTIVITY
+    QMap <int, spineMLAsyncServer *>::iterator it;
+    for (it = servers.begin(); it != servers.end(); ++it) {
+        it.value()->close();
+        delete it.value();
+    }
+#endif
+    servers.clear();
+    connStreams.clear();
+}
+
+void liveActivityReceiver::connectionReady(spineMLAsyncConnection * conn)
+{
+#ifdef USE_LIVE_ACTIVITY
+    spineMLAsyncServer * server = qobject_cast <spineMLAsyncServer *> (sender());
+    int port = servers.key(server, -1);
+
+    // the output of that name on the port, or the only one there
+    int found = -1;
+    int onPort = 0;
+    int lastOnPort = -1;
+    for (int i = 0; i < streams.size(); ++i) {
+        if (streams[i]->port != port) {
+            continue;
+        }
+        ++onPort;
+        lastOnPort = i;
+        if (streams[i]->name == conn->name()) {
+            found = i;
+        }
+    }
+    if (found < 0 && onPort == 1) {
+        found = lastOnPort;
+    }
+    if (found < 0) {
+        DBG() << "Live activity: no output" << conn->name() << "on port" << port;
+        conn->abort();
+        return;
+    }
+
+    stream * s = streams[found];
+    if (!conn->isSource() || conn->size() != s->size) {
+        QMutexLocker locker(&lock);
+        s->error = "was sent " + QString::number(conn->size()) + " values a timestep, not "
+                + QString::number(s->size);
+        conn->abort();
+        return;
+    }
+
+    connStreams[conn] = found;
+    connect(conn, SIGNAL(framesReceived(spineMLAsyncConnection*,const double*,int)),
+            this, SLOT(framesReceived(spineMLAsyncConnection*,const double*,int)));
+
+    QMutexLocker locker(&lock);
+    s->connected = true;
+    s->error.clear();
+    s->steps = 0;
+#else
+    Q_UNUSED(conn)
+#endif
+}
+
+void liveActivityReceiver::connectionFinished(spineMLAsyncConnection * conn)
+{
+    int index = connStreams.value(conn, -1);
+    connStreams.remove(conn);
+    if (index >= 0) {
+        QMutexLocker locker(&lock);
+        streams[index]->connected = false;
+    }
+}
+
+void liveActivityReceiver::framesReceived(spineMLAsyncConnection * conn, const double * values, int steps)
+{
+    int index = connStreams.value(conn, -1);
+    if (index < 0 || steps < 1) {
+        return;
+    }
+    stream * s = streams[index];
+
+    // the range of every timestep, but only the last is shown
+    double lo = s->steps > 0 ? s->min : values[0];
+    double hi = s->steps > 0 ? s->max : values[0];
+    int count = steps * s->size;
+    for (int i = 0; i < count; ++i) {
+        if (values[i] < lo) lo = values[i];
+        if (values[i] > hi) hi = values[i];
+    }
+    memcpy(s->back.data(), values + (steps-1) * s->size, s->size * sizeof(double));
+
+    QMutexLocker locker(&lock);
+    s->back.swap(s->front);
+    s->fresh = true;
+    s->min = lo;
+    s->max = hi;
+    s->steps += steps;
+}
@@ -0,0 +1,110 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_LIVEACTIVITY_H
+#define SC_LIVEACTIVITY_H
+
+#include "globalHeader.h"
+
+class spineMLAsyncServer;
+class spineMLAsyncConnection;
+
+/*!
+ * \brief The liveActivityReceiver class hosts the network server endpoints
+ * which a running simulation sends its external outputs to, so that the 3D
+ * view can colour neurons as the model runs rather than from its logs.
+ *
+ * Each stream is an analog external output of the experiment: the model
+ * connects to the output's port (with the output's name, so that several
+ * outputs may share a port) and sends frames of size values. The receiver
+ * lives on its own thread, where the frames are read, and keeps only the
+ * latest timestep of each stream. That is written into a back buffer and
+ * swapped with the front one under the lock, so the GUI takes the newest
+ * complete frame once a redraw without ever waiting on the network, and a
+ * slow redraw simply skips timesteps.
+ *
+ * Add the streams, move the receiver to its thread and invoke start(); call
+ * stop() with a blocking queued connection before the thread is quit.
+ */
+class liveActivityReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    liveActivityReceiver();
+    ~liveActivityReceiver();
+
+    /*!
+     * Listen for the output name on port, of size values a timestep, and
+     * return the index of its stream. Only before start().
+     */
+    int addStream(const QString &name, int port, int size);
+    int numStreams();
+
+    /*!
+     * If a frame of stream has arrived since the last call, swap it into
+     * values, with the least and greatest value the stream has sent, and
+     * return true.
+     */
+    bool takeFrame(int stream, QVector <double> &values, double &min, double &max);
+
+    /*!
+     * A line for each stream, saying what it is waiting for or has received.
+     */
+    QStringList status();
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void connectionReady(spineMLAsyncConnection * conn);
+    void connectionFinished(spineMLAsyncConnection * conn);
+    void framesReceived(spineMLAsyncConnection * conn, const double * values, int steps);
+
+private:
+    struct stream {
+        QString name;
+        int port;
+        int size;
+        // written only on the receiver's thread
+        QVector <double> back;
+        // the rest are guarded by lock
+        QVector <double> front;
+        bool fresh;
+        double min;
+        double max;
+        qint64 steps;
+        bool connected;
+        QString error;
+    };
+
+    QMutex lock;
+    QVector <stream *> streams;
+    // one server for each port, and the stream each connection feeds
+    QMap <int, spineMLAsyncServer *> servers;
+    QMap <spineMLAsyncConnection *, int> connStreams;
+};
+
+#endif // SC_LIVEACTIVITY_H
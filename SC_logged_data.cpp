@@ -26,18 +26,38 @@
 // qcustomplot widget
 
 #include "SC_logged_data.h"
+#include "SC_profiler.h"
+#include "SC_settings.h"
+#include "SC_ioservice.h"
 #include <QXmlStreamReader>
+#include <QSet>
+#include <algorithm>
+#include <cstring>
 
 logData::logData(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    accessLock(QMutex::Recursive)
 {
     this->timeStep = 0.1;
+    this->mappedLog = NULL;
+    this->mappedLogSize = 0;
+    this->chunked = false;
+    this->chunkRows = 0;
+    this->chunkedRowCount = 0;
+    this->chunkCache.setMaxCost(LOG_CHUNK_CACHE_BYTES);
+    this->heldEnd = 0;
+    this->heldEndBefore = 0;
+    this->clearEventIndex();
 }
 
 void logData::deleteLogFile (void)
 {
+    QMutexLocker locker(&accessLock);
+    this->unmapLogFile();
+    this->clearEventIndex();
     QDir dir;
     dir.remove(this->logFileXMLname);
+    dir.remove(this->eventIndexFileName());
     dir.remove(this->logFile.fileName());
 }
 
@@ -48,21 +68,7 @@ double logData::getMax()
     }
 
     // no max, must calculate
-    double tempMax = -Q_INFINITY;
-    QVector < double > rowData;
-    rowData.push_back(-Q_INFINITY);
-    int i = 0;
-    while (rowData.size() > 0) {
-        for (int j = 0; j < rowData.size(); ++j) {
-            if (rowData[j] > tempMax && rowData[j] < Q_INFINITY) {
-                tempMax = rowData[j];
-            }
-        }
-        //qDebug() << rowData[0] << rowData[1]<< rowData[2]<< rowData[3]<< rowData[4]<< rowData[5]<< rowData[6]<< rowData[7]<< rowData[8]<< rowData[9];}
-        rowData = getRow(i);
-        ++i;
-    }
-    max = tempMax;
+    this->calculateRange();
     return max;
 }
 
@@ -73,47 +79,713 @@ double logData::getMin()
     }
 
     // no min, must calculate
+    this->calculateRange();
+    return min;
+}
+
+void logData::calculateRange()
+{
+    double tempMax = -Q_INFINITY;
     double tempMin = Q_INFINITY;
-    QVector < double > rowData;
-    rowData.push_back(Q_INFINITY);
-    int i = 0;
-    while (rowData.size() > 0) {
-        for (int j = 0; j < rowData.size(); ++j) {
-            if (rowData[j] < tempMin) {
-                tempMin = rowData[j];
+
+    colSamples.fill(0, columns.size());
+    colMean.fill(0, columns.size());
+    colM2.fill(0, columns.size());
+
+    if (dataFormat == BINARY) {
+
+        // scan each column in blocks rather than a row at a time
+        QVector < double > block;
+        for (int c = 0; c < columns.size(); ++c) {
+            for (qint64 first = 0; ; first += LOG_EXTRACT_BLOCK_ROWS) {
+                if (!this->extractColumn(c, block, first, LOG_EXTRACT_BLOCK_ROWS) || block.isEmpty()) {
+                    break;
+                }
+                for (int i = 0; i < block.size(); ++i) {
+                    if (block[i] > tempMax && block[i] < Q_INFINITY) {
+                        tempMax = block[i];
+                    }
+                    if (block[i] < tempMin) {
+                        tempMin = block[i];
+                    }
+                    this->addColumnSample(c, block[i]);
+                }
             }
         }
-        rowData = getRow(i);
-        ++i;
+
+    } else {
+
+        QVector < double > rowData;
+        rowData.push_back(Q_INFINITY);
+        int i = 0;
+        while (rowData.size() > 0) {
+            for (int j = 0; j < rowData.size(); ++j) {
+                if (rowData[j] > tempMax && rowData[j] < Q_INFINITY) {
+                    tempMax = rowData[j];
+                }
+                if (rowData[j] < tempMin) {
+                    tempMin = rowData[j];
+                }
+                // the first row is only there to start the loop
+                if (i > 0) {
+                    this->addColumnSample(j, rowData[j]);
+                }
+            }
+            rowData = getRow(i);
+            ++i;
+        }
     }
+
+    max = tempMax;
     min = tempMin;
-    return min;
+}
+
+void logData::addColumnSample(int colNum, double value)
+{
+    // also skips NaN
+    if (colNum >= colSamples.size() || !(value > -Q_INFINITY && value < Q_INFINITY)) {
+        return;
+    }
+    qint64 n = ++colSamples[colNum];
+    double delta = value - colMean[colNum];
+    colMean[colNum] += delta / n;
+    colM2[colNum] += delta * (value - colMean[colNum]);
+}
+
+bool logData::getColumnStats(QVector < double > &means, QVector < double > &variances)
+{
+    means.clear();
+    variances.clear();
+    if (dataClass != ANALOGDATA) {
+        return false;
+    }
+    if (max == Q_INFINITY || colSamples.size() != columns.size()) {
+        this->calculateRange();
+    }
+    means.resize(columns.size());
+    variances.resize(columns.size());
+    for (int c = 0; c < columns.size(); ++c) {
+        means[c] = colMean[c];
+        variances[c] = colSamples[c] > 1 ? colM2[c] / (colSamples[c] - 1) : 0;
+    }
+    return true;
+}
+
+/*!
+ * Copy the values of type T found every stride bytes from base into out,
+ * converting to double. Kept as a simple counted loop so the compiler can
+ * turn it into vector gathers.
+ */
+template <typename T>
+static void gatherColumn(const uchar * base, qint64 rows, int stride, double * out)
+{
+    for (qint64 r = 0; r < rows; ++r) {
+        T val;
+        memcpy(&val, base + r*stride, sizeof(T));
+        out[r] = (double) val;
+    }
+}
+
+bool logData::extractColumn(int colNum, QVector < double > &out, qint64 firstRow, qint64 numRows)
+{
+    PROFILE_SCOPE("logData::extractColumn");
+    QMutexLocker locker(&accessLock);
+    out.clear();
+
+    if (colNum < 0 || colNum >= columns.size()) {
+        return false;
+    }
+    if (!calculateBinaryDataStride() || binaryDataStride == 0) {
+        return false;
+    }
+    int offset = calculateBinaryDataOffset(colNum);
+    if (offset == -1) {
+        return false;
+    }
+
+    dataType type = columns[colNum].type;
+    if (type == TYPE_INT64 || type == TYPE_STRING) {
+        // not supported currently
+        return false;
+    }
+
+    // only whole rows; an empty log has no data yet, which is not an error
+    qint64 rows = this->binaryRowCount() - firstRow;
+    if (numRows >= 0 && numRows < rows) {
+        rows = numRows;
+    }
+    if (rows <= 0) {
+        return true;
+    }
+
+    // a compressed log is gathered a chunk at a time
+    out.resize(rows);
+    for (qint64 done = 0; done < rows; ) {
+        qint64 n = rows - done;
+        const uchar * data = this->binaryRows(firstRow + done, n);
+        if (data == NULL) {
+            out.clear();
+            return false;
+        }
+        const uchar * base = data + offset;
+        if (type == TYPE_DOUBLE) {
+            gatherColumn<double>(base, n, binaryDataStride, out.data() + done);
+        } else if (type == TYPE_FLOAT) {
+            gatherColumn<float>(base, n, binaryDataStride, out.data() + done);
+        } else {
+            gatherColumn<int>(base, n, binaryDataStride, out.data() + done);
+        }
+        done += n;
+    }
+    return true;
+}
+
+const uchar * logData::mapLogFile(qint64 &size)
+{
+    residencyManager::touch(this);
+    size = logFile.size();
+
+    // remap if the simulator has written more since we last looked
+    if (mappedLog != NULL && size != mappedLogSize) {
+        this->unmapLogFile();
+    }
+    if (mappedLog == NULL && size > 0) {
+        mappedLog = logFile.map(0, size);
+        if (mappedLog != NULL) {
+            mappedLogSize = size;
+        }
+    }
+    if (mappedLog == NULL) {
+        size = 0;
+    }
+    return mappedLog;
+}
+
+void logData::unmapLogFile()
+{
+    if (mappedLog != NULL) {
+        logFile.unmap(mappedLog);
+        mappedLog = NULL;
+        mappedLogSize = 0;
+    }
+}
+
+/*!
+ * Read the <LogCompression> element of a logrep, which lists the chunks of a
+ * compressed binary log:
+ *
+ *   <LogCompression type="zlib" rowsPerChunk="4096" rows="100000">
+ *     <Chunk offset="0" size="30512"/>
+ *     ...
+ *   </LogCompression>
+ *
+ * Each chunk holds rowsPerChunk rows (the last may hold fewer), as they
+ * would be laid out in an uncompressed log, compressed as by qCompress(),
+ * and is found size bytes from offset in the log file. A compressed log is
+ * written whole, so it is not followed while the simulator runs.
+ */
+bool logData::readChunkIndex(QXmlStreamReader * reader)
+{
+    if (reader->attributes().value("type").toString() != "zlib") {
+        qDebug() << "Unknown log compression" << reader->attributes().value("type").toString();
+        return false;
+    }
+    bool rowsOk, countOk;
+    chunkRows = reader->attributes().value("rowsPerChunk").toString().toLongLong(&rowsOk);
+    chunkedRowCount = reader->attributes().value("rows").toString().toLongLong(&countOk);
+    if (!rowsOk || !countOk || chunkRows <= 0 || chunkedRowCount < 0) {
+        qDebug() << "Bad log compression rows";
+        return false;
+    }
+
+    while (reader->readNextStartElement()) {
+        if (reader->name() != "Chunk") {
+            qDebug() << "Unknown tag name " << reader->name();
+            return false;
+        }
+        bool offsetOk, sizeOk;
+        qint64 offset = reader->attributes().value("offset").toString().toLongLong(&offsetOk);
+        int size = reader->attributes().value("size").toString().toInt(&sizeOk);
+        if (!offsetOk || !sizeOk || offset < 0 || size <= 0) {
+            qDebug() << "Bad log chunk";
+            return false;
+        }
+        chunkOffsets.push_back(offset);
+        chunkSizes.push_back(size);
+        reader->skipCurrentElement();
+    }
+
+    if (chunkOffsets.size() != (chunkedRowCount + chunkRows - 1) / chunkRows) {
+        qDebug() << "The log chunks do not hold" << chunkedRowCount << "rows";
+        return false;
+    }
+    chunked = true;
+    return true;
+}
+
+qint64 logData::numRows()
+{
+    QMutexLocker locker(&accessLock);
+    if (dataFormat != BINARY || !calculateBinaryDataStride() || binaryDataStride == 0) {
+        return -1;
+    }
+    return this->binaryRowCount();
+}
+
+bool logData::getColumn(int colNum, QVector < double > &out, qint64 firstRow, qint64 numRows)
+{
+    return this->extractColumn(colNum, out, firstRow, numRows);
+}
+
+/*!
+ * The number of whole rows in a binary log; binaryDataStride must be set.
+ */
+qint64 logData::binaryRowCount()
+{
+    if (chunked) {
+        return chunkedRowCount;
+    }
+    return logFile.size() / binaryDataStride;
+}
+
+/*!
+ * The rows of a binary log from firstRow, as they are laid out in an
+ * uncompressed log. rows is cut down to those which lie together, which
+ * for a compressed log is to the end of the chunk, and the pointer is good
+ * until the next call. Returns NULL if the rows can't be read.
+ */
+const uchar * logData::binaryRows(qint64 firstRow, qint64 &rows)
+{
+    qint64 total = this->binaryRowCount();
+    if (firstRow < 0 || firstRow >= total) {
+        rows = 0;
+        return NULL;
+    }
+    rows = qMin(rows, total - firstRow);
+
+    qint64 size;
+    const uchar * data = this->mapLogFile(size);
+
+    if (!chunked) {
+        if (data == NULL) {
+            rows = 0;
+        }
+        return data == NULL ? NULL : data + firstRow*binaryDataStride;
+    }
+
+    int chunk = (int) (firstRow / chunkRows);
+    QByteArray * unpacked = chunkCache.object(chunk);
+    if (unpacked == NULL) {
+        if (data == NULL || chunkOffsets[chunk] + chunkSizes[chunk] > size) {
+            qDebug() << "Log chunk" << chunk << "is past the end of" << logFile.fileName();
+            rows = 0;
+            return NULL;
+        }
+        QByteArray rowData = qUncompress(data + chunkOffsets[chunk], chunkSizes[chunk]);
+        qint64 expected = qMin(chunkRows, total - chunk*chunkRows) * binaryDataStride;
+        if (rowData.size() != expected) {
+            qDebug() << "Log chunk" << chunk << "of" << logFile.fileName() << "is corrupt";
+            rows = 0;
+            return NULL;
+        }
+        // a chunk too big for the cache is held until the next one is read
+        if (rowData.size() > chunkCache.maxCost()) {
+            chunkScratch = rowData;
+            unpacked = &chunkScratch;
+        } else {
+            unpacked = new QByteArray(rowData);
+            chunkCache.insert(chunk, unpacked, unpacked->size());
+        }
+    }
+
+    qint64 inChunk = firstRow - chunk*chunkRows;
+    rows = qMin(rows, chunkRows - inChunk);
+    return (const uchar *) unpacked->constData() + inChunk*binaryDataStride;
+}
+
+void logData::clearEventIndex()
+{
+    eventIndexedTo = 0;
+    eventIndexValid = true;
+    eventTimesSorted = true;
+    lastEventTime = -Q_INFINITY;
+    eventBucketStarts.clear();
+    spikeCounts.clear();
+    rateBins.clear();
+}
+
+QString logData::eventIndexFileName()
+{
+    return logFile.fileName() + LOG_EVENT_INDEX_SUFFIX;
+}
+
+int logData::eventBucket(double t)
+{
+    // also catches NaN
+    if (!(t > 0) || timeStep <= 0) {
+        return 0;
+    }
+    // allow for times written out to fewer places than the timestep needs
+    double b = floor(t / timeStep + 1e-6);
+    if (b >= LOG_EVENT_INDEX_MAX_BUCKETS - 1) {
+        return LOG_EVENT_INDEX_MAX_BUCKETS - 1;
+    }
+    return (int) b;
+}
+
+void logData::indexEvent(double t, qint64 offset, int neuron)
+{
+    if (dataClass == EVENTDATA) {
+        if (neuron >= 0 && neuron < LOG_ACTIVITY_MAX_NEURONS) {
+            if (spikeCounts.size() <= neuron) {
+                spikeCounts.resize(neuron + 1);
+            }
+            ++spikeCounts[neuron];
+        }
+        // also catches NaN
+        if (t >= 0) {
+            int bin = (int) qMin(floor(t / LOG_ACTIVITY_BIN_MS), (double) LOG_ACTIVITY_MAX_BINS - 1);
+            if (rateBins.size() <= bin) {
+                rateBins.resize(bin + 1);
+            }
+            ++rateBins[bin];
+        }
+    }
+
+    if (t < lastEventTime) {
+        // the buckets only hold for a log in time order; read the whole
+        // log for each window from now on
+        eventTimesSorted = false;
+        eventBucketStarts.clear();
+    }
+    if (t > lastEventTime) {
+        lastEventTime = t;
+    }
+    if (!eventTimesSorted) {
+        return;
+    }
+    int b = this->eventBucket(t);
+    while (eventBucketStarts.size() <= b) {
+        eventBucketStarts.push_back(offset);
+    }
+}
+
+/*!
+ * Split a line of a text log into its columns. Returns false for a blank line.
+ */
+bool logData::splitLine(const QByteArray &raw, QStringList &cols)
+{
+    QString line(raw);
+    while (line.endsWith('\n') || line.endsWith('\r')) {
+        line.chop(1);
+    }
+    if (line.isEmpty()) {
+        return false;
+    }
+    if (dataFormat == CSVFormat) {
+        line.remove(" ");
+        cols = line.split(",");
+    } else {
+        line = line.simplified();
+        cols = line.split(" ");
+    }
+    return true;
+}
+
+bool logData::updateEventIndex()
+{
+    if (!eventIndexValid) {
+        return false;
+    }
+
+    if (dataFormat == BINARY) {
+
+        if (!calculateBinaryDataStride() || binaryDataStride == 0 || columns.size() < 2) {
+            eventIndexValid = false;
+            return false;
+        }
+
+        // the neurons are read in the same pass for the activity counts
+        qint64 rows = this->binaryRowCount();
+        QVector < double > block;
+        QVector < double > neurons;
+        for (qint64 first = eventIndexedTo / binaryDataStride; first < rows; first += LOG_EXTRACT_BLOCK_ROWS) {
+            qint64 n = qMin((qint64) LOG_EXTRACT_BLOCK_ROWS, rows - first);
+            if (!this->extractColumn(0, block, first, n) || block.size() != n
+                || (dataClass == EVENTDATA && (!this->extractColumn(1, neurons, first, n) || neurons.size() != n))) {
+                eventIndexValid = false;
+                eventBucketStarts.clear();
+                return false;
+            }
+            for (int i = 0; i < block.size(); ++i) {
+                this->indexEvent(block[i], (first + i) * binaryDataStride, dataClass == EVENTDATA ? (int) neurons[i] : -1);
+            }
+        }
+        eventIndexedTo = rows * binaryDataStride;
+        return true;
+    }
+
+    if (logFile.size() <= eventIndexedTo) {
+        return true;
+    }
+
+    logFile.seek(eventIndexedTo);
+
+    while (!logFile.atEnd()) {
+
+        QByteArray raw = logFile.readLine();
+
+        // a partial last line is picked up next time
+        if (!raw.endsWith('\n')) {
+            break;
+        }
+        qint64 offset = eventIndexedTo;
+        eventIndexedTo += raw.size();
+
+        QStringList cols;
+        if (!this->splitLine(raw, cols)) {
+            continue;
+        }
+
+        // parse
+        if (cols.size() != (int) columns.size() || cols.size() < 2) {
+            qDebug() << "Col size incorrect on import";
+            eventIndexValid = false;
+            eventBucketStarts.clear();
+            return false;
+        }
+
+        this->indexEvent(cols[0].toDouble(), offset, dataClass == EVENTDATA ? cols[1].toInt() : -1);
+    }
+
+    return true;
+}
+
+/*!
+ * A checksum of the last bytes of the log before indexedTo, which are the
+ * same for as long as the log is only appended to.
+ */
+quint16 logData::eventIndexCheck(qint64 indexedTo)
+{
+    // offsets into a compressed log are past its chunks, but it is only
+    // ever written whole, so its end is checked instead
+    if (chunked) {
+        indexedTo = logFile.size();
+    }
+    qint64 from = qMax((qint64) 0, indexedTo - LOG_EVENT_INDEX_CHECK_BYTES);
+    if (!logFile.seek(from)) {
+        return 0;
+    }
+    QByteArray tail = logFile.read(indexedTo - from);
+    return qChecksum(tail.constData(), tail.size());
+}
+
+bool logData::loadEventIndex()
+{
+    QFile f(this->eventIndexFileName());
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic, version;
+    qint32 format, stride;
+    double step, last;
+    qint64 indexedTo;
+    quint16 check;
+    bool sorted;
+    QVector < qint64 > starts;
+    QVector < qint64 > counts;
+    QVector < qint64 > bins;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != LOG_EVENT_INDEX_MAGIC || version != LOG_EVENT_INDEX_VERSION) {
+        return false;
+    }
+    in >> format >> stride >> step >> indexedTo >> check >> sorted >> last >> starts >> counts >> bins;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    // the index must be for this log as it is laid out now, and the log must
+    // not have been rewritten since
+    if (dataFormat == BINARY && (!calculateBinaryDataStride() || stride != binaryDataStride)) {
+        return false;
+    }
+    if (format != (qint32) dataFormat || step != timeStep
+        || indexedTo < 0 || indexedTo > (dataFormat == BINARY ? this->binaryRowCount()*binaryDataStride : logFile.size())
+        || this->eventIndexCheck(indexedTo) != check) {
+        return false;
+    }
+
+    eventIndexedTo = indexedTo;
+    eventIndexValid = true;
+    eventTimesSorted = sorted;
+    lastEventTime = last;
+    eventBucketStarts = starts;
+    spikeCounts = counts;
+    rateBins = bins;
+    return true;
+}
+
+void logData::saveEventIndex()
+{
+    if (!eventIndexValid || eventIndexedTo == 0) {
+        return;
+    }
+
+    QFile f(this->eventIndexFileName());
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        // not fatal; the index is built again next time
+        qDebug() << "Couldn't save event index" << this->eventIndexFileName();
+        return;
+    }
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << (quint32) LOG_EVENT_INDEX_MAGIC << (quint32) LOG_EVENT_INDEX_VERSION
+        << (qint32) dataFormat << (qint32) (dataFormat == BINARY ? binaryDataStride : 0)
+        << timeStep << eventIndexedTo << this->eventIndexCheck(eventIndexedTo)
+        << eventTimesSorted << lastEventTime << eventBucketStarts << spikeCounts << rateBins;
+}
+
+/*!
+ * Find the events with from < time < to, looking only at the timesteps of the
+ * log which hold them. Indices are neuron indices.
+ */
+bool logData::getEvents(double from, double to, QVector < double > &times, QVector < double > &indices)
+{
+    PROFILE_SCOPE("logData::getEvents");
+    QMutexLocker locker(&accessLock);
+    times.clear();
+    indices.clear();
+
+    if (!this->updateEventIndex()) {
+        return false;
+    }
+
+    // the buckets either side are read too, so rounding in the bucket
+    // numbers can't lose an event
+    qint64 start = 0;
+    qint64 end = eventIndexedTo;
+    if (eventTimesSorted) {
+        int first = this->eventBucket(from);
+        int last = this->eventBucket(to) + 1;
+        start = first < eventBucketStarts.size() ? eventBucketStarts[first] : eventIndexedTo;
+        end = last < eventBucketStarts.size() ? eventBucketStarts[last] : eventIndexedTo;
+    }
+    if (start >= end) {
+        return true;
+    }
+
+    if (dataFormat == BINARY) {
+        QVector < double > t;
+        QVector < double > idx;
+        qint64 rows = (end - start) / binaryDataStride;
+        for (qint64 first = start / binaryDataStride, done = 0; done < rows; done += LOG_EXTRACT_BLOCK_ROWS) {
+            qint64 n = qMin((qint64) LOG_EXTRACT_BLOCK_ROWS, rows - done);
+            if (!this->extractColumn(0, t, first + done, n) || !this->extractColumn(1, idx, first + done, n)) {
+                return false;
+            }
+            for (int i = 0; i < t.size() && i < idx.size(); ++i) {
+                if (t[i] > from && t[i] < to) {
+                    times.push_back(t[i]);
+                    indices.push_back(idx[i]);
+                }
+            }
+        }
+        return true;
+    }
+
+    logFile.seek(start);
+    while (logFile.pos() < end && !logFile.atEnd()) {
+        QByteArray raw = logFile.readLine();
+        QStringList cols;
+        if (!this->splitLine(raw, cols) || cols.size() < 2) {
+            continue;
+        }
+        double t = cols[0].toDouble();
+        if (t > from && t < to) {
+            times.push_back(t);
+            indices.push_back(cols[1].toInt());
+        }
+    }
+
+    return true;
+}
+
+bool logData::getFiringRates(QVector < double > &neurons, QVector < double > &rates)
+{
+    QMutexLocker locker(&accessLock);
+    neurons.clear();
+    rates.clear();
+    if (dataClass != EVENTDATA || !this->updateEventIndex()) {
+        return false;
+    }
+
+    // over the run, or as far as it has got
+    double duration = endTime > 0 ? endTime : lastEventTime;
+    if (!(duration > 0)) {
+        duration = timeStep;
+    }
+    for (int i = 0; i < eventIndices.size(); ++i) {
+        int n = eventIndices[i];
+        neurons.push_back(n);
+        rates.push_back(n >= 0 && n < spikeCounts.size() ? spikeCounts[n] * 1000.0 / duration : 0);
+    }
+    return true;
+}
+
+bool logData::getPopulationRate(QVector < double > &times, QVector < double > &rates)
+{
+    QMutexLocker locker(&accessLock);
+    times.clear();
+    rates.clear();
+    if (dataClass != EVENTDATA || !this->updateEventIndex()) {
+        return false;
+    }
+
+    times.resize(rateBins.size());
+    rates.resize(rateBins.size());
+    for (int k = 0; k < rateBins.size(); ++k) {
+        times[k] = k * LOG_ACTIVITY_BIN_MS;
+        rates[k] = rateBins[k] * 1000.0 / LOG_ACTIVITY_BIN_MS;
+    }
+    return true;
 }
 
 QVector < double > logData::getRow(int rowNum)
 {
+    PROFILE_SCOPE("logData::getRow");
+    QMutexLocker locker(&accessLock);
     QVector < double > rowData;
 
     // is not analog return empty
     //if (this->dataClass != ANALOGDATA)
     //    return rowData;
 
+    // events, and text logs, give the indices of the events in the timestep
+    if (this->dataClass == EVENTDATA || dataFormat != BINARY) {
+        double desiredTimeMin = this->timeStep*rowNum-1.0-this->timeStep/2.0;
+        double desiredTimeMax = this->timeStep*rowNum+this->timeStep/2.0;
+        QVector < double > times;
+        this->getEvents(desiredTimeMin, desiredTimeMax, times, rowData);
+        return rowData;
+    }
+
     // get data
     switch (dataFormat) {
     case BINARY:
     {
-        if (!calculateBinaryDataStride()) {
+        if (!calculateBinaryDataStride() || binaryDataStride == 0 || rowNum < 0) {
             return rowData;
         }
 
-        // stream data from file
-        QDataStream data(&logFile);
-        data.device()->seek(0);
-        // offset into file
-        data.skipRawData(binaryDataStride*rowNum);
-
-        // if we skip to the end of the file
-        if (data.atEnd()) {
+        // if we are past the end of the file return nothing
+        qint64 rows = 1;
+        const uchar * row = this->binaryRows(rowNum, rows);
+        if (row == NULL) {
             return rowData;
         }
 
@@ -126,49 +798,35 @@ QVector < double > logData::getRow(int rowNum)
             }
         }
 
+        double * dest;
         switch (columns[0].type) {
         case TYPE_DOUBLE:
-        {
-            if (allLogged) {
-                rowData.resize(columns.size());
-                data.readRawData((char *) &rowData[0], sizeof(double)*rowData.size());
-            } else {
-                QVector < double > tempDbl;
-                tempDbl.resize(columns.size());
-                data.readRawData((char *) &tempDbl[0], sizeof(double)*tempDbl.size());
-                // a good first guess
-                vector <double> temp = rowData.toStdVector();
-                temp.resize(columns.back().index+1, Q_INFINITY);
-                rowData = QVector <double>::fromStdVector(temp);
-                for (int i = 0; i < columns.size(); ++i) {
-                    if (static_cast<int>(columns[i].index) > rowData.size()) {
-                        vector <double> temp = rowData.toStdVector();
-                        temp.resize(columns[i].index+1, Q_INFINITY);
-                        rowData = QVector <double>::fromStdVector(temp);
-                    }
-                    rowData[columns[i].index] = tempDbl[i];
-                }
-            }
-            return rowData;
-        }
-        break;
         case TYPE_FLOAT:
+        case TYPE_INT32:
         {
-            QVector < float > tempFloat;
-            tempFloat.resize(columns.size());
-            data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-            data.readRawData((char *) &tempFloat[0], sizeof(float)*tempFloat.size());
-            // a good first guess
-            vector <double> temp = rowData.toStdVector();
-            temp.resize(columns.back().index+1, Q_INFINITY);
-            rowData = QVector <double>::fromStdVector(temp);
-            for (int i = 0; i < columns.size(); ++i) {
-                if (static_cast<int>(columns[i].index) > rowData.size()) {
-                    vector <double> temp = rowData.toStdVector();
-                    temp.resize(columns[i].index+1, Q_INFINITY);
-                    rowData = QVector <double>::fromStdVector(temp);
+            // all logged rows hold the indices in order, so gather straight
+            // into the row, otherwise gather and then scatter to the indices
+            QVector < double > tempRow;
+            if (allLogged) {
+                rowData.resize(columns.size());
+                dest = rowData.data();
+            } else {
+                tempRow.resize(columns.size());
+                dest = tempRow.data();
+            }
+            int typeSize = binaryDataStride / columns.size();
+            if (columns[0].type == TYPE_DOUBLE) {
+                gatherColumn<double>(row, columns.size(), typeSize, dest);
+            } else if (columns[0].type == TYPE_FLOAT) {
+                gatherColumn<float>(row, columns.size(), typeSize, dest);
+            } else {
+                gatherColumn<int>(row, columns.size(), typeSize, dest);
+            }
+            if (!allLogged) {
+                rowData.fill(Q_INFINITY, loggedIndices.last()+1);
+                for (int i = 0; i < columns.size(); ++i) {
+                    rowData[columns[i].index] = tempRow[i];
                 }
-                rowData[columns[i].index] = tempFloat[i];
             }
             return rowData;
         }
@@ -180,72 +838,11 @@ QVector < double > logData::getRow(int rowNum)
 
         }
         break;
-        case TYPE_INT32:
-        {
-            QVector < int > tempInt;
-            tempInt.resize(columns.size());
-            data.readRawData((char *) &tempInt[0], sizeof(int)*tempInt.size());
-            // a good first guess
-            vector <double> temp = rowData.toStdVector();
-            temp.resize(columns.back().index+1, Q_INFINITY);
-            rowData = QVector <double>::fromStdVector(temp);
-            for (int i = 0; i < columns.size(); ++i) {
-                if (static_cast<int>(columns[i].index) > rowData.size()) {
-                    vector <double> temp = rowData.toStdVector();
-                    temp.resize(columns[i].index+1, Q_INFINITY);
-                    rowData = QVector <double>::fromStdVector(temp);
-                }
-                rowData[columns[i].index] = tempInt[i];
-            }
-            return rowData;
-        }
-        break;
         case TYPE_STRING:
             return rowData;
         } // end switch (columns[0].type)
         break;
     }
-    case CSVFormat:
-    case SSVFormat:
-    {
-        // read line by line
-        QTextStream data(&logFile);
-        data.device()->seek(0);
-
-        float desiredTimeMin = this->timeStep*rowNum-1.0-this->timeStep/2.0;
-        float desiredTimeMax = this->timeStep*rowNum+this->timeStep/2.0;
-
-        // read a line
-        while (!data.atEnd()) {
-
-            // get line
-            QString line = data.readLine();
-
-            // divide up
-            QStringList cols;
-            if (dataFormat == CSVFormat) {
-                line.remove(" ");
-                cols = line.split(",");
-            }
-            else if (dataFormat == SSVFormat) {
-                line = line.simplified();
-                cols = line.split(" ");
-            }
-
-            // parse
-            if (cols.size() != (int) columns.size()) {
-                qDebug() << "Col size incorrect on import";
-                rowData.clear();
-                return rowData;
-            }
-
-            // for each entry with the desired timerange, add the index to the list
-            if (cols[0].toDouble() > desiredTimeMin && cols[0].toDouble() < desiredTimeMax) {
-                rowData.push_back(cols[1].toInt());
-            }
-
-        }
-     }
     default:
         // do nothing in these cases.
         break;
@@ -255,6 +852,7 @@ QVector < double > logData::getRow(int rowNum)
 }
 
 bool logData::plotLine(QCustomPlot *plot, QMdiSubWindow* msw, int colNum, int update) {
+    PROFILE_SCOPE("logData::plotLine");
 
     // if no plot give up. FIXME - could get plot from msw. That's always where it comes from.
     if (plot == NULL) {
@@ -271,177 +869,594 @@ bool logData::plotLine(QCustomPlot *plot, QMdiSubWindow* msw, int colNum, int up
     // Don't need this->plots anymore? Or used as temporary storage only?
     this->plots.insert (plot, msw);
 
-    // clear existing data;
-    colData[colNum].clear();
-
     // get data
     switch (dataFormat) {
     case BINARY:
     {
-        if (!calculateBinaryDataStride()) {
+        if (!this->readColumn(colNum)) {
             return false;
         }
-        int offset = calculateBinaryDataOffset(colNum);
-        if (offset == -1) {
-            return false;
+        if (colFollowed.size() < colData.size()) {
+            colFollowed.resize(colData.size());
         }
+        colFollowed[colNum] = true;
+        heldEnd = qMax(heldEnd, ((double) colData[colNum].size())*timeStep);
+        break;
+    } // end case BINARY
+    case CSVFormat:
+    case SSVFormat:
+        colData[colNum].clear();
+        colHeld[colNum] = 0;
+        this->buildPyramid(colNum);
+        break;
+    default:
+        // oops, bad dataType
+        return false;
+    }
 
-        // stream data from file
-        QDataStream data(&logFile);
-        data.device()->seek(0);
-        // offset into file
-        data.skipRawData(offset);
-        switch (columns[colNum].type) {
-        case TYPE_DOUBLE:
-        {
-            double tempDbl;
-            while (data.readRawData((char *) &tempDbl, sizeof(tempDbl)) != -1) {
-                // add to data
-                colData[colNum].push_back(tempDbl);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(double));
-                if (data.atEnd())
-                    break;
-            }
-            break;
+    QCPRange fullRange(0, ((double) colData[colNum].size())*timeStep);
+    logRegistry::touchColumn(this, colNum);
+
+    if (update == -1) {
+        // add graph and setup data and name
+        DBG() << "plot->addGraph called";
+        plot->addGraph();
+        this->setLineData(plot->graph(plot->graphCount()-1), colNum, fullRange, plot->axisRect()->width());
+        plot->graph(plot->graphCount()-1)->setName("Index " + QString::number(columns[colNum].index));
+
+        // add properties to graph so we know what it came from
+        plot->graph(plot->graphCount()-1)->setProperty("type", "linePlot");
+        plot->graph(plot->graphCount()-1)->setProperty("source", logFileXMLname);
+        plot->graph(plot->graphCount()-1)->setProperty("index", colNum);
+
+        // axis labels
+        plot->xAxis->setLabel("Time (ms)");
+        plot->yAxis->setLabel(columns[colNum].heading + " (" + columns[colNum].dims + ")");
+
+        // alternate colours
+        QPen pen;
+        pen.setColor((Qt::GlobalColor) (7+(plot->graphCount()-1)%11));
+        plot->graph(plot->graphCount()-1)->setPen(pen);
+
+        // fit all if not an update
+        plot->rescaleAxes();
+
+
+    } else {
+        DBG() << "plot->graph(update) called";
+        this->setLineData(plot->graph(update), colNum, plot->xAxis->range(), plot->axisRect()->width());
+    }
+
+    // refetch the right level of detail on zoom and pan
+    connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(plotRangeChanged(QCPRange)), Qt::UniqueConnection);
+
+    plot->legend->setVisible(false); // fixme, make this an option
+
+    // title
+    QCPPlotTitle* t = (QCPPlotTitle*)0;
+    if (plot->plotLayout()->rowCount() == 1) {
+        plot->plotLayout()->insertRow(0); // inserts an empty row above the default axis rect
+        plot->plotLayout()->addElement(0, 0, new QCPPlotTitle(plot, this->logName));
+        t = (QCPPlotTitle*)plot->plotLayout()->element (0, 0);
+
+    } else {
+        // update title as it's empty
+        t = (QCPPlotTitle*)plot->plotLayout()->element (0, 0);
+        if (t->text().isEmpty()) {
+            t->setText (this->logName);
         }
-        case TYPE_FLOAT:
-        {
-            float tempFloat;
-            data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-            while (data.readRawData((char *) &tempFloat, sizeof(tempFloat)) != -1) {
-                // add to data
-                colData[colNum].push_back((double) tempFloat);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(float));
-                if (data.atEnd())
-                    break;
-            }
-            break;
+    }
+    // Set font size based on text length here.
+    QFont f = t->font();
+    int len = this->logName.size();
+    int fs = 15; // original default for plots
+    if (len <= 24) {
+        fs = 15;
+    } else if (len > 24 && len <= 32) {
+        fs = 12;
+    } else if (len > 32 && len <= 43) {
+        fs = 10;
+    } else {
+        fs = 8;
+    }
+
+    if (f.pointSize() != fs) {
+        f.setPointSize(fs);
+        t->setFont(f);
+    }
+
+    // redraw
+    plot->replot();
+
+    // Ensure that when destroyed, the relevant plot will be removed. (no longer required)
+    //connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()));
+
+    return true;
+}
+
+bool logData::readColumn(int colNum)
+{
+    PROFILE_SCOPE("logData::readColumn");
+    QMutexLocker locker(&accessLock);
+    if (colNum < 0 || colNum >= colData.size()) {
+        return false;
+    }
+
+    // another plot of the column, or a logLoader, may have read it already
+    if (colReady[colNum] && colData[colNum].size() == colHeld[colNum]
+        && colHeld[colNum] == this->binaryRowCount()) {
+        return true;
+    }
+
+    colData[colNum].clear();
+    if (!this->extractColumn(colNum, colData[colNum])) {
+        return false;
+    }
+    colHeld[colNum] = colData[colNum].size();
+    // summarise the column so long logs are drawn from a coarser level
+    this->buildPyramid(colNum);
+    colReady[colNum] = true;
+    return true;
+}
+
+void logData::adoptColumns(logData * from)
+{
+    QMutexLocker locker(&accessLock);
+    if (from->columns.size() != columns.size() || from->colData.size() != colData.size()) {
+        return;
+    }
+    if (colPyramids.size() < colData.size()) {
+        colPyramids.resize(colData.size());
+    }
+    for (int c = 0; c < colData.size() && c < from->colPyramids.size(); ++c) {
+        if (!from->colReady[c]) {
+            continue;
         }
-        case TYPE_INT64:
-        {
-            // not supported currently
-                return false;
-            int tempInt;
-            while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                // add to data
-                colData[colNum].push_back((double) tempInt);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(long int));
-                if (data.atEnd())
-                    break;
-            }
+        colData[c].swap(from->colData[c]);
+        qSwap(colPyramids[c], from->colPyramids[c]);
+        colHeld[c] = from->colHeld[c];
+        colReady[c] = true;
+    }
+    if (from->max != Q_INFINITY) {
+        max = from->max;
+        min = from->min;
+        colSamples = from->colSamples;
+        colMean = from->colMean;
+        colM2 = from->colM2;
+    }
+}
+
+/*!
+ * Summarise colData[colNum] from sample from onward into the pyramid, so
+ * that rows appended to a column only rebuild the buckets they fall in.
+ */
+void logData::buildPyramid(int colNum, int from)
+{
+    if (colPyramids.size() < colData.size()) {
+        colPyramids.resize(colData.size());
+    }
+    columnPyramid &pyr = colPyramids[colNum];
+    if (from <= 0) {
+        pyr.mins.clear();
+        pyr.maxs.clear();
+        from = 0;
+    }
+
+    // each level reduces the one below it (the raw data for the first)
+    for (int level = 0; ; ++level) {
+
+        int n = level == 0 ? colData[colNum].size() : pyr.mins[level-1].size();
+        if (n <= LOG_PYRAMID_FACTOR) {
             break;
         }
-        case TYPE_INT32:
-        {
-            int tempInt;
-            while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                // add to data
-                colData[colNum].push_back((double) tempInt);
-                // skip to next row
-                data.skipRawData(binaryDataStride-sizeof(int));
-                if (data.atEnd())
-                    break;
+        if (level == pyr.mins.size()) {
+            pyr.mins.push_back(QVector < double > ());
+            pyr.maxs.push_back(QVector < double > ());
+            from = 0;
+        }
+        const QVector < double > &lowMins = level == 0 ? colData[colNum] : pyr.mins[level-1];
+        const QVector < double > &lowMaxs = level == 0 ? colData[colNum] : pyr.maxs[level-1];
+        QVector < double > &mins = pyr.mins[level];
+        QVector < double > &maxs = pyr.maxs[level];
+
+        int buckets = (n + LOG_PYRAMID_FACTOR - 1) / LOG_PYRAMID_FACTOR;
+        mins.resize(buckets);
+        maxs.resize(buckets);
+
+        // the bucket holding from may have been partly filled before
+        int firstBucket = from / LOG_PYRAMID_FACTOR;
+        for (int b = firstBucket; b < buckets; ++b) {
+            int first = b * LOG_PYRAMID_FACTOR;
+            int last = qMin(first + LOG_PYRAMID_FACTOR, n);
+            double mn = lowMins[first];
+            double mx = lowMaxs[first];
+            for (int i = first + 1; i < last; ++i) {
+                if (lowMins[i] < mn) mn = lowMins[i];
+                if (lowMaxs[i] > mx) mx = lowMaxs[i];
             }
-            break;
+            mins[b] = mn;
+            maxs[b] = mx;
         }
-        case TYPE_STRING:
+        from = firstBucket;
+    }
+}
+
+bool logData::appendNewRows()
+{
+    PROFILE_SCOPE("logData::appendNewRows");
+    QMutexLocker locker(&accessLock);
+    this->heldEndBefore = this->heldEnd;
+
+    // event and text logs are read by time window from their index
+    if (dataClass == EVENTDATA || dataFormat != BINARY) {
+        if (!chunked && logFile.size() < eventIndexedTo) {
+            this->clearEventIndex();
+            this->heldEnd = 0;
+        }
+        if (!this->updateEventIndex()) {
             return false;
-            break;
         }
-        // what about default:?
-    } // end case BINARY
-    case CSVFormat:
-    case SSVFormat:
-        break;
-    default:
-        // oops, bad dataType
+        if (lastEventTime > this->heldEnd) {
+            this->heldEnd = lastEventTime;
+        }
+        return this->heldEnd != this->heldEndBefore;
+    }
+
+    if (!calculateBinaryDataStride() || binaryDataStride == 0) {
         return false;
     }
+    qint64 rows = this->binaryRowCount();
+
+    bool grew = false;
+    QVector < double > block;
+    for (int c = 0; c < colFollowed.size() && c < colData.size(); ++c) {
+        if (!colFollowed[c]) {
+            continue;
+        }
+        int held = colHeld[c];
+        if (rows < held) {
+            // a new run has replaced the log
+            colData[c].clear();
+            held = 0;
+        }
+        if (rows == held) {
+            continue;
+        }
+        // the last buckets of the pyramid are rebuilt from the column, so a
+        // column which was dropped is read back first
+        if (colData[c].size() != held && !this->extractColumn(c, colData[c], 0, held)) {
+            continue;
+        }
+        if (!this->extractColumn(c, block, held)) {
+            continue;
+        }
+        colData[c] += block;
+        colHeld[c] = colData[c].size();
+        this->buildPyramid(c, held);
+        logRegistry::touchColumn(this, c);
+        grew = true;
+    }
+    this->heldEnd = ((double) rows)*timeStep;
+    return grew;
+}
+
+void logData::updatePlot(QCustomPlot * plot)
+{
+    PROFILE_SCOPE("logData::updatePlot");
+    QCPRange range = plot->xAxis->range();
+
+    // keep following the end of the run if it was in view, growing the
+    // range if it starts from the beginning and sliding it otherwise
+    if (range.upper >= heldEndBefore && heldEnd > range.upper) {
+        if (range.lower <= 0) {
+            range.upper = heldEnd;
+        } else {
+            double shift = heldEnd - range.upper;
+            range.lower += shift;
+            range.upper += shift;
+        }
+        plot->xAxis->setRange(range);
+    }
+
+    for (int i = 0; i < plot->graphCount(); ++i) {
+        QCPGraph * graph = plot->graph(i);
+        if (graph->property("source").toString() != logFileXMLname) {
+            continue;
+        }
+        QString type = graph->property("type").toString();
+        if (type == "linePlot") {
+            int colNum = graph->property("index").toInt();
+            if (colNum >= 0 && colNum < colData.size()) {
+                this->setLineData(graph, colNum, range, plot->axisRect()->width());
+                graph->rescaleValueAxis(true);
+            }
+        } else if (type == "rasterPlot") {
+            // only a window reaching past what was read before has changed
+            double span = range.size();
+            if (range.upper + span > heldEndBefore) {
+                this->setRasterData(graph, graph->property("indices").toList(), range.lower - span, range.upper + span);
+            }
+        } else if (type == "firingRates" || type == "populationRate") {
+            // the counts have already been extended with the index
+            this->setActivityData(graph, type);
+            graph->rescaleValueAxis(true);
+        }
+    }
+
+    plot->replot();
+}
+
+/*!
+ * Give graph the samples of column colNum that cover range (with a range's
+ * width of margin either side for panning), using the coarsest pyramid level
+ * that still gives at least one min/max pair per pixel.
+ */
+void logData::setLineData(QCPGraph * graph, int colNum, const QCPRange &range, int pixels)
+{
+    if (pixels < 1) {
+        pixels = 1;
+    }
+
+    int held = colHeld[colNum];
+    double span = range.size();
+    int first = qMax(0, (int) floor((range.lower - span) / timeStep));
+    int last = qMin(held, (int) ceil((range.upper + span) / timeStep) + 1);
+    if (first >= last) {
+        first = 0;
+        last = held;
+    }
+
+    // find the level: samples per bucket grows by LOG_PYRAMID_FACTOR each level
+    int visible = (int) ceil(span / timeStep);
+    int level = -1;
+    int bucketSize = 1;
+    while (colNum < colPyramids.size() && level + 1 < colPyramids[colNum].mins.size()
+           && visible / (bucketSize * LOG_PYRAMID_FACTOR) >= pixels) {
+        ++level;
+        bucketSize *= LOG_PYRAMID_FACTOR;
+    }
 
-    //
     QVector < double > times;
-    for (int i = 0; i < colData[colNum].size(); ++i) {
-        times.push_back(((double) i)*timeStep);
+    QVector < double > values;
+
+    if (level == -1) {
+        // full resolution, from the column if it is still held and
+        // otherwise just the rows in view from the log
+        QVector < double > window;
+        const double * raw = NULL;
+        if (colData[colNum].size() == held) {
+            raw = colData[colNum].constData() + first;
+            logRegistry::touchColumn(this, colNum);
+        } else if (this->extractColumn(colNum, window, first, last - first)) {
+            last = first + window.size();
+            raw = window.constData();
+        } else {
+            last = first;
+        }
+        times.reserve(last - first);
+        values.reserve(last - first);
+        for (int i = first; i < last; ++i) {
+            times.push_back(((double) i)*timeStep);
+            values.push_back(raw[i - first]);
+        }
+    } else {
+        const QVector < double > &mins = colPyramids[colNum].mins[level];
+        const QVector < double > &maxs = colPyramids[colNum].maxs[level];
+        int bFirst = first / bucketSize;
+        int bLast = qMin(mins.size(), (last + bucketSize - 1) / bucketSize);
+        times.reserve(2*(bLast - bFirst));
+        values.reserve(2*(bLast - bFirst));
+        // the min and max of each bucket as two points across the bucket
+        for (int b = bFirst; b < bLast; ++b) {
+            double t = ((double) b*bucketSize)*timeStep;
+            times.push_back(t);
+            values.push_back(mins[b]);
+            times.push_back(t + ((double) bucketSize/2)*timeStep);
+            values.push_back(maxs[b]);
+        }
     }
 
-    if (update == -1) {
-        // add graph and setup data and name
-        DBG() << "plot->addGraph called";
+    graph->setData(times, values);
+}
+
+void logData::plotRangeChanged(const QCPRange &range)
+{
+    QCPAxis * axis = qobject_cast < QCPAxis * > (sender());
+    if (axis == NULL) {
+        return;
+    }
+    QCustomPlot * plot = axis->parentPlot();
+
+    for (int i = 0; i < plot->graphCount(); ++i) {
+        QCPGraph * graph = plot->graph(i);
+        if (graph->property("source").toString() != logFileXMLname) {
+            continue;
+        }
+        QString type = graph->property("type").toString();
+        if (type == "rasterPlot") {
+            // re-read only when the window goes outside what is held, or
+            // is a small part of it
+            double span = range.size();
+            double from = range.lower - span;
+            double to = range.upper + span;
+            double heldFrom = graph->property("eventsFrom").toDouble();
+            double heldTo = graph->property("eventsTo").toDouble();
+            if (from >= heldFrom && to <= heldTo
+                && heldTo - heldFrom <= LOG_RASTER_REFETCH_RATIO * (to - from)) {
+                continue;
+            }
+            this->setRasterData(graph, graph->property("indices").toList(), from, to);
+            continue;
+        }
+        if (type != "linePlot") {
+            continue;
+        }
+        int colNum = graph->property("index").toInt();
+        if (colNum < 0 || colNum >= colData.size()) {
+            continue;
+        }
+        this->setLineData(graph, colNum, range, axis->axisRect()->width());
+    }
+}
+
+/*!
+ * Give graph the events with from < time < to of the neurons at the positions
+ * indices in eventIndices, reading only those timesteps of the log.
+ */
+bool logData::setRasterData(QCPGraph * graph, const QList < QVariant > &indices, double from, double to)
+{
+    QVector < double > times;
+    QVector < double > neurons;
+    if (!this->getEvents(from, to, times, neurons)) {
+        return false;
+    }
+
+    // usually every logged neuron is shown, and then there is nothing to drop
+    QSet < int > wanted;
+    for (int i = 0; i < indices.size(); ++i) {
+        int pos = indices[i].toInt();
+        if (pos >= 0 && pos < eventIndices.size()) {
+            wanted.insert(eventIndices[pos]);
+        }
+    }
+    if (wanted.size() < eventIndices.size()) {
+        int kept = 0;
+        for (int i = 0; i < times.size(); ++i) {
+            if (wanted.contains((int) neurons[i])) {
+                times[kept] = times[i];
+                neurons[kept] = neurons[i];
+                ++kept;
+            }
+        }
+        times.resize(kept);
+        neurons.resize(kept);
+    }
+
+    graph->setData(times, neurons);
+    graph->setProperty("eventsFrom", from);
+    graph->setProperty("eventsTo", to);
+    return true;
+}
+
+bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVariant > indices, int update) {
+    PROFILE_SCOPE("logData::plotRaster");
+
+    // if no plot give up
+    if (plot == NULL) {
+        return false;
+    }
+
+    this->plots.insert (plot, msw);
+
+    if (columns.size() != 2 && columns.size() != 3) {
+        qDebug() << "Not 2 cols (spike log) or 3 cols (impulse log)";
+        return false;
+    }
+
+    // add graph and setup data and name, or update existing
+    DBG() << "plot-> functions to be called";
+    if (update == -1) {
+
         plot->addGraph();
-        plot->graph(plot->graphCount()-1)->setData(times, colData[colNum]);
-        plot->graph(plot->graphCount()-1)->setName("Index " + QString::number(columns[colNum].index));
+        QCPGraph * graph = plot->graph(plot->graphCount()-1);
+
+        // the whole run is shown to start with, held with the same margin as
+        // on a zoom so that setting the range below does not read it again
+        double from = endTime > 0 ? -endTime : -Q_INFINITY;
+        double to = endTime > 0 ? 2*endTime : Q_INFINITY;
+        if (!this->setRasterData(graph, indices, from, to)) {
+            plot->removeGraph(graph);
+            return false;
+        }
+        heldEnd = qMax(heldEnd, lastEventTime);
+        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDisc, 1));
+        graph->setLineStyle(QCPGraph::lsNone);
 
         // add properties to graph so we know what it came from
-        plot->graph(plot->graphCount()-1)->setProperty("type", "linePlot");
-        plot->graph(plot->graphCount()-1)->setProperty("source", logFileXMLname);
-        plot->graph(plot->graphCount()-1)->setProperty("index", colNum);
+        graph->setProperty("type", "rasterPlot");
+        graph->setProperty("source", logFileXMLname);
+        QVariant var(indices);
+        graph->setProperty("indices", var);
 
         // axis labels
         plot->xAxis->setLabel("Time (ms)");
-        plot->yAxis->setLabel(columns[colNum].heading + " (" + columns[colNum].dims + ")");
+        plot->yAxis->setLabel("Index");
 
         // alternate colours
         QPen pen;
         pen.setColor((Qt::GlobalColor) (7+(plot->graphCount()-1)%11));
-        plot->graph(plot->graphCount()-1)->setPen(pen);
-
-        // fit all if not an update
-        plot->rescaleAxes();
+        graph->setPen(pen);
 
+        plot->xAxis->setRange(0, endTime);
+        plot->yAxis->setRange(-0.5, eventIndices.size()-0.5);
+        plot->yAxis->setTickStep(1.0);
 
     } else {
-        DBG() << "plot->graph(update) called";
-        plot->graph(update)->setData(times, colData[colNum]);
+        // the log may have grown, so read the current window again
+        QCPRange range = plot->xAxis->range();
+        if (!this->setRasterData(plot->graph(update), indices,
+                                 range.lower - range.size(), range.upper + range.size())) {
+            return false;
+        }
     }
 
-    plot->legend->setVisible(false); // fixme, make this an option
+    // re-read the events in view on zoom and pan
+    connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(plotRangeChanged(QCPRange)), Qt::UniqueConnection);
 
     // title
-    QCPPlotTitle* t = (QCPPlotTitle*)0;
     if (plot->plotLayout()->rowCount() == 1) {
         plot->plotLayout()->insertRow(0); // inserts an empty row above the default axis rect
         plot->plotLayout()->addElement(0, 0, new QCPPlotTitle(plot, this->logName));
-        t = (QCPPlotTitle*)plot->plotLayout()->element (0, 0);
-
     } else {
-        // update title as it's empty
-        t = (QCPPlotTitle*)plot->plotLayout()->element (0, 0);
+        QCPPlotTitle* t = (QCPPlotTitle*)plot->plotLayout()->element (0, 0);
         if (t->text().isEmpty()) {
             t->setText (this->logName);
         }
     }
-    // Set font size based on text length here.
-    QFont f = t->font();
-    int len = this->logName.size();
-    int fs = 15; // original default for plots
-    if (len <= 24) {
-        fs = 15;
-    } else if (len > 24 && len <= 32) {
-        fs = 12;
-    } else if (len > 32 && len <= 43) {
-        fs = 10;
-    } else {
-        fs = 8;
-    }
-
-    if (f.pointSize() != fs) {
-        f.setPointSize(fs);
-        t->setFont(f);
-    }
 
     // redraw
     plot->replot();
 
-    // Ensure that when destroyed, the relevant plot will be removed. (no longer required)
-    //connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()));
+    connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()));
 
     return true;
 }
 
-bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVariant > indices, int update) {
+/*!
+ * Give graph the summary type of the log, as it stands.
+ */
+bool logData::setActivityData(QCPGraph * graph, const QString &type)
+{
+    QVector < double > keys;
+    QVector < double > values;
+    if (type == "firingRates") {
+        if (!this->getFiringRates(keys, values)) {
+            return false;
+        }
+        graph->setData(keys, values);
+    } else if (type == "populationRate") {
+        if (!this->getPopulationRate(keys, values)) {
+            return false;
+        }
+        graph->setData(keys, values);
+    } else if (type == "columnMeans") {
+        QVector < double > variances;
+        if (!this->getColumnStats(values, variances)) {
+            return false;
+        }
+        for (int c = 0; c < columns.size(); ++c) {
+            keys.push_back(columns[c].index);
+            variances[c] = sqrt(variances[c]);
+        }
+        graph->setDataValueError(keys, values, variances);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool logData::plotActivity(QCustomPlot * plot, QMdiSubWindow* msw, const QString &type, int update) {
+    PROFILE_SCOPE("logData::plotActivity");
 
     // if no plot give up
     if (plot == NULL) {
@@ -450,171 +1465,56 @@ bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVarian
 
     this->plots.insert (plot, msw);
 
-    // clear existing data;
-    colData[0].clear();
-    colData[1].clear();
-
-    // get data
-    for (int colNum = 0; colNum < 2; ++colNum) {
-        switch (dataFormat) {
-        case BINARY:
-        {
-            if (!calculateBinaryDataStride())
-                return false;
-            int offset = calculateBinaryDataOffset(colNum);
-            if (offset == -1)
-                return false;
-            // stream data from file
-            QDataStream data(&logFile);
-            data.device()->seek(0);
-            // offset into file
-            data.skipRawData(offset);
-            switch (columns[colNum].type) {
-            case TYPE_DOUBLE:
-            {
-                double tempDbl;
-                while (data.readRawData((char *) &tempDbl, sizeof(tempDbl)) != -1) {
-                    // add to data
-                    colData[colNum].push_back(tempDbl);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(double));
-                    if (data.atEnd())
-                        break;
-                }
-            }
-                break;
-            case TYPE_FLOAT:
-            {
-                float tempFloat;
-                data.setFloatingPointPrecision(QDataStream::SinglePrecision);
-                while (data.readRawData((char *) &tempFloat, sizeof(tempFloat)) != -1) {
-                    // add to data
-                    colData[colNum].push_back((double) tempFloat);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(float));
-                    if (data.atEnd())
-                        break;
-                }
-            }
-                break;
-            case TYPE_INT64:
-            {
-                // not supported currently
-                    return false;
-                int tempInt;
-                while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                    // add to data
-                    colData[colNum].push_back((double) tempInt);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(long int));
-                    if (data.atEnd())
-                        break;
-                }
-            }
-                break;
-            case TYPE_INT32:
-            {
-                int tempInt;
-                while (data.readRawData((char *) &tempInt, sizeof(tempInt)) != -1) {
-                    // add to data
-                    colData[colNum].push_back((double) tempInt);
-                    // skip to next row
-                    data.skipRawData(binaryDataStride-sizeof(int));
-                    if (data.atEnd())
-                        break;
-                }
-            }
-                break;
-            case TYPE_STRING:
-                return false;
-            }
-        }
-            break;
-        case CSVFormat:
-        case SSVFormat:
-        {
-            // read line by line
-            QTextStream data(&logFile);
-            data.device()->seek(0);
-
-            // read a line
-            while (!data.atEnd()) {
-
-                // get line
-                QString line = data.readLine();
-
-                // divide up
-                QStringList cols;
-                if (dataFormat == CSVFormat) {
-                    line.remove(" ");
-                    cols = line.split(",");
-                }
-                else if (dataFormat == SSVFormat) {
-                    line = line.simplified();
-                    cols = line.split(" ");
-                }
-
-                // parse
-                if (cols.size() != (int) columns.size()) {
-                    qDebug() << "Col size incorrect on import";
-                    return false;
-                }
-
-                for (int i = 0; i < indices.size(); ++i) {
-                    if (cols[1].toInt() == indices[i].toInt()) {
-                        colData[0].push_back(cols[0].toDouble());
-                        colData[1].push_back(cols[1].toDouble());
-                    }
-                }
-
-            }
-        }
-
-            break;
-        default:
-            // oops, bad dataType
-            qDebug() << "Bad dataType";
+    if (update != -1) {
+        if (!this->setActivityData(plot->graph(update), type)) {
             return false;
-
         }
+        plot->graph(update)->rescaleValueAxis();
+        plot->replot();
+        return true;
     }
 
-    if (colData.size() != 2 && colData.size() != 3) {
-        qDebug() << "Not 2 cols (spike log) or 3 cols (impulse log)";
+    plot->addGraph();
+    QCPGraph * graph = plot->graph(plot->graphCount()-1);
+    if (!this->setActivityData(graph, type)) {
+        plot->removeGraph(graph);
         return false;
     }
 
-    // add graph and setup data and name, or update existing
-    DBG() << "plot-> functions to be called";
-    if (update == -1) {
-
-        plot->addGraph();
-        plot->graph(plot->graphCount()-1)->setData(colData[0], colData[1]);
-        plot->graph(plot->graphCount()-1)->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDisc, 1));
-        plot->graph(plot->graphCount()-1)->setLineStyle(QCPGraph::lsNone);
+    // add properties to graph so we know what it came from
+    graph->setProperty("type", type);
+    graph->setProperty("source", logFileXMLname);
 
-        // add properties to graph so we know what it came from
-        plot->graph(plot->graphCount()-1)->setProperty("type", "rasterPlot");
-        plot->graph(plot->graphCount()-1)->setProperty("source", logFileXMLname);
-        QVariant var(indices);
-        plot->graph(plot->graphCount()-1)->setProperty("indices", var);
+    // alternate colours
+    QPen pen;
+    pen.setColor((Qt::GlobalColor) (7+(plot->graphCount()-1)%11));
+    graph->setPen(pen);
 
-        // axis labels
+    if (type == "populationRate") {
         plot->xAxis->setLabel("Time (ms)");
-        plot->yAxis->setLabel("Index");
-
-        // alternate colours
-        QPen pen;
-        pen.setColor((Qt::GlobalColor) (7+(plot->graphCount()-1)%11));
-        plot->graph(plot->graphCount()-1)->setPen(pen);
-
+        plot->yAxis->setLabel("Population rate (Hz)");
+        graph->setLineStyle(QCPGraph::lsStepLeft);
         plot->xAxis->setRange(0, endTime);
-        plot->yAxis->setRange(-0.5, eventIndices.size()-0.5);
-        plot->yAxis->setTickStep(1.0);
-
     } else {
-        plot->graph(update)->setData(colData[0], colData[1]);
+        // the x axis is of neurons, not time, so it is left out when the
+        // view unifies the time axes of its plots
+        plot->setProperty("indexAxis", true);
+        plot->xAxis->setLabel("Index");
+        if (type == "firingRates") {
+            plot->yAxis->setLabel("Firing rate (Hz)");
+            graph->setLineStyle(QCPGraph::lsImpulse);
+            graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDisc, 3));
+        } else {
+            plot->yAxis->setLabel("Mean");
+            graph->setLineStyle(QCPGraph::lsNone);
+            graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDisc, 3));
+            graph->setErrorType(QCPGraph::etValue);
+        }
+        graph->rescaleKeyAxis();
+        QCPRange keys = plot->xAxis->range();
+        plot->xAxis->setRange(keys.lower - 0.5, keys.upper + 0.5);
     }
+    graph->rescaleValueAxis();
 
     // title
     if (plot->plotLayout()->rowCount() == 1) {
@@ -630,8 +1530,6 @@ bool logData::plotRaster(QCustomPlot * plot, QMdiSubWindow* msw, QList < QVarian
     // redraw
     plot->replot();
 
-    connect(plot, SIGNAL(destroyed()), this, SLOT(onPlotDestroyed()));
-
     return true;
 }
 
@@ -688,6 +1586,8 @@ int logData::calculateBinaryDataOffset(int colNum) {
 
 bool logData::setupFromXML() {
 
+    QMutexLocker locker(&accessLock);
+
     // no log specified
     if (logFileXMLname.isEmpty()) {
         qDebug() << "XML filename not set";
@@ -709,9 +1609,15 @@ bool logData::setupFromXML() {
     // clear up
     columns.clear();
     eventIndices.clear();
+    loggedIndices = indexSet();
     allLogged = false;
     min = Q_INFINITY;
     max = Q_INFINITY;
+    chunked = false;
+    chunkOffsets.clear();
+    chunkSizes.clear();
+    chunkCache.clear();
+    chunkScratch.clear();
 
     // temp config data
     QString logFileName;
@@ -750,6 +1656,13 @@ bool logData::setupFromXML() {
                                 return false;
                             }
 
+                        } else if (reader->name() == "LogCompression") {
+
+                            if (!this->readChunkIndex(reader)) {
+                                delete reader;
+                                return false;
+                            }
+
                         } else if (reader->name() == "LogEndTime") {
 
                             QString tempStr = reader->readElementText();
@@ -883,14 +1796,12 @@ bool logData::setupFromXML() {
                             // as unclosed
                             reader->readNextStartElement();
 
-                            // add columns
-                            vector <column> temp = columns.toStdVector();
-                            temp.resize(size, newCol);
-                            columns = QVector<column>::fromStdVector(temp);
-
-                            // setup indices
-                            for (int i = 0; i < columns.size(); ++i)
-                                columns[i].index = i;
+                            // add columns, with the indices in order
+                            columns.reserve(columns.size() + size);
+                            for (int i = 0; i < size; ++i) {
+                                newCol.index = columns.size();
+                                columns.push_back(newCol);
+                            }
 
                         } else if (reader->name() == "TimeStep") {
 
@@ -939,6 +1850,13 @@ bool logData::setupFromXML() {
                                 return false;
                             }
 
+                        } else if (reader->name() == "LogCompression") {
+
+                            if (!this->readChunkIndex(reader)) {
+                                delete reader;
+                                return false;
+                            }
+
                         } else if (reader->name() == "LogEndTime") {
 
                             QString tempStr = reader->readElementText();
@@ -1069,6 +1987,13 @@ bool logData::setupFromXML() {
 
     }
 
+    // only binary logs are compressed
+    if (chunked && dataFormat != BINARY) {
+        qDebug() << "A compressed log must be binary";
+        delete reader;
+        return false;
+    }
+
     // load the log file
     // get local dir
     QString dirPath = logFileXMLname;
@@ -1080,6 +2005,10 @@ bool logData::setupFromXML() {
 #endif
     QDir localDir(dirPath);
 
+    // anything mapped or indexed belongs to the previous setup
+    this->unmapLogFile();
+    this->clearEventIndex();
+
     if (!logFile.isOpen()) {
         logFile.setFileName(localDir.absoluteFilePath(logFileName));
         if( !logFile.open( QIODevice::ReadOnly ) ) {
@@ -1087,10 +2016,37 @@ bool logData::setupFromXML() {
             qDebug() << "Couldn't open log file " << localDir.absoluteFilePath(logFileName);
             delete reader;
             return false;}
+        // its columns are read for plotting as soon as it is chosen
+        ioService::hintReadAhead(logFile.fileName());
+    }
+
+    // index the timesteps of event and text logs, starting from the index
+    // saved last time if it is still good
+    if (dataClass == EVENTDATA || dataFormat != BINARY) {
+        if (!this->loadEventIndex()) {
+            this->clearEventIndex();
+        }
+        qint64 indexedTo = eventIndexedTo;
+        if (this->updateEventIndex() && eventIndexedTo != indexedTo) {
+            this->saveEventIndex();
+        }
+    }
+
+    if (dataClass == EVENTDATA) {
+        loggedIndices = allLogged ? indexSet::all() : indexSet::fromIndices(eventIndices);
+    } else {
+        QVector < int > indices(columns.size());
+        for (int i = 0; i < columns.size(); ++i) {
+            indices[i] = columns[i].index;
+        }
+        loggedIndices = indexSet::fromIndices(indices);
     }
 
     // resize data carriers
     colData.resize(columns.size());
+    colHeld.resize(columns.size());
+    // what is held may be from before the log was written again
+    colReady.fill(false, columns.size());
 
     int lastsep = logFileName.lastIndexOf(QDir::separator());
     if (lastsep != -1) {
@@ -1103,3 +2059,289 @@ bool logData::setupFromXML() {
     delete reader;
     return true;
 }
+
+void logData::dropColumn(int colNum)
+{
+    if (colNum < colData.size()) {
+        colData[colNum] = QVector < double > ();
+    }
+}
+
+qint64 logData::residentBytes() const
+{
+    QMutexLocker locker(const_cast < QMutex * > (&accessLock));
+    qint64 bytes = mappedLogSize + chunkCache.totalCost();
+    for (int i = 0; i < colData.size(); ++i) {
+        bytes += (qint64) colData[i].size() * sizeof(double);
+    }
+    return bytes;
+}
+
+void logData::evictResident()
+{
+    QMutexLocker locker(&accessLock);
+    for (int i = 0; i < colData.size(); ++i) {
+        this->dropColumn(i);
+    }
+    this->unmapLogFile();
+    chunkCache.clear();
+}
+
+/*!
+ * The memory held by a column, which may have gone if the log has been set up
+ * again with fewer columns.
+ */
+static qint64 heldColumnBytes(const logData * log, int colNum)
+{
+    return colNum < log->colData.size() ? (qint64) log->colData[colNum].size() * sizeof(double) : 0;
+}
+
+QHash < QString, logRegistry::entry > logRegistry::entries;
+QList < QPair < logData *, int > > logRegistry::columnsUsed;
+
+logData * logRegistry::acquire(const QString &logFileXMLname)
+{
+    QDateTime modified = QFileInfo(logFileXMLname).lastModified();
+    QHash < QString, entry >::iterator it = entries.find(logFileXMLname);
+    if (it != entries.end()) {
+        // a new run has written the report again
+        if (it->modified != modified) {
+            it->modified = modified;
+            it->log->setupFromXML();
+        }
+        ++it->refs;
+        return it->log;
+    }
+
+    logData * log = new logData();
+    log->logFileXMLname = logFileXMLname;
+    if (!log->setupFromXML()) {
+        delete log;
+        return (logData *) 0;
+    }
+    entry e;
+    e.log = log;
+    e.refs = 1;
+    e.modified = modified;
+    entries.insert(logFileXMLname, e);
+    return log;
+}
+
+logData * logRegistry::adopt(logData * log)
+{
+    QHash < QString, entry >::iterator it = entries.find(log->logFileXMLname);
+    if (it != entries.end()) {
+        delete log;
+        QString logFileXMLname = it.key();
+        return acquire(logFileXMLname);
+    }
+    entry e;
+    e.log = log;
+    e.refs = 1;
+    e.modified = QFileInfo(log->logFileXMLname).lastModified();
+    entries.insert(log->logFileXMLname, e);
+    return log;
+}
+
+void logRegistry::retain(logData * log)
+{
+    if (log == (logData *) 0) {
+        return;
+    }
+    QHash < QString, entry >::iterator it = entries.find(log->logFileXMLname);
+    if (it != entries.end() && it->log == log) {
+        ++it->refs;
+    }
+}
+
+void logRegistry::release(logData * log)
+{
+    if (log == (logData *) 0) {
+        return;
+    }
+    QHash < QString, entry >::iterator it = entries.find(log->logFileXMLname);
+    if (it == entries.end() || it->log != log) {
+        // not from the registry
+        return;
+    }
+    if (--it->refs > 0) {
+        return;
+    }
+    entries.erase(it);
+    for (int i = 0; i < columnsUsed.size(); ++i) {
+        if (columnsUsed[i].first == log) {
+            columnsUsed.removeAt(i--);
+        }
+    }
+    delete log;
+}
+
+void logRegistry::touchColumn(logData * log, int colNum)
+{
+    QPair < logData *, int > used(log, colNum);
+    residencyManager::touch(log);
+    columnsUsed.removeOne(used);
+    columnsUsed.push_back(used);
+
+    qint64 limit = (qint64) settingsCache::logCacheLimitMB() * 1024 * 1024;
+    if (limit <= 0) {
+        return;
+    }
+    qint64 total = 0;
+    for (int i = 0; i < columnsUsed.size(); ++i) {
+        total += heldColumnBytes(columnsUsed[i].first, columnsUsed[i].second);
+    }
+
+    // the column just used is kept, however large
+    while (total > limit && columnsUsed.size() > 1) {
+        QPair < logData *, int > oldest = columnsUsed.takeFirst();
+        total -= heldColumnBytes(oldest.first, oldest.second);
+        oldest.first->dropColumn(oldest.second);
+    }
+}
+
+logLoader::logLoader(const QString &logFileXMLname, const QVector < int > &columns) :
+    logFileXMLname(logFileXMLname),
+    columns(columns),
+    owner(QThread::currentThread()),
+    log((logData *) 0)
+{
+    // the loader is deleted by whoever connects to finished()
+    this->setAutoDelete(false);
+}
+
+logLoader::~logLoader()
+{
+    delete this->log;
+}
+
+void logLoader::run()
+{
+    PROFILE_SCOPE("logLoader::run");
+    logData * loaded = new logData();
+    loaded->logFileXMLname = this->logFileXMLname;
+    if (loaded->setupFromXML()) {
+        if (loaded->dataFormat == BINARY) {
+            for (int i = 0; i < this->columns.size(); ++i) {
+                loaded->readColumn(this->columns[i]);
+            }
+        }
+        // the 3D view colours populations by the range of their logs
+        if (loaded->dataClass == ANALOGDATA) {
+            loaded->getMax();
+        }
+        loaded->moveToThread(this->owner);
+        this->log = loaded;
+    } else {
+        delete loaded;
+    }
+    emit finished();
+}
+
+logData * logLoader::takeLog()
+{
+    logData * taken = this->log;
+    this->log = (logData *) 0;
+    return taken;
+}
+
+logRowPrefetcher::logRowPrefetcher(int depth) :
+    QObject(),
+    position(0),
+    depth(depth),
+    fillQueued(0)
+{
+}
+
+/*!
+ * Read ahead of row in logs from now on, dropping anything already read for
+ * other logs or outside the new window. NULL entries in logs are ignored.
+ */
+void logRowPrefetcher::setPosition(const QVector < logData * > &logs, int row)
+{
+    {
+        QMutexLocker locker(&lock);
+
+        this->logs.clear();
+        for (int i = 0; i < logs.size(); ++i) {
+            if (logs[i] != NULL && !this->logs.contains(logs[i])) {
+                this->logs.push_back(logs[i]);
+            }
+        }
+
+        QHash < logData *, QMap < int, QVector < double > > >::iterator it = rows.begin();
+        while (it != rows.end()) {
+            if (!this->logs.contains(it.key())) {
+                it = rows.erase(it);
+                continue;
+            }
+            QMap < int, QVector < double > >::iterator r = it.value().begin();
+            while (r != it.value().end()) {
+                if (r.key() < row || r.key() >= row + depth) {
+                    r = it.value().erase(r);
+                } else {
+                    ++r;
+                }
+            }
+            ++it;
+        }
+
+        position = row;
+    }
+
+    this->queueFill();
+}
+
+QVector < double > logRowPrefetcher::getRow(logData * log, int row)
+{
+    {
+        QMutexLocker locker(&lock);
+        QHash < logData *, QMap < int, QVector < double > > >::const_iterator it = rows.constFind(log);
+        if (it != rows.constEnd()) {
+            QMap < int, QVector < double > >::const_iterator r = it.value().constFind(row);
+            if (r != it.value().constEnd()) {
+                return r.value();
+            }
+        }
+    }
+
+    // not read ahead yet
+    return log->getRow(row);
+}
+
+void logRowPrefetcher::queueFill()
+{
+    // only one fill is queued at a time; it runs until the window is full
+    if (fillQueued.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "fill", Qt::QueuedConnection);
+    }
+}
+
+void logRowPrefetcher::fill()
+{
+    for (;;) {
+        // the lock is held over the read so that setPosition() can drop a log
+        // knowing it is no longer in use here
+        QMutexLocker locker(&lock);
+
+        logData * log = NULL;
+        int next = -1;
+        for (int i = 0; i < logs.size() && log == NULL; ++i) {
+            const QMap < int, QVector < double > > &logRows = rows[logs[i]];
+            for (int r = position; r < position + depth; ++r) {
+                if (!logRows.contains(r)) {
+                    log = logs[i];
+                    next = r;
+                    break;
+                }
+            }
+        }
+
+        if (log == NULL) {
+            fillQueued.fetchAndStoreOrdered(0);
+            return;
+        }
+
+        rows[log].insert(next, log->getRow(next));
+    }
+}
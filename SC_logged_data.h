@@ -27,8 +27,15 @@
 
 #include <QObject>
 #include <QMdiArea>
+#include <QCache>
+#include <QRunnable>
+#include <QDateTime>
 #include "qcustomplot.h"
 #include "globalHeader.h"
+#include "SC_residency.h"
+#include "SC_indexset.h"
+
+class QXmlStreamReader;
 
 enum fileFormat
 {
@@ -52,6 +59,59 @@ enum dataType
     TYPE_STRING
 };
 
+/*!
+ * Min/max summaries of an analog column at successively coarser resolutions,
+ * level k holding one bucket per LOG_PYRAMID_FACTOR^(k+1) samples.
+ */
+struct columnPyramid
+{
+    QVector < QVector < double > > mins;
+    QVector < QVector < double > > maxs;
+};
+
+#define LOG_PYRAMID_FACTOR 4
+
+// rows per block when scanning whole binary logs
+#define LOG_EXTRACT_BLOCK_ROWS 65536
+
+// rows read ahead of the playback position
+#define LOG_PREFETCH_ROWS 64
+
+// the per-timestep event index is saved next to the log with this suffix
+#define LOG_EVENT_INDEX_SUFFIX ".tidx"
+#define LOG_EVENT_INDEX_MAGIC 0x53434549
+#define LOG_EVENT_INDEX_VERSION 2
+
+// bytes at the end of the indexed part of the log which are checksummed, so a
+// saved index is not used for a log which has since been rewritten
+#define LOG_EVENT_INDEX_CHECK_BYTES 4096
+
+// most timesteps indexed; later events share the last bucket
+#define LOG_EVENT_INDEX_MAX_BUCKETS (1 << 24)
+
+// event logs are summarised as they are indexed, by the events of each neuron
+// and the events of the whole population in bins of this many ms; later
+// events share the last bin, and neuron indices past the maximum are not counted
+#define LOG_ACTIVITY_BIN_MS 1.0
+#define LOG_ACTIVITY_MAX_BINS (1 << 22)
+#define LOG_ACTIVITY_MAX_NEURONS (1 << 24)
+
+// a raster is re-read on zooming in once it holds this many times the events
+// of the window it needs
+#define LOG_RASTER_REFETCH_RATIO 8
+
+// how often the logs of a running simulation are checked for new rows, and
+// so the most often their plots are redrawn
+#define LOG_FOLLOW_INTERVAL_MS 500
+
+// decompressed chunks of a compressed binary log held in memory (bytes)
+#define LOG_CHUNK_CACHE_BYTES (64 << 20)
+
+// the columns decoded from logs for plotting are held up to the limit in the
+// setting "logOptions/columnCacheMB" (by default this many MB), beyond which
+// the least recently drawn are dropped and read again from the log as needed
+#define LOG_COLUMN_CACHE_DEFAULT_MB 512
+
 struct column
 {
     int index;
@@ -63,7 +123,7 @@ struct column
 /*!
  * \brief The logData class provides an interface to logged data from simulations stored on disk
  */
-class logData : public QObject
+class logData : public QObject, public residentData
 {
     Q_OBJECT
 public:
@@ -85,6 +145,8 @@ public:
     dataClasses dataClass;
     QVector < column > columns;
     QVector < int > eventIndices;
+    // the neuron indices of the columns, or of the events, which are logged
+    indexSet loggedIndices;
 
     /*!
      * Return the number of QCustomPlots associated with this logData object.
@@ -99,27 +161,282 @@ public: // but really private 2.
     fileFormat dataFormat;
     double endTime;
     int binaryDataStride;
+    // colData[c] may have been dropped by the logRegistry, leaving the
+    // pyramid of the colHeld[c] rows read so far; colReady[c] is set once
+    // the column has been read since the log was last set up
     QVector < QVector < double > > colData;
+    QVector < int > colHeld;
+    QVector < bool > colReady;
+    QVector < columnPyramid > colPyramids;
     QString eventPortName;
     bool allLogged;
     double min;
     double max;
 
+private:
+    friend class logRegistry;
+    void dropColumn(int colNum);
+
+    // rows may be read ahead on another thread while the log is plotted, so
+    // the mapping and index are only touched with this held
+    QMutex accessLock;
+
+    // binary logs are mapped so rows can be addressed directly; the mapping
+    // is refreshed when the log grows during a run
+    const uchar * mapLogFile(qint64 &size);
+    void unmapLogFile();
+    uchar * mappedLog;
+    qint64 mappedLogSize;
+
+    // a binary log may instead be stored as zlib compressed chunks of whole
+    // rows, listed in the logrep XML, so that reading a time window only
+    // decompresses the chunks which hold it. binaryRows() gives the rows from
+    // firstRow that lie together in memory, either way
+    bool readChunkIndex(QXmlStreamReader * reader);
+    qint64 binaryRowCount();
+    const uchar * binaryRows(qint64 firstRow, qint64 &rows);
+    bool chunked;
+    qint64 chunkRows;
+    qint64 chunkedRowCount;
+    QVector < qint64 > chunkOffsets;
+    QVector < int > chunkSizes;
+    QCache < int, QByteArray > chunkCache;
+    QByteArray chunkScratch;
+
+    // event logs and text logs are indexed by timestep: eventBucketStarts[k]
+    // is the file offset of the first event in timestep k or later, so a time
+    // window is read without scanning the rest of the file. The index is
+    // extended when more has been written, and kept beside the log so that it
+    // is only built once
+    bool updateEventIndex();
+    void clearEventIndex();
+    bool loadEventIndex();
+    void saveEventIndex();
+    QString eventIndexFileName();
+    quint16 eventIndexCheck(qint64 indexedTo);
+    int eventBucket(double t);
+    void indexEvent(double t, qint64 offset, int neuron);
+    bool splitLine(const QByteArray &raw, QStringList &cols);
+    qint64 eventIndexedTo;
+    bool eventIndexValid;
+    bool eventTimesSorted;
+    double lastEventTime;
+    QVector < qint64 > eventBucketStarts;
+
+    // the activity of an event log, counted by indexEvent() and saved with
+    // the index: spikeCounts[n] events of neuron n, and rateBins[k] events
+    // in bin k of LOG_ACTIVITY_BIN_MS
+    QVector < qint64 > spikeCounts;
+    QVector < qint64 > rateBins;
+
+    // the running mean and sum of squared deviations (Welford) of each
+    // column of an analog log, found with its range
+    void addColumnSample(int colNum, double value);
+    QVector < qint64 > colSamples;
+    QVector < double > colMean;
+    QVector < double > colM2;
+    bool setActivityData(QCPGraph * graph, const QString &type);
+
+    bool extractColumn(int colNum, QVector < double > &out, qint64 firstRow = 0, qint64 numRows = -1);
+    void calculateRange();
+    void buildPyramid(int colNum, int from = 0);
+    void setLineData(QCPGraph * graph, int colNum, const QCPRange &range, int pixels);
+    bool setRasterData(QCPGraph * graph, const QList < QVariant > &indices, double from, double to);
+
+    // the binary columns which are plotted, and so are extended by
+    // appendNewRows(); and the time read up to, before and after it
+    QVector < bool > colFollowed;
+    double heldEnd;
+    double heldEndBefore;
+
 public:
     /*!
      * Delete the log file associated with this logData
      */
     void deleteLogFile (void);
+    /*!
+     * The residentData view of the decoded columns, the mapping and the
+     * decompressed chunks, for the residencyManager. Pyramids are kept.
+     */
+    qint64 residentBytes() const;
+    void evictResident();
     bool setupFromXML();
     double getMax();
     double getMin();
     QVector < double > getRow(int rowNum);
+    bool getEvents(double from, double to, QVector < double > &times, QVector < double > &indices);
     bool plotLine(QCustomPlot* plot, QMdiSubWindow* msw, int colNum, int update = -1);
     bool plotRaster(QCustomPlot* plot, QMdiSubWindow* msw, QList < QVariant > indices, int update = -1);
+    /*!
+     * Plot a summary of the log found while it was read: "firingRates" (Hz
+     * for each logged neuron of an event log), "populationRate" (Hz of the
+     * whole population over time) or "columnMeans" (the mean of each column
+     * of an analog log, with its standard deviation).
+     */
+    bool plotActivity(QCustomPlot* plot, QMdiSubWindow* msw, const QString &type, int update = -1);
     bool calculateBinaryDataStride();
     int calculateBinaryDataOffset(int);
 
+    /*!
+     * The rate in Hz over the run of each neuron in eventIndices of an event
+     * log. Only what has been written since the log was last indexed is read.
+     */
+    bool getFiringRates(QVector < double > &neurons, QVector < double > &rates);
+    /*!
+     * The rate in Hz of all the events of an event log, at the start of each
+     * bin of LOG_ACTIVITY_BIN_MS.
+     */
+    bool getPopulationRate(QVector < double > &times, QVector < double > &rates);
+    /*!
+     * The mean and variance of each column of an analog log, found with its
+     * range if that has not been found yet.
+     */
+    bool getColumnStats(QVector < double > &means, QVector < double > &variances);
+
+    /*!
+     * Read column colNum of a binary log and summarise it into its pyramid,
+     * unless all of it has been read since the log was set up.
+     */
+    bool readColumn(int colNum);
+    /*!
+     * Take the columns which from has read, and its range if it has found
+     * it, where from is another logData set up from the same report.
+     */
+    void adoptColumns(logData * from);
+
+    /*!
+     * The number of whole rows in a binary log, or -1 for a text log.
+     */
+    qint64 numRows();
+    /*!
+     * Read numRows values (all the rest if -1) of column colNum of a binary
+     * log from firstRow. Returns false if the column can't be read.
+     */
+    bool getColumn(int colNum, QVector < double > &out, qint64 firstRow = 0, qint64 numRows = -1);
+
+    /*!
+     * Read what the simulator has written to the log since it was last
+     * read: the plotted columns of an analog log and their pyramids are
+     * extended by the new rows, and an event log's index by the new
+     * events. A log which has become shorter is read again from the
+     * start. Returns true if there was anything new.
+     */
+    bool appendNewRows();
+    /*!
+     * Redraw the graphs from this log in plot after appendNewRows(). If
+     * the end of the log was in view it is kept in view.
+     */
+    void updatePlot(QCustomPlot * plot);
+
 public slots:
+    void plotRangeChanged(const QCPRange &range);
+};
+
+/*!
+ * \brief The logRegistry class holds one logData for each log report, shared
+ * by everything that shows the log, so that a log opened in several graph
+ * views and in the 3D visualiser is mapped, and its columns and pyramids
+ * read, once. A logData from acquire() or retain() is deleted when the last
+ * of these is matched by a release().
+ *
+ * The registry also bounds the memory of the columns decoded for plotting
+ * across all the logs, to settingsCache::logCacheLimitMB(), dropping the
+ * least recently drawn; a column's pyramid is kept, and the rows in view are
+ * read from the log if it is drawn at full resolution again. Each log is also
+ * tracked by the residencyManager, which may let go of all its columns when
+ * it is the least recently used of the data held.
+ */
+class logRegistry
+{
+public:
+    /*!
+     * The log for the report logFileXMLname, set up from it if it is not
+     * held yet, or re-read if the report has changed since. 0 if the report
+     * can't be read.
+     */
+    static logData * acquire(const QString &logFileXMLname);
+    /*!
+     * As acquire(), for a log which has been set up already, by a
+     * logLoader. If the report is held already log is deleted and the log
+     * held is returned instead.
+     */
+    static logData * adopt(logData * log);
+    static void retain(logData * log);
+    static void release(logData * log);
+
+    /*!
+     * Note that a column of log has just been read or drawn.
+     */
+    static void touchColumn(logData * log, int colNum);
+
+private:
+    struct entry
+    {
+        logData * log;
+        int refs;
+        QDateTime modified;
+    };
+    static QHash < QString, entry > entries;
+    // the held columns, least recently drawn first
+    static QList < QPair < logData *, int > > columnsUsed;
+};
+
+/*!
+ * \brief The logLoader class sets up a logData from a report on a pool
+ * thread, and reads the given columns of it with their pyramids, and its
+ * range if it is an analog log, so that a view can load many logs at once
+ * without waiting on them. finished() is emitted (from the pool thread) when
+ * it is done, after which the log is passed to the thread which made the
+ * loader and can be taken from it; one which is not taken is deleted with
+ * the loader.
+ */
+class logLoader : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    logLoader(const QString &logFileXMLname, const QVector < int > &columns);
+    ~logLoader();
+    void run();
+
+    QString logFileXMLname;
+    /*!
+     * The log, or 0 if its report could not be read.
+     */
+    logData * takeLog();
+
+signals:
+    void finished();
+
+private:
+    QVector < int > columns;
+    QThread * owner;
+    logData * log;
+};
+
+/*!
+ * \brief The logRowPrefetcher class reads rows from a set of logs ahead of a
+ * playback position on its own thread, so that stepping through a recording
+ * does not wait on the disk. Rows that are not ready yet are read directly.
+ */
+class logRowPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit logRowPrefetcher(int depth = LOG_PREFETCH_ROWS);
+    void setPosition(const QVector < logData * > &logs, int row);
+    QVector < double > getRow(logData * log, int row);
+
+private:
+    void queueFill();
+    QMutex lock;
+    QVector < logData * > logs;
+    QHash < logData *, QMap < int, QVector < double > > > rows;
+    int position;
+    int depth;
+    QAtomicInt fillQueued;
+
+private slots:
+    void fill();
 };
 
 #endif // LOGDATA_H
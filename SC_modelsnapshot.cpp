@@ -0,0 +1,185 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_modelsnapshot.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "NL_population.h"
+#include "NL_projection_and_synapse.h"
+#include "NL_genericinput.h"
+#include "NL_connection.h"
+#include "CL_classes.h"
+#include "SC_profiler.h"
+#include <QUndoStack>
+
+namespace {
+    propertySnapshot snapshotOf(const ParameterInstance * par, bool isStateVariable)
+    {
+        propertySnapshot p;
+        p.isStateVariable = isStateVariable;
+        p.type = Undefined;
+        if (par == (const ParameterInstance *)0) {
+            return p;
+        }
+        p.name = par->name;
+        p.dims = par->dims->toString();
+        p.type = par->currType;
+        p.value = par->value;
+        p.indices = par->indices;
+        return p;
+    }
+
+    connectionSnapshot snapshotOf(connection * conn)
+    {
+        connectionSnapshot c;
+        if (conn == (connection *)0) {
+            return c;
+        }
+        c.type = conn->type;
+        c.delay = snapshotOf(conn->delay, false);
+
+        fixedProb_connection * fixedProb = dynamic_cast<fixedProb_connection *> (conn);
+        if (fixedProb) {
+            c.probability = fixedProb->p;
+            c.seed = fixedProb->seed;
+        }
+
+        csv_connection * csv = dynamic_cast<csv_connection *> (conn);
+        if (csv) {
+            pythonscript_connection * pyConn = dynamic_cast<pythonscript_connection *> (csv->generator);
+            if (pyConn) {
+                c.type = Python;
+                c.scriptName = pyConn->scriptName;
+            }
+            // shares the store; the generator is not needed to read it
+            csv_connection * list = static_cast<csv_connection *> (csv->newFromExisting());
+            delete list->generator;
+            list->generator = (connection *)0;
+            // made on this thread, so let it go on this thread
+            c.list = QSharedPointer <csv_connection> (list, &QObject::deleteLater);
+        }
+        return c;
+    }
+
+    componentSnapshot snapshotOf(QSharedPointer <ComponentInstance> cmpt)
+    {
+        componentSnapshot s;
+        if (cmpt.isNull()) {
+            return s;
+        }
+        s.name = cmpt->component->name;
+        s.type = cmpt->component->type;
+        for (int i = 0; i < cmpt->ParameterList.size(); ++i) {
+            s.properties.push_back(snapshotOf(cmpt->ParameterList[i], false));
+        }
+        for (int i = 0; i < cmpt->StateVariableList.size(); ++i) {
+            s.properties.push_back(snapshotOf(cmpt->StateVariableList[i], true));
+        }
+        for (int i = 0; i < cmpt->inputs.size(); ++i) {
+            QSharedPointer <genericInput> in = cmpt->inputs[i];
+            if (in->isDeleted) {
+                continue;
+            }
+            inputSnapshot is;
+            is.source = in->getSrcName();
+            is.destination = in->getDestName();
+            is.srcPort = in->srcPort;
+            is.dstPort = in->dstPort;
+            is.projInput = in->projInput;
+            is.connectivity = snapshotOf(in->conn);
+            s.inputs.push_back(is);
+        }
+        return s;
+    }
+}
+
+const propertySnapshot * componentSnapshot::property(const QString &name) const
+{
+    for (int i = 0; i < this->properties.size(); ++i) {
+        if (this->properties[i].name == name) {
+            return &this->properties[i];
+        }
+    }
+    return (const propertySnapshot *)0;
+}
+
+const populationSnapshot * modelSnapshot::population(const QString &name) const
+{
+    for (int i = 0; i < this->populations.size(); ++i) {
+        if (this->populations[i].name == name) {
+            return &this->populations[i];
+        }
+    }
+    return (const populationSnapshot *)0;
+}
+
+QSharedPointer <const modelSnapshot> modelSnapshot::take(nl_rootdata * data)
+{
+    PROFILE_SCOPE("modelSnapshot::take");
+    modelSnapshot * snapshot = new modelSnapshot;
+    if (data->currProject) {
+        snapshot->projectName = data->currProject->name;
+        if (data->currProject->undoStack) {
+            snapshot->undoIndex = data->currProject->undoStack->index();
+        }
+    }
+
+    snapshot->populations.resize(data->populations.size());
+    for (int i = 0; i < data->populations.size(); ++i) {
+        QSharedPointer <population> pop = data->populations[i];
+        populationSnapshot &ps = snapshot->populations[i];
+        ps.name = pop->name;
+        ps.size = pop->numNeurons;
+        ps.isSpikeSource = pop->isSpikeSource;
+        ps.neuron = snapshotOf(pop->neuronType);
+        if (!pop->layoutType.isNull()) {
+            ps.layoutName = pop->layoutType->component->name;
+            ps.locations = pop->layoutType->locations;
+        }
+
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            if (proj->isDeleted) {
+                continue;
+            }
+            projectionSnapshot pr;
+            pr.source = proj->source->name;
+            pr.destination = proj->destination->name;
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                QSharedPointer <synapse> syn = proj->synapses[k];
+                if (syn->isDeleted) {
+                    continue;
+                }
+                synapseSnapshot ss;
+                ss.weightUpdate = snapshotOf(syn->weightUpdateCmpt);
+                ss.postSynapse = snapshotOf(syn->postSynapseCmpt);
+                ss.connectivity = snapshotOf(syn->connectionType);
+                pr.synapses.push_back(ss);
+            }
+            ps.projections.push_back(pr);
+        }
+    }
+    return QSharedPointer <const modelSnapshot> (snapshot);
+}
@@ -0,0 +1,142 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_MODELSNAPSHOT_H
+#define SC_MODELSNAPSHOT_H
+
+#include "globalHeader.h"
+
+class nl_rootdata;
+class csv_connection;
+class connection;
+
+/*!
+ * A Property or State Variable as it was when the snapshot was taken. The
+ * value and index lists are implicitly shared with the live one, so taking
+ * them costs nothing until one of the two is changed.
+ */
+struct propertySnapshot {
+    QString name;
+    QString dims;
+    ParameterType type;
+    bool isStateVariable;
+    QVector <double> value;
+    QVector <int> indices;
+};
+
+/*!
+ * The connectivity of a synapse or generic input. Explicit lists share the
+ * backing store of the live list (see csv_connection::newFromExisting),
+ * which moves to a copy of its own before it is next written to, so list
+ * can be read on any thread while the user edits the live one.
+ */
+struct connectionSnapshot {
+    connectionSnapshot() : type(none), probability(0), seed(0) {}
+    connectionType type;
+    // of a fixed probability connection
+    float probability;
+    int seed;
+    // for a Python script connection, its script
+    QString scriptName;
+    propertySnapshot delay;
+    // the explicit list, for CSV and Python connections; null otherwise
+    QSharedPointer <csv_connection> list;
+};
+
+struct inputSnapshot {
+    QString source;
+    QString destination;
+    QString srcPort;
+    QString dstPort;
+    bool projInput;
+    connectionSnapshot connectivity;
+};
+
+struct componentSnapshot {
+    QString name;
+    // neuron_body, weight_update, postsynapse ...
+    QString type;
+    QVector <propertySnapshot> properties;
+    // the generic inputs into the component
+    QVector <inputSnapshot> inputs;
+
+    const propertySnapshot * property(const QString &name) const;
+};
+
+struct synapseSnapshot {
+    componentSnapshot weightUpdate;
+    componentSnapshot postSynapse;
+    connectionSnapshot connectivity;
+};
+
+struct projectionSnapshot {
+    QString source;
+    QString destination;
+    QVector <synapseSnapshot> synapses;
+};
+
+struct populationSnapshot {
+    QString name;
+    int size;
+    bool isSpikeSource;
+    componentSnapshot neuron;
+    QString layoutName;
+    // the locations last generated for the layout, if any
+    QVector <loc> locations;
+    QVector <projectionSnapshot> projections;
+};
+
+/*!
+ * \brief The modelSnapshot class is a read only copy of the network, for
+ * work done on other threads (saving, exporting, generating) while the user
+ * goes on editing the live model.
+ *
+ * A snapshot is taken on the GUI thread in time proportional to the number
+ * of objects in the network, not to the size of their data: the property
+ * values, locations and explicit connection lists are all shared with the
+ * live model, copy on write. After that it may be read on, and released
+ * from, any thread.
+ */
+class modelSnapshot
+{
+public:
+    /*!
+     * A snapshot of the network of data, as it is now. Call on the GUI
+     * thread.
+     */
+    static QSharedPointer <const modelSnapshot> take(nl_rootdata * data);
+
+    const populationSnapshot * population(const QString &name) const;
+
+    QString projectName;
+    // the index of the project's undo stack when it was taken, or -1
+    int undoIndex;
+    QVector <populationSnapshot> populations;
+
+private:
+    modelSnapshot() : undoIndex(-1) {}
+};
+
+#endif // SC_MODELSNAPSHOT_H
@@ -0,0 +1,414 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_modelvalidator.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "NL_connection.h"
+#include "CL_classes.h"
+#include "EL_experiment.h"
+#include "SC_profiler.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QUndoStack>
+#include <QDataStream>
+
+modelValidator * modelValidator::instance = (modelValidator*)0;
+
+namespace {
+
+/*
+ * A property whose explicit values are checked against size, the number of
+ * elements it is given for (-1 if that is not known here).
+ */
+struct parCheck {
+    ParameterInstance * par;
+    int size;
+    QString label;
+};
+
+/*
+ * A connection list whose indices are checked against the sizes of the
+ * source and destination.
+ */
+struct connCheck {
+    const csv_connection * conn;
+    int srcSize;
+    int dstSize;
+    QString label;
+};
+
+/*
+ * The checks of one population or projection that read its values, run on
+ * the pool.
+ */
+class validationJob : public QRunnable
+{
+public:
+    validationJob() : cached(false) { this->setAutoDelete(false); }
+
+    void run (void)
+    {
+        for (int i = 0; i < this->pars.size(); ++i) {
+            this->checkPar (this->pars[i]);
+        }
+        for (int i = 0; i < this->conns.size(); ++i) {
+            this->checkConn (this->conns[i]);
+        }
+    }
+
+    const void * object;
+    // what the checks read which does not change through the undo stack
+    QByteArray key;
+    bool cached;
+    QVector <parCheck> pars;
+    QVector <connCheck> conns;
+    QStringList problems;
+
+private:
+    void checkPar (const parCheck& c)
+    {
+        const ParameterInstance * par = c.par;
+        if (par->currType != ExplicitList) {
+            return;
+        }
+        if (par->indices.size() != par->value.size()) {
+            this->problems.push_back (c.label + ": property '" + par->name + "' has "
+                                      + QString::number(par->value.size()) + " values for "
+                                      + QString::number(par->indices.size()) + " indices.");
+            return;
+        }
+        if (c.size < 0) {
+            return;
+        }
+        for (int i = 0; i < par->indices.size(); ++i) {
+            if (par->indices[i] < 0 || par->indices[i] >= c.size) {
+                this->problems.push_back (c.label + ": property '" + par->name + "' has a value for index "
+                                          + QString::number(par->indices[i]) + ", but there are only "
+                                          + QString::number(c.size) + " elements.");
+                return;
+            }
+        }
+    }
+
+    void checkConn (const connCheck& c)
+    {
+        connectionStatistics stats;
+        if (!c.conn->getStatistics (c.srcSize, c.dstSize, stats) || stats.outOfRange == 0) {
+            return;
+        }
+        if (stats.minSrc < 0 || stats.maxSrc >= c.srcSize) {
+            this->problems.push_back (c.label + ": the connection list has source indices from "
+                                      + QString::number(stats.minSrc) + " to " + QString::number(stats.maxSrc)
+                                      + ", but the source has " + QString::number(c.srcSize) + " elements.");
+        }
+        if (stats.minDst < 0 || stats.maxDst >= c.dstSize) {
+            this->problems.push_back (c.label + ": the connection list has destination indices from "
+                                      + QString::number(stats.minDst) + " to " + QString::number(stats.maxDst)
+                                      + ", but the destination has " + QString::number(c.dstSize) + " elements.");
+        }
+    }
+};
+
+void addPars (validationJob * job, ComponentRootInstance * cmpt, int size, const QString& label)
+{
+    for (int i = 0; i < cmpt->ParameterList.size(); ++i) {
+        parCheck c = { cmpt->ParameterList[i], size, label };
+        job->pars.push_back (c);
+    }
+    for (int i = 0; i < cmpt->StateVariableList.size(); ++i) {
+        parCheck c = { cmpt->StateVariableList[i], size, label };
+        job->pars.push_back (c);
+    }
+}
+
+/*
+ * The number of elements of cmpt when an index into it is definitely
+ * bounded by it, else -1 (the source indices of a weight update, say, are
+ * not its destination neurons).
+ */
+int definiteSize (QSharedPointer <ComponentInstance> cmpt)
+{
+    if (cmpt->component->type == "neuron_body" || cmpt->component->type == "postsynapse") {
+        return cmpt->getSize();
+    }
+    return -1;
+}
+
+/*
+ * The generic inputs into cmpt: their ports are checked here, as matching
+ * them reads the dimensions of the ports, and their connections are added
+ * to the job.
+ */
+void addInputs (validationJob * job, QSharedPointer <ComponentInstance> cmpt, QStringList& problems)
+{
+    for (int i = 0; i < cmpt->inputs.size(); ++i) {
+        QSharedPointer <genericInput> in = cmpt->inputs[i];
+        if (in->srcCmpt.isNull() || in->dstCmpt.isNull() || in->conn == NULL) {
+            continue;
+        }
+        QString label = "Input " + in->getName();
+        if (in->srcPort.isEmpty() || in->dstPort.isEmpty()) {
+            problems.push_back (label + ": no pair of ports is chosen.");
+        } else if (!cmpt->getPortMatches (i, false).contains (in->srcPort + "->" + in->dstPort)) {
+            problems.push_back (label + ": the ports " + in->srcPort + " and " + in->dstPort + " do not match.");
+        }
+
+        int srcSize = definiteSize (in->srcCmpt);
+        int dstSize = definiteSize (in->dstCmpt);
+        if (srcSize < 0 || dstSize < 0) {
+            continue;
+        }
+        if (in->conn->type == OnetoOne && srcSize != dstSize) {
+            problems.push_back (label + ": one to one, but the source has " + QString::number(srcSize)
+                                + " elements and the destination " + QString::number(dstSize) + ".");
+        }
+        csv_connection * csv = dynamic_cast <csv_connection*> (in->conn);
+        if (csv != NULL) {
+            connCheck c = { csv, srcSize, dstSize, label };
+            job->conns.push_back (c);
+        }
+    }
+}
+
+/*
+ * The key of what the checks of job read that is not changed through the
+ * undo stack.
+ */
+QByteArray jobKey (const validationJob * job)
+{
+    QByteArray key;
+    QDataStream s (&key, QIODevice::WriteOnly);
+    for (int i = 0; i < job->pars.size(); ++i) {
+        s << (quint64)(quintptr)job->pars[i].par << (qint32)job->pars[i].size;
+    }
+    for (int i = 0; i < job->conns.size(); ++i) {
+        s << job->conns[i].conn->getExportKey() << (qint32)job->conns[i].srcSize << (qint32)job->conns[i].dstSize;
+    }
+    return key;
+}
+
+bool hasPort (QSharedPointer <ComponentInstance> cmpt, const QString& name)
+{
+    QSharedPointer <Component> c = cmpt->component;
+    for (int i = 0; i < c->AnalogPortList.size(); ++i) {
+        if (c->AnalogPortList[i]->name == name) {
+            return true;
+        }
+    }
+    for (int i = 0; i < c->EventPortList.size(); ++i) {
+        if (c->EventPortList[i]->name == name) {
+            return true;
+        }
+    }
+    for (int i = 0; i < c->ImpulsePortList.size(); ++i) {
+        if (c->ImpulsePortList[i]->name == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isSpikeSource (QSharedPointer <ComponentInstance> cmpt)
+{
+    QSharedPointer <population> pop = qSharedPointerDynamicCast <population> (cmpt->owner);
+    return !pop.isNull() && pop->isSpikeSource;
+}
+
+/*
+ * The checks of the inputs, outputs and changes of expt. These are what
+ * exptInput::writeXML and the others would write out: those which are set,
+ * and whose component is still in the model.
+ */
+void checkExperiment (nl_rootdata * data, experiment * expt, QStringList& problems)
+{
+    for (int i = 0; i < expt->ins.size(); ++i) {
+        exptInput * in = expt->ins[i];
+        if (!in->set || in->edit || data->isValidPointer (in->target.data()).isNull()) {
+            continue;
+        }
+        if (in->target->component->name == "none" || isSpikeSource (in->target)) {
+            continue;
+        }
+        QString label = "Experiment input '" + in->name + "'";
+        if (in->portName.isEmpty()) {
+            problems.push_back (label + ": no port is chosen.");
+        } else if (!hasPort (in->target, in->portName)) {
+            problems.push_back (label + ": " + in->target->getXMLName() + " has no port " + in->portName + ".");
+        }
+        int size = definiteSize (in->target);
+        if (in->inType == arrayConstant && size >= 0 && in->params.size() != size) {
+            problems.push_back (label + ": " + QString::number(in->params.size()) + " values for "
+                                + QString::number(size) + " elements.");
+        }
+    }
+
+    for (int i = 0; i < expt->outs.size(); ++i) {
+        exptOutput * out = expt->outs[i];
+        if (!out->set || out->edit || data->isValidPointer (out->source.data()).isNull()) {
+            continue;
+        }
+        if (out->source->component->name == "none" || isSpikeSource (out->source)) {
+            continue;
+        }
+        QString label = "Experiment output '" + out->name + "'";
+        if (out->portName.isEmpty()) {
+            problems.push_back (label + ": no port is chosen.");
+        } else if (!hasPort (out->source, out->portName)) {
+            problems.push_back (label + ": " + out->source->getXMLName() + " has no port " + out->portName + ".");
+        }
+    }
+
+    for (int i = 0; i < expt->changes.size(); ++i) {
+        exptChangeProp * change = expt->changes[i];
+        if (!change->set || change->edit || data->isValidPointer (change->component.data()).isNull()) {
+            continue;
+        }
+        QString label = "Experiment change '" + change->name + "'";
+        if (change->par == NULL) {
+            problems.push_back (label + ": no property is chosen.");
+            continue;
+        }
+        bool found = false;
+        for (int j = 0; j < change->component->ParameterList.size() && !found; ++j) {
+            found = change->component->ParameterList[j]->name == change->par->name;
+        }
+        for (int j = 0; j < change->component->StateVariableList.size() && !found; ++j) {
+            found = change->component->StateVariableList[j]->name == change->par->name;
+        }
+        if (!found) {
+            problems.push_back (label + ": " + change->component->getXMLName() + " has no property "
+                                + change->par->name + ".");
+        }
+    }
+}
+
+} // namespace
+
+modelValidator * modelValidator::get (void)
+{
+    if (instance == (modelValidator*)0) {
+        instance = new modelValidator();
+    }
+    return instance;
+}
+
+void modelValidator::invalidate (void)
+{
+    this->results.clear();
+}
+
+QStringList modelValidator::validate (nl_rootdata * data, experiment * expt)
+{
+    PROFILE_SCOPE("modelValidator::validate");
+    modelValidator * v = get();
+    if (data->currProject != (projectObject*)0 && v->stack != data->currProject->undoStack) {
+        // a different project; what was kept may be for freed objects
+        v->results.clear();
+        v->stack = data->currProject->undoStack;
+        connect (v->stack, SIGNAL(indexChanged(int)), v, SLOT(invalidate()), Qt::UniqueConnection);
+    }
+
+    QStringList problems;
+    QVector <validationJob*> jobs;
+
+    for (int i = 0; i < data->populations.size(); ++i) {
+        QSharedPointer <population> pop = data->populations[i];
+        validationJob * job = new validationJob;
+        job->object = pop.data();
+        QString label = "Population '" + pop->name + "'";
+        if (!pop->neuronType.isNull()) {
+            addPars (job, pop->neuronType.data(), pop->numNeurons, label);
+            addInputs (job, pop->neuronType, problems);
+        }
+        if (!pop->layoutType.isNull()) {
+            addPars (job, pop->layoutType.data(), pop->numNeurons, label + " layout");
+        }
+        jobs.push_back (job);
+
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            if (proj->destination.isNull()) {
+                continue;
+            }
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                QSharedPointer <synapse> syn = proj->synapses[k];
+                validationJob * job = new validationJob;
+                job->object = syn.data();
+                QString label = "Projection " + proj->getName() + ", synapse " + QString::number(k);
+                int srcSize = pop->numNeurons;
+                int dstSize = proj->destination->numNeurons;
+
+                csv_connection * csv = dynamic_cast <csv_connection*> (syn->connectionType);
+                if (syn->connectionType != NULL && syn->connectionType->type == OnetoOne && srcSize != dstSize) {
+                    problems.push_back (label + ": one to one, but the source has " + QString::number(srcSize)
+                                        + " neurons and the destination " + QString::number(dstSize) + ".");
+                }
+                if (csv != NULL) {
+                    connCheck c = { csv, srcSize, dstSize, label };
+                    job->conns.push_back (c);
+                }
+                if (!syn->weightUpdateCmpt.isNull()) {
+                    addPars (job, syn->weightUpdateCmpt.data(), csv != NULL ? csv->getNumRows() : -1, label + " weight update");
+                    addInputs (job, syn->weightUpdateCmpt, problems);
+                }
+                if (!syn->postSynapseCmpt.isNull()) {
+                    addPars (job, syn->postSynapseCmpt.data(), dstSize, label + " postsynapse");
+                    addInputs (job, syn->postSynapseCmpt, problems);
+                }
+                jobs.push_back (job);
+            }
+        }
+    }
+
+    // run the checks of what has changed since they were last run
+    QThreadPool pool;
+    for (int i = 0; i < jobs.size(); ++i) {
+        jobs[i]->key = jobKey (jobs[i]);
+        QHash <const void *, objectResult>::const_iterator it = v->results.constFind (jobs[i]->object);
+        if (it != v->results.constEnd() && it.value().key == jobs[i]->key) {
+            jobs[i]->problems = it.value().problems;
+            jobs[i]->cached = true;
+        } else {
+            pool.start (jobs[i]);
+        }
+    }
+    pool.waitForDone();
+
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (!jobs[i]->cached) {
+            objectResult r;
+            r.key = jobs[i]->key;
+            r.problems = jobs[i]->problems;
+            v->results.insert (jobs[i]->object, r);
+        }
+        problems += jobs[i]->problems;
+        delete jobs[i];
+    }
+
+    if (expt != NULL) {
+        checkExperiment (data, expt, problems);
+    }
+    return problems;
+}
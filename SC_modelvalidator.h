@@ -0,0 +1,85 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef SC_MODELVALIDATOR_H
+#define SC_MODELVALIDATOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+class nl_rootdata;
+class experiment;
+class QUndoStack;
+
+/*!
+ * \brief The modelValidator class checks a model for errors that would
+ * stop the simulator, or make it read past the end of an array, before
+ * the model is written out for a run: explicit values and connection
+ * lists with indices out of range, one to one connections between
+ * populations of different sizes, generic inputs without a matching pair
+ * of ports, and experiment inputs, outputs and changes naming a port or
+ * property that their component does not have.
+ *
+ * The checks of each population and synapse are run together on a thread
+ * pool. What is found is kept for each object until the project
+ * is next changed (its undo stack moves), and the explicit connection
+ * lists are checked from their statistics, which are kept with each list
+ * until it changes (see csv_connection::getStatistics), so that a run
+ * after a small change only checks again what the change touched.
+ */
+class modelValidator : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * The problems found in the network of data and in expt, each a line
+     * for the user; empty if there are none.
+     */
+    static QStringList validate (nl_rootdata * data, experiment * expt);
+
+public slots:
+    /*!
+     * Forget what was found for each object, as the project has changed.
+     */
+    void invalidate (void);
+
+private:
+    modelValidator() : stack((QUndoStack*)0) {}
+    static modelValidator * get (void);
+    static modelValidator * instance;
+
+    // the undo stack of the project last checked
+    QUndoStack * stack;
+    // what was found for each population and synapse, with the key
+    // of what the checks read which is not changed through the undo
+    // stack (sizes and connection list content)
+    struct objectResult {
+        QByteArray key;
+        QStringList problems;
+    };
+    QHash <const void *, objectResult> results;
+};
+
+#endif // SC_MODELVALIDATOR_H
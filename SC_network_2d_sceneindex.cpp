@@ -0,0 +1,164 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_network_2d_sceneindex.h"
+
+// a leaf is split once it holds more than this many objects...
+#define SCENEINDEX_NODE_CAPACITY 8
+// ...unless it is already this deep
+#define SCENEINDEX_MAX_DEPTH 10
+
+// QRectF::intersects() is false for rects of zero width or height, which a
+// straight projection or a point query can have, so compare edges instead
+static bool meets(const QRectF &a, const QRectF &b)
+{
+    return a.left() <= b.right() && b.left() <= a.right()
+        && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+static bool holds(const QRectF &outer, const QRectF &inner)
+{
+    return outer.left() <= inner.left() && inner.right() <= outer.right()
+        && outer.top() <= inner.top() && inner.bottom() <= outer.bottom();
+}
+
+sceneIndex::sceneIndex()
+{
+}
+
+void sceneIndex::clear()
+{
+    this->entries.clear();
+    this->nodes.clear();
+}
+
+int sceneIndex::add(const QRectF &bounds, QSharedPointer <systemObject> object)
+{
+    entry e;
+    e.bounds = bounds.normalized();
+    e.object = object;
+    this->entries.push_back(e);
+    return this->entries.size()-1;
+}
+
+void sceneIndex::build()
+{
+    this->nodes.clear();
+    if (this->entries.isEmpty()) {
+        return;
+    }
+
+    // united() skips empty rects, so find the extent by hand
+    QRectF all = this->entries[0].bounds;
+    for (int i = 1; i < this->entries.size(); ++i) {
+        const QRectF &b = this->entries[i].bounds;
+        all.setLeft(qMin(all.left(), b.left()));
+        all.setTop(qMin(all.top(), b.top()));
+        all.setRight(qMax(all.right(), b.right()));
+        all.setBottom(qMax(all.bottom(), b.bottom()));
+    }
+
+    node root;
+    root.bounds = all;
+    root.children = -1;
+    this->nodes.push_back(root);
+
+    for (int i = 0; i < this->entries.size(); ++i) {
+        this->insert(0, i, 0);
+    }
+}
+
+void sceneIndex::insert(int nodeIndex, int item, int depth)
+{
+    if (this->nodes[nodeIndex].children != -1) {
+        for (int c = 0; c < 4; ++c) {
+            int child = this->nodes[nodeIndex].children + c;
+            if (holds(this->nodes[child].bounds, this->entries[item].bounds)) {
+                this->insert(child, item, depth+1);
+                return;
+            }
+        }
+        this->nodes[nodeIndex].items.push_back(item);
+        return;
+    }
+
+    this->nodes[nodeIndex].items.push_back(item);
+    if (this->nodes[nodeIndex].items.size() > SCENEINDEX_NODE_CAPACITY && depth < SCENEINDEX_MAX_DEPTH) {
+        this->split(nodeIndex);
+        QVector <int> items = this->nodes[nodeIndex].items;
+        this->nodes[nodeIndex].items.clear();
+        for (int i = 0; i < items.size(); ++i) {
+            this->insert(nodeIndex, items[i], depth);
+        }
+    }
+}
+
+void sceneIndex::split(int nodeIndex)
+{
+    QRectF b = this->nodes[nodeIndex].bounds;
+    QPointF c = b.center();
+    QRectF quarters[4] = {
+        QRectF(b.topLeft(), c),
+        QRectF(QPointF(c.x(), b.top()), QPointF(b.right(), c.y())),
+        QRectF(QPointF(b.left(), c.y()), QPointF(c.x(), b.bottom())),
+        QRectF(c, b.bottomRight())
+    };
+
+    // nodes may reallocate, so take the index before adding
+    this->nodes[nodeIndex].children = this->nodes.size();
+    for (int i = 0; i < 4; ++i) {
+        node child;
+        child.bounds = quarters[i];
+        child.children = -1;
+        this->nodes.push_back(child);
+    }
+}
+
+QVector <int> sceneIndex::query(const QRectF &region) const
+{
+    QVector <int> found;
+    if (!this->nodes.isEmpty()) {
+        this->query(0, region.normalized(), found);
+        qSort(found);
+    }
+    return found;
+}
+
+void sceneIndex::query(int nodeIndex, const QRectF &region, QVector <int> &found) const
+{
+    const node &n = this->nodes[nodeIndex];
+    if (!meets(n.bounds, region)) {
+        return;
+    }
+    for (int i = 0; i < n.items.size(); ++i) {
+        if (meets(this->entries[n.items[i]].bounds, region)) {
+            found.push_back(n.items[i]);
+        }
+    }
+    if (n.children != -1) {
+        for (int c = 0; c < 4; ++c) {
+            this->query(n.children + c, region, found);
+        }
+    }
+}
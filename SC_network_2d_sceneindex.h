@@ -0,0 +1,92 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef SCENEINDEX_H
+#define SCENEINDEX_H
+
+#include "globalHeader.h"
+#include "NL_systemobject.h"
+
+/*!
+ * \brief The sceneIndex class is a quad-tree over the bounds of the objects
+ * drawn in the network layer, in model (GL) co-ordinates.
+ *
+ * Objects are added in drawing order and a query returns the indices of the
+ * objects whose bounds meet a region, in that same order, so the caller can
+ * draw (or hit-test) just those objects without changing how they stack up.
+ * An object whose bounds straddle a split is kept in the smallest node that
+ * holds it whole.
+ */
+class sceneIndex
+{
+public:
+    sceneIndex();
+
+    /*!
+     * Remove all the objects.
+     */
+    void clear();
+
+    /*!
+     * Add an object with the given bounds. The index of the object is the
+     * number of objects added before it. Call build() once all are added.
+     */
+    int add(const QRectF &bounds, QSharedPointer <systemObject> object);
+
+    /*!
+     * Sort the added objects into the tree.
+     */
+    void build();
+
+    /*!
+     * The indices of the objects whose bounds meet region, in increasing
+     * order.
+     */
+    QVector <int> query(const QRectF &region) const;
+
+    int size() const { return this->entries.size(); }
+    QSharedPointer <systemObject> object(int i) const { return this->entries[i].object; }
+    const QRectF &bounds(int i) const { return this->entries[i].bounds; }
+
+private:
+    struct entry {
+        QRectF bounds;
+        QSharedPointer <systemObject> object;
+    };
+    struct node {
+        QRectF bounds;
+        // index of the first of the four children, or -1 for a leaf
+        int children;
+        QVector <int> items;
+    };
+
+    void insert(int nodeIndex, int item, int depth);
+    void split(int nodeIndex);
+    void query(int nodeIndex, const QRectF &region, QVector <int> &found) const;
+
+    QVector <entry> entries;
+    QVector <node> nodes;
+};
+
+#endif // SCENEINDEX_H
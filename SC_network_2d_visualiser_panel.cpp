@@ -23,6 +23,7 @@
 ****************************************************************************/
 
 #include "SC_network_2d_visualiser_panel.h"
+#include "SC_profiler.h"
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
   #define RETINA_SUPPORT 1.0
@@ -46,7 +47,7 @@ GLWidget::GLWidget(QWidget *parent):QWidget(parent)
 
 {
     // variable for making sure we don't redraw the openGL when we don't need to
-    changed = CHANGED_TIME;
+    changed = 0;
 
     currSelType = 0;
     currSelInd = 0;
@@ -66,21 +67,34 @@ GLWidget::GLWidget(QWidget *parent):QWidget(parent)
 
     // Nothing is moving to begin with.
     this->itemMoving = false;
+
+    this->scheduleRedraw(CHANGED_TIME);
 }
 
 
 GLWidget::~GLWidget()
 {
+    animationScheduler::remove(this);
 }
 
 void GLWidget::redrawGLview()
 {
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
 }
 
+void GLWidget::scheduleRedraw(int frames)
+{
+    changed = qMax(changed, frames);
+    animationScheduler::requestFrames(this);
+}
 
-void GLWidget::animate()
+bool GLWidget::animateFrame()
 {
+    // a hidden view is redrawn when it is shown again
+    if (!this->isVisible()) {
+        return false;
+    }
+
     float animSpeed = 1.0;
 
     GLscale += (targGLscale - GLscale)*animSpeed;
@@ -90,6 +104,13 @@ void GLWidget::animate()
         --changed;
         repaint();
     }
+    return changed > 0 || GLscale != targGLscale;
+}
+
+void GLWidget::showEvent(QShowEvent * event)
+{
+    this->scheduleRedraw(CHANGED_TIME);
+    QWidget::showEvent(event);
 }
 
 void GLWidget::mousePressEvent(QMouseEvent* event)
@@ -126,7 +147,7 @@ void GLWidget::mousePressEvent(QMouseEvent* event)
 
 void GLWidget::mouseReleaseEvent(QMouseEvent* event)
 {
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
     this->button = Qt::NoButton;
     setCursor(Qt::ArrowCursor);
     // convert the incoming x and y into the openGL coordinates
@@ -167,7 +188,7 @@ void GLWidget::mouseReleaseEvent(QMouseEvent* event)
 
 void GLWidget::wheelEvent(QWheelEvent* event)
 {
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
     float val = float(event->delta()) / 320.0;
 
     val = pow(2.0f,val);
@@ -194,7 +215,7 @@ void GLWidget::wheelEvent(QWheelEvent* event)
 
 void GLWidget::mouseMoveEvent(QMouseEvent* event)
 {
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
 
     // convert mouse event into openGL coordinates
     float xGL = float((event->x()*RETINA_SUPPORT)-(this->width()*RETINA_SUPPORT)/2)*2.0/(GLscale)-viewX;
@@ -233,7 +254,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent* event)
 
 void GLWidget::keyPressEvent(QKeyEvent * event)
 {
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
 
     if (event->type() == QEvent::KeyPress) {
         if (event->key() == Qt::Key_Control) {
@@ -250,7 +271,7 @@ void GLWidget::keyPressEvent(QKeyEvent * event)
 
 void GLWidget::keyReleaseEvent(QKeyEvent * event)
 {
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
 
     if (event->type() == QEvent::KeyRelease) {
         if (event->key() == Qt::Key_Control) {
@@ -277,6 +298,7 @@ void GLWidget::resizeGL(int, int)
 
 void GLWidget::paintEvent(QPaintEvent * event)
 {
+    PROFILE_SCOPE("GLWidget::paintEvent");
 #ifdef Q_OS_MAC2
     makeCurrent();
     //QPixmap pix((this->width()*RETINA_SUPPORT), (this->height()*RETINA_SUPPORT))
@@ -374,11 +396,13 @@ void GLWidget::move(GLfloat x, GLfloat y)
 void GLWidget::zoomOut()
 {
     this->targGLscale *= 2.0;
+    this->scheduleRedraw(CHANGED_TIME);
 }
 
 void GLWidget::zoomIn()
 {
     this->targGLscale /= 2.0;
+    this->scheduleRedraw(CHANGED_TIME);
 }
 
 void GLWidget::startConnect()
@@ -392,7 +416,7 @@ void GLWidget::finishConnect()
     this->connectMode = false;
     this->setMouseTracking(false);
 
-    changed = CHANGED_TIME;
+    this->scheduleRedraw(CHANGED_TIME);
 }
 
 void GLWidget::saveImage()
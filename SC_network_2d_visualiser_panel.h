@@ -26,15 +26,16 @@
 #define GLWIDGET_H
 
 #include "globalHeader.h"
+#include "SC_animationscheduler.h"
 
 #ifndef GL_MULTISAMPLE
 #define GL_MULTISAMPLE 0x809D
 #endif
 
 #ifdef Q_OS_MAC2
-class GLWidget : public QGLWidget
+class GLWidget : public QGLWidget, public animatedView
 #else
-class GLWidget : public QWidget
+class GLWidget : public QWidget, public animatedView
 #endif
 {
     Q_OBJECT
@@ -44,6 +45,15 @@ public:
     ~GLWidget();
     void move(GLfloat, GLfloat);
 
+    /*!
+     * Redraw the view for at least the next frames frames, by asking the
+     * animationScheduler for them; nothing is redrawn by the scheduler
+     * otherwise.
+     */
+    void scheduleRedraw(int frames);
+    bool animateFrame();
+
+    // frames still to be redrawn
     int changed;
     float viewX;
     float viewY;
@@ -70,7 +80,6 @@ signals:
     void endDragSelect();
 
 public slots:
-    void animate();
     void zoomOut();
     void zoomIn();
     void startConnect();
@@ -81,6 +90,7 @@ public slots:
 protected:
     void initializeGL();
     void paintEvent(QPaintEvent * event);
+    void showEvent(QShowEvent * event);
     void resizeGL(int, int);
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
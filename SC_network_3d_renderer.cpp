@@ -0,0 +1,806 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#include "SC_network_3d_renderer.h"
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+// lit with the fixed function light 0 so instanced neurons match the rest of
+// the scene
+static const char * neuronVertexShader =
+        "#version 120\n"
+        "attribute vec3 vertex;\n"
+        "attribute vec3 instancePosition;\n"
+        "attribute vec4 instanceColour;\n"
+        "uniform float radius;\n"
+        "uniform vec3 offset;\n"
+        "varying vec4 colour;\n"
+        "void main() {\n"
+        "    vec3 normal = normalize(gl_NormalMatrix * vertex);\n"
+        "    vec3 light = normalize(gl_LightSource[0].position.xyz);\n"
+        "    float diffuse = max(dot(normal, light), 0.0);\n"
+        "    vec3 lit = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb + diffuse * gl_LightSource[0].diffuse.rgb;\n"
+        "    colour = vec4(instanceColour.rgb * lit, instanceColour.a);\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * vec4(vertex * radius + instancePosition + offset, 1.0);\n"
+        "}\n";
+
+static const char * neuronFragmentShader =
+        "#version 120\n"
+        "varying vec4 colour;\n"
+        "void main() {\n"
+        "    gl_FragColor = colour;\n"
+        "}\n";
+
+glNeuronRenderer::glNeuronRenderer()
+{
+    available = false;
+    program = NULL;
+    positionBuffer = NULL;
+    colourBuffer = NULL;
+    drawArraysInstanced = NULL;
+    vertexAttribDivisor = NULL;
+    vertexAttr = -1;
+    positionAttr = -1;
+    colourAttr = -1;
+}
+
+glNeuronRenderer::~glNeuronRenderer()
+{
+    // the owning widget makes its context current before deleting us
+    QMap <int, sphereMesh>::iterator it;
+    for (it = meshes.begin(); it != meshes.end(); ++it) {
+        delete it.value().buffer;
+    }
+    delete positionBuffer;
+    delete colourBuffer;
+    delete program;
+}
+
+bool glNeuronRenderer::initialise(const QGLContext * context)
+{
+    available = false;
+
+    if (!QGLShaderProgram::hasOpenGLShaderPrograms(context)) {
+        return false;
+    }
+
+    // core in GL 3.3, otherwise from the ARB extensions
+    drawArraysInstanced = (drawArraysInstancedFn) context->getProcAddress("glDrawArraysInstanced");
+    if (drawArraysInstanced == NULL) {
+        drawArraysInstanced = (drawArraysInstancedFn) context->getProcAddress("glDrawArraysInstancedARB");
+    }
+    vertexAttribDivisor = (vertexAttribDivisorFn) context->getProcAddress("glVertexAttribDivisor");
+    if (vertexAttribDivisor == NULL) {
+        vertexAttribDivisor = (vertexAttribDivisorFn) context->getProcAddress("glVertexAttribDivisorARB");
+    }
+    if (drawArraysInstanced == NULL || vertexAttribDivisor == NULL) {
+        return false;
+    }
+
+    program = new QGLShaderProgram(context);
+    if (!program->addShaderFromSourceCode(QGLShader::Vertex, neuronVertexShader)
+        || !program->addShaderFromSourceCode(QGLShader::Fragment, neuronFragmentShader)
+        || !program->link()) {
+        qDebug() << "Instanced neuron shader failed:" << program->log();
+        delete program;
+        program = NULL;
+        return false;
+    }
+    vertexAttr = program->attributeLocation("vertex");
+    positionAttr = program->attributeLocation("instancePosition");
+    colourAttr = program->attributeLocation("instanceColour");
+
+    positionBuffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+    positionBuffer->setUsagePattern(QGLBuffer::StreamDraw);
+    colourBuffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+    colourBuffer->setUsagePattern(QGLBuffer::StreamDraw);
+    if (!positionBuffer->create() || !colourBuffer->create()) {
+        return false;
+    }
+
+    available = true;
+    return true;
+}
+
+glNeuronRenderer::sphereMesh * glNeuronRenderer::getMesh(int LoD)
+{
+    QMap <int, sphereMesh>::iterator it = meshes.find(LoD);
+    if (it != meshes.end()) {
+        return &it.value();
+    }
+
+    // same rings and segments as glConnectionWidget::drawNeuron, as
+    // triangles of a unit sphere (so each vertex is also its normal)
+    int rings = LoD;
+    int segments = LoD;
+    QVector <GLfloat> verts;
+    verts.reserve((rings+1)*segments*18);
+
+    for (int i = 0; i <= rings; i++) {
+        double rings0 = M_PI * (-0.5 + (double) (i - 1) / rings);
+        double z0  = sin(rings0);
+        double zr0 =  cos(rings0);
+
+        double rings1 = M_PI * (-0.5 + (double) i / rings);
+        double z1 = sin(rings1);
+        double zr1 = cos(rings1);
+
+        for (int j = 0; j < segments; j++) {
+            double seg0 = 2 * M_PI * (double) (j - 1) / segments;
+            double seg1 = 2 * M_PI * (double) j / segments;
+            GLfloat a[3] = {GLfloat(cos(seg0) * zr0), GLfloat(sin(seg0) * zr0), GLfloat(z0)};
+            GLfloat b[3] = {GLfloat(cos(seg0) * zr1), GLfloat(sin(seg0) * zr1), GLfloat(z1)};
+            GLfloat c[3] = {GLfloat(cos(seg1) * zr0), GLfloat(sin(seg1) * zr0), GLfloat(z0)};
+            GLfloat d[3] = {GLfloat(cos(seg1) * zr1), GLfloat(sin(seg1) * zr1), GLfloat(z1)};
+            const GLfloat * quad[6] = {a, b, c, c, b, d};
+            for (int v = 0; v < 6; ++v) {
+                verts.push_back(quad[v][0]);
+                verts.push_back(quad[v][1]);
+                verts.push_back(quad[v][2]);
+            }
+        }
+    }
+
+    sphereMesh mesh;
+    mesh.buffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+    mesh.buffer->setUsagePattern(QGLBuffer::StaticDraw);
+    mesh.buffer->create();
+    mesh.buffer->bind();
+    mesh.buffer->allocate(verts.constData(), verts.size()*sizeof(GLfloat));
+    mesh.buffer->release();
+    mesh.numVertices = verts.size() / 3;
+
+    return &(meshes.insert(LoD, mesh).value());
+}
+
+void glNeuronRenderer::drawPopulation(const QVector <loc> &locations, const neuronDrawList &list, loc offset,
+                                      const QVector <QColor> &colours, QColor defaultColour, GLfloat radius)
+{
+    if (!available || locations.isEmpty()) {
+        return;
+    }
+
+    // an instanced draw for each level of detail in use
+    for (int level = 0; level < NEURON_LOD_LEVELS; ++level) {
+        const QVector <int> &spheres = list.spheres[level];
+        if (spheres.isEmpty()) {
+            continue;
+        }
+
+        // per neuron colours, falling back to the population colour
+        positionData.resize(spheres.size());
+        colourData.resize(spheres.size()*4);
+        GLubyte * col = colourData.data();
+        for (int i = 0; i < spheres.size(); ++i) {
+            int n = spheres[i];
+            positionData[i] = locations[n];
+            const QColor &c = n < colours.size() ? colours[n] : defaultColour;
+            col[i*4] = c.red();
+            col[i*4+1] = c.green();
+            col[i*4+2] = c.blue();
+            col[i*4+3] = c.alpha();
+        }
+        this->drawInstances(this->getMesh(NEURON_MIN_LOD << level), offset, radius);
+    }
+
+    glNeuronRenderer::drawPoints(locations, list, offset, colours, defaultColour);
+}
+
+void glNeuronRenderer::drawInstances(sphereMesh * mesh, loc offset, GLfloat radius)
+{
+    program->bind();
+    program->setUniformValue("radius", radius);
+    program->setUniformValue("offset", QVector3D(offset.x, offset.y, offset.z));
+
+    mesh->buffer->bind();
+    program->enableAttributeArray(vertexAttr);
+    program->setAttributeBuffer(vertexAttr, GL_FLOAT, 0, 3);
+
+    // loc is three packed floats, so the locations go straight into the buffer
+    positionBuffer->bind();
+    positionBuffer->allocate(positionData.constData(), positionData.size()*sizeof(loc));
+    program->enableAttributeArray(positionAttr);
+    program->setAttributeBuffer(positionAttr, GL_FLOAT, 0, 3, sizeof(loc));
+    vertexAttribDivisor(positionAttr, 1);
+
+    colourBuffer->bind();
+    colourBuffer->allocate(colourData.constData(), colourData.size());
+    program->enableAttributeArray(colourAttr);
+    program->setAttributeBuffer(colourAttr, GL_UNSIGNED_BYTE, 0, 4);
+    vertexAttribDivisor(colourAttr, 1);
+
+    drawArraysInstanced(GL_TRIANGLES, 0, mesh->numVertices, positionData.size());
+
+    // leave the attribute state as we found it for the immediate mode drawing
+    vertexAttribDivisor(positionAttr, 0);
+    vertexAttribDivisor(colourAttr, 0);
+    program->disableAttributeArray(vertexAttr);
+    program->disableAttributeArray(positionAttr);
+    program->disableAttributeArray(colourAttr);
+    colourBuffer->release();
+    program->release();
+}
+
+void glNeuronRenderer::drawPoints(const QVector <loc> &locations, const neuronDrawList &list, loc offset,
+                                  const QVector <QColor> &colours, QColor defaultColour)
+{
+    int numPoints = list.points.size() + list.clusterLocations.size();
+    if (numPoints == 0) {
+        return;
+    }
+
+    QVector <GLfloat> verts(numPoints*3);
+    QVector <GLubyte> cols(numPoints*4);
+    for (int i = 0; i < numPoints; ++i) {
+        bool cluster = i >= list.points.size();
+        int n = cluster ? list.clusterNeurons[i - list.points.size()] : list.points[i];
+        const loc &l = cluster ? list.clusterLocations[i - list.points.size()] : locations[n];
+        verts[i*3] = l.x + offset.x;
+        verts[i*3+1] = l.y + offset.y;
+        verts[i*3+2] = l.z + offset.z;
+        const QColor &c = n < colours.size() ? colours[n] : defaultColour;
+        cols[i*4] = c.red();
+        cols[i*4+1] = c.green();
+        cols[i*4+2] = c.blue();
+        cols[i*4+3] = c.alpha();
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_POINT_SMOOTH);
+    glPointSize(NEURON_POINT_PIXELS);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, verts.constData());
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, cols.constData());
+    glDrawArrays(GL_POINTS, 0, numPoints);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPopAttrib();
+}
+
+glConnectionLines::glConnectionLines()
+{
+    buffer = NULL;
+    numVertices = 0;
+}
+
+glConnectionLines::~glConnectionLines()
+{
+    delete buffer;
+}
+
+void glConnectionLines::setVertices(const QVector <GLfloat> &vertices)
+{
+    numVertices = vertices.size() / 3;
+
+    if (buffer == NULL) {
+        buffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+        buffer->setUsagePattern(QGLBuffer::StaticDraw);
+        if (!buffer->create()) {
+            delete buffer;
+            buffer = NULL;
+        }
+    }
+
+    if (buffer != NULL) {
+        buffer->bind();
+        buffer->allocate(vertices.constData(), vertices.size()*sizeof(GLfloat));
+        buffer->release();
+        clientVertices.clear();
+    } else {
+        clientVertices = vertices;
+    }
+}
+
+void glConnectionLines::draw(GLenum mode)
+{
+    if (numVertices == 0) {
+        return;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (buffer != NULL) {
+        buffer->bind();
+        glVertexPointer(3, GL_FLOAT, 0, 0);
+    } else {
+        glVertexPointer(3, GL_FLOAT, 0, clientVertices.constData());
+    }
+    glDrawArrays(mode, 0, numVertices);
+    if (buffer != NULL) {
+        buffer->release();
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+neuronPickGrid::neuronPickGrid()
+{
+    radius = 0;
+    cellSize = 1;
+    mins.x = 0; mins.y = 0; mins.z = 0;
+    dims[0] = 0; dims[1] = 0; dims[2] = 0;
+}
+
+bool neuronPickGrid::isBuiltFor(const QVector <loc> &locations, GLfloat radius) const
+{
+    // a changed layout is a different (detached) vector
+    return this->locations.constData() == locations.constData()
+            && this->locations.size() == locations.size() && this->radius == radius;
+}
+
+void neuronPickGrid::build(const QVector <loc> &locations, GLfloat radius)
+{
+    this->locations = locations;
+    this->radius = radius;
+    cellStart.clear();
+    cellNeurons.clear();
+    dims[0] = 0; dims[1] = 0; dims[2] = 0;
+    if (locations.isEmpty()) {
+        return;
+    }
+
+    loc maxes = locations[0];
+    mins = locations[0];
+    for (int i = 1; i < locations.size(); ++i) {
+        mins.x = qMin(mins.x, locations[i].x); maxes.x = qMax(maxes.x, locations[i].x);
+        mins.y = qMin(mins.y, locations[i].y); maxes.y = qMax(maxes.y, locations[i].y);
+        mins.z = qMin(mins.z, locations[i].z); maxes.z = qMax(maxes.z, locations[i].z);
+    }
+    mins.x -= radius; mins.y -= radius; mins.z -= radius;
+    maxes.x += radius; maxes.y += radius; maxes.z += radius;
+
+    // about one neuron per cell, but never smaller than a neuron so each
+    // neuron overlaps at most 8 cells
+    GLfloat extent[3] = {maxes.x - mins.x, maxes.y - mins.y, maxes.z - mins.z};
+    GLfloat volume = qMax(extent[0], 2*radius) * qMax(extent[1], 2*radius) * qMax(extent[2], 2*radius);
+    cellSize = qMax(2*radius, GLfloat(pow(volume/GLfloat(locations.size()), 1.0/3.0)));
+    if (!(cellSize > 0)) {
+        cellSize = 1;
+    }
+    for (;;) {
+        qint64 numCells = 1;
+        for (int d = 0; d < 3; ++d) {
+            dims[d] = qMax(1, int(ceil(extent[d]/cellSize)));
+            numCells *= dims[d];
+        }
+        if (numCells <= 8 * (qint64) locations.size() + 64) {
+            break;
+        }
+        cellSize *= 2;
+    }
+    int numCells = dims[0]*dims[1]*dims[2];
+
+    // count then fill the cells each neuron's bounding box overlaps
+    cellStart.fill(0, numCells+1);
+    for (int pass = 0; pass < 2; ++pass) {
+        QVector <int> fillPos;
+        if (pass == 1) {
+            for (int c = 0; c < numCells; ++c) {
+                cellStart[c+1] += cellStart[c];
+            }
+            cellNeurons.resize(cellStart[numCells]);
+            fillPos = cellStart;
+        }
+        for (int i = 0; i < locations.size(); ++i) {
+            int lo[3], hi[3];
+            GLfloat p[3] = {locations[i].x - mins.x, locations[i].y - mins.y, locations[i].z - mins.z};
+            for (int d = 0; d < 3; ++d) {
+                lo[d] = qBound(0, int((p[d] - radius)/cellSize), dims[d]-1);
+                hi[d] = qBound(0, int((p[d] + radius)/cellSize), dims[d]-1);
+            }
+            for (int z = lo[2]; z <= hi[2]; ++z) {
+                for (int y = lo[1]; y <= hi[1]; ++y) {
+                    for (int x = lo[0]; x <= hi[0]; ++x) {
+                        int c = (z*dims[1] + y)*dims[0] + x;
+                        if (pass == 0) {
+                            ++cellStart[c+1];
+                        } else {
+                            cellNeurons[fillPos[c]++] = i;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * Return the index of the first neuron hit by the ray from origin along dir,
+ * setting t to the distance along the ray, or -1 if none is hit.
+ */
+int neuronPickGrid::pick(loc origin, loc dir, GLfloat &t) const
+{
+    if (cellStart.isEmpty()) {
+        return -1;
+    }
+
+    GLfloat len = sqrt(dir.x*dir.x + dir.y*dir.y + dir.z*dir.z);
+    if (len == 0) {
+        return -1;
+    }
+    GLfloat o[3] = {origin.x - mins.x, origin.y - mins.y, origin.z - mins.z};
+    GLfloat d[3] = {dir.x/len, dir.y/len, dir.z/len};
+
+    // clip the ray to the grid
+    GLfloat tEnter = 0;
+    GLfloat tExit = std::numeric_limits<GLfloat>::max();
+    for (int a = 0; a < 3; ++a) {
+        GLfloat size = dims[a]*cellSize;
+        if (d[a] == 0) {
+            if (o[a] < 0 || o[a] > size) {
+                return -1;
+            }
+            continue;
+        }
+        GLfloat t0 = (0 - o[a])/d[a];
+        GLfloat t1 = (size - o[a])/d[a];
+        if (t0 > t1) {
+            qSwap(t0, t1);
+        }
+        tEnter = qMax(tEnter, t0);
+        tExit = qMin(tExit, t1);
+    }
+    if (tEnter > tExit) {
+        return -1;
+    }
+
+    // walk the cells along the ray
+    int cell[3], step[3];
+    GLfloat tMax[3], tDelta[3];
+    for (int a = 0; a < 3; ++a) {
+        GLfloat p = o[a] + d[a]*tEnter;
+        cell[a] = qBound(0, int(p/cellSize), dims[a]-1);
+        if (d[a] > 0) {
+            step[a] = 1;
+            tMax[a] = tEnter + ((cell[a]+1)*cellSize - p)/d[a];
+            tDelta[a] = cellSize/d[a];
+        } else if (d[a] < 0) {
+            step[a] = -1;
+            tMax[a] = tEnter + (cell[a]*cellSize - p)/d[a];
+            tDelta[a] = -cellSize/d[a];
+        } else {
+            step[a] = 0;
+            tMax[a] = std::numeric_limits<GLfloat>::max();
+            tDelta[a] = 0;
+        }
+    }
+
+    int best = -1;
+    GLfloat bestT = std::numeric_limits<GLfloat>::max();
+    GLfloat r2 = radius*radius;
+    for (;;) {
+        int c = (cell[2]*dims[1] + cell[1])*dims[0] + cell[0];
+        for (int n = cellStart[c]; n < cellStart[c+1]; ++n) {
+            const loc &l = locations[cellNeurons[n]];
+            GLfloat oc[3] = {o[0] - (l.x - mins.x), o[1] - (l.y - mins.y), o[2] - (l.z - mins.z)};
+            GLfloat b = oc[0]*d[0] + oc[1]*d[1] + oc[2]*d[2];
+            GLfloat disc = b*b - (oc[0]*oc[0] + oc[1]*oc[1] + oc[2]*oc[2] - r2);
+            if (disc < 0) {
+                continue;
+            }
+            GLfloat root = sqrt(disc);
+            GLfloat hit = -b - root;
+            if (hit < 0) {
+                hit = -b + root;
+            }
+            if (hit >= 0 && hit < bestT) {
+                bestT = hit;
+                best = cellNeurons[n];
+            }
+        }
+
+        // nothing in a later cell can be nearer than the end of this one
+        int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        if ((best != -1 && bestT <= tMax[a]) || tMax[a] > tExit) {
+            break;
+        }
+        cell[a] += step[a];
+        if (cell[a] < 0 || cell[a] >= dims[a]) {
+            break;
+        }
+        tMax[a] += tDelta[a];
+    }
+
+    t = bestT;
+    return best;
+}
+
+void neuronDrawList::clear()
+{
+    for (int level = 0; level < NEURON_LOD_LEVELS; ++level) {
+        spheres[level].resize(0);
+    }
+    points.resize(0);
+    clusterLocations.resize(0);
+    clusterNeurons.resize(0);
+}
+
+neuronView::neuronView()
+{
+    for (int p = 0; p < 6; ++p) {
+        planes[p][0] = 0; planes[p][1] = 0; planes[p][2] = 0; planes[p][3] = 1;
+    }
+    eyeDepth[0] = 0; eyeDepth[1] = 0; eyeDepth[2] = 0; eyeDepth[3] = -1;
+    pixelScale = 1;
+    ortho = false;
+    detail = 1;
+}
+
+void neuronView::set(const GLdouble * modelview, const GLdouble * projection, const GLint * viewport, int detail)
+{
+    // the planes are the sums and differences of the rows of the clip
+    // matrix (the matrices are column major)
+    GLdouble clip[16];
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            clip[c*4+r] = 0;
+            for (int k = 0; k < 4; ++k) {
+                clip[c*4+r] += projection[k*4+r] * modelview[c*4+k];
+            }
+        }
+    }
+    for (int p = 0; p < 6; ++p) {
+        int row = p / 2;
+        GLdouble sign = (p % 2 == 0) ? 1 : -1;
+        GLdouble plane[4];
+        for (int c = 0; c < 4; ++c) {
+            plane[c] = clip[c*4+3] + sign * clip[c*4+row];
+        }
+        GLdouble len = sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+        if (len == 0) {
+            len = 1;
+        }
+        for (int c = 0; c < 4; ++c) {
+            planes[p][c] = GLfloat(plane[c] / len);
+        }
+    }
+
+    // the depth in front of the eye is minus the eye z
+    for (int c = 0; c < 4; ++c) {
+        eyeDepth[c] = GLfloat(-modelview[c*4+2]);
+    }
+    ortho = projection[11] == 0 && projection[15] == 1;
+    pixelScale = GLfloat(fabs(projection[5]) * viewport[3] / 2.0);
+    this->detail = GLfloat(pow(2.0, double(detail - NEURON_DEFAULT_DETAIL)));
+}
+
+int neuronView::classify(loc mins, loc maxes) const
+{
+    int result = 2;
+    for (int p = 0; p < 6; ++p) {
+        const GLfloat * plane = planes[p];
+        // the corners furthest inside and furthest outside the plane
+        GLfloat inside = plane[3], outside = plane[3];
+        inside += plane[0] * (plane[0] > 0 ? maxes.x : mins.x);
+        inside += plane[1] * (plane[1] > 0 ? maxes.y : mins.y);
+        inside += plane[2] * (plane[2] > 0 ? maxes.z : mins.z);
+        if (inside < 0) {
+            return 0;
+        }
+        outside += plane[0] * (plane[0] > 0 ? mins.x : maxes.x);
+        outside += plane[1] * (plane[1] > 0 ? mins.y : maxes.y);
+        outside += plane[2] * (plane[2] > 0 ? mins.z : maxes.z);
+        if (outside < 0) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+bool neuronView::contains(loc centre, GLfloat radius) const
+{
+    for (int p = 0; p < 6; ++p) {
+        const GLfloat * plane = planes[p];
+        if (plane[0]*centre.x + plane[1]*centre.y + plane[2]*centre.z + plane[3] < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+GLfloat neuronView::pixelsAcross(loc centre, GLfloat size, GLfloat slack) const
+{
+    if (ortho) {
+        return size * pixelScale;
+    }
+    GLfloat depth = eyeDepth[0]*centre.x + eyeDepth[1]*centre.y + eyeDepth[2]*centre.z + eyeDepth[3] - slack;
+    // up to or around the eye, so as near as can be
+    if (depth <= 1e-3f) {
+        return std::numeric_limits<GLfloat>::max();
+    }
+    return size * pixelScale / depth;
+}
+
+neuronOctree::neuronOctree()
+{
+    radius = 0;
+}
+
+bool neuronOctree::isBuiltFor(const QVector <loc> &locations, GLfloat radius) const
+{
+    // a changed layout is a different (detached) vector
+    return this->locations.constData() == locations.constData()
+            && this->locations.size() == locations.size() && this->radius == radius;
+}
+
+void neuronOctree::build(const QVector <loc> &locations, GLfloat radius)
+{
+    this->locations = locations;
+    this->radius = radius;
+    nodes.clear();
+    order.resize(locations.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    if (locations.isEmpty()) {
+        return;
+    }
+
+    node root;
+    root.first = 0;
+    root.count = locations.size();
+    nodes.push_back(root);
+    QVector <int> depths(1, 0);
+    QVector <int> scratch;
+    QVector <int> sorted;
+
+    // breadth first, so the children of each node are added together
+    for (int n = 0; n < nodes.size(); ++n) {
+        node current = nodes[n];
+
+        // the bounds and centroid of the neurons the node holds
+        const loc &start = locations[order[current.first]];
+        current.mins = start;
+        current.maxes = start;
+        double sum[3] = {0, 0, 0};
+        for (int i = current.first; i < current.first + current.count; ++i) {
+            const loc &l = locations[order[i]];
+            current.mins.x = qMin(current.mins.x, l.x); current.maxes.x = qMax(current.maxes.x, l.x);
+            current.mins.y = qMin(current.mins.y, l.y); current.maxes.y = qMax(current.maxes.y, l.y);
+            current.mins.z = qMin(current.mins.z, l.z); current.maxes.z = qMax(current.maxes.z, l.z);
+            sum[0] += l.x; sum[1] += l.y; sum[2] += l.z;
+        }
+        current.centroid.x = GLfloat(sum[0] / current.count);
+        current.centroid.y = GLfloat(sum[1] / current.count);
+        current.centroid.z = GLfloat(sum[2] / current.count);
+        current.firstChild = -1;
+        current.numChildren = 0;
+
+        bool coincident = current.mins.x == current.maxes.x && current.mins.y == current.maxes.y
+                && current.mins.z == current.maxes.z;
+        if (current.count > NEURON_OCTREE_LEAF_SIZE && depths[n] < NEURON_OCTREE_MAX_DEPTH && !coincident) {
+            // sort the neurons into the octants about the middle of the bounds
+            loc mid;
+            mid.x = 0.5f * (current.mins.x + current.maxes.x);
+            mid.y = 0.5f * (current.mins.y + current.maxes.y);
+            mid.z = 0.5f * (current.mins.z + current.maxes.z);
+            int counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            scratch.resize(current.count);
+            for (int i = 0; i < current.count; ++i) {
+                const loc &l = locations[order[current.first + i]];
+                int octant = (l.x > mid.x ? 1 : 0) | (l.y > mid.y ? 2 : 0) | (l.z > mid.z ? 4 : 0);
+                scratch[i] = octant;
+                ++counts[octant];
+            }
+            int fill[8];
+            int pos = 0;
+            for (int o = 0; o < 8; ++o) {
+                fill[o] = pos;
+                pos += counts[o];
+            }
+            sorted.resize(current.count);
+            for (int i = 0; i < current.count; ++i) {
+                sorted[fill[scratch[i]]++] = order[current.first + i];
+            }
+            memcpy(order.data() + current.first, sorted.constData(), current.count * sizeof(int));
+
+            current.firstChild = nodes.size();
+            pos = current.first;
+            for (int o = 0; o < 8; ++o) {
+                if (counts[o] == 0) {
+                    continue;
+                }
+                node child;
+                child.first = pos;
+                child.count = counts[o];
+                pos += counts[o];
+                nodes.push_back(child);
+                depths.push_back(depths[n] + 1);
+                ++current.numChildren;
+            }
+        }
+        nodes[n] = current;
+    }
+}
+
+void neuronOctree::collect(const neuronView &view, loc offset, neuronDrawList &out) const
+{
+    if (nodes.isEmpty()) {
+        return;
+    }
+
+    GLfloat diameter = 2 * radius;
+    GLfloat sphereMin = NEURON_SPHERE_MIN_PIXELS / view.detail;
+    QVector <int> stack;
+    stack.push_back(0);
+    while (!stack.isEmpty()) {
+        const node &current = nodes[stack.back()];
+        stack.pop_back();
+
+        // the bounds of the spheres, where they are drawn
+        loc mins, maxes, centroid;
+        mins.x = current.mins.x + offset.x - radius; maxes.x = current.maxes.x + offset.x + radius;
+        mins.y = current.mins.y + offset.y - radius; maxes.y = current.maxes.y + offset.y + radius;
+        mins.z = current.mins.z + offset.z - radius; maxes.z = current.maxes.z + offset.z + radius;
+        int side = view.classify(mins, maxes);
+        if (side == 0) {
+            continue;
+        }
+        centroid.x = current.centroid.x + offset.x;
+        centroid.y = current.centroid.y + offset.y;
+        centroid.z = current.centroid.z + offset.z;
+        GLfloat dx = maxes.x - mins.x, dy = maxes.y - mins.y, dz = maxes.z - mins.z;
+        GLfloat extent = sqrt(dx*dx + dy*dy + dz*dz);
+
+        // too small to tell its neurons apart
+        if (current.count > 1 && view.pixelsAcross(centroid, extent, extent) <= NEURON_CLUSTER_MAX_PIXELS) {
+            out.clusterLocations.push_back(centroid);
+            out.clusterNeurons.push_back(order[current.first]);
+            continue;
+        }
+
+        // every neuron too small to show its shape, even the nearest
+        bool allPoints = view.pixelsAcross(centroid, diameter, extent) < sphereMin;
+        if (!allPoints && current.firstChild >= 0) {
+            for (int c = 0; c < current.numChildren; ++c) {
+                stack.push_back(current.firstChild + c);
+            }
+            continue;
+        }
+
+        for (int i = current.first; i < current.first + current.count; ++i) {
+            int n = order[i];
+            loc l;
+            l.x = locations[n].x + offset.x;
+            l.y = locations[n].y + offset.y;
+            l.z = locations[n].z + offset.z;
+            if (side == 1 && !view.contains(l, radius)) {
+                continue;
+            }
+            GLfloat pixels = allPoints ? 0 : view.pixelsAcross(l, diameter);
+            if (pixels < sphereMin) {
+                out.points.push_back(n);
+                continue;
+            }
+            // the fewest rings for the size
+            GLfloat rings = pixels * view.detail / NEURON_PIXELS_PER_RING;
+            int level = 0;
+            while (level < NEURON_LOD_LEVELS - 1 && (NEURON_MIN_LOD << level) < rings) {
+                ++level;
+            }
+            out.spheres[level].push_back(n);
+        }
+    }
+}
@@ -0,0 +1,223 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+#ifndef GLNEURONRENDERER_H
+#define GLNEURONRENDERER_H
+
+#include "globalHeader.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// an octree node with more neurons than this is split
+#define NEURON_OCTREE_LEAF_SIZE 64
+// and no deeper than this, for neurons laid out on top of one another
+#define NEURON_OCTREE_MAX_DEPTH 16
+
+// spheres are drawn with NEURON_MIN_LOD rings, doubled for each level
+#define NEURON_MIN_LOD 4
+#define NEURON_LOD_LEVELS 4
+// the pixels across a sphere for each ring it is drawn with
+#define NEURON_PIXELS_PER_RING 4.0f
+// neurons smaller than this many pixels across are drawn as points
+#define NEURON_SPHERE_MIN_PIXELS 4.0f
+// and clusters of neurons smaller than this many as a single point
+#define NEURON_CLUSTER_MAX_PIXELS 2.0f
+#define NEURON_POINT_PIXELS 3.0f
+// the detail setting at which the sizes above are used; each step up or
+// down doubles or halves the detail
+#define NEURON_DEFAULT_DETAIL 5
+
+/*!
+ * \brief The neuronDrawList struct is what neuronOctree::collect finds to
+ * draw of a population in a view: the neurons near enough to be spheres,
+ * by level of detail, the neurons drawn as points, and the clusters so far
+ * away that each is drawn as one point, in the colour of one of its neurons.
+ */
+struct neuronDrawList
+{
+    void clear();
+    QVector <int> spheres[NEURON_LOD_LEVELS];
+    QVector <int> points;
+    QVector <loc> clusterLocations;
+    QVector <int> clusterNeurons;
+};
+
+/*!
+ * \brief The neuronView class is the view neurons are drawn in, from the GL
+ * matrices and viewport: the planes of its frustum, for culling, and the
+ * scale from the size of something to the pixels it covers.
+ */
+class neuronView
+{
+public:
+    neuronView();
+    void set(const GLdouble * modelview, const GLdouble * projection, const GLint * viewport, int detail);
+    // 0 if the box is outside the frustum, 1 if it is partly inside and 2 if
+    // it is inside
+    int classify(loc mins, loc maxes) const;
+    bool contains(loc centre, GLfloat radius) const;
+    // the pixels across something of the given size at centre, or, with
+    // slack, at slack nearer the eye than centre
+    GLfloat pixelsAcross(loc centre, GLfloat size, GLfloat slack = 0) const;
+    // multiplies the pixels across a neuron must be for a level of detail
+    GLfloat detail;
+
+private:
+    GLfloat planes[6][4];
+    GLfloat eyeDepth[4];
+    GLfloat pixelScale;
+    bool ortho;
+};
+
+/*!
+ * \brief The neuronOctree class divides the locations of a population into
+ * an octree, so each frame only the nodes in the view are walked: those
+ * outside it are culled whole, those too small to see are drawn as a single
+ * point, and only the neurons near enough to show their shape are drawn as
+ * spheres, with the level of detail their size on screen needs.
+ */
+class neuronOctree
+{
+public:
+    neuronOctree();
+    void build(const QVector <loc> &locations, GLfloat radius);
+    bool isBuiltFor(const QVector <loc> &locations, GLfloat radius) const;
+    // what to draw of the neurons, moved by offset, in view
+    void collect(const neuronView &view, loc offset, neuronDrawList &out) const;
+
+private:
+    struct node {
+        loc mins;
+        loc maxes;
+        loc centroid;
+        // the neurons of the node are order[first] to order[first+count-1]
+        int first;
+        int count;
+        // the children are contiguous, or firstChild is -1 for a leaf
+        int firstChild;
+        int numChildren;
+    };
+
+    QVector <loc> locations;
+    GLfloat radius;
+    QVector <node> nodes;
+    QVector <int> order;
+};
+
+/*!
+ * \brief The glNeuronRenderer class draws the neurons of a population as
+ * instanced spheres: a sphere mesh is built once for each level of detail and
+ * every neuron's position and colour goes into an instance buffer, so a whole
+ * population is one draw call. If the context lacks GLSL or instanced arrays
+ * initialise() returns false and the caller keeps using immediate mode.
+ */
+class glNeuronRenderer
+{
+public:
+    glNeuronRenderer();
+    ~glNeuronRenderer();
+    bool initialise(const QGLContext * context);
+    bool isAvailable() {return available;}
+    void drawPopulation(const QVector <loc> &locations, const neuronDrawList &list, loc offset,
+                        const QVector <QColor> &colours, QColor defaultColour, GLfloat radius);
+    /*!
+     * Draw the points and clusters of the list as smooth, unlit points, with
+     * or without the renderer, as the instanced spheres would not be seen.
+     */
+    static void drawPoints(const QVector <loc> &locations, const neuronDrawList &list, loc offset,
+                           const QVector <QColor> &colours, QColor defaultColour);
+
+private:
+    typedef void (APIENTRY * drawArraysInstancedFn)(GLenum, GLint, GLsizei, GLsizei);
+    typedef void (APIENTRY * vertexAttribDivisorFn)(GLuint, GLuint);
+
+    struct sphereMesh {
+        QGLBuffer * buffer;
+        int numVertices;
+    };
+
+    sphereMesh * getMesh(int LoD);
+    void drawInstances(sphereMesh * mesh, loc offset, GLfloat radius);
+
+    bool available;
+    QGLShaderProgram * program;
+    QMap <int, sphereMesh> meshes;
+    QGLBuffer * positionBuffer;
+    QGLBuffer * colourBuffer;
+    QVector <GLubyte> colourData;
+    QVector <loc> positionData;
+    drawArraysInstancedFn drawArraysInstanced;
+    vertexAttribDivisorFn vertexAttribDivisor;
+    int vertexAttr;
+    int positionAttr;
+    int colourAttr;
+};
+
+/*!
+ * \brief The glConnectionLines class holds the vertices of a set of
+ * connections in a vertex buffer, so they are uploaded once when the
+ * connectivity changes rather than sent vertex by vertex every frame. Falls
+ * back to a client side vertex array if buffers cannot be created.
+ */
+class glConnectionLines
+{
+public:
+    glConnectionLines();
+    ~glConnectionLines();
+    void setVertices(const QVector <GLfloat> &vertices);
+    void draw(GLenum mode);
+
+private:
+    QGLBuffer * buffer;
+    QVector <GLfloat> clientVertices;
+    int numVertices;
+};
+
+/*!
+ * \brief The neuronPickGrid class buckets the locations of a population into
+ * a uniform grid, so a ray cast from the mouse is only tested against the
+ * neurons in the cells it passes through, nearest cell first.
+ */
+class neuronPickGrid
+{
+public:
+    neuronPickGrid();
+    void build(const QVector <loc> &locations, GLfloat radius);
+    bool isBuiltFor(const QVector <loc> &locations, GLfloat radius) const;
+    int pick(loc origin, loc dir, GLfloat &t) const;
+
+private:
+    QVector <loc> locations;
+    GLfloat radius;
+    loc mins;
+    GLfloat cellSize;
+    int dims[3];
+    // neurons of cell c are cellNeurons[cellStart[c]] to cellNeurons[cellStart[c+1]-1]
+    QVector <int> cellStart;
+    QVector <int> cellNeurons;
+};
+
+#endif // GLNEURONRENDERER_H
@@ -31,6 +31,9 @@
 #include "GL/glu.h"
 #endif
 #include "SC_python_connection_generate_dialog.h"
+#include "SC_settings.h"
+#include "SC_profiler.h"
+#include "EL_experiment.h"
 #include "mainwindow.h"
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
 #include <QOpenGLFramebufferObject>
@@ -45,8 +48,30 @@
   #endif
 #endif
 #include <limits>
+#include <algorithm>
 
 
+/*!
+ * The black-red-yellow-white colour scale used to show logged values, sampled
+ * at LOG_COLOUR_LUT_SIZE points from the minimum to the maximum of the log.
+ */
+static QVector <QColor> buildLogColourLUT()
+{
+    QVector <QColor> lut(LOG_COLOUR_LUT_SIZE);
+    for (int i = 0; i < LOG_COLOUR_LUT_SIZE; ++i) {
+        int val = (i*255)/(LOG_COLOUR_LUT_SIZE-1);
+        val *= 3;
+        // complete the remap in just 4 ternarys
+        int val3 = val > 511 ? val-512 : 0;
+        int val2 = val3 > 0 ? 511 : val;
+        val2 = val2 > 255 ? val2 - 256 : 0;
+        int val1 = val < 255 ? val : 255;
+
+        lut[i] = QColor(val1,val2, val3, 255);
+    }
+    return lut;
+}
+
 glConnectionWidget::glConnectionWidget(nl_rootdata * data, QWidget *parent) : QGLWidget(QGLFormat(QGL::SampleBuffers), parent)
 {
     model = (QAbstractTableModel *)0;
@@ -59,20 +84,482 @@ glConnectionWidget::glConnectionWidget(nl_rootdata * data, QWidget *parent) : QG
     selectedType = 1;
     connGenerationMutex = new QMutex;
     imageSaveMode = false;
+    imageTile = QRect();
+    pickValid = false;
 
-    connect(&timer, SIGNAL(timeout()), this, SLOT(updateLogData()));
-
-    timer.start(50);
+    // the playback position is picked up on the next animation frame
     newLogTime = 0;
     currentLogTime = 0;
 
+    // rows are read ahead of the playback position on their own thread
+    logPrefetch = new logRowPrefetcher;
+    logPrefetch->moveToThread(&prefetchThread);
+    prefetchThread.start();
+
+    live = (liveActivityReceiver *) 0;
+
     orthoView = false;
     repaintAllowed = true;
+    repaintTimer.setSingleShot(true);
+    repaintTimer.setInterval(5);
+    connect(&repaintTimer, SIGNAL(timeout()), this, SLOT(allowRepaint()));
+    profilerTimer.setSingleShot(true);
+    profilerTimer.setInterval(500);
+    connect(&profilerTimer, SIGNAL(timeout()), this, SLOT(update()));
+    neuronRenderer = NULL;
+
+    logColourLUT = buildLogColourLUT();
+
+    // so that Escape reaches keyPressEvent once the view is clicked
+    setFocusPolicy(Qt::ClickFocus);
+}
+
+glConnectionWidget::~glConnectionWidget()
+{
+    animationScheduler::remove(this);
+
+    // stop any script that is still running, and let it finish
+    QMap <pythonscript_connection *, QPointer <pythonscript_connection> >::const_iterator gen;
+    for (gen = generatingConns.constBegin(); gen != generatingConns.constEnd(); ++gen) {
+        if (gen.value()) {
+            gen.value()->cancelGeneration();
+        }
+    }
+    generationThread.quit();
+    generationThread.wait();
+    prefetchThread.quit();
+    prefetchThread.wait();
+    delete logPrefetch;
+    for (int i = 0; i < popLogs.size(); ++i) {
+        logRegistry::release(popLogs[i]);
+    }
+    this->stopLiveActivity();
+
+    // GL buffers must be freed in their own context
+    this->makeCurrent();
+    delete neuronRenderer;
+    QMap <systemObject *, connectionLineCache>::iterator it;
+    for (it = lineCaches.begin(); it != lineCaches.end(); ++it) {
+        delete it.value().lines;
+    }
+}
+
+void glConnectionWidget::invalidateConnectionLines()
+{
+    // the connection vectors may have been refilled in place
+    QMap <systemObject *, connectionLineCache>::iterator it;
+    for (it = lineCaches.begin(); it != lineCaches.end(); ++it) {
+        it.value().dirty = true;
+    }
+    adjacencies.clear();
+    weightColours.clear();
+}
+
+/*!
+ * The source and destination index of connections[targNum]. Explicit lists
+ * keep their own index; otherwise one is built the first time it is needed
+ * after the connections change.
+ */
+const connectionAdjacency & glConnectionWidget::getAdjacency(int targNum)
+{
+    connection * conn;
+    if (selectedConns[targNum]->type == synapseObject) {
+        QSharedPointer <synapse> currTarg = qSharedPointerDynamicCast <synapse> (selectedConns[targNum]);
+        conn = currTarg.isNull() ? NULL : currTarg->connectionType;
+    } else {
+        QSharedPointer<genericInput> currIn = qSharedPointerDynamicCast<genericInput> (selectedConns[targNum]);
+        conn = currIn.isNull() ? NULL : currIn->conn;
+    }
+    if (conn != NULL && conn->type == CSV) {
+        csv_connection * csv_conn = dynamic_cast<csv_connection *> (conn);
+        // connections[targNum] is a copy of the list, row for row
+        if (csv_conn != NULL && csv_conn->getNumRows() == connections[targNum].size()) {
+            return csv_conn->getAdjacency();
+        }
+    }
+
+    systemObject * key = selectedConns[targNum].data();
+    QMap <systemObject *, connectionAdjacency>::iterator it = adjacencies.find(key);
+    if (it == adjacencies.end()) {
+        it = adjacencies.insert(key, connectionAdjacency());
+        it.value().build(connections[targNum]);
+    }
+    return it.value();
+}
+
+/*!
+ * The weights of connections[targNum] scaled across the range of the whole
+ * projection, with their statistics. They are computed the first time they
+ * are needed after the connections or the weight list change.
+ */
+const weightColourCache & glConnectionWidget::getWeightColours(int targNum, const ParameterInstance * weights)
+{
+    weightColourCache &cache = weightColours[selectedConns[targNum].data()];
+    int numConns = connections[targNum].size();
+    if (cache.weights == weights && cache.numConns == numConns
+        && cache.values == weights->value.constData() && cache.numValues == weights->value.size()
+        && cache.indices == weights->indices.constData() && cache.numIndices == weights->indices.size()) {
+        return cache;
+    }
+
+    cache.stats.compute(weights);
+    explicitValueLookup weightOf(weights);
+    cache.normalised.resize(numConns);
+    for (int i = 0; i < numConns; ++i) {
+        cache.normalised[i] = weightOf.contains(i) ? (GLfloat) cache.stats.normalised(weightOf.at(i)) : 1.0f;
+    }
+    cache.weights = weights;
+    cache.numConns = numConns;
+    cache.values = weights->value.constData();
+    cache.numValues = weights->value.size();
+    cache.indices = weights->indices.constData();
+    cache.numIndices = weights->indices.size();
+    return cache;
+}
+
+/*!
+ * Draw the connections of selectedConns[targNum] from a vertex buffer, which
+ * is rebuilt only when the connections, the locations or offsets of either
+ * end, or the number of connections to draw have changed.
+ */
+void glConnectionWidget::drawConnectionLines(int targNum, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset)
+{
+    const QVector <conn> &conns = connections[targNum];
+    const QVector <loc> &srcLocs = src->layoutType->locations;
+    const QVector <loc> &dstLocs = dst->layoutType->locations;
+
+    // Only render a subsample of the black connections lines, as set in the settings
+    int maxConnections = settingsCache::glMaxConnections();
+    int inc = 1;
+    if (maxConnections > 0 && conns.size() > maxConnections) {
+        // Compute inc based on number of connections:
+        inc = (int) conns.size()/maxConnections;
+    }
+
+    connectionLineCache &cache = lineCaches[selectedConns[targNum].data()];
+    if (cache.lines == NULL) {
+        cache.lines = new glConnectionLines;
+        cache.dirty = true;
+    }
+
+    if (cache.dirty || cache.type != CSV || cache.connData != conns.constData() || cache.numConns != conns.size()
+        || cache.srcLocs != srcLocs.constData() || cache.numSrc != srcLocs.size()
+        || cache.dstLocs != dstLocs.constData() || cache.numDst != dstLocs.size()
+        || cache.srcOffset.x != srcOffset.x || cache.srcOffset.y != srcOffset.y || cache.srcOffset.z != srcOffset.z
+        || cache.dstOffset.x != dstOffset.x || cache.dstOffset.y != dstOffset.y || cache.dstOffset.z != dstOffset.z
+        || cache.srcVisualised != src->isVisualised || cache.dstVisualised != dst->isVisualised
+        || cache.inc != inc) {
+
+        QVector <GLfloat> verts;
+        verts.reserve((conns.size()/inc + 1)*9);
+
+        for (int i = 0; i < conns.size(); i+=inc) {
+
+            if (conns[i].src < srcLocs.size() && conns[i].dst < dstLocs.size()) {
+
+                // each connection is a thin triangle from src to dst
+                loc a, b;
+                float lift;
+                if (src->isVisualised && dst->isVisualised) {
+                    a.x = srcLocs[conns[i].src].x+srcOffset.x; a.y = srcLocs[conns[i].src].y+srcOffset.y; a.z = srcLocs[conns[i].src].z+srcOffset.z;
+                    b.x = dstLocs[conns[i].dst].x+dstOffset.x; b.y = dstLocs[conns[i].dst].y+dstOffset.y; b.z = dstLocs[conns[i].dst].z+dstOffset.z;
+                    lift = 0.05;
+                } else if (src->isVisualised && !dst->isVisualised) {
+                    a = srcLocs[conns[i].src];
+                    b.x = dstOffset.x; b.y = dstOffset.y; b.z = dstOffset.z;
+                    lift = 0.01;
+                } else if (!src->isVisualised && dst->isVisualised) {
+                    a = src->loc3;
+                    b = dstLocs[conns[i].dst];
+                    lift = 0.01;
+                } else {
+                    continue;
+                }
+                verts.push_back(a.x); verts.push_back(a.y); verts.push_back(a.z);
+                verts.push_back(b.x); verts.push_back(b.y); verts.push_back(b.z);
+                verts.push_back(b.x); verts.push_back(b.y); verts.push_back(b.z+lift);
+
+            } else {
+                // ERR - CONNECTION INDEX OUT OF RANGE
+            }
+        }
+
+        cache.lines->setVertices(verts);
+        cache.dirty = false;
+        // any explicit list
+        cache.type = CSV;
+        cache.connData = conns.constData();
+        cache.numConns = conns.size();
+        cache.prob = -1;
+        cache.srcLocs = srcLocs.constData();
+        cache.numSrc = srcLocs.size();
+        cache.dstLocs = dstLocs.constData();
+        cache.numDst = dstLocs.size();
+        cache.srcOffset = srcOffset;
+        cache.dstOffset = dstOffset;
+        cache.srcVisualised = src->isVisualised;
+        cache.dstVisualised = dst->isVisualised;
+        cache.inc = inc;
+    }
+
+    glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
+    cache.lines->draw(GL_TRIANGLES);
+}
+
+namespace {
+    // packs generated connections into thin triangles, as drawConnectionLines does
+    class fixedProbLineBuilder : public fixedProbSink
+    {
+    public:
+        fixedProbLineBuilder(const QVector <loc> &srcLocs, const QVector <loc> &dstLocs, loc3f srcOffset, loc3f dstOffset, int inc, QVector <GLfloat> &verts)
+            : srcLocs(srcLocs), dstLocs(dstLocs), srcOffset(srcOffset), dstOffset(dstOffset), inc(inc), count(0), verts(verts) {}
+        bool addConnections(const connArrays &block) {
+            for (int i = 0; i < block.src.size(); ++i, ++count) {
+                if (count % inc != 0) {
+                    continue;
+                }
+                const loc &a = srcLocs[block.src[i]];
+                const loc &b = dstLocs[block.dst[i]];
+                verts.push_back(a.x+srcOffset.x); verts.push_back(a.y+srcOffset.y); verts.push_back(a.z+srcOffset.z);
+                verts.push_back(b.x+dstOffset.x); verts.push_back(b.y+dstOffset.y); verts.push_back(b.z+dstOffset.z);
+                verts.push_back(b.x+dstOffset.x); verts.push_back(b.y+dstOffset.y); verts.push_back(b.z+dstOffset.z+0.05f);
+            }
+            return true;
+        }
+    private:
+        const QVector <loc> &srcLocs;
+        const QVector <loc> &dstLocs;
+        loc3f srcOffset;
+        loc3f dstOffset;
+        int inc;
+        qint64 count;
+        QVector <GLfloat> &verts;
+    };
+
+    qint64 greatestCommonDivisor(qint64 a, qint64 b)
+    {
+        while (b != 0) {
+            qint64 r = a % b;
+            a = b;
+            b = r;
+        }
+        return a;
+    }
+
+    // keeps the sources which connect to one destination
+    class fixedProbColumnFinder : public fixedProbSink
+    {
+    public:
+        fixedProbColumnFinder(int dst, QVector <int> &srcs) : dst(dst), srcs(srcs) {}
+        bool addConnections(const connArrays &block) {
+            for (int i = 0; i < block.dst.size(); ++i) {
+                if (block.dst[i] == dst) {
+                    srcs.push_back(block.src[i]);
+                }
+            }
+            return true;
+        }
+    private:
+        int dst;
+        QVector <int> &srcs;
+    };
+}
+
+/*!
+ * Draw the connections of a fixed probability connection from a vertex
+ * buffer filled as they are generated, so no list of them is kept. The
+ * buffer is rebuilt only when the probability, seed, locations, offsets or
+ * number of connections to draw change, and the connections of the selected
+ * neuron only when the selection changes as well.
+ */
+void glConnectionWidget::drawFixedProbLines(int targNum, fixedProb_connection * fpConn, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset, float lineScaleFactor)
+{
+    const QVector <loc> &srcLocs = src->layoutType->locations;
+    const QVector <loc> &dstLocs = dst->layoutType->locations;
+    if (srcLocs.size() == 0 || dstLocs.size() == 0) {
+        return;
+    }
+
+    // Only render a subsample of the black connections lines, as set in the
+    // settings: whole rows are skipped so that only the sample is generated,
+    // then the rows kept are thinned if there are too few sources for that
+    int maxConnections = settingsCache::glMaxConnections();
+    double expected = (double) fpConn->p * srcLocs.size() * dstLocs.size();
+    int rowStride = 1;
+    int inc = 1;
+    if (maxConnections > 0 && expected > maxConnections) {
+        rowStride = (int) qMin((double) srcLocs.size(), expected/maxConnections);
+        expected = (double) fpConn->p * ((srcLocs.size()+rowStride-1)/rowStride) * dstLocs.size();
+        if (expected > maxConnections) {
+            inc = (int) (expected/maxConnections);
+        }
+    }
+
+    connectionLineCache &cache = lineCaches[selectedConns[targNum].data()];
+    if (cache.lines == NULL) {
+        cache.lines = new glConnectionLines;
+        cache.dirty = true;
+    }
+
+    if (cache.dirty || cache.type != FixedProb || cache.prob != fpConn->p || cache.seed != fpConn->seed
+        || cache.srcLocs != srcLocs.constData() || cache.numSrc != srcLocs.size()
+        || cache.dstLocs != dstLocs.constData() || cache.numDst != dstLocs.size()
+        || cache.srcOffset.x != srcOffset.x || cache.srcOffset.y != srcOffset.y || cache.srcOffset.z != srcOffset.z
+        || cache.dstOffset.x != dstOffset.x || cache.dstOffset.y != dstOffset.y || cache.dstOffset.z != dstOffset.z
+        || cache.rowStride != rowStride || cache.inc != inc) {
+
+        QVector <GLfloat> verts;
+        verts.reserve((int) (expected/inc + 1)*9);
+        fixedProbLineBuilder builder(srcLocs, dstLocs, srcOffset, dstOffset, inc, verts);
+        fpConn->generate(srcLocs.size(), dstLocs.size(), builder, rowStride);
+
+        cache.lines->setVertices(verts);
+        cache.dirty = false;
+        cache.type = FixedProb;
+        cache.connData = NULL;
+        cache.numConns = 0;
+        cache.prob = fpConn->p;
+        cache.seed = fpConn->seed;
+        cache.srcLocs = srcLocs.constData();
+        cache.numSrc = srcLocs.size();
+        cache.dstLocs = dstLocs.constData();
+        cache.numDst = dstLocs.size();
+        cache.srcOffset = srcOffset;
+        cache.dstOffset = dstOffset;
+        cache.srcVisualised = src->isVisualised;
+        cache.dstVisualised = dst->isVisualised;
+        cache.rowStride = rowStride;
+        cache.inc = inc;
+        cache.selIndex = -1;
+    }
+
+    glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
+    cache.lines->draw(GL_TRIANGLES);
+
+    // the connections of the selected neuron: a row is generated directly,
+    // a column needs the sources found
+    if (cache.selIndex != selectedIndex || cache.selType != selectedType) {
+        cache.selLines.clear();
+        if (selectedType == 1 && selectedIndex >= 0 && selectedIndex < srcLocs.size()) {
+            QVector <qint32> row;
+            fpConn->generateRow(selectedIndex, dstLocs.size(), row);
+            for (int i = 0; i < row.size(); ++i) {
+                cache.selLines.push_back(srcLocs[selectedIndex]);
+                cache.selLines.push_back(dstLocs[row[i]]);
+            }
+        } else if (selectedType == 2 && selectedIndex >= 0 && selectedIndex < dstLocs.size()) {
+            QVector <int> srcs;
+            fixedProbColumnFinder finder(selectedIndex, srcs);
+            fpConn->generate(srcLocs.size(), dstLocs.size(), finder);
+            for (int i = 0; i < srcs.size(); ++i) {
+                cache.selLines.push_back(srcLocs[srcs[i]]);
+                cache.selLines.push_back(dstLocs[selectedIndex]);
+            }
+        }
+        cache.selIndex = selectedIndex;
+        cache.selType = selectedType;
+    }
+
+    // redraw selected (over the top of everything else so no depth test):
+    glDisable(GL_DEPTH_TEST);
+    glLineWidth(1.5f*lineScaleFactor);
+    glColor4f(0.0f, 0.0f, 1.0f, 0.8f);
+    glBegin(GL_LINES);
+    for (int i = 0; i < cache.selLines.size(); i += 2) {
+        glVertex3f(cache.selLines[i].x+srcOffset.x, cache.selLines[i].y+srcOffset.y, cache.selLines[i].z+srcOffset.z);
+        glVertex3f(cache.selLines[i+1].x+dstOffset.x, cache.selLines[i+1].y+dstOffset.y, cache.selLines[i+1].z+dstOffset.z);
+    }
+    glEnd();
+}
+
+/*!
+ * Draw the connections of an all to all connection from a vertex buffer. If
+ * there are more pairs than the number of connections to draw, an evenly
+ * spaced sample of them is taken, so the cost is that of the sample and not
+ * of every pair. The buffer is rebuilt only when the locations, offsets or
+ * number of connections to draw change.
+ */
+void glConnectionWidget::drawAllToAllLines(int targNum, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset, float lineScaleFactor)
+{
+    const QVector <loc> &srcLocs = src->layoutType->locations;
+    const QVector <loc> &dstLocs = dst->layoutType->locations;
+    if (srcLocs.size() == 0 && dstLocs.size() == 0) {
+        return;
+    }
+
+    // a population without locations is drawn as a single point
+    qint64 numSrc = qMax(1, srcLocs.size());
+    qint64 numDst = qMax(1, dstLocs.size());
+    qint64 total = numSrc*numDst;
+
+    // Only render a subsample of the connections lines, as set in the settings.
+    // The stride through the pairs shares no factor with the number of
+    // destinations, so the sample does not keep to the same few columns
+    int maxConnections = settingsCache::glMaxConnections();
+    qint64 inc = 1;
+    if (maxConnections > 0 && total > maxConnections) {
+        inc = (total + maxConnections - 1)/maxConnections;
+        while (numDst > 1 && greatestCommonDivisor(inc, numDst) != 1) {
+            ++inc;
+        }
+    }
+
+    connectionLineCache &cache = lineCaches[selectedConns[targNum].data()];
+    if (cache.lines == NULL) {
+        cache.lines = new glConnectionLines;
+        cache.dirty = true;
+    }
+
+    if (cache.dirty || cache.type != AlltoAll
+        || cache.srcLocs != srcLocs.constData() || cache.numSrc != srcLocs.size()
+        || cache.dstLocs != dstLocs.constData() || cache.numDst != dstLocs.size()
+        || cache.srcOffset.x != srcOffset.x || cache.srcOffset.y != srcOffset.y || cache.srcOffset.z != srcOffset.z
+        || cache.dstOffset.x != dstOffset.x || cache.dstOffset.y != dstOffset.y || cache.dstOffset.z != dstOffset.z
+        || cache.inc != inc) {
+
+        QVector <GLfloat> verts;
+        verts.reserve((int) (total/inc + 1)*6);
+        loc origin = {0, 0, 0};
+        for (qint64 k = 0; k < total; k += inc) {
+            const loc &a = srcLocs.size() > 0 ? srcLocs[(int) (k/numDst)] : origin;
+            const loc &b = dstLocs.size() > 0 ? dstLocs[(int) (k%numDst)] : origin;
+            verts.push_back(a.x+srcOffset.x); verts.push_back(a.y+srcOffset.y); verts.push_back(a.z+srcOffset.z);
+            verts.push_back(b.x+dstOffset.x); verts.push_back(b.y+dstOffset.y); verts.push_back(b.z+dstOffset.z);
+        }
+
+        cache.lines->setVertices(verts);
+        cache.dirty = false;
+        cache.type = AlltoAll;
+        cache.connData = NULL;
+        cache.numConns = 0;
+        cache.prob = -1;
+        cache.srcLocs = srcLocs.constData();
+        cache.numSrc = srcLocs.size();
+        cache.dstLocs = dstLocs.constData();
+        cache.numDst = dstLocs.size();
+        cache.srcOffset = srcOffset;
+        cache.dstOffset = dstOffset;
+        cache.srcVisualised = src->isVisualised;
+        cache.dstVisualised = dst->isVisualised;
+        cache.inc = (int) inc;
+    }
+
+    glLineWidth(1.5f*lineScaleFactor);
+    glColor4f(0.0f, 0.0f, 1.0f, 0.2f);
+    cache.lines->draw(GL_LINES);
 }
 
 void glConnectionWidget::initializeGL()
 {
     glEnable(GL_MULTISAMPLE);
+
+    // retained mode neurons where the context supports them
+    if (neuronRenderer == NULL) {
+        neuronRenderer = new glNeuronRenderer;
+        if (!neuronRenderer->initialise(this->context())) {
+            qDebug() << "Instanced neuron drawing not available, using immediate mode";
+        }
+    }
 }
 
 void glConnectionWidget::toggleOrthoView(bool toggle)
@@ -85,9 +572,26 @@ void glConnectionWidget::clear()
 {
     selectedPops.clear();
     popColours.clear();
+    for (int i = 0; i < popLogs.size(); ++i) {
+        logRegistry::release(popLogs[i]);
+    }
     popLogs.clear();
     selectedConns.clear();
     connections.clear();
+    connectionKeys.clear();
+    logPrefetch->setPosition(popLogs, 0);
+    this->invalidateConnectionLines();
+    generationErrors.clear();
+    pickGrids.clear();
+    octrees.clear();
+    layoutJobs.clear();
+    this->resetSelection();
+}
+
+void glConnectionWidget::resetSelection()
+{
+    selectedObject.clear();
+    selection.clear();
     selectedIndex = 0;
     selectedType = 1;
     model = (QAbstractTableModel *)0;
@@ -115,17 +619,109 @@ void glConnectionWidget::addLogs(QVector < logData * > * logs)
                 // check each log in turn
                 for (int k = 0; k < logs->size(); ++k) {
                     if ((*logs)[k]->logName == possibleLogName) {
-                        this->popLogs[i] = (*logs)[k];
+                        this->setPopLog(i, (*logs)[k]);
+                        // find the range now rather than on the first frame of playback
+                        this->popLogs[i]->getMax();
+                        this->popLogs[i]->getMin();
                     }
                 }
             }
         }
+
+        // without an analog log, the spikes of an event send port give the
+        // firing rate of each neuron, counted when the log was indexed
+        for (int j = 0; j < pop->neuronType->component->EventPortList.size() && this->popLogs[i] == NULL; ++j) {
+
+            EventPort * port = pop->neuronType->component->EventPortList[j];
+            if (port->mode == EventSendPort) {
+
+                QString possibleLogName = pop->name + "_" + port->name + "_log.bin";
+                possibleLogName.replace(" ", "_");
+
+                for (int k = 0; k < logs->size(); ++k) {
+                    if ((*logs)[k]->logName == possibleLogName && (*logs)[k]->dataClass == EVENTDATA) {
+                        this->setPopLog(i, (*logs)[k]);
+                        this->setFiringRateColours(i);
+                    }
+                }
+            }
+        }
+    }
+
+    logPrefetch->setPosition(popLogs, currentLogTime);
+}
+
+void glConnectionWidget::setPopLog(int index, logData * log)
+{
+    if (popLogs[index] == log) {
+        return;
+    }
+    logRegistry::retain(log);
+    logRegistry::release(popLogs[index]);
+    popLogs[index] = log;
+}
+
+void glConnectionWidget::setFiringRateColours(int index)
+{
+    QVector < double > neurons;
+    QVector < double > rates;
+    if (!popLogs[index]->getFiringRates(neurons, rates)) {
+        return;
+    }
+
+    int numNeurons = selectedPops[index]->numNeurons;
+    popColours[index].resize(numNeurons);
+    popColours[index].fill(QColor(0,0,0,255));
+
+    double maxRate = 0;
+    for (int j = 0; j < rates.size(); ++j) {
+        maxRate = qMax(maxRate, rates[j]);
+    }
+    if (maxRate == 0) {
+        return;
+    }
+    double scale = (LOG_COLOUR_LUT_SIZE-1)/maxRate;
+
+    for (int j = 0; j < neurons.size(); ++j) {
+        int n = (int) neurons[j];
+        if (n >= 0 && n < numNeurons) {
+            int entry = (int) (rates[j]*scale);
+            popColours[index][n] = logColourLUT[entry > LOG_COLOUR_LUT_SIZE-1 ? LOG_COLOUR_LUT_SIZE-1 : entry];
+        }
     }
 }
 
 void glConnectionWidget::updateLogDataTime(int index)
 {
     newLogTime = index;
+    logPrefetch->setPosition(popLogs, index);
+
+    // however often the position moves it is drawn once a frame
+    if (newLogTime != currentLogTime) {
+        animationScheduler::requestFrames(this);
+    }
+}
+
+bool glConnectionWidget::animateFrame()
+{
+    // a hidden view catches up when it is shown again
+    if (this->isVisible()) {
+        this->updateLogData();
+        // a live model keeps sending until it is stopped
+        if (live) {
+            this->updateLiveActivity();
+            return true;
+        }
+    }
+    return false;
+}
+
+void glConnectionWidget::showEvent(QShowEvent * event)
+{
+    if (newLogTime != currentLogTime || live) {
+        animationScheduler::requestFrames(this);
+    }
+    QGLWidget::showEvent(event);
 }
 
 void glConnectionWidget::updateLogData()
@@ -142,8 +738,14 @@ void glConnectionWidget::updateLogData()
         if (popLogs[i] == NULL)
             continue;
 
+        // an event log has no row of values; its rates may have grown
+        if (popLogs[i]->dataClass == EVENTDATA) {
+            this->setFiringRateColours(i);
+            continue;
+        }
+
         // get a row
-        QVector < double > logValues = popLogs[i]->getRow(currentLogTime);
+        QVector < double > logValues = logPrefetch->getRow(popLogs[i], currentLogTime);
 
         // data not usable
         if (logValues.size() == 0)
@@ -156,18 +758,23 @@ void glConnectionWidget::updateLogData()
         popColours[i].resize(selectedPops[i]->numNeurons);
         popColours[i].fill(col);
 
-        // remap data
+        // the range is cached by the log, so fetch it once per row
+        double logMin = popLogs[i]->getMin();
+        double logRange = popLogs[i]->getMax() - logMin;
+        if (logRange == 0) {
+            continue;
+        }
+        double scale = (LOG_COLOUR_LUT_SIZE-1)/logRange;
+
+        // remap data through the colour table
+        const double * values = logValues.constData();
+        const QColor * lut = logColourLUT.constData();
+        QColor * colours = popColours[i].data();
         for (int j = 0; j < logValues.size(); ++j) {
-            if (logValues[j] < Q_INFINITY && (popLogs[i]->getMax()-popLogs[i]->getMin()) != 0) {
-                int val = ((logValues[j]-popLogs[i]->getMin())*255.0)/(popLogs[i]->getMax()-popLogs[i]->getMin());
-                val *= 3;
-                // complete the remap in just 4 ternarys
-                int val3 = val > 511 ? val-512 : 0;
-                int val2 = val3 > 0 ? 511 : val;
-                val2 = val2 > 255 ? val2 - 256 : 0;
-                int val1 = val < 255 ? val : 255;
-
-                popColours[i][j] = QColor(val1,val2, val3, 255);
+            if (values[j] < Q_INFINITY) {
+                int entry = (int) ((values[j]-logMin)*scale);
+                entry = entry < 0 ? 0 : (entry > LOG_COLOUR_LUT_SIZE-1 ? LOG_COLOUR_LUT_SIZE-1 : entry);
+                colours[j] = lut[entry];
             }
         }
     }
@@ -176,6 +783,138 @@ void glConnectionWidget::updateLogData()
     this->repaint();
 }
 
+bool glConnectionWidget::startLiveActivity(QString &error)
+{
+    this->stopLiveActivity();
+
+    experiment * expt = (experiment *) 0;
+    for (int i = 0; i < data->experiments.size(); ++i) {
+        if (data->experiments[i]->selected) {
+            expt = data->experiments[i];
+        }
+    }
+    if (expt == (experiment *) 0) {
+        error = "No experiment is selected.";
+        return false;
+    }
+
+    liveActivityReceiver * receiver = new liveActivityReceiver;
+    livePops.clear();
+    liveNeurons.clear();
+    for (int i = 0; i < expt->outs.size(); ++i) {
+        exptOutput * out = expt->outs[i];
+        if (!out->isExternal || !out->portIsAnalog || out->edit || out->source.isNull()
+            || out->source->component->type != "neuron_body") {
+            continue;
+        }
+        QSharedPointer <population> pop = qSharedPointerDynamicCast <population> (out->source->owner);
+        if (pop.isNull() || !selectedPops.contains(pop)) {
+            continue;
+        }
+
+        QVector <int> neurons = out->indices.toVector();
+        receiver->addStream(out->name, out->externalOutput.port, neurons.isEmpty() ? pop->numNeurons : neurons.size());
+        livePops.push_back(pop);
+        liveNeurons.push_back(neurons);
+    }
+
+    if (receiver->numStreams() == 0) {
+        delete receiver;
+        error = "The experiment '" + expt->name + "' has no external analog outputs from the populations shown.";
+        return false;
+    }
+
+    live = receiver;
+    live->moveToThread(&liveThread);
+    liveThread.start();
+    QMetaObject::invokeMethod(live, "start", Qt::QueuedConnection);
+    animationScheduler::requestFrames(this);
+    this->repaint();
+    return true;
+}
+
+void glConnectionWidget::stopLiveActivity()
+{
+    if (!live) {
+        return;
+    }
+    QMetaObject::invokeMethod(live, "stop", Qt::BlockingQueuedConnection);
+    liveThread.quit();
+    liveThread.wait();
+    delete live;
+    live = (liveActivityReceiver *) 0;
+    livePops.clear();
+    liveNeurons.clear();
+    this->update();
+}
+
+void glConnectionWidget::updateLiveActivity()
+{
+    bool changed = false;
+    for (int s = 0; s < livePops.size(); ++s) {
+
+        // the populations shown may have changed since
+        int index = selectedPops.indexOf(livePops[s]);
+        if (index < 0) {
+            continue;
+        }
+
+        double logMin;
+        double logMax;
+        if (!live->takeFrame(s, liveFrame, logMin, logMax)) {
+            continue;
+        }
+
+        int numNeurons = selectedPops[index]->numNeurons;
+        if (popColours[index].size() != numNeurons) {
+            popColours[index].resize(numNeurons);
+            popColours[index].fill(QColor(0,0,0,255));
+        }
+        double logRange = logMax - logMin;
+        if (logRange == 0) {
+            continue;
+        }
+        double scale = (LOG_COLOUR_LUT_SIZE-1)/logRange;
+
+        // as updateLogData
+        const double * values = liveFrame.constData();
+        const int * neurons = liveNeurons[s].isEmpty() ? (const int *) 0 : liveNeurons[s].constData();
+        const QColor * lut = logColourLUT.constData();
+        QColor * colours = popColours[index].data();
+        for (int j = 0; j < liveFrame.size(); ++j) {
+            int n = neurons ? neurons[j] : j;
+            if (n < 0 || n >= numNeurons || !(values[j] < Q_INFINITY)) {
+                continue;
+            }
+            int entry = (int) ((values[j]-logMin)*scale);
+            entry = entry < 0 ? 0 : (entry > LOG_COLOUR_LUT_SIZE-1 ? LOG_COLOUR_LUT_SIZE-1 : entry);
+            colours[n] = lut[entry];
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        this->repaint();
+    }
+}
+
+void glConnectionWidget::drawLiveStatus(QPainter &painter)
+{
+    if (!live) {
+        return;
+    }
+
+    QStringList lines = live->status();
+    QPen oldPen = painter.pen();
+    painter.setPen(QColor(100,100,100));
+    int y = this->height() - 10 - 20*lines.size();
+    for (int i = 0; i < lines.size(); ++i) {
+        painter.drawText(QRect(10, y, this->width()-20, 20), Qt::AlignLeft, lines[i]);
+        y += 20;
+    }
+    painter.setPen(oldPen);
+}
+
 void glConnectionWidget::resizeGL(int, int)
 {
     // setup the view
@@ -225,15 +964,13 @@ void glConnectionWidget::allowRepaint()
 
 void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
 {
+    PROFILE_SCOPE("glConnectionWidget::paintEvent");
     // avoid repainting too fast
     if (this->repaintAllowed == false) {
         return;
     } else {
         this->repaintAllowed = false;
-        QTimer * timer = new QTimer(this);
-        timer->setSingleShot(true);
-        connect(timer, SIGNAL(timeout()), this, SLOT(allowRepaint()));
-        timer->start(5);
+        repaintTimer.start();
     }
 
     // don't try and repaint a hidden widget!
@@ -284,32 +1021,23 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
     // add some neurons!
 
     // fetch quality setting
-    QSettings settings;
-    int quality = settings.value("glOptions/detail", 5).toInt();
+    int quality = settingsCache::glDetail();
 
     glPushMatrix();
     glTranslatef(0,0,-5.0);
 
+    // keep the transform the neurons are drawn with for picking
+    if (!imageSaveMode) {
+        glGetDoublev(GL_MODELVIEW_MATRIX, pickModelview);
+        glGetDoublev(GL_PROJECTION_MATRIX, pickProjection);
+        glGetIntegerv(GL_VIEWPORT, pickViewport);
+        pickValid = true;
+    }
+
     // if previewing a layout then override normal drawing
     if (locations.size() > 0) {
-        for (int i = 0; i < locations[0].size(); ++i) {
-            glPushMatrix();
-
-            glTranslatef(locations[0][i].x, locations[0][i].y, locations[0][i].z);
-
-            // draw with a level of detail dependant on the number on neurons we must draw
-            int LoD = round(250.0f/float(locations[0].size())*pow(2,float(quality)));
-            // put some bounds on
-            if (LoD < 4) {
-                LoD = 4;
-            }
-            if (LoD > 32) {
-                LoD = 32;
-            }
-            this->drawNeuron(0.5, LoD, LoD, QColor(100,100,100,255));
-
-            glPopMatrix();
-        }
+        loc noOffset = {0,0,0};
+        this->drawNeurons(previewOctree, locations[0], noOffset, QVector <QColor> (), QColor(100,100,100,255));
 
         glPopMatrix();
         // need this as no painter!
@@ -317,58 +1045,59 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
         return;
     }
 
-    // draw with a level of detail dependant on the number on neurons we must draw
-    // sum neurons across all pops we'll draw
+    // the spheres at the ends of the connections are drawn with a level of
+    // detail dependant on the number on neurons we must draw, so sum
+    // neurons across all pops we'll draw
     int totalNeurons = 0;
     for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
         totalNeurons += selectedPops[locNum]->layoutType->locations.size();
     }
     int LoD = round(250.0f/float(totalNeurons)*pow(2,float(quality)));
+    if (LoD < 4) {
+        LoD = 4;
+    }
+    if (LoD > 32) {
+        LoD = 32;
+    }
+    // exported images get detail in proportion to how much larger they are
+    // than the view, rather than the finest mesh for every neuron
+    if (imageSaveMode) {
+        float viewSize = float(qMax(this->width(), this->height())*RETINA_SUPPORT);
+        float scaleUp = float(qMax(imageSaveWidth, imageSaveHeight)) / qMax(viewSize, 1.0f);
+        LoD = qBound(4, int(LoD * qMax(scaleUp, 1.0f)), 64);
+    }
 
     // normal drawing
     for (int locNum = 0; locNum < selectedPops.size(); ++locNum) {
         QSharedPointer <population> currPop = selectedPops[locNum];
-        for (int i = 0; i < currPop->layoutType->locations.size(); ++i) {
-            glPushMatrix();
 
-            glTranslatef(currPop->layoutType->locations[i].x, currPop->layoutType->locations[i].y, currPop->layoutType->locations[i].z);
-
-            // if currently selected
+        if (layoutJobs.contains(currPop.data())) {
+            loc offset;
             if (currPop == selectedObject) {
-                // move to pop location denoted by the spinboxes for x, y, z
-                glTranslatef(loc3Offset.x, loc3Offset.y,loc3Offset.z);
-            } else {
-                glTranslatef(currPop->loc3.x, currPop->loc3.y,currPop->loc3.z);
-            }
-
-            // draw with a level of detail dependant on the number on neurons we must draw
-            // put some bounds on
-            if (LoD < 4) {
-                LoD = 4;
-            }
-            if (LoD > 32) {
-                LoD = 32;
-            }
-            if (imageSaveMode) {
-                LoD = 64;
-            }
-
-            // check we haven't broken stuff
-            if (popColours[locNum].size() > currPop->layoutType->locations.size()) {
-                popColours[locNum].clear();
-                popLogs[locNum] = NULL;
-            }
-
-            if (popColours[locNum].size() > 0) {
-                this->drawNeuron(0.5, LoD, LoD, popColours[locNum][i]);
+                offset.x = loc3Offset.x; offset.y = loc3Offset.y; offset.z = loc3Offset.z;
             } else {
-                this->drawNeuron(0.5, LoD, LoD, QColor(100 + 0.5*currPop->colour.red(),
-                                                       100 + 0.5*currPop->colour.green(),
-                                                       100 + 0.5*currPop->colour.blue(),255));
+                offset.x = currPop->loc3.x; offset.y = currPop->loc3.y; offset.z = currPop->loc3.z;
             }
+            this->drawLayoutPlaceholder(currPop, offset);
+            continue;
+        }
 
-            glPopMatrix();
+        // check we haven't broken stuff
+        if (popColours[locNum].size() > currPop->layoutType->locations.size()) {
+            popColours[locNum].clear();
+            setPopLog(locNum, NULL);
+        }
+        loc offset;
+        if (currPop == selectedObject) {
+            // move to pop location denoted by the spinboxes for x, y, z
+            offset.x = loc3Offset.x; offset.y = loc3Offset.y; offset.z = loc3Offset.z;
+        } else {
+            offset.x = currPop->loc3.x; offset.y = currPop->loc3.y; offset.z = currPop->loc3.z;
         }
+        this->drawNeurons(octrees[currPop.data()], currPop->layoutType->locations, offset, popColours[locNum],
+                          QColor(100 + 0.5*currPop->colour.red(),
+                                 100 + 0.5*currPop->colour.green(),
+                                 100 + 0.5*currPop->colour.blue(),255));
     }
 
     // draw synapses
@@ -443,11 +1172,15 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
             if (csv_conn->generator) {
                 pythonscript_connection * pyConn = dynamic_cast<pythonscript_connection *> (csv_conn->generator);
                 CHECK_CAST(pyConn)
-                if (pyConn->changed()) {
-                    pyConn->regenerateConnections();
-                    // fetch connections back here:
-                    connections[targNum].clear();
-                    csv_conn->getAllData(connections[targNum]);
+                // the script runs on the worker thread, and nothing is drawn
+                // for this projection until connectionsGenerated()
+                if (pyConn->changed() && !generatingConns.contains(pyConn) && !generationErrors.contains(pyConn)) {
+                    this->startConnectionGeneration(pyConn);
+                }
+                if (generatingConns.contains(pyConn)) {
+                    glEnable(GL_DEPTH_TEST);
+                    glEnable(GL_LIGHTING);
+                    continue;
                 }
             }
         }
@@ -460,58 +1193,16 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
                 continue;
             }
 
-            connGenerationMutex->lock();
-
-            // Only render a few thousand of the black connections lines max
-            int inc = 1;
-            int connectionsToSkip = 1000; // FIXME: Make this a UI parameter
-            if (connections[targNum].size() > connectionsToSkip) {
-                // Compute inc based on number of connections:
-                inc = (int) connections[targNum].size()/connectionsToSkip;
+            // a worker is replacing connections
+            if (!connGenerationMutex->tryLock()) {
+                glEnable(GL_DEPTH_TEST);
+                glEnable(GL_LIGHTING);
+                continue;
             }
-            for (int i = 0; i < connections[targNum].size(); i+=inc) {
-
-                if (connections[targNum][i].src < src->layoutType->locations.size()
-                    && connections[targNum][i].dst < dst->layoutType->locations.size()) {
-
-                    glLineWidth(2.0*lineScaleFactor);
-                    glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
-
-                    // draw in
-                    glBegin(GL_TRIANGLES);
-                    if (src->isVisualised && dst->isVisualised) {
-                        glVertex3f(src->layoutType->locations[connections[targNum][i].src].x+srcX,
-                                   src->layoutType->locations[connections[targNum][i].src].y+srcY,
-                                   src->layoutType->locations[connections[targNum][i].src].z+srcZ);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y+dstY,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z+dstZ);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x+dstX,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y+dstY,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z+dstZ+0.05);
-                    }
-                    if (src->isVisualised && !dst->isVisualised) {
-                        glVertex3f(src->layoutType->locations[connections[targNum][i].src].x,
-                                   src->layoutType->locations[connections[targNum][i].src].y,
-                                   src->layoutType->locations[connections[targNum][i].src].z);
-                        glVertex3f(dstX, dstY, dstZ);
-                        glVertex3f(dstX, dstY, dstZ+0.01);
-                    }
-                    if (!src->isVisualised && dst->isVisualised) {
-                        glVertex3f(src->loc3.x, src->loc3.y, src->loc3.z);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z);
-                        glVertex3f(dst->layoutType->locations[connections[targNum][i].dst].x,
-                                   dst->layoutType->locations[connections[targNum][i].dst].y,
-                                   dst->layoutType->locations[connections[targNum][i].dst].z+0.01);
-                    }
-                    glEnd();
 
-                } else {
-                    // ERR - CONNECTION INDEX OUT OF RANGE
-                }
-            }
+            loc3f srcOffset = {srcX, srcY, srcZ};
+            loc3f dstOffset = {dstX, dstY, dstZ};
+            this->drawConnectionLines(targNum, src, dst, srcOffset, dstOffset);
 
             // draw selected connections on top
             glDisable(GL_DEPTH_TEST);
@@ -528,46 +1219,51 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
                     theweights = wu->getWeightsParameter();
                 }
 
-                // If we have weights, then we have to find the max and min weights for the connection
-                double maxweight = std::numeric_limits<double>::min();
-                double minweight = std::numeric_limits<double>::max();
-                double m = 0;
-                double c = 0;
+                // the connections of the selected neuron, from the adjacency index
+                const connectionAdjacency &adjacency = this->getAdjacency(targNum);
+                int numNrnConns = 0;
+                const int * nrnConns = NULL;
+                if (selectedType == 1) {
+                    nrnConns = adjacency.outgoing(selectedIndex, numNrnConns);
+                } else if (selectedType == 2) {
+                    nrnConns = adjacency.incoming(selectedIndex, numNrnConns);
+                }
+
+                // the weights scaled across the projection, computed once
+                const weightColourCache * weightColour = (weightColourCache *)0;
                 if (theweights != (ParameterInstance*)0) {
-                    //DBG() << "Redetermining minweight/maxweight...";
-#pragma omp parallel for
-                    for (int i = 0; i < connections[targNum].size(); ++i) {
-
-                        if (connections[targNum][i].src < src->layoutType->locations.size()
-                            && connections[targNum][i].dst < dst->layoutType->locations.size()) {
-
-                            if (((int) connections[targNum][i].src == selectedIndex && selectedType == 1)
-                                || ((int) connections[targNum][i].dst == selectedIndex && selectedType == 2)) {
-
-                                if (theweights != (ParameterInstance*)0 && i < theweights->value.size()) {
-
-                                    double myweight = theweights->value[i];
-                                    if (myweight > maxweight) {
-                                        //DBG() << "Setting maxweight to " << myweight;
-                                        maxweight = myweight;
-                                    }
-                                    if (myweight < minweight) {
-                                        //DBG() << "Setting minweight to " << myweight;
-                                        minweight = myweight;
-                                    }
-                                }
-                            }
-                        }
+                    weightColour = &this->getWeightColours(targNum, theweights);
+                }
+
+                // only the connections that can be highlighted need be visited:
+                // selected rows, those sharing a source or destination with a
+                // selected row, and those of the selected neuron
+                QVector <int> highlighted;
+                for (int j = 0; j < (int) selection.count(); ++j) {
+                    int row = selection[j].row();
+                    if (row < 0 || row >= connections[targNum].size()) {
+                        continue;
+                    }
+                    highlighted.push_back(row);
+                    int count = 0;
+                    const int * rowConns = NULL;
+                    if (selection[j].column() == 0) {
+                        rowConns = adjacency.outgoing(connections[targNum][row].src, count);
+                    } else if (selection[j].column() == 1) {
+                        rowConns = adjacency.incoming(connections[targNum][row].dst, count);
+                    }
+                    for (int n = 0; n < count; ++n) {
+                        highlighted.push_back(rowConns[n]);
                     }
-                    // Compute a linear scaling from minweight to maxweight
-                    double rise = 1.0;
-                    double run = maxweight - minweight;
-                    m = rise/run;
-                    c = 1.0 - m * maxweight;
-                    //DBG() << "minweight: " << minweight << " maxweight: " << maxweight << " m: " << m << " c: " << c;
                 }
+                for (int n = 0; n < numNrnConns; ++n) {
+                    highlighted.push_back(nrnConns[n]);
+                }
+                std::sort(highlighted.begin(), highlighted.end());
+                highlighted.erase(std::unique(highlighted.begin(), highlighted.end()), highlighted.end());
 
-                for (int i = 0; i < connections[targNum].size(); ++i) {
+                for (int h = 0; h < highlighted.size(); ++h) {
+                    int i = highlighted[h];
 
                     if (connections[targNum][i].src < src->layoutType->locations.size()
                         && connections[targNum][i].dst < dst->layoutType->locations.size()) {
@@ -601,14 +1297,8 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
                         if (((int) connections[targNum][i].src == selectedIndex && selectedType == 1)
                             || ((int) connections[targNum][i].dst == selectedIndex && selectedType == 2)) {
 
-                            if (theweights != (ParameterInstance*)0) {
-                                //DBG() << "i=" << i << " and theweights->value.size()=" << theweights->value.size();
-                                if (i < theweights->value.size()) {
-                                    double myweight = theweights->value[i];
-                                    //DBG() << "Weight for this connection line is " << myweight << " m is " << m << " and c is " << c;
-                                    normweight = static_cast<float>(m * myweight + c);
-                                    //DBG() << "normalised weight is " << normweight;
-                                }
+                            if (weightColour != (weightColourCache *)0) {
+                                normweight = weightColour->normalised[i];
                             }
                             glLineWidth(1.5f*lineScaleFactor);
 
@@ -731,47 +1421,9 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
 
         if (conn->type == AlltoAll) {
 
-            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) {
-
-                for (int i = 0; i < src->layoutType->locations.size(); ++i) {
-                    for (int j = 0; j <  dst->layoutType->locations.size(); ++j) {
-
-                        glLineWidth(1.5f*lineScaleFactor);
-                        glColor4f(0.0f, 0.0f, 1.0f, 0.2f);
-                        // draw in
-                        glBegin(GL_LINES);
-                        glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                        glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                        glEnd();
-                    }
-                }
-            }
-            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
-
-                for (int i = 0; i < src->layoutType->locations.size(); ++i) {
-
-                    glLineWidth(1.5f*lineScaleFactor);
-                    glColor4f(0.0f, 0.0f, 1.0f, 0.2f);
-                    // draw in
-                    glBegin(GL_LINES);
-                    glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                    glVertex3f(dstX, dstY, dstZ);
-                    glEnd();
-                }
-            }
-            if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
-
-                 for (int j = 0; j <  dst->layoutType->locations.size(); ++j) {
-
-                    glLineWidth(1.5f*lineScaleFactor);
-                    glColor4f(0.0f, 0.0f, 1.0f, 0.2f);
-                    // draw in
-                    glBegin(GL_LINES);
-                    glVertex3f(srcX, srcY, srcZ);
-                    glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                    glEnd();
-                }
-            }
+            loc3f srcOffset = {srcX, srcY, srcZ};
+            loc3f dstOffset = {dstX, dstY, dstZ};
+            this->drawAllToAllLines(targNum, src, dst, srcOffset, dstOffset, lineScaleFactor);
         }
 
         if (conn->type == FixedProb) {
@@ -779,91 +1431,43 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
             fixedProb_connection * fpConn = dynamic_cast <fixedProb_connection *> (conn);
             CHECK_CAST(fpConn)
 
-            random.setSeed(fpConn->seed);
-
             prob = fpConn->p;
 
-            // generate a list of projections to highlight
-            QVector < loc > redrawLocs;
-
-            for (int i = 0; i < src->layoutType->locations.size(); ++i) {
-                for (int j = 0; j <  dst->layoutType->locations.size(); ++j) {
-                    if (random.value() < this->prob) {
-                        glLineWidth(1.0f*lineScaleFactor);
-                        glColor4f(0.0f, 0.0f, 0.0f, 0.1f);
-
-                        if (((int) i == selectedIndex && selectedType == 1) \
-                                || ((int) j == selectedIndex && selectedType == 2))
-                        {
-                            // store for redraw of selected connections
-                            loc pstart;
-                            loc pend;
-
-                            if ((src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) \
-                                    || (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0)) {
-                                pstart.x = src->layoutType->locations[i].x+srcX;
-                                pstart.y = src->layoutType->locations[i].y+srcY;
-                                pstart.z = src->layoutType->locations[i].z+srcZ;
-                            }
-                            if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
-                                pstart.x = srcX;
-                                pstart.y = srcY;
-                                pstart.z = srcZ;
-                            }
-                            if ((src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) \
-                                    || (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0)) {
-                                pend.x = dst->layoutType->locations[j].x+dstX;
-                                pend.y = dst->layoutType->locations[j].y+dstY;
-                                pend.z = dst->layoutType->locations[j].z+dstZ;
-                            }
-                            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
-                                pend.x = dstX;
-                                pend.y = dstY;
-                                pend.z = dstZ;
-                            }
-                            redrawLocs.push_back(pstart);
-                            redrawLocs.push_back(pend);
-                        }
-                        else
-                        {
-                            // draw in
-                            glBegin(GL_LINES);
-                            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() > 0) {
-                                glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                                glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                            }
-                            if (src->layoutType->locations.size() > 0 && dst->layoutType->locations.size() == 0) {
-                                glVertex3f(src->layoutType->locations[i].x+srcX, src->layoutType->locations[i].y+srcY, src->layoutType->locations[i].z+srcZ);
-                                glVertex3f(dstX, dstY, dstZ);
-                            }
-                            if (src->layoutType->locations.size() == 0 && dst->layoutType->locations.size() > 0) {
-                                glVertex3f(srcX, srcY, srcZ);
-                                glVertex3f(dst->layoutType->locations[j].x+dstX, dst->layoutType->locations[j].y+dstY, dst->layoutType->locations[j].z+dstZ);
-                            }
-                            glEnd();
-                        }
-                    }
-                }
-            }
-            // redraw selected (over the top of everything else so no depth test):
-            glDisable(GL_DEPTH_TEST);
-
-            for (int i=0; i < redrawLocs.size(); i+=2) {
-
-                // redraw
-                glLineWidth(1.5f*lineScaleFactor);
-                glColor4f(0.0f, 0.0f, 1.0f, 0.8f);
-                glBegin(GL_LINES);
-                glVertex3f(redrawLocs[i].x, redrawLocs[i].y,redrawLocs[i].z);
-                glVertex3f(redrawLocs[i+1].x, redrawLocs[i+1].y,redrawLocs[i+1].z);
-                glEnd();
-            }
+            loc3f srcOffset = {srcX, srcY, srcZ};
+            loc3f dstOffset = {dstX, dstY, dstZ};
+            this->drawFixedProbLines(targNum, fpConn, src, dst, srcOffset, dstOffset, lineScaleFactor);
         }
 
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_LIGHTING);
     }
 
+    // free the buffers of connections no longer shown (the context is current here)
+    QMap <systemObject *, connectionLineCache>::iterator lineIt = lineCaches.begin();
+    while (lineIt != lineCaches.end()) {
+        bool shown = false;
+        for (int targNum = 0; targNum < this->selectedConns.size(); ++targNum) {
+            if (selectedConns[targNum].data() == lineIt.key()) {
+                shown = true;
+                break;
+            }
+        }
+        if (!shown) {
+            delete lineIt.value().lines;
+            lineIt = lineCaches.erase(lineIt);
+        } else {
+            ++lineIt;
+        }
+    }
+    QMap <systemObject *, weightColourCache>::iterator weightIt = weightColours.begin();
+    while (weightIt != weightColours.end()) {
+        if (lineCaches.contains(weightIt.key())) {
+            ++weightIt;
+        } else {
+            weightIt = weightColours.erase(weightIt);
+        }
+    }
+
     glDisable(GL_BLEND);
     glDisable(GL_POLYGON_SMOOTH);
     glDisable(GL_LINE_SMOOTH);
@@ -939,17 +1543,269 @@ void glConnectionWidget::paintEvent(QPaintEvent * /*event*/)
             }
         }
         painter.setPen(oldPen);
+        this->drawGenerationStatus(painter);
+        this->drawLiveStatus(painter);
+        this->drawProfilerOverlay(painter);
         painter.end();
     } else {
         // if the painter isn't there this doesn't get called!
         QPainter painter(this);
         painter.setRenderHint(QPainter::Antialiasing);
+        this->drawGenerationStatus(painter);
+        this->drawLiveStatus(painter);
+        this->drawProfilerOverlay(painter);
         painter.end();
     }
 
     glPopMatrix();
 }
 
+/*!
+ * Start running pyConn's script on the generation thread. The layouts are
+ * generated here, as the populations are shared with the GUI, and the worker
+ * is given copies of the locations.
+ */
+void glConnectionWidget::startConnectionGeneration(pythonscript_connection * pyConn)
+{
+    // a generate dialog may be running it already
+    if (pyConn->isGenerating()) {
+        return;
+    }
+    pyConn->refetchScript();
+    if (!pyConn->changed()) {
+        return;
+    }
+
+    QString errorLog;
+    pyConn->srcPop->layoutType->generateLayout(pyConn->srcPop->numNeurons, &pyConn->srcPop->layoutType->locations, errorLog);
+    if (errorLog.isEmpty()) {
+        pyConn->dstPop->layoutType->generateLayout(pyConn->dstPop->numNeurons, &pyConn->dstPop->layoutType->locations, errorLog);
+    }
+    if (!errorLog.isEmpty()) {
+        generationErrors[pyConn] = pyConn->scriptName + ": " + errorLog;
+        return;
+    }
+
+    connectionGenerationWorker * worker = new connectionGenerationWorker(pyConn, pyConn->srcPop->layoutType->locations, pyConn->dstPop->layoutType->locations);
+    worker->moveToThread(&generationThread);
+    connect(worker, SIGNAL(finished()), this, SLOT(connectionsGenerated()));
+
+    if (!generationThread.isRunning()) {
+        generationThread.start();
+    }
+    generatingConns.insert(pyConn, QPointer <pythonscript_connection> (pyConn));
+    QMetaObject::invokeMethod(worker, "generate", Qt::QueuedConnection);
+}
+
+void glConnectionWidget::connectionsGenerated()
+{
+    connectionGenerationWorker * worker = qobject_cast <connectionGenerationWorker *> (sender());
+    if (!worker) {
+        return;
+    }
+    worker->deleteLater();
+
+    // drop this connection, and any deleted while their scripts ran
+    pythonscript_connection * pyConn = worker->currConn.data();
+    QMap <pythonscript_connection *, QPointer <pythonscript_connection> >::iterator gen = generatingConns.begin();
+    while (gen != generatingConns.end()) {
+        if (gen.value().isNull() || gen.key() == pyConn) {
+            gen = generatingConns.erase(gen);
+        } else {
+            ++gen;
+        }
+    }
+    if (!pyConn) {
+        this->update();
+        return;
+    }
+
+    // the result is stored here, on the GUI thread, as the connection and
+    // its explicit list are used by it
+    pyConn->conns = &pyConn->connections;
+    if (!pyConn->applyGeneration(worker->job)) {
+        // superseded by a later run
+        this->update();
+        return;
+    }
+    QVector <conn> generated;
+    if (pyConn->connection_target) {
+        if (pyConn->errorLog.isEmpty() && pyConn->pythonErrors.isEmpty()) {
+            pyConn->connection_target->getAllData(generated);
+        }
+    } else {
+        generated = pyConn->connections;
+    }
+
+    if (!pyConn->errorLog.isEmpty()) {
+        generationErrors[pyConn] = pyConn->scriptName + ": " + pyConn->errorLog;
+    } else if (!pyConn->pythonErrors.isEmpty()) {
+        generationErrors[pyConn] = pyConn->scriptName + ": " + pyConn->pythonErrors;
+    } else if (pyConn->connection_target && generated.size() == 0) {
+        generationErrors[pyConn] = pyConn->scriptName + ": Error: no connections generated for Python Script Connection";
+    } else {
+        // move the weights across
+        ParameterInstance * par = pyConn->getPropPointer();
+        if (par && pyConn->hasWeight) {
+            par->currType = ExplicitList;
+            par->setDenseValues(pyConn->weights);
+        }
+
+        // hand the new connections to each projection generated by this script
+        for (int targNum = 0; targNum < selectedConns.size() && targNum < connections.size(); ++targNum) {
+            connection * conn;
+            if (selectedConns[targNum]->type == synapseObject) {
+                QSharedPointer <synapse> currTarg = qSharedPointerDynamicCast <synapse> (selectedConns[targNum]);
+                CHECK_CAST(currTarg)
+                conn = currTarg->connectionType;
+            } else {
+                QSharedPointer<genericInput> currIn = qSharedPointerDynamicCast<genericInput> (selectedConns[targNum]);
+                CHECK_CAST(currIn)
+                conn = currIn->conn;
+            }
+            if (conn->type == CSV) {
+                csv_connection * csv_conn = dynamic_cast<csv_connection *> (conn);
+                CHECK_CAST(csv_conn)
+                if (csv_conn->generator == pyConn) {
+                    connections[targNum] = generated;
+                }
+            }
+        }
+        this->invalidateConnectionLines();
+    }
+
+    this->update();
+}
+
+/*!
+ * List the scripts that are running or have failed over the view.
+ */
+void glConnectionWidget::drawGenerationStatus(QPainter &painter)
+{
+    if (generatingConns.isEmpty() && generationErrors.isEmpty()) {
+        return;
+    }
+
+    QPen oldPen = painter.pen();
+    int y = 10;
+
+    painter.setPen(QColor(100,100,100));
+    QMap <pythonscript_connection *, QPointer <pythonscript_connection> >::const_iterator it;
+    for (it = generatingConns.constBegin(); it != generatingConns.constEnd(); ++it) {
+        if (it.value().isNull()) {
+            continue;
+        }
+        QString text = "Generating connectivity: " + it.value()->scriptName + "...";
+        int progress = it.value()->generationProgress();
+        if (progress >= 0) {
+            text += " " + QString::number(progress) + "%";
+        }
+        painter.drawText(QRect(10, y, this->width()-20, 20), Qt::AlignLeft, text + " (Esc to cancel)");
+        y += 20;
+    }
+    // keep the progress current while the scripts run
+    if (!generatingConns.isEmpty()) {
+        QTimer::singleShot(250, this, SLOT(update()));
+    }
+
+    painter.setPen(QColor(200,0,0));
+    QMap <pythonscript_connection *, QString>::const_iterator err;
+    for (err = generationErrors.constBegin(); err != generationErrors.constEnd(); ++err) {
+        QRect bounds = painter.boundingRect(QRect(10, y, this->width()-20, this->height()-y), Qt::AlignLeft | Qt::TextWordWrap, err.value());
+        painter.drawText(bounds, Qt::AlignLeft | Qt::TextWordWrap, err.value());
+        y += bounds.height() + 5;
+    }
+
+    painter.setPen(oldPen);
+}
+
+/*!
+ * Summarise the recently profiled scopes in the bottom left of the view.
+ */
+void glConnectionWidget::drawProfilerOverlay(QPainter &painter)
+{
+    if (!profiler::overlayShown() || imageSaveMode) {
+        return;
+    }
+
+    QVector <profileSummary> summary = profiler::summarise(PROFILE_OVERLAY_WINDOW_MS);
+    QStringList lines;
+    lines << "Last " + QString::number(PROFILE_OVERLAY_WINDOW_MS / 1000) + " s: calls, total ms, longest ms";
+    for (int i = 0; i < summary.size() && i < 12; ++i) {
+        lines << QString("%1  %2  %3  %4").arg(summary[i].name)
+                                         .arg(summary[i].count)
+                                         .arg(summary[i].totalMs, 0, 'f', 1)
+                                         .arg(summary[i].maxMs, 0, 'f', 1);
+    }
+
+    QPen oldPen = painter.pen();
+    QFont oldFont = painter.font();
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPointSize(9);
+    painter.setFont(font);
+
+    QRect bounds = painter.boundingRect(QRect(0, 0, this->width(), this->height()), Qt::AlignLeft, lines.join("\n"));
+    bounds.moveBottomLeft(QPoint(10, this->height() - 10));
+    painter.fillRect(bounds.adjusted(-5, -5, 5, 5), QColor(255, 255, 255, 200));
+    painter.setPen(QColor(40, 40, 40));
+    painter.drawText(bounds, Qt::AlignLeft, lines.join("\n"));
+
+    painter.setFont(oldFont);
+    painter.setPen(oldPen);
+
+    // keep the figures current while nothing else redraws the view
+    if (!profilerTimer.isActive()) {
+        profilerTimer.start();
+    }
+}
+
+/*!
+ * Draw the neurons at locations, moved by offset, through tree (rebuilt
+ * first if the locations have changed): those outside the view are culled,
+ * those too small to make out are drawn as points, and the rest as spheres
+ * with the detail their size on screen needs. Instanced if the renderer is
+ * available, and otherwise in immediate mode.
+ */
+void glConnectionWidget::drawNeurons(neuronOctree &tree, const QVector <loc> &locations, loc offset,
+                                     const QVector <QColor> &colours, QColor defaultColour)
+{
+    PROFILE_SCOPE("glConnectionWidget::drawNeurons");
+    if (!tree.isBuiltFor(locations, 0.5)) {
+        tree.build(locations, 0.5);
+    }
+
+    GLdouble modelview[16];
+    GLdouble projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    neuronView view;
+    view.set(modelview, projection, viewport, settingsCache::glDetail());
+
+    neuronList.clear();
+    tree.collect(view, offset, neuronList);
+
+    if (neuronRenderer != NULL && neuronRenderer->isAvailable()) {
+        neuronRenderer->drawPopulation(locations, neuronList, offset, colours, defaultColour, 0.5);
+        return;
+    }
+
+    for (int level = 0; level < NEURON_LOD_LEVELS; ++level) {
+        int LoD = NEURON_MIN_LOD << level;
+        const QVector <int> &spheres = neuronList.spheres[level];
+        for (int i = 0; i < spheres.size(); ++i) {
+            int n = spheres[i];
+            glPushMatrix();
+            glTranslatef(locations[n].x + offset.x, locations[n].y + offset.y, locations[n].z + offset.z);
+            this->drawNeuron(0.5, LoD, LoD, n < colours.size() ? colours[n] : defaultColour);
+            glPopMatrix();
+        }
+    }
+    glNeuronRenderer::drawPoints(locations, neuronList, offset, colours, defaultColour);
+}
+
 void glConnectionWidget::drawNeuron(GLfloat r, int rings, int segments, QColor col)
 {
     // draw a sphere to represent a neuron
@@ -987,16 +1843,24 @@ void glConnectionWidget::setupView()
     if (imageSaveMode) {
         width = imageSaveWidth;
         height = imageSaveHeight;
+        glViewport(0, 0, imageTile.width(), imageTile.height());
     } else {
         width = this->width()*RETINA_SUPPORT;
         height = this->height()*RETINA_SUPPORT;
+        glViewport(0, 0, width, height);
     }
 
-    glViewport(0, 0, width, height);
-
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
+    // when exporting in tiles, stretch the projection so that only this
+    // tile of the full image falls in the viewport
+    if (imageSaveMode && imageTile != QRect(0, 0, width, height)) {
+        glTranslatef(float(width - 2*imageTile.x() - imageTile.width())/float(imageTile.width()),
+                     float(height - 2*imageTile.y() - imageTile.height())/float(imageTile.height()), 0);
+        glScalef(float(width)/float(imageTile.width()), float(height)/float(imageTile.height()), 1);
+    }
+
     // move view
     if (!orthoView)
         gluPerspective(60.0,((GLfloat)width)/((GLfloat)height), 1.0, 100000.0);
@@ -1176,6 +2040,11 @@ void glConnectionWidget::selectionChanged(QItemSelection top, QItemSelection)
 
     // look up the selected item
     QModelIndexList indices = top.indexes();
+    if (indices.isEmpty()) {
+        // the selected row has been removed
+        this->repaint();
+        return;
+    }
     TreeItem *item = static_cast<TreeItem*>(indices[0].internalPointer());
 
     for (int i = 0; i < data->populations.size(); ++i) {
@@ -1275,7 +2144,7 @@ void glConnectionWidget::parsChangedPopulation(int value)
             }
 
             // invalidate logs as size of pop has changed
-            popLogs[i] = NULL;
+            setPopLog(i, NULL);
             popColours[i].clear();
         }
     }
@@ -1326,6 +2195,8 @@ void glConnectionWidget::parsChangedPopulation()
 void glConnectionWidget::parsChangedProjections()
 {
     this->refreshAll();
+    // the weights may have been edited in place
+    weightColours.clear();
 
     for (int i = 0; i < selectedConns.size(); ++i) {
 
@@ -1353,6 +2224,7 @@ void glConnectionWidget::parsChangedProjections()
                 }
                 ((pythonscript_connection *) conn)->connections = connections[i];
                 ((pythonscript_connection *) conn)->setUnchanged(true);
+                this->invalidateConnectionLines();
             }
         }
     }
@@ -1405,6 +2277,7 @@ void glConnectionWidget::parsChangedProjection()
                         }
                         ((pythonscript_connection *) conn)->connections = connections[i];
                         ((pythonscript_connection *) conn)->setUnchanged(true);
+                        this->invalidateConnectionLines();
                     }
                 }
             }
@@ -1417,38 +2290,54 @@ void glConnectionWidget::parsChangedProjection()
 // after switching views, check we haven't broken anything!
 void glConnectionWidget::refreshAll()
 {
+    // what is in the network now, which may be another project's
+    QSet <systemObject *> current;
+    for (int i = 0; i < data->populations.size(); ++i) {
+        QSharedPointer <population> currPop = data->populations[i];
+        current.insert(currPop.data());
+        for (int j = 0; j < currPop->neuronType->inputs.size(); ++j) {
+            current.insert(currPop->neuronType->inputs[j].data());
+        }
+        for (int j = 0; j < currPop->projections.size(); ++j) {
+            for (int k = 0; k < currPop->projections[j]->synapses.size(); ++k) {
+                current.insert(currPop->projections[j]->synapses[k].data());
+            }
+        }
+    }
+
     // check on populations
+    QVector <QSharedPointer <population> > newLayouts;
     for (int i = 0; i < selectedPops.size(); ++i) {
 
         QSharedPointer <population> currPop = selectedPops[i];
 
         // check it isn't deleted
-        if (currPop->isDeleted) {
+        if (currPop->isDeleted || !current.contains(currPop.data())) {
             // remove
             selectedPops.erase(selectedPops.begin()+i);
+            setPopLog(i, NULL);
             popLogs.erase(popLogs.begin()+i);
             popColours.erase(popColours.begin()+i);
+            layoutJobs.remove(currPop.data());
             --i;
             continue;
         }
 
-        // refresh data if size has changed
-        if ((int) currPop->layoutType->locations.size() != currPop->numNeurons) {
-            QString errs;
+        // refresh data if size has changed, unless it is being made already
+        if ((int) currPop->layoutType->locations.size() != currPop->numNeurons
+            && !layoutJobs.contains(currPop.data())) {
             currPop->layoutType->locations.clear();
-            currPop->layoutType->generateLayout(currPop->numNeurons,&currPop->layoutType->locations,errs);
-            // display all errors
-            if (!errs.isEmpty()) {
-                this->data->updateStatusBar(errs,2000);
-            }
+            newLayouts.push_back(currPop);
         }
     }
+    this->startLayouts(newLayouts);
 
     // check on projections
     for (int i = 0; i < selectedConns.size(); ++i) {
         // check it isn't deleted
-        if (selectedConns[i]->isDeleted) {
+        if (selectedConns[i]->isDeleted || !current.contains(selectedConns[i].data())) {
             // remove
+            connectionKeys.remove(selectedConns[i].data());
             selectedConns.erase(selectedConns.begin()+i);
             connections.erase(connections.begin()+i);
             --i;
@@ -1473,6 +2362,84 @@ void glConnectionWidget::drawLocations(QVector <loc> locs)
     this->repaint();
 }
 
+/*!
+ * Generate the layouts of pops side by side on the thread pool. Each is drawn
+ * as a box until layoutsGenerated() collects it.
+ */
+void glConnectionWidget::startLayouts(const QVector <QSharedPointer <population> > &pops)
+{
+    if (pops.isEmpty()) {
+        return;
+    }
+    QVector <QSharedPointer <layoutJob> > jobs;
+    for (int i = 0; i < pops.size(); ++i) {
+        QSharedPointer <layoutJob> job = layoutJob::create(pops[i]->layoutType, pops[i]->numNeurons);
+        connect(job.data(), SIGNAL(done()), this, SLOT(layoutsGenerated()), Qt::QueuedConnection);
+        layoutJobs[pops[i].data()] = job;
+        jobs.push_back(job);
+    }
+    layoutJob::startInBackground(jobs);
+
+    // those which were cached are done already
+    this->layoutsGenerated();
+}
+
+void glConnectionWidget::layoutsGenerated()
+{
+    bool collected = false;
+    QString errs;
+    for (int i = 0; i < selectedPops.size(); ++i) {
+        QMap <population *, QSharedPointer <layoutJob> >::iterator it = layoutJobs.find(selectedPops[i].data());
+        if (it == layoutJobs.end() || !it.value()->isDone()) {
+            continue;
+        }
+        it.value()->collect(&selectedPops[i]->layoutType->locations, errs);
+        layoutJobs.erase(it);
+        collected = true;
+    }
+    if (!errs.isEmpty()) {
+        this->data->updateStatusBar(errs, 2000);
+    }
+    if (collected) {
+        // lines drawn to the placeholders are drawn to the neurons now
+        this->invalidateConnectionLines();
+        this->repaint();
+    }
+}
+
+/*!
+ * A wireframe box standing in for a population whose layout is being made,
+ * of about the size of the default layout of as many neurons.
+ */
+void glConnectionWidget::drawLayoutPlaceholder(QSharedPointer <population> pop, loc offset)
+{
+    GLfloat w = 10.0f;
+    GLfloat h = qMax(1.0f, ceilf(float(pop->numNeurons) / 10.0f));
+    GLfloat d = 1.0f;
+    GLfloat corners[8][3];
+    for (int c = 0; c < 8; ++c) {
+        corners[c][0] = offset.x + ((c & 1) ? w : 0.0f) - 0.5f;
+        corners[c][1] = offset.y + ((c & 2) ? h : 0.0f) - 0.5f;
+        corners[c][2] = offset.z + ((c & 4) ? d : 0.0f) - 0.5f;
+    }
+
+    glDisable(GL_LIGHTING);
+    glLineWidth(1.0f);
+    glColor4f(pop->colour.redF(), pop->colour.greenF(), pop->colour.blueF(), 0.8f);
+    glBegin(GL_LINES);
+    // each edge joins corners which differ in one axis
+    for (int c = 0; c < 8; ++c) {
+        for (int axis = 1; axis < 8; axis <<= 1) {
+            if (!(c & axis)) {
+                glVertex3fv(corners[c]);
+                glVertex3fv(corners[c | axis]);
+            }
+        }
+    }
+    glEnd();
+    glEnable(GL_LIGHTING);
+}
+
 void glConnectionWidget::clearLocations()
 {
     // clear the set of location passed in (used for layout previews)
@@ -1505,6 +2472,8 @@ void glConnectionWidget::getConnections()
                     // refresh the connections
                     connections[i].clear();
                     ((csv_connection *) currTarg->connectionType)->getAllData(connections[i]);
+                    connectionKeys[currTarg.data()] = this->connectionKey(currTarg->connectionType);
+                    this->invalidateConnectionLines();
                 }
             }
         }
@@ -1513,10 +2482,52 @@ void glConnectionWidget::getConnections()
     this->repaint();
 }
 
+QByteArray glConnectionWidget::connectionKey(connection * connType)
+{
+    // the connection itself, which is replaced when its type is changed
+    QByteArray key = QByteArray::number((qulonglong) (quintptr) connType);
+    if (connType->type == CSV) {
+        key += ":" + ((csv_connection *) connType)->getExportKey();
+    } else if (connType->type == Python) {
+        pythonscript_connection * pyConn = (pythonscript_connection *) connType;
+        key += ":" + QByteArray::number(pyConn->connections.size()) + (pyConn->changed() ? ":changed" : "");
+    }
+    return key;
+}
+
+bool glConnectionWidget::loadConnections(connection * connType, QSharedPointer <population> src, QSharedPointer <population> dst, QVector < conn > &out)
+{
+    out.clear();
+    if (connType->type == CSV) {
+        // load in the connections
+        ((csv_connection *) connType)->getAllData(out);
+    } else if (connType->type == Python) {
+        pythonscript_connection * pyConn = (pythonscript_connection *) connType;
+        if (pyConn->connections.size() > 0 && !pyConn->changed()) {
+            out = pyConn->connections;
+        } else {
+            // generate
+            // launch version increment dialog box:
+            generate_dialog generate(pyConn, src, dst, out, connGenerationMutex, this);
+            bool retVal = generate.exec();
+            if (!retVal) {
+                return false;
+            }
+            pyConn->connections = out;
+            pyConn->setUnchanged(true);
+        }
+    }
+    return true;
+}
+
 void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
 {
     // this is fired when an item is checked or unchecked
 
+    // let failed scripts be retried
+    generationErrors.clear();
+
+    QVector <QSharedPointer <population> > newLayouts;
     for (int i = 0; i < data->populations.size(); ++i) {
 
         QSharedPointer <population> currPop = (QSharedPointer <population>) data->populations[i];
@@ -1530,14 +2541,9 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
                     inList = true;
             }
             if (!inList) {
-                // generate data:
+                // generate data, alongside the other populations checked
                 if (currPop->layoutType->locations.size() == 0) {
-                    QString errs;
-                    currPop->layoutType->generateLayout(currPop->numNeurons,&currPop->layoutType->locations,errs);
-                    // display all errors
-                    if (!errs.isEmpty()) {
-                        //this->data->statusBarUpdate(errs,2000);
-                    }
+                    newLayouts.push_back(currPop);
                 }
                 selectedPops.push_back(currPop);
                 popLogs.push_back(NULL);
@@ -1548,8 +2554,10 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
             for (int p = 0; p < this->selectedPops.size(); ++p) {
                 if (selectedPops[p] == currPop) {
                     selectedPops.erase(selectedPops.begin()+p);
+                    setPopLog(p, NULL);
                     popLogs.erase(popLogs.begin()+p);
                     popColours.erase(popColours.begin()+p);
+                    layoutJobs.remove(currPop.data());
                     // clear location data
                     currPop->layoutType->locations.clear();
                 }
@@ -1565,42 +2573,30 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
                 if (currIn->source->type == populationObject && currIn->destination->type == populationObject) {
                     if (currIn->isVisualised) {
                         // add to list if not in list
-                        bool inList = false;
+                        int inList = -1;
                         for (int p = 0; p < this->selectedConns.size(); ++p) {
                             if (selectedConns[p] == currIn)
-                                inList = true;
+                                inList = p;
                         }
-                        if (!inList) {
+                        if (inList == -1) {
                             selectedConns.push_back(currIn);
                             connections.resize(connections.size()+1);
-
-                            if (currIn->conn->type == CSV) {
-                                // load in the connections
-                                ((csv_connection *) currIn->conn)->getAllData(connections.back());
-                            } else if (currIn->conn->type == Python) {
-                                if (((pythonscript_connection *) currIn->conn)->connections.size() > 0 && !((pythonscript_connection *) currIn->conn)->changed()) {
-                                    connections.back() = ((pythonscript_connection *) currIn->conn)->connections;
-                                } else {
-                                    // generate
-                                    // launch version increment dialog box:
-                                    QSharedPointer <population> popSrc = qSharedPointerDynamicCast <population> (currIn->source);
-                                    QSharedPointer <population> popDst = qSharedPointerDynamicCast <population> (currIn->destination);
-                                    generate_dialog generate(((pythonscript_connection *) currIn->conn), popSrc, popDst, connections.back(), connGenerationMutex, this);
-                                    bool retVal = generate.exec();
-                                    if (!retVal) {
-                                        continue;
-                                    }
-                                    ((pythonscript_connection *) currIn->conn)->connections = connections.back();
-                                    ((pythonscript_connection *) currIn->conn)->setUnchanged(true);
-                                }
-                            }
-
+                            inList = selectedConns.size()-1;
+                        } else if (connectionKeys.value(currIn.data()) == this->connectionKey(currIn->conn)) {
+                            // already loaded, and unchanged since
+                            continue;
                         }
 
+                        QSharedPointer <population> popSrc = qSharedPointerDynamicCast <population> (currIn->source);
+                        QSharedPointer <population> popDst = qSharedPointerDynamicCast <population> (currIn->destination);
+                        this->loadConnections(currIn->conn, popSrc, popDst, connections[inList]);
+                        connectionKeys[currIn.data()] = this->connectionKey(currIn->conn);
+
                     } else {
                         // remove from list if there
                         for (int p = 0; p < this->selectedConns.size(); ++p) {
                             if (selectedConns[p] == currIn) {
+                                connectionKeys.remove(currIn.data());
                                 selectedConns.erase(selectedConns.begin()+p);
                                 connections.erase(connections.begin()+p);
                             }
@@ -1622,39 +2618,31 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
 
                 if (currTarg->isVisualised) {
                     // if not in list then add to list
-                    bool inList = false;
+                    int inList = -1;
                     for (int p = 0; p < this->selectedConns.size(); ++p) {
                         if (selectedConns[p] == currTarg)
-                            inList = true;
+                            inList = p;
                     }
-                    if (!inList) {
+                    if (inList == -1) {
                         selectedConns.push_back(currTarg);
                         connections.resize(connections.size()+1);
+                        inList = selectedConns.size()-1;
+                    } else if (connectionKeys.value(currTarg.data()) == this->connectionKey(currTarg->connectionType)) {
+                        // already loaded, and unchanged since
+                        continue;
+                    }
 
-                        if (currTarg->connectionType->type == CSV) {
-                            // load in the connections
-                            ((csv_connection *) currTarg->connectionType)->getAllData(connections.back());
-                        } else if (currTarg->connectionType->type == Python) {
-                            if (((pythonscript_connection *) currTarg->connectionType)->connections.size() > 0 && !((pythonscript_connection *) currTarg->connectionType)->changed()) {
-                                connections.back() = ((pythonscript_connection *) currTarg->connectionType)->connections;
-                            } else {
-                                // generate
-                                // launch version increment dialog box:
-                                generate_dialog generate(((pythonscript_connection *) currTarg->connectionType), currTarg->proj->source, currTarg->proj->destination, connections.back(), connGenerationMutex, this);
-                                bool retVal = generate.exec();
-                                if (!retVal) {
-                                    return;
-                                }
-                                ((pythonscript_connection *) currTarg->connectionType)->connections = connections.back();
-                                ((pythonscript_connection *) currTarg->connectionType)->setUnchanged(true);
-                            }
-                        }
-
+                    bool loaded = this->loadConnections(currTarg->connectionType, currTarg->proj->source, currTarg->proj->destination, connections[inList]);
+                    connectionKeys[currTarg.data()] = this->connectionKey(currTarg->connectionType);
+                    if (!loaded) {
+                        this->startLayouts(newLayouts);
+                        return;
                     }
                 } else {
                     // if in list then remove from list
                     for (int p = 0; p < this->selectedConns.size(); ++p) {
                         if (selectedConns[p] == currTarg) {
+                            connectionKeys.remove(currTarg.data());
                             selectedConns.erase(selectedConns.begin()+p);
                             connections.erase(connections.begin()+p);
                         }
@@ -1663,6 +2651,11 @@ void glConnectionWidget::sysSelectionChanged(QModelIndex, QModelIndex)
             }
         }
     }
+    this->startLayouts(newLayouts);
+
+    // entries may have been refilled or reused
+    this->invalidateConnectionLines();
+
     // check for logs:
     experiment* currentExperiment = data->main->getCurrentExpt();
     if (currentExperiment != (experiment*)0) {
@@ -1690,10 +2683,28 @@ void glConnectionWidget::connectionSelectionChanged(QItemSelection, QItemSelecti
     this->repaint();
 }
 
+/*!
+ * Escape cancels the scripts generating connectivity for the view.
+ */
+void glConnectionWidget::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape && !generatingConns.isEmpty()) {
+        QMap <pythonscript_connection *, QPointer <pythonscript_connection> >::const_iterator it;
+        for (it = generatingConns.constBegin(); it != generatingConns.constEnd(); ++it) {
+            if (it.value()) {
+                it.value()->cancelGeneration();
+            }
+        }
+        return;
+    }
+    QGLWidget::keyPressEvent(event);
+}
+
 void glConnectionWidget::mousePressEvent(QMouseEvent *event)
 {
     setCursor(Qt::ClosedHandCursor);
     button = event->button();
+    pressPos = event->pos();
     origPos = event->globalPos();
     origPos.setX(origPos.x() - pos.x()*100/zoomFactor);
     origPos.setY(origPos.y() + pos.y()*100/zoomFactor);
@@ -1702,9 +2713,94 @@ void glConnectionWidget::mousePressEvent(QMouseEvent *event)
     origRot.setY(origRot.y() - rot.y()*2);
 }
 
-void glConnectionWidget::mouseReleaseEvent(QMouseEvent *)
+void glConnectionWidget::mouseReleaseEvent(QMouseEvent *event)
 {
     setCursor(Qt::ArrowCursor);
+
+    // a click rather than a drag picks a neuron
+    if (button == Qt::LeftButton && (event->pos() - pressPos).manhattanLength() < 3) {
+        this->pickNeuron(event->pos());
+    }
+}
+
+/*!
+ * Cast a ray through point and select the nearest neuron it hits at either
+ * end of the selected projection, showing that neuron's connections.
+ */
+void glConnectionWidget::pickNeuron(QPoint point)
+{
+    if (!pickValid || selectedObject.isNull() || locations.size() > 0) {
+        return;
+    }
+
+    QSharedPointer <population> ends[2];
+    if (selectedObject->type == synapseObject) {
+        QSharedPointer <synapse> currTarg = qSharedPointerDynamicCast <synapse> (selectedObject);
+        CHECK_CAST(currTarg)
+        ends[0] = currTarg->proj->source;
+        ends[1] = currTarg->proj->destination;
+    } else if (selectedObject->type == inputObject) {
+        QSharedPointer<genericInput> currIn = qSharedPointerDynamicCast<genericInput> (selectedObject);
+        CHECK_CAST(currIn)
+        ends[0] = qSharedPointerDynamicCast <population> (currIn->source);
+        ends[1] = qSharedPointerDynamicCast <population> (currIn->destination);
+    } else {
+        return;
+    }
+
+    // the ray from the near to the far plane under the mouse
+    GLdouble winX = point.x()*RETINA_SUPPORT;
+    GLdouble winY = pickViewport[3] - point.y()*RETINA_SUPPORT;
+    GLdouble nearPt[3];
+    GLdouble farPt[3];
+    if (!gluUnProject(winX, winY, 0.0, pickModelview, pickProjection, pickViewport, &nearPt[0], &nearPt[1], &nearPt[2])
+        || !gluUnProject(winX, winY, 1.0, pickModelview, pickProjection, pickViewport, &farPt[0], &farPt[1], &farPt[2])) {
+        return;
+    }
+    loc dir;
+    dir.x = farPt[0] - nearPt[0];
+    dir.y = farPt[1] - nearPt[1];
+    dir.z = farPt[2] - nearPt[2];
+
+    int picked = -1;
+    int pickedEnd = 0;
+    GLfloat pickedT = std::numeric_limits<GLfloat>::max();
+    for (int e = 0; e < 2; ++e) {
+        QSharedPointer <population> pop = ends[e];
+        if (pop.isNull() || !pop->isVisualised) {
+            continue;
+        }
+        neuronPickGrid &grid = pickGrids[pop.data()];
+        if (!grid.isBuiltFor(pop->layoutType->locations, 0.5)) {
+            grid.build(pop->layoutType->locations, 0.5);
+        }
+        // into the population's own coordinates
+        loc origin;
+        origin.x = nearPt[0] - pop->loc3.x;
+        origin.y = nearPt[1] - pop->loc3.y;
+        origin.z = nearPt[2] - pop->loc3.z;
+        GLfloat t;
+        int index = grid.pick(origin, dir, t);
+        if (index != -1 && t < pickedT) {
+            picked = index;
+            pickedEnd = e;
+            pickedT = t;
+        }
+    }
+    if (picked == -1) {
+        return;
+    }
+
+    // for a self connection keep whichever end is being shown
+    if (ends[0] == ends[1]) {
+        pickedEnd = selectedType == 2 ? 1 : 0;
+    }
+
+    selectedType = pickedEnd + 1;
+    selectedIndex = picked;
+    emit neuronPickedFrom(pickedEnd);
+    emit neuronPicked(picked);
+    this->repaint();
 }
 
 void glConnectionWidget::mouseMoveEvent(QMouseEvent *event)
@@ -1760,23 +2856,53 @@ void glConnectionWidget::selectedNrnChanged(int index)
 }
 
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
+/*!
+ * Render the view at w x h through one framebuffer object of at most
+ * IMAGE_EXPORT_TILE_SIZE square, one tile at a time, so the size of the
+ * image is not limited by what the GL can allocate at once.
+ */
 QImage glConnectionWidget:: renderQImage(int w, int h)
 {
-    // Set the rendering engine to the size of the image to render
+    QImage image(w, h, QImage::Format_ARGB32);
+    if (image.isNull()) {
+        return QImage();
+    }
+
     // Also set the format so that the depth buffer will work
+    int fboWidth = qMin(w, IMAGE_EXPORT_TILE_SIZE);
+    int fboHeight = qMin(h, IMAGE_EXPORT_TILE_SIZE);
     QOpenGLFramebufferObjectFormat format;
     format.setAttachment(QOpenGLFramebufferObject::Depth);
-    QOpenGLFramebufferObject qfb(w,h,format);
-    qfb.bind();
+    QOpenGLFramebufferObject qfb(fboWidth,fboHeight,format);
     // If the frame buffer does not work then return an empty image
     if(!qfb.isValid()) return(QImage());
-    resizeGL(w,h);
-    // Draw the scene to the buffer
-    glEnable(GL_MULTISAMPLE);
-    this->repaint();
-    qfb.release();
+
+    QPainter imagePainter(&image);
+    imagePainter.setCompositionMode(QPainter::CompositionMode_Source);
+
+    // tiles are in GL coordinates, from the bottom left of the image
+    for (int y = 0; y < h; y += fboHeight) {
+        for (int x = 0; x < w; x += fboWidth) {
+            imageTile = QRect(x, y, qMin(fboWidth, w-x), qMin(fboHeight, h-y));
+
+            // Draw the scene to the buffer
+            qfb.bind();
+            glEnable(GL_MULTISAMPLE);
+            this->repaintAllowed = true;
+            this->repaint();
+            qfb.release();
+
+            // the tile is drawn at the bottom left of the buffer
+            QImage tile = qfb.toImage();
+            imagePainter.drawImage(QPoint(x, h - y - imageTile.height()), tile,
+                                   QRect(0, fboHeight - imageTile.height(), imageTile.width(), imageTile.height()));
+        }
+    }
+    imagePainter.end();
+
+    imageTile = QRect(0, 0, w, h);
     resizeGL(width(),height());
-    return(qfb.toImage());
+    return image;
 }
 #endif
 
@@ -1785,6 +2911,7 @@ QPixmap glConnectionWidget::renderImage(int width, int height)
     QPixmap pix;
     imageSaveHeight = height;
     imageSaveWidth = width;
+    imageTile = QRect(0, 0, width, height);
     imageSaveMode = true;
 
 // renderPixmap is broken in Qt > 5.0 - this fix doesn't currently work correctly, but is better than nothing
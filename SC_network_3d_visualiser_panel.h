@@ -25,8 +25,14 @@
 #ifndef GLCONNECTIONWIDGET_H
 #define GLCONNECTIONWIDGET_H
 
+#include <QPointer>
 #include "globalHeader.h"
+#include "CL_classes.h"
+#include "CL_layout_classes.h"
 #include "SC_logged_data.h"
+#include "SC_network_3d_renderer.h"
+#include "SC_animationscheduler.h"
+#include "SC_liveactivity.h"
 
 class RNG
 {
@@ -46,6 +52,12 @@ private:
 
 };
 
+// largest framebuffer, in pixels each way, used when exporting images
+#define IMAGE_EXPORT_TILE_SIZE 2048
+
+// number of entries in the colour table used to show logged values
+#define LOG_COLOUR_LUT_SIZE 1024
+
 struct popLocs {
 
     QVector < loc > locations;
@@ -62,11 +74,56 @@ struct loc3f {
     float z;
 };
 
-class glConnectionWidget : public QGLWidget
+// the vertex buffer for one projection's connections and what it was built from
+struct connectionLineCache {
+    connectionLineCache() {lines = NULL; dirty = true; type = none; prob = -1; seed = 0; rowStride = 1; selIndex = -1; selType = 0;}
+    glConnectionLines * lines;
+    bool dirty;
+    // the kind of connection the buffer was built for
+    connectionType type;
+    const conn * connData;
+    int numConns;
+    const loc * srcLocs;
+    int numSrc;
+    const loc * dstLocs;
+    int numDst;
+    loc3f srcOffset;
+    loc3f dstOffset;
+    bool srcVisualised;
+    bool dstVisualised;
+    int inc;
+    // fixed probability connections are generated, not copied from a list
+    float prob;
+    int seed;
+    // only every rowStride-th source of generated connections is drawn
+    int rowStride;
+    // the generated connections of the selected neuron, as line end points
+    QVector <loc> selLines;
+    int selIndex;
+    int selType;
+};
+
+// the weights of one projection's connections scaled for colouring, and
+// what they were scaled from
+struct weightColourCache {
+    weightColourCache() {weights = NULL; values = NULL; numValues = 0; indices = NULL; numIndices = 0; numConns = -1;}
+    const ParameterInstance * weights;
+    const double * values;
+    int numValues;
+    const int * indices;
+    int numIndices;
+    int numConns;
+    explicitValueStatistics stats;
+    // from 0 at the least weight to 1 at the greatest, by connection index
+    QVector <GLfloat> normalised;
+};
+
+class glConnectionWidget : public QGLWidget, public animatedView
 {
     Q_OBJECT
 public:
     explicit glConnectionWidget(nl_rootdata * data, QWidget *parent = 0);
+    ~glConnectionWidget();
     QVector <QSharedPointer <population> > selectedPops;
     QVector < popLocs> pops;
     QVector <QSharedPointer<systemObject> > selectedConns;
@@ -81,12 +138,68 @@ public:
     int seed;
     bool popIndicesShown;
     void clear();
+    /*!
+     * Forget the selected object and neuron, keeping the populations and
+     * connections which are shown and their loaded data.
+     */
+    void resetSelection();
     QPixmap renderImage(int, int);
     void addLogs(QVector<logData *> *logs);
     void refreshAll();
+    /*!
+     * Listen for the analog external outputs, of the selected experiment,
+     * from the populations shown, and colour their neurons from each
+     * timestep the running model sends. False, with error set, if there
+     * are no such outputs.
+     */
+    bool startLiveActivity(QString &error);
+    void stopLiveActivity();
 
 private:
     void drawNeuron(GLfloat, int, int, QColor);
+    glNeuronRenderer * neuronRenderer;
+    QMap <systemObject *, connectionLineCache> lineCaches;
+    // what each of the selectedConns was loaded from, so that its data are
+    // only fetched again when that changes
+    QMap <systemObject *, QByteArray> connectionKeys;
+    QByteArray connectionKey(connection * connType);
+    bool loadConnections(connection * connType, QSharedPointer <population> src, QSharedPointer <population> dst, QVector < conn > &out);
+    void invalidateConnectionLines();
+    QMap <systemObject *, connectionAdjacency> adjacencies;
+    const connectionAdjacency & getAdjacency(int targNum);
+    QMap <systemObject *, weightColourCache> weightColours;
+    const weightColourCache & getWeightColours(int targNum, const ParameterInstance * weights);
+    QMap <population *, neuronPickGrid> pickGrids;
+    // the octrees the neurons of each population, and of the layout
+    // previewed, are culled and drawn through
+    QMap <population *, neuronOctree> octrees;
+    neuronOctree previewOctree;
+    neuronDrawList neuronList;
+    void drawNeurons(neuronOctree &tree, const QVector <loc> &locations, loc offset,
+                     const QVector <QColor> &colours, QColor defaultColour);
+    GLdouble pickModelview[16];
+    GLdouble pickProjection[16];
+    GLint pickViewport[4];
+    bool pickValid;
+    QPoint pressPos;
+    void pickNeuron(QPoint point);
+    void drawConnectionLines(int targNum, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset);
+    void drawFixedProbLines(int targNum, fixedProb_connection * fpConn, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset, float lineScaleFactor);
+    void drawAllToAllLines(int targNum, QSharedPointer <population> src, QSharedPointer <population> dst, loc3f srcOffset, loc3f dstOffset, float lineScaleFactor);
+    QThread generationThread;
+    // the connections whose scripts are running, any of which may be
+    // deleted before its script finishes
+    QMap <pythonscript_connection *, QPointer <pythonscript_connection> > generatingConns;
+    // the error of each script which failed, headed by its name
+    QMap <pythonscript_connection *, QString> generationErrors;
+    void startConnectionGeneration(pythonscript_connection * pyConn);
+    void drawGenerationStatus(QPainter &painter);
+    // the layouts of selectedPops being generated on the pool; each of
+    // these populations is drawn as a box until its job is done
+    QMap <population *, QSharedPointer <layoutJob> > layoutJobs;
+    void startLayouts(const QVector <QSharedPointer <population> > &pops);
+    void drawLayoutPlaceholder(QSharedPointer <population> pop, loc offset);
+    void drawProfilerOverlay(QPainter &painter);
     void setupView();
     QString currentObjectName;
     QAbstractTableModel * model;
@@ -110,11 +223,32 @@ private:
     bool imageSaveMode;
     int imageSaveWidth;
     int imageSaveHeight;
+    QRect imageTile;
     QVector < QVector < QColor > > popColours;
+    // the logs shown on the selected populations, each held from the
+    // logRegistry so it outlives the graph view which loaded it
     QVector < logData * > popLogs;
+    void setPopLog(int index, logData * log);
+    // an event log colours its population by the firing rate of each neuron
+    void setFiringRateColours(int index);
+    QVector < QColor > logColourLUT;
     int currentLogTime;
     int newLogTime;
-    QTimer timer;
+    bool animateFrame();
+    logRowPrefetcher * logPrefetch;
+    QThread prefetchThread;
+    // the external outputs being received, and the population and neuron
+    // index of each value of each of them (empty for all, in order)
+    liveActivityReceiver * live;
+    QThread liveThread;
+    QVector <QSharedPointer <population> > livePops;
+    QVector <QVector <int> > liveNeurons;
+    QVector <double> liveFrame;
+    void updateLiveActivity();
+    void drawLiveStatus(QPainter &painter);
+    QTimer repaintTimer;
+    // refreshes the profiler overlay
+    QTimer profilerTimer;
     bool orthoView;
     bool repaintAllowed;
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
@@ -127,6 +261,8 @@ signals:
     void getNeuronLocationsSrc(QVector < QVector <loc> > *, QVector < QColor > *, QString name = "");
     void updatePanel(QString);
     void setSelectionbyName(QString);
+    void neuronPicked(int index);
+    void neuronPickedFrom(int from);
     
 public slots:
     void redraw();
@@ -149,15 +285,19 @@ public slots:
     void updateLogData();
     void toggleOrthoView(bool);
     void allowRepaint();
+    void connectionsGenerated();
+    void layoutsGenerated();
 
 protected:
     void initializeGL();
+    void showEvent(QShowEvent * event);
     void paintEvent(QPaintEvent *);
     void resizeGL(int width, int height);
     void mousePressEvent(QMouseEvent *event);
-    void mouseReleaseEvent(QMouseEvent *);
+    void mouseReleaseEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent *event);
+    void keyPressEvent(QKeyEvent *event);
 
 };
 
@@ -31,6 +31,8 @@
 #include "SC_projectobject.h"
 #include "SC_systemmodel.h"
 #include "SC_component_rootcomponentitem.h"
+#include "SC_clipboard.h"
+#include "QTimer"
 
 /*
  Alex Cope 2012
@@ -69,11 +71,27 @@ nl_rootdata::nl_rootdata(QObject *parent) :
     this->catalogLayout.push_back(QSharedPointer<NineMLLayout>(new NineMLLayout()));
     this->catalogLayout[0]->name = "none";
     this->selectionMoved = false;
+    this->undoGestureOpen = false;
+    this->undoGestureCount = 0;
+    this->undoGestureRedraws = 0;
+    this->systemModelQueued = false;
+    this->routingProject = (projectObject *) 0;
+    this->routingGeneration = 0;
+    this->routingValid = false;
+    this->registryProject = (projectObject *) 0;
+    this->registryGeneration = 0;
+    this->registryValid = false;
 
     this->selChange = false;
 
     if (!popImage.load( ":/icons/objects/icons/nrn.png" )) std::cerr << "warn" << endl;
 
+    // the drawn model is indexed and cached until something asks for a redraw
+    this->sceneValid = false;
+    this->sceneCacheValid = false;
+    this->sceneCacheScale = 0.0;
+    connect(this, SIGNAL(redrawGLview()), this, SLOT(sceneChanged()));
+
     // update version and name
     setCaption("");
 
@@ -105,22 +123,14 @@ void nl_rootdata::redrawViews()
     main->viewELhandler->redraw();
 
     if ( main->viewVZ.OpenGLWidget != NULL) {
-        // redraw viz
-        main->viewVZ.OpenGLWidget->refreshAll();
         // clear away old stuff
         main->viewVZ.currObject = (QSharedPointer<systemObject>)0;
         main->viewVZhandler->clearAll();
-        main->viewVZ.OpenGLWidget->clear();
         // configure TreeView
-        if (!(main->viewVZ.sysModel == NULL)) {
-            delete main->viewVZ.sysModel;
-        }
-        main->viewVZ.sysModel = new systemmodel(this);
-        main->viewVZ.treeView->setModel(main->viewVZ.sysModel);
-        // connect for function
-        connect(main->viewVZ.treeView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), main->viewVZhandler, SLOT(selectionChanged(QItemSelection,QItemSelection)));
-        connect(main->viewVZ.treeView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), main->viewVZ.OpenGLWidget, SLOT(selectionChanged(QItemSelection,QItemSelection)));
-        connect(main->viewVZ.sysModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), main->viewVZ.OpenGLWidget, SLOT(sysSelectionChanged(QModelIndex,QModelIndex)));
+        main->configureSystemModel();
+        // redraw viz, keeping what is shown and still in the network
+        main->viewVZ.OpenGLWidget->refreshAll();
+        main->viewVZ.OpenGLWidget->resetSelection();
         main->viewVZhandler->redrawHeaders();
         main->viewVZ.OpenGLWidget->sysSelectionChanged(QModelIndex(), QModelIndex());
     }
@@ -180,82 +190,43 @@ bool nl_rootdata::doesExperimentExist (experiment* e)
 
 void nl_rootdata::replaceComponent(QSharedPointer<Component> oldComp, QSharedPointer<Component> newComp)
 {
-    for (int p = 0; p < this->populations.size(); ++p) {
+    // a copy, as migrating the instances moves them in the index
+    QVector <componentUse> users = this->usersOf(oldComp);
+    QSet <ComponentInstance *> migrated;
 
-        QSharedPointer <population> pop = this->populations[p];
+    for (int u = 0; u < users.size(); ++u) {
 
-        // replace references
-        if (pop->neuronType->component == oldComp) {
-            // has the type changed?
-            if (newComp->type != "neuron_body") {
-                pop->neuronType->migrateComponent(catalogNrn[0]);
-                for (int i = 0; i < experiments.size(); ++i) {
-                    experiment * currExpt = experiments[i];
-                    currExpt->updateChanges(pop->neuronType);
-                }
+        QSharedPointer <ComponentInstance> inst = users[u].instance;
+
+        // has the type changed?
+        if (newComp->type != users[u].type) {
+            if (users[u].type == "neuron_body") {
+                inst->migrateComponent(catalogNrn[0]);
+            } else if (users[u].type == "weight_update") {
+                inst->migrateComponent(catalogWU[0]);
             } else {
-                pop->neuronType->migrateComponent(newComp);
-                for (int i = 0; i < experiments.size(); ++i) {
-                    experiment * currExpt = experiments[i];
-                    currExpt->updateChanges(pop->neuronType);
-                }
+                inst->migrateComponent(catalogPS[0]);
             }
+        } else {
+            inst->migrateComponent(newComp);
         }
+        migrated.insert(inst.data());
+    }
 
-        for (int pr = 0; pr < pop->projections.size(); ++pr) {
-
-            QSharedPointer <projection> proj = pop->projections[pr];
-
-            for (int sy = 0; sy < proj->synapses.size(); ++sy) {
-
-                QSharedPointer <synapse> syn = proj->synapses[sy];
-
-                // replace references
-                if (syn->weightUpdateCmpt->component == oldComp) {
-                    // has the type changed?
-                    if (newComp->type != "weight_update") {
-                        syn->weightUpdateCmpt->migrateComponent(catalogWU[0]);
-                        for (int i = 0; i < experiments.size(); ++i) {
-                            experiment * currExpt = experiments[i];
-                            currExpt->updateChanges(syn->weightUpdateCmpt);
-                        }
-                    } else {
-                        syn->weightUpdateCmpt->migrateComponent(newComp);
-                        for (int i = 0; i < experiments.size(); ++i) {
-                            experiment * currExpt = experiments[i];
-                            currExpt->updateChanges(syn->weightUpdateCmpt);
-                        }
-                    }
-                }
-
-                // replace references
-                if (syn->postSynapseCmpt->component == oldComp) {
-                    // has the type changed?
-                    if (newComp->type != "postsynapse") {
-                        syn->postSynapseCmpt->migrateComponent(catalogPS[0]);
-                        for (int i = 0; i < experiments.size(); ++i) {
-                            experiment * currExpt = experiments[i];
-                            currExpt->updateChanges(syn->postSynapseCmpt);
-                        }
-                    } else {
-                        syn->postSynapseCmpt->migrateComponent(newComp);
-                        for (int i = 0; i < experiments.size(); ++i) {
-                            experiment * currExpt = experiments[i];
-                            currExpt->updateChanges(syn->postSynapseCmpt);
-                        }
-                    }
-                }
-            }
+    // then each experiment is fixed in one pass, for all the instances
+    for (int i = 0; i < experiments.size(); ++i) {
+        experiment * currExpt = experiments[i];
+        if (!migrated.isEmpty()) {
+            currExpt->updateChanges(migrated);
         }
-
         // also fix experiments with bad pointers to PORTS and PARS & COMPONENTS
-        for (int i = 0; i < experiments.size(); ++i) {
-            experiment * currExpt = experiments[i];
+        if (!this->populations.isEmpty()) {
             currExpt->purgeBadPointer(oldComp, newComp);
         }
-
     }
 
+    this->invalidateRouting();
+
     // clear undo
     this->currProject->undoStack->clear();
 }
@@ -263,39 +234,61 @@ void nl_rootdata::replaceComponent(QSharedPointer<Component> oldComp, QSharedPoi
 // centralised function for finding if a component is in the model
 bool nl_rootdata::isComponentInUse(QSharedPointer<Component> oldComp)
 {
-    for (int p = 0; p < populations.size(); ++p) {
+    return !this->usersOf(oldComp).isEmpty();
+}
+
+void nl_rootdata::invalidateRouting()
+{
+    this->routingValid = false;
+    this->componentUsers.clear();
+    this->registryValid = false;
+}
 
-        QSharedPointer <population> pop = populations[p];
+const QVector <nl_rootdata::componentUse> & nl_rootdata::usersOf(QSharedPointer<Component> comp)
+{
+    // without a project nothing tells us when the network changes
+    if (!this->routingValid || this->currProject == (projectObject *) 0 || this->routingProject != this->currProject
+        || this->routingGeneration != this->currProject->modelGeneration) {
 
-        // replace references
-        if (pop->neuronType->component == oldComp) {
-            return true;
-        }
+        this->componentUsers.clear();
 
-        for (int pr = 0; pr < pop->projections.size(); ++pr) {
+        // in the order the places were searched before there was an index
+        for (int p = 0; p < populations.size(); ++p) {
 
-            QSharedPointer <projection> proj = pop->projections[pr];
+            QSharedPointer <population> pop = populations[p];
+            componentUse use;
+            use.instance = pop->neuronType;
+            use.type = "neuron_body";
+            this->componentUsers[pop->neuronType->component.data()].push_back(use);
 
-            for (int sy = 0; sy < proj->synapses.size(); ++sy) {
+            for (int pr = 0; pr < pop->projections.size(); ++pr) {
 
-                QSharedPointer <synapse> syn = proj->synapses[sy];
+                QSharedPointer <projection> proj = pop->projections[pr];
 
-                // replace references
-                if (syn->weightUpdateCmpt->component == oldComp) {
-                    return true;
-                }
+                for (int sy = 0; sy < proj->synapses.size(); ++sy) {
 
-                // replace references
-                if (syn->postSynapseCmpt->component == oldComp) {
-                    return true;
+                    QSharedPointer <synapse> syn = proj->synapses[sy];
+                    use.instance = syn->weightUpdateCmpt;
+                    use.type = "weight_update";
+                    this->componentUsers[syn->weightUpdateCmpt->component.data()].push_back(use);
+                    use.instance = syn->postSynapseCmpt;
+                    use.type = "postsynapse";
+                    this->componentUsers[syn->postSynapseCmpt->component.data()].push_back(use);
                 }
             }
         }
-        // also fix experiments with bad pointers:
+
+        this->routingProject = this->currProject;
+        this->routingGeneration = this->currProject ? this->currProject->modelGeneration : 0;
+        this->routingValid = true;
     }
 
-    // component not found
-    return false;
+    static const QVector <componentUse> none;
+    QHash <Component *, QVector <componentUse> >::const_iterator it = this->componentUsers.constFind(comp.data());
+    if (it == this->componentUsers.constEnd()) {
+        return none;
+    }
+    return *it;
 }
 
 // centralised function for finding if a component is in the model
@@ -342,6 +335,112 @@ void nl_rootdata::reDrawPanel()
     emit updatePanel(this);
 }
 
+void nl_rootdata::beginUndoGesture()
+{
+    if (!this->undoGestureOpen) {
+        this->undoGestureOpen = true;
+        ++this->undoGestureCount;
+    }
+}
+
+int nl_rootdata::undoGesture()
+{
+    return this->undoGestureOpen ? this->undoGestureCount : -1;
+}
+
+bool nl_rootdata::deferUndoRedraw(int redraws)
+{
+    if (!this->undoGestureOpen) {
+        return false;
+    }
+    this->undoGestureRedraws |= redraws;
+    return true;
+}
+
+void nl_rootdata::endUndoGesture()
+{
+    if (!this->undoGestureOpen) {
+        return;
+    }
+    this->undoGestureOpen = false;
+    int redraws = this->undoGestureRedraws;
+    this->undoGestureRedraws = 0;
+
+    if ((redraws & UNDO_REDRAW_PROJECTIONS) && main->viewVZ.OpenGLWidget != NULL) {
+        main->viewVZ.OpenGLWidget->parsChangedProjections();
+    }
+    if (redraws & UNDO_REDRAW_VIEWS) {
+        this->redrawViews();
+    }
+    if (redraws & UNDO_REDRAW_PANEL) {
+        this->reDrawPanel();
+    }
+}
+
+void nl_rootdata::systemModelChanged()
+{
+    if (!this->systemModelQueued) {
+        this->systemModelQueued = true;
+        QTimer::singleShot(0, this, SLOT(updateSystemModel()));
+    }
+}
+
+void nl_rootdata::updateSystemModel()
+{
+    this->systemModelQueued = false;
+    if (main == NULL || main->viewVZ.sysModel == NULL || main->viewVZ.sysModel->dataPtr != this) {
+        // the tree is built when the visualiser is first shown
+        return;
+    }
+
+    // rows for removed objects go, and take their selection with them
+    main->viewVZ.sysModel->update();
+
+    if (main->viewVZ.currObject != (QSharedPointer<systemObject>)0 && main->viewVZ.currObject->isDeleted) {
+        main->viewVZ.currObject = (QSharedPointer<systemObject>)0;
+        main->viewVZhandler->clearAll();
+        main->viewVZhandler->redrawHeaders();
+    }
+
+    if (main->viewVZ.OpenGLWidget != NULL) {
+        main->viewVZ.OpenGLWidget->refreshAll();
+        main->viewVZ.OpenGLWidget->sysSelectionChanged(QModelIndex(), QModelIndex());
+    }
+}
+
+bool nl_rootdata::eventFilter(QObject * obj, QEvent * event)
+{
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+        // the widget may go with the panel before it sees the release
+        connect(obj, SIGNAL(destroyed()), this, SLOT(endUndoGesture()), Qt::UniqueConnection);
+        this->beginUndoGesture();
+        break;
+    case QEvent::MouseButtonRelease:
+        this->endUndoGesture();
+        break;
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    {
+        QKeyEvent * key = static_cast<QKeyEvent *>(event);
+        if (key->key() != Qt::Key_Up && key->key() != Qt::Key_Down
+            && key->key() != Qt::Key_PageUp && key->key() != Qt::Key_PageDown) {
+            break;
+        }
+        if (event->type() == QEvent::KeyPress) {
+            connect(obj, SIGNAL(destroyed()), this, SLOT(endUndoGesture()), Qt::UniqueConnection);
+            this->beginUndoGesture();
+        } else if (!key->isAutoRepeat()) {
+            this->endUndoGesture();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return QObject::eventFilter(obj, event);
+}
+
 void nl_rootdata::callRedrawGLview()
 {
     emit redrawGLview();
@@ -357,6 +456,8 @@ void nl_rootdata::saveImage(QString fileName)
 
 void nl_rootdata::reDrawAll()
 {
+    this->sceneChanged();
+
     // update panel - we don't always want to do this as it loses focus from widgets
     emit updatePanel(this);
 }
@@ -398,22 +499,11 @@ void nl_rootdata::reDrawAll(QPainter *painter, float GLscale, float viewX, float
         }
     }
 
-    // populations
-    for (int i = 0; i < this->populations.size(); ++i) {
-        this->populations[i]->draw(painter, GLscale, viewX, viewY, width, height, this->popImage, style);
-    }
-    for (int i = 0; i < this->populations.size(); ++i) {
-        this->populations[i]->drawSynapses(painter, GLscale, viewX, viewY, width, height, style);
-    }
-    for (int i = 0; i < this->populations.size(); ++i) {
-        QPen pen(QColor(100,0,0,100));
-
-        QSettings settings;
-        float dpi = settings.value("dpi", "1").toFloat();
-        pen.setWidthF(float(1)/dpi);
-
-        painter->setPen(pen);
-        this->populations[i]->drawInputs(painter, GLscale, viewX, viewY, width, height, style);
+    // populations, projections and inputs
+    if (style == standardDrawStyle) {
+        this->drawCachedScene(painter, GLscale, viewX, viewY, width, height, style);
+    } else {
+        this->drawScene(painter, GLscale, viewX, viewY, width, height, style);
     }
 
     // selected object
@@ -479,8 +569,18 @@ void nl_rootdata::reDrawAll(QPainter *painter, float GLscale, float viewX, float
     painter->drawLine(QLineF(x-14.0f, y, x+14.0f, y));
 
     // update positions
+    bool moved = false;
     for (int i = 0; i < this->populations.size(); ++i) {
+        float x = this->populations[i]->x;
+        float y = this->populations[i]->y;
         this->populations[i]->animate(this->populations[i]);
+        if (this->populations[i]->x != x || this->populations[i]->y != y) {
+            moved = true;
+        }
+    }
+    // the view is only redrawn while something is moving
+    if (moved) {
+        emit redrawGLview();
     }
 
     // draw dragselect if present
@@ -509,6 +609,223 @@ void nl_rootdata::reDrawAll(QPainter *painter, float GLscale, float viewX, float
     }
 }
 
+void nl_rootdata::sceneChanged()
+{
+    this->sceneValid = false;
+    this->sceneCacheValid = false;
+}
+
+void nl_rootdata::rebuildScene()
+{
+    this->scene.clear();
+
+    // populations, then projections, then inputs, as each layer is drawn
+    // over the one before; within a layer the order is the model's
+    for (int i = 0; i < this->populations.size(); ++i) {
+        this->scene.add(sceneBounds(this->populations[i]), this->populations[i]);
+    }
+    for (int i = 0; i < this->populations.size(); ++i) {
+        for (int j = 0; j < this->populations[i]->projections.size(); ++j) {
+            QSharedPointer <projection> proj = this->populations[i]->projections[j];
+            this->scene.add(sceneBounds(proj), proj);
+        }
+    }
+    for (int i = 0; i < this->populations.size(); ++i) {
+        QSharedPointer <population> pop = this->populations[i];
+        for (int j = 0; j < pop->neuronType->inputs.size(); ++j) {
+            this->scene.add(sceneBounds(pop->neuronType->inputs[j]), pop->neuronType->inputs[j]);
+        }
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            if (proj->destination == (QSharedPointer <population>)0) {
+                continue;
+            }
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                for (int l = 0; l < proj->synapses[k]->weightUpdateCmpt->inputs.size(); ++l) {
+                    this->scene.add(sceneBounds(proj->synapses[k]->weightUpdateCmpt->inputs[l]), proj->synapses[k]->weightUpdateCmpt->inputs[l]);
+                }
+                for (int l = 0; l < proj->synapses[k]->postSynapseCmpt->inputs.size(); ++l) {
+                    this->scene.add(sceneBounds(proj->synapses[k]->postSynapseCmpt->inputs[l]), proj->synapses[k]->postSynapseCmpt->inputs[l]);
+                }
+            }
+        }
+    }
+
+    this->scene.build();
+
+    // clicks are resolved in a different order from drawing: for each
+    // population its inputs, then its projections each followed by their
+    // inputs, then the population itself
+    this->selectionRank.clear();
+    for (int i = 0; i < this->populations.size(); ++i) {
+        QSharedPointer <population> pop = this->populations[i];
+        for (int j = 0; j < pop->neuronType->inputs.size(); ++j) {
+            this->selectionRank.insert(pop->neuronType->inputs[j].data(), this->selectionRank.size());
+        }
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            this->selectionRank.insert(proj.data(), this->selectionRank.size());
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                for (int l = 0; l < proj->synapses[k]->weightUpdateCmpt->inputs.size(); ++l) {
+                    this->selectionRank.insert(proj->synapses[k]->weightUpdateCmpt->inputs[l].data(), this->selectionRank.size());
+                }
+                for (int l = 0; l < proj->synapses[k]->postSynapseCmpt->inputs.size(); ++l) {
+                    this->selectionRank.insert(proj->synapses[k]->postSynapseCmpt->inputs[l].data(), this->selectionRank.size());
+                }
+            }
+        }
+        this->selectionRank.insert(pop.data(), this->selectionRank.size());
+    }
+
+    this->hitPaths.clear();
+    this->sceneValid = true;
+}
+
+QVector <QSharedPointer<systemObject> > nl_rootdata::sceneObjectsIn(const QRectF &region)
+{
+    if (!this->sceneValid) {
+        this->rebuildScene();
+    }
+
+    QVector <int> found = this->scene.query(region);
+
+    // sort into selection order by rank
+    QMap <int, QSharedPointer<systemObject> > ranked;
+    for (int i = 0; i < found.size(); ++i) {
+        QSharedPointer <systemObject> obj = this->scene.object(found[i]);
+        ranked.insert(this->selectionRank.value(obj.data(), this->selectionRank.size()+i), obj);
+    }
+    return ranked.values().toVector();
+}
+
+bool nl_rootdata::curveIsClicked(QSharedPointer <projection> proj, float xGL, float yGL, float GLscale)
+{
+    // as projection::is_clicked, but the intersection path is kept until
+    // the scene changes
+    QHash <projection *, QPainterPath>::iterator it = this->hitPaths.find(proj.data());
+    if (it == this->hitPaths.end()) {
+        it = this->hitPaths.insert(proj.data(), proj->makeIntersectionLine(0, proj->curves.size()));
+    }
+    return it->intersects(QRectF(xGL-10.0/GLscale, yGL-10.0/GLscale, 20.0/GLscale, 20.0/GLscale));
+}
+
+QRectF nl_rootdata::curveBounds(QSharedPointer <projection> proj, float margin)
+{
+    // a bezier curve lies within the hull of its control points (QRectF's
+    // united() skips empty rects, so the extent is found by hand)
+    QPointF lo = proj->start;
+    QPointF hi = proj->start;
+    for (int i = 0; i < proj->curves.size(); ++i) {
+        QPointF points[3] = {proj->curves[i].C1, proj->curves[i].C2, proj->curves[i].end};
+        for (int p = 0; p < 3; ++p) {
+            lo.setX(qMin(lo.x(), points[p].x()));
+            lo.setY(qMin(lo.y(), points[p].y()));
+            hi.setX(qMax(hi.x(), points[p].x()));
+            hi.setY(qMax(hi.y(), points[p].y()));
+        }
+    }
+    return QRectF(lo, hi).adjusted(-margin, -margin, margin, margin);
+}
+
+QRectF nl_rootdata::sceneBounds(QSharedPointer <systemObject> object)
+{
+    switch (object->type) {
+    case populationObject:
+    {
+        QSharedPointer <population> pop = qSharedPointerDynamicCast <population> (object);
+        QRectF bounds(QPointF(pop->getLeft(), pop->getBottom()), QPointF(pop->getRight(), pop->getTop()));
+        // room for the spike source circle and the selection shadow
+        return bounds.normalized().adjusted(-0.5, -0.5, 0.5, 0.5);
+    }
+    case projectionObject:
+    {
+        // labels are placed off the curve, by up to about their width
+        QSharedPointer <projection> proj = qSharedPointerDynamicCast <projection> (object);
+        return curveBounds(proj, proj->showLabel ? 3.0 : 0.5);
+    }
+    case inputObject:
+        return curveBounds(qSharedPointerDynamicCast <projection> (object), 1.0);
+    default:
+        return QRectF();
+    }
+}
+
+void nl_rootdata::drawScene(QPainter *painter, float GLscale, float viewX, float viewY, int width, int height, drawStyle style)
+{
+    if (!this->sceneValid) {
+        this->rebuildScene();
+    }
+
+    // the model co-ordinates on screen, plus some pixels for pen widths
+    float pad = 40.0/GLscale;
+    QRectF view(QPointF(-float(width)/GLscale-viewX-pad, viewY-float(height)/GLscale-pad),
+                QPointF(float(width)/GLscale-viewX+pad, viewY+float(height)/GLscale+pad));
+    QVector <int> visible = this->scene.query(view);
+
+    QPen projectionPen(QColor(0,0,255,255));
+    projectionPen.setWidthF(1.5);
+#ifdef Q_OS_MAC
+    projectionPen.setWidthF(0.75);
+#endif
+
+    // so we could have an inherited class with this function
+    QImage ignored;
+
+    for (int i = 0; i < visible.size(); ++i) {
+        QSharedPointer <systemObject> obj = this->scene.object(visible[i]);
+        if (obj->type == populationObject) {
+            QSharedPointer <population> pop = qSharedPointerDynamicCast <population> (obj);
+            pop->draw(painter, GLscale, viewX, viewY, width, height, this->popImage, style);
+        } else if (obj->type == projectionObject) {
+            QSharedPointer <projection> proj = qSharedPointerDynamicCast <projection> (obj);
+            QPen oldPen = painter->pen();
+            painter->setPen(projectionPen);
+            proj->draw(painter, GLscale, viewX, viewY, width, height, ignored, style);
+            painter->setPen(oldPen);
+        } else if (obj->type == inputObject) {
+            QSharedPointer <genericInput> input = qSharedPointerDynamicCast <genericInput> (obj);
+            painter->setPen(QColor(0,210,0,255));
+            input->draw(painter, GLscale, viewX, viewY, width, height, ignored, style);
+        }
+    }
+    painter->setPen(QColor(0,0,0,255));
+}
+
+void nl_rootdata::drawCachedScene(QPainter *painter, float GLscale, float viewX, float viewY, int width, int height, drawStyle style)
+{
+    // The cache covers the view plus half a view on every side, drawn with
+    // the view's scale, so panning within that margin is only a blit.
+    float dx = (viewX-this->sceneCacheView.x())*GLscale/2.0;
+    float dy = (viewY-this->sceneCacheView.y())*GLscale/2.0;
+    QSize cacheSize(2*width, 2*height);
+
+    if (!this->sceneCacheValid || this->sceneCacheScale != GLscale || this->sceneCache.size() != cacheSize
+        || fabs(dx) > float(width)/2.0 || fabs(dy) > float(height)/2.0) {
+        if (this->sceneCache.size() != cacheSize) {
+            this->sceneCache = QPixmap(cacheSize);
+        }
+        this->sceneCache.fill(Qt::transparent);
+
+        QPainter cachePainter(&this->sceneCache);
+        cachePainter.setRenderHints(painter->renderHints());
+        cachePainter.setFont(painter->font());
+        cachePainter.setPen(painter->pen());
+        // drawing at twice the size about the same view centre offsets
+        // everything by half a view, which is the margin
+        this->drawScene(&cachePainter, GLscale, viewX, viewY, cacheSize.width(), cacheSize.height(), style);
+        cachePainter.end();
+
+        this->sceneCacheView = QPointF(viewX, viewY);
+        this->sceneCacheScale = GLscale;
+        this->sceneCacheValid = true;
+        dx = 0;
+        dy = 0;
+    }
+
+    painter->drawPixmap(QPointF(dx-float(width)/2.0, dy-float(height)/2.0), this->sceneCache);
+    painter->setPen(QColor(0,0,0,255));
+}
+
 void destroyDom(QDomNode &node)
 {
     QDomNodeList childList = node.childNodes();
@@ -552,107 +869,22 @@ void nl_rootdata::dragSelect(float xGL, float yGL)
         selList.clear();
     }
 
-    // add selected objects to list
-    for (int i = 0; i < this->populations.size(); ++i) {
-        QSharedPointer <population> pop = populations[i];
-
-        if (dragSelection.contains(pop->x, pop->y)) {
-            // if not already selected
-            bool alreadySelected = false;
-            for (int s = 0; s < this->selList.size(); ++s) {
-                if (selList[s] == pop) {
-                    alreadySelected = true;
-                }
-            }
-            if (!alreadySelected) {
-                selList.push_back(pop);
-            }
+    // add selected objects to list; anything inside the drag is in the index
+    // query, as its bounds contain the points tested
+    QVector <QSharedPointer<systemObject> > near = this->sceneObjectsIn(this->dragSelection);
+    for (int i = 0; i < near.size(); ++i) {
+        bool inside = false;
+        if (near[i]->type == populationObject) {
+            QSharedPointer <population> pop = qSharedPointerDynamicCast <population> (near[i]);
+            inside = dragSelection.contains(pop->x, pop->y);
+        } else if (near[i]->type == projectionObject || near[i]->type == inputObject) {
+            QSharedPointer <projection> proj = qSharedPointerDynamicCast <projection> (near[i]);
+            inside = proj->curves.size() > 0
+                && dragSelection.contains(proj->start) && dragSelection.contains(proj->curves.back().end);
         }
-
-        for (int j = 0; j < pop->neuronType->inputs.size(); ++j) {
-            QSharedPointer<genericInput> in = pop->neuronType->inputs[j];
-
-            if (in->curves.size() > 0) {
-                if (dragSelection.contains(in->start) && dragSelection.contains(in->curves.back().end)) {
-                    // if not already selected
-                    bool alreadySelected = false;
-                    for (int s = 0; s < this->selList.size(); ++s) {
-                        if (selList[s] == in) {
-                            alreadySelected = true;
-                        }
-                    }
-                    if (!alreadySelected) {
-                        selList.push_back(in);
-                    }
-                }
-            }
-        }
-
-        for (int j = 0; j < pop->projections.size(); ++j) {
-            QSharedPointer <projection> proj = pop->projections[j];
-
-            if (proj->curves.size() > 0) {
-                if (dragSelection.contains(proj->start) && dragSelection.contains(proj->curves.back().end)) {
-                    // if not already selected
-                    bool alreadySelected = false;
-                    for (int s = 0; s < this->selList.size(); ++s) {
-                        if (selList[s] == proj) {
-                            alreadySelected = true;
-                        }
-                    }
-                    if (!alreadySelected) {
-                        selList.push_back(proj);
-                    }
-                }
-            }
-
-            for (int pt = 0; pt < proj->synapses.size(); ++pt) {
-
-                QSharedPointer <synapse> projT = proj->synapses[pt];
-
-
-                // select generic inputs for weightupdate
-                for (int c = 0; c < projT->weightUpdateCmpt->inputs.size(); ++c) {
-
-                    QSharedPointer<genericInput> in = projT->weightUpdateCmpt->inputs[c];
-
-                    if (in->curves.size() > 0) {
-                        if (dragSelection.contains(in->start) && dragSelection.contains(in->curves.back().end)) {
-                            // if not already selected
-                            bool alreadySelected = false;
-                            for (int s = 0; s < this->selList.size(); ++s) {
-                                if (selList[s] == in) {
-                                    alreadySelected = true;
-                                }
-                            }
-                            if (!alreadySelected) {
-                                selList.push_back(in);
-                            }
-                        }
-                    }
-                }
-
-                // select generic inputs for postsynapse
-                for (int c = 0; c < projT->postSynapseCmpt->inputs.size(); ++c) {
-
-                    QSharedPointer<genericInput> in = projT->postSynapseCmpt->inputs[c];
-
-                    if (in->curves.size() > 0) {
-                        if (dragSelection.contains(in->start) && dragSelection.contains(in->curves.back().end)) {
-                            // if not already selected
-                            bool alreadySelected = false;
-                            for (int s = 0; s < this->selList.size(); ++s) {
-                                if (selList[s] == in) {
-                                    alreadySelected = true;
-                                }
-                            }
-                            if (!alreadySelected) {
-                                selList.push_back(in);
-                            }
-                        }
-                    }
-                }
-            }
+        // if not already selected
+        if (inside && !this->selList.contains(near[i])) {
+            selList.push_back(near[i]);
         }
     }
 
@@ -688,6 +920,11 @@ void rootData::onLeftMouseUp (float xGL, float yGL, float GLscale)
 
 void nl_rootdata::itemWasMoved()
 {
+    this->sceneChanged();
+
+    // the moves of all the selected items are one redraw
+    this->beginUndoGesture();
+
     if (!this->selList.empty()) {
         // We have a pointer(s) to the moved item(s). Check types to
         // see what to do with it/them.  If ANY object in selList is a
@@ -704,6 +941,8 @@ void nl_rootdata::itemWasMoved()
             this->projectionHandleMoved();
         }
     }
+
+    this->endUndoGesture();
 }
 
 void nl_rootdata::projectionHandleMoved()
@@ -732,8 +971,10 @@ void nl_rootdata::populationMoved(const QVector <QSharedPointer<population> >& p
 
     QVector <QSharedPointer<population> >::const_iterator popsi = pops.begin();
 
-    // A parent undocommand which will group together potentially multiple undos.
-    QUndoCommand* parentCmd = new QUndoCommand();
+    // A parent undocommand which will group together potentially
+    // multiple undos. A single move is pushed alone, so that it can
+    // merge with the next one.
+    QUndoCommand* parentCmd = pops.size() > 1 ? new QUndoCommand() : (QUndoCommand*)0;
 
     while (popsi != pops.end()) {
         // New position of the population, which it already has a record of.
@@ -744,17 +985,17 @@ void nl_rootdata::populationMoved(const QVector <QSharedPointer<population> >& p
         // the current offset in the population (as the population moves,
         // the mouse remains in the same location on the object).
         QPointF lastPopulationPosition = lastLeftMouseDownPos + (*popsi)->getLocationOffset();
-        new movePopulation(this, (*popsi), lastPopulationPosition, newPos, parentCmd);
+        QUndoCommand* moveCmd = new movePopulation(this, (*popsi), lastPopulationPosition, newPos, parentCmd);
+        if (parentCmd == (QUndoCommand*)0) {
+            this->currProject->undoStack->push(moveCmd);
+        }
         ++popsi;
     }
 
-    if (pops.size() > 1) {
+    if (parentCmd != (QUndoCommand*)0) {
         parentCmd->setText ("move populations");
-    } else {
-        parentCmd->setText ("move population");
+        this->currProject->undoStack->push(parentCmd);
     }
-
-    this->currProject->undoStack->push(parentCmd);
 }
 
 void nl_rootdata::onNewSelections (float xGL, float yGL)
@@ -912,67 +1153,25 @@ void nl_rootdata::onLeftMouseDown(float xGL, float yGL, float GLscale, bool shif
 
 void nl_rootdata::findSelection (float xGL, float yGL, float GLscale, QVector <QSharedPointer<systemObject> >& newlySelectedList)
 {
-    // Now look at populations and their inputs.
-    for (int i = 0; i < this->populations.size(); ++i) {
-
-        // check population inputs:
-        for (int j = 0; j < this->populations[i]->neuronType->inputs.size(); ++j) {
-            // find if an edge of the input is hit
-            if (this->populations[i]->neuronType->inputs[j]->is_clicked(xGL, yGL, GLscale)) {
-                // add the input to the selection list
-                newlySelectedList.push_back(this->populations[i]->neuronType->inputs[j]);
-                // selection complete, move on
-                return;
-            }
-        } // for loop checking population inputs
-
-        // check projections
-        for (int j = 0; j < this->populations[i]->projections.size(); ++j) {
-
-            // find if an edge of the projection is hit
-            if (this->populations[i]->projections[j]->is_clicked(xGL, yGL, GLscale)) {
-                // add to selection list
-                newlySelectedList.push_back(this->populations[i]->projections[j]);
-                // selection complete, move on
-                return;
-            }
-
-            // check proj inputs:
-            for (int k = 0; k < this->populations[i]->projections[j]->synapses.size(); ++k) {
-
-                QSharedPointer <synapse> col = this->populations[i]->projections[j]->synapses[k];
-
-                for (int l = 0; l < col->weightUpdateCmpt->inputs.size(); ++l) {
-
-                    // find if an edge of the input is hit
-                    if (col->weightUpdateCmpt->inputs[l]->is_clicked(xGL, yGL, GLscale)) {
-                        //  add to selection list
-                        newlySelectedList.push_back(col->weightUpdateCmpt->inputs[l]);
-                        // selection complete, move on
-                        return;
-                    }
-                }
-
-                for (int l = 0; l < col->postSynapseCmpt->inputs.size(); ++l) {
-                    // find if an edge of the input is hit
-                    if (col->postSynapseCmpt->inputs[l]->is_clicked(xGL, yGL, GLscale)) {
-                        //  add to selection list
-                        newlySelectedList.push_back(col->postSynapseCmpt->inputs[l]);
-                        // selection complete, move on
-                        return;
-                    }
-                }
-            } // for loop checking projection inputs.
-        } // for-loop over projections
-
-        // select if under the cursor - no two objects should overlap!
-        if (this->populations[i]->is_clicked(xGL, yGL, GLscale)) {
-            //  add to selection list
-            newlySelectedList.push_back(this->populations[i]);
-            // selection complete, move on
+    // only the objects whose bounds are near the cursor need testing
+    float pad = 10.0/GLscale;
+    QVector <QSharedPointer<systemObject> > near = this->sceneObjectsIn(QRectF(xGL-pad, yGL-pad, 2*pad, 2*pad));
+
+    for (int i = 0; i < near.size(); ++i) {
+        bool clicked = false;
+        if (near[i]->type == populationObject) {
+            // select if under the cursor - no two objects should overlap!
+            clicked = near[i]->is_clicked(xGL, yGL, GLscale);
+        } else if (near[i]->type == projectionObject || near[i]->type == inputObject) {
+            // find if an edge of the projection or input is hit
+            clicked = this->curveIsClicked(qSharedPointerDynamicCast <projection> (near[i]), xGL, yGL, GLscale);
+        }
+        if (clicked) {
+            // add to selection list, selection complete
+            newlySelectedList.push_back(near[i]);
             return;
         }
-    } // for-loop over populations
+    }
 }
 
 QColor nl_rootdata::getColor(QColor initCol)
@@ -1053,6 +1252,8 @@ void nl_rootdata::addSpikeSource()
 
 void nl_rootdata::addBezierOrProjection(float xGL, float yGL)
 {
+    this->sceneChanged();
+
     if (this->selList.size() == 1) {
         if (this->selList[0]->type == projectionObject) {
 
@@ -1103,6 +1304,8 @@ void nl_rootdata::addBezierOrProjection(float xGL, float yGL)
 
 void nl_rootdata::startAddBezier(float xGL, float yGL)
 {
+    this->sceneChanged();
+
     if (this->selList.size() == 1) {
         if (this->selList[0]->type == populationObject) {
 
@@ -1204,6 +1407,8 @@ void nl_rootdata::startAddBezier(float xGL, float yGL)
 
 void nl_rootdata::abortProjection()
 {
+    this->sceneChanged();
+
     // the new projection should be the only one in the selList, but may not be...
     if (selList[0]->type == projectionObject) {
         QSharedPointer <projection> proj = qSharedPointerDynamicCast <projection> (this->selList[0]);
@@ -1250,13 +1455,19 @@ void nl_rootdata::mouseMoveGL(float xGL, float yGL)
             bool collision = false;
             QSharedPointer <population> pop = qSharedPointerDynamicCast <population> (selList[0]);
 
-            // avoid collisions
-            for (int i = 0; i < populations.size(); ++i) {
-                if (populations[i]->getName() != pop->getName()) {
-                    if (populations[i]->within_bounds(pop->leftBound(xGL)+0.01, pop->topBound(yGL)-0.01)) collision = true;
-                    if (populations[i]->within_bounds(pop->rightBound(xGL)-0.01, pop->topBound(yGL)-0.01)) collision = true;
-                    if (populations[i]->within_bounds(pop->leftBound(xGL)+0.01, pop->bottomBound(yGL)+0.01)) collision = true;
-                    if (populations[i]->within_bounds(pop->rightBound(xGL)-0.01, pop->bottomBound(yGL)+0.01)) collision = true;
+            // avoid collisions with the populations near the new position
+            QVector <QSharedPointer<systemObject> > near = this->sceneObjectsIn(QRectF(QPointF(pop->leftBound(xGL), pop->bottomBound(yGL)),
+                                                                                       QPointF(pop->rightBound(xGL), pop->topBound(yGL))));
+            for (int i = 0; i < near.size(); ++i) {
+                if (near[i]->type != populationObject) {
+                    continue;
+                }
+                QSharedPointer <population> other = qSharedPointerDynamicCast <population> (near[i]);
+                if (other->getName() != pop->getName()) {
+                    if (other->within_bounds(pop->leftBound(xGL)+0.01, pop->topBound(yGL)-0.01)) collision = true;
+                    if (other->within_bounds(pop->rightBound(xGL)-0.01, pop->topBound(yGL)-0.01)) collision = true;
+                    if (other->within_bounds(pop->leftBound(xGL)+0.01, pop->bottomBound(yGL)+0.01)) collision = true;
+                    if (other->within_bounds(pop->rightBound(xGL)-0.01, pop->bottomBound(yGL)+0.01)) collision = true;
                 }
             }
 
@@ -1282,6 +1493,8 @@ void nl_rootdata::mouseMoveGL(float xGL, float yGL)
             in->moveSelectedControlPoint(xGL, yGL);
         }
     }
+
+    this->sceneChanged();
 }
 
 void nl_rootdata::updatePortMap(QString var)
@@ -1712,7 +1925,7 @@ void nl_rootdata::renamePopulation()
     // update name (undo-able)
     if (finalName != currSel->name) {
         titleLabel->setText("<u><b>" + finalName + "</b></u>");
-        this->currProject->undoStack->push(new updateTitle(currSel, finalName, currSel->name));
+        this->currProject->undoStack->push(new updateTitle(this, currSel, finalName, currSel->name));
     }
 
     // redraw view
@@ -1945,7 +2158,14 @@ void nl_rootdata::getNeuronLocationsSrc(QVector <QVector <loc> > *locations,QVec
                     }
                     locations->clear();
 
-                    // generate src and dst locations:
+                    // generate src and dst locations, the destination's on
+                    // the thread pool while the source's are made here
+                    QSharedPointer <population> dstPop = this->populations[ind]->projections[cInd]->destination;
+                    QSharedPointer <layoutJob> dstJob;
+                    if (dstPop->layoutType->component->name != "none") {
+                        dstJob = layoutJob::create(dstPop->layoutType, dstPop->numNeurons);
+                        layoutJob::startInBackground(QVector <QSharedPointer <layoutJob> > () << dstJob);
+                    }
                     // SOURCE
                     QString err = "";
                     locations->resize(2);
@@ -1971,8 +2191,8 @@ void nl_rootdata::getNeuronLocationsSrc(QVector <QVector <loc> > *locations,QVec
                     }
 
                     // DESTINATION
-                    if (this->populations[ind]->projections[cInd]->destination->layoutType->component->name != "none") {
-                        this->populations[ind]->projections[cInd]->destination->layoutType->generateLayout(this->populations[ind]->projections[cInd]->destination->numNeurons, &((*locations)[1]), err);
+                    if (!dstJob.isNull()) {
+                        dstJob->collect(&((*locations)[1]), err);
                         cols->push_back(this->populations[ind]->projections[cInd]->destination->colour);
                     } else {
                         // linear layout by default:
@@ -2003,127 +2223,270 @@ void nl_rootdata::getNeuronLocationsSrc(QVector <QVector <loc> > *locations,QVec
 
 QSharedPointer<systemObject> nl_rootdata::getObjectFromName(QString name)
 {
-    QSharedPointer<systemObject> currObject = (QSharedPointer<systemObject>)0;
-
     // find the pop / projection that is being displayed
-    for (int i = 0; i < this->populations.size(); ++i) {
-        if (this->populations[i]->getName() == name) {
-            currObject = this->populations[i];
-            break;
-        }
-        for (int j = 0; j < this->populations[i]->projections.size(); ++j) {
-            if (this->populations[i]->projections[j]->getName() == name) {
-                currObject = this->populations[i]->projections[j];
-                break;
-            }
-        }
+    this->updateRegistry();
+    QHash <QString, modelPath>::const_iterator it = this->nameRegistry.constFind(name);
+    if (it == this->nameRegistry.constEnd()) {
+        return (QSharedPointer<systemObject>)0;
+    }
+    QSharedPointer<systemObject> currObject = this->systemObjectAt(*it);
+    if (currObject && currObject->getName() == name) {
+        return currObject;
     }
 
-    return currObject;
+    this->rebuildRegistry();
+    it = this->nameRegistry.constFind(name);
+    if (it != this->nameRegistry.constEnd()) {
+        return this->systemObjectAt(*it);
+    }
+    return (QSharedPointer<systemObject>)0;
 }
 
 QSharedPointer<systemObject> nl_rootdata::isValidPointer(systemObject * ptr)
 {
     // find the pop / projection / input reference
-    for (int i = 0; i < this->populations.size(); ++i) {
+    QSharedPointer<systemObject> null;
+    this->updateRegistry();
+    QHash <systemObject *, modelPath>::const_iterator it = this->systemObjectRegistry.constFind(ptr);
+    if (it == this->systemObjectRegistry.constEnd()) {
+        return null;
+    }
+    QSharedPointer<systemObject> found = this->systemObjectAt(*it);
+    if (found.data() == ptr) {
+        return found;
+    }
 
-        if (this->populations[i].data() == ptr) {
-            return this->populations[i];
-        }
+    this->rebuildRegistry();
+    it = this->systemObjectRegistry.constFind(ptr);
+    if (it != this->systemObjectRegistry.constEnd()) {
+        return this->systemObjectAt(*it);
+    }
 
-        for (int j = 0; j < this->populations[i]->neuronType->inputs.size(); ++j)
-            if (this->populations[i]->neuronType->inputs[j].data() == ptr) {
-                return this->populations[i]->neuronType->inputs[j];
-            }
+    // not found
+    return null;
+}
 
-        for (int j = 0; j < this->populations[i]->projections.size(); ++j) {
+// allow safe usage of NineMLComponentData pointers
+QSharedPointer<ComponentInstance> nl_rootdata::isValidPointer(ComponentInstance * ptr)
+{
+    // find the reference
+    QSharedPointer<ComponentInstance> null;
+    this->updateRegistry();
+    QHash <ComponentInstance *, modelPath>::const_iterator it = this->componentInstanceRegistry.constFind(ptr);
+    if (it == this->componentInstanceRegistry.constEnd()) {
+        return null;
+    }
+    QSharedPointer<ComponentInstance> found = this->componentInstanceAt(*it);
+    if (found.data() == ptr) {
+        return found;
+    }
 
-            if (this->populations[i]->projections[j].data() == ptr) {
-                return this->populations[i]->projections[j];
-            }
+    this->rebuildRegistry();
+    it = this->componentInstanceRegistry.constFind(ptr);
+    if (it != this->componentInstanceRegistry.constEnd()) {
+        return this->componentInstanceAt(*it);
+    }
 
-            for (int k = 0; k < this->populations[i]->projections[j]->synapses.size(); ++k) {
-                if (this->populations[i]->projections[j]->synapses[k].data() == ptr) {
-                    return this->populations[i]->projections[j]->synapses[k];
-                }
-                for (int l = 0; l < this->populations[i]->projections[j]->synapses[k]->weightUpdateCmpt->inputs.size(); ++l) {
-                    if (this->populations[i]->projections[j]->synapses[k]->weightUpdateCmpt->inputs[l].data() == ptr) {
-                        return this->populations[i]->projections[j]->synapses[k]->weightUpdateCmpt->inputs[l];
-                    }
-                }
+    // not found
+    return null;
+}
 
-                for (int l = 0; l < this->populations[i]->projections[j]->synapses[k]->postSynapseCmpt->inputs.size(); ++l) {
-                    if (this->populations[i]->projections[j]->synapses[k]->postSynapseCmpt->inputs[l].data() == ptr) {
-                        return this->populations[i]->projections[j]->synapses[k]->postSynapseCmpt->inputs[l];
-                    }
-                }
-            }
-        }
+// allow safe usage of NineMLComponent pointers
+QSharedPointer<Component> nl_rootdata::isValidPointer(Component * ptr)
+{
+    QSharedPointer<Component> null;
+    this->updateRegistry();
+    QHash <Component *, modelPath>::const_iterator it = this->componentRegistry.constFind(ptr);
+    if (it == this->componentRegistry.constEnd()) {
+        return null;
+    }
+    QSharedPointer<Component> found = this->componentAt(*it);
+    if (found.data() == ptr) {
+        return found;
+    }
+
+    this->rebuildRegistry();
+    it = this->componentRegistry.constFind(ptr);
+    if (it != this->componentRegistry.constEnd()) {
+        return this->componentAt(*it);
     }
 
     // not found
-    QSharedPointer<systemObject> null;
     return null;
 }
 
-// allow safe usage of NineMLComponentData pointers
-QSharedPointer<ComponentInstance> nl_rootdata::isValidPointer(ComponentInstance * ptr)
+void nl_rootdata::updateRegistry()
 {
-    // find the reference
+    // without a project nothing tells us when the network changes
+    if (!this->registryValid || this->currProject == (projectObject *) 0 || this->registryProject != this->currProject
+        || this->registryGeneration != this->currProject->modelGeneration) {
+        this->rebuildRegistry();
+    }
+}
+
+void nl_rootdata::rebuildRegistry()
+{
+    // the network has changed under the registry, so maybe under the
+    // routing index too
+    this->invalidateRouting();
+    this->registryProject = this->currProject;
+    this->registryGeneration = this->currProject ? this->currProject->modelGeneration : 0;
+    this->registryValid = true;
+    this->systemObjectRegistry.clear();
+    this->componentInstanceRegistry.clear();
+    this->componentRegistry.clear();
+    this->nameRegistry.clear();
+
+    // where an object appears twice the first place found is kept, which is
+    // the one the original linear searches returned
     for (int i = 0; i < this->populations.size(); ++i) {
+        QSharedPointer <population> pop = this->populations[i];
+        if (!this->systemObjectRegistry.contains(pop.data())) {
+            this->systemObjectRegistry.insert(pop.data(), modelPath(modelPath::Population, i));
+        }
+        if (!this->nameRegistry.contains(pop->getName())) {
+            this->nameRegistry.insert(pop->getName(), modelPath(modelPath::Population, i));
+        }
+        if (!this->componentInstanceRegistry.contains(pop->neuronType.data())) {
+            this->componentInstanceRegistry.insert(pop->neuronType.data(), modelPath(modelPath::NeuronBody, i));
+        }
 
-        if (this->populations[i]->neuronType.data() == ptr) {
-            return this->populations[i]->neuronType;
+        for (int j = 0; j < pop->neuronType->inputs.size(); ++j) {
+            if (!this->systemObjectRegistry.contains(pop->neuronType->inputs[j].data())) {
+                this->systemObjectRegistry.insert(pop->neuronType->inputs[j].data(), modelPath(modelPath::PopulationInput, i, j));
+            }
         }
 
-        for (int j = 0; j < this->populations[i]->projections.size(); ++j) {
-            for (int k = 0; k < this->populations[i]->projections[j]->synapses.size(); ++k) {
-                if (this->populations[i]->projections[j]->synapses[k]->weightUpdateCmpt.data() == ptr) {
-                    return this->populations[i]->projections[j]->synapses[k]->weightUpdateCmpt;
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            QSharedPointer <projection> proj = pop->projections[j];
+            if (!this->systemObjectRegistry.contains(proj.data())) {
+                this->systemObjectRegistry.insert(proj.data(), modelPath(modelPath::Projection, i, j));
+            }
+            if (!this->nameRegistry.contains(proj->getName())) {
+                this->nameRegistry.insert(proj->getName(), modelPath(modelPath::Projection, i, j));
+            }
+
+            for (int k = 0; k < proj->synapses.size(); ++k) {
+                QSharedPointer <synapse> syn = proj->synapses[k];
+                if (!this->systemObjectRegistry.contains(syn.data())) {
+                    this->systemObjectRegistry.insert(syn.data(), modelPath(modelPath::Synapse, i, j, k));
+                }
+                if (!this->componentInstanceRegistry.contains(syn->weightUpdateCmpt.data())) {
+                    this->componentInstanceRegistry.insert(syn->weightUpdateCmpt.data(), modelPath(modelPath::WeightUpdate, i, j, k));
+                }
+                if (!this->componentInstanceRegistry.contains(syn->postSynapseCmpt.data())) {
+                    this->componentInstanceRegistry.insert(syn->postSynapseCmpt.data(), modelPath(modelPath::PostSynapse, i, j, k));
                 }
-                if (this->populations[i]->projections[j]->synapses[k]->postSynapseCmpt.data() == ptr) {
-                    return this->populations[i]->projections[j]->synapses[k]->postSynapseCmpt;
+                for (int l = 0; l < syn->weightUpdateCmpt->inputs.size(); ++l) {
+                    if (!this->systemObjectRegistry.contains(syn->weightUpdateCmpt->inputs[l].data())) {
+                        this->systemObjectRegistry.insert(syn->weightUpdateCmpt->inputs[l].data(), modelPath(modelPath::WeightUpdateInput, i, j, k, l));
+                    }
+                }
+                for (int l = 0; l < syn->postSynapseCmpt->inputs.size(); ++l) {
+                    if (!this->systemObjectRegistry.contains(syn->postSynapseCmpt->inputs[l].data())) {
+                        this->systemObjectRegistry.insert(syn->postSynapseCmpt->inputs[l].data(), modelPath(modelPath::PostSynapseInput, i, j, k, l));
+                    }
                 }
             }
         }
     }
 
-    // not found
-    QSharedPointer<ComponentInstance> null;
-    return null;
+    const QVector < QSharedPointer<Component> > * catalogs[4] = {&this->catalogNrn, &this->catalogPS, &this->catalogUnsorted, &this->catalogWU};
+    const modelPath::kind catalogKinds[4] = {modelPath::CatalogNrn, modelPath::CatalogPS, modelPath::CatalogUnsorted, modelPath::CatalogWU};
+    for (int c = 0; c < 4; ++c) {
+        for (int i = 0; i < catalogs[c]->size(); ++i) {
+            Component * comp = (*catalogs[c])[i].data();
+            if (!this->componentRegistry.contains(comp)) {
+                this->componentRegistry.insert(comp, modelPath(catalogKinds[c], i));
+            }
+        }
+    }
 }
 
-// allow safe usage of NineMLComponent pointers
-QSharedPointer<Component> nl_rootdata::isValidPointer(Component * ptr)
+QSharedPointer<systemObject> nl_rootdata::systemObjectAt(const modelPath &path)
 {
-    for (int i = 0; i < this->catalogNrn.size(); ++i) {
-        //DBG() << catalogNrn[i].data();
-        if (catalogNrn[i] == ptr) {
-            return catalogNrn[i];
-        }
+    QSharedPointer<systemObject> null;
+    if (path.i < 0 || path.i >= this->populations.size()) {
+        return null;
     }
-    for (int i = 0; i < this->catalogPS.size(); ++i) {
-        //DBG() << catalogPS[i].data();
-        if (catalogPS[i]  == ptr) {
-            return catalogPS[i];
-        }
+    QSharedPointer <population> pop = this->populations[path.i];
+    if (path.type == modelPath::Population) {
+        return pop;
     }
-    for (int i = 0; i < this->catalogUnsorted.size(); ++i) {
-        //DBG() << catalogUnsorted[i].data();
-        if (catalogUnsorted[i]  == ptr) {
-            return catalogUnsorted[i];
+    if (path.type == modelPath::PopulationInput) {
+        if (path.j < 0 || path.j >= pop->neuronType->inputs.size()) {
+            return null;
         }
+        return pop->neuronType->inputs[path.j];
+    }
+    if (path.j < 0 || path.j >= pop->projections.size()) {
+        return null;
     }
-    for (int i = 0; i < this->catalogWU.size(); ++i) {
-        //DBG() << catalogWU[i].data();
-        if (catalogWU[i] == ptr) {
-            return catalogWU[i];
+    QSharedPointer <projection> proj = pop->projections[path.j];
+    if (path.type == modelPath::Projection) {
+        return proj;
+    }
+    if (path.k < 0 || path.k >= proj->synapses.size()) {
+        return null;
+    }
+    QSharedPointer <synapse> syn = proj->synapses[path.k];
+    switch (path.type) {
+    case modelPath::Synapse:
+        return syn;
+    case modelPath::WeightUpdateInput:
+        if (path.l < 0 || path.l >= syn->weightUpdateCmpt->inputs.size()) {
+            return null;
+        }
+        return syn->weightUpdateCmpt->inputs[path.l];
+    case modelPath::PostSynapseInput:
+        if (path.l < 0 || path.l >= syn->postSynapseCmpt->inputs.size()) {
+            return null;
         }
+        return syn->postSynapseCmpt->inputs[path.l];
+    default:
+        return null;
     }
+}
 
-    // not found
-    QSharedPointer<Component> null;
-    return null;
+QSharedPointer<ComponentInstance> nl_rootdata::componentInstanceAt(const modelPath &path)
+{
+    QSharedPointer<ComponentInstance> null;
+    if (path.i < 0 || path.i >= this->populations.size()) {
+        return null;
+    }
+    QSharedPointer <population> pop = this->populations[path.i];
+    if (path.type == modelPath::NeuronBody) {
+        return pop->neuronType;
+    }
+    if (path.j < 0 || path.j >= pop->projections.size()
+        || path.k < 0 || path.k >= pop->projections[path.j]->synapses.size()) {
+        return null;
+    }
+    QSharedPointer <synapse> syn = pop->projections[path.j]->synapses[path.k];
+    switch (path.type) {
+    case modelPath::WeightUpdate:
+        return syn->weightUpdateCmpt;
+    case modelPath::PostSynapse:
+        return syn->postSynapseCmpt;
+    default:
+        return null;
+    }
+}
+
+QSharedPointer<Component> nl_rootdata::componentAt(const modelPath &path)
+{
+    const QVector < QSharedPointer<Component> > * catalog;
+    switch (path.type) {
+    case modelPath::CatalogNrn: catalog = &this->catalogNrn; break;
+    case modelPath::CatalogPS: catalog = &this->catalogPS; break;
+    case modelPath::CatalogUnsorted: catalog = &this->catalogUnsorted; break;
+    case modelPath::CatalogWU: catalog = &this->catalogWU; break;
+    default: return QSharedPointer<Component>();
+    }
+    if (path.i < 0 || path.i >= catalog->size()) {
+        return QSharedPointer<Component>();
+    }
+    return (*catalog)[path.i];
 }
 
 void nl_rootdata::setSelectionbyName(QString name)
@@ -2290,6 +2653,11 @@ void nl_rootdata::copyParsToClipboard()
                 clipboardCData = QSharedPointer<ComponentInstance> (new ComponentInstance(proj->synapses[proj->currTarg]->postSynapseCmpt));
             }
         }
+
+        // and on the system clipboard, for other SpineCreators
+        if (!clipboardCData.isNull()) {
+            propertyClipboard::copy(clipboardCData);
+        }
     }
     this->reDrawAll();
 }
@@ -2299,11 +2667,13 @@ void nl_rootdata::pasteParsFromClipboard()
     // safety
     if (selList.size() == 1) {
 
+        QSharedPointer <ComponentInstance> dest;
+
         // if population
         if (selList[0]->type == populationObject) {
             if (sender()->property("source").toString() == "tab1") {
                 QSharedPointer <population> pop = qSharedPointerDynamicCast<population> (selList[0]);
-                this->currProject->undoStack->push(new pastePars(this,clipboardCData,pop->neuronType));
+                dest = pop->neuronType;
             }
         }
 
@@ -2311,12 +2681,27 @@ void nl_rootdata::pasteParsFromClipboard()
         if (selList[0]->type == projectionObject) {
             QSharedPointer <projection> proj = qSharedPointerDynamicCast<projection> (selList[0]);
             if (sender()->property("source").toString() == "tab1") {
-                this->currProject->undoStack->push(new pastePars(this,clipboardCData,(proj->synapses[proj->currTarg]->weightUpdateCmpt)));
+                dest = proj->synapses[proj->currTarg]->weightUpdateCmpt;
             }
             if (sender()->property("source").toString() == "tab2") {
-                this->currProject->undoStack->push(new pastePars(this,clipboardCData,(proj->synapses[proj->currTarg]->postSynapseCmpt)));
+                dest = proj->synapses[proj->currTarg]->postSynapseCmpt;
             }
         }
+
+        if (dest.isNull()) {
+            return;
+        }
+
+        // Properties copied in another SpineCreator come from the system
+        // clipboard, and otherwise from our own copy
+        QSharedPointer <ComponentInstance> source = clipboardCData;
+        if (propertyClipboard::hasForeignData()) {
+            source = propertyClipboard::paste(dest);
+        }
+        if (source.isNull()) {
+            return;
+        }
+        this->currProject->undoStack->push(new pastePars(this,source,dest));
     }
 }
 
@@ -36,6 +36,7 @@
 #include "SC_network_3d_visualiser_panel.h"
 #include "NL_systemobject.h"
 #include "SC_valuelistdialog.h"
+#include "SC_network_2d_sceneindex.h"
 
 struct selStruct {
     int type;
@@ -49,6 +50,34 @@ struct loadedComponent {
     QString url;
 };
 
+/*!
+ * Where an object sits in the model: its kind and its indices in the
+ * nested containers (population i, projection or input j, synapse k,
+ * input l). An entry in the nl_rootdata registry is checked by looking
+ * the path up again, which takes constant time whatever the model size.
+ */
+struct modelPath {
+    enum kind {
+        Population, PopulationInput, Projection, Synapse, WeightUpdateInput, PostSynapseInput,
+        NeuronBody, WeightUpdate, PostSynapse,
+        CatalogNrn, CatalogPS, CatalogUnsorted, CatalogWU
+    };
+    modelPath() : type(Population), i(-1), j(-1), k(-1), l(-1) {}
+    modelPath(kind type, int i, int j = -1, int k = -1, int l = -1) : type(type), i(i), j(j), k(k), l(l) {}
+    kind type;
+    int i;
+    int j;
+    int k;
+    int l;
+};
+
+// redraws which undo commands put off while an undo gesture is open
+enum undoRedraw {
+    UNDO_REDRAW_VIEWS = 1,
+    UNDO_REDRAW_PANEL = 2,
+    UNDO_REDRAW_PROJECTIONS = 4
+};
+
 class nl_rootdata : public QObject
 {
     Q_OBJECT
@@ -70,11 +99,50 @@ public:
     ComponentRootObject* import_component_xml_single(QString fileName);
     bool isComponentInUse(QSharedPointer<Component> oldComp);
     bool removeComponent(QSharedPointer<Component> oldComp);
+    /*!
+     * Drop the routing index and the object registry, after the network
+     * has been changed other than through the project's undo stack.
+     */
+    void invalidateRouting();
     QSharedPointer<systemObject> isValidPointer(systemObject *ptr);
     QSharedPointer<ComponentInstance> isValidPointer(ComponentInstance *ptr);
     QSharedPointer<Component> isValidPointer(Component *ptr);
     void redrawViews();
 
+    /*!
+     * Open an undo gesture. Until endUndoGesture(), commands which edit
+     * the same thing are merged into one undo step, and the redraws they
+     * ask for are made once when the gesture ends.
+     */
+    void beginUndoGesture();
+
+    /*!
+     * The number of the open undo gesture, or -1 if none is open. Commands
+     * made in the same gesture merge.
+     */
+    int undoGesture();
+
+    /*!
+     * Called by an undo command in place of the redraws in the undoRedraw
+     * flags; returns true if they have been put off until the open gesture
+     * ends, in which case the command should not redraw.
+     */
+    bool deferUndoRedraw(int redraws);
+
+    /*!
+     * Called by undo commands which add, remove or rename what the
+     * visualiser's tree shows. The tree and the visualiser are brought up
+     * to date once control returns to the event loop, for however many
+     * commands called this.
+     */
+    void systemModelChanged();
+
+    /*!
+     * Spin boxes with this as an event filter open an undo gesture while
+     * they are pressed or their step keys are held.
+     */
+    bool eventFilter(QObject * obj, QEvent * event);
+
     /*!
      * Return true if the passed in experiment pointer is found in any
      * of the experiments either in the current nl_rootdata instance,
@@ -133,6 +201,12 @@ public:
     QSharedPointer <projection> currentlySelectedProjection;
     //@}
 
+    /*!
+     * The region of the model drawn by a population, projection or input,
+     * as held in the scene index, or a null rect for any other object.
+     */
+    static QRectF sceneBounds(QSharedPointer <systemObject> object);
+
 signals:
     void undoRenameBox();
     void finishDrawingSynapse();
@@ -191,6 +265,8 @@ public slots:
     void setCaptionOut(QString);
     void setModelTitle(QString);
     void undoOrRedoPerformed(int);
+    void endUndoGesture();
+    void updateSystemModel();
     void abortProjection();
     void updatePanelView2Accessor();
     /*!
@@ -223,6 +299,13 @@ public slots:
 
     void reDrawAll();
 
+    /*!
+     * Mark the drawn model as changed, so the scene index and the cached
+     * drawing are rebuilt on the next paint. reDrawAll() and redrawGLview()
+     * both do this.
+     */
+    void sceneChanged();
+
     void updateDrawStyle();
 
 private:
@@ -311,6 +394,98 @@ private:
      * at the end of the object movement).
      */
     QPointF lastLeftMouseDownPos;
+
+    // the open undo gesture, and the redraws put off until it ends
+    bool undoGestureOpen;
+    int undoGestureCount;
+    int undoGestureRedraws;
+
+    // an updateSystemModel() is queued
+    bool systemModelQueued;
+
+    /*!
+     * \brief The object registry used by isValidPointer and
+     * getObjectFromName.
+     *
+     * Like the routing index, it is rebuilt when first needed after the
+     * project's modelGeneration moves on, another project is selected or
+     * invalidateRouting() is called, and a miss is simply a miss. An entry
+     * whose object is no longer at the recorded path shows the model was
+     * changed some other way, and rebuilds it.
+     */
+    //@{
+    QHash <systemObject *, modelPath> systemObjectRegistry;
+    QHash <ComponentInstance *, modelPath> componentInstanceRegistry;
+    QHash <Component *, modelPath> componentRegistry;
+    QHash <QString, modelPath> nameRegistry;
+    projectObject * registryProject;
+    quint64 registryGeneration;
+    bool registryValid;
+    void updateRegistry();
+    void rebuildRegistry();
+    QSharedPointer<systemObject> systemObjectAt(const modelPath &path);
+    QSharedPointer<ComponentInstance> componentInstanceAt(const modelPath &path);
+    QSharedPointer<Component> componentAt(const modelPath &path);
+    //@}
+
+    /*!
+     * \brief The routing index: the component instances which use each
+     * component, with the type of component each of their places takes.
+     *
+     * replaceComponent and isComponentInUse look the component up here
+     * rather than searching every population, projection and synapse.
+     * The index is built when first needed, and kept until the project's
+     * modelGeneration moves on (or another project is selected), so it
+     * follows every command on the project's undo stack.
+     */
+    //@{
+    struct componentUse {
+        QSharedPointer <ComponentInstance> instance;
+        QString type;
+    };
+    QHash <Component *, QVector <componentUse> > componentUsers;
+    projectObject * routingProject;
+    quint64 routingGeneration;
+    bool routingValid;
+    const QVector <componentUse> & usersOf(QSharedPointer<Component> comp);
+    //@}
+
+    /*!
+     * \brief The drawn populations, projections and inputs, indexed by
+     * their bounds so only those in view are drawn.
+     *
+     * For the standard style the drawing is kept in sceneCache, which is
+     * redrawn when the scale or size changes, when the view pans beyond
+     * its margin, or after sceneChanged(). Selection shadows, handles and
+     * the cursor are still drawn on every paint.
+     */
+    //@{
+    sceneIndex scene;
+    bool sceneValid;
+    QPixmap sceneCache;
+    bool sceneCacheValid;
+    float sceneCacheScale;
+    QPointF sceneCacheView;
+    void rebuildScene();
+    static QRectF curveBounds(QSharedPointer <projection> proj, float margin);
+    void drawScene(QPainter *painter, float GLscale, float viewX, float viewY, int width, int height, drawStyle style);
+    void drawCachedScene(QPainter *painter, float GLscale, float viewX, float viewY, int width, int height, drawStyle style);
+    //@}
+
+    /*!
+     * \brief Hit-testing through the scene index.
+     *
+     * sceneObjectsIn returns the objects whose bounds meet region, in the
+     * order findSelection gives them priority (selectionRank).
+     * curveIsClicked is projection::is_clicked with the intersection path
+     * kept in hitPaths until the scene changes.
+     */
+    //@{
+    QHash <systemObject *, int> selectionRank;
+    QHash <projection *, QPainterPath> hitPaths;
+    QVector <QSharedPointer<systemObject> > sceneObjectsIn(const QRectF &region);
+    bool curveIsClicked(QSharedPointer <projection> proj, float xGL, float yGL, float GLscale);
+    //@}
 };
 
 #endif // ROOTDATA_H
@@ -33,6 +33,87 @@
  them to be set and modified.
  */
 
+namespace {
+
+    // keys are compared whole, so each part is terminated
+    void keyString(QByteArray &key, const QString &s)
+    {
+        key += s.toUtf8();
+        key += '\0';
+    }
+
+    void keyPointer(QByteArray &key, const void * p)
+    {
+        key += QByteArray::number((qulonglong) (quintptr) p, 16);
+        key += '\0';
+    }
+
+    void keyNumber(QByteArray &key, int n)
+    {
+        key += QByteArray::number(n);
+        key += '\0';
+    }
+
+    // as drawParamsLayout, which does not draw some of the layout properties
+    bool drawnParameter(QSharedPointer<ComponentRootInstance> type9ml, ParameterInstance * par, bool state)
+    {
+        if (type9ml->type != NineMLLayoutType) {
+            return true;
+        }
+        if (state) {
+            return par->name != "x" && par->name != "y" && par->name != "z";
+        }
+        return par->name != "numNeurons";
+    }
+
+    /*
+     * The parts of the parameters which decide the widgets drawn for them,
+     * and the parameters themselves in the order they are drawn.
+     */
+    void parameterKeys(QSharedPointer<ComponentRootInstance> type9ml, QByteArray &key, QVector <void *> &objects)
+    {
+        for (int j = 0; j < 2; ++j) {
+            QVector <ParameterInstance *> pars;
+            if (j == 0) {
+                pars = type9ml->ParameterList;
+            } else {
+                for (int l = 0; l < type9ml->StateVariableList.size(); ++l) {
+                    pars.push_back(type9ml->StateVariableList[l]);
+                }
+            }
+            keyNumber(key, pars.size());
+            for (int l = 0; l < pars.size(); ++l) {
+                ParameterInstance * par = pars[l];
+                if (!drawnParameter(type9ml, par, j == 1)) continue;
+                keyString(key, par->name);
+                keyNumber(key, par->currType);
+                if (par->currType == Statistical) {
+                    keyNumber(key, int(round(par->value[0])));
+                }
+                keyString(key, par->dims->toString());
+                keyString(key, par->filename);
+                objects.push_back((void *) par);
+            }
+        }
+    }
+
+    // as drawParamsLayout, which clears the results from QSettings
+    bool componentValidates(QSharedPointer<ComponentInstance> instance)
+    {
+        instance->component->validateComponent();
+        QSettings settings;
+        int num_errs = settings.beginReadArray("errors");
+        settings.endArray();
+        num_errs += settings.beginReadArray("warnings");
+        settings.endArray();
+
+        settings.remove("errors");
+        settings.remove("warnings");
+        return num_errs == 0;
+    }
+
+} // namespace
+
 nl_rootlayout::nl_rootlayout(nl_rootdata * data, QWidget *parent) :
     QVBoxLayout(parent)
 {
@@ -181,6 +262,7 @@ void nl_rootlayout::initPopulationHeader(nl_rootdata * data) {
     QSpinBox *sizeSpin = new QSpinBox;
     sizeSpin->setFocusPolicy(Qt::StrongFocus);
     sizeSpin->installEventFilter(new FilterOutUndoRedoEvents);
+    sizeSpin->installEventFilter(data);
     sizeSpin->setRange(1, 2000000);
     sizeSpin->setSingleStep(1);
     sizeSpin->setValue(0);
@@ -628,6 +710,18 @@ void nl_rootlayout::initFinish(nl_rootdata * data) {
 
 void nl_rootlayout::updateLayoutList(nl_rootdata * data) {
 
+    // only refill the list when the catalogue has changed
+    QByteArray key;
+    keyPointer(key, data);
+    for (int i = 0; i < data->catalogLayout.size(); ++i) {
+        keyPointer(key, data->catalogLayout[i].data());
+        keyString(key, data->catalogLayout[i]->name);
+    }
+    if (key == layoutCatalogKey) {
+        return;
+    }
+    layoutCatalogKey = key;
+
     // upadte the layout list
     layoutComboBox->clear();
     // we don't want to set stuff while this occurs
@@ -642,7 +736,21 @@ void nl_rootlayout::updateLayoutList(nl_rootdata * data) {
 
 void nl_rootlayout::updateComponentLists(nl_rootdata * data) {
 
-    // update the component lists
+    // update the component lists, if the catalogues have changed
+    QByteArray key;
+    keyPointer(key, data);
+    for (int c = 0; c < 3; ++c) {
+        QVector < QSharedPointer<Component> > &catalog = c == 0 ? data->catalogNrn : (c == 1 ? data->catalogWU : data->catalogPS);
+        keyNumber(key, catalog.size());
+        for (int i = 0; i < catalog.size(); ++i) {
+            keyPointer(key, catalog[i].data());
+            keyString(key, catalog[i]->name);
+        }
+    }
+    if (key == componentCatalogKey) {
+        return;
+    }
+    componentCatalogKey = key;
 
     // we don't want to set stuff while this occurs
     neuronComboBox->disconnect(data);
@@ -760,7 +868,7 @@ void nl_rootlayout::updatePanel(nl_rootdata* data)
         emit setModelName(data->currProject->name);
         data->setCaptionOut(data->currProject->name);
         // remove input properties
-        emit deleteProperties();
+        clearPropertyWidgets();
         // show model panel
         emit showModel();
 
@@ -810,6 +918,12 @@ void nl_rootlayout::popSelected(QSharedPointer <population> &pop, nl_rootdata* d
             emit setNeuronType(i);
         }
     }
+    // the list is no longer refilled for each selection
+    for (int i = 0; i < data->catalogLayout.size(); ++i) {
+        if (pop->layoutType->component == data->catalogLayout[i]) {
+            emit setLayoutType(i);
+        }
+    }
 
     // if no data hide paste
     emit allowPaste(data->clipboardCData != NULL);
@@ -826,9 +940,130 @@ void nl_rootlayout::popSelected(QSharedPointer <population> &pop, nl_rootdata* d
     tabs->setTabText(0, "Neuron Body");
     tabs->setTabText(1, "Layout");
 
-    emit deleteProperties();
+    QByteArray key;
+    QVector <void *> objects;
+    populationPanelKey(pop, data, key, objects);
+
+    if (!panelKey.isEmpty() && key == panelKey) {
+        // same widgets, for this population's properties
+        rebindPanel(objects);
+        if (pop->neuronType->component->name != "none") {
+            emit showTab0CopyPaste();
+        }
+        return;
+    }
+
+    QSet <QObject *> before = panelChildren();
+    clearPropertyWidgets();
     drawParamsLayout(data);
+    panelKey = key;
+    panelObjects = objects;
+    keepPanelWidgets(before);
+
+}
+
+void nl_rootlayout::populationPanelKey(QSharedPointer <population> &pop, nl_rootdata * data, QByteArray &key, QVector <void *> &objects)
+{
+    QSharedPointer <ComponentInstance> nrn = pop->neuronType;
+    keyPointer(key, nrn->component.data());
+    objects.push_back((void *) nrn.data());
+    if (componentValidates(nrn)) {
+        keyString(key, "valid");
+        parameterKeys(nrn, key, objects);
+    }
+
+    if (nrn->component->name != "none") {
+        for (int input = 0; input < nrn->inputs.size(); ++input) {
+            QSharedPointer<genericInput> currInput = nrn->inputs[input];
+            keyString(key, currInput->srcCmpt->getXMLName());
+            keyString(key, nrn->getPortMatches(input, false).join("\n"));
+            keyString(key, currInput->srcPort + "->" + currInput->dstPort);
+            keyString(key, currInput->dstCmpt->component->name);
+            keyNumber(key, currInput->projInput);
+            objects.push_back((void *) currInput.data());
+        }
+
+        // the completer for adding inputs
+        for (int i = 0; i < data->populations.size(); ++i) {
+            keyString(key, data->populations[i]->neuronType->getXMLName());
+            for (int j = 0; j < data->populations[i]->projections.size(); ++j) {
+                for (int k = 0; k < data->populations[i]->projections[j]->synapses.size(); ++k) {
+                    keyString(key, data->populations[i]->projections[j]->synapses[k]->weightUpdateCmpt->getXMLName());
+                    keyString(key, data->populations[i]->projections[j]->synapses[k]->postSynapseCmpt->getXMLName());
+                }
+            }
+        }
+    }
+
+    QSharedPointer <ComponentRootInstance> layout = qSharedPointerDynamicCast <ComponentRootInstance> (pop->layoutType);
+    keyPointer(key, pop->layoutType->component.data());
+    objects.push_back((void *) layout.data());
+    parameterKeys(layout, key, objects);
+}
+
+QSet <QObject *> nl_rootlayout::panelChildren()
+{
+    QSet <QObject *> children;
+    QList <QWidget *> widgets = tab1->findChildren<QWidget *>() + tab2->findChildren<QWidget *>();
+    for (int i = 0; i < widgets.size(); ++i) {
+        children.insert(widgets[i]);
+    }
+    return children;
+}
 
+void nl_rootlayout::keepPanelWidgets(const QSet <QObject *> &before)
+{
+    // the widgets just drawn which point into the model
+    QList <QWidget *> widgets = tab1->findChildren<QWidget *>() + tab2->findChildren<QWidget *>();
+    for (int i = 0; i < widgets.size(); ++i) {
+        if (before.contains(widgets[i])) continue;
+        if (widgets[i]->property("ptr").isValid() || widgets[i]->property("ptrDst").isValid()
+            || widgets[i]->property("ptrComp").isValid()) {
+            panelWidgets.push_back(widgets[i]);
+        }
+    }
+}
+
+void nl_rootlayout::rebindPanel(const QVector <void *> &objects)
+{
+    QHash <void *, void *> rebound;
+    for (int i = 0; i < panelObjects.size() && i < objects.size(); ++i) {
+        rebound[panelObjects[i]] = objects[i];
+    }
+
+    const char * pointers[] = { "ptr", "ptrDst", "ptrComp" };
+    for (int i = 0; i < panelWidgets.size(); ++i) {
+        QWidget * widget = panelWidgets[i];
+        if (!widget) continue;
+        for (int p = 0; p < 3; ++p) {
+            QVariant v = widget->property(pointers[p]);
+            if (v.isValid() && rebound.contains(v.value<void *>())) {
+                widget->setProperty(pointers[p], qVariantFromValue(rebound[v.value<void *>()]));
+            }
+        }
+
+        // refresh the values, without sending them back as edits
+        if (widget->property("action").toString() != "changeVal") continue;
+        ParameterInstance * par = (ParameterInstance *) widget->property("ptr").value<void *>();
+        int valToChange = widget->property("valToChange").toInt();
+        if (valToChange >= par->value.size()) continue;
+        bool blocked = widget->blockSignals(true);
+        if (qobject_cast<QDoubleSpinBox *> (widget)) {
+            ((QDoubleSpinBox *) widget)->setValue(par->value[valToChange]);
+        } else if (qobject_cast<QSpinBox *> (widget)) {
+            ((QSpinBox *) widget)->setValue(par->value[valToChange]);
+        }
+        widget->blockSignals(blocked);
+    }
+    panelObjects = objects;
+}
+
+void nl_rootlayout::clearPropertyWidgets()
+{
+    panelKey.clear();
+    panelObjects.clear();
+    panelWidgets.clear();
+    emit deleteProperties();
 }
 
 void nl_rootlayout::projSelected(QSharedPointer <projection> &proj, nl_rootdata* data) {
@@ -913,7 +1148,7 @@ void nl_rootlayout::projSelected(QSharedPointer <projection> &proj, nl_rootdata*
     connectionComboBox->setCurrentIndex(proj->synapses[proj->currTarg]->connectionType->getIndex());
     connect(connectionComboBox, SIGNAL(activated(int)), data, SLOT(updateComponentType(int)));
 
-    emit deleteProperties();
+    clearPropertyWidgets();
     drawParamsLayout(data);
 }
 
@@ -922,7 +1157,7 @@ void nl_rootlayout::inSelected(QSharedPointer<genericInput> in, nl_rootdata* dat
 {
     emit showInput();
     emit setInputName("<u><b>" + in->getName() + "</b></u>");
-    emit deleteProperties();
+    clearPropertyWidgets();
 
     data->currentlySelectedProjection = in;
 
@@ -1630,6 +1865,7 @@ void nl_rootlayout::drawSingleParam(QFormLayout * varLayout, ParameterInstance *
         parSpin->setProperty("action","changeVal");
         connect(this, SIGNAL(deleteProperties()), parSpin, SLOT(deleteLater()));
         parSpin->installEventFilter(new FilterOutUndoRedoEvents);
+        parSpin->installEventFilter(data);
         parSpin->setFocusPolicy(Qt::StrongFocus);
 
         buttons->addWidget(parSpin);
@@ -1711,6 +1947,7 @@ void nl_rootlayout::drawSingleParam(QFormLayout * varLayout, ParameterInstance *
             connect(parSpin, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
             connect(this, SIGNAL(deleteProperties()), parSpin, SLOT(deleteLater()));
             parSpin->installEventFilter(new FilterOutUndoRedoEvents);
+            parSpin->installEventFilter(data);
             parSpin->setFocusPolicy(Qt::StrongFocus);
             buttons->addWidget(parSpin);
 
@@ -1729,6 +1966,7 @@ void nl_rootlayout::drawSingleParam(QFormLayout * varLayout, ParameterInstance *
             parSpin->setProperty("ptr", qVariantFromValue((void *) currPar));
             parSpin->setProperty("action","changeVal");
             parSpin->installEventFilter(new FilterOutUndoRedoEvents);
+            parSpin->installEventFilter(data);
             parSpin->setFocusPolicy(Qt::StrongFocus);
             connect(parSpin, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
             connect(this, SIGNAL(deleteProperties()), parSpin, SLOT(deleteLater()));
@@ -1754,6 +1992,7 @@ void nl_rootlayout::drawSingleParam(QFormLayout * varLayout, ParameterInstance *
             parSpin->setProperty("ptr", qVariantFromValue((void *) currPar));
             parSpin->setProperty("action","changeVal");
             parSpin->installEventFilter(new FilterOutUndoRedoEvents);
+            parSpin->installEventFilter(data);
             parSpin->setFocusPolicy(Qt::StrongFocus);
             connect(parSpin, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
             connect(this, SIGNAL(deleteProperties()), parSpin, SLOT(deleteLater()));
@@ -1775,6 +2014,7 @@ void nl_rootlayout::drawSingleParam(QFormLayout * varLayout, ParameterInstance *
             parSpin->setProperty("ptr", qVariantFromValue((void *) currPar));
             parSpin->setProperty("action","changeVal");
             parSpin->installEventFilter(new FilterOutUndoRedoEvents);
+            parSpin->installEventFilter(data);
             parSpin->setFocusPolicy(Qt::StrongFocus);
             connect(parSpin, SIGNAL(valueChanged(double)), data, SLOT (updatePar()));
             connect(this, SIGNAL(deleteProperties()), parSpin, SLOT(deleteLater()));
@@ -1796,6 +2036,7 @@ void nl_rootlayout::drawSingleParam(QFormLayout * varLayout, ParameterInstance *
         seedSpin->setProperty("ptr", qVariantFromValue((void *) currPar));
         seedSpin->setProperty("action","changeVal");
         seedSpin->installEventFilter(new FilterOutUndoRedoEvents);
+        seedSpin->installEventFilter(data);
         seedSpin->setFocusPolicy(Qt::StrongFocus);
         connect(seedSpin, SIGNAL(valueChanged(int)), data, SLOT (updatePar()));
         connect(this, SIGNAL(deleteProperties()), seedSpin, SLOT(deleteLater()));
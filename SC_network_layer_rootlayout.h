@@ -54,6 +54,25 @@ private:
     void drawParamsLayout(nl_rootdata * data);
     void drawSingleParam(QFormLayout * varLayout, ParameterInstance * currPar, nl_rootdata * data, bool connectionBool, QString type, QSharedPointer<ComponentRootInstance>  type9ml, connection * conn);
 
+    /*!
+     * The property widgets are drawn again only when the structure of the
+     * panel changes: a population panel whose key (see populationPanelKey)
+     * matches the one drawn has its widgets rebound to the new objects and
+     * their values refreshed instead.
+     */
+    void populationPanelKey(QSharedPointer<population> &, nl_rootdata *, QByteArray &key, QVector <void *> &objects);
+    QSet <QObject *> panelChildren();
+    void keepPanelWidgets(const QSet <QObject *> &before);
+    void rebindPanel(const QVector <void *> &objects);
+    void clearPropertyWidgets();
+    QByteArray panelKey;
+    QVector <void *> panelObjects;
+    QList < QPointer<QWidget> > panelWidgets;
+
+    // the catalogues the type selection boxes were filled from
+    QByteArray layoutCatalogKey;
+    QByteArray componentCatalogKey;
+
     // are these needed anymore?
     void recursiveDeleteLater(QLayout * parentLayout);
     QVector <QWidget *> forDeleting;
@@ -0,0 +1,415 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_networkgraphwriter.h"
+#include "NL_connection.h"
+#include "SC_profiler.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QDataStream>
+#include <QMutex>
+#include <cmath>
+
+namespace {
+
+/*
+ * The text of a population, as last written.
+ */
+struct cachedText {
+    QByteArray key;
+    QString nodes;
+    QString edges;
+};
+
+QMutex cacheLock;
+QHash <QString, cachedText> cache;
+
+QString typeName (connectionType type)
+{
+    switch (type) {
+    case AlltoAll:
+        return "all to all";
+    case OnetoOne:
+        return "one to one";
+    case FixedProb:
+        return "fixed probability";
+    case CSV:
+        return "explicit list";
+    case Python:
+        return "python script";
+    case CSA:
+        return "CSA";
+    default:
+        return "none";
+    }
+}
+
+/*
+ * The number of connections of c from srcSize sources to dstSize
+ * destinations, as connection::getStatistics gives it. False if it is not
+ * known.
+ */
+bool countOf (const connectionSnapshot& c, int srcSize, int dstSize, qint64& count, bool& exact)
+{
+    if (!c.list.isNull()) {
+        connectionStatistics stats;
+        if (!c.list->getStatistics (srcSize, dstSize, stats)) {
+            return false;
+        }
+        count = stats.count;
+        exact = stats.exact;
+        return true;
+    }
+    exact = true;
+    switch (c.type) {
+    case AlltoAll:
+        count = (qint64) srcSize * dstSize;
+        return true;
+    case OnetoOne:
+        count = qMin (srcSize, dstSize);
+        return true;
+    case FixedProb:
+        count = (qint64) floor ((double) srcSize * dstSize * qBound (0.0f, c.probability, 1.0f) + 0.5);
+        exact = false;
+        return true;
+    default:
+        return false;
+    }
+}
+
+QString dotQuoted (const QString& text)
+{
+    QString escaped = text;
+    escaped.replace ("\\", "\\\\");
+    escaped.replace ("\"", "\\\"");
+    escaped.replace ("\n", "\\n");
+    return "\"" + escaped + "\"";
+}
+
+QString xmlEscaped (const QString& text)
+{
+    QString escaped = text;
+    escaped.replace ("&", "&amp;");
+    escaped.replace ("<", "&lt;");
+    escaped.replace (">", "&gt;");
+    escaped.replace ("\"", "&quot;");
+    return escaped;
+}
+
+QString xmlData (const QString& key, const QString& value)
+{
+    return "      <data key=\"" + key + "\">" + xmlEscaped (value) + "</data>\n";
+}
+
+/*
+ * Makes the text of one population on the pool: its node, and the edges
+ * of its projections and of the generic inputs into it and its synapses.
+ */
+class graphJob : public QRunnable
+{
+public:
+    graphJob() : cached(false) { this->setAutoDelete(false); }
+
+    void run (void)
+    {
+        if (this->fmt == networkGraphWriter::dot) {
+            this->writeDot();
+        } else {
+            this->writeGraphML();
+        }
+    }
+
+    const modelSnapshot * snapshot;
+    const populationSnapshot * pop;
+    networkGraphWriter::format fmt;
+    QByteArray key;
+    bool cached;
+    QString nodes;
+    QString edges;
+
+private:
+    /*
+     * The generic inputs of the components of the population whose source
+     * and destination are both populations: the others are between the
+     * components of a population or projection, and are not drawn.
+     */
+    QVector <const inputSnapshot *> populationInputs (void) const
+    {
+        QVector <const componentSnapshot *> cmpts;
+        cmpts.push_back (&this->pop->neuron);
+        for (int i = 0; i < this->pop->projections.size(); ++i) {
+            const projectionSnapshot& proj = this->pop->projections[i];
+            for (int j = 0; j < proj.synapses.size(); ++j) {
+                cmpts.push_back (&proj.synapses[j].weightUpdate);
+                cmpts.push_back (&proj.synapses[j].postSynapse);
+            }
+        }
+        QVector <const inputSnapshot *> inputs;
+        for (int i = 0; i < cmpts.size(); ++i) {
+            for (int j = 0; j < cmpts[i]->inputs.size(); ++j) {
+                const inputSnapshot& in = cmpts[i]->inputs[j];
+                if (this->snapshot->population (in.source) && this->snapshot->population (in.destination)) {
+                    inputs.push_back (&in);
+                }
+            }
+        }
+        return inputs;
+    }
+
+    QString connectionsLabel (const connectionSnapshot& c, int dstSize) const
+    {
+        qint64 count;
+        bool exact;
+        if (!countOf (c, this->pop->size, dstSize, count, exact)) {
+            return "? connections";
+        }
+        return (exact ? "" : "~") + QString::number (count) + " connections";
+    }
+
+    void writeDot (void)
+    {
+        const populationSnapshot& p = *this->pop;
+        this->nodes = "  subgraph " + dotQuoted ("cluster_" + p.name) + " {\n"
+                + "    label=" + dotQuoted (p.name) + ";\n"
+                + "    " + dotQuoted (p.name) + " [shape=" + (p.isSpikeSource ? "ellipse" : "box")
+                + ", label=" + dotQuoted (p.name + "\n" + p.neuron.name + "\n" + QString::number (p.size) + " neurons") + "];\n"
+                + "  }\n";
+
+        this->edges.clear();
+        for (int i = 0; i < p.projections.size(); ++i) {
+            const projectionSnapshot& proj = p.projections[i];
+            const populationSnapshot * dst = this->snapshot->population (proj.destination);
+            int dstSize = dst ? dst->size : 0;
+            for (int j = 0; j < proj.synapses.size(); ++j) {
+                const synapseSnapshot& syn = proj.synapses[j];
+                QString label = syn.weightUpdate.name + " / " + syn.postSynapse.name + "\n"
+                        + typeName (syn.connectivity.type) + "\n" + this->connectionsLabel (syn.connectivity, dstSize);
+                this->edges += "  " + dotQuoted (proj.source) + " -> " + dotQuoted (proj.destination)
+                        + " [label=" + dotQuoted (label) + "];\n";
+            }
+        }
+        QVector <const inputSnapshot *> inputs = this->populationInputs();
+        for (int i = 0; i < inputs.size(); ++i) {
+            this->edges += "  " + dotQuoted (inputs[i]->source) + " -> " + dotQuoted (inputs[i]->destination)
+                    + " [style=dashed, label=" + dotQuoted (inputs[i]->srcPort + " -> " + inputs[i]->dstPort) + "];\n";
+        }
+    }
+
+    void writeGraphML (void)
+    {
+        const populationSnapshot& p = *this->pop;
+        this->nodes = "    <node id=\"" + xmlEscaped (p.name) + "\">\n"
+                + xmlData ("size", QString::number (p.size))
+                + xmlData ("component", p.neuron.name)
+                + xmlData ("spikeSource", p.isSpikeSource ? "true" : "false")
+                + "    </node>\n";
+
+        this->edges.clear();
+        for (int i = 0; i < p.projections.size(); ++i) {
+            const projectionSnapshot& proj = p.projections[i];
+            const populationSnapshot * dst = this->snapshot->population (proj.destination);
+            int dstSize = dst ? dst->size : 0;
+            for (int j = 0; j < proj.synapses.size(); ++j) {
+                const synapseSnapshot& syn = proj.synapses[j];
+                this->edges += "    <edge source=\"" + xmlEscaped (proj.source) + "\" target=\"" + xmlEscaped (proj.destination) + "\">\n"
+                        + xmlData ("kind", "projection")
+                        + xmlData ("weightUpdate", syn.weightUpdate.name)
+                        + xmlData ("postSynapse", syn.postSynapse.name)
+                        + xmlData ("connectivity", typeName (syn.connectivity.type));
+                qint64 count;
+                bool exact;
+                if (countOf (syn.connectivity, p.size, dstSize, count, exact)) {
+                    this->edges += xmlData ("connections", QString::number (count))
+                            + xmlData ("exact", exact ? "true" : "false");
+                }
+                this->edges += "    </edge>\n";
+            }
+        }
+        QVector <const inputSnapshot *> inputs = this->populationInputs();
+        for (int i = 0; i < inputs.size(); ++i) {
+            this->edges += "    <edge source=\"" + xmlEscaped (inputs[i]->source) + "\" target=\"" + xmlEscaped (inputs[i]->destination) + "\">\n"
+                    + xmlData ("kind", "input")
+                    + xmlData ("ports", inputs[i]->srcPort + " -> " + inputs[i]->dstPort)
+                    + "    </edge>\n";
+        }
+    }
+};
+
+void keyOf (QDataStream& s, const connectionSnapshot& c)
+{
+    s << (qint32) c.type << c.probability << (qint32) c.seed;
+    if (!c.list.isNull()) {
+        s << c.list->getExportKey();
+    }
+}
+
+void keyOf (QDataStream& s, const modelSnapshot * snapshot, const componentSnapshot& cmpt)
+{
+    s << cmpt.name << (qint32) cmpt.inputs.size();
+    for (int i = 0; i < cmpt.inputs.size(); ++i) {
+        const inputSnapshot& in = cmpt.inputs[i];
+        s << in.source << in.destination << in.srcPort << in.dstPort
+          << (snapshot->population (in.source) != (const populationSnapshot *) 0)
+          << (snapshot->population (in.destination) != (const populationSnapshot *) 0);
+    }
+}
+
+/*
+ * The key of what the text of job is made from; it is made again only if
+ * this has changed.
+ */
+QByteArray jobKey (const graphJob * job)
+{
+    QByteArray key;
+    QDataStream s (&key, QIODevice::WriteOnly);
+    const populationSnapshot& p = *job->pop;
+    s << (qint32) job->fmt << p.name << (qint32) p.size << p.isSpikeSource;
+    keyOf (s, job->snapshot, p.neuron);
+    for (int i = 0; i < p.projections.size(); ++i) {
+        const projectionSnapshot& proj = p.projections[i];
+        const populationSnapshot * dst = job->snapshot->population (proj.destination);
+        s << proj.destination << (qint32) (dst ? dst->size : -1);
+        for (int j = 0; j < proj.synapses.size(); ++j) {
+            keyOf (s, job->snapshot, proj.synapses[j].weightUpdate);
+            keyOf (s, job->snapshot, proj.synapses[j].postSynapse);
+            keyOf (s, proj.synapses[j].connectivity);
+        }
+    }
+    return key;
+}
+
+} // namespace
+
+networkGraphWriter::format networkGraphWriter::formatFor(const QString &fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "graphml" || suffix == "xml") {
+        return graphML;
+    }
+    return dot;
+}
+
+bool networkGraphWriter::write(QSharedPointer <const modelSnapshot> snapshot, const QString &fileName,
+                               format fmt, QString &error)
+{
+    PROFILE_SCOPE("networkGraphWriter::write");
+
+    QVector <graphJob *> jobs;
+    for (int i = 0; i < snapshot->populations.size(); ++i) {
+        graphJob * job = new graphJob;
+        job->snapshot = snapshot.data();
+        job->pop = &snapshot->populations[i];
+        job->fmt = fmt;
+        jobs.push_back(job);
+    }
+
+    // make the text of the populations which have changed since last time
+    QThreadPool pool;
+    cacheLock.lock();
+    for (int i = 0; i < jobs.size(); ++i) {
+        jobs[i]->key = jobKey(jobs[i]);
+        QHash <QString, cachedText>::const_iterator it = cache.constFind(jobs[i]->pop->name);
+        if (it != cache.constEnd() && it.value().key == jobs[i]->key) {
+            jobs[i]->nodes = it.value().nodes;
+            jobs[i]->edges = it.value().edges;
+            jobs[i]->cached = true;
+        } else {
+            pool.start(jobs[i]);
+        }
+    }
+    cacheLock.unlock();
+    pool.waitForDone();
+
+    // keep only the populations of this export, so the cache does not grow
+    // with every population ever renamed or deleted
+    QHash <QString, cachedText> kept;
+    for (int i = 0; i < jobs.size(); ++i) {
+        cachedText t;
+        t.key = jobs[i]->key;
+        t.nodes = jobs[i]->nodes;
+        t.edges = jobs[i]->edges;
+        kept.insert(jobs[i]->pop->name, t);
+    }
+    cacheLock.lock();
+    cache = kept;
+    cacheLock.unlock();
+
+    bool ok = true;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        error = "Could not open '" + fileName + "' for writing: " + file.errorString();
+        ok = false;
+    } else {
+        QTextStream out(&file);
+        out.setCodec("UTF-8");
+        if (fmt == dot) {
+            out << "digraph " << dotQuoted(snapshot->projectName) << " {\n";
+            out << "  rankdir=LR;\n";
+        } else {
+            out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+                << "  <key id=\"size\" for=\"node\" attr.name=\"size\" attr.type=\"int\"/>\n"
+                << "  <key id=\"component\" for=\"node\" attr.name=\"component\" attr.type=\"string\"/>\n"
+                << "  <key id=\"spikeSource\" for=\"node\" attr.name=\"spikeSource\" attr.type=\"boolean\"/>\n"
+                << "  <key id=\"kind\" for=\"edge\" attr.name=\"kind\" attr.type=\"string\"/>\n"
+                << "  <key id=\"weightUpdate\" for=\"edge\" attr.name=\"weightUpdate\" attr.type=\"string\"/>\n"
+                << "  <key id=\"postSynapse\" for=\"edge\" attr.name=\"postSynapse\" attr.type=\"string\"/>\n"
+                << "  <key id=\"connectivity\" for=\"edge\" attr.name=\"connectivity\" attr.type=\"string\"/>\n"
+                << "  <key id=\"connections\" for=\"edge\" attr.name=\"connections\" attr.type=\"long\"/>\n"
+                << "  <key id=\"exact\" for=\"edge\" attr.name=\"exact\" attr.type=\"boolean\"/>\n"
+                << "  <key id=\"ports\" for=\"edge\" attr.name=\"ports\" attr.type=\"string\"/>\n"
+                << "  <graph id=\"" << xmlEscaped(snapshot->projectName) << "\" edgedefault=\"directed\">\n";
+        }
+        // all the nodes first: in DOT a node belongs to the first subgraph
+        // it appears in, edges included
+        for (int i = 0; i < jobs.size(); ++i) {
+            out << jobs[i]->nodes;
+        }
+        for (int i = 0; i < jobs.size(); ++i) {
+            out << jobs[i]->edges;
+        }
+        if (fmt == dot) {
+            out << "}\n";
+        } else {
+            out << "  </graph>\n</graphml>\n";
+        }
+        out.flush();
+        if (file.error() != QFile::NoError) {
+            error = "Could not write '" + fileName + "': " + file.errorString();
+            ok = false;
+        }
+    }
+
+    for (int i = 0; i < jobs.size(); ++i) {
+        delete jobs[i];
+    }
+    return ok;
+}
+
+void networkGraphWriter::clearCache()
+{
+    QMutexLocker locker(&cacheLock);
+    cache.clear();
+}
@@ -0,0 +1,76 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_NETWORKGRAPHWRITER_H
+#define SC_NETWORKGRAPHWRITER_H
+
+#include "globalHeader.h"
+#include "SC_modelsnapshot.h"
+
+/*!
+ * \brief The networkGraphWriter class writes an overview of a network, its
+ * populations and the projections and generic inputs between them, as a
+ * Graphviz DOT or a GraphML file. Where DotWriter draws the regimes of one
+ * component, this draws the whole model, read from a modelSnapshot so that
+ * it can be written off the GUI thread or from headless mode.
+ *
+ * Each projection edge is labelled with its synapses and the number of
+ * connections, from connectionStatistics: counted (and cached with the
+ * list) for explicit lists, and following from the rule, or expected for
+ * fixed probability, for the others.
+ *
+ * The text of each population (its node, and the edges out of it) is made
+ * on the pool, and kept between exports with the key of what it was made
+ * from, so that for a large model only the populations which have changed
+ * since the last export are made again; the text is then written out in
+ * the order of the populations.
+ */
+class networkGraphWriter
+{
+public:
+    enum format {
+        dot,
+        graphML
+    };
+
+    /*!
+     * The format for a file name: GraphML for .graphml or .xml, else DOT.
+     */
+    static format formatFor(const QString &fileName);
+
+    /*!
+     * Write the network in snapshot to fileName. Returns false, with error
+     * set, if it could not be written.
+     */
+    static bool write(QSharedPointer <const modelSnapshot> snapshot, const QString &fileName,
+                      format fmt, QString &error);
+
+    /*!
+     * Forget the text kept from earlier exports.
+     */
+    static void clearCache();
+};
+
+#endif // SC_NETWORKGRAPHWRITER_H
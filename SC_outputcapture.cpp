@@ -0,0 +1,220 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_outputcapture.h"
+#include <QDir>
+#include <QFileInfo>
+#include <climits>
+#include <cstring>
+
+multiPatternMatcher::multiPatternMatcher()
+{
+    this->state = 0;
+    this->best = -1;
+}
+
+void multiPatternMatcher::setPatterns(const QList <QByteArray> &patterns)
+{
+    this->next.clear();
+    this->ends.clear();
+    this->reset();
+
+    bool any = false;
+    for (int i = 0; i < patterns.size(); ++i) {
+        any = any || !patterns[i].isEmpty();
+    }
+    if (!any) {
+        return;
+    }
+
+    // the trie of the patterns, with -1 for the bytes which leave it
+    this->next.fill(-1, 256);
+    this->ends.push_back(INT_MAX);
+    for (int i = 0; i < patterns.size(); ++i) {
+        const QByteArray &p = patterns[i];
+        if (p.isEmpty()) {
+            continue;
+        }
+        int s = 0;
+        for (int j = 0; j < p.size(); ++j) {
+            int b = (uchar) p[j];
+            if (this->next[s*256 + b] == -1) {
+                this->next[s*256 + b] = this->ends.size();
+                this->next.insert(this->next.size(), 256, -1);
+                this->ends.push_back(INT_MAX);
+            }
+            s = this->next[s*256 + b];
+        }
+        this->ends[s] = qMin(this->ends[s], i);
+    }
+
+    // fill in the transitions which leave the trie from the failure links,
+    // breadth first so that each state's failure is complete before it is
+    // followed, and let each state end the patterns its failure ends
+    QVector <int> fail(this->ends.size(), 0);
+    QVector <int> queue;
+    for (int b = 0; b < 256; ++b) {
+        int v = this->next[b];
+        if (v == -1) {
+            this->next[b] = 0;
+        } else {
+            queue.push_back(v);
+        }
+    }
+    for (int q = 0; q < queue.size(); ++q) {
+        int u = queue[q];
+        this->ends[u] = qMin(this->ends[u], this->ends[fail[u]]);
+        for (int b = 0; b < 256; ++b) {
+            int v = this->next[u*256 + b];
+            int f = this->next[fail[u]*256 + b];
+            if (v == -1) {
+                this->next[u*256 + b] = f;
+            } else {
+                fail[v] = f;
+                queue.push_back(v);
+            }
+        }
+    }
+}
+
+void multiPatternMatcher::reset()
+{
+    this->state = 0;
+    this->best = -1;
+}
+
+bool multiPatternMatcher::feed(const char * data, int n)
+{
+    if (this->next.isEmpty()) {
+        return false;
+    }
+    const int * nx = this->next.constData();
+    const int * en = this->ends.constData();
+    int s = this->state;
+    int found = this->best < 0 ? INT_MAX : this->best;
+    for (int i = 0; i < n; ++i) {
+        s = nx[s*256 + (uchar) data[i]];
+        if (en[s] < found) {
+            found = en[s];
+        }
+    }
+    this->state = s;
+    if (found != INT_MAX && found != this->best) {
+        this->best = found;
+        return true;
+    }
+    return false;
+}
+
+outputCapture::outputCapture()
+{
+    this->ringStart = 0;
+    this->ringSize = 0;
+    this->spilled = 0;
+}
+
+outputCapture::~outputCapture()
+{
+    this->spillFile.close();
+}
+
+void outputCapture::start(const QString &spillFileName, const QList <QByteArray> &patterns)
+{
+    this->spillFile.close();
+    this->spillFile.setFileName(spillFileName);
+    this->ringStart = 0;
+    this->ringSize = 0;
+    this->spilled = 0;
+    this->matcher.setPatterns(patterns);
+}
+
+bool outputCapture::append(const QByteArray &chunk)
+{
+    bool found = this->matcher.feed(chunk.constData(), chunk.size());
+
+    if (this->ring.isEmpty()) {
+        this->ring.resize(OUTPUT_CAPTURE_HELD_BYTES);
+    }
+    int cap = this->ring.size();
+    const char * data = chunk.constData();
+    int n = chunk.size();
+
+    // make room, moving the oldest output to the file
+    int overflow = qMin(this->ringSize + n - cap, this->ringSize);
+    if (overflow > 0) {
+        int first = qMin(overflow, cap - this->ringStart);
+        this->spill(this->ring.constData() + this->ringStart, first);
+        this->spill(this->ring.constData(), overflow - first);
+        this->ringStart = (this->ringStart + overflow) % cap;
+        this->ringSize -= overflow;
+    }
+    if (n > cap) {
+        this->spill(data, n - cap);
+        data += n - cap;
+        n = cap;
+    }
+
+    int pos = (this->ringStart + this->ringSize) % cap;
+    int first = qMin(n, cap - pos);
+    memcpy(this->ring.data() + pos, data, first);
+    memcpy(this->ring.data(), data + first, n - first);
+    this->ringSize += n;
+
+    return found;
+}
+
+void outputCapture::spill(const char * data, int n)
+{
+    if (n <= 0) {
+        return;
+    }
+    if (!this->spillFile.isOpen() && !this->spillFile.fileName().isEmpty()) {
+        QDir().mkpath(QFileInfo(this->spillFile.fileName()).absolutePath());
+        this->spillFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (this->spillFile.isOpen()) {
+        this->spillFile.write(data, n);
+        // so that it can be read while the process runs
+        this->spillFile.flush();
+    }
+    this->spilled += n;
+}
+
+QString outputCapture::text() const
+{
+    QByteArray held;
+    if (this->ringSize > 0) {
+        int cap = this->ring.size();
+        int first = qMin(this->ringSize, cap - this->ringStart);
+        held.append(this->ring.constData() + this->ringStart, first);
+        held.append(this->ring.constData(), this->ringSize - first);
+    }
+    QString out;
+    if (this->spilled > 0) {
+        out = "[The first " + QString::number(this->spilled) + " bytes of output are in "
+                + this->spillFile.fileName() + "]\n";
+    }
+    return out + QString::fromUtf8(held);
+}
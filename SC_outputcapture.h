@@ -0,0 +1,128 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_OUTPUTCAPTURE_H
+#define SC_OUTPUTCAPTURE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+// the most output of a process held in memory; older output is moved to
+// the spill file
+#define OUTPUT_CAPTURE_HELD_BYTES (4*1024*1024)
+
+/*!
+ * \brief The multiPatternMatcher class finds any of a set of byte patterns
+ * in a stream given a chunk at a time, in one pass, with an Aho-Corasick
+ * automaton. A match which spans two chunks is found.
+ */
+class multiPatternMatcher
+{
+public:
+    multiPatternMatcher();
+
+    /*!
+     * Match patterns from now on. Empty patterns are ignored.
+     */
+    void setPatterns(const QList <QByteArray> &patterns);
+
+    /*!
+     * Forget what has been fed, keeping the patterns.
+     */
+    void reset();
+
+    /*!
+     * Match the next n bytes of the stream. Returns true if a pattern was
+     * matched for the first time.
+     */
+    bool feed(const char * data, int n);
+
+    /*!
+     * The index of the first of the patterns, in the order given, which has
+     * been matched, or -1.
+     */
+    int firstMatched() const { return this->best; }
+
+private:
+    // next[s*256+b] is the state after byte b in state s
+    QVector <int> next;
+    // the first pattern which ends at each state, or INT_MAX
+    QVector <int> ends;
+    int state;
+    int best;
+};
+
+/*!
+ * \brief The outputCapture class holds the output of a process, or its
+ * last OUTPUT_CAPTURE_HELD_BYTES, in a ring buffer. Output which leaves the
+ * buffer is appended to a spill file, so the file and the buffer together
+ * hold all of it, in order. Each chunk is also fed to a
+ * multiPatternMatcher, so that error messages are found as they are
+ * printed.
+ */
+class outputCapture
+{
+public:
+    outputCapture();
+    ~outputCapture();
+
+    /*!
+     * Start again, with no output held, spilling to spillFileName and
+     * matching patterns.
+     */
+    void start(const QString &spillFileName, const QList <QByteArray> &patterns);
+
+    /*!
+     * Add chunk to the output. Returns true if it completed a match of a
+     * pattern not matched before.
+     */
+    bool append(const QByteArray &chunk);
+
+    /*!
+     * The first pattern matched, as multiPatternMatcher::firstMatched().
+     */
+    int firstMatched() const { return this->matcher.firstMatched(); }
+
+    /*!
+     * The output held, decoded as UTF-8, after a line naming the spill file
+     * if some of the output is only there.
+     */
+    QString text() const;
+
+private:
+    void spill(const char * data, int n);
+
+    QByteArray ring;
+    int ringStart;
+    int ringSize;
+    qint64 spilled;
+    QFile spillFile;
+    multiPatternMatcher matcher;
+};
+
+#endif // SC_OUTPUTCAPTURE_H
@@ -0,0 +1,360 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_profiler.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadStorage>
+#include <algorithm>
+#include <climits>
+#include <iostream>
+
+namespace {
+
+inline int loadAcquire(QAtomicInt &value)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    return value.loadAcquire();
+#else
+    return (int) value;
+#endif
+}
+
+inline void storeRelease(QAtomicInt &value, int newValue)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    value.storeRelease(newValue);
+#else
+    value.fetchAndStoreRelease(newValue);
+#endif
+}
+
+/*
+ * The ring of events recorded by one thread. Only that thread writes to it.
+ */
+class profileBuffer
+{
+public:
+    profileBuffer(int thread, const QString &threadName) :
+        written(0), published(0), thread(thread), threadName(threadName) {}
+
+    void record(const char * name, qint64 start, qint64 duration)
+    {
+        profileEvent &event = this->ring[this->written & (PROFILE_BUFFER_EVENTS - 1)];
+        event.name = name;
+        event.start = start;
+        event.duration = duration;
+        event.thread = this->thread;
+        ++this->written;
+        storeRelease(this->published, (int) this->written);
+    }
+
+    void copyTo(QVector <profileEvent> &out)
+    {
+        qint64 end = (quint32) loadAcquire(this->published);
+        qint64 begin = qMax((qint64) 0, end - PROFILE_BUFFER_EVENTS);
+        int first = out.size();
+        for (qint64 i = begin; i < end; ++i) {
+            out.push_back(this->ring[i & (PROFILE_BUFFER_EVENTS - 1)]);
+        }
+
+        // the slot after the last published one shares its place with the
+        // oldest, so anything the writer has since lapped is dropped
+        qint64 after = (quint32) loadAcquire(this->published);
+        qint64 safe = qMax((qint64) 0, after - PROFILE_BUFFER_EVENTS + 1);
+        if (safe > begin) {
+            out.remove(first, (int) qMin(safe - begin, end - begin));
+        }
+    }
+
+    profileEvent ring[PROFILE_BUFFER_EVENTS];
+    quint32 written;
+    QAtomicInt published;
+    int thread;
+    QString threadName;
+};
+
+/*
+ * What QThreadStorage holds: it deletes this when the thread ends, but the
+ * buffer is kept so that the thread's events can still be exported.
+ */
+struct threadBuffer
+{
+    profileBuffer * buffer;
+};
+
+QAtomicInt recordingFlag(0);
+QAtomicInt overlayFlag(0);
+QMutex registryLock;
+QList <profileBuffer *> buffers;
+QThreadStorage <threadBuffer *> threadBuffers;
+
+struct profileClock
+{
+    profileClock() { this->timer.start(); }
+    QElapsedTimer timer;
+};
+profileClock profileTime;
+
+profileBuffer * currentBuffer()
+{
+    if (!threadBuffers.hasLocalData()) {
+        QMutexLocker locker(&registryLock);
+        QString threadName;
+        if (QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread()) {
+            threadName = "GUI";
+        } else {
+            threadName = "Worker " + QString::number(buffers.size());
+        }
+        threadBuffer * local = new threadBuffer;
+        local->buffer = new profileBuffer(buffers.size(), threadName);
+        buffers.push_back(local->buffer);
+        threadBuffers.setLocalData(local);
+    }
+    return threadBuffers.localData()->buffer;
+}
+
+bool longerTotal(const profileSummary &a, const profileSummary &b)
+{
+    return a.totalMs > b.totalMs;
+}
+
+// the duration below which the given fraction of the durations fall
+double percentile(const QVector <double> &sorted, double fraction)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    int i = (int) (fraction * (sorted.size() - 1) + 0.5);
+    return sorted[qBound(0, i, sorted.size() - 1)];
+}
+
+bool recordingFromEnvironment()
+{
+    return !qgetenv(PROFILE_ENVIRONMENT_VARIABLE).isEmpty()
+        || !qgetenv(PROFILE_SUMMARY_ENVIRONMENT_VARIABLE).isEmpty();
+}
+
+QString jsonString(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("\\", "\\\\");
+    escaped.replace("\"", "\\\"");
+    return "\"" + escaped + "\"";
+}
+
+} // namespace
+
+bool profiler::isRecording (void)
+{
+    return loadAcquire(recordingFlag) != 0;
+}
+
+void profiler::setRecording (bool record)
+{
+    storeRelease(recordingFlag, record ? 1 : 0);
+}
+
+bool profiler::overlayShown (void)
+{
+    return loadAcquire(overlayFlag) != 0;
+}
+
+void profiler::setOverlayShown (bool show)
+{
+    storeRelease(overlayFlag, show ? 1 : 0);
+    // the overlay shows what is recorded
+    if (show) {
+        profiler::setRecording(true);
+    } else if (!recordingFromEnvironment()) {
+        profiler::setRecording(false);
+    }
+}
+
+void profiler::initFromEnvironment (void)
+{
+    if (recordingFromEnvironment()) {
+        profiler::setRecording(true);
+    }
+}
+
+void profiler::writeFromEnvironment (void)
+{
+    QString fileName = QString::fromLocal8Bit(qgetenv(PROFILE_ENVIRONMENT_VARIABLE));
+    if (!fileName.isEmpty() && !profiler::writeChromeTrace(fileName)) {
+        std::cerr << "Could not write the profile to '" << fileName.toStdString() << "'." << std::endl;
+    }
+    QString summaryName = QString::fromLocal8Bit(qgetenv(PROFILE_SUMMARY_ENVIRONMENT_VARIABLE));
+    if (!summaryName.isEmpty() && !profiler::writeSummary(summaryName)) {
+        std::cerr << "Could not write the profile summary to '" << summaryName.toStdString() << "'." << std::endl;
+    }
+}
+
+qint64 profiler::now (void)
+{
+    return profileTime.timer.nsecsElapsed();
+}
+
+void profiler::record (const char * name, qint64 start, qint64 duration)
+{
+    currentBuffer()->record(name, start, duration);
+}
+
+QVector <profileEvent> profiler::events (void)
+{
+    QList <profileBuffer *> all;
+    {
+        QMutexLocker locker(&registryLock);
+        all = buffers;
+    }
+    QVector <profileEvent> out;
+    for (int i = 0; i < all.size(); ++i) {
+        all[i]->copyTo(out);
+    }
+    return out;
+}
+
+QVector <profileSummary> profiler::summarise (int msecs)
+{
+    qint64 from = profiler::now() - (qint64) msecs * 1000000;
+    QVector <profileEvent> all = profiler::events();
+
+    QHash <QString, profileSummary> totals;
+    QHash <QString, QVector <double> > durations;
+    for (int i = 0; i < all.size(); ++i) {
+        const profileEvent &event = all[i];
+        if (event.start + event.duration < from) {
+            continue;
+        }
+        QString name = QString::fromLatin1(event.name);
+        if (!totals.contains(name)) {
+            profileSummary summary;
+            summary.name = name;
+            summary.count = 0;
+            summary.totalMs = 0;
+            summary.medianMs = 0;
+            summary.p95Ms = 0;
+            summary.maxMs = 0;
+            totals.insert(name, summary);
+        }
+        profileSummary &summary = totals[name];
+        double ms = event.duration / 1000000.0;
+        ++summary.count;
+        summary.totalMs += ms;
+        summary.maxMs = qMax(summary.maxMs, ms);
+        durations[name].push_back(ms);
+    }
+
+    QVector <profileSummary> out;
+    QHash <QString, profileSummary>::const_iterator it;
+    for (it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        profileSummary summary = it.value();
+        QVector <double> &times = durations[summary.name];
+        std::sort(times.begin(), times.end());
+        summary.medianMs = percentile(times, 0.5);
+        summary.p95Ms = percentile(times, 0.95);
+        out.push_back(summary);
+    }
+    std::sort(out.begin(), out.end(), longerTotal);
+    return out;
+}
+
+bool profiler::writeChromeTrace (const QString &fileName)
+{
+    QVector <profileEvent> all = profiler::events();
+    QList <profileBuffer *> threads;
+    {
+        QMutexLocker locker(&registryLock);
+        threads = buffers;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    qint64 pid = QCoreApplication::applicationPid();
+
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (int i = 0; i < threads.size(); ++i) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << threads[i]->thread
+            << ",\"args\":{\"name\":" << jsonString(threads[i]->threadName) << "}}";
+        first = false;
+    }
+    for (int i = 0; i < all.size(); ++i) {
+        // complete events, in microseconds
+        out << (first ? "" : ",\n")
+            << "{\"name\":" << jsonString(QString::fromLatin1(all[i].name)) << ",\"ph\":\"X\",\"pid\":" << pid
+            << ",\"tid\":" << all[i].thread
+            << ",\"ts\":" << QString::number(all[i].start / 1000.0, 'f', 3)
+            << ",\"dur\":" << QString::number(all[i].duration / 1000.0, 'f', 3) << "}";
+        first = false;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.flush();
+
+    return file.error() == QFile::NoError;
+}
+
+QString profiler::summaryJson (void)
+{
+    // everything held, however old
+    QVector <profileSummary> all = profiler::summarise(INT_MAX);
+    QString out = "[";
+    for (int i = 0; i < all.size(); ++i) {
+        const profileSummary &summary = all[i];
+        out += (i == 0 ? "\n" : ",\n");
+        out += "{\"name\":" + jsonString(summary.name)
+            + ",\"count\":" + QString::number(summary.count)
+            + ",\"total_ms\":" + QString::number(summary.totalMs, 'f', 3)
+            + ",\"mean_ms\":" + QString::number(summary.totalMs / summary.count, 'f', 3)
+            + ",\"median_ms\":" + QString::number(summary.medianMs, 'f', 3)
+            + ",\"p95_ms\":" + QString::number(summary.p95Ms, 'f', 3)
+            + ",\"max_ms\":" + QString::number(summary.maxMs, 'f', 3) + "}";
+    }
+    out += "\n]";
+    return out;
+}
+
+bool profiler::writeSummary (const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out << "{\"probes\":" << profiler::summaryJson() << "}\n";
+    out.flush();
+
+    return file.error() == QFile::NoError;
+}
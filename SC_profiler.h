@@ -0,0 +1,162 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_PROFILER_H
+#define SC_PROFILER_H
+
+#include <QString>
+#include <QVector>
+#include <QAtomicInt>
+
+// events kept per thread; older ones are overwritten. A power of two.
+#define PROFILE_BUFFER_EVENTS 16384
+
+// the overlay summarises this much of the recent past
+#define PROFILE_OVERLAY_WINDOW_MS 2000
+
+// set to a file name to record from startup and write a trace there on exit
+#define PROFILE_ENVIRONMENT_VARIABLE "SPINECREATOR_PROFILE"
+
+// set to a file name to record from startup and write the totals of each
+// probe there, as JSON, on exit
+#define PROFILE_SUMMARY_ENVIRONMENT_VARIABLE "SPINECREATOR_PROFILE_SUMMARY"
+
+/*!
+ * One timed scope: name is a string literal, and the times are in ns
+ * since the profiler's clock started.
+ */
+struct profileEvent
+{
+    const char * name;
+    qint64 start;
+    qint64 duration;
+    int thread;
+};
+
+/*!
+ * Totals for one probe name over a span of time, for the overlay and for
+ * comparing one build with another.
+ */
+struct profileSummary
+{
+    QString name;
+    int count;
+    double totalMs;
+    double medianMs;
+    double p95Ms;
+    double maxMs;
+};
+
+/*!
+ * \brief The profiler class collects the events recorded by profileProbes.
+ *
+ * Each thread writes to a ring buffer of its own, so recording takes no
+ * lock: the thread fills a slot and then publishes the count. Readers copy
+ * what has been published and drop the slots which may have been
+ * overwritten while they copied. Nothing is recorded unless recording is
+ * on, when a probe costs two clock reads.
+ */
+class profiler
+{
+public:
+    static bool isRecording (void);
+    static void setRecording (bool record);
+
+    static bool overlayShown (void);
+    static void setOverlayShown (bool show);
+
+    /*!
+     * Start recording if PROFILE_ENVIRONMENT_VARIABLE or
+     * PROFILE_SUMMARY_ENVIRONMENT_VARIABLE is set.
+     */
+    static void initFromEnvironment (void);
+
+    /*!
+     * Write the trace to the file named by PROFILE_ENVIRONMENT_VARIABLE,
+     * and the summary to the one named by
+     * PROFILE_SUMMARY_ENVIRONMENT_VARIABLE, if they are set.
+     */
+    static void writeFromEnvironment (void);
+
+    static qint64 now (void);
+    static void record (const char * name, qint64 start, qint64 duration);
+
+    /*!
+     * The events still held, from all threads.
+     */
+    static QVector <profileEvent> events (void);
+
+    /*!
+     * Totals per probe over the last msecs, longest total first.
+     */
+    static QVector <profileSummary> summarise (int msecs);
+
+    /*!
+     * Write the events held as a Chrome trace ("Trace Event Format" JSON,
+     * as read by chrome://tracing and Perfetto). Returns false if the file
+     * could not be written.
+     */
+    static bool writeChromeTrace (const QString &fileName);
+
+    /*!
+     * The totals of every probe still held, as a JSON array of objects
+     * with name, count, total_ms, mean_ms, median_ms, p95_ms and max_ms,
+     * longest total first. For the frame times of the paint events, and
+     * for spinecreatorbench to keep with its results.
+     */
+    static QString summaryJson (void);
+
+    /*!
+     * Write summaryJson() to fileName as {"probes": [...]}. Returns false
+     * if the file could not be written.
+     */
+    static bool writeSummary (const QString &fileName);
+};
+
+/*!
+ * \brief The profileProbe class times the scope it is declared in, under a
+ * name which must be a string literal. Use PROFILE_SCOPE.
+ */
+class profileProbe
+{
+public:
+    explicit profileProbe (const char * name) :
+        name(name), start(profiler::isRecording() ? profiler::now() : -1) {}
+    ~profileProbe() {
+        if (this->start >= 0) {
+            profiler::record(this->name, this->start, profiler::now() - this->start);
+        }
+    }
+
+private:
+    const char * name;
+    qint64 start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) profileProbe PROFILE_CONCAT(profileProbe_, __LINE__) (name)
+
+#endif // SC_PROFILER_H
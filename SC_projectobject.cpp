@@ -4,17 +4,177 @@
 #include "SC_network_layer_rootdata.h"
 #include "mainwindow.h"
 #include "SC_versioncontrol.h"
+#include "SC_settings.h"
+#include "SC_utilities.h"
+#include "SC_profiler.h"
 #include "EL_experiment.h"
 #include "SC_systemmodel.h"
+#include "SC_ioservice.h"
+#include <QMutex>
+#include <QThreadPool>
+#include <QXmlStreamReader>
+
+namespace {
+    // Outcome of reading one of the project's XML files
+    enum xmlFileStatus {
+        xmlFileParsed,
+        xmlFileNotOpened,
+        xmlFileNotParsed
+    };
+
+    // Parses one file, once the ioService has read it, into a document
+    // owned by the caller.
+    class xmlFileParser : public QRunnable
+    {
+    public:
+        xmlFileParser(const ioFuture& file, QDomDocument* doc, int* status)
+            : file(file), doc(doc), status(status) {}
+        void run() {
+            PROFILE_SCOPE("xmlFileParser::run");
+            if (!this->file.waitForFinished()) {
+                *this->status = xmlFileNotOpened;
+                return;
+            }
+            if (!this->doc->setContent(this->file.data())) {
+                *this->status = xmlFileNotParsed;
+                return;
+            }
+            *this->status = xmlFileParsed;
+        }
+    private:
+        ioFuture file;
+        QDomDocument* doc;
+        int* status;
+    };
+
+    // Parses fileNames[i] into docs[i] with status[i]. All the files are
+    // queued to be read first, and each is parsed as it arrives, spreading
+    // the files across the available cores. The QDom classes are
+    // reentrant, so each document can be filled on its own thread;
+    // waitForDone() hands them all back to the caller.
+    void parseXmlFiles(const QStringList& fileNames, const QDir& dir,
+                       QVector<QDomDocument>& docs, QVector<int>& status)
+    {
+        docs.resize(fileNames.size());
+        status.fill(xmlFileNotOpened, fileNames.size());
+        QVector<ioFuture> files(fileNames.size());
+        for (int i = 0; i < fileNames.size(); ++i) {
+            files[i] = ioService::read(dir.absoluteFilePath(fileNames[i]));
+        }
+        QThreadPool pool;
+        for (int i = 0; i < fileNames.size(); ++i) {
+            pool.start(new xmlFileParser(files[i], &docs[i], &status[i]));
+        }
+        pool.waitForDone();
+    }
+
+    // What a file in a project directory holds, going by the root
+    // element and its first child
+    enum xmlFileKind {
+        xmlComponentFile,
+        xmlLayoutFile,
+        xmlOtherFile
+    };
+
+    // Reads only as far as the first child of the root element, so the
+    // files of a directory are sorted without parsing any of them whole.
+    // As QDomElement::tagName(), the names are the qualified ones.
+    xmlFileKind sniffXmlFile(const QString& path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return xmlOtherFile;
+        }
+        QXmlStreamReader reader(&file);
+        bool inRoot = false;
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement()) {
+                if (!inRoot) {
+                    if (reader.qualifiedName() != "SpineML") {
+                        return xmlOtherFile;
+                    }
+                    inRoot = true;
+                } else if (reader.qualifiedName() == "ComponentClass") {
+                    return xmlComponentFile;
+                } else if (reader.qualifiedName() == "LayoutClass") {
+                    return xmlLayoutFile;
+                } else {
+                    return xmlOtherFile;
+                }
+            } else if (reader.isEndElement()) {
+                // a root with no children
+                return xmlOtherFile;
+            }
+        }
+        return xmlOtherFile;
+    }
+
+    // One of the files of a project which is written independently of
+    // the others
+    struct projectFileJob
+    {
+        QString fileName;
+        QSharedPointer<Component> component;
+        QSharedPointer<NineMLLayout> layout;
+        experiment* expt;
+        bool written;
+        // the write of the file, queued with the ioService
+        ioFuture file;
+        // the errors stored while writing it, for the GUI thread to store
+        QStringList errors;
+    };
+
+    // Writes a component, layout or experiment out and queues it to be
+    // saved to its file. These only read the model, which is not changed
+    // while it is saved, so several can be written at once, alongside the
+    // network.
+    class projectFileWriter : public QRunnable
+    {
+    public:
+        projectFileWriter(projectFileJob* job, projectObject* project)
+            : job(job), project(project) {}
+        void run() {
+            PROFILE_SCOPE("projectFileWriter::run");
+            SCUtilities::collectErrors (&this->job->errors);
+            QByteArray text;
+            QXmlStreamWriter xmlOut(&text);
+            if (this->job->component) {
+                xmlOut.setAutoFormatting(true);
+                this->job->component->writeXML(xmlOut);
+            } else if (this->job->layout) {
+                xmlOut.setAutoFormatting(true);
+                this->job->layout->writeXML(xmlOut);
+            } else {
+                this->job->expt->writeXML(&xmlOut, this->project);
+            }
+            if (!xmlOut.hasError()) {
+                this->job->file = ioService::write(this->job->fileName, text);
+            }
+            SCUtilities::collectErrors ((QStringList*)0);
+        }
+    private:
+        projectFileJob* job;
+        projectObject* project;
+    };
+}
 
 projectObject::projectObject(QObject *parent) :
     QObject(parent)
 {
     this->name = "New Project";
+    this->errorsShown = 0;
 
     this->menuAction = new QAction(this);
 
     this->undoStack = new QUndoStack(this);
+    this->changeGeneration = 1;
+    this->checkedGeneration = 0;
+    this->checkedChanged = false;
+    this->recoveredChanges = false;
+    this->modelGeneration = 0;
+    connect(this->undoStack, SIGNAL(cleanChanged(bool)), this, SLOT(markChanged()));
+    connect(this->undoStack, SIGNAL(indexChanged(int)), this, SLOT(modelEdited()));
 
     // Screen cursor pos initialised in the nl_rootdata object to 0,0 also.
     //this->currentCursorPos.x = 0.0;
@@ -116,13 +276,13 @@ QString projectObject::getFilenameFriendlyName (void)
 
 bool projectObject::open_project(QString fileName)
 {
+    PROFILE_SCOPE("projectObject::open_project");
     QDir project_dir(fileName);
 
     // remove filename
     project_dir.cdUp();
 
-    QSettings settings;
-    settings.setValue("files/currentFileName", project_dir.absolutePath());
+    settingsCache::setCurrentFileName(project_dir.absolutePath());
 
     // Set currentCursorPos to 0 before opening a project to ensure we
     // don't translate anything in position.
@@ -135,16 +295,18 @@ bool projectObject::open_project(QString fileName)
         return false;
     }
 
-    // then load in all the components listed in the project file
-    for (int i = 0; i < this->components.size(); ++i) {
-        this->loadComponent(this->components[i], project_dir);
+    // the network and experiments are read while the components are parsed
+    ioService::hintReadAhead(project_dir.absoluteFilePath(this->networkFile));
+    for (int i = 0; i < this->experiments.size(); ++i) {
+        ioService::hintReadAhead(project_dir.absoluteFilePath(this->experiments[i]));
     }
+
+    // then load in all the components listed in the project file
+    this->loadComponents(this->components, project_dir);
     printErrors("Errors found loading project Components:");
 
     // then load in all the layouts listed in the project file
-    for (int i = 0; i < this->layouts.size(); ++i) {
-        this->loadLayout(this->layouts[i], project_dir);
-    }
+    this->loadLayouts(this->layouts, project_dir);
     printErrors("Errors found loading project Layouts:");
 
     // now the network
@@ -159,6 +321,11 @@ bool projectObject::open_project(QString fileName)
     }
     printErrors("Errors found loading project Experiments:");
 
+    // The network is usable now. The explicit connection lists are copied
+    // into their backing stores in the background, or on first use if
+    // that comes sooner.
+    this->startDeferredImports();
+
     // check for errors
     printWarnings("Issues were found while loading the project:");
 
@@ -170,10 +337,9 @@ bool projectObject::open_project(QString fileName)
 
 bool projectObject::save_project(QString fileName, nl_rootdata * data)
 {
+    PROFILE_SCOPE("projectObject::save_project");
     if (!fileName.contains(".")) {
-        QMessageBox msgBox;
-        msgBox.setText("Project file needs .proj suffix.");
-        msgBox.exec();
+        SCUtilities::showMessage("Project file needs .proj suffix.");
         return false;
     }
     DBG() << "save_project ('" << fileName << "', rootData*)";
@@ -186,15 +352,31 @@ bool projectObject::save_project(QString fileName, nl_rootdata * data)
     // check for version control
     this->version.setupVersion();
 
+    // sync project
+    copy_back_data(data);
+    ParameterInstance::restartFileNames();
+
+    // Connection lists opened from this directory may not have been
+    // copied into their backing stores yet, and their files are about to
+    // be removed or overwritten
+    QVector<csv_connection*> openedConns = this->getExplicitConnections();
+    for (int i = 0; i < openedConns.size(); ++i) {
+        openedConns[i]->waitForImport();
+    }
+
     // No longer remove explicitDataBinaryFiles on save - we'll
     // overwrite those files which need overwriting, and we'll use the
     // files present in the directory to help choose new names for new
     // property/explicitDataBinaryFiles.
     //
     // However, we DO remove old connection binary files (but not
-    // explicitData binary files).
+    // explicitData binary files). When exporting through the
+    // exportCache, unchanged ones are kept and it removes the rest.
     project_dir.setNameFilters(QStringList() << "conn*.bin");
-    QStringList files = project_dir.entryList(QDir::Files);
+    QStringList files;
+    if (!exportCache::isActive()) {
+        files = project_dir.entryList(QDir::Files);
+    }
     for (int i = 0; i < files.size(); ++i) {
         // delete
         project_dir.remove(files[i]);
@@ -204,46 +386,85 @@ bool projectObject::save_project(QString fileName, nl_rootdata * data)
         }
     }
 
-    // sync project
-    copy_back_data(data);
-
     // write project file
     if (!save_project_file(fileName)) {
         return false;
     }
+    exportCache::written(fileName);
 
-    // write components
-    for (int i = 1; i < this->catalogNB.size(); ++i) {
-        saveComponent(this->catalogNB[i]->getXMLName(), project_dir, this->catalogNB[i]);
-    }
-    for (int i = 1; i < this->catalogWU.size(); ++i) {
-        saveComponent(this->catalogWU[i]->getXMLName(), project_dir, this->catalogWU[i]);
+    // write components, layouts and experiments on a pool while the
+    // network is written here. Components are validated first, as that
+    // reports to the user.
+    QVector<projectFileJob> jobs;
+    QVector<QSharedPointer<Component> > components;
+    components << this->catalogNB.mid(1) << this->catalogWU.mid(1) << this->catalogPS.mid(1) << this->catalogGC.mid(1);
+    for (int i = 0; i < components.size(); ++i) {
+        if (!components[i]->validateForWrite()) {
+            continue;
+        }
+        projectFileJob job = { project_dir.absoluteFilePath(components[i]->getXMLName()),
+                               components[i], QSharedPointer<NineMLLayout>(), (experiment*)0, false };
+        jobs.push_back(job);
     }
-    for (int i = 1; i < this->catalogPS.size(); ++i) {
-        saveComponent(this->catalogPS[i]->getXMLName(), project_dir, this->catalogPS[i]);
+    for (int i = 1; i < this->catalogLAY.size(); ++i) {
+        this->catalogLAY[i]->validateForWrite();
+        projectFileJob job = { project_dir.absoluteFilePath(this->catalogLAY[i]->getXMLName()),
+                               QSharedPointer<Component>(), this->catalogLAY[i], (experiment*)0, false };
+        jobs.push_back(job);
     }
-    for (int i = 1; i < this->catalogGC.size(); ++i) {
-        saveComponent(this->catalogGC[i]->getXMLName(), project_dir, this->catalogGC[i]);
+    for (int i = 0; i < this->experimentList.size(); ++i) {
+        projectFileJob job = { project_dir.absoluteFilePath("experiment" + QString::number(i) + ".xml"),
+                               QSharedPointer<Component>(), QSharedPointer<NineMLLayout>(), this->experimentList[i], false };
+        jobs.push_back(job);
     }
 
-    // write layouts
-    for (int i = 1; i < this->catalogLAY.size(); ++i) {
-        saveLayout(this->catalogLAY[i]->getXMLName(), project_dir, this->catalogLAY[i]);
+    QThreadPool pool;
+    for (int i = 0; i < jobs.size(); ++i) {
+        pool.start(new projectFileWriter(&jobs[i], this));
     }
 
     // write network
     saveNetwork(this->networkFile, project_dir);
-
-    // write experiments
-    for (int i = 0; i < this->experimentList.size(); ++i) {
-        saveExperiment("experiment" + QString::number(i) + ".xml", project_dir, this->experimentList[i]);
+    exportCache::written(project_dir.absoluteFilePath(this->networkFile));
+
+    pool.waitForDone();
+    for (int i = 0; i < jobs.size(); ++i) {
+        SCUtilities::storeErrors(jobs[i].errors);
+        jobs[i].written = jobs[i].file.waitForFinished();
+        if (!jobs[i].written) {
+            addError("Error creating file '" + jobs[i].fileName + "' - is there sufficient disk space?");
+            continue;
+        }
+        exportCache::written(jobs[i].fileName);
+        // store path for easy access
+        if (jobs[i].component) {
+            jobs[i].component->filePath = jobs[i].fileName;
+        } else if (jobs[i].layout) {
+            jobs[i].layout->filePath = jobs[i].fileName;
+        }
+        // add to version control
+        if (this->version.isModelUnderVersion()) {
+            this->version.addToVersion(jobs[i].fileName);
+        }
     }
 
     // copy additional files
     for (int i = 0; i < this->additionalFiles.size(); ++i) {
         // copy additionalFiles[i] to project_dir / additionalFiles[i].fileName()
         QFileInfo fileInfo(this->additionalFiles[i]);
-        QFile::copy(additionalFiles[i], project_dir.absolutePath() + QDir::separator() + fileInfo.fileName());
+        QString copyName = project_dir.absolutePath() + QDir::separator() + fileInfo.fileName();
+        // the copy is current if the original has not changed since it was made
+        QByteArray key = (fileInfo.absoluteFilePath() + ":" + QString::number(fileInfo.size())
+                          + ":" + QString::number(fileInfo.lastModified().toMSecsSinceEpoch())).toUtf8();
+        if (exportCache::isCurrent(copyName, key)) {
+            continue;
+        }
+        if (exportCache::isActive()) {
+            // QFile::copy will not overwrite
+            QFile::remove(copyName);
+        }
+        QFile::copy(additionalFiles[i], copyName);
+        exportCache::written(copyName, key);
     }
 
     // store the new file name
@@ -257,6 +478,10 @@ bool projectObject::save_project(QString fileName, nl_rootdata * data)
     }
 
     this->undoStack->setClean();
+    if (this->recoveredChanges) {
+        this->recoveredChanges = false;
+        this->markChanged();
+    }
 
     return true;
 }
@@ -284,25 +509,44 @@ bool projectObject::import_network(QString fileName, cursorType cursorPos)
     project_dir.cdUp();
 
     // Set currentFileName
-    QSettings settings;
-    settings.setValue("files/currentFileName", project_dir.absolutePath());
+    settingsCache::setCurrentFileName(project_dir.absolutePath());
 
-    // get a list of all the files in the directory containing fileName
-    QStringList files = project_dir.entryList();
-
-    // load all the component files
+    // get a list of all the files in the directory containing fileName,
+    // and sort out the components and layouts from their first elements
+    QStringList files = project_dir.entryList(QDir::Files);
+    QStringList componentFiles;
+    QStringList layoutFiles;
     for (int i = 0; i < files.size(); ++i) {
-        if (isComponent(project_dir.absoluteFilePath(files[i]))) {
-            this->loadComponent(files[i], project_dir);
+        switch (sniffXmlFile(project_dir.absoluteFilePath(files[i]))) {
+        case xmlComponentFile:
+            componentFiles.push_back(files[i]);
+            break;
+        case xmlLayoutFile:
+            layoutFiles.push_back(files[i]);
+            break;
+        default:
+            break;
         }
     }
 
-    // load all the layout files
-    for (int i = 0; i < files.size(); ++i) {
-        if (isLayout(project_dir.absoluteFilePath(files[i]))) {
-            this->loadLayout(files[i], project_dir);
+    // parse just those, once, then load the component files followed by
+    // the layout files; any which are not well formed are skipped
+    QVector<QDomDocument> docs;
+    QVector<int> status;
+    parseXmlFiles(componentFiles, project_dir, docs, status);
+    for (int i = 0; i < componentFiles.size(); ++i) {
+        if (status[i] == xmlFileParsed) {
+            this->addComponent(componentFiles[i], docs[i], status[i]);
         }
     }
+    docs.clear();
+    parseXmlFiles(layoutFiles, project_dir, docs, status);
+    for (int i = 0; i < layoutFiles.size(); ++i) {
+        if (status[i] == xmlFileParsed) {
+            this->addLayout(layoutFiles[i], docs[i], status[i]);
+        }
+    }
+    docs.clear();
 
     int firstNewPop = this->network.size();
 
@@ -367,6 +611,8 @@ bool projectObject::import_network(QString fileName, cursorType cursorPos)
     printWarnings("Issues found importing the Network:");
     printErrors("Errors found importing the Network:");
 
+    this->startDeferredImports();
+
     return true;
 }
 
@@ -389,9 +635,7 @@ bool projectObject::load_project_file(QString fileName)
     // open the file
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("Could not open the project file");
-        msgBox.exec();
+        SCUtilities::showMessage("Could not open the project file");
         return false;
     }
 
@@ -599,17 +843,14 @@ bool projectObject::save_project_file(QString fileName)
 {
     // complain if there's no extension (client code should correctly set fileName)
     if (!fileName.contains(".")) {
-        QMessageBox msgBox;
-        msgBox.setText("Project file needs .proj suffix.");
-        msgBox.exec();
+        SCUtilities::showMessage("Project file needs .proj suffix.");
         return false;
     }
 
-    QFile file(fileName);
+    // written beside it and moved over it, as the other files are
+    QFile file(ioService::temporaryFileName(fileName));
     if (!file.open(QIODevice::WriteOnly)) {
-        QMessageBox msgBox;
-        msgBox.setText("Could not create the project file '" + fileName + "'");
-        msgBox.exec();
+        SCUtilities::showMessage("Could not create the project file '" + fileName + "'");
         return false;
     }
 
@@ -673,101 +914,73 @@ bool projectObject::save_project_file(QString fileName)
     }
 
     writer->writeEndElement(); // SpineCreatorProject
+    writer->writeEndDocument();
+
+    bool ok = !writer->hasError() && file.flush();
+    delete writer;
+    file.close();
+    if (!ok || !ioService::replaceFile(file.fileName(), fileName)) {
+        QFile::remove(file.fileName());
+        SCUtilities::showMessage("Could not write the project file '" + fileName + "' - is there sufficient disk space?");
+        return false;
+    }
 
     // add to version control
     if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(file.fileName());
+        this->version.addToVersion(fileName);
     }
 
     return true;
 }
 
-bool projectObject::isComponent(QString fileName)
+void projectObject::loadComponents(const QStringList& fileNames, QDir project_dir)
 {
-    // try opening the file and loading the XML
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return false;
-    }
-    if (!this->doc.setContent(&file)) {
-        return false;
-    }
-
-    // we have loaded the XML - discard the file handle
-    file.close();
+    QVector<QDomDocument> docs;
+    QVector<int> status;
+    parseXmlFiles(fileNames, project_dir, docs, status);
 
-    // confirm root tag is correct
-    QDomElement root = this->doc.documentElement();
-    if (root.tagName() != "SpineML" ) {
-        this->doc.clear();
-        return false;
-    }
-
-    // if a componentclass
-    QDomElement classType = root.firstChildElement();
-    if (classType.tagName() != "ComponentClass") {
-        this->doc.clear();
-        return false;
+    // add to the catalogs in the order of the project file, so that
+    // duplicates are resolved as they always were
+    for (int i = 0; i < fileNames.size(); ++i) {
+        this->addComponent(fileNames[i], docs[i], status[i]);
+        docs[i].clear();
     }
-
-    // clean up
-    this->doc.clear();
-    return true;
 }
 
-bool projectObject::isLayout(QString fileName)
+void projectObject::loadLayouts(const QStringList& fileNames, QDir project_dir)
 {
-    // try opening the file and loading the XML
-    QFile file(fileName);
-    if(!file.open(QIODevice::ReadOnly)) {
-        return false;
-    }
-    if(!this->doc.setContent(&file)) {
-        return false;
-    }
+    QVector<QDomDocument> docs;
+    QVector<int> status;
+    parseXmlFiles(fileNames, project_dir, docs, status);
 
-    // we have loaded the XML - discard the file handle
-    file.close();
-
-    // confirm root tag is correct
-    QDomElement root = this->doc.documentElement();
-    if (root.tagName() != "SpineML") {
-        this->doc.clear();
-        return false;
+    for (int i = 0; i < fileNames.size(); ++i) {
+        this->addLayout(fileNames[i], docs[i], status[i]);
+        docs[i].clear();
     }
-
-    // if a componentclass
-    QDomElement classType = root.firstChildElement();
-    if (classType.tagName() != "LayoutClass") {
-        this->doc.clear();
-        return false;
-    }
-
-    // clean up
-    this->doc.clear();
-
-    return true;
 }
 
 void projectObject::loadComponent(QString fileName, QDir project_dir)
+{
+    this->loadComponents(QStringList() << fileName, project_dir);
+}
+
+void projectObject::addComponent(const QString& fileName, QDomDocument& fileDoc, int status)
 {
     if (fileName == "none.xml") {
         return;
     }
 
-    // try opening the file and loading the XML
-    QFile file(project_dir.absoluteFilePath(fileName));
-    if (!file.open(QIODevice::ReadOnly)) {
+    if (status == xmlFileNotOpened) {
         addError("Cannot open required file '" + fileName + "'");
         return;
     }
-    if (!this->doc.setContent(&file)) {
+    if (status == xmlFileNotParsed) {
         addError("Cannot read required file '" + fileName + "'");
         return;
     }
 
     // confirm root tag is correct
-    QDomElement root = this->doc.documentElement();
+    QDomElement root = fileDoc.documentElement();
     if (root.tagName() != "SpineML" ) {
         addError("Missing or incorrect root tag in required file '" + fileName + "'");
         return;
@@ -783,7 +996,7 @@ void projectObject::loadComponent(QString fileName, QDir project_dir)
         // create a new AL class instance and populate it from the data
         QSharedPointer<Component>tempALobject = QSharedPointer<Component> (new Component());
 
-        tempALobject->load(&this->doc);
+        tempALobject->load(&fileDoc);
 
         // check for errors:
         QSettings settings;
@@ -831,63 +1044,28 @@ void projectObject::loadComponent(QString fileName, QDir project_dir)
     }
 }
 
-void projectObject::saveComponent(QString fileName, QDir project_dir, QSharedPointer<Component> component)
+void projectObject::loadLayout(QString fileName, QDir project_dir)
 {
-    // if no extension then append a .xml
-    if (!fileName.contains(".")) {
-        fileName.append(".xml");
-    }
-
-    QString fname = project_dir.absoluteFilePath(fileName);
-    QFile file(fname);
-    if (!file.open(QIODevice::WriteOnly)) {
-        addError("saveComponent: Error creating file for '" + fname + "' - is there sufficient disk space?");
-        return;
-    }
-
-    this->doc.setContent(QString(""));
-
-    // get the 9ML description
-    component->write(&this->doc);
-
-    // write out to file
-    QTextStream tsFromFile(&file );
-    tsFromFile << this->doc.toString();
-    tsFromFile.flush();
-
-    // add to version control
-    if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(file.fileName());
-    }
-
-    file.close();
-
-    // store path for easy access
-    component->filePath = project_dir.absoluteFilePath(fileName);
-
-    // kill off the DOM document
-    this->doc.clear();
+    this->loadLayouts(QStringList() << fileName, project_dir);
 }
 
-void projectObject::loadLayout(QString fileName, QDir project_dir)
+void projectObject::addLayout(const QString& fileName, QDomDocument& fileDoc, int status)
 {
     if (fileName == "none.xml") {
         return;
     }
 
-    // try opening the file and loading the XML
-    QFile file(project_dir.absoluteFilePath(fileName));
-    if (!file.open(QIODevice::ReadOnly)) {
+    if (status == xmlFileNotOpened) {
         addError("Cannot open required file '" + fileName + "'");
         return;
     }
-    if (!this->doc.setContent(&file)) {
+    if (status == xmlFileNotParsed) {
         addError("Cannot read required file '" + fileName + "'");
         return;
     }
 
     // confirm root tag is correct
-    QDomElement root = this->doc.documentElement();
+    QDomElement root = fileDoc.documentElement();
     if (root.tagName() != "SpineML" ) {
         addError("Missing or incorrect root tag in required file '" + fileName + "'");
         return;
@@ -903,7 +1081,7 @@ void projectObject::loadLayout(QString fileName, QDir project_dir)
             // create a new AL class instance and populate it from the data
             QSharedPointer<NineMLLayout>tempALobject = QSharedPointer<NineMLLayout> (new NineMLLayout());
 
-            tempALobject->load(&this->doc);
+            tempALobject->load(&fileDoc);
 
             // check for errors:
             QSettings settings;
@@ -935,43 +1113,6 @@ void projectObject::loadLayout(QString fileName, QDir project_dir)
 
 }
 
-void projectObject::saveLayout(QString fileName, QDir project_dir, QSharedPointer<NineMLLayout> layout)
-{
-    // if no extension then append a .xml
-    if (!fileName.contains(".")) {
-        fileName.append(".xml");
-    }
-
-    QFile file(project_dir.absoluteFilePath(fileName));
-    if (!file.open(QIODevice::WriteOnly)) {
-        addError("Error creating file for '" + fileName + "' - is there sufficient disk space?");
-        return;
-    }
-
-    this->doc.setContent(QString(""));
-
-    // get the 9ML description
-    layout->write(&this->doc);
-
-    // write out to file
-    QTextStream tsFromFile(&file);
-    tsFromFile << this->doc.toString();
-    tsFromFile.flush();
-
-    // add to version control
-    if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(file.fileName());
-    }
-
-    file.close();
-
-    // store path for easy access
-    layout->filePath = project_dir.absoluteFilePath(fileName);
-
-    // kill off the DOM document
-    this->doc.clear();
-}
-
 cursorType
 projectObject::getCursorPos (void)
 {
@@ -1107,6 +1248,7 @@ void projectObject::loadNetwork(QString fileName, QDir project_dir, bool isProje
 #endif
     n = this->doc.documentElement().firstChild();
     int counter = firstNewPop;
+    int numNewPops = this->network.size() - firstNewPop;
     while (!n.isNull()) {
 
         if (n.isComment()) {
@@ -1116,6 +1258,9 @@ void projectObject::loadNetwork(QString fileName, QDir project_dir, bool isProje
 
         QDomElement e = n.toElement();
         if (e.tagName() == "LL:Population" ) {
+            // the connection lists dominate the load time for large models
+            emit loadProgress ("Loading connectivity for population " + this->network[counter]->name,
+                               100 * (counter - firstNewPop) / qMax(numNewPops, 1));
             // with all the populations added, add the projections and join them up:
             this->network[counter]->load_projections_from_xml(e, &this->doc, &this->meta, this);
 #ifdef __DEBUG_LOAD_NETWORK
@@ -1204,7 +1349,9 @@ void projectObject::loadNetwork(QString fileName, QDir project_dir, bool isProje
 
 void projectObject::saveNetwork(QString fileName, QDir projectDir)
 {
-    QFile fileModel(projectDir.absoluteFilePath(fileName));
+    PROFILE_SCOPE("projectObject::saveNetwork");
+    QString modelFileName = projectDir.absoluteFilePath(fileName);
+    QFile fileModel(ioService::temporaryFileName(modelFileName));
     if (!fileModel.open(QIODevice::WriteOnly)) {
         addError("Error creating Network file - is there sufficient disk space?");
         return;
@@ -1244,26 +1391,103 @@ void projectObject::saveNetwork(QString fileName, QDir projectDir)
         xmlOut.writeEndElement();//LL:Annotation
     }
 
+    // report progress through the explicit connection lists, which
+    // dominate the save time for large models
+    QVector<csv_connection*> explicitConns = this->getExplicitConnections();
+    for (int i = 0; i < explicitConns.size(); ++i) {
+        connect(explicitConns[i], SIGNAL(progress(int)), this, SLOT(explicitDataProgress(int)));
+    }
+
+    // regenerate the scripted lists which have changed together, rather
+    // than one at a time as each is written
+    QVector<pythonscript_connection*> scripted;
+    for (int i = 0; i < explicitConns.size(); ++i) {
+        pythonscript_connection* pyConn = dynamic_cast<pythonscript_connection*> (explicitConns[i]->generator);
+        if (pyConn) {
+            scripted.push_back(pyConn);
+        }
+    }
+    pythonscript_connection::regenerateChanged(scripted);
+
     // create a node for each population with the variables set
     for (int pop = 0; pop < this->network.size(); ++pop) {
         // WE NEED TO HAVE A PROPER MODEL NAME!
+        this->explicitDataInProgress = this->network[pop]->name;
         this->network[pop]->write_population_xml(xmlOut);
     }
 
+    for (int i = 0; i < explicitConns.size(); ++i) {
+        disconnect(explicitConns[i], SIGNAL(progress(int)), this, SLOT(explicitDataProgress(int)));
+    }
+    this->explicitDataInProgress.clear();
+
     xmlOut.writeEndDocument();
 
+    bool ok = !xmlOut.hasError() && fileModel.flush();
+    fileModel.close();
+    if (!ok || !ioService::replaceFile(fileModel.fileName(), modelFileName)) {
+        QFile::remove(fileModel.fileName());
+        addError("Error creating Network file - is there sufficient disk space?");
+        return;
+    }
+
     // add to version control
     if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(fileModel.fileName());
+        this->version.addToVersion(modelFileName);
     }
 
-    fileModel.close();
-
     // Clean up stale explicit data binary files, by searching through
     // xmlOut and comparing with the files in the model dir.
     this->cleanUpStaleExplicitData(fileName, projectDir);
 }
 
+void projectObject::startDeferredImports (void)
+{
+    QVector<QSharedPointer<deferredStoreImport> > imports;
+    QVector<csv_connection*> conns = this->getExplicitConnections();
+    for (int i = 0; i < conns.size(); ++i) {
+        QSharedPointer<deferredStoreImport> job = conns[i]->getPendingImport();
+        if (job) {
+            imports.push_back(job);
+        }
+    }
+    deferredStoreImport::startInBackground(imports);
+}
+
+QVector<csv_connection*> projectObject::getExplicitConnections (void)
+{
+    QVector<csv_connection*> conns;
+
+    for (int i = 0; i < this->network.size(); ++i) {
+
+        QVector < QSharedPointer<genericInput> > inputs = this->network[i]->neuronType->inputs;
+
+        for (int j = 0; j < this->network[i]->projections.size(); ++j) {
+            for (int k = 0; k < this->network[i]->projections[j]->synapses.size(); ++k) {
+                QSharedPointer<synapse> syn = this->network[i]->projections[j]->synapses[k];
+                if (syn->connectionType->type == CSV) {
+                    conns.push_back((csv_connection*)syn->connectionType);
+                }
+                inputs += syn->weightUpdateCmpt->inputs;
+                inputs += syn->postSynapseCmpt->inputs;
+            }
+        }
+
+        for (int j = 0; j < inputs.size(); ++j) {
+            if (inputs[j]->conn != NULL && inputs[j]->conn->type == CSV) {
+                conns.push_back((csv_connection*)inputs[j]->conn);
+            }
+        }
+    }
+
+    return conns;
+}
+
+void projectObject::explicitDataProgress (int percent)
+{
+    emit saveProgress ("Saving connectivity for population " + this->explicitDataInProgress, percent);
+}
+
 void projectObject::cleanUpStaleExplicitData(QString& fileName, QDir& projectDir)
 {
     // Make a list of all the explicitDataBinaryFiles in the model.
@@ -1379,31 +1603,6 @@ bool projectObject::doesExperimentExist (experiment* e)
     return false;
 }
 
-void projectObject::saveExperiment(QString fileName, QDir project_dir, experiment * expt)
-{
-    QString absPath = project_dir.absoluteFilePath(fileName);
-    QFile file (absPath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        addError("Error creating file '" + absPath + "' - is there sufficient disk space?");
-        return;
-    }
-
-    // use stream writer
-    QXmlStreamWriter * xmlOutExpt = new QXmlStreamWriter;
-    xmlOutExpt->setDevice(&(file));
-
-    expt->writeXML(xmlOutExpt, this);
-
-    delete xmlOutExpt;
-
-    file.close();
-
-    // add to version control
-    if (this->version.isModelUnderVersion()) {
-        this->version.addToVersion(fileName);
-    }
-}
-
 void projectObject::copy_back_data(nl_rootdata * data)
 {
     // copy data from rootData to project
@@ -1420,6 +1619,7 @@ void projectObject::copy_back_data(nl_rootdata * data)
 void projectObject::copy_out_data(nl_rootdata * data)
 {
     // copy from project to rootData
+    data->invalidateRouting();
     data->populations = this->network;
     data->catalogNrn = this->catalogNB;
     data->catalogWU = this->catalogWU;
@@ -1450,9 +1650,9 @@ void projectObject::select_project(nl_rootdata * data)
     copy_out_data(data);
 
     QSettings settings;
-    settings.remove("files/currentFileName");
+    settingsCache::removeCurrentFileName();
     if (this->filePath != "") {
-        settings.setValue("files/currentFileName", this->filePath);
+        settingsCache::setCurrentFileName(this->filePath);
     }
     settings.setValue("model/model_name", "New Project");
 
@@ -1466,11 +1666,7 @@ void projectObject::select_project(nl_rootdata * data)
 
     // visualiser view - configure TreeView
     if (data->main->viewVZ.OpenGLWidget != NULL) {
-        if (!(data->main->viewVZ.sysModel == NULL)) {
-            delete data->main->viewVZ.sysModel;
-        }
-        data->main->viewVZ.sysModel = new systemmodel(data);
-        data->main->viewVZ.treeView->setModel(data->main->viewVZ.sysModel);
+        data->main->configureSystemModel();
         data->main->viewVZhandler->restoreTreeState();
     }
 
@@ -1554,11 +1750,7 @@ bool projectObject::printWarnings(QString title)
     // display warnings:
     if (!warns.isEmpty()) {
         // display warnings
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>" + title + "</b></P>" + warns);
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.exec();
+        SCUtilities::showMessage("<P><b>" + title + "</b></P>" + warns, QMessageBox::Critical, true);
     }
 
     return true;
@@ -1587,6 +1779,7 @@ bool projectObject::printErrors(QString title)
         // clear errors
         settings.remove("errors");
         settings.setProperty("MERR", QString("True"));
+        ++this->errorsShown;
 
     } else {
         return false;
@@ -1596,11 +1789,7 @@ bool projectObject::printErrors(QString title)
         // Display errors. (Seb has observed one hang here where the
         // msgBox failed to show when there was a project error.
         DBG() << "Errors in SC_projectobject.cpp: " << errors;
-        QMessageBox msgBox;
-        msgBox.setText("<P><b>" + title + "</b></P>" + errors);
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.setTextFormat(Qt::RichText);
-        msgBox.exec();
+        SCUtilities::showMessage("<P><b>" + title + "</b></P>" + errors, QMessageBox::Critical, true);
     }
 
     return true;
@@ -1630,29 +1819,46 @@ void projectObject::addWarning(QString text)
 
 bool projectObject::isChanged(nl_rootdata * data)
 {
-    if (data->currProject == this) {
-        copy_back_data(data);
-    }
-    if (!this->undoStack->isClean()) {
-         return true;
-    }
-    for (int i = 1; i < this->catalogNB.size(); ++i) {
-        if (!this->catalogNB[i]->undoStack.isClean())
-            return true;
-    }
-    for (int i = 1; i < this->catalogWU.size(); ++i) {
-        if (!this->catalogWU[i]->undoStack.isClean())
-            return true;
-    }
-    for (int i = 1; i < this->catalogPS.size(); ++i) {
-        if (!this->catalogPS[i]->undoStack.isClean())
-            return true;
-    }
-    for (int i = 1; i < this->catalogGC.size(); ++i) {
-        if (!this->catalogGC[i]->undoStack.isClean())
-            return true;
+    // the current project's catalogues are held by data until it is
+    // deselected; they are read there rather than copied back
+    bool current = (data->currProject == this);
+    const QVector < QSharedPointer<Component> > * catalogs[4] = {
+        current ? &data->catalogNrn : &this->catalogNB,
+        current ? &data->catalogWU : &this->catalogWU,
+        current ? &data->catalogPS : &this->catalogPS,
+        current ? &data->catalogUnsorted : &this->catalogGC
+    };
+
+    QVector <int> sizes(4);
+    for (int c = 0; c < 4; ++c) {
+        sizes[c] = catalogs[c]->size();
+    }
+    if (this->checkedGeneration == this->changeGeneration && this->checkedCatalogSizes == sizes) {
+        return this->checkedChanged;
+    }
+
+    this->checkedGeneration = this->changeGeneration;
+    this->checkedCatalogSizes = sizes;
+    this->checkedChanged = this->recoveredChanges || !this->undoStack->isClean();
+    for (int c = 0; c < 4 && !this->checkedChanged; ++c) {
+        for (int i = 1; i < catalogs[c]->size(); ++i) {
+            if (!(*catalogs[c])[i]->undoStack.isClean()) {
+                this->checkedChanged = true;
+                break;
+            }
+        }
     }
-    return false;
+    return this->checkedChanged;
+}
+
+void projectObject::markChanged()
+{
+    ++this->changeGeneration;
+}
+
+void projectObject::modelEdited()
+{
+    ++this->modelGeneration;
 }
 
 // allow safe usage of systemObject pointers
@@ -1823,3 +2029,100 @@ QString projectObject::getUniquePopName(QString newName)
 
     return newName;
 }
+
+/////// EXPORT CACHE
+
+namespace {
+    struct exportedFile
+    {
+        QByteArray key;
+        qint64 size;
+        QDateTime modified;
+    };
+
+    // what was written by earlier exports, by absolute file path
+    QMap<QString, exportedFile> exportedFiles;
+    // files written or kept by the export in progress
+    QSet<QString> claimedExportFiles;
+    QString exportDir;
+    // experiments are written on the pool, and note their files here
+    QMutex exportLock;
+}
+
+void exportCache::begin(const QString &dirPath)
+{
+    QMutexLocker locker(&exportLock);
+    exportDir = QDir(dirPath).absolutePath();
+    claimedExportFiles.clear();
+}
+
+void exportCache::end()
+{
+    QMutexLocker locker(&exportLock);
+    if (exportDir.isEmpty()) {
+        return;
+    }
+    QDir dir(exportDir);
+    QStringList files = dir.entryList(QDir::Files);
+    for (int i = 0; i < files.size(); ++i) {
+        QString fileName = dir.absoluteFilePath(files[i]);
+        if (!claimedExportFiles.contains(fileName)) {
+            dir.remove(files[i]);
+            exportedFiles.remove(fileName);
+        }
+    }
+    claimedExportFiles.clear();
+    exportDir.clear();
+}
+
+bool exportCache::isActive()
+{
+    QMutexLocker locker(&exportLock);
+    return !exportDir.isEmpty();
+}
+
+bool exportCache::isCurrent(const QString &fileName, const QByteArray &key)
+{
+    QMutexLocker locker(&exportLock);
+    if (exportDir.isEmpty() || key.isEmpty()) {
+        return false;
+    }
+    QString absName = QFileInfo(fileName).absoluteFilePath();
+    QMap<QString, exportedFile>::const_iterator it = exportedFiles.constFind(absName);
+    if (it == exportedFiles.constEnd() || it->key != key) {
+        return false;
+    }
+    // check nothing else has changed the file since we wrote it
+    QFileInfo info(absName);
+    if (!info.exists() || info.size() != it->size || info.lastModified() != it->modified) {
+        return false;
+    }
+    claimedExportFiles.insert(absName);
+    return true;
+}
+
+void exportCache::written(const QString &fileName, const QByteArray &key)
+{
+    QMutexLocker locker(&exportLock);
+    if (exportDir.isEmpty()) {
+        return;
+    }
+    QFileInfo info(fileName);
+    QString absName = info.absoluteFilePath();
+    claimedExportFiles.insert(absName);
+    if (key.isEmpty()) {
+        exportedFiles.remove(absName);
+        return;
+    }
+    exportedFile record;
+    record.key = key;
+    record.size = info.size();
+    record.modified = info.lastModified();
+    exportedFiles.insert(absName, record);
+}
+
+bool exportCache::isClaimed(const QString &fileName)
+{
+    QMutexLocker locker(&exportLock);
+    return claimedExportFiles.contains(QFileInfo(fileName).absoluteFilePath());
+}
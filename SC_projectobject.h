@@ -66,8 +66,19 @@ public:
 
     // errors
     void printIssues(QString);
+    /*!
+     * The number of times printErrors() has found errors to show, so
+     * that a caller without a GUI can tell if opening reported any.
+     */
+    int errorsShown;
 
     // general helpers
+    /*!
+     * True if the project or one of its components has unsaved changes.
+     * This only looks at the undo stacks again after one of them has
+     * become clean or unclean, or a component catalogue has changed size,
+     * so it can be asked on every title update.
+     */
     bool isChanged(nl_rootdata *);
     bool isValidPointer(QSharedPointer<systemObject>);
     bool isValidPointer(QSharedPointer <ComponentInstance>);
@@ -135,6 +146,19 @@ public:
     // features
     versionControl version;
     QUndoStack * undoStack;
+    /*!
+     * Set when unsaved changes have been recovered from an autosave
+     * journal into the project, which then counts as changed until it is
+     * next saved; see autosaver.
+     */
+    bool recoveredChanges;
+
+    /*!
+     * Bumped by modelEdited(), as each command is pushed, undone or redone
+     * on the project's undo stack, so that what is worked out from the
+     * network (as nl_rootdata's routing index) knows when it is stale.
+     */
+    quint64 modelGeneration;
 
     // state of the visualizer QTreeWidget
     QStringList treeWidgetState;
@@ -146,21 +170,26 @@ public:
     // about this object.
     QString annotation;
 
+    /*!
+     * Gather every explicit list connection in the network, from
+     * synapses and from generic inputs.
+     */
+    QVector<csv_connection*> getExplicitConnections (void);
+
 private:
 
     cursorType currentCursorPos;
 
     // load helpers
-    bool isComponent(QString);
-    bool isLayout(QString);
     void loadComponent(QString, QDir);
-    void saveComponent(QString, QDir, QSharedPointer<Component>);
+    void loadComponents(const QStringList&, QDir);
+    void addComponent(const QString&, QDomDocument&, int);
     void loadLayout(QString, QDir);
-    void saveLayout(QString, QDir, QSharedPointer<NineMLLayout>);
+    void loadLayouts(const QStringList&, QDir);
+    void addLayout(const QString&, QDomDocument&, int);
     void loadNetwork(QString, QDir, bool isProject = true);
     void saveNetwork(QString, QDir);
     void loadExperiment(QString, QDir, bool skipFileError = false);
-    void saveExperiment(QString, QDir, experiment *);
 
     // error handling
     bool printWarnings(QString);
@@ -188,10 +217,94 @@ private:
     QDomDocument meta;
 #endif
 
+    /*!
+     * Hand the explicit list copies still pending from the last load to
+     * the thread pool.
+     */
+    void startDeferredImports (void);
+
+    /*!
+     * The explicit connection currently being written by saveNetwork,
+     * used to label progress messages.
+     */
+    QString explicitDataInProgress;
+
+    /*!
+     * Bumped by markChanged(); isChanged() keeps its answer, and the
+     * catalogue sizes it was found with, until this moves on.
+     */
+    //@{
+    quint64 changeGeneration;
+    quint64 checkedGeneration;
+    bool checkedChanged;
+    QVector <int> checkedCatalogSizes;
+    //@}
+
 signals:
+    /*!
+     * Emitted during a save to report the progress of long running
+     * steps, such as writing large explicit connection lists.
+     */
+    void saveProgress (QString, int);
+    /*!
+     * Emitted while the network is loaded, as the projections of each
+     * population, with their connection lists, are read.
+     */
+    void loadProgress (QString, int);
 
 public slots:
+    /*!
+     * Connected to csv_connection::progress while the network is
+     * saved. Re-emitted as saveProgress.
+     */
+    void explicitDataProgress (int percent);
+
+    /*!
+     * Note that the clean state of one of the project's undo stacks may
+     * have changed. Connected to the cleanChanged signals of the project's
+     * undo stack and of the component undo stacks as they are edited.
+     */
+    void markChanged ();
+
+    /*!
+     * Connected to the indexChanged signal of the project's undo stack.
+     */
+    void modelEdited ();
+};
 
+/*!
+ * \brief The exportCache class lets a model be written repeatedly into the
+ * same directory (the temporary directory an experiment is run from), while
+ * only rewriting the files whose content has changed.
+ *
+ * Between begin() and end(), writers of large files pass a key describing
+ * the content they would write to isCurrent(); if the file already holds that
+ * content it is kept and need not be written. After writing a file, writers
+ * call written(). end() removes every file in the directory that was neither
+ * kept nor written, so the directory holds exactly the model just exported.
+ * Outside an export, isCurrent() is always false and written() does nothing.
+ */
+class exportCache
+{
+public:
+    static void begin(const QString &dirPath);
+    static void end();
+    static bool isActive();
+    /*!
+     * True, and the file kept, if fileName was written by an earlier export
+     * with the same key and has not been changed since.
+     */
+    static bool isCurrent(const QString &fileName, const QByteArray &key);
+    /*!
+     * Record that fileName has been written this export with content
+     * described by key. An empty key is never current, so the file is
+     * kept for this export only.
+     */
+    static void written(const QString &fileName, const QByteArray &key = QByteArray());
+    /*!
+     * True if fileName has been kept or written so far in this export.
+     */
+    static bool isClaimed(const QString &fileName);
 };
 
 #endif // PROJECTOBJECT_H
@@ -26,7 +26,9 @@
 #include "ui_generate_dialog.h"
 #include "NL_population.h"
 #include "NL_connection.h"
+#include "NL_kernelconnectivity.h"
 #include "SC_network_3d_visualiser_panel.h"
+#include "SC_utilities.h"
 
 
 generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPointer <population> src, QSharedPointer <population> dst, QVector < conn > &conns, QMutex * mutex, QWidget *parent) :
@@ -36,6 +38,9 @@ generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPoin
     ui->setupUi(this);
 
     this->setWindowTitle("Generate connections using Python");
+    ui->caption->setText("Generating " + currConn->scriptName);
+    // busy until the script reports how far it has got
+    ui->progressBar->setRange(0, 0);
 
     // generating connectivity
 
@@ -44,6 +49,13 @@ generate_dialog::generate_dialog(pythonscript_connection * currConn, QSharedPoin
     currConn->dstPop = dst;
     currConn->conns = &conns;
     currConn->mutex = mutex;
+    this->conns = &conns;
+    this->worker = (connectionGenerationWorker *) 0;
+    this->workerThread = (QThread *) 0;
+    this->cancelling = false;
+
+    this->progressTimer = new QTimer(this);
+    connect(progressTimer, SIGNAL(timeout()), this, SLOT(showProgress()));
 
 
 
@@ -75,10 +87,59 @@ void generate_dialog::doPython() {
     pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
     CHECK_CAST(currConnPy)
 
-    currConnPy->generate_connections();
-
+    // the layouts are generated here, as they belong to the populations
+    currConnPy->errorLog.clear();
+    currConnPy->pythonErrors.clear();
+    currConnPy->srcPop->layoutType->generateLayout(currConnPy->srcPop->numNeurons, &currConnPy->srcPop->layoutType->locations, currConnPy->errorLog);
+    if (currConnPy->errorLog.isEmpty()) {
+        currConnPy->dstPop->layoutType->generateLayout(currConnPy->dstPop->numNeurons, &currConnPy->dstPop->layoutType->locations, currConnPy->errorLog);
+    }
     if (!currConnPy->errorLog.isEmpty()) {
         ui->errors->setText(currConnPy->errorLog);
+        return;
+    }
+
+    worker = new connectionGenerationWorker(currConnPy, currConnPy->srcPop->layoutType->locations, currConnPy->dstPop->layoutType->locations);
+    workerThread = new QThread(this);
+    worker->moveToThread(workerThread);
+    connect(worker, SIGNAL(finished()), this, SLOT(pythonDone()));
+    workerThread->start();
+    QMetaObject::invokeMethod(worker, "generate", Qt::QueuedConnection);
+
+    progressTimer->start(100);
+}
+
+void generate_dialog::showProgress() {
+
+    pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
+    CHECK_CAST(currConnPy)
+
+    int progress = currConnPy->generationProgress();
+    if (progress >= 0) {
+        ui->progressBar->setRange(0, 100);
+        ui->progressBar->setValue(progress);
+    }
+}
+
+void generate_dialog::pythonDone() {
+
+    progressTimer->stop();
+    workerThread->quit();
+    workerThread->wait();
+
+    pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
+    CHECK_CAST(currConnPy)
+
+    // the worker generated into a result of its own, stored here
+    currConnPy->conns = this->conns;
+    currConnPy->applyGeneration(worker->job);
+    worker->deleteLater();
+    worker = (connectionGenerationWorker *) 0;
+
+    if (cancelling) {
+        QDialog::reject();
+    } else if (!currConnPy->errorLog.isEmpty()) {
+        ui->errors->setText(currConnPy->errorLog);
     } else if (!currConnPy->pythonErrors.isEmpty()) {
         ui->errors->setText(currConnPy->pythonErrors);
     } else {
@@ -86,17 +147,29 @@ void generate_dialog::doPython() {
         ParameterInstance * par = currConnPy->getPropPointer();
         if (par && currConnPy->hasWeight) {
             par->currType = ExplicitList;
-            par->value = currConnPy->weights;
-            par->indices.clear();
-            for (int i = 0; i < currConnPy->weights.size(); ++i) {
-                par->indices.push_back(i);
-            }
+            par->setDenseValues(currConnPy->weights);
         }
         this->accept();
     }
 
 }
 
+/*!
+ * Cancel stops the script first; the dialog closes once it has.
+ */
+void generate_dialog::reject() {
+
+    if (worker) {
+        pythonscript_connection * currConnPy = dynamic_cast <pythonscript_connection *> (currConn);
+        CHECK_CAST(currConnPy)
+        ui->caption->setText("Cancelling " + currConnPy->scriptName);
+        cancelling = true;
+        currConnPy->cancelGeneration();
+        return;
+    }
+    QDialog::reject();
+}
+
 void generate_dialog::moveFromThread() {
     //currConn->moveToThread(QApplication::instance()->thread());
     workerThread->exit();
@@ -136,5 +209,29 @@ void generate_dialog::moveFromThread() {
 
 generate_dialog::~generate_dialog()
 {
+    if (workerThread) {
+        workerThread->quit();
+        workerThread->wait();
+    }
     delete ui;
 }
+
+connectionGenerationWorker::connectionGenerationWorker(pythonscript_connection * currConn, const QVector <loc> &srcLocs, const QVector <loc> &dstLocs) :
+    QObject()
+{
+    this->currConn = currConn;
+    currConn->beginGeneration(job, srcLocs, dstLocs);
+    // made on the GUI thread, which Python should be started on, unless
+    // the connection is a kernel generated without it
+    if (!kernelConnectivity::isKernelScript(currConn->scriptText)) {
+        SCUtilities::initPython();
+    }
+}
+
+void connectionGenerationWorker::generate()
+{
+    // nothing of the connection is touched here
+    pythonscript_connection::runGeneration(job);
+
+    emit finished();
+}
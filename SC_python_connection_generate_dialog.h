@@ -26,7 +26,9 @@
 #define GENERATE_DIALOG_H
 
 #include <QDialog>
+#include <QPointer>
 #include "globalHeader.h"
+#include "NL_connection.h"
 
 namespace Ui {
 class generate_dialog;
@@ -36,6 +38,8 @@ class generate_dialog;
  * \brief The generate_dialog class alerts the user that python cnnectivity is being generated
  *
  */
+class connectionGenerationWorker;
+
 class generate_dialog : public QDialog
 {
     Q_OBJECT
@@ -49,10 +53,45 @@ private:
     Ui::generate_dialog *ui;
     connection * currConn;
     QThread *workerThread;
+    // the script runs on workerThread, so the dialog can show its progress
+    // and cancel it
+    connectionGenerationWorker * worker;
+    QVector <conn> * conns;
+    QTimer * progressTimer;
+    bool cancelling;
 
 public slots:
     void moveFromThread();
     void doPython();
+    void reject();
+
+private slots:
+    void showProgress();
+    void pythonDone();
+};
+
+/*!
+ * \brief The connectionGenerationWorker class runs a python connection script
+ * on a background thread, from copies of the population locations, so that
+ * the caller's thread is not blocked while the script runs. The script only
+ * fills job, which is left for the GUI thread to apply to the connection
+ * when finished() is emitted; the connection may be deleted meanwhile, in
+ * which case currConn is null.
+ */
+class connectionGenerationWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit connectionGenerationWorker(pythonscript_connection * currConn, const QVector <loc> &srcLocs, const QVector <loc> &dstLocs);
+    QPointer <pythonscript_connection> currConn;
+    connectionGeneration job;
+
+public slots:
+    void generate();
+
+signals:
+    void finished();
 };
 
 #endif // GENERATE_DIALOG_H
@@ -0,0 +1,103 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_residency.h"
+#include "SC_settings.h"
+#include <QCoreApplication>
+#include <QVector>
+#include <QPair>
+#include <algorithm>
+
+residencyManager * residencyManager::instance = (residencyManager *) 0;
+QMutex residencyManager::lock;
+QHash <const residentData *, qint64> residencyManager::lastUse;
+qint64 residencyManager::useCount = 0;
+qint64 residencyManager::queuedAt = 0;
+bool residencyManager::trimQueued = false;
+
+residentData::~residentData()
+{
+    residencyManager::forget(this);
+}
+
+void residencyManager::touch(const residentData * data)
+{
+    QMutexLocker locker(&lock);
+    lastUse[data] = ++useCount;
+    if (trimQueued || QCoreApplication::instance() == (QCoreApplication *) 0) {
+        return;
+    }
+    if (instance == (residencyManager *) 0) {
+        // made on whichever thread touches first, and handed to the GUI
+        // thread so that trim() runs from its event loop
+        instance = new residencyManager();
+        instance->moveToThread(QCoreApplication::instance()->thread());
+    }
+    trimQueued = true;
+    queuedAt = useCount;
+    QMetaObject::invokeMethod(instance, "trim", Qt::QueuedConnection);
+}
+
+void residencyManager::forget(const residentData * data)
+{
+    QMutexLocker locker(&lock);
+    lastUse.remove(data);
+}
+
+void residencyManager::trim()
+{
+    qint64 limit = (qint64) settingsCache::residentLimitMB() * 1024 * 1024;
+
+    // the data which may be let go, least recently used first
+    QVector < QPair <qint64, const residentData *> > cold;
+    qint64 total = 0;
+    {
+        QMutexLocker locker(&lock);
+        trimQueued = false;
+        for (QHash <const residentData *, qint64>::const_iterator it = lastUse.begin(); it != lastUse.end(); ++it) {
+            total += it.key()->residentBytes();
+            if (it.value() < queuedAt) {
+                cold.push_back(qMakePair(it.value(), it.key()));
+            }
+        }
+    }
+    if (limit <= 0 || total <= limit) {
+        return;
+    }
+    std::sort(cold.begin(), cold.end());
+
+    // data is only deleted on this thread, so what is in cold stays valid
+    for (int i = 0; i < cold.size() && total > limit; ++i) {
+        residentData * data = const_cast <residentData *> (cold[i].second);
+        total -= data->residentBytes();
+        data->evictResident();
+        total += data->residentBytes();
+        QMutexLocker locker(&lock);
+        // unless it has been used again meanwhile on another thread
+        if (lastUse.value(data) == cold[i].first) {
+            lastUse.remove(data);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_RESIDENCY_H
+#define SC_RESIDENCY_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+
+/*!
+ * \brief The residentData class is data held in memory that can be let go
+ * and read back from disk when it is next used, such as the mapped backing
+ * store and index of an explicit connection list or the columns read from
+ * a log. It is tracked by the residencyManager once it has been touched.
+ */
+class residentData
+{
+public:
+    residentData() {}
+    virtual ~residentData();
+
+    /*!
+     * The memory held now, which evictResident() would let go of.
+     */
+    virtual qint64 residentBytes (void) const = 0;
+
+    /*!
+     * Let go of what is held. It must be read back when next used, so
+     * nothing is lost.
+     */
+    virtual void evictResident (void) = 0;
+};
+
+/*!
+ * \brief The residencyManager class bounds the memory held by the
+ * residentData in use to settingsCache::residentLimitMB(), letting go of
+ * the least recently used first.
+ *
+ * touch() may be called from any thread and only notes the use. The memory
+ * is checked afterwards, from the event loop of the GUI thread, so that
+ * nothing is let go while a caller may still hold pointers into it; what
+ * was touched since the last check is kept, however large.
+ */
+class residencyManager : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * Note that data has just been used.
+     */
+    static void touch (const residentData * data);
+
+    /*!
+     * Stop tracking data, which is being deleted.
+     */
+    static void forget (const residentData * data);
+
+private slots:
+    void trim (void);
+
+private:
+    residencyManager() {}
+    static residencyManager * instance;
+    static QMutex lock;
+    // the last use of each data tracked, by useCount
+    static QHash <const residentData *, qint64> lastUse;
+    static qint64 useCount;
+    // whether a check is queued, and useCount when it was; what has been
+    // used since is kept
+    static qint64 queuedAt;
+    static bool trimQueued;
+};
+
+#endif // SC_RESIDENCY_H
@@ -0,0 +1,232 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#include "SC_runcache.h"
+#include "SC_profiler.h"
+#include <QCryptographicHash>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QStandardPaths>
+#endif
+
+namespace {
+    QDir cacheRoot()
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+        QDir lib_dir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+        QDir lib_dir = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+        return QDir(lib_dir.absoluteFilePath(RUN_CACHE_DIR));
+    }
+
+    void removeFiles(const QDir &dir)
+    {
+        QStringList files = dir.entryList(QDir::Files | QDir::System | QDir::Hidden);
+        for (int i = 0; i < files.size(); ++i) {
+            dir.remove(files[i]);
+        }
+    }
+
+    void removeEntry(const QString &dirName)
+    {
+        QDir root = cacheRoot();
+        removeFiles(QDir(root.absoluteFilePath(dirName)));
+        root.rmdir(dirName);
+    }
+
+    bool copyFiles(const QDir &from, const QDir &to, const QString &skip)
+    {
+        QStringList files = from.entryList(QDir::Files);
+        for (int i = 0; i < files.size(); ++i) {
+            if (files[i] == skip) {
+                continue;
+            }
+            QFile::remove(to.absoluteFilePath(files[i]));
+            if (!QFile::copy(from.absoluteFilePath(files[i]), to.absoluteFilePath(files[i]))) {
+                DBG() << "Could not copy" << from.absoluteFilePath(files[i]) << "to" << to.absolutePath();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void stamp(const QDir &entry)
+    {
+        // a new file, so the entry's modification time moves too
+        QFile::remove(entry.absoluteFilePath(RUN_CACHE_STAMP_FILE));
+        QFile f(entry.absoluteFilePath(RUN_CACHE_STAMP_FILE));
+        f.open(QIODevice::WriteOnly);
+    }
+
+    qint64 bytesIn(const QDir &dir)
+    {
+        qint64 total = 0;
+        QFileInfoList files = dir.entryInfoList(QDir::Files);
+        for (int i = 0; i < files.size(); ++i) {
+            total += files[i].size();
+        }
+        return total;
+    }
+}
+
+bool runResultCache::isEnabled()
+{
+    QSettings settings;
+    return settings.value("runCache/enabled", true).toBool();
+}
+
+QByteArray runResultCache::hashOfFile(const QString &filePath)
+{
+    QString canonical = QFileInfo(filePath).canonicalFilePath();
+    if (this->fileHashes.contains(canonical)) {
+        return this->fileHashes[canonical];
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QFile f(canonical);
+    if (f.open(QIODevice::ReadOnly)) {
+        while (!f.atEnd()) {
+            hash.addData(f.read(1 << 20));
+        }
+    }
+    QByteArray result = hash.result();
+    this->fileHashes[canonical] = result;
+    return result;
+}
+
+QByteArray runResultCache::keyFor(const QString &modelDir, int exptNum, const QString &simName)
+{
+    PROFILE_SCOPE("runResultCache::keyFor");
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    // the model, with its experiments
+    QDir dir(modelDir);
+    QStringList files = dir.entryList(QDir::Files, QDir::Name);
+    for (int i = 0; i < files.size(); ++i) {
+        hash.addData(files[i].toUtf8());
+        hash.addData(this->hashOfFile(dir.absoluteFilePath(files[i])));
+    }
+    hash.addData(("experiment:" + QString::number(exptNum)).toUtf8());
+
+    // and the simulator
+    QSettings settings;
+    settings.beginGroup("simulators/" + simName);
+    QStringList keys = settings.allKeys();
+    keys.sort();
+    for (int i = 0; i < keys.size(); ++i) {
+        hash.addData((keys[i] + "=" + settings.value(keys[i]).toString() + "\n").toUtf8());
+    }
+    QFileInfo script(settings.value("path").toString().split(" ").last());
+    settings.endGroup();
+    hash.addData((simName + ":" + QString::number(script.size()) + ":"
+                  + script.lastModified().toString(Qt::ISODate)).toUtf8());
+
+    return hash.result().toHex();
+}
+
+bool runResultCache::restore(const QByteArray &key, const QString &logDir, QString &output)
+{
+    PROFILE_SCOPE("runResultCache::restore");
+    QDir entry(cacheRoot().absoluteFilePath(QString(key)));
+    if (key.isEmpty() || !entry.exists()) {
+        return false;
+    }
+
+    QDir logs(logDir);
+    if (!QDir().mkpath(logs.absolutePath())) {
+        return false;
+    }
+    // the logs of the last run are not those of this one
+    removeFiles(logs);
+    if (!copyFiles(entry, logs, RUN_CACHE_OUTPUT_FILE)) {
+        removeFiles(logs);
+        return false;
+    }
+    QFile::remove(logs.absoluteFilePath(RUN_CACHE_STAMP_FILE));
+
+    QFile out(entry.absoluteFilePath(RUN_CACHE_OUTPUT_FILE));
+    if (out.open(QIODevice::ReadOnly)) {
+        output = QString::fromUtf8(out.readAll());
+    }
+    stamp(entry);
+    return true;
+}
+
+void runResultCache::store(const QByteArray &key, const QString &logDir, const QString &output)
+{
+    PROFILE_SCOPE("runResultCache::store");
+    QDir logs(logDir);
+    if (key.isEmpty() || !logs.exists() || bytesIn(logs) > (qint64) RUN_CACHE_MAX_MB * 1024 * 1024) {
+        return;
+    }
+
+    // written under another name, so that an entry is whole or not there
+    QDir root = cacheRoot();
+    QString name(key);
+    QString partName = name + ".part";
+    removeEntry(partName);
+    if (!root.mkpath(partName)) {
+        DBG() << "Could not create the run cache entry" << root.absoluteFilePath(partName);
+        return;
+    }
+    QDir part(root.absoluteFilePath(partName));
+    if (!copyFiles(logs, part, QString())) {
+        removeEntry(partName);
+        return;
+    }
+    QFile out(part.absoluteFilePath(RUN_CACHE_OUTPUT_FILE));
+    if (out.open(QIODevice::WriteOnly)) {
+        out.write(output.toUtf8());
+        out.close();
+    }
+    stamp(part);
+
+    removeEntry(name);
+    if (!root.rename(partName, name)) {
+        removeEntry(partName);
+        return;
+    }
+    evict();
+}
+
+void runResultCache::evict()
+{
+    QDir root = cacheRoot();
+    QFileInfoList entries = root.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time);
+
+    // newest first; keep them until the limits are reached
+    qint64 limit = (qint64) RUN_CACHE_MAX_MB * 1024 * 1024;
+    qint64 total = 0;
+    int kept = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        qint64 bytes = bytesIn(QDir(entries[i].absoluteFilePath()));
+        if (!entries[i].fileName().endsWith(".part") && kept < RUN_CACHE_MAX_ENTRIES && total + bytes <= limit) {
+            total += bytes;
+            ++kept;
+            continue;
+        }
+        removeEntry(entries[i].fileName());
+    }
+}
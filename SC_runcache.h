@@ -0,0 +1,93 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+
+#ifndef SC_RUNCACHE_H
+#define SC_RUNCACHE_H
+
+#include "globalHeader.h"
+
+// the directory, within the application's data directory, holding the logs
+// of earlier runs
+#define RUN_CACHE_DIR "runcache"
+// the most runs kept, and the most disk (MB) their logs may take; the least
+// recently used go first
+#define RUN_CACHE_MAX_ENTRIES 16
+#define RUN_CACHE_MAX_MB 4096
+// the simulator's output, kept with the logs
+#define RUN_CACHE_OUTPUT_FILE "simulator_output.txt"
+// touched when an entry is stored or used, to order entries for eviction
+#define RUN_CACHE_STAMP_FILE "last_used"
+
+/*!
+ * \brief The runResultCache class keeps the logs of simulator runs, keyed by
+ * everything the run depends on, so that running an identical experiment
+ * again restores its logs rather than simulating it again.
+ *
+ * The key is a hash of every file of the exported model (which includes the
+ * experiment files), the number of the experiment run, and the settings of
+ * the simulator under simulators/<name>, with the size and time of its
+ * convert_script. An object holds the hashes of the files it has read, so
+ * the files shared by the runs of a batch are read once.
+ */
+class runResultCache
+{
+public:
+    /*!
+     * False if runCache/enabled has been set false, for models which are
+     * meant to give a different result each run.
+     */
+    static bool isEnabled();
+
+    /*!
+     * The key of a run of experiment exptNum of the model exported in
+     * modelDir, with the simulator simName.
+     */
+    QByteArray keyFor(const QString &modelDir, int exptNum, const QString &simName);
+
+    /*!
+     * Copy the logs stored for key into logDir, replacing the files there,
+     * and set output to the simulator's output. False if key is not
+     * stored.
+     */
+    static bool restore(const QByteArray &key, const QString &logDir, QString &output);
+
+    /*!
+     * Store the logs of a successful run, found in logDir, under key.
+     */
+    static void store(const QByteArray &key, const QString &logDir, const QString &output);
+
+    /*!
+     * The SHA-1 of the content of filePath, read once by each object.
+     */
+    QByteArray hashOfFile(const QString &filePath);
+
+private:
+    static void evict();
+
+    // by the canonical path of the file
+    QHash <QString, QByteArray> fileHashes;
+};
+
+#endif // SC_RUNCACHE_H
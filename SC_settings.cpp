@@ -25,6 +25,149 @@
 #include "SC_settings.h"
 #include "ui_settings_window.h"
 #include "QSettings"
+#include <QMutex>
+#include <QMutexLocker>
+
+/////// SETTINGS CACHE
+
+namespace {
+    struct cachedSettingValues
+    {
+        bool valid;
+        int glDetail;
+        int glMaxConnections;
+        bool saveBinaryConnections;
+        bool sortConnections;
+        int undoMemoryLimitMB;
+        int logCacheLimitMB;
+        int residentLimitMB;
+        int autosaveMinutes;
+        float dpiRatio;
+        bool haveCurrentFileName;
+        QString currentFileName;
+    };
+
+    cachedSettingValues cachedValues = { false, 5, 100000, true, false, 256, 512, 4096, 5, 1.0f, false, QString() };
+    // connections may be generated off the GUI thread
+    QMutex cachedValuesLock;
+
+    // call with cachedValuesLock held
+    void loadCachedSettings()
+    {
+        if (cachedValues.valid) {
+            return;
+        }
+        QSettings settings;
+        cachedValues.glDetail = settings.value("glOptions/detail", 5).toInt();
+        cachedValues.glMaxConnections = settings.value("glOptions/maxConnections", 100000).toInt();
+        cachedValues.saveBinaryConnections = settings.value("fileOptions/saveBinaryConnections", "error").toBool();
+        cachedValues.sortConnections = settings.value("fileOptions/sortConnections", false).toBool();
+        cachedValues.undoMemoryLimitMB = settings.value("undoOptions/memoryLimitMB", 256).toInt();
+        cachedValues.logCacheLimitMB = settings.value("logOptions/columnCacheMB", 512).toInt();
+        cachedValues.residentLimitMB = settings.value("memoryOptions/residentLimitMB", 4096).toInt();
+        cachedValues.autosaveMinutes = settings.value("fileOptions/autosaveMinutes", 5).toInt();
+        cachedValues.dpiRatio = settings.value("dpi", 1.0).toFloat();
+        cachedValues.haveCurrentFileName = settings.contains("files/currentFileName");
+        cachedValues.currentFileName = settings.value("files/currentFileName").toString();
+        cachedValues.valid = true;
+    }
+}
+
+int settingsCache::glDetail()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.glDetail;
+}
+
+int settingsCache::glMaxConnections()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.glMaxConnections;
+}
+
+bool settingsCache::saveBinaryConnections()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.saveBinaryConnections;
+}
+
+bool settingsCache::sortConnections()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.sortConnections;
+}
+
+int settingsCache::undoMemoryLimitMB()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.undoMemoryLimitMB;
+}
+
+int settingsCache::logCacheLimitMB()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.logCacheLimitMB;
+}
+
+int settingsCache::residentLimitMB()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.residentLimitMB;
+}
+
+int settingsCache::autosaveMinutes()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.autosaveMinutes;
+}
+
+float settingsCache::dpiRatio()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.dpiRatio;
+}
+
+QString settingsCache::currentFileName(const QString &defaultValue)
+{
+    QMutexLocker locker(&cachedValuesLock);
+    loadCachedSettings();
+    return cachedValues.haveCurrentFileName ? cachedValues.currentFileName : defaultValue;
+}
+
+void settingsCache::setCurrentFileName(const QString &fileName)
+{
+    QMutexLocker locker(&cachedValuesLock);
+    QSettings settings;
+    settings.setValue("files/currentFileName", fileName);
+    cachedValues.haveCurrentFileName = true;
+    cachedValues.currentFileName = fileName;
+}
+
+void settingsCache::removeCurrentFileName()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    QSettings settings;
+    settings.remove("files/currentFileName");
+    cachedValues.haveCurrentFileName = false;
+    cachedValues.currentFileName.clear();
+}
+
+void settingsCache::invalidate()
+{
+    QMutexLocker locker(&cachedValuesLock);
+    cachedValues.valid = false;
+}
+
+/////// SETTINGS WINDOW
 
 settings_window::settings_window(QWidget *parent) :
     QDialog(parent),
@@ -87,11 +230,40 @@ settings_window::settings_window(QWidget *parent) :
     ui->save_as_binary->setChecked(writeBinary);
     connect(ui->save_as_binary, SIGNAL(toggled(bool)), this, SLOT(saveAsBinaryToggled(bool)));
 
+    // sort explicit connection lists as they are imported or generated
+    ui->sort_connections->setChecked(settings.value("fileOptions/sortConnections", false).toBool());
+    connect(ui->sort_connections, SIGNAL(toggled(bool)), this, SLOT(sortConnectionsToggled(bool)));
+
     // change level of detail box
     int lod = settings.value("glOptions/detail", 5).toInt();
     ui->openGLDetailSpinBox->setValue(lod);
     connect(ui->openGLDetailSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setGLDetailLevel(int)));
 
+    // change number of connections drawn box
+    int maxConns = settings.value("glOptions/maxConnections", 100000).toInt();
+    ui->openGLConnectionsSpinBox->setValue(maxConns);
+    connect(ui->openGLConnectionsSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setGLMaxConnections(int)));
+
+    // change the memory the undo history may hold
+    int undoMB = settings.value("undoOptions/memoryLimitMB", 256).toInt();
+    ui->undoMemorySpinBox->setValue(undoMB);
+    connect(ui->undoMemorySpinBox, SIGNAL(valueChanged(int)), this, SLOT(setUndoMemoryLimit(int)));
+
+    // change the memory the columns read from logs may hold
+    int logMB = settings.value("logOptions/columnCacheMB", 512).toInt();
+    ui->logCacheSpinBox->setValue(logMB);
+    connect(ui->logCacheSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setLogCacheLimit(int)));
+
+    // change the memory the connections and logs being edited may hold
+    int residentMB = settings.value("memoryOptions/residentLimitMB", 4096).toInt();
+    ui->residentMemorySpinBox->setValue(residentMB);
+    connect(ui->residentMemorySpinBox, SIGNAL(valueChanged(int)), this, SLOT(setResidentLimit(int)));
+
+    // change how often unsaved changes are written for crash recovery
+    int autosave = settings.value("fileOptions/autosaveMinutes", 5).toInt();
+    ui->autosaveSpinBox->setValue(autosave);
+    connect(ui->autosaveSpinBox, SIGNAL(valueChanged(int)), this, SLOT(setAutosaveInterval(int)));
+
     // change dev stuff box
     bool devMode = settings.value("dev_mode_on", "false").toBool();
     ui->dev_mode_check->setChecked(devMode);
@@ -288,12 +460,56 @@ void settings_window::saveAsBinaryToggled(bool toggle)
 {
     QSettings settings;
     settings.setValue("fileOptions/saveBinaryConnections", QString::number((float) toggle));
+    settingsCache::invalidate();
+}
+
+void settings_window::sortConnectionsToggled(bool toggle)
+{
+    QSettings settings;
+    settings.setValue("fileOptions/sortConnections", toggle);
+    settingsCache::invalidate();
 }
 
 void settings_window::setGLDetailLevel(int value)
 {
     QSettings settings;
     settings.setValue("glOptions/detail", value);
+    settingsCache::invalidate();
+}
+
+void settings_window::setGLMaxConnections(int value)
+{
+    QSettings settings;
+    settings.setValue("glOptions/maxConnections", value);
+    settingsCache::invalidate();
+}
+
+void settings_window::setUndoMemoryLimit(int value)
+{
+    QSettings settings;
+    settings.setValue("undoOptions/memoryLimitMB", value);
+    settingsCache::invalidate();
+}
+
+void settings_window::setLogCacheLimit(int value)
+{
+    QSettings settings;
+    settings.setValue("logOptions/columnCacheMB", value);
+    settingsCache::invalidate();
+}
+
+void settings_window::setResidentLimit(int value)
+{
+    QSettings settings;
+    settings.setValue("memoryOptions/residentLimitMB", value);
+    settingsCache::invalidate();
+}
+
+void settings_window::setAutosaveInterval(int value)
+{
+    QSettings settings;
+    settings.setValue("fileOptions/autosaveMinutes", value);
+    settingsCache::invalidate();
 }
 
 void settings_window::setDevMode(bool toggle)
@@ -475,6 +691,7 @@ void settings_window::getNewSimName()
         this->ui->comboBox->addItem(simName);
         this->ui->comboBox->setCurrentIndex(this->ui->comboBox->count()-1);
         this->ui->useBinary->setChecked(false);
+        this->ui->useBinaryArrayInputs->setChecked(false);
         edited = true;
     }
 
@@ -494,6 +711,7 @@ void settings_window::selectSimulator(QString simName)
     this->path = settings.value("path").toString();
     this->working_dir = settings.value("working_dir").toString();
     ui->useBinary->setChecked(settings.value("binary").toBool());
+    ui->useBinaryArrayInputs->setChecked(settings.value(ARRAY_INPUT_BINARY_SETTING, false).toBool());
     settings.endGroup();
 
     settings.beginGroup("simulators/" + simName + "/envVar");
@@ -533,6 +751,7 @@ void settings_window::applyChanges()
     settings.setValue("path", ui->scriptLineEdit->text());
     settings.setValue("working_dir", ui->scriptWDLineEdit->text());
     settings.setValue("binary", ui->useBinary->isChecked());
+    settings.setValue(ARRAY_INPUT_BINARY_SETTING, ui->useBinaryArrayInputs->isChecked());
     settings.endGroup();
 
     settings.beginGroup("simulators/" + ui->comboBox->currentText() + "/envVar");
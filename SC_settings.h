@@ -34,6 +34,67 @@ namespace Ui {
 
 class PythonSyntaxHighlighter;
 
+// the setting, under simulators/<name>, of a simulator which reads the
+// BinaryFile form of array inputs; off unless the user turns it on
+#define ARRAY_INPUT_BINARY_SETTING "binaryArrayInputs"
+
+/*!
+ * \brief The settingsCache class holds the settings that are read on the paint
+ * and save paths, so that QSettings is parsed once rather than on every frame
+ * or connection. The settings window invalidates it when it writes them, and
+ * the current file name is written through it.
+ */
+class settingsCache
+{
+public:
+    static int glDetail();
+    static int glMaxConnections();
+    static bool saveBinaryConnections();
+    /*!
+     * \brief sortConnections returns true if explicit connection lists are
+     * sorted by source and destination when they are imported or generated.
+     */
+    static bool sortConnections();
+    /*!
+     * \brief undoMemoryLimitMB returns the most memory the undo history may
+     * hold, in MB, or 0 for no limit.
+     */
+    static int undoMemoryLimitMB();
+    /*!
+     * \brief logCacheLimitMB returns the most memory the columns read from
+     * logs for plotting may hold, in MB, or 0 for no limit.
+     */
+    static int logCacheLimitMB();
+    /*!
+     * \brief residentLimitMB returns the most memory the explicit connection
+     * lists and log columns in use may hold between them, in MB, or 0 for no
+     * limit; see residencyManager.
+     */
+    static int residentLimitMB();
+    /*!
+     * \brief autosaveMinutes returns how often, in minutes, unsaved changes
+     * are written to the recovery directory, or 0 for never; see autosaver.
+     */
+    static int autosaveMinutes();
+    /*!
+     * \brief dpiRatio returns the device pixel ratio saved in "dpi", which
+     * line widths and handle sizes are scaled by.
+     */
+    static float dpiRatio();
+    /*!
+     * \brief currentFileName returns files/currentFileName, or defaultValue
+     * if it is not set.
+     */
+    static QString currentFileName(const QString &defaultValue = QString());
+    static void setCurrentFileName(const QString &fileName);
+    static void removeCurrentFileName();
+    /*!
+     * \brief invalidate drops the cached values; they are re-read from
+     * QSettings on the next access.
+     */
+    static void invalidate();
+};
+
 /*!
  * \brief The settings_window class allows simulators and GUI settings to be updated, and python
  * connections to be defined
@@ -84,7 +145,13 @@ public slots:
     void changePythonHome (void);
     void changedEnvVar(QString);
     void saveAsBinaryToggled(bool);
+    void sortConnectionsToggled(bool);
     void setGLDetailLevel(int);
+    void setGLMaxConnections(int);
+    void setUndoMemoryLimit(int);
+    void setLogCacheLimit(int);
+    void setResidentLimit(int);
+    void setAutosaveInterval(int);
     void setDevMode(bool);
     void close();
     void scriptSelectionChanged(QListWidgetItem *current, QListWidgetItem *previous);
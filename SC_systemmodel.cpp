@@ -33,7 +33,7 @@ systemmodel::systemmodel(nl_rootdata * dataPtr, QObject *parent) :
     QList<QVariant> rootData;
     rootData << "Model";
     rootItem = new TreeItem(rootData, NULL);
-    setupModelData(rootItem);
+    update();
 }
 
  QModelIndexList systemmodel::getPersistentIndexList()
@@ -194,85 +194,130 @@ Qt::ItemFlags systemmodel::flags(const QModelIndex &index) const
     return flags;
 }
 
-void systemmodel::setupModelData(TreeItem *parent)
+void systemmodel::update()
 {
-    QList<TreeItem*> parents;
-    parents << parent;
+    updateChildren(rootItem, QModelIndex());
+}
 
-    for (int pop = 0; pop < dataPtr->populations.size();++pop) {
+QVector < systemmodel::rowSpec > systemmodel::childRows(TreeItem *parent)
+{
+    QVector < rowSpec > rows;
 
-        // add population
-        QSharedPointer <population> currPop = (QSharedPointer <population>) dataPtr->populations[pop];
-        QList<QVariant> columnDataPop;
-        columnDataPop << currPop->getName();
+    if (parent == rootItem) {
 
-        // add as child of current parent and set this as the new parent
-        parents.last()->appendChild(new TreeItem(columnDataPop, &(currPop->isVisualised), parents.last()));
-        parents.last()->child(parents.last()->childCount()-1)->type = currPop->type;
-        parents << parents.last()->child(parents.last()->childCount()-1);
+        // populations
+        for (int pop = 0; pop < dataPtr->populations.size(); ++pop) {
+            QSharedPointer <population> currPop = (QSharedPointer <population>) dataPtr->populations[pop];
+            rowSpec row = { currPop, currPop->getName(), &(currPop->isVisualised), currPop->type };
+            rows.push_back(row);
+        }
 
-        // add generic inputs for Populations
+    } else if (parent->type == populationObject) {
 
-        for (int output = 0; output < dataPtr->populations[pop]->neuronType->outputs.size(); ++output) {
+        QSharedPointer <population> currPop = qSharedPointerDynamicCast <population> (parent->object);
+        if (!currPop) {
+            return rows;
+        }
 
-            // add output
-            QSharedPointer<genericInput> currOutput = dataPtr->populations[pop]->neuronType->outputs[output];
+        // add generic inputs for Populations
+        for (int output = 0; output < currPop->neuronType->outputs.size(); ++output) {
+
+            QSharedPointer<genericInput> currOutput = currPop->neuronType->outputs[output];
 
             // really we can only currently display pop -> pop inputs sensibly...
             if (!currOutput->projInput) {
                 if (currOutput->source->type == populationObject && currOutput->destination->type == populationObject) {
-                    QList<QVariant> columnDataInput;
-                    columnDataInput << "Output from " + currOutput->source->getName() + " to " + currOutput->destination->getName() + " port " + currOutput->dstPort + " " + QString::number(output);
-
-                    // add as child of current parent
-                    parents.last()->appendChild(new TreeItem(columnDataInput, &(currOutput->isVisualised), parents.last()));
-                    parents.last()->child(parents.last()->childCount()-1)->type = currOutput->type;
+                    rowSpec row = { currOutput, "Output from " + currOutput->source->getName() + " to " + currOutput->destination->getName() + " port " + currOutput->dstPort + " " + QString::number(output),
+                                    &(currOutput->isVisualised), currOutput->type };
+                    rows.push_back(row);
                 }
             }
-
         }
 
         // add projections
-
         for (int proj = 0; proj < currPop->projections.size(); ++proj) {
-
-            // add projection
             QSharedPointer <projection> currProj = (QSharedPointer <projection>) currPop->projections[proj];
-            QList<QVariant> columnDataProj;
-            columnDataProj << currProj->getName();
+            rowSpec row = { currProj, currProj->getName(), (bool *) NULL, currProj->type };
+            rows.push_back(row);
+        }
 
-            // add as child of current parent and set this as the new parent
-            parents.last()->appendChild(new TreeItem(columnDataProj, NULL, parents.last()));
-            parents.last()->child(parents.last()->childCount()-1)->type = currProj->type;
-            parents << parents.last()->child(parents.last()->childCount()-1);
+    } else if (parent->type == projectionObject) {
 
-            for (int targ = 0; targ < dataPtr->populations[pop]->projections[proj]->synapses.size(); ++targ) {
+        QSharedPointer <projection> currProj = qSharedPointerDynamicCast <projection> (parent->object);
+        if (!currProj) {
+            return rows;
+        }
 
-                // add Synapse
-                //QSharedPointer <projection> currTarg = (QSharedPointer <projection>) currProj->synapses[targ];
-                QList<QVariant> columnDataTarg;
-                columnDataTarg << currProj->getName() + ": Synapse " + QString::number(targ);
+        // add Synapses
+        for (int targ = 0; targ < currProj->synapses.size(); ++targ) {
+            rowSpec row = { currProj->synapses[targ], currProj->getName() + ": Synapse " + QString::number(targ),
+                            &(currProj->synapses[targ]->isVisualised), nullObject };
+            rows.push_back(row);
+        }
+    }
 
-                // add as child of current parent
-                parents.last()->appendChild(new TreeItem(columnDataTarg, &(currProj->synapses[targ]->isVisualised), parents.last()));
-                parents.last()->child(parents.last()->childCount()-1)->type = nullObject;
+    return rows;
+}
 
-            }
+void systemmodel::updateChildren(TreeItem *parent, const QModelIndex &parentIndex)
+{
+    QVector < rowSpec > rows = childRows(parent);
+
+    // remove the rows for objects which have gone
+    for (int i = parent->childCount() - 1; i >= 0; --i) {
+        bool wanted = false;
+        for (int r = 0; r < rows.size() && !wanted; ++r) {
+            wanted = rows[r].object == parent->child(i)->object;
+        }
+        if (!wanted) {
+            beginRemoveRows(parentIndex, i, i);
+            parent->removeChild(i);
+            endRemoveRows();
+        }
+    }
 
-            // go back a level of parents
-            parents.pop_back();
+    // then walk the wanted rows in order, adding new ones and moving any
+    // which have been reordered
+    for (int i = 0; i < rows.size(); ++i) {
 
+        TreeItem * item = parent->child(i);
+        if (item == NULL || item->object != rows[i].object) {
+            int found = -1;
+            for (int j = i + 1; j < parent->childCount() && found == -1; ++j) {
+                if (parent->child(j)->object == rows[i].object) {
+                    found = j;
+                }
+            }
+            if (found != -1) {
+                beginMoveRows(parentIndex, found, found, parentIndex, i);
+                parent->moveChild(found, i);
+                endMoveRows();
+            } else {
+                QList<QVariant> columnData;
+                columnData << rows[i].name;
+                item = new TreeItem(columnData, rows[i].check, parent);
+                item->type = rows[i].type;
+                item->object = rows[i].object;
+                beginInsertRows(parentIndex, i, i);
+                parent->insertChild(i, item);
+                endInsertRows();
+            }
+            item = parent->child(i);
         }
 
-        // go back a level of parents
-        parents.pop_back();
+        // relabel, for renames and for indices which have shifted
+        QModelIndex itemIndex = index(i, 0, parentIndex);
+        if (item->name != rows[i].name || item->checkedPointer() != rows[i].check) {
+            item->setName(rows[i].name, rows[i].check);
+            emit dataChanged(itemIndex, itemIndex);
+        }
 
+        if (item->type == populationObject || item->type == projectionObject) {
+            updateChildren(item, itemIndex);
+        }
     }
-
 }
 
-
-
 TreeItem::TreeItem(const QList<QVariant> &data, bool * check, TreeItem *parent)
 {
     parentItem = parent;
@@ -292,6 +337,28 @@ void TreeItem::appendChild(TreeItem *item)
     childItems.append(item);
 }
 
+void TreeItem::insertChild(int row, TreeItem *item)
+{
+    childItems.insert(row, item);
+}
+
+void TreeItem::removeChild(int row)
+{
+    delete childItems.takeAt(row);
+}
+
+void TreeItem::moveChild(int from, int to)
+{
+    childItems.move(from, to);
+}
+
+void TreeItem::setName(const QString &name, bool * check)
+{
+    this->name = name;
+    itemData[0] = name;
+    checked = check;
+}
+
 TreeItem *TreeItem::child(int row)
 {
     return childItems.value(row);
@@ -49,8 +49,24 @@ public:
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
     QModelIndexList getPersistentIndexList();
 
+    /*!
+     * Bring the tree into line with the network. Only the rows which
+     * differ are inserted, removed or relabelled, so that the views keep
+     * their state and only hear about what has changed.
+     */
+    void update();
+
 private:
-    void setupModelData(TreeItem *parent);
+    // what one row of the tree should show
+    struct rowSpec
+    {
+        QSharedPointer <systemObject> object;
+        QString name;
+        bool * check;
+        systemObjectType type;
+    };
+    QVector < rowSpec > childRows(TreeItem *parent);
+    void updateChildren(TreeItem *parent, const QModelIndex &parentIndex);
     TreeItem *rootItem;
 
 signals:
@@ -66,6 +82,9 @@ public:
     ~TreeItem();
 
     void appendChild(TreeItem *child);
+    void insertChild(int row, TreeItem *child);
+    void removeChild(int row);
+    void moveChild(int from, int to);
 
     TreeItem *child(int row);
     int childCount() const;
@@ -75,8 +94,12 @@ public:
     TreeItem *parent();
     bool isChecked() const { return *checked; }
     void setChecked( bool set ) { *checked = set; }
+    bool * checkedPointer() const { return checked; }
+    void setName(const QString &name, bool * check);
     systemObjectType type;
     QString name;
+    // the object the row stands for, kept alive while it is shown
+    QSharedPointer <systemObject> object;
 
 private:
     QList<TreeItem*> childItems;
@@ -31,6 +31,221 @@
 #include "mainwindow.h"
 #include "SC_component_rootcomponentitem.h"
 #include "SC_projectobject.h"
+#include "SC_settings.h"
+
+// ######## SNAPSHOT MEMORY #################
+
+QList <snapshotUndoCommand *> snapshotUndoCommand::history;
+
+snapshotUndoCommand::snapshotUndoCommand(QUndoCommand *parent) :
+    QUndoCommand(parent)
+{
+    this->applied = false;
+    this->spilled = false;
+    this->discarded = false;
+    history.push_back(this);
+}
+
+snapshotUndoCommand::~snapshotUndoCommand()
+{
+    history.removeOne(this);
+}
+
+qint64 snapshotUndoCommand::totalBytes()
+{
+    QSet <const void *> seen;
+    qint64 total = 0;
+    for (int i = 0; i < history.size(); ++i) {
+        total += history[i]->snapshotBytes(seen);
+    }
+    return total;
+}
+
+void snapshotUndoCommand::enforceLimit(snapshotUndoCommand * current)
+{
+    qint64 limit = (qint64) settingsCache::undoMemoryLimitMB() * 1024 * 1024;
+    if (limit <= 0) {
+        return;
+    }
+    qint64 total = totalBytes();
+
+    // first move the oldest snapshots to disk...
+    for (int i = 0; i < history.size() && total > limit; ++i) {
+        snapshotUndoCommand * cmd = history[i];
+        if (cmd == current || cmd->spilled || cmd->discarded || !cmd->applied) {
+            continue;
+        }
+        cmd->spillSnapshots();
+        cmd->spilled = true;
+        total = totalBytes();
+    }
+
+    // ...then forget them. Undone commands are left, as their snapshots go
+    // with them when the next change is pushed
+    for (int i = 0; i < history.size() && total > limit; ++i) {
+        snapshotUndoCommand * cmd = history[i];
+        if (cmd == current || cmd->discarded || !cmd->applied) {
+            continue;
+        }
+        cmd->discardSnapshots();
+        cmd->discarded = true;
+        cmd->setText(cmd->text() + " (no longer undoable)");
+        total = totalBytes();
+    }
+}
+
+namespace {
+    // estimates of the memory held by a component, for the undo limit
+    qint64 textBytes(const QString &text)
+    {
+        return sizeof(QString) + (qint64) text.size() * sizeof(QChar);
+    }
+
+    qint64 objectBytes(ComponentModelObject * obj, qint64 size)
+    {
+        qint64 bytes = size + textBytes(obj->annotation);
+        QMap<QString, QString>::const_iterator i = obj->annotationTexts.constBegin();
+        while (i != obj->annotationTexts.constEnd()) {
+            bytes += textBytes(i.key()) + textBytes(i.value());
+            ++i;
+        }
+        return bytes;
+    }
+
+    qint64 mathsBytes(MathInLine * maths)
+    {
+        return maths == NULL ? 0 : objectBytes(maths, sizeof(MathInLine)) + textBytes(maths->equation);
+    }
+
+    qint64 parameterBytes(Parameter * par, qint64 size)
+    {
+        return objectBytes(par, size) + textBytes(par->name) + textBytes(par->filename) + sizeof(dim);
+    }
+
+    qint64 assignmentBytes(const QVector <StateAssignment*> &assigns)
+    {
+        qint64 bytes = 0;
+        for (int i = 0; i < assigns.size(); ++i) {
+            bytes += objectBytes(assigns[i], sizeof(StateAssignment)) + textBytes(assigns[i]->name) + mathsBytes(assigns[i]->maths);
+        }
+        return bytes;
+    }
+
+    qint64 outBytes(const QVector <EventOut*> &events, const QVector <ImpulseOut*> &impulses)
+    {
+        qint64 bytes = 0;
+        for (int i = 0; i < events.size(); ++i) {
+            bytes += objectBytes(events[i], sizeof(EventOut)) + textBytes(events[i]->port_name);
+        }
+        for (int i = 0; i < impulses.size(); ++i) {
+            bytes += objectBytes(impulses[i], sizeof(ImpulseOut)) + textBytes(impulses[i]->port_name);
+        }
+        return bytes;
+    }
+
+    qint64 componentBytes(QSharedPointer<Component> component)
+    {
+        if (component.isNull()) {
+            return 0;
+        }
+        Component * c = component.data();
+        qint64 bytes = objectBytes(c, sizeof(Component)) + textBytes(c->name) + textBytes(c->type)
+                + textBytes(c->initial_regime_name) + textBytes(c->path) + textBytes(c->filePath);
+        for (int i = 0; i < c->ParameterList.size(); ++i) {
+            bytes += parameterBytes(c->ParameterList[i], sizeof(Parameter));
+        }
+        for (int i = 0; i < c->StateVariableList.size(); ++i) {
+            bytes += parameterBytes(c->StateVariableList[i], sizeof(StateVariable));
+        }
+        for (int i = 0; i < c->AliasList.size(); ++i) {
+            bytes += parameterBytes(c->AliasList[i], sizeof(Alias)) + mathsBytes(c->AliasList[i]->maths);
+        }
+        for (int i = 0; i < c->AnalogPortList.size(); ++i) {
+            bytes += objectBytes(c->AnalogPortList[i], sizeof(AnalogPort)) + textBytes(c->AnalogPortList[i]->name);
+        }
+        for (int i = 0; i < c->EventPortList.size(); ++i) {
+            bytes += objectBytes(c->EventPortList[i], sizeof(EventPort)) + textBytes(c->EventPortList[i]->name);
+        }
+        for (int i = 0; i < c->ImpulsePortList.size(); ++i) {
+            bytes += objectBytes(c->ImpulsePortList[i], sizeof(ImpulsePort)) + textBytes(c->ImpulsePortList[i]->name);
+        }
+        for (int i = 0; i < c->RegimeList.size(); ++i) {
+            Regime * r = c->RegimeList[i];
+            bytes += objectBytes(r, sizeof(Regime)) + textBytes(r->name);
+            for (int j = 0; j < r->TimeDerivativeList.size(); ++j) {
+                TimeDerivative * td = r->TimeDerivativeList[j];
+                bytes += objectBytes(td, sizeof(TimeDerivative)) + textBytes(td->variable_name) + mathsBytes(td->maths);
+            }
+            for (int j = 0; j < r->OnConditionList.size(); ++j) {
+                OnCondition * oc = r->OnConditionList[j];
+                bytes += objectBytes(oc, sizeof(OnCondition)) + textBytes(oc->target_regime_name)
+                        + assignmentBytes(oc->StateAssignList) + outBytes(oc->eventOutList, oc->impulseOutList);
+                if (oc->trigger != NULL) {
+                    bytes += objectBytes(oc->trigger, sizeof(Trigger)) + mathsBytes(oc->trigger->maths);
+                }
+            }
+            for (int j = 0; j < r->OnEventList.size(); ++j) {
+                OnEvent * oe = r->OnEventList[j];
+                bytes += objectBytes(oe, sizeof(OnEvent)) + textBytes(oe->target_regime_name) + textBytes(oe->src_port_name)
+                        + assignmentBytes(oe->StateAssignList) + outBytes(oe->eventOutList, oe->impulseOutList);
+            }
+            for (int j = 0; j < r->OnImpulseList.size(); ++j) {
+                OnImpulse * oi = r->OnImpulseList[j];
+                bytes += objectBytes(oi, sizeof(OnImpulse)) + textBytes(oi->target_regime_name) + textBytes(oi->src_port_name)
+                        + assignmentBytes(oi->StateAssignList) + outBytes(oi->eventOutList, oi->impulseOutList);
+            }
+        }
+        return bytes;
+    }
+
+    // the memory held by a connection kept for an undo; an explicit list
+    // lives in its backing store, so only its index and mapping count
+    qint64 connectionBytes(connection * c)
+    {
+        if (c == NULL) {
+            return 0;
+        }
+        qint64 bytes = sizeof(connection);
+        if (c->type == CSV) {
+            bytes += static_cast<csv_connection *>(c)->getResidentBytes();
+        }
+        if (c->generator != NULL && c->generator->type == Python) {
+            pythonscript_connection * py = static_cast<pythonscript_connection *>(c->generator);
+            bytes += (qint64) py->connections.size() * sizeof(conn) + (qint64) py->weights.size() * sizeof(double);
+        }
+        return bytes;
+    }
+
+    void spillConnection(connection * c)
+    {
+        if (c == NULL) {
+            return;
+        }
+        if (c->type == CSV) {
+            static_cast<csv_connection *>(c)->releaseResident();
+        }
+        if (c->generator != NULL && c->generator->type == Python) {
+            // the generated list is only a cache of what is in the backing
+            // store, and is made again if it is needed
+            static_cast<pythonscript_connection *>(c->generator)->connections = QVector <conn> ();
+        }
+    }
+
+    // a fixed probability connection switched to an explicit list keeps the
+    // connections it described, streamed straight into the list
+    void expandFixedProb(connection * from, connection * to, QSharedPointer <systemObject> srcObj, QSharedPointer <systemObject> dstObj)
+    {
+        if (from == NULL || from->type != FixedProb || to->type != CSV) {
+            return;
+        }
+        QSharedPointer <population> src = qSharedPointerDynamicCast <population> (srcObj);
+        QSharedPointer <population> dst = qSharedPointerDynamicCast <population> (dstObj);
+        if (src.isNull() || dst.isNull()) {
+            return;
+        }
+        static_cast<csv_connection *>(to)->setAllData(*static_cast<fixedProb_connection *>(from), src->numNeurons, dst->numNeurons);
+    }
+}
 
 // ######## DELETE SELECTION #################
 
@@ -147,6 +362,7 @@ void addPopulationCmd::undo()
     }
     // do children by calling parent class function:
     QUndoCommand::undo();
+    data->systemModelChanged();
 }
 
 void addPopulationCmd::redo()
@@ -163,6 +379,7 @@ void addPopulationCmd::redo()
     }
     // do children by calling parent class function:
     QUndoCommand::redo();
+    data->systemModelChanged();
 }
 
 // ######## DELETE POPULATION #################
@@ -260,6 +477,7 @@ void delPopulation::undo()
     }
     // do children by calling parent class function:
     QUndoCommand::undo();
+    data->systemModelChanged();
 }
 
 void delPopulation::redo()
@@ -287,6 +505,7 @@ void delPopulation::redo()
     }
     pop->isDeleted = true;
     isDeleted = true;
+    data->systemModelChanged();
 }
 
 // ######## MOVE POPULATION #################
@@ -298,12 +517,15 @@ movePopulation::movePopulation(nl_rootdata * data, QSharedPointer<population> po
     this->setText("move population");
     this->oldPos = oldPos;
     this->newPos = newPos;
+    this->gesture = data->undoGesture();
 }
 
 void movePopulation::undo()
 {
     pop->move (this->oldPos.x(), this->oldPos.y());
-    data->redrawViews();
+    if (!data->deferUndoRedraw(UNDO_REDRAW_VIEWS)) {
+        data->redrawViews();
+    }
     // undo children by calling parent class function:
     QUndoCommand::undo();
 }
@@ -315,10 +537,23 @@ void movePopulation::redo()
     // not mouse positions.
     pop->setLocationOffset(0, 0);
     pop->move (this->newPos.x(), this->newPos.y());
-    data->redrawViews();
+    if (!data->deferUndoRedraw(UNDO_REDRAW_VIEWS)) {
+        data->redrawViews();
+    }
     QUndoCommand::redo();
 }
 
+bool movePopulation::mergeWith(const QUndoCommand * other)
+{
+    const movePopulation * move = static_cast<const movePopulation *>(other);
+    // moves made in one gesture are one step
+    if (move->pop != this->pop || this->gesture == -1 || move->gesture != this->gesture) {
+        return false;
+    }
+    this->newPos = move->newPos;
+    return true;
+}
+
 // ######## MOVE PROJECTION HANDLE #################
 moveProjectionHandle::moveProjectionHandle(nl_rootdata * data, QSharedPointer<projection> proj, const QPointF& oldPos, const QPointF& newPos, QUndoCommand *parent) :
     QUndoCommand(parent)
@@ -328,22 +563,37 @@ moveProjectionHandle::moveProjectionHandle(nl_rootdata * data, QSharedPointer<pr
     this->setText("move handle");
     this->oldPos = oldPos;
     this->newPos = newPos;
+    this->gesture = data->undoGesture();
 }
 
 void moveProjectionHandle::undo()
 {
     proj->moveSelectedControlPoint (this->oldPos.x(), this->oldPos.y());
-    data->redrawViews();
+    if (!data->deferUndoRedraw(UNDO_REDRAW_VIEWS)) {
+        data->redrawViews();
+    }
     QUndoCommand::undo();
 }
 
 void moveProjectionHandle::redo()
 {
     proj->moveSelectedControlPoint (this->newPos.x(), this->newPos.y());
-    data->redrawViews();
+    if (!data->deferUndoRedraw(UNDO_REDRAW_VIEWS)) {
+        data->redrawViews();
+    }
     QUndoCommand::redo();
 }
 
+bool moveProjectionHandle::mergeWith(const QUndoCommand * other)
+{
+    const moveProjectionHandle * move = static_cast<const moveProjectionHandle *>(other);
+    if (move->proj != this->proj || this->gesture == -1 || move->gesture != this->gesture) {
+        return false;
+    }
+    this->newPos = move->newPos;
+    return true;
+}
+
 // ######## ADD PROJECTION #################
 
 addProjection::addProjection(nl_rootdata * data, QSharedPointer<projection> proj, QUndoCommand *parent) :
@@ -378,6 +628,7 @@ void addProjection::undo()
     }
     // do children by calling parent class function:
     QUndoCommand::undo();
+    data->systemModelChanged();
 }
 
 void addProjection::redo()
@@ -393,6 +644,7 @@ void addProjection::redo()
     }
     // do children by calling parent class function:
     QUndoCommand::redo();
+    data->systemModelChanged();
 }
 
 // ######## DELETE PROJECTION #################
@@ -438,6 +690,7 @@ void delProjection::undo()
     }
     // do children by calling parent class function:
     QUndoCommand::undo();
+    data->systemModelChanged();
 }
 
 void delProjection::redo()
@@ -459,6 +712,7 @@ void delProjection::redo()
             }
         }
     }
+    data->systemModelChanged();
 }
 
 // ######## ADD SYNAPSE #################
@@ -488,6 +742,7 @@ void addSynapse::undo()
     syn->isDeleted = true;
     QUndoCommand::undo();
     data->reDrawAll();
+    data->systemModelChanged();
 }
 
 void addSynapse::redo()
@@ -497,6 +752,7 @@ void addSynapse::redo()
     syn->isDeleted = false;
     QUndoCommand::redo();
     data->reDrawAll();
+    data->systemModelChanged();
 }
 
 // ######## DELETE SYNAPSE #################
@@ -599,6 +855,7 @@ void delSynapse::undo()
     // do children by calling parent class function:
     QUndoCommand::undo();
     data->reDrawAll();
+    data->systemModelChanged();
 }
 
 void delSynapse::redo()
@@ -616,7 +873,7 @@ void delSynapse::redo()
     isUndone = false;
 
     data->reDrawAll();
-
+    data->systemModelChanged();
 }
 
 
@@ -640,6 +897,7 @@ void addInput::undo()
     // delete input (must disconnect it first!)
     this->input->disconnect();
     this->isDeleted = true;
+    data->systemModelChanged();
 }
 
 void addInput::redo()
@@ -647,6 +905,7 @@ void addInput::redo()
     // create new Synapse on projection
     this->input->connect(input);
     this->isDeleted = false;
+    data->systemModelChanged();
 }
 
 // ######## DELETE GENERIC INPUT #################
@@ -682,6 +941,7 @@ void delInput::undo()
         data->cursor.x = -100000;
         data->cursor.y = -100000;
     }
+    data->systemModelChanged();
 }
 
 void delInput::redo()
@@ -701,12 +961,14 @@ void delInput::redo()
     }
     input->isDeleted = true;
     isDeleted = true;
+    data->systemModelChanged();
 }
 
 // ######## CHANGE CONNECTION #################
 changeConnection:: changeConnection(nl_rootdata * data, QSharedPointer<systemObject> pNewConn, int index, QUndoCommand *parent) :
-    QUndoCommand(parent)
+    snapshotUndoCommand(parent)
 {
+    this->oldConn = NULL;
     this->index = index;
     this->newConn = pNewConn;
     this->data = data;
@@ -738,6 +1000,9 @@ changeConnection:: changeConnection(nl_rootdata * data, QSharedPointer<systemObj
 
 void changeConnection::undo()
 {
+    if (this->discarded) {
+        return;
+    }
     if (newConn->type == inputObject) {
         // Switching back from newConn to oldConn.
         delete (qSharedPointerDynamicCast <genericInput> (newConn))->conn;
@@ -747,12 +1012,15 @@ void changeConnection::undo()
         delete (qSharedPointerDynamicCast <synapse> (newConn))->connectionType;
         (qSharedPointerDynamicCast <synapse> (newConn))->connectionType = oldConn;
     }
-    isUndone = true;
+    this->applied = false;
     data->reDrawAll();
 }
 
 void changeConnection::redo()
 {
+    if (this->discarded) {
+        return;
+    }
     // newConn is a QSharedPointer<systemObject>; it's the newConn
     if (newConn->type == inputObject) {
 
@@ -792,10 +1060,7 @@ void changeConnection::redo()
                 // Then this is a csv_connection to csv_connection
                 // change, so transfer information from old to new.
                 csv_connection* oldcsv = static_cast<csv_connection*>(oldConn);
-                newConnIn->conn = oldcsv->newFromExisting(); // allocates csv_connection and copies most data.
-                csv_connection* newcsv = static_cast<csv_connection*>(newConnIn->conn);
-                // For some reason newFromExisting doesn't copy data values. dunno why.
-                newcsv->copyDataValues(oldcsv);
+                newConnIn->conn = oldcsv->newFromExisting(); // allocates csv_connection and shares its data.
 
             } else {
                 // Switching from another connection type (e.g. alltoall)
@@ -803,6 +1068,7 @@ void changeConnection::redo()
             }
             newConnIn->conn->setSynapseIndex (oldConn->getSynapseIndex());
             newConnIn->conn->setParent (oldConn->parent);
+            expandFixedProb(oldConn, newConnIn->conn, newConnIn->source, newConnIn->destination);
             break;
         }
         case Python:
@@ -857,10 +1123,7 @@ void changeConnection::redo()
                 // Then this is a csv_connection to csv_connection
                 // change, so transfer information from old to new.
                 csv_connection* oldcsv = static_cast<csv_connection*>(oldConn);
-                newConnSyn->connectionType = oldcsv->newFromExisting(); // allocates csv_connection and copies most data.
-                csv_connection* newcsv = static_cast<csv_connection*>(newConnSyn->connectionType);
-                // For some reason newFromExisting doesn't copy data values. dunno why.
-                newcsv->copyDataValues(oldcsv);
+                newConnSyn->connectionType = oldcsv->newFromExisting(); // allocates csv_connection and shares its data.
 
             } else {
                 // Switching from another connection type (e.g. alltoall)
@@ -868,6 +1131,7 @@ void changeConnection::redo()
             }
             newConnSyn->connectionType->setSynapseIndex (oldConn->getSynapseIndex());
             newConnSyn->connectionType->setParent (oldConn->parent);
+            expandFixedProb(oldConn, newConnSyn->connectionType, newConnSyn->proj->source, newConnSyn->proj->destination);
             break;
         case Python:
             newConnSyn->connectionType = new csv_connection;
@@ -904,14 +1168,34 @@ void changeConnection::redo()
         DBG() << "Unexpected object pointed to by newConn.";
     }
 
-    isUndone = false;
+    this->applied = true;
+    this->spilled = false;
     data->reDrawAll();
+    snapshotUndoCommand::enforceLimit(this);
+}
+
+qint64 changeConnection::snapshotBytes(QSet <const void *> &)
+{
+    return this->applied ? connectionBytes(this->oldConn) : 0;
+}
+
+void changeConnection::spillSnapshots()
+{
+    spillConnection(this->oldConn);
+}
+
+void changeConnection::discardSnapshots()
+{
+    delete this->oldConn;
+    this->oldConn = NULL;
+    this->applied = false;
 }
 
 // ######## Update a CSV connections delay to be either global or per-connection #################
 globalConnectionDelayChange:: globalConnectionDelayChange(nl_rootdata * d, QSharedPointer<systemObject> pExistingConn, bool gDelay, QUndoCommand *parent) :
-    QUndoCommand(parent)
+    snapshotUndoCommand(parent)
 {
+    this->oldConn = NULL;
     this->connParent = pExistingConn;
     this->data = d;
     this->globalDelay = gDelay;
@@ -920,6 +1204,9 @@ globalConnectionDelayChange:: globalConnectionDelayChange(nl_rootdata * d, QShar
 
 void globalConnectionDelayChange::undo()
 {
+    if (this->discarded) {
+        return;
+    }
     if (this->connParent->type == inputObject) {
         // Switching back from connParent to oldConn.
         delete (qSharedPointerDynamicCast <genericInput> (this->connParent))->conn;
@@ -929,12 +1216,15 @@ void globalConnectionDelayChange::undo()
         delete (qSharedPointerDynamicCast <synapse> (this->connParent))->connectionType;
         (qSharedPointerDynamicCast <synapse> (this->connParent))->connectionType = oldConn;
     }
-    this->isUndone = true;
+    this->applied = false;
     this->data->reDrawAll();
 }
 
 void globalConnectionDelayChange::redo()
 {
+    if (this->discarded) {
+        return;
+    }
     // connParent is a QSharedPointer<systemObject>; it's the connParent
     if (this->connParent->type == inputObject) {
 
@@ -958,10 +1248,9 @@ void globalConnectionDelayChange::redo()
         // This is a csv_connection to csv_connection
         // change, so transfer information from old to new.
         csv_connection* oldcsv = static_cast<csv_connection*>(this->oldConn);
-        connParentIn->conn = oldcsv->newFromExisting(); // allocates csv_connection and copies most data.
+        connParentIn->conn = oldcsv->newFromExisting(); // allocates csv_connection and shares its data.
 
         csv_connection* newcsv = static_cast<csv_connection*>(connParentIn->conn);
-        newcsv->copyDataValues(oldcsv); // This is not handled in newFromExisting.
 
         // Now make the actual change to the new connection
         if (this->globalDelay) {
@@ -981,9 +1270,8 @@ void globalConnectionDelayChange::redo()
         // Then this is a csv_connection to csv_connection
         // change, so transfer information from old to new.
         csv_connection* oldcsv = static_cast<csv_connection*>(this->oldConn);
-        connParentSyn->connectionType = oldcsv->newFromExisting(); // allocates csv_connection and copies most data.
+        connParentSyn->connectionType = oldcsv->newFromExisting(); // allocates csv_connection and shares its data.
         csv_connection* newcsv = static_cast<csv_connection*>(connParentSyn->connectionType);
-        newcsv->copyDataValues(oldcsv);
 
         if (this->globalDelay) {
             newcsv->updateDataForNumCols(2);
@@ -998,8 +1286,27 @@ void globalConnectionDelayChange::redo()
         DBG() << "Unexpected object pointed to by connParent.";
     }
 
-    this->isUndone = false;
+    this->applied = true;
+    this->spilled = false;
     this->data->reDrawAll();
+    snapshotUndoCommand::enforceLimit(this);
+}
+
+qint64 globalConnectionDelayChange::snapshotBytes(QSet <const void *> &)
+{
+    return this->applied ? connectionBytes(this->oldConn) : 0;
+}
+
+void globalConnectionDelayChange::spillSnapshots()
+{
+    spillConnection(this->oldConn);
+}
+
+void globalConnectionDelayChange::discardSnapshots()
+{
+    delete this->oldConn;
+    this->oldConn = NULL;
+    this->applied = false;
 }
 
 // ######## SET SIZE #################
@@ -1013,6 +1320,8 @@ setSizeUndo::setSizeUndo(nl_rootdata * data, QSharedPointer <population> ptr, in
     this->data = data;
     this->setText("set " + this->ptr->getName() + " size to " + QString::number(value));
     firstRedo = true;
+    this->gesture = data->undoGesture();
+    this->edited.start();
 }
 
 void setSizeUndo::undo()
@@ -1027,7 +1336,7 @@ void setSizeUndo::undo()
 void setSizeUndo::redo()
 {
     ptr->numNeurons = value;
-    if (data->main->viewVZ.OpenGLWidget != NULL) {
+    if (data->main->viewVZ.OpenGLWidget != NULL && !data->deferUndoRedraw(UNDO_REDRAW_PROJECTIONS)) {
         data->main->viewVZ.OpenGLWidget->parsChangedProjections();
     }
     if (!firstRedo) {
@@ -1036,6 +1345,19 @@ void setSizeUndo::redo()
     firstRedo = false;
 }
 
+bool setSizeUndo::mergeWith(const QUndoCommand * other)
+{
+    const setSizeUndo * set = static_cast<const setSizeUndo *>(other);
+    if (set->ptr != this->ptr
+        || ((this->gesture == -1 || set->gesture != this->gesture) && this->edited.elapsed() > UNDO_MERGE_MS)) {
+        return false;
+    }
+    this->value = set->value;
+    this->setText(set->text());
+    this->edited.restart();
+    return true;
+}
+
 // ######## SET LOC 3D #################
 
 setLoc3Undo::setLoc3Undo(nl_rootdata * data, QSharedPointer <population> ptr, int index, int value, QUndoCommand *parent) :
@@ -1057,6 +1379,8 @@ setLoc3Undo::setLoc3Undo(nl_rootdata * data, QSharedPointer <population> ptr, in
         this->setText("set " + this->ptr->getName() + " y location to " + QString::number(value));
     if (index == 2)
         this->setText("set " + this->ptr->getName() + " z location to " + QString::number(value));
+    this->gesture = data->undoGesture();
+    this->edited.start();
 }
 
 void setLoc3Undo::undo()
@@ -1079,6 +1403,19 @@ void setLoc3Undo::redo()
         ptr->loc3.z = value;
 }
 
+bool setLoc3Undo::mergeWith(const QUndoCommand * other)
+{
+    const setLoc3Undo * set = static_cast<const setLoc3Undo *>(other);
+    if (set->ptr != this->ptr || set->index != this->index
+        || ((this->gesture == -1 || set->gesture != this->gesture) && this->edited.elapsed() > UNDO_MERGE_MS)) {
+        return false;
+    }
+    this->value = set->value;
+    this->setText(set->text());
+    this->edited.restart();
+    return true;
+}
+
 // ######## UPDATE PAR #################
 
 updateParUndo::updateParUndo(nl_rootdata * data, ParameterInstance * ptr, int index, float value, QUndoCommand *parent) :
@@ -1091,6 +1428,8 @@ updateParUndo::updateParUndo(nl_rootdata * data, ParameterInstance * ptr, int in
     this->setText("set " + this->ptr->name + " to " + QString::number(value));
     this->index = index;
     this->firstRedo = true;
+    this->gesture = data->undoGesture();
+    this->edited.start();
 }
 
 void updateParUndo::undo()
@@ -1108,6 +1447,19 @@ void updateParUndo::redo()
     firstRedo = false;
 }
 
+bool updateParUndo::mergeWith(const QUndoCommand * other)
+{
+    const updateParUndo * update = static_cast<const updateParUndo *>(other);
+    if (update->ptr != this->ptr || update->index != this->index
+        || ((this->gesture == -1 || update->gesture != this->gesture) && this->edited.elapsed() > UNDO_MERGE_MS)) {
+        return false;
+    }
+    this->value = update->value;
+    this->setText(update->text());
+    this->edited.restart();
+    return true;
+}
+
 // ######## UPDATE CONN PROB #################
 
 updateConnProb::updateConnProb(nl_rootdata * data, fixedProb_connection * ptr, float value, QUndoCommand *parent) :
@@ -1294,9 +1646,10 @@ void updateParType::redo()
 
 // ######## CHANGE TITLE #################
 
-updateTitle::updateTitle(QSharedPointer <population> ptr, QString newName, QString oldName, QUndoCommand *parent) :
+updateTitle::updateTitle(nl_rootdata * data, QSharedPointer <population> ptr, QString newName, QString oldName, QUndoCommand *parent) :
     QUndoCommand(parent)
 {
+    this->data = data;
     this->ptr = ptr;
     this->oldName = oldName;
     this->newName = newName;
@@ -1307,12 +1660,14 @@ void updateTitle::undo()
 {
     // set name
     ptr->name = oldName;
+    data->systemModelChanged();
 }
 
 void updateTitle::redo()
 {
     // set name
     ptr->name = newName;
+    data->systemModelChanged();
 }
 
 // ######## CHANGE PROJECTION DRAW STYLE #################
@@ -1580,17 +1935,39 @@ void pastePars::redo()
 // ######## COMPONENT #################
 
 changeComponent::changeComponent(RootComponentItem * root, QSharedPointer<Component> oldComponent, QString message, QUndoCommand *parent) :
-    QUndoCommand(parent)
+    snapshotUndoCommand(parent)
 {
     this->viewCL = &root->main->viewCL;
+    this->stack = &root->alPtr->undoStack;
     this->setText(message);
     this->unChangedComponent = oldComponent;
-    this->changedComponent = QSharedPointer<Component> (new Component(this->viewCL->root->al));
+    this->unChangedBytes = componentBytes(oldComponent);
+    this->changedBytes = 0;
     first_redo = true;
 }
 
 void changeComponent::undo()
 {
+    if (this->discarded) {
+        return;
+    }
+
+    // keep the component as it is now, for the redo. If the next change
+    // has been undone this is the component it went back to, so share that
+    if (this->changedComponent.isNull()) {
+        const changeComponent * next = (const changeComponent *)0;
+        if (this->stack->index() < this->stack->count()) {
+            next = dynamic_cast<const changeComponent *> (this->stack->command(this->stack->index()));
+        }
+        if (next != (const changeComponent *)0 && !next->discarded && !next->unChangedComponent.isNull()) {
+            this->changedComponent = next->unChangedComponent;
+            this->changedBytes = next->unChangedBytes;
+        } else {
+            this->changedComponent = QSharedPointer<Component> (new Component(this->viewCL->root->al));
+            this->changedBytes = componentBytes(this->changedComponent);
+        }
+    }
+
     // load the old version, copying across the pointer to the source component
     QSharedPointer<Component> alPtr = this->viewCL->root->alPtr;
     this->viewCL->mainWindow->initialiseModel(this->unChangedComponent);
@@ -1600,10 +1977,16 @@ void changeComponent::undo()
     QObject::connect(viewCL->fileList, SIGNAL(currentItemChanged(QListWidgetItem*,QListWidgetItem*)), viewCL->root->main, SLOT(fileListItemChanged(QListWidgetItem*,QListWidgetItem*)));
 
     viewCL->mainWindow->updateTitle(true);
+
+    this->applied = false;
+    snapshotUndoCommand::enforceLimit(this);
 }
 
 void changeComponent::redo()
 {
+    if (this->discarded) {
+        return;
+    }
     if (!first_redo) {
         // load the new version, copying across the pointer to the source component
         QSharedPointer<Component> alPtr = this->viewCL->root->alPtr;
@@ -1618,6 +2001,29 @@ void changeComponent::redo()
 
     viewCL->mainWindow->updateTitle(true);
 
+    this->applied = true;
+    snapshotUndoCommand::enforceLimit(this);
+}
+
+qint64 changeComponent::snapshotBytes(QSet <const void *> &seen)
+{
+    qint64 bytes = 0;
+    if (!this->unChangedComponent.isNull() && !seen.contains(this->unChangedComponent.data())) {
+        seen.insert(this->unChangedComponent.data());
+        bytes += this->unChangedBytes;
+    }
+    if (!this->changedComponent.isNull() && !seen.contains(this->changedComponent.data())) {
+        seen.insert(this->changedComponent.data());
+        bytes += this->changedBytes;
+    }
+    return bytes;
+}
+
+void changeComponent::discardSnapshots()
+{
+    this->unChangedComponent.clear();
+    this->changedComponent.clear();
+    this->applied = false;
 }
 
 changeComponentType::changeComponentType(RootComponentItem * root, QVector <QSharedPointer<Component> > * old_lib, QVector <QSharedPointer<Component> > * new_lib, QSharedPointer<Component> component, QString message, QUndoCommand *parent) :
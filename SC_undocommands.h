@@ -26,6 +26,9 @@
 #define UNDOCOMMANDS_H
 
 #include <QUndoCommand>
+#include <QUndoStack>
+#include <QSet>
+#include <QTime>
 #include <utility>
 #include "globalHeader.h"
 #include "NL_projection_and_synapse.h"
@@ -33,6 +36,58 @@
 #include "NL_connection.h"
 #include "EL_experiment.h"
 
+// ids of the commands which merge into the one before them when both edit
+// the same thing, so that an interactive edit is one undo step
+enum undoMergeId {
+    UNDO_ID_MOVE_POPULATION = 1,
+    UNDO_ID_MOVE_PROJECTION_HANDLE,
+    UNDO_ID_SET_SIZE,
+    UNDO_ID_SET_LOC3,
+    UNDO_ID_UPDATE_PAR
+};
+
+// edits of the same value made this close together (ms) are merged even
+// outside an undo gesture
+#define UNDO_MERGE_MS 750
+
+/*!
+ * \brief The snapshotUndoCommand class is the base of the undo commands which
+ * keep copies of the model, so that the memory held by the undo history can be
+ * kept within the limit set in the settings window. Past the limit the oldest
+ * snapshots are first moved to disk and then discarded; a command whose
+ * snapshots have been discarded no longer changes anything on undo or redo.
+ */
+class snapshotUndoCommand : public QUndoCommand
+{
+public:
+    snapshotUndoCommand(QUndoCommand *parent = 0);
+    virtual ~snapshotUndoCommand();
+
+    /*!
+     * Bring the memory held by all the snapshot commands within the limit,
+     * spilling and then discarding from the oldest. current is left alone.
+     */
+    static void enforceLimit(snapshotUndoCommand * current);
+
+protected:
+    // the bytes held in memory; a snapshot shared between commands is
+    // counted once, by its address in seen
+    virtual qint64 snapshotBytes(QSet <const void *> &seen) = 0;
+    // move what can be moved to disk
+    virtual void spillSnapshots() {}
+    // let go of the snapshots; only called while the command is applied
+    virtual void discardSnapshots() = 0;
+
+    bool applied;
+    bool spilled;
+    bool discarded;
+
+private:
+    static qint64 totalBytes();
+    // in the order the commands were made
+    static QList <snapshotUndoCommand *> history;
+};
+
 class delSelection : public QUndoCommand
 {
 public:
@@ -87,7 +142,12 @@ public:
     ~moveProjectionHandle() {};
     void undo();
     void redo();
+    int id() const { return UNDO_ID_MOVE_PROJECTION_HANDLE; }
+    bool mergeWith(const QUndoCommand * other);
 private:
+    // the undo gesture this was made in, or -1
+    int gesture;
+
     /*!
      * The rootData object, which is included so that the screen can
      * be re-drawn after restoring the position of the handle with
@@ -120,8 +180,12 @@ public:
     ~movePopulation() {}
     void undo();
     void redo();
+    int id() const { return UNDO_ID_MOVE_POPULATION; }
+    bool mergeWith(const QUndoCommand * other);
 
 private:
+    // the undo gesture this was made in, or -1
+    int gesture;
 
     /*!
      * The rootData object, which is included so that the screen can
@@ -247,18 +311,24 @@ private:
     bool isDeleted;
 };
 
-class changeConnection : public QUndoCommand
+class changeConnection : public snapshotUndoCommand
 {
 public:
     changeConnection(nl_rootdata * data, QSharedPointer<systemObject> pNewConn, int index, QUndoCommand *parent = 0);
     ~changeConnection() {
-        if (!this->isUndone) {
+        // while undone, oldConn is back in the model
+        if (this->applied) {
             delete this->oldConn;
         }
     }
     void undo();
     void redo();
 
+protected:
+    qint64 snapshotBytes(QSet <const void *> &seen);
+    void spillSnapshots();
+    void discardSnapshots();
+
 private:
     // these references are needed for the redo and undo
     nl_rootdata * data;
@@ -267,27 +337,30 @@ private:
     QString scriptName;
     QMap<QString, QString> mparams;
     connection * oldConn;
-    bool isUndone;
 };
 
-class globalConnectionDelayChange : public QUndoCommand
+class globalConnectionDelayChange : public snapshotUndoCommand
 {
 public:
     globalConnectionDelayChange(nl_rootdata * data, QSharedPointer<systemObject> pExistingConn, bool globalDelay, QUndoCommand *parent = 0);
     ~globalConnectionDelayChange() {
-        if (!this->isUndone) {
+        if (this->applied) {
             delete this->oldConn;
         }
     }
     void undo();
     void redo();
 
+protected:
+    qint64 snapshotBytes(QSet <const void *> &seen);
+    void spillSnapshots();
+    void discardSnapshots();
+
 private:
     // these references are needed for the redo and undo
     nl_rootdata * data;
     QSharedPointer<systemObject> connParent; // The connection's parent object. Contains the new connection details.
     connection * oldConn;
-    bool isUndone;
     bool globalDelay;
 };
 
@@ -297,6 +370,8 @@ public:
     setSizeUndo(nl_rootdata * data, QSharedPointer <population> ptr, int value, QUndoCommand *parent = 0);
     void undo();
     void redo();
+    int id() const { return UNDO_ID_SET_SIZE; }
+    bool mergeWith(const QUndoCommand * other);
 
 private:
     // these references are needed for the redo and undo
@@ -305,6 +380,10 @@ private:
     int oldValue;
     int value;
     bool firstRedo;
+    // the undo gesture this was made in, or -1, and the time since the
+    // last edit merged in
+    int gesture;
+    QTime edited;
 };
 
 class setLoc3Undo : public QUndoCommand
@@ -313,6 +392,8 @@ public:
     setLoc3Undo(nl_rootdata * data, QSharedPointer <population> ptr, int index, int value, QUndoCommand *parent = 0);
     void undo();
     void redo();
+    int id() const { return UNDO_ID_SET_LOC3; }
+    bool mergeWith(const QUndoCommand * other);
 
 private:
     // these references are needed for the redo and undo
@@ -321,6 +402,10 @@ private:
     int oldValue;
     int value;
     int index;
+    // the undo gesture this was made in, or -1, and the time since the
+    // last edit merged in
+    int gesture;
+    QTime edited;
 };
 
 class updateParUndo : public QUndoCommand
@@ -329,6 +414,8 @@ public:
     updateParUndo(nl_rootdata * data, ParameterInstance * ptr, int index, float value, QUndoCommand *parent = 0);
     void undo();
     void redo();
+    int id() const { return UNDO_ID_UPDATE_PAR; }
+    bool mergeWith(const QUndoCommand * other);
 
 private:
     // these references are needed for the redo and undo
@@ -338,6 +425,10 @@ private:
     float value;
     int index;
     bool firstRedo;
+    // the undo gesture this was made in, or -1, and the time since the
+    // last edit merged in
+    int gesture;
+    QTime edited;
 };
 
 class updateConnProb: public QUndoCommand
@@ -412,12 +503,13 @@ private:
 class updateTitle : public QUndoCommand
 {
 public:
-    updateTitle(QSharedPointer <population> ptr, QString newName, QString oldName, QUndoCommand *parent = 0);
+    updateTitle(nl_rootdata * data, QSharedPointer <population> ptr, QString newName, QString oldName, QUndoCommand *parent = 0);
     void undo();
     void redo();
 
 private:
     // these references are needed for the redo and undo
+    nl_rootdata * data;
     QSharedPointer <population> ptr;
     QString oldName;
     QString newName;
@@ -541,19 +633,34 @@ private:
 
 struct viewCLstruct;
 
-class changeComponent: public QUndoCommand
+class changeComponent: public snapshotUndoCommand
 {
 public:
     changeComponent(RootComponentItem *root, QSharedPointer<Component> oldComponent, QString message, QUndoCommand *parent = 0);
     ~changeComponent() {}
     void undo();
     void redo();
+    /*!
+     * True while the command has never been undone, so that a further
+     * edit may still join it (see RootComponentItem::isNewEdit).
+     */
+    bool isOpen() const {return !this->discarded && this->changedComponent.isNull() && !this->unChangedComponent.isNull();}
+
+protected:
+    qint64 snapshotBytes(QSet <const void *> &seen);
+    void discardSnapshots();
 
 private:
     // these references are needed for the redo and undo
     viewCLstruct * viewCL;
+    // the stack this is pushed on, to find the command after it
+    QUndoStack * stack;
+    // the component after the change; taken on the first undo, when it is
+    // the component being edited, or shared with the next command
     QSharedPointer<Component> changedComponent;
     QSharedPointer<Component> unChangedComponent;
+    qint64 changedBytes;
+    qint64 unChangedBytes;
     bool first_redo;
 };
 
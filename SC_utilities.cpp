@@ -1,9 +1,62 @@
+#ifdef _DEBUG
+  #undef _DEBUG
+  #include <Python.h>
+  #define _DEBUG
+#else
+  #include <Python.h>
+#endif
+
 #include "SC_utilities.h"
+#include "globalHeader.h"
 #include <QSettings>
+#include <QApplication>
+#include <QRegularExpression>
+#include <QMutex>
+#include <QThreadStorage>
+#include <iostream>
+
+// the main thread's Python state while it does not hold the GIL
+static PyThreadState * mainPythonThreadState = NULL;
+
+// Python is started when a connection script first needs it
+static QMutex pythonStartLock;
+static bool pythonRunning = false;
+
+namespace {
+    // where the errors stored on a thread go while it collects them
+    struct errorCollector
+    {
+        errorCollector() : errs((QStringList*)0) {}
+        QStringList* errs;
+    };
+}
+static QThreadStorage<errorCollector*> errorCollectors;
+
+void
+SCUtilities::collectErrors (QStringList* errs)
+{
+    if (!errorCollectors.hasLocalData()) {
+        errorCollectors.setLocalData (new errorCollector);
+    }
+    errorCollectors.localData()->errs = errs;
+}
+
+void
+SCUtilities::storeErrors (const QStringList& errs)
+{
+    for (int i = 0; i < errs.size(); ++i) {
+        SCUtilities::storeError (errs[i]);
+    }
+}
 
 void
 SCUtilities::storeError (QString emsg)
 {
+    if (errorCollectors.hasLocalData() && errorCollectors.localData()->errs) {
+        errorCollectors.localData()->errs->append (emsg);
+        return;
+    }
+
     QSettings settings;
     int num_errs = settings.beginReadArray("errors");
     settings.endArray();
@@ -12,3 +65,158 @@ SCUtilities::storeError (QString emsg)
     settings.setValue("errorText", emsg);
     settings.endArray();
 }
+
+bool
+SCUtilities::haveGui (void)
+{
+    return qobject_cast<QApplication*>(QCoreApplication::instance()) != (QApplication*)0;
+}
+
+void
+SCUtilities::showMessage (const QString& text, QMessageBox::Icon icon, bool richText)
+{
+    if (SCUtilities::haveGui()) {
+        QMessageBox msgBox;
+        msgBox.setText(text);
+        msgBox.setIcon(icon);
+        if (richText) {
+            msgBox.setTextFormat(Qt::RichText);
+        }
+        msgBox.exec();
+        return;
+    }
+
+    QString plain = text;
+    if (richText) {
+        plain.replace(QRegularExpression("<br/?>|</[Pp]>", QRegularExpression::CaseInsensitiveOption), "\n");
+        plain.remove(QRegularExpression("<[^>]*>"));
+    }
+    std::cerr << plain.trimmed().toStdString() << std::endl;
+}
+
+void
+SCUtilities::initPython (void)
+{
+    QMutexLocker locker(&pythonStartLock);
+    if (pythonRunning) {
+        return;
+    }
+    pythonRunning = true;
+
+#define PYTHON_NO_DEBUG
+#ifdef PYTHON_NO_DEBUG
+
+    // Initialise Python. To run numba cuda code, it's going to be
+    // necessary to set this up with a user-specifiable path to python
+    // and/or modules.
+    //
+    {
+        QSettings pysettings;
+
+        // Check the python/initialisation setting. If it's "true",
+        // then Py_Initialise() must have failed, in which case reset
+        // the python settings for programname and pythonhome to empty
+        // values.
+        QString python_init = pysettings.value ("python/initialisation", "false").toString();
+
+        if (python_init == "true") {
+            // then Py_Initialise failed
+            pysettings.setValue ("python/programname", "");
+            pysettings.setValue ("python/pythonhome", "");
+            DBG() << "Reset python path/home settings as Py_Initialise crashed.";
+
+        } else {
+            // Py_Initialise was ok last time
+            QString py_programname = pysettings.value("python/programname","").toString();
+
+#if PY_MAJOR_VERSION == 2
+            // Python 2.x API requires chars when calling
+            // Py_SetProgramName() etc, Python 3.x requires wchars.
+            char* py_programname_ca;
+            py_programname_ca = new char[py_programname.length() + 1];
+            memcpy (py_programname_ca, py_programname.toStdString().c_str(), py_programname.length());
+#elif PY_MAJOR_VERSION > 2
+            wchar_t* py_programname_ca;
+            py_programname_ca = new wchar_t[py_programname.length() + 1];
+            py_programname.toWCharArray (py_programname_ca);
+#endif
+            py_programname_ca[py_programname.length()] = 0;
+            if (!py_programname.isEmpty()) {
+                // When using Anaconda, set to /home/seb/anaconda3/bin/python
+                Py_SetProgramName (py_programname_ca);
+                DBG() << "Setting user-specified path to the python binary. Warning: SpineCreator may crash if this setting causes Py_Initialise() to fail. In this case, when SpineCreator re-starts it will erase the content of python path and home.";
+            }
+            delete py_programname_ca;
+
+            QString py_pythonhome = pysettings.value("python/pythonhome","").toString();
+#if PY_MAJOR_VERSION == 2
+            char* py_pythonhome_ca;
+            py_pythonhome_ca = new char[py_pythonhome.length() + 1];
+            memcpy (py_pythonhome_ca, py_pythonhome.toStdString().c_str(), py_pythonhome.length());
+#elif PY_MAJOR_VERSION >= 3
+            wchar_t* py_pythonhome_ca;
+            py_pythonhome_ca = new wchar_t[py_pythonhome.length() + 1];
+            py_pythonhome.toWCharArray (py_pythonhome_ca);
+#endif
+            py_pythonhome_ca[py_pythonhome.length()] = 0;
+
+            if (!py_pythonhome.isEmpty()) {
+                // Seb's value for pythonhome to use Anaconda in home
+                // directory with Numba CUDA:
+                // /home/seb/anaconda3:/home/seb/anaconda3/bin:/home/seb/anaconda3/lib:/home/seb/anaconda3/lib/python3.7:/home/seb/anaconda3/lib/python3.7/lib-dynload:/home/seb/anaconda3/lib/python3.7/site-packages:/home/seb/anaconda3/lib/python3.7/site-packages/numba:/home/seb/anaconda3/lib/python3.7/site-packages/numba/cuda
+                // NB: If python home is set to garbage, it will cause
+                // Py_Initialize() to abort the program. Hence the
+                // python_init scheme to check and see if we've
+                // initialised and crashed on a previous attempt.
+                Py_SetPythonHome(py_pythonhome_ca);
+                DBG() << "Setting user-specified PYTHONHOME. Warning: SpineCreator may crash if this setting causes Py_Initialise() to fail. In this case, when SpineCreator re-starts it will erase the content of python path and home.";
+            }
+            delete py_pythonhome_ca;
+        }
+
+        pysettings.setValue ("python/initialisation", "true");
+    } // ensure pysettings goes out of scope before Py_Initialize()
+
+    Py_Initialize();
+
+    { // New scope to reset python/initialisation to "false"
+        QSettings pysettings2;
+        pysettings2.setValue ("python/initialisation", "false");
+    }
+
+    // Connectivity scripts may run on worker threads, so release the GIL
+    // here and have each call into Python take it (see pythonGILLock)
+    PyEval_InitThreads();
+    mainPythonThreadState = PyEval_SaveThread();
+#endif
+
+#ifdef DEBUG
+    DBG() << "Python interpreter: " << (wchar_t*)Py_GetProgramName();
+    DBG() << "Py_GetPrefix(): " << (wchar_t*)Py_GetPrefix();
+    DBG() << "Py_GetExecPrefix(): " << (wchar_t*)Py_GetExecPrefix();
+    DBG() << "Py_GetPath(): " << (wchar_t*)Py_GetPath();
+    DBG() << "Py_GetProgramFullPath(): " << (wchar_t*)Py_GetProgramFullPath();
+#endif
+}
+
+bool
+SCUtilities::pythonStarted (void)
+{
+    QMutexLocker locker(&pythonStartLock);
+    return pythonRunning;
+}
+
+void
+SCUtilities::finalizePython (void)
+{
+    QMutexLocker locker(&pythonStartLock);
+    if (!pythonRunning) {
+        return;
+    }
+    pythonRunning = false;
+    if (mainPythonThreadState != NULL) {
+        PyEval_RestoreThread(mainPythonThreadState);
+        mainPythonThreadState = NULL;
+    }
+    Py_Finalize();
+}
@@ -30,6 +30,8 @@
 #define _SC_UTILITIES_H_ 1
 
 #include <QString>
+#include <QStringList>
+#include <QMessageBox>
 
 class SCUtilities {
 public:
@@ -37,9 +39,46 @@ public:
 
     /*!
      * Store the error @param emsg in a QSettings object called
-     * "errors".
+     * "errors". On a thread which is collecting its errors, it is kept
+     * in the collector's list instead.
      */
     static void storeError (QString emsg);
+
+    /*!
+     * Keep the errors stored on this thread in @param errs, rather than
+     * in the settings, until this is called again with null. Jobs run on
+     * a pool do this, and their errors are passed to storeErrors() on the
+     * GUI thread once they are done, as the settings array can not be
+     * added to from several threads at once.
+     */
+    static void collectErrors (QStringList* errs);
+    static void storeErrors (const QStringList& errs);
+
+    /*!
+     * True if there is a QApplication, so that dialogs may be shown;
+     * false when running headless under a QCoreApplication.
+     */
+    static bool haveGui (void);
+
+    /*!
+     * Show @param text in a message box or, when there is no GUI,
+     * write it to stderr (without its markup, if @param richText).
+     */
+    static void showMessage (const QString& text,
+                             QMessageBox::Icon icon = QMessageBox::NoIcon,
+                             bool richText = false);
+
+    /*!
+     * Start the Python interpreter, if it is not already running,
+     * using the python/programname and python/pythonhome settings,
+     * and release the GIL for connectivity scripts to take. It is
+     * started on first use, preferably from the GUI thread, as the
+     * thread which starts it is the one which finalizePython() shuts
+     * it down on.
+     */
+    static void initPython (void);
+    static bool pythonStarted (void);
+    static void finalizePython (void);
 };
 
 #endif // _SC_UTILITIES_H_
@@ -28,11 +28,38 @@ vectorModel::vectorModel(QObject *parent) :
     QAbstractTableModel(parent)
 {
     this->currPar = (ParameterInstance *)0;
+    this->fetchedRows = 0;
+}
+
+int vectorModel::listRows() const
+{
+    return currPar ? currPar->value.size() : 0;
 }
 
 int vectorModel::rowCount(const QModelIndex & /*parent = QModelIndex()*/) const
 {
-    return currPar->value.size()+1;
+    if (fetchedRows < listRows()) {
+        return fetchedRows;
+    }
+    return listRows()+1;
+}
+
+bool vectorModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && fetchedRows < listRows();
+}
+
+void vectorModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    int more = qMin(LIST_MODEL_PAGE_ROWS, listRows()-fetchedRows);
+    // the last page brings the empty row with it
+    int last = fetchedRows+more < listRows() ? fetchedRows+more-1 : fetchedRows+more;
+    beginInsertRows(QModelIndex(), fetchedRows, last);
+    fetchedRows += more;
+    endInsertRows();
 }
 int vectorModel::columnCount(const QModelIndex &/*parent = QModelIndex()*/) const
 {
@@ -43,8 +70,9 @@ QVariant vectorModel::data(const QModelIndex &index, int role) const
     if (role == Qt::DisplayRole)
     {
         if (index.column() == 0) {
+            // at() so that a list shared with a copy is not detached
             if (index.row() < (int) currPar->indices.size())
-                return currPar->indices[index.row()];
+                return currPar->indices.at(index.row());
             else if (index.row() == (int) currPar->indices.size())
                 return "";
             else
@@ -52,7 +80,7 @@ QVariant vectorModel::data(const QModelIndex &index, int role) const
         }
         else if (index.column() == 1) {
             if (index.row() < (int) currPar->value.size())
-                return currPar->value[index.row()];
+                return currPar->value.at(index.row());
             else if (index.row() == (int) currPar->value.size())
                 return "";
             else
@@ -64,12 +92,17 @@ QVariant vectorModel::data(const QModelIndex &index, int role) const
 }
 void vectorModel::setPointer(ParameterInstance * currPar)
 {
+    beginResetModel();
     this->currPar = currPar;
+    this->fetchedRows = qMin(LIST_MODEL_PAGE_ROWS, listRows());
+    endResetModel();
 }
 
 void vectorModel::emitDataChanged() {
-   QModelIndex index = this->createIndex(0,0);
-   emit dataChanged(index, index);
+    // the list may have been replaced, so start again from the first page
+    beginResetModel();
+    this->fetchedRows = qMin(LIST_MODEL_PAGE_ROWS, listRows());
+    endResetModel();
 }
 
 QVariant vectorModel::headerData(int section, Qt::Orientation orientation, int role) const {
@@ -104,6 +137,7 @@ bool vectorModel::setData(const QModelIndex & index, const QVariant & value, int
                 currPar->value.back() = 0;
                 currPar->indices.resize(currPar->indices.size()+1);
                 currPar->indices.back() = value.toInt();
+                fetchedRows = listRows();
                 endInsertRows();
                 emit setSpinBoxVal(currPar->value.size());
             }
@@ -118,6 +152,7 @@ bool vectorModel::setData(const QModelIndex & index, const QVariant & value, int
                 currPar->value.back() = value.toFloat();
                 currPar->indices.resize(currPar->indices.size()+1);
                 currPar->indices.back() = 0;
+                fetchedRows = listRows();
                 endInsertRows();
                 emit setSpinBoxVal(currPar->value.size());
             }
@@ -129,27 +164,26 @@ bool vectorModel::setData(const QModelIndex & index, const QVariant & value, int
 
 bool vectorModel::insertConnRows(int row) {
 
-    if (row > (int) currPar->indices.size()) {
-        beginInsertRows(this->createIndex(currPar->indices.size()-1, 0).parent(),currPar->indices.size(),row-1);
+    if (row == (int) currPar->indices.size()) {
+        return true;
+    }
 
+    bool allShown = fetchedRows >= listRows();
+    beginResetModel();
+    if (row > (int) currPar->indices.size()) {
         int start = currPar->indices.size();
         currPar->value.resize(row);
         currPar->indices.resize(row);
         // and fill in indices
         for (int i = start; i < currPar->indices.size(); ++i)
             currPar->indices[i] = i;
-
-        endInsertRows();
-        emit setSpinBoxVal(currPar->value.size());
-    }
-    if (row < (int) currPar->indices.size()) {
-        beginRemoveRows(this->createIndex(currPar->indices.size()-1, 0).parent(),row, currPar->indices.size()-1);
+    } else {
         currPar->value.resize(row);
         currPar->indices.resize(row);
-
-        endRemoveRows();
-        emit setSpinBoxVal(currPar->value.size());
     }
+    fetchedRows = allShown ? row : qMin(fetchedRows, row);
+    endResetModel();
+    emit setSpinBoxVal(currPar->value.size());
 
     return true;
 
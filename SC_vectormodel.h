@@ -42,9 +42,15 @@ public:
     bool insertConnRows(int row);
     Qt::ItemFlags flags(const QModelIndex & /*index*/) const;
     void emitDataChanged();
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
 
 private:
     ParameterInstance * currPar;
+    // the rows shown so far; the empty row for adding a value follows
+    // them once the whole list is shown
+    int fetchedRows;
+    int listRows() const;
 
 signals:
     void editCompleted(const QString &);
@@ -25,79 +25,87 @@
 #include "SC_versioncontrol.h"
 #include "QProcess"
 #include "QSettings"
+#include "QTimer"
 #include "globalHeader.h"
 #include "SC_commitdialog.h"
+#include "SC_settings.h"
+#include "SC_utilities.h"
 
-versionControl::versionControl(QObject *parent) :
-    QObject(parent)
-{
-
-    // detect version control systems
-    this->detectVCSes();
-
-    this->version = NONE;
-
-}
-
-void versionControl::detectVCSes() {
-
-    // check for mercurial
+int versionControl::mercurialFound = -1;
+bool versionControl::mercurialDetecting = false;
 
-    // set up the environment for the spawned processes
+// the environment for the spawned processes
+static QProcessEnvironment mercurialEnvironment()
+{
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    //env.insert("PATH", qgetenv("PATH"));
 
     // the path fetched by Qt on Mac may not include /usr/local/bin, so we need to check and add it
 #ifdef Q_OS_MAC
     QString path = qgetenv("PATH");
     if (!path.contains("/usr/local/bin")) {
         path = path + ":/usr/local/bin";
+        // in addition the environment of spineCreator on Mac may not include /usr/local/bin, which is needed to launch hg in the first place
+        qputenv("PATH", path.toStdString().c_str());
     }
-    qDebug() << path;
-    env.insert("PATH", path);
-    // in addition the environment of spineCreator on Mac may not include /usr/local/bin, which is needed to launch hg in the first place
-    qputenv("PATH", path.toStdString().c_str());
-#else
-    env.insert("PATH", qgetenv("PATH"));
-#endif
-
-    // make the QProcess
-    QProcess * mercurial = new QProcess;
-    mercurial->setWorkingDirectory(qgetenv("HOME"));
-    mercurial->setProcessEnvironment(env);
-
-#ifdef NEED_VERSIONCONTROL_FINISHED
-    connect(mercurial, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(finished(int, QProcess::ExitStatus)));
 #endif
-    connect(mercurial, SIGNAL(readyReadStandardOutput()), this, SLOT(standardOutput()));
-    connect(mercurial, SIGNAL(readyReadStandardError()), this, SLOT(standardError()));
+    env.insert("PATH", qgetenv("PATH"));
+    // to be used as a username if one is not set
+    env.insert("EMAIL", QHostInfo::localHostName());
+    return env;
+}
 
-    mercurial->start("hg");
+versionControl::versionControl(QObject *parent) :
+    QObject(parent)
+{
+    this->version = NONE;
+    this->running = NULL;
+    this->closing = false;
+    this->flushQueued = false;
+    this->statusCurrent = false;
+
+    this->watchdog = new QTimer(this);
+    this->watchdog->setSingleShot(true);
+    connect(this->watchdog, SIGNAL(timeout()), this, SLOT(jobTimedOut()));
+
+    // detect version control systems, once for all projects
+    if (mercurialFound == -1 && !mercurialDetecting) {
+        mercurialDetecting = true;
+        this->runMercurial(VCS_DETECT, QStringList() << "--version");
+    }
+}
 
-    isMercurialThere = mercurial->waitForFinished(1000);
+versionControl::~versionControl()
+{
+    this->waitForJobs();
+}
 
-    delete mercurial;
+void versionControl::detectVCSes() {
 
+    // check for mercurial again, and then for the model's repository
+    mercurialFound = -1;
+    mercurialDetecting = true;
+    this->runMercurial(VCS_DETECT, QStringList() << "--version");
+    this->setupVersion();
 }
 
 bool versionControl::haveMercurial() {
 
-    return this->isMercurialThere;
+    return mercurialFound == 1;
 }
 
 bool versionControl::isModelUnderMercurial() {
 
-    if (!this->isMercurialThere)
-        return false;
-
-    QSettings settings;
+    // as found by the last setupVersion()
+    return this->version == MERCURIAL;
+}
 
-    // get current model path from QSettings
+QString versionControl::modelDir() {
 
-    QString path = settings.value("files/currentFileName", "No model").toString();
+    // get current model path
+    QString path = settingsCache::currentFileName("No model");
 
     if (path == "No model") {
-        return false;
+        return QString();
     }
 
     // strip the .proj from the end of the path, if has the .proj
@@ -105,135 +113,164 @@ bool versionControl::isModelUnderMercurial() {
         int index = path.lastIndexOf(QDir::toNativeSeparators("/"));
         path.chop(path.size()-index);
     }
+    return QDir::toNativeSeparators(path);
+}
 
-    // set up the environment for the spawned processes
-    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    env.insert("PATH", qgetenv("PATH"));
+// add a file to the repository
+bool versionControl::addToMercurial(QString file) {
 
-    // make the QProcess
-    QProcess * mercurial = new QProcess;
-    mercurial->setWorkingDirectory(QDir::toNativeSeparators(path));
-    mercurial->setProcessEnvironment(env);
+    QString dir = this->modelDir();
+    if (dir.isEmpty()) {
+        return false;
+    }
+    if (!this->pendingDir.isEmpty() && dir != this->pendingDir) {
+        this->flushPending();
+    }
+    this->pendingDir = dir;
 
-#ifdef NEED_VERSIONCONTROL_FINISHED
-    connect(mercurial, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(finished(int, QProcess::ExitStatus)));
-#endif
-    connect(mercurial, SIGNAL(readyReadStandardOutput()), this, SLOT(standardOutput()));
-    connect(mercurial, SIGNAL(readyReadStandardError()), this, SLOT(standardError()));
+    // saving removes and then rewrites some files; they are still tracked
+    this->pendingRemoves.removeAll(file);
+    if (!this->pendingAdds.contains(file)) {
+        this->pendingAdds.push_back(file);
+    }
 
-    mercurial->start("hg summary");
+    // passed to hg together once the save is done
+    if (!this->flushQueued) {
+        this->flushQueued = true;
+        QTimer::singleShot(0, this, SLOT(flushPending()));
+    }
+    return true;
+}
 
-    bool noerror = mercurial->waitForFinished(1000);
+// remove a file from the repository
+bool versionControl::removeFromMercurial(QString file) {
 
-    // tidy these up every so often...
-    stdOutText.clear();
-    stdErrText.clear();
+    QString dir = this->modelDir();
+    if (dir.isEmpty()) {
+        return false;
+    }
+    if (!this->pendingDir.isEmpty() && dir != this->pendingDir) {
+        this->flushPending();
+    }
+    this->pendingDir = dir;
 
-    if (noerror) {
-        // check output
-        if (mercurial->exitCode() == 0) {
-            return true;
-        } else {
-            return false;
-        }
+    if (!this->pendingRemoves.contains(file)) {
+        this->pendingRemoves.push_back(file);
     }
-    return false;
+    if (!this->flushQueued) {
+        this->flushQueued = true;
+        QTimer::singleShot(0, this, SLOT(flushPending()));
+    }
+    return true;
 }
 
-// add a file to the repository
-bool versionControl::addToMercurial(QString file) {
-
-    return runMercurial("add \"" + file + "\"");
-}
+void versionControl::flushPending() {
 
-// remove a file from the repository
-bool versionControl::removeFromMercurial(QString file) {
+    this->flushQueued = false;
+    if (this->pendingDir.isEmpty()) {
+        return;
+    }
 
-    return runMercurial("remove \"" + file + "\"");
+    // the files have already been deleted; --after only records it, so
+    // that a file which has been written again is left alone
+    if (!this->pendingRemoves.isEmpty()) {
+        vcsJob job;
+        job.type = VCS_CHANGE;
+        job.dir = this->pendingDir;
+        job.args << "remove" << "--after" << this->pendingRemoves;
+        this->jobs.push_back(job);
+    }
+    if (!this->pendingAdds.isEmpty()) {
+        vcsJob job;
+        job.type = VCS_CHANGE;
+        job.dir = this->pendingDir;
+        job.args << "add" << this->pendingAdds;
+        this->jobs.push_back(job);
+    }
+    this->pendingRemoves.clear();
+    this->pendingAdds.clear();
+    this->pendingDir.clear();
+    this->statusCurrent = false;
 
+    this->startNextJob();
 }
 
 // commit a new version
 bool versionControl::commitMercurial(QString message) {
 
-    // different OS require different tricks for multi-line messages
-#if defined Q_OS_LINUX
-    QString moo =       "commit -m \"$(echo -e '" + message + "')\"";
-    qDebug() << moo;
-    return runMercurial("commit -m \"" + message + "\"");
-#elif defined Q_OS_MAC
-    return runMercurial("commit -m \"$(echo -e '" + message + "')\"");
-#elif defined Q_OS_WIN
-    return runMercurial("commit -m \"" + message + "\"");
-#else
-    // Assume Unix-like
-    return runMercurial("commit -m \"$(echo -e '" + message + "')\"");
-#endif
+    // the message is passed as one argument, with no shell, so it may
+    // hold several lines
+    this->flushPending();
+    return runMercurial(VCS_CHANGE, QStringList() << "commit" << "-m" << message);
 }
 
 // remove a file from the repository
 bool versionControl::updateMercurial() {
 
-    return runMercurial("update");
+    return runMercurial(VCS_CHANGE, QStringList() << "update");
 
 }
 
 // remove a file from the repository
 bool versionControl::revertMercurial() {
 
-    return runMercurial("revert");
+    return runMercurial(VCS_CHANGE, QStringList() << "revert");
 
 }
 
-// read the log
-QString versionControl::showMercurialLog() {
+// read the log, which is shown when hg has finished
+void versionControl::showMercurialLog() {
 
-    runMercurial("log -v");
-    return stdOutText;
+    runMercurial(VCS_SHOW_LOG, QStringList() << "log" << "-v");
 
 }
 
 // fetch the status
-QString versionControl::showMercurialStatus() {
+void versionControl::showMercurialStatus() {
 
-    runMercurial("status");
-    return stdOutText;
+    runMercurial(VCS_SHOW_STATUS, QStringList() << "status");
 
 }
 
-bool versionControl::runMercurial(QString options) {
+bool versionControl::runMercurial(vcsJobType type, const QStringList &args) {
 
-    if (!this->isMercurialThere)
-        return false;
-
-    QSettings settings;
-
-    // get current model path from QSettings
+    vcsJob job;
+    job.type = type;
+    job.args = args;
+    if (type == VCS_DETECT) {
+        job.dir = qgetenv("HOME");
+    } else {
+        if (mercurialFound == 0) {
+            return false;
+        }
+        job.dir = this->modelDir();
+        if (job.dir.isEmpty()) {
+            return false;
+        }
+    }
+    if (type == VCS_CHANGE) {
+        this->statusCurrent = false;
+    }
 
-    QString path = settings.value("files/currentFileName", "No model").toString();
+    this->jobs.push_back(job);
+    this->startNextJob();
+    return true;
+}
 
-    if (path == "No model") {
-        return false;
-    }
+void versionControl::startNextJob() {
 
-    // strip the .proj from the end of the path, if has the .proj
-    if (path.contains(".proj")) {
-        int index = path.lastIndexOf(QDir::toNativeSeparators("/"));
-        path.chop(path.size()-index);
+    if (this->running != NULL || this->jobs.isEmpty()) {
+        return;
     }
-
-    // set up the environment for the spawned processes
-    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    env.insert("PATH", qgetenv("PATH"));
-    // to be used as a username if one is not set
-    env.insert("EMAIL", QHostInfo::localHostName());
+    this->runningJob = this->jobs.takeFirst();
 
     // make the QProcess
-    QProcess * mercurial = new QProcess;
-    mercurial->setWorkingDirectory(QDir::toNativeSeparators(path));
-    mercurial->setProcessEnvironment(env);
+    QProcess * mercurial = new QProcess(this);
+    mercurial->setWorkingDirectory(this->runningJob.dir);
+    mercurial->setProcessEnvironment(mercurialEnvironment());
 
-    //connect(mercurial, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(finished(int, QProcess::ExitStatus)));
+    connect(mercurial, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(jobFinished(int,QProcess::ExitStatus)));
+    connect(mercurial, SIGNAL(error(QProcess::ProcessError)), this, SLOT(jobError(QProcess::ProcessError)));
     connect(mercurial, SIGNAL(readyReadStandardOutput()), this, SLOT(standardOutput()));
     connect(mercurial, SIGNAL(readyReadStandardError()), this, SLOT(standardError()));
 
@@ -242,25 +279,137 @@ bool versionControl::runMercurial(QString options) {
     stdErrText.clear();
 
     // launch
-    mercurial->start("hg " + options);
+    this->running = mercurial;
+    mercurial->start("hg", this->runningJob.args);
+    this->watchdog->start(VCS_JOB_TIMEOUT_MS);
+}
 
-    // wait until complete, or 3 s
-    bool noerror = mercurial->waitForFinished(3000);
+void versionControl::jobFinished(int exitCode, QProcess::ExitStatus status) {
 
-    if (noerror) {
-        // check output
-        if (mercurial->exitCode() == 0) {
-            delete mercurial;
-            return true;
-        } else {
-            delete mercurial;
-            return false;
+    if (sender() != this->running) {
+        return;
+    }
+    // check output
+    this->jobDone(status == QProcess::NormalExit && exitCode == 0);
+}
+
+void versionControl::jobError(QProcess::ProcessError error) {
+
+    // a process which started reports its end through finished()
+    if (sender() != this->running || error != QProcess::FailedToStart) {
+        return;
+    }
+    mercurialFound = 0;
+    this->jobDone(false);
+}
+
+void versionControl::jobTimedOut() {
+
+    if (this->running != NULL) {
+        DBG() << "hg " << this->runningJob.args << " did not finish, killing it";
+        this->running->kill();
+    }
+}
+
+void versionControl::jobDone(bool ok) {
+
+    this->watchdog->stop();
+    this->running->disconnect(this);
+    this->running->deleteLater();
+    this->running = NULL;
+
+    vcsJob job = this->runningJob;
+    QString out = this->stdOutText;
+    if (!ok && job.type == VCS_CHANGE) {
+        DBG() << "hg " << job.args << " failed: " << this->stdErrText;
+    }
+
+    bool changed = false;
+    switch (job.type) {
+    case VCS_DETECT:
+        // hg ran, so it is installed
+        mercurialDetecting = false;
+        if (mercurialFound != 0) {
+            mercurialFound = 1;
+        }
+        changed = true;
+        break;
+    case VCS_SUMMARY:
+    {
+        versionType found = ok ? MERCURIAL : NONE;
+        changed = found != this->version;
+        this->version = found;
+        if (ok && !this->closing) {
+            this->runMercurial(VCS_STATUS, QStringList() << "status");
+        }
+        break;
+    }
+    case VCS_CHANGE:
+        // keep the cached status up to date
+        if (!this->closing) {
+            bool queued = false;
+            for (int i = 0; i < this->jobs.size(); ++i) {
+                queued = queued || this->jobs[i].type == VCS_STATUS || this->jobs[i].type == VCS_SHOW_STATUS;
+            }
+            if (!queued) {
+                this->runMercurial(VCS_STATUS, QStringList() << "status");
+            }
+        }
+        break;
+    case VCS_STATUS:
+    case VCS_SHOW_STATUS:
+        if (ok) {
+            this->cachedStatus = out;
+            this->statusCurrent = true;
+            for (int i = 0; i < this->jobs.size(); ++i) {
+                this->statusCurrent = this->statusCurrent && this->jobs[i].type != VCS_CHANGE;
+            }
         }
+        break;
+    case VCS_SHOW_LOG:
+        break;
+    }
+
+    this->startNextJob();
 
+    if (changed) {
+        emit versionChanged();
+    }
+
+    if (this->closing || !SCUtilities::haveGui()) {
+        return;
     }
-    delete mercurial;
-    return false;
 
+    // show the status or log
+    if (job.type == VCS_SHOW_STATUS || job.type == VCS_SHOW_LOG) {
+        commitDialog * dialog = new commitDialog;
+        if (job.type == VCS_SHOW_STATUS) {
+            dialog->showStatus(out);
+        } else {
+            dialog->showLog(out);
+        }
+        dialog->exec();
+        delete dialog;
+    }
+}
+
+void versionControl::waitForJobs() {
+
+    // no more status refreshes or dialogs
+    this->closing = true;
+    this->flushPending();
+    while (this->running != NULL) {
+        QProcess * mercurial = this->running;
+        if (!mercurial->waitForFinished(VCS_JOB_TIMEOUT_MS) && this->running == mercurial) {
+            // it did not finish, or never started
+            mercurial->kill();
+            mercurial->waitForFinished(1000);
+            if (this->running == mercurial) {
+                this->jobDone(false);
+            }
+        }
+    }
+    this->closing = false;
 }
 
 bool versionControl::haveVersion() {
@@ -367,27 +516,25 @@ bool versionControl::revertVersion() {
 
 bool versionControl::showVersionStatus() {
 
-    QString status;
-
     switch (this->version) {
     case NONE:
         return false;
     case MERCURIAL:
-        status = showMercurialStatus();
         break;
     case SVN:
     case CVS:
         return false;
     }
 
-    // show log
-    commitDialog * dialog = new commitDialog;
-    dialog->showStatus(status);
-    switch(dialog->exec()) {
-    case QDialog::Accepted:
-        return true;
-    case QDialog::Rejected:
-        return true;
+    // show the cached status if nothing has changed since it was read,
+    // otherwise once it has been refreshed
+    if (this->statusCurrent) {
+        commitDialog * dialog = new commitDialog;
+        dialog->showStatus(this->cachedStatus);
+        dialog->exec();
+        delete dialog;
+    } else {
+        showMercurialStatus();
     }
 
     return true;
@@ -396,66 +543,32 @@ bool versionControl::showVersionStatus() {
 
 bool versionControl::showVersionLog() {
 
-    QString log;
-
     switch (this->version) {
     case NONE:
         return false;
     case MERCURIAL:
-        log = showMercurialLog();
+        showMercurialLog();
         break;
     case SVN:
     case CVS:
         return false;
     }
 
-    // show log
-    commitDialog * dialog = new commitDialog;
-    dialog->showLog(log);
-    switch(dialog->exec()) {
-    case QDialog::Accepted:
-        return true;
-    case QDialog::Rejected:
-        return true;
-    }
-
     return true;
 }
 
 void versionControl::setupVersion() {
 
-    if (isModelUnderMercurial()) {
-        this->version = MERCURIAL;
-        return;
-    }
-
-    this->version = NONE;
-
-}
-
-
-#ifdef NEED_VERSIONCONTROL_FINISHED
-void versionControl::finished(int, QProcess::ExitStatus status)
-{
-    // get status
-    /*if (status == QProcess::CrashExit) {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle("Simulator Error");
-        msgBox.setText(stdErrText);
-        msgBox.exec();
-        return;
+    // the model's repository is checked in the background, and
+    // versionChanged() emitted if it is not what was last found
+    if (mercurialFound == 0 || !this->runMercurial(VCS_SUMMARY, QStringList() << "summary")) {
+        if (this->version != NONE) {
+            this->version = NONE;
+            emit versionChanged();
+        }
     }
-    if (status == QProcess::NormalExit) {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle("Simulator Complete");
-        msgBox.setText(stdOutText);
-        msgBox.exec();
-        return;
-    }*/
 
-    // collect logs
 }
-#endif
 
 void versionControl::standardOutput() {
 
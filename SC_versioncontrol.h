@@ -27,6 +27,9 @@
 
 #include <QObject>
 #include <QProcess>
+#include <QStringList>
+
+class QTimer;
 
 enum versionType {
     NONE,
@@ -35,11 +38,42 @@ enum versionType {
     CVS
 };
 
+// an hg job is killed if it has not finished after this long
+#define VCS_JOB_TIMEOUT_MS 120000
+
+enum vcsJobType {
+    VCS_DETECT,      // is hg installed?
+    VCS_SUMMARY,     // is the model in a repository?
+    VCS_CHANGE,      // add, remove, commit, update or revert
+    VCS_STATUS,      // refresh the cached status
+    VCS_SHOW_STATUS, // refresh the cached status and show it
+    VCS_SHOW_LOG
+};
+
+struct vcsJob {
+    vcsJobType type;
+    QString dir;
+    QStringList args;
+};
+
+/*!
+ * \brief The versionControl class keeps a project's model under Mercurial.
+ *
+ * hg is never waited for on the GUI thread: each operation is queued as a
+ * vcsJob and the jobs are run one at a time in the background. Whether hg
+ * is installed, whether the model is in a repository and its status are
+ * cached, and versionChanged() is emitted when the first two change. Files
+ * added and removed while a project is saved are collected and passed to
+ * a single hg add and hg remove once the save has returned to the event
+ * loop. Jobs still queued when the object is destroyed are run to the end
+ * first.
+ */
 class versionControl : public QObject
 {
     Q_OBJECT
 public:
     explicit versionControl(QObject *parent = 0);
+    ~versionControl();
 
     void detectVCSes();
 
@@ -50,9 +84,9 @@ public:
     bool commitMercurial(QString message);
     bool updateMercurial();
     bool revertMercurial();
-    QString showMercurialLog();
-    QString showMercurialStatus();
-    bool runMercurial(QString options);
+    void showMercurialLog();
+    void showMercurialStatus();
+    bool runMercurial(vcsJobType type, const QStringList &args);
 
     bool haveVersion();
     bool isModelUnderVersion();
@@ -66,18 +100,50 @@ public:
 
     void setupVersion();
 
+    /*!
+     * Run every queued job, and the pending adds and removes, to the end.
+     */
+    void waitForJobs();
+
 private:
+    QString modelDir();
+    void startNextJob();
+    void jobDone(bool ok);
+
     QString stdOutText;
     QString stdErrText;
-    bool isMercurialThere;
     versionType version;
 
+    // hg is looked for once, for every project: -1 until it is known
+    static int mercurialFound;
+    static bool mercurialDetecting;
+
+    QList < vcsJob > jobs;
+    QProcess * running;
+    vcsJob runningJob;
+    QTimer * watchdog;
+    bool closing;
+
+    // files to pass to hg add and hg remove in the directory pendingDir
+    QStringList pendingAdds;
+    QStringList pendingRemoves;
+    QString pendingDir;
+    bool flushQueued;
+
+    // hg status, and whether it has been read since the last change
+    QString cachedStatus;
+    bool statusCurrent;
+
 signals:
+    void versionChanged();
 
 public slots:
-#ifdef NEED_VERSIONCONTROL_FINISHED
-    void finished(int, QProcess::ExitStatus status);
-#endif
+    void flushPending();
+
+private slots:
+    void jobFinished(int, QProcess::ExitStatus status);
+    void jobError(QProcess::ProcessError error);
+    void jobTimedOut();
     void standardOutput();
     void standardError();
 
@@ -34,6 +34,11 @@
 #include "EL_experiment.h"
 #include "SC_projectobject.h"
 #include "SC_undocommands.h"
+#include "SC_settings.h"
+#include "SC_modelvalidator.h"
+#include "SC_runcache.h"
+#include "SC_executionbackend.h"
+#include "SC_batchexperimentwindow.h"
 #include "qmessageboxresizable.h"
 #include <QTimer>
 
@@ -53,6 +58,7 @@
 viewELExptPanelHandler::viewELExptPanelHandler(QObject *parent) :
     QObject(parent)
 {
+    this->backend = (executionBackend *) 0;
 }
 
 viewELExptPanelHandler::viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdata * data, QObject *parent) :
@@ -78,12 +84,15 @@ viewELExptPanelHandler::viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdat
 
     ((QHBoxLayout *) this->viewEL->expt->layout())->setContentsMargins(0,0,0,0);
 
-    // for animation
-    QTimer *timer = new QTimer( this );
-    // this creates a Qt timer event
-    connect( timer, SIGNAL(timeout()), this->gl, SLOT(animate()) );
-    // launch the timer
-    timer->start(16);
+    // animated by the animationScheduler, when it has anything to redraw
+#endif
+
+    // simulation progress is picked up from the sim time file as it changes
+    this->simTimeUpdateTimer.setSingleShot(true);
+    this->simTimeLastProgress = -1;
+    this->backend = (executionBackend *) 0;
+#ifdef Q_OS_WIN
+    this->simFinishPending = false;
 #endif
 
     this->exptSetup->setContentsMargins(14*RETINA_SUPPORT,14*RETINA_SUPPORT,14*RETINA_SUPPORT,14*RETINA_SUPPORT);
@@ -128,7 +137,6 @@ viewELExptPanelHandler::viewELExptPanelHandler(viewELstruct * viewEL, nl_rootdat
     // panel is part of struct viewELstruct and is a QWidget:
     this->viewEL->panel->setStyleSheet("QWidget { background-color: white; }");
 
-    redrawPanel();
     redrawExpt();
 
 }
@@ -189,7 +197,6 @@ void viewELExptPanelHandler::recursiveDeleteExpt(QLayout * parentLayout)
 
 void viewELExptPanelHandler::redraw()
 {
-    redrawPanel();
     redrawExpt();
     // update title in case of undo / redo so the * accurately reflects unsaved changes
     this->data->main->updateTitle();
@@ -197,7 +204,6 @@ void viewELExptPanelHandler::redraw()
 
 void viewELExptPanelHandler::redraw(int)
 {
-    redrawPanel();
     redrawExpt();
     // update title in case of undo / redo so the * accurately reflects unsaved changes
     this->data->main->updateTitle();
@@ -205,7 +211,6 @@ void viewELExptPanelHandler::redraw(int)
 
 void viewELExptPanelHandler::redraw(double)
 {
-    redrawPanel();
     redrawExpt();
     // update title in case of undo / redo so the * accurately reflects unsaved changes
     this->data->main->updateTitle();
@@ -306,6 +311,7 @@ void viewELExptPanelHandler::redrawExpt()
     recursiveDeleteExpt(exptInputs);
     recursiveDeleteExpt(exptOutputs);
     recursiveDeleteExpt(exptChanges);
+    rowsUsed.clear();
 
     experiment * currentExperiment = NULL;
 
@@ -314,10 +320,11 @@ void viewELExptPanelHandler::redrawExpt()
         if (data->experiments[i]->selected) {currentExperiment = data->experiments[i]; break;}
     }
 
-    if (currentExperiment == NULL) return;
-
-    if (currentExperiment->editing)
+    if (currentExperiment == NULL || currentExperiment->editing) {
+        dropUnusedRows();
+        this->redrawPanel();
         return;
+    }
 
     // check if we have any edits going on - if we do then disable the Run Simulator button
     bool edit_going_on = false;
@@ -397,6 +404,7 @@ void viewELExptPanelHandler::redrawExpt()
 
     // add a stretch to force the content to the top
     exptSetup->addStretch();
+    dropUnusedRows();
 
 #else
 
@@ -411,7 +419,16 @@ void viewELExptPanelHandler::redrawExpt()
     // existing
     for (int i = 0; i < currentExperiment->ins.size(); ++i) {
         exptInput * in = currentExperiment->ins[i];
-        formIn->addLayout(in->drawInput(this->data, this));
+        if (in->edit) {
+            formIn->addLayout(in->drawInput(this->data, this));
+            continue;
+        }
+        QByteArray key = in->viewKey();
+        QWidget * row = keptRow(in, key);
+        if (!row) {
+            row = keepRow(in, key, in->drawInput(this->data, this));
+        }
+        formIn->addWidget(row);
     }
 
     //add new input
@@ -440,7 +457,16 @@ void viewELExptPanelHandler::redrawExpt()
     // existing
     for (int i = 0; i < currentExperiment->outs.size(); ++i) {
         exptOutput * out = currentExperiment->outs[i];
-        formOut->addLayout(out->drawOutput(this->data, this));
+        if (out->edit) {
+            formOut->addLayout(out->drawOutput(this->data, this));
+            continue;
+        }
+        QByteArray key = out->viewKey();
+        QWidget * row = keptRow(out, key);
+        if (!row) {
+            row = keepRow(out, key, out->drawOutput(this->data, this));
+        }
+        formOut->addWidget(row);
     }
 
     // add new output
@@ -541,6 +567,7 @@ void viewELExptPanelHandler::redrawExpt()
     exptInputs->addStretch();
     exptOutputs->addStretch();
     exptChanges->addStretch();
+    dropUnusedRows();
 
     if (scroll) {
         // replace scroll bar location (currently does not work)
@@ -550,10 +577,82 @@ void viewELExptPanelHandler::redrawExpt()
 #endif
 }
 
+QWidget * viewELExptPanelHandler::keptRow(void * element, const QByteArray &key)
+{
+    if (!rows.contains(element) || !rows[element] || rowKeys[element] != key) {
+        return (QWidget *) 0;
+    }
+    rowsUsed.insert(element);
+    return rows[element];
+}
+
+QWidget * viewELExptPanelHandler::keepRow(void * element, const QByteArray &key, QVBoxLayout * row)
+{
+    if (rows.contains(element) && rows[element]) {
+        rows[element]->hide();
+        rows[element]->deleteLater();
+    }
+
+    // the layout was added to the panel's own before, without margins
+    row->setContentsMargins(0,0,0,0);
+    QWidget * widget = new QWidget;
+    widget->setLayout(row);
+    // recursiveDeleteExpt leaves it for the next redraw
+    widget->setProperty("noDelete", true);
+
+    rows[element] = widget;
+    rowKeys[element] = key;
+    rowsUsed.insert(element);
+    return widget;
+}
+
+void viewELExptPanelHandler::dropUnusedRows()
+{
+    // rows which were not placed again are out of the panel, so they go
+    QMutableHashIterator <void *, QPointer<QWidget> > i(rows);
+    while (i.hasNext()) {
+        i.next();
+        if (rowsUsed.contains(i.key())) continue;
+        if (i.value()) {
+            i.value()->hide();
+            i.value()->deleteLater();
+        }
+        rowKeys.remove(i.key());
+        i.remove();
+    }
+}
+
+QByteArray viewELExptPanelHandler::exptBoxKey(int index)
+{
+    experiment * expt = data->experiments[index];
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << index << data->experiments.size() << expt->name << expt->description
+           << expt->selected << expt->editing << expt->subEdit << expt->running;
+    return key;
+}
+
 void viewELExptPanelHandler::redrawPanel()
 {
     QVBoxLayout * panel = ((QVBoxLayout *) viewEL->panel->layout());
 
+    // boxes showing what they did are not drawn again (editing ones are, to
+    // reset what was typed into them)
+    QHash <experiment *, QPointer<QWidget> > kept;
+    for (int i = 0; i < data->experiments.size(); ++i) {
+        experiment * expt = data->experiments[i];
+        if (!expt->editing && exptBoxes.value(expt) && exptBoxKeys.value(expt) == exptBoxKey(i)) {
+            kept[expt] = exptBoxes[expt];
+        }
+    }
+    QHashIterator <experiment *, QPointer<QWidget> > box(exptBoxes);
+    while (box.hasNext()) {
+        box.next();
+        if (box.value()) {
+            box.value()->setProperty("noDelete", kept.contains(box.key()));
+        }
+    }
+
     // clear panel except toolbar
     emit this->deleteWidgets();
     recursiveDelete(panel);
@@ -578,11 +677,19 @@ void viewELExptPanelHandler::redrawPanel()
     panel->insertWidget(2, add);
 
     // add experiments
+    exptBoxes.clear();
+    exptBoxKeys.clear();
     for (int i = data->experiments.size()-1; i >= 0; --i) {
-        exptBox * box = data->experiments[i]->getBox(this);
-        box->setProperty("index", i);
-        connect(box, SIGNAL(clicked()), this, SLOT(changeSelection()));
+        experiment * expt = data->experiments[i];
+        QWidget * box = kept.value(expt);
+        if (!box) {
+            box = expt->getBox(this);
+            box->setProperty("index", i);
+            connect(box, SIGNAL(clicked()), this, SLOT(changeSelection()));
+        }
         panel->insertWidget(2, box);
+        exptBoxes[expt] = box;
+        exptBoxKeys[expt] = exptBoxKey(i);
     }
 }
 
@@ -604,7 +711,6 @@ void viewELExptPanelHandler::addExperiment()
     emit enableRun(false);
 
     // redraw to show the new experiment
-    redrawPanel();
     redrawExpt();
 }
 
@@ -625,7 +731,6 @@ void viewELExptPanelHandler::delExperiment()
     }
 
     // redraw to updata the selection
-    redrawPanel();
     redrawExpt();
 }
 
@@ -667,7 +772,6 @@ void viewELExptPanelHandler::editExperiment()
     emit enableRun(false);
 
     // redraw to update the editBox
-    redrawPanel();
     redrawExpt();
 }
 
@@ -688,7 +792,6 @@ void viewELExptPanelHandler::doneEditExperiment()
     emit enableRun(true);
 
     // redraw to update the editBox
-    redrawPanel();
     redrawExpt();
 }
 
@@ -702,7 +805,6 @@ void viewELExptPanelHandler::cancelEditExperiment()
     emit enableRun(true);
 
     // redraw to update the editBox
-    redrawPanel();
     redrawExpt();
 }
 
@@ -727,7 +829,6 @@ void viewELExptPanelHandler::changeSelection()
     // Update the experiment menu
     this->main->setExperimentMenu();
 
-    redrawPanel();
     redrawExpt();
 }
 
@@ -1343,33 +1444,13 @@ void viewELExptPanelHandler::setOutputType()
 void viewELExptPanelHandler::setOutputIndices()
 {
     exptOutput * out = (exptOutput *) sender()->property("ptr").value<void *>();
-    // sanity check
+    // sanity check: blank, or not a list of indices, puts back what was there
     QString text = ((QLineEdit *) sender())->text();
-
-    // blank is invalid
-    if (text.isEmpty()) {
-        ((QLineEdit *) sender())->setText(out->indices);
-        return;
+    indexSet indices;
+    if (indexSet::fromString(text, indices)) {
+        out->indices = indices;
     }
-    if (text != "all") {
-        QString validCharacters("1234567890,");
-        for (int i = 0; i < text.size(); ++i) {
-            if (!validCharacters.contains(text[i])) {
-                // invalid character used
-                ((QLineEdit *) sender())->setText(out->indices);
-                return;
-            }
-        }
-        QStringList numbers = text.split(',');
-        for (int i = 0; i < numbers.size(); ++i) {
-            if (numbers[i].isEmpty()) {
-                // invalid arrangement used
-                ((QLineEdit *) sender())->setText(out->indices);
-                return;
-            }
-        }
-    }
-    out->indices = text;
+    ((QLineEdit *) sender())->setText(out->indices.toRangeString());
 }
 
 void viewELExptPanelHandler::setOutputStartT(double t)
@@ -1774,6 +1855,17 @@ void viewELExptPanelHandler::delChangedProp()
     redrawExpt();
 }
 
+void viewELExptPanelHandler::runBatch()
+{
+    int index = sender()->property("index").toInt();
+    if (index < 0 || index >= this->data->experiments.size()) {
+        return;
+    }
+
+    BatchExperimentWindow batch(this->data, this->data->experiments[index], this->data->main);
+    batch.exec();
+}
+
 void viewELExptPanelHandler::run()
 {
     QSettings settings;
@@ -1788,9 +1880,6 @@ void viewELExptPanelHandler::run()
         connect(runButton, SIGNAL(clicked()), this, SLOT(cancelRun()));
     }
 
-    simulatorStdOutText = "";
-    simulatorStdErrText = "";
-
     // fetch current experiment sim engine
     experiment * currentExperiment = NULL;
     int currentExptNum = -1;
@@ -1814,6 +1903,10 @@ void viewELExptPanelHandler::run()
 
     QString simName = currentExperiment->setup.simType;
 
+    // where the simulator runs, from simulators/<name>/backend
+    delete this->backend;
+    this->backend = new executionBackend(simName, this);
+
     // load path
     settings.beginGroup("simulators/" + simName);
     DBG() << "Simulator name: " << simName;
@@ -1821,7 +1914,9 @@ void viewELExptPanelHandler::run()
     // Check that path exists and is executable.
     QFile the_script(path);
 #ifndef Q_OS_WIN
-    if (!the_script.exists()) {
+    if (!this->backend->isLocal()) {
+        // the convert_script is on the host it runs on
+    } else if (!the_script.exists()) {
         // Error - convert_script file doesn't exist
         this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' does not exist.");
         return;
@@ -1837,7 +1932,7 @@ void viewELExptPanelHandler::run()
         }
     }
 //#else
-    if (simName != "BRAHMS") {
+    if (simName != "BRAHMS" && this->backend->isLocal()) {
         if (!the_script.exists()) {
             // Error - convert_script file doesn't exist
             this->cleanUpPostRun("Simulator Error", "The simulator '" + path + "' does not exist.");
@@ -1856,6 +1951,13 @@ void viewELExptPanelHandler::run()
     }
 #endif
 
+    // Stop here on errors the simulator would fail on, or worse not notice
+    QStringList problems = modelValidator::validate(this->data, currentExperiment);
+    if (!problems.isEmpty()) {
+        this->cleanUpPostRun("Model errors", problems.join("\n"));
+        return;
+    }
+
     // The convert_script takes the working directory as a script argument
     QString wk_dir_string = settings.value("working_dir").toString();
     settings.endGroup();
@@ -1950,19 +2052,17 @@ void viewELExptPanelHandler::run()
             return;
         }
 
-        // clear directory
-        QDir model_dir(this->tdir.path());
-        QStringList files = model_dir.entryList(QDir::Files);
-        for (int i = 0; i < files.size(); ++i) {
-            model_dir.remove(files[i]);
-        }
-
-        // Write the model into the temporary dir
+        // Write the model into the temporary dir. The directory is kept
+        // between runs; the export cache leaves the files that have not
+        // changed since the last run alone and removes any left over.
+        exportCache::begin(this->tdir.path());
         tFilePath = this->tdir.path()+ QDir::separator() + "temp.proj";
-        settings.setValue("files/currentFileName", tFilePath);
+        settingsCache::setCurrentFileName(tFilePath);
         DBG() << "Saving project temporarily to: " << tFilePath;
         // save_project changes the current project's filepath.
-        if (!this->data->currProject->save_project(tFilePath, this->data)) {
+        bool saved = this->data->currProject->save_project(tFilePath, this->data);
+        exportCache::end();
+        if (!saved) {
             DBG() << "Failed to save the model into the temporary model directory";
             this->cleanUpPostRun("Model save error", "The simulation could not be started");
             // Revert currProject->filePath here
@@ -1975,16 +2075,6 @@ void viewELExptPanelHandler::run()
     }
 #endif
 
-    QProcess * simulator = new QProcess;
-    if (!simulator) {
-        // Really bad error - memory allocation error. The following will probably fail:
-        this->cleanUpPostRun("Memory Allocation Error", "The simulator failed to start - you're out of RAM.");
-        return;
-    }
-
-    simulator->setWorkingDirectory(wk_dir.absolutePath());
-    simulator->setProcessEnvironment(env);
-
     // This is a project-specific* output directory, stored in a
     // folder in the working directory.
     //
@@ -1995,14 +2085,51 @@ void viewELExptPanelHandler::run()
     // enable easy comparison of two experiments and would be great.
     QString out_dir_name = wk_dir.absolutePath() + QDir::separator() + "temp" + QDir::separator() + data->currProject->getFilenameFriendlyName() + "_e" + QString::number(currentExptNum);
 
+    // an identical earlier run's logs are as good as running it again
+    this->runCacheKey.clear();
+    bool cacheable = runResultCache::isEnabled();
+#ifdef Q_OS_WIN
+    // BRAHMS is run synchronously through bash, with its logs elsewhere
+    cacheable = cacheable && simName != "BRAHMS";
+#endif
+    if (cacheable) {
+        runResultCache cache;
+        this->runCacheKey = cache.keyFor(QFileInfo(tFilePath).dir().path(), currentExptNum, simName);
+        QString logDir = out_dir_name + QDir::separator() + "log";
+        QString output;
+        if (runResultCache::restore(this->runCacheKey, logDir, output)) {
+            DBG() << "Restored the logs of an identical earlier run into" << logDir;
+            this->finishCachedRun(currentExperiment, logDir, output);
+            return;
+        }
+    }
+
+    QProcess * simulator = new QProcess;
+    if (!simulator) {
+        // Really bad error - memory allocation error. The following will probably fail:
+        this->cleanUpPostRun("Memory Allocation Error", "The simulator failed to start - you're out of RAM.");
+        return;
+    }
+
+    simulator->setWorkingDirectory(wk_dir.absolutePath());
+    simulator->setProcessEnvironment(env);
+
     simulator->setProperty("logpath", out_dir_name + QDir::separator() + "log");
 
+    // the simulator's output is held up to a limit, with the rest moved into
+    // the run directory, and searched for the known errors as it arrives
+    QList <QByteArray> errorPatterns;
+    for (int i = 0; i < this->errorStrings.size(); ++i) {
+        errorPatterns.push_back(this->errorStrings[i].toUtf8());
+    }
+    simulatorOutput.start(out_dir_name + QDir::separator() + "simulator_output.txt", errorPatterns);
+
     QFileInfo projFileInfo(tFilePath); // tFilePath contains the path
                                        // to the model being executed,
                                        // either in the original location
                                        // or in the temporary directory.
     QString modelpath(projFileInfo.dir().path());
-    {
+    if (this->backend->isLocal()) {
         QStringList al;
 #ifdef Q_OS_WIN
         if (simName == "BRAHMS") {
@@ -2079,6 +2206,22 @@ void viewELExptPanelHandler::run()
             simulator->start(path,al);
         }
 #endif
+    } else {
+        // a local shell sends the model, runs it there and fetches the logs
+        settings.beginGroup("simulators/" + simName);
+        bool rebuild = settings.value("envVar/REBUILD").toString() == "true";
+        settings.endGroup();
+        QString program;
+        QStringList al;
+        QString error;
+        QString runName = data->currProject->getFilenameFriendlyName() + "_e" + QString::number(currentExptNum);
+        if (!this->backend->prepare(modelpath, out_dir_name, currentExptNum, rebuild, runName, program, al, error)) {
+            this->cleanUpPostRun("Simulator Error", error);
+            return;
+        }
+        path = program;
+        DBG() << "Starting on " << this->backend->describe();
+        simulator->start(program, al);
     }
 
     // Wait a couple of seconds for the process to start
@@ -2120,15 +2263,71 @@ void viewELExptPanelHandler::run()
     connect(simulator, SIGNAL(readyReadStandardOutput()), this, SLOT(simulatorStandardOutput()));
     connect(simulator, SIGNAL(readyReadStandardError()), this, SLOT(simulatorStandardError()));
 
-    // now start a timer to check on the simulation progress
-    connect(&simTimeChecker, SIGNAL(timeout()), this, SLOT(checkForSimTime()));
+    // now watch the sim time file to follow the simulation progress, with
+    // a slow timer in case the file can't be watched
+    connect(&simTimeWatcher, SIGNAL(fileChanged(QString)), this, SLOT(simTimeFileChanged()));
+    connect(&simTimeWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(simTimeFileChanged()));
+    connect(&simTimeChecker, SIGNAL(timeout()), this, SLOT(simTimeFileChanged()));
+    connect(&simTimeUpdateTimer, SIGNAL(timeout()), this, SLOT(checkForSimTime()));
     this->simTimeMax = currentExperiment->setup.duration;
+    this->simTimeLastProgress = -1;
+    this->simTimeLastUpdate.invalidate();
+
+    // plot the logs as they are written, if their graphs are open
+    if (main->existsViewGV(currentExperiment)) {
+        QString followPath = simulator->property("logpath").toString();
+#ifdef Q_OS_WIN
+        if (simName == "BRAHMS") {
+            followPath = this->logpath;
+        }
+#endif
+        this->logFollower = main->viewGV[currentExperiment]->properties;
+        this->logFollower->followLogs(followPath);
+    }
 
     this->simTimeFileName = QDir::toNativeSeparators(out_dir_name + QDir::separator() + "model" + QDir::separator() + "time.txt");
     QFile::remove(simTimeFileName);
     this->simCancelFileName = QDir::toNativeSeparators(out_dir_name + QDir::separator() + "model" + QDir::separator() + "stop.txt");
-    DBG() << "Starting simTimeChecker to check on simulation progress";
-    simTimeChecker.start(17);
+    DBG() << "Watching " << simTimeFileName << " for simulation progress";
+    if (!this->backend->isLocal()) {
+        this->backend->followProgress(simTimeFileName);
+    }
+    this->watchSimTimeFile();
+    simTimeChecker.start(SIM_TIME_POLL_INTERVAL);
+}
+
+void viewELExptPanelHandler::watchSimTimeFile()
+{
+    QFileInfo info(this->simTimeFileName);
+    if (info.exists()) {
+        // simulators that replace the file drop it from the watch list
+        if (!this->simTimeWatcher.files().contains(this->simTimeFileName)) {
+            this->simTimeWatcher.addPath(this->simTimeFileName);
+        }
+    } else {
+        QString dir = info.absolutePath();
+        if (QDir(dir).exists() && !this->simTimeWatcher.directories().contains(dir)) {
+            this->simTimeWatcher.addPath(dir);
+        }
+    }
+}
+
+void viewELExptPanelHandler::simTimeFileChanged()
+{
+    if (!runExpt) return;
+
+    this->watchSimTimeFile();
+
+    // an update is already due
+    if (this->simTimeUpdateTimer.isActive()) {
+        return;
+    }
+    qint64 since = this->simTimeLastUpdate.isValid() ? this->simTimeLastUpdate.elapsed() : SIM_TIME_UPDATE_INTERVAL;
+    if (since >= SIM_TIME_UPDATE_INTERVAL) {
+        this->checkForSimTime();
+    } else {
+        this->simTimeUpdateTimer.start(SIM_TIME_UPDATE_INTERVAL - since);
+    }
 }
 
 /*!
@@ -2140,6 +2339,10 @@ void viewELExptPanelHandler::run()
  * message detail.
  */
 void viewELExptPanelHandler::cleanUpPostRun(QString msg, QString msgDetail) {
+    if (this->logFollower) {
+        this->logFollower->stopFollowingLogs();
+        this->logFollower = (viewGVpropertieslayout*)0;
+    }
     if (!msg.isEmpty()) {
         QMessageBox msgBox;
         msgBox.setWindowTitle(msg);
@@ -2169,18 +2372,36 @@ void viewELExptPanelHandler::cancelRun() {
 
     if (!runExpt) return;
 
+    // the logs of a cancelled run are not those of a whole one
+    this->runCacheKey.clear();
+
     QFile simCancelFile(simCancelFileName);
 
     simCancelFile.open(QFile::WriteOnly);
     simCancelFile.close();
+    if (this->backend) {
+        this->backend->cancel();
+    }
 
 #ifdef Q_OS_WIN
-    Sleep(2000);
-    this->simulatorFinished(0,QProcess::NormalExit);
+    // give the simulator time to write its logs, without blocking the GUI
+    if (!this->simFinishPending) {
+        this->simFinishPending = true;
+        QTimer::singleShot(2000, this, SLOT(finishPendingRun()));
+    }
 #endif
 
 }
 
+#ifdef Q_OS_WIN
+void viewELExptPanelHandler::finishPendingRun()
+{
+    this->simFinishPending = false;
+    if (!runExpt) return;
+    this->simulatorFinished(0,QProcess::NormalExit);
+}
+#endif
+
 /*!
  * \brief viewELExptPanelHandler::checkForSimTime
  * This function is used to pick up the infromation left by a simulator, and
@@ -2192,6 +2413,8 @@ void viewELExptPanelHandler::checkForSimTime() {
 
     if (!runExpt) return;
 
+    this->simTimeLastUpdate.start();
+
     QFile simTimeFile(simTimeFileName);
 
     simTimeFile.open(QFile::ReadOnly);
@@ -2210,9 +2433,13 @@ void viewELExptPanelHandler::checkForSimTime() {
             if (runExpt->runButton) {
                 runExpt->runButton->setText("Running: " + QString::number(simTimeCurr) + "ms");
                 float proportion = simTimeCurr / (this->simTimeMax*1000);
-                runExpt->progressBar->setStyleSheet(QString("QLabel {background-color: qlineargradient(spread:pad, x1:0, y1:0, x2:1, y2:0, stop:0 rgba(150, 255, 150, 255), ") \
-                                       + QString("stop:") + QString::number(proportion) + QString(" rgba(150, 255, 150, 255), stop:")  + QString::number(proportion+0.01) + QString(" rgba(150, 255, 150, 0), stop:1 rgba(255, 255, 255, 0))}"));
-
+                // only restyle the bar when it has visibly moved
+                int progress = qRound(proportion * 1000);
+                if (progress != this->simTimeLastProgress) {
+                    this->simTimeLastProgress = progress;
+                    runExpt->progressBar->setStyleSheet(QString("QLabel {background-color: qlineargradient(spread:pad, x1:0, y1:0, x2:1, y2:0, stop:0 rgba(150, 255, 150, 255), ") \
+                                           + QString("stop:") + QString::number(proportion) + QString(" rgba(150, 255, 150, 255), stop:")  + QString::number(proportion+0.01) + QString(" rgba(150, 255, 150, 0), stop:1 rgba(255, 255, 255, 0))}"));
+                }
             }
         }
 #ifdef Q_OS_WIN
@@ -2232,9 +2459,10 @@ void viewELExptPanelHandler::checkForSimTime() {
 
     // check if we have finished...
     if (currentExperiment->setup.simType == "BRAHMS") {
-        if (simTimeCurr > this->simTimeMax*1000-0.2) {
-            Sleep(2000);
-            this->simulatorFinished(0,QProcess::NormalExit);
+        if (simTimeCurr > this->simTimeMax*1000-0.2 && !this->simFinishPending) {
+            // give the simulator time to write its logs, without blocking the GUI
+            this->simFinishPending = true;
+            QTimer::singleShot(2000, this, SLOT(finishPendingRun()));
         }
     }
 #endif
@@ -2242,12 +2470,65 @@ void viewELExptPanelHandler::checkForSimTime() {
     }
 }
 
-void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
+void viewELExptPanelHandler::showRunLogs(experiment * currentExperiment, QDir logs)
+{
+    QStringList filter;
+    filter << "*.xml";
+    logs.setNameFilters(filter);
+
+    // add logs to graphs
+    // First ensure viewGV[currentExperiment] exists. if not, do nothing?
+    if (main->existsViewGV(currentExperiment)) {
+        DBG() << "viewGV exists for currentExperiment; updating logdata etc.";
+        data->main->viewGV[currentExperiment]->properties->populateVLogData (logs.entryList(), &logs);
+
+        // and insert logs into visualiser
+        if (data->main->viewVZ.OpenGLWidget != NULL) {
+            data->main->viewVZ.OpenGLWidget->addLogs(&data->main->viewGV[currentExperiment]->properties->vLogData);
+        }
+    } else {
+        DBG() << "viewGV didn't exist for currentExperiment, so not updating logdata etc.";
+    }
+}
+
+void viewELExptPanelHandler::finishCachedRun(experiment * currentExperiment, const QString &logDir, const QString &output)
+{
+    this->showRunLogs(currentExperiment, QDir(logDir));
+
+    // as simulatorFinished(), with nothing to wait for
+    if (this->runExpt->runButton) {
+        QMessageBoxResizable msgBox;
+        msgBox.setWindowTitle("Simulator Complete");
+        msgBox.setIcon(QMessageBox::Information);
+        msgBox.setText("The model and experiment are the same as for an earlier run, so its logs have been restored "
+                       "rather than running the simulator again. See below for the output of that run.");
+        msgBox.setDetailedText(output);
+        msgBox.addButton(QMessageBox::Ok);
+        msgBox.setDefaultButton(QMessageBox::Ok);
+        msgBox.exec();
+    }
+    this->cleanUpPostRun("", "");
+    emit simulationDone();
+}
+
+void viewELExptPanelHandler::simulatorFinished(int exitCode, QProcess::ExitStatus status)
 {
     // stop updating the bar
     simTimeChecker.disconnect();
     simTimeChecker.stop();
+    simTimeUpdateTimer.disconnect();
+    simTimeUpdateTimer.stop();
+    simTimeWatcher.disconnect();
+    if (!simTimeWatcher.files().isEmpty()) {
+        simTimeWatcher.removePaths(simTimeWatcher.files());
+    }
+    if (!simTimeWatcher.directories().isEmpty()) {
+        simTimeWatcher.removePaths(simTimeWatcher.directories());
+    }
     QFile::remove(simCancelFileName);
+    if (this->backend) {
+        this->backend->runFinished();
+    }
 
     // find currentExperiment (could make use of MainWindow::getCurrentExpt)
     experiment* currentExperiment = (experiment*)0;
@@ -2265,23 +2546,19 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
                                + QString("stop:") + QString::number(proportion) + QString(" rgba(150, 255, 150, 0), stop:")  + QString::number(proportion+0.01) + QString(" rgba(150, 255, 150, 0), stop:1 rgba(255, 255, 255, 0))}"));
     }
 
-    // check for errors we can present
-    for (int i = 0; i < (int) errorStrings.size(); ++i) {
-
-        // check if error there
-        if (simulatorStdOutText.contains(errorStrings[i])) {
-            // error found
-            QMessageBoxResizable msgBox;
-            msgBox.setWindowTitle("Simulator Error Report");
-            msgBox.setIcon(QMessageBox::Critical);
-            msgBox.setText(errorMessages[i]);
-            msgBox.setDetailedText(simulatorStdOutText);
-            msgBox.addButton(QMessageBox::Ok);
-            msgBox.setDefaultButton(QMessageBox::Ok);
-            msgBox.exec();
-            this->cleanUpPostRun("", "");
-            return;
-        }
+    // check for errors we can present, found as the output arrived
+    int errorFound = simulatorOutput.firstMatched();
+    if (errorFound >= 0 && errorFound < errorMessages.size()) {
+        QMessageBoxResizable msgBox;
+        msgBox.setWindowTitle("Simulator Error Report");
+        msgBox.setIcon(QMessageBox::Critical);
+        msgBox.setText(errorMessages[errorFound]);
+        msgBox.setDetailedText(simulatorOutput.text());
+        msgBox.addButton(QMessageBox::Ok);
+        msgBox.setDefaultButton(QMessageBox::Ok);
+        msgBox.exec();
+        this->cleanUpPostRun("", "");
+        return;
     }
 
     // collect logs
@@ -2298,29 +2575,13 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
     }
 #endif
 
-    QStringList filter;
-    filter << "*.xml";
-    logs.setNameFilters(filter);
-
-    // add logs to graphs
-    // First ensure viewGV[currentExperiment] exists. if not, do nothing?
-    if (main->existsViewGV(currentExperiment)) {
-        DBG() << "viewGV exists for currentExperiment; updating logdata etc.";
-        data->main->viewGV[currentExperiment]->properties->populateVLogData (logs.entryList(), &logs);
-
-        // and insert logs into visualiser
-        if (data->main->viewVZ.OpenGLWidget != NULL) {
-            data->main->viewVZ.OpenGLWidget->addLogs(&data->main->viewGV[currentExperiment]->properties->vLogData);
-        }
-    } else {
-        DBG() << "viewGV didn't exist for currentExperiment, so not updating logdata etc.";
-    }
+    this->showRunLogs(currentExperiment, logs);
 
     // get status
     if (status == QProcess::CrashExit) {
         QMessageBox msgBox;
         msgBox.setWindowTitle("Simulator Crash");
-        msgBox.setText(simulatorStdErrText);
+        msgBox.setText(simulatorOutput.text());
         msgBox.addButton(QMessageBox::Ok);
         msgBox.setDefaultButton(QMessageBox::Ok);
         msgBox.exec();
@@ -2335,11 +2596,15 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
             msgBox.setWindowTitle("Simulator Complete");
             msgBox.setIcon(QMessageBox::Information);
             msgBox.setText("Simulator has finished. See below for more details.");
-            msgBox.setDetailedText(simulatorStdOutText);
+            msgBox.setDetailedText(simulatorOutput.text());
             msgBox.addButton(QMessageBox::Ok);
             msgBox.setDefaultButton(QMessageBox::Ok);
             msgBox.exec();
         }
+        // keep the logs for the next identical run
+        if (exitCode == 0 && !this->runCacheKey.isEmpty()) {
+            runResultCache::store(this->runCacheKey, logs.absolutePath(), simulatorOutput.text());
+        }
         // signal others
         this->cleanUpPostRun("", "");
         emit simulationDone();
@@ -2352,13 +2617,24 @@ void viewELExptPanelHandler::simulatorFinished(int, QProcess::ExitStatus status)
 void viewELExptPanelHandler::simulatorStandardOutput()
 {
     QByteArray data = ((QProcess *) sender())->readAllStandardOutput();
-    simulatorStdOutText = simulatorStdOutText + QString().fromUtf8(data);
+    this->simulatorOutputArrived(data);
 }
 
 void viewELExptPanelHandler::simulatorStandardError()
 {
     QByteArray data = ((QProcess *) sender())->readAllStandardError();
-    simulatorStdOutText = simulatorStdOutText + QString().fromUtf8(data);
+    this->simulatorOutputArrived(data);
+}
+
+void viewELExptPanelHandler::simulatorOutputArrived(const QByteArray &chunk)
+{
+    if (simulatorOutput.append(chunk)) {
+        // say so now, rather than when the simulator has finished
+        int errorFound = simulatorOutput.firstMatched();
+        if (errorFound < errorMessages.size()) {
+            this->data->updateStatusBar("Simulator error: " + errorMessages[errorFound].trimmed(), 0);
+        }
+    }
 }
 
 void viewELExptPanelHandler::mouseMove(float xGL, float yGL)
@@ -30,8 +30,19 @@
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
   #include <QTemporaryDir>
 #endif
+#include <QFileSystemWatcher>
+#include <QElapsedTimer>
+#include "SC_outputcapture.h"
+
+// the progress label is updated at most this often (ms)
+#define SIM_TIME_UPDATE_INTERVAL 100
+// the sim time file is still checked this often (ms), in case a change
+// notification is missed or the file's directory doesn't exist yet
+#define SIM_TIME_POLL_INTERVAL 500
 
 struct viewELstruct;
+class viewGVpropertieslayout;
+class executionBackend;
 
 
 class viewELExptPanelHandler : public QObject
@@ -68,14 +79,30 @@ private:
     QVBoxLayout * exptOutputs;
     QVBoxLayout * exptChanges;
 
-    QString simulatorStdOutText;
-    QString simulatorStdErrText;
+    // what the simulator prints, on either stream
+    outputCapture simulatorOutput;
 
     QStringList errorStrings;
     QStringList errorMessages;
+    void simulatorOutputArrived(const QByteArray &chunk);
 
     QVector <QWidget * > forDeleting;
 
+    /*!
+     * The experiment boxes, and the rows of the inputs and outputs in view
+     * mode, are kept between redraws while what they show (their key) is
+     * unchanged, and only drawn again when it does change.
+     */
+    QByteArray exptBoxKey(int index);
+    QWidget * keptRow(void * element, const QByteArray &key);
+    QWidget * keepRow(void * element, const QByteArray &key, QVBoxLayout * row);
+    void dropUnusedRows();
+    QHash <experiment *, QPointer<QWidget> > exptBoxes;
+    QHash <experiment *, QByteArray> exptBoxKeys;
+    QHash <void *, QPointer<QWidget> > rows;
+    QHash <void *, QByteArray> rowKeys;
+    QSet <void *> rowsUsed;
+
     void recursiveDeleteLoop(QLayout * parentLayout);
     void recursiveDelete(QLayout * parentLayout);
     void recursiveDeleteExpt(QLayout * parentLayout);
@@ -95,16 +122,45 @@ private:
     GLWidget * gl;
 
     QTimer simTimeChecker;
+    QFileSystemWatcher simTimeWatcher;
+    QTimer simTimeUpdateTimer;
+    QElapsedTimer simTimeLastUpdate;
+    int simTimeLastProgress;
     QString simTimeFileName;
     QString simCancelFileName;
 #ifdef Q_OS_WIN
     QString logpath;
+    bool simFinishPending;
 #endif
     float simTimeMax;
+    // the graphs following the logs of the run, if they are open
+    QPointer<viewGVpropertieslayout> logFollower;
+
+    /*!
+     * Watch the sim time file, or the directory it will be written to
+     * if it doesn't exist yet.
+     */
+    void watchSimTimeFile();
     experiment * runExpt;
 
     void cleanUpPostRun(QString, QString);
 
+    /*!
+     * Show the logs of a run in the graphs and the visualiser.
+     */
+    void showRunLogs(experiment * currentExperiment, QDir logs);
+
+    /*!
+     * Finish a run whose logs were restored from the runResultCache.
+     */
+    void finishCachedRun(experiment * currentExperiment, const QString &logDir, const QString &output);
+
+    // the runResultCache key of the running experiment, if it can be cached
+    QByteArray runCacheKey;
+
+    // where the running experiment's simulator runs
+    executionBackend * backend;
+
 signals:
     void enableRun(bool);
     void simulationDone();
@@ -176,11 +232,24 @@ public slots:
     void redraw(double);
 
     void run();
+    /*!
+     * Open the batch launch window for the experiment of the sender's
+     * "index" property.
+     */
+    void runBatch();
     void cancelRun();
     void simulatorFinished(int, QProcess::ExitStatus);
     void simulatorStandardOutput();
     void simulatorStandardError();
     void checkForSimTime();
+    /*!
+     * Called when the sim time file (or its directory) changes; updates
+     * the progress, at most every SIM_TIME_UPDATE_INTERVAL ms.
+     */
+    void simTimeFileChanged();
+#ifdef Q_OS_WIN
+    void finishPendingRun();
+#endif
 
     /*!
      * \brief Called when the mouse moves on the model view
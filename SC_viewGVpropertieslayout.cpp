@@ -79,6 +79,10 @@ viewGVpropertieslayout::viewGVpropertieslayout(viewGVstruct * viewGVin, QWidget
     QPushButton * dlb = new QPushButton("Delete log file (PERMANENTLY)");
     this->layout()->addWidget(dlb);
     this->unifyTime = true;
+    this->unifying = false;
+    this->loadGeneration = 0;
+    this->unifyTimer.setSingleShot (true);
+    this->unifyTimer.setInterval (GRAPH_UNIFY_INTERVAL_MS);
     QCheckBox* unifyTimeButton = new QCheckBox("Unify time axes");
     unifyTimeButton->setCheckState (Qt::Checked);
     this->layout()->addWidget (unifyTimeButton);
@@ -90,12 +94,21 @@ viewGVpropertieslayout::viewGVpropertieslayout(viewGVstruct * viewGVin, QWidget
     connect(agb, SIGNAL(clicked()), this, SLOT(addGraphsToCurrent()));
     connect(dlb, SIGNAL(clicked()), this, SLOT(deleteCurrentLog()));
     connect(unifyTimeButton, SIGNAL(clicked()), this, SLOT(toggleUnifyTime()));
+    connect(&this->followTimer, SIGNAL(timeout()), this, SLOT(followTick()));
+    connect(&this->unifyTimer, SIGNAL(timeout()), this, SLOT(applyUnifiedRange()));
 }
 
 viewGVpropertieslayout::~viewGVpropertieslayout()
 {
+    // the loads still running are finished, and their logs dropped
+    this->loadPool.waitForDone();
+    QSet<logLoader*>::iterator l;
+    for (l = this->pendingLoads.begin(); l != this->pendingLoads.end(); ++l) {
+        delete (*l);
+    }
+
     for (int i = 0; i < this->vLogData.size(); ++i) {
-        delete this->vLogData[i];
+        logRegistry::release(this->vLogData[i]);
     }
 
     delete actionAddGraphSubWin;
@@ -130,37 +143,75 @@ void viewGVpropertieslayout::setupPlot(QCustomPlot * plot)
 
     // Connect signal to unify the time axis range
     connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(unifyRangeForAllPlots(QCPRange)));
+    // and catch the plot being shown after a range was unified while hidden
+    plot->installEventFilter(this);
 }
 
 void viewGVpropertieslayout::unifyRangeForAllPlots (const QCPRange& r)
 {
-    if (this->unifyTime) {
-        // Need sender, so we don't try to set range for that one.
-        QCustomPlot* senderPlot = qobject_cast<QCustomPlot*>(sender());
-
-        QList<QMdiSubWindow*> subWins = this->viewGV->mdiarea->subWindowList();
-        QList<QMdiSubWindow*>::iterator sw = subWins.begin();
-        while (sw != subWins.end()) {
-            if ((*sw) != (QMdiSubWindow*)0) {
-                QCustomPlot* p = (QCustomPlot*)(*sw)->widget();
-                if (p != senderPlot) {
-                    // Disconnect handler, change range, then re-connect the handler:
-                    bool disconnected = disconnect (p->xAxis, SIGNAL(rangeChanged(QCPRange)),
-                                                    this, SLOT(unifyRangeForAllPlots(QCPRange)));
-                    if (disconnected) {
-                        p->xAxis->setRange(r);
-                        p->replot();
-                        bool connected = connect(p->xAxis, SIGNAL(rangeChanged(QCPRange)),
-                                                 this, SLOT(unifyRangeForAllPlots(QCPRange)));
-                        if (!connected) {
-                            DBG() << "WARNING: Failed to re-connect unifyRangeForAllPlots signal";
-                        }
-                    }
-                }
-            }
-            sw++;
+    // not configured to unify time axes, or this is a plot being unified
+    if (!this->unifyTime || this->unifying) {
+        return;
+    }
+    // or the x axis is not of time (see logData::plotActivity)
+    QCPAxis* axis = qobject_cast<QCPAxis*>(sender());
+    if (axis != (QCPAxis*)0 && axis->parentPlot()->property("indexAxis").toBool()) {
+        return;
+    }
+
+    // the timer is not restarted, so a continuous drag still updates the
+    // other plots every GRAPH_UNIFY_INTERVAL_MS
+    this->unifiedRange = r;
+    if (!this->unifyTimer.isActive()) {
+        this->unifyTimer.start();
+    }
+}
+
+void viewGVpropertieslayout::applyUnifiedRange()
+{
+    if (!this->unifyTime) {
+        return;
+    }
+
+    QList<QMdiSubWindow*> subWins = this->viewGV->mdiarea->subWindowList();
+    for (int i = 0; i < subWins.size(); ++i) {
+        QCustomPlot* p = qobject_cast<QCustomPlot*>(subWins[i]->widget());
+        if (p == (QCustomPlot*)0 || p->property("indexAxis").toBool()) {
+            continue;
+        }
+        // this includes the plot the range came from
+        QCPRange current = p->xAxis->range();
+        if (current == this->unifiedRange) {
+            continue;
+        }
+        if (p->isVisible()) {
+            this->setUnifiedRange (p);
+        } else {
+            p->setProperty ("unifiedRangeStale", true);
+        }
+    }
+}
+
+void viewGVpropertieslayout::setUnifiedRange (QCustomPlot* plot)
+{
+    plot->setProperty ("unifiedRangeStale", false);
+    this->unifying = true;
+    plot->xAxis->setRange (this->unifiedRange);
+    this->unifying = false;
+    // let the paints of all the plots be drawn together
+    plot->replot (QCustomPlot::rpQueued);
+}
+
+bool viewGVpropertieslayout::eventFilter (QObject* watched, QEvent* event)
+{
+    if (event->type() == QEvent::Show && this->unifyTime
+        && watched->property ("unifiedRangeStale").toBool()) {
+        QCustomPlot* p = qobject_cast<QCustomPlot*>(watched);
+        if (p != (QCustomPlot*)0) {
+            this->setUnifiedRange (p);
         }
-    } // else not configured to unify time axes
+    }
+    return QWidget::eventFilter (watched, event);
 }
 
 void viewGVpropertieslayout::updateLogList()
@@ -176,12 +227,14 @@ void viewGVpropertieslayout::updateLogList()
 
 void viewGVpropertieslayout::clearVLogData()
 {
-    // If logData's deconstructor worked, then this would be just vLogData.clear():
+    // logs still loading are dropped when they finish
+    ++this->loadGeneration;
+    this->pendingLogs.clear();
+
+    // the logs may still be shown elsewhere, so they are handed back
     QVector<logData*>::iterator j = this->vLogData.begin();
     while (j != this->vLogData.end()) {
-        if ((*j) != (logData*)0) {
-            delete (*j);
-        }
+        logRegistry::release(*j);
         j = this->vLogData.erase(j);
     }
 
@@ -198,44 +251,87 @@ void viewGVpropertieslayout::populateVLogData (QStringList fileNames, QDir* path
               << fileNames.size();
     }
 
-    // load the files
+    // load the files, or set them up again if they are loaded already,
+    // each on loadPool
     for (int i = 0; i < fileNames.size(); ++i) {
-
-        bool exists = false;
-
         QString logXMLname;
         if (path) {
             logXMLname = path->absoluteFilePath(fileNames[i]);
         } else {
             logXMLname = fileNames[i];
         }
+        if (!this->pendingLogs.contains(logXMLname)) {
+            this->startLogLoad(logXMLname);
+        }
+    }
+}
 
-        // check if we have the log
-        //DBG() << "logsForGraphs size is " << this->logsForGraphs.size();
-        for (int i = 0; i < this->vLogData.size(); ++i) {
-            if (this->vLogData[i]->logFileXMLname == logXMLname) {
-                DBG() "Refreshing existing log " << logXMLname << "...";
-                this->refreshLog(this->vLogData[i]);
-                exists = true;
+void viewGVpropertieslayout::startLogLoad (const QString& logXMLname)
+{
+    // the columns plotted from the log are read on the pool too
+    QVector<int> columns;
+    QList<QMdiSubWindow*> subWins = this->viewGV->mdiarea->subWindowList();
+    for (int i = 0; i < subWins.size(); ++i) {
+        QCustomPlot* plot = qobject_cast<QCustomPlot*>(subWins[i]->widget());
+        if (plot == (QCustomPlot*)0) {
+            continue;
+        }
+        for (int j = 0; j < plot->graphCount(); ++j) {
+            QCPGraph* graph = plot->graph(j);
+            if (graph->property("source").toString() == logXMLname
+                && graph->property("type").toString() == "linePlot"
+                && !columns.contains(graph->property("index").toInt())) {
+                columns.push_back(graph->property("index").toInt());
             }
         }
+    }
+
+    logLoader* loader = new logLoader(logXMLname, columns);
+    loader->setProperty("generation", this->loadGeneration);
+    connect(loader, SIGNAL(finished()), this, SLOT(logLoaded()), Qt::QueuedConnection);
+    this->pendingLoads.insert(loader);
+    this->pendingLogs.insert(logXMLname);
+    this->loadPool.start(loader);
+}
+
+void viewGVpropertieslayout::logLoaded()
+{
+    logLoader* loader = static_cast<logLoader*>(sender());
+    if (!this->pendingLoads.remove(loader)) {
+        return;
+    }
+    // the loader is done with once this returns
+    loader->deleteLater();
+    if (loader->property("generation").toInt() != this->loadGeneration) {
+        return;
+    }
+    this->pendingLogs.remove(loader->logFileXMLname);
 
-        // otherwise...
-        if (!exists) {
-            //DBG() << "Create a new logData object";
-            logData * log = new logData();
-            log->logFileXMLname = logXMLname;
-            if (!log->setupFromXML()) {
-                qDebug() << "Failed to read XML";
-                delete log;
-                continue;
+    logData* loaded = loader->takeLog();
+    if (loaded == (logData*)0) {
+        qDebug() << "Failed to read XML";
+        return;
+    }
+
+    // a log which is open already is set up again, and takes the columns
+    // which were read for it
+    for (int i = 0; i < this->vLogData.size(); ++i) {
+        if (this->vLogData[i]->logFileXMLname == loaded->logFileXMLname) {
+            DBG() << "Refreshing existing log " << loaded->logFileXMLname << "...";
+            logData* log = this->vLogData[i];
+            if (log->setupFromXML()) {
+                log->adoptColumns(loaded);
+                this->refreshLog(log);
             }
-            //DBG() << "Push back " << logXMLname << " onto logsForGraphs";
-            this->vLogData.push_back(log);
+            delete loaded;
+            return;
         }
     }
 
+    // shared with any other view which has the log open
+    this->vLogData.push_back(logRegistry::adopt(loaded));
     this->updateLogList();
+    emit logsLoaded();
 }
 
 void viewGVpropertieslayout::clearPlots (void)
@@ -257,6 +353,65 @@ void viewGVpropertieslayout::addEmptyPlot (void)
     this->actionToGrid_triggered();
 }
 
+void viewGVpropertieslayout::followLogs (QString logDir)
+{
+    this->followedLogDir = logDir;
+    this->followTimer.start (LOG_FOLLOW_INTERVAL_MS);
+}
+
+void viewGVpropertieslayout::stopFollowingLogs (void)
+{
+    this->followTimer.stop();
+    this->followedLogDir.clear();
+}
+
+void viewGVpropertieslayout::followTick()
+{
+    // nothing to show the logs in; they are caught up with when it is shown
+    if (!this->viewGV->mdiarea->isVisible()) {
+        return;
+    }
+
+    // load the logs whose reports have been written since the last look
+    QDir logs(this->followedLogDir);
+    QStringList reports = logs.entryList (QStringList() << "*.xml", QDir::Files);
+    QStringList newReports;
+    for (int i = 0; i < reports.size(); ++i) {
+        QString logXMLname = logs.absoluteFilePath (reports[i]);
+        bool loaded = false;
+        for (int j = 0; j < this->vLogData.size(); ++j) {
+            if (this->vLogData[j]->logFileXMLname == logXMLname) {
+                loaded = true;
+                break;
+            }
+        }
+        if (!loaded) {
+            newReports.push_back (reports[i]);
+        }
+    }
+    if (!newReports.isEmpty()) {
+        this->populateVLogData (newReports, &logs);
+    }
+
+    // extend the plots of the logs which have grown
+    QList<QMdiSubWindow*> subWins = this->viewGV->mdiarea->subWindowList();
+    for (int i = 0; i < this->vLogData.size(); ++i) {
+        logData* log = this->vLogData[i];
+        if (QFileInfo(log->logFileXMLname).absolutePath() != logs.absolutePath() || !log->appendNewRows()) {
+            continue;
+        }
+        for (int j = 0; j < subWins.size(); ++j) {
+            QCustomPlot* plot = (QCustomPlot*)subWins[j]->widget();
+            for (int k = 0; k < plot->graphCount(); ++k) {
+                if (plot->graph(k)->property("source").toString() == log->logFileXMLname) {
+                    log->updatePlot (plot);
+                    break;
+                }
+            }
+        }
+    }
+}
+
 void viewGVpropertieslayout::addLinesRasters (logData* log, QMdiSubWindow* subWin)
 {
     QCustomPlot* currPlot = (QCustomPlot*)subWin->widget();
@@ -277,6 +432,9 @@ void viewGVpropertieslayout::addLinesRasters (logData* log, QMdiSubWindow* subWi
                 // get indices
                 QList < QVariant > indices = currPlot->graph(j)->property("indices").toList();
                 log->plotRaster(currPlot, subWin, indices, j);
+
+            } else if (type == "firingRates" || type == "populationRate" || type == "columnMeans") {
+                log->plotActivity(currPlot, subWin, type, j);
             }
         } // else graph not from this log
 
@@ -299,7 +457,7 @@ void viewGVpropertieslayout::deleteCurrentLog()
     // remove the log
     logData* log = this->vLogData[listIdx];
     this->vLogData.erase(this->vLogData.begin()+listIdx);
-    delete log;
+    logRegistry::release(log);
 
     // refresh display
     this->updateLogList();
@@ -465,8 +623,10 @@ void viewGVpropertieslayout::logListSelectionChanged(int index)
 
         // populate types with analog plot forms:
         this->typeList->addItem("Line plot");
+        // summarised as the log was read, and of all its columns
+        this->typeList->addItem("Column mean");
 
-        // Pre-select Line plot, as there is only one option.
+        // Pre-select Line plot, the usual choice.
         this->typeList->setCurrentItem(this->typeList->item(0));
 
         // For line plots, it's common to select one or a few traces
@@ -476,9 +636,11 @@ void viewGVpropertieslayout::logListSelectionChanged(int index)
 
         // populate types with event plot forms:
         this->typeList->addItem("Raster plot");
-        // An alternative plot type is: this->types->addItem("Histogram");
+        // counted as the log was indexed, and of all the logged neurons
+        this->typeList->addItem("Firing rate");
+        this->typeList->addItem("Population rate");
 
-        // Pre-select Raster plot, as there is only one option.
+        // Pre-select Raster plot, the usual choice.
         this->typeList->setCurrentItem(this->typeList->item(0));
 
         // Typically we want to select all items for a raster plot, so do this here:
@@ -525,6 +687,10 @@ void viewGVpropertieslayout::addGraphsToCurrent()
                     DBG() << "Oops, failed to plot";
                 }
             }
+        } else if (this->typeList->currentRow() == 1) { // Column mean
+            if (!this->vLogData[dataIndex]->plotActivity(currPlot, this->currentSubWindow, "columnMeans")) {
+                DBG() << "Oops, failed to plot";
+            }
         }
     }
     if (this->vLogData[dataIndex]->dataClass == EVENTDATA) {
@@ -537,6 +703,11 @@ void viewGVpropertieslayout::addGraphsToCurrent()
             if (!this->vLogData[dataIndex]->plotRaster(currPlot, this->currentSubWindow, indexList)) {
                 DBG() << "Oops, failed to plot";
             }
+        } else if (this->typeList->currentRow() == 1 || this->typeList->currentRow() == 2) { // Firing or population rate
+            QString type = this->typeList->currentRow() == 1 ? "firingRates" : "populationRate";
+            if (!this->vLogData[dataIndex]->plotActivity(currPlot, this->currentSubWindow, type)) {
+                DBG() << "Oops, failed to plot";
+            }
         }
     }
 }
@@ -627,9 +798,11 @@ void viewGVpropertieslayout::actionToGrid_triggered()
 
 void viewGVpropertieslayout::actionRefreshLogData_triggered()
 {
-    // refresh all logs:
+    // refresh all logs, all at once:
     for (int i = 0; i < this->vLogData.size(); ++i) {
-        this->refreshLog (this->vLogData[i]);
+        if (!this->pendingLogs.contains(this->vLogData[i]->logFileXMLname)) {
+            this->startLogLoad (this->vLogData[i]->logFileXMLname);
+        }
     }
 }
 
@@ -657,19 +830,16 @@ void viewGVpropertieslayout::actionSavePng_triggered()
 // backend. Calls logData::setupFromXML to re-populate log, then
 void viewGVpropertieslayout::refreshLog (logData* log)
 {
-    if (log->setupFromXML()) {
-        // find graphs from this log
-
-        // get a list of the MDI windows which are visible
-        QList<QMdiSubWindow*> subWins = this->viewGV->mdiarea->subWindowList();
+    // find graphs from this log
 
-        // loop and extract the plot
-        for (int i = 0; i < subWins.size(); ++i) {
-            // Adds lines and rasters from log to subWins[i] ONLY if there's a match.
-            this->addLinesRasters (log, subWins[i]);
-        }
+    // get a list of the MDI windows which are visible
+    QList<QMdiSubWindow*> subWins = this->viewGV->mdiarea->subWindowList();
 
-    } // else return
+    // loop and extract the plot
+    for (int i = 0; i < subWins.size(); ++i) {
+        // Adds lines and rasters from log to subWins[i] ONLY if there's a match.
+        this->addLinesRasters (log, subWins[i]);
+    }
 }
 
 void viewGVpropertieslayout::actionLoadLogData_triggered()
@@ -26,11 +26,16 @@
 #define VIEWGVPROPERTIESLAYOUT_H
 
 #include <QtGui>
+#include <QThreadPool>
 #include "SC_logged_data.h"
 #include "EL_experiment.h"
 
 struct viewGVstruct; // Defined in mainwindow.h
 
+// with unified time axes, a range change is passed on to the other plots at
+// most this often, so a burst of wheel or drag events replots them once
+#define GRAPH_UNIFY_INTERVAL_MS 30
+
 class viewGVpropertieslayout : public QWidget
 {
     Q_OBJECT
@@ -67,6 +72,14 @@ public:
      */
     void addEmptyPlot (void);
 
+    /*!
+     * While a simulation is running, look in logDir every
+     * LOG_FOLLOW_INTERVAL_MS for new logs and for new rows in the logs
+     * which are loaded, and extend their plots with them.
+     */
+    void followLogs (QString logDir);
+    void stopFollowingLogs (void);
+
     /*!
      * \brief viewGV - a structure defined in mainwindow.h holding
      * information about the graphing interface of SpineCreator.
@@ -151,11 +164,23 @@ private:
     void updateLogList (void);
 
     /*!
-     * \brief refreshLog
+     * \brief refreshLog redraws the graphs of log in all the sub windows.
      * \param log
      */
     void refreshLog (logData* log);
 
+    /*!
+     * Set up the log logXMLname on loadPool, reading the columns which are
+     * plotted from it; logLoaded() adds it, or refreshes the log of that
+     * name, when it is done. Loads started before the last clearVLogData()
+     * are dropped when they finish.
+     */
+    void startLogLoad (const QString& logXMLname);
+    QThreadPool loadPool;
+    QSet<logLoader*> pendingLoads;
+    QSet<QString> pendingLogs;
+    int loadGeneration;
+
     /*!
      * Run through the logData object and graph all data on @see subWin.
      */
@@ -168,7 +193,26 @@ private:
      */
     bool unifyTime;
 
+    /*!
+     * The latest x range to be unified, which unifyTimer applies to the
+     * other plots. Plots which are not visible then are marked with the
+     * property "unifiedRangeStale" and are given the range when next
+     * shown, by eventFilter().
+     */
+    QTimer unifyTimer;
+    QCPRange unifiedRange;
+    bool unifying;
+    void setUnifiedRange (QCustomPlot* plot);
+    bool eventFilter (QObject* watched, QEvent* event);
+
+    QTimer followTimer;
+    QString followedLogDir;
+
 signals:
+    /*!
+     * Emitted when a log has been added to vLogData.
+     */
+    void logsLoaded();
 
 public slots:
     // property slots
@@ -190,7 +234,7 @@ public slots:
     /*!
      * Set the range r on the x axis for all plots other than the
      * current one. This is a "unify time" option for multiple
-     * graphs. Cool.
+     * graphs. The change is made on the next tick of unifyTimer.
      */
     void unifyRangeForAllPlots (const QCPRange& r);
 
@@ -234,6 +278,11 @@ public slots:
     void actionRefreshLogData_triggered();
     void actionSavePdf_triggered();
     void actionSavePng_triggered();
+
+private slots:
+    void followTick();
+    void applyUnifiedRange();
+    void logLoaded();
 };
 
 #endif // VIEWGVPROPERTIESLAYOUT_H
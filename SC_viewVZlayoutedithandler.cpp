@@ -38,6 +38,8 @@ viewVZLayoutEditHandler::viewVZLayoutEditHandler(nl_rootdata * data, viewNLstruc
     this->viewVZ->treeView = NULL;
 
     this->playBackTimeStep = 17;
+    this->playBackStartRow = 0;
+    this->playBackLastRow = 0;
     connect(&playBack, SIGNAL(timeout()), this, SLOT(playBackTimeout()));
 
     initGlobal();
@@ -318,6 +320,19 @@ void viewVZLayoutEditHandler::initGlobal()
 
     viewVZ->toolbar->layout()->addWidget(ortho);
 
+    // colour the neurons from a running model's external outputs
+
+    QPushButton * liveActivity = new QPushButton("Live", data->main);
+    connect(liveActivity, SIGNAL(toggled(bool)), this, SLOT(toggleLiveActivity(bool)));
+    liveActivity->setCheckable(true);
+    liveActivity->setToolTip("Show the activity of the populations shown, from the external outputs of the selected experiment, as it runs");
+    liveActivity->setMinimumHeight(28);
+    liveActivity->setMaximumWidth(40);
+    liveActivity->setFlat(true);
+    liveActivity->setChecked(false);
+
+    viewVZ->toolbar->layout()->addWidget(liveActivity);
+
     ((QHBoxLayout *)viewVZ->toolbar->layout())->addStretch();
 }
 
@@ -640,7 +655,7 @@ void viewVZLayoutEditHandler::togglePlay()
         QCommonStyle style;
         but->setIcon(style.standardIcon(QStyle::SP_MediaPlay));
     } else {
-        playBack.setInterval(playBackTimeStep);
+        this->restartPlayBackClock();
         playBack.start();
         QPushButton * but = (QPushButton *) sender();
         QCommonStyle style;
@@ -648,11 +663,36 @@ void viewVZLayoutEditHandler::togglePlay()
     }
 }
 
+/*!
+ * Pace playback from the current slider position. The timer runs at no more
+ * than about 60 frames a second and each tick moves to the row that is due,
+ * so rows are dropped rather than playback slowing when frames run long.
+ */
+void viewVZLayoutEditHandler::restartPlayBackClock()
+{
+    playBackStartRow = timeSlider->value();
+    playBackLastRow = playBackStartRow;
+    playBackClock.start();
+    playBack.setInterval(qMax(playBackTimeStep, 16));
+}
+
 void viewVZLayoutEditHandler::playBackTimeout()
 {
+    // the slider has been moved by hand
+    if (timeSlider->value() != playBackLastRow) {
+        this->restartPlayBackClock();
+    }
+
     if (timeSlider->value() < timeSlider->maximum()) {
-        timeSlider->setValue(timeSlider->value()+1);
-        viewVZ->OpenGLWidget->updateLogDataTime(timeSlider->value());
+        qint64 due = playBackStartRow + playBackClock.elapsed() / qMax(playBackTimeStep, 1);
+        if (due > timeSlider->maximum()) {
+            due = timeSlider->maximum();
+        }
+        if (due > timeSlider->value()) {
+            timeSlider->setValue((int) due);
+            viewVZ->OpenGLWidget->updateLogDataTime(timeSlider->value());
+        }
+        playBackLastRow = timeSlider->value();
     } else {
         playBack.stop();
         QCommonStyle style;
@@ -660,9 +700,31 @@ void viewVZLayoutEditHandler::playBackTimeout()
     }
 }
 
+void viewVZLayoutEditHandler::toggleLiveActivity(bool on)
+{
+    if (!on) {
+        viewVZ->OpenGLWidget->stopLiveActivity();
+        return;
+    }
+
+    QString error;
+    if (!viewVZ->OpenGLWidget->startLiveActivity(error)) {
+        QMessageBox::warning(data->main, "Live activity", error);
+        QPushButton * button = qobject_cast <QPushButton *> (sender());
+        if (button) {
+            button->blockSignals(true);
+            button->setChecked(false);
+            button->blockSignals(false);
+        }
+    }
+}
+
 void viewVZLayoutEditHandler::setPlayTimeStep(int tstep)
 {
     this->playBackTimeStep = tstep;
+    if (playBack.isActive()) {
+        this->restartPlayBackClock();
+    }
 }
 
 void viewVZLayoutEditHandler::clearAll()
@@ -831,6 +893,14 @@ void viewVZLayoutEditHandler::selectionChanged(QItemSelection top, QItemSelectio
 {
     // look up the selected item
     QModelIndexList indices = top.indexes();
+    if (indices.isEmpty()) {
+        // the selected row has been removed
+        viewVZ->currObject = (QSharedPointer<systemObject>)0;
+        data->selList.clear();
+        this->clearAll();
+        this->redrawHeaders();
+        return;
+    }
     TreeItem *item = static_cast<TreeItem*>(indices[0].internalPointer());
 
     // sanity check
@@ -1229,6 +1299,7 @@ void viewVZLayoutEditHandler::drawDeletables()
             index->setFocusPolicy(Qt::StrongFocus);
             index->installEventFilter(new FilterOutUndoRedoEvents);
             connect(index, SIGNAL(valueChanged(int)), viewVZ->OpenGLWidget, SLOT (selectedNrnChanged(int)));
+            connect(viewVZ->OpenGLWidget, SIGNAL(neuronPicked(int)), index, SLOT(setValue(int)));
             connect(this, SIGNAL(deleteProperties()), index, SLOT(deleteLater()));
             hlay->addWidget(index);
             hlay->addWidget(new QLabel(" from population "));
@@ -1243,6 +1314,7 @@ void viewVZLayoutEditHandler::drawDeletables()
             from->setFocusPolicy(Qt::StrongFocus);
             from->installEventFilter(new FilterOutUndoRedoEvents);
             connect(from, SIGNAL(currentIndexChanged(int)), viewVZ->OpenGLWidget, SLOT (selectedNrnChanged(int)));
+            connect(viewVZ->OpenGLWidget, SIGNAL(neuronPickedFrom(int)), from, SLOT(setCurrentIndex(int)));
             connect(this, SIGNAL(deleteProperties()), from, SLOT(deleteLater()));
             hlay->addWidget(from);
             panelLayout->insertLayout(panelLayout->count() - 2, hlay,2);
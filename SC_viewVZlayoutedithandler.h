@@ -81,6 +81,11 @@ private:
     // timer
     QTimer playBack;
     int playBackTimeStep;
+    // playback is paced from the row and time it (re)started
+    QElapsedTimer playBackClock;
+    int playBackStartRow;
+    int playBackLastRow;
+    void restartPlayBackClock();
 
     // population
     QComboBox * layoutComboBox;
@@ -141,6 +146,7 @@ public slots:
     void togglePlay();
     void playBackTimeout();
     void setPlayTimeStep(int tstep);
+    void toggleLiveActivity(bool on);
 
     void disableButton();
 
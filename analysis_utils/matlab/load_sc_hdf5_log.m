@@ -0,0 +1,46 @@
+%% This function loads a window of time, and optionally a range of the
+%% neurons, of an analog log from the HDF5 store written by SpineCreator
+%% with --export-hdf5, reading only that part of the file.
+%%
+%% log is the log's file name without the .bin. t_range is [start end) in
+%% ms, and rows (numbered from 1) is a contiguous range of the logged
+%% neurons, as [first last].
+%%
+%% Usage:
+%%
+%% [ data, t, neurons ] = load_sc_hdf5_log ('model.h5', 'Population_v_log', [500 600])
+%%
+%%  or, for the first ten logged neurons only,
+%%
+%% [ data, t, neurons ] = load_sc_hdf5_log ('model.h5', 'Population_v_log', [500 600], [1 10])
+%%
+%% data has a row per neuron and a column per timestep, as from
+%% load_sc_data; t is the time of each timestep in ms and neurons the
+%% neuron index of each row.
+%%
+function [ data, t, neurons ] = load_sc_hdf5_log (h5_file, log, t_range, rows)
+
+    group = ['/logs/', log];
+    dt = h5readatt (h5_file, group, 'dt');
+    neurons = h5read (h5_file, [group, '/neurons']);
+
+    % The values are stored a row per neuron; MATLAB sees them transposed.
+    info = h5info (h5_file, [group, '/values']);
+    num_steps = info.Dataspace.Size(1);
+    num_rows = info.Dataspace.Size(2);
+
+    if nargin < 4
+        rows = [1 num_rows];
+    end
+    first = max (0, ceil (t_range(1) / dt - 1e-9));
+    last = min (num_steps, ceil (t_range(2) / dt - 1e-9));
+    nsteps = max (0, last - first);
+
+    data = zeros (rows(2) - rows(1) + 1, nsteps);
+    if nsteps > 0
+        data = h5read (h5_file, [group, '/values'], ...
+                       [first+1, rows(1)], [nsteps, rows(2)-rows(1)+1])';
+    end
+    t = (first + (0 : nsteps-1)) * dt;
+    neurons = neurons(rows(1):rows(2));
+end
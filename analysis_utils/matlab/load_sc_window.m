@@ -0,0 +1,80 @@
+%% This function loads a window of time, and optionally a subset of the
+%% columns, from a binary analog log output from SpineCreator, without
+%% reading the rest of the file. Use it in place of load_sc_data for
+%% logs which are too large to load whole.
+%%
+%% The log holds a row of num_cols doubles per timestep. The rows from
+%% t_start up to (but not including) t_end (in ms; dt is the timestep
+%% in ms) are read a chunk at a time, and only the columns given in
+%% cols (numbered from 1) are kept. If not all the neurons were logged,
+%% the *_logrep.xml file lists the neuron index held in each column
+%% (the LogCol elements, in order).
+%%
+%% Usage:
+%%
+%% [ data, t ] = load_sc_window ('Population_v_log.bin', 100, 0.1, [500 600])
+%%
+%%  or, for columns 1, 5 and 9 only,
+%%
+%% [ data, t ] = load_sc_window ('Population_v_log.bin', 100, 0.1, [500 600], [1 5 9])
+%%
+%% data has a row per column and a column per timestep, as from
+%% load_sc_data; t is the time of each timestep in ms.
+%%
+function [ data, t ] = load_sc_window (bin_file, num_cols, dt, t_range, cols)
+
+    if nargin < 5
+        cols = 1:num_cols;
+    end
+    data = [];
+    t = [];
+
+    if any(cols < 1) || any(cols > num_cols)
+        display ('Error: columns out of range');
+        return;
+    end
+
+    [ fid, fopen_msg ] = fopen (bin_file, 'r', 'native');
+    if fid == -1
+        display (['Failed to open file ', bin_file, ' with error: ', ...
+                  fopen_msg]);
+        return;
+    end
+
+    % Whole rows in the file (it may still be being written).
+    fseek (fid, 0, 'eof');
+    num_steps = floor (ftell (fid) / (8 * num_cols));
+
+    % Row r (from 0) holds the values at time r*dt.
+    first = max (0, ceil (t_range(1) / dt - 1e-9));
+    last = min (num_steps, ceil (t_range(2) / dt - 1e-9));
+    nsteps = max (0, last - first);
+
+    data = zeros (length (cols), nsteps);
+    t = (first + (0 : nsteps-1)) * dt;
+
+    % Read a bounded number of rows at a time, keeping only cols.
+    chunk = max (1, floor (2^24 / (8 * num_cols)));
+    fseek (fid, first * 8 * num_cols, 'bof');
+    done = 0;
+    while done < nsteps
+        n = min (chunk, nsteps - done);
+        [ block, count ] = fread (fid, [num_cols, n], 'double=>double');
+        if count < num_cols * n
+            display (['Warning: short read from ', bin_file]);
+            n = floor (count / num_cols);
+            data = data(:, 1:done+n);
+            t = t(1:done+n);
+            if n == 0
+                break;
+            end
+        end
+        data(:, done+1 : done+n) = block(cols, 1:n);
+        done = done + n;
+    end
+
+    rtn = fclose (fid);
+    if rtn == -1
+        display (['Warning: failed to close file ', bin_file]);
+    end
+end
@@ -20,7 +20,7 @@ def load_sc_data (file_path, num_neurons=0):
         base_path = file_path [:end-7]
     else:
         # Error
-        print 'Error: Bad SpineCreator log file name: ' + file_path
+        print ('Error: Bad SpineCreator log file name: ' + file_path)
         return (0,0,0)
 
     xml_file = base_path + 'rep.xml'
@@ -40,7 +40,7 @@ def load_sc_data (file_path, num_neurons=0):
         # Assumed Analog Log here. May be wrong for event log.
         logFileType = root.find('.//LogFileType')
         if logFileType.text != 'binary':
-            print 'File described by ', xml_file, ' is not marked as being in binary format.'
+            print ('File described by ' + xml_file + ' is not marked as being in binary format.')
             return(0,0,0)
 
         # Log end is in steps of size dt. Unused at present even
@@ -70,3 +70,276 @@ def load_sc_data (file_path, num_neurons=0):
 
     # return data, count, t in a list. Could be a tuple?
     return (data, count, t)
+
+
+# The readers below map the log file into memory with numpy.memmap
+# rather than reading it, so that logs larger than RAM can be used. Only
+# the parts of the file which are selected - a window of time, a subset
+# of neurons - are ever read from disk, and they can be taken a chunk
+# at a time.
+#
+# The layout of the log comes from its *_logrep.xml file, parsed as
+# logData::setupFromXML does in SpineCreator (SC_logged_data.cpp). An
+# analog log has a row per timestep, holding a column per logged
+# neuron; if not all the neurons were logged (no LogAll element), each
+# LogCol gives the index of the neuron in its column. An event log has
+# a row per event: the time, the index of the neuron and, for
+# impulses, a value.
+
+# Sizes as written by SpineML_2_BRAHMS, in native byte order. longint
+# is a C long int, which is 8 bytes on the 64 bit Linux and Mac OS X
+# builds.
+_sc_binary_types = { 'double': 'f8', 'float': 'f4', 'int': 'i4', 'longint': 'i8' }
+
+def read_logrep (xml_file):
+# read_logrep Parse a SpineCreator *_logrep.xml log description.
+#
+# Returns a dict with: 'log_class' ('analog' or 'event'), 'file_type'
+# ('binary', 'csv' or 'ssv'), 'log_file' (the path of the log, which is
+# given relative to the xml file), 'end_time', 'dt', 'port' (event logs
+# only), 'all_logged', 'event_indices' (event logs only) and 'columns',
+# a list of dicts with 'index', 'heading', 'dims' and 'type'.
+
+    import os
+    import xml.etree.ElementTree as et
+
+    root = et.parse(xml_file).getroot()
+    if root.tag != 'LogReport':
+        raise ValueError (xml_file + ' is not a LogReport')
+
+    rep = { 'log_class': None, 'file_type': None, 'log_file': None,
+            'end_time': 0.0, 'dt': 1.0, 'port': '', 'all_logged': False,
+            'event_indices': [], 'columns': [] }
+
+    for log in root:
+        if log.tag == 'AnalogLog':
+            rep['log_class'] = 'analog'
+        elif log.tag == 'EventLog':
+            rep['log_class'] = 'event'
+        else:
+            raise ValueError ('Log type unknown: ' + log.tag)
+
+        for el in log:
+            if el.tag == 'LogFile':
+                rep['log_file'] = el.text.strip()
+            elif el.tag == 'LogFileType':
+                rep['file_type'] = el.text.strip()
+                if rep['file_type'] not in ('binary', 'csv', 'ssv'):
+                    raise ValueError ('Invalid file format: ' + rep['file_type'])
+            elif el.tag == 'LogEndTime':
+                rep['end_time'] = float(el.text)
+            elif el.tag == 'TimeStep':
+                rep['dt'] = float(el.get('dt'))
+            elif el.tag == 'LogPort':
+                rep['port'] = el.text.strip()
+            elif el.tag == 'LogIndex':
+                rep['event_indices'].append (int(el.text))
+            elif el.tag == 'LogCol':
+                # Event port logs don't use the index.
+                index = -1
+                if rep['log_class'] == 'analog':
+                    index = int(el.get('index'))
+                rep['columns'].append ({ 'index': index, 'heading': el.get('heading'),
+                                         'dims': el.get('dims'), 'type': el.get('type') })
+            elif el.tag == 'LogAll':
+                rep['all_logged'] = True
+                size = int(el.get('size'))
+                if rep['log_class'] == 'analog':
+                    # As many columns as neurons, replacing any LogCols.
+                    rep['columns'] = [ { 'index': i, 'heading': el.get('headings'),
+                                         'dims': el.get('dims'), 'type': el.get('type') }
+                                       for i in range(size) ]
+                else:
+                    rep['event_indices'].extend (range(size))
+            else:
+                raise ValueError ('Unknown tag name ' + el.tag)
+
+    if rep['log_file'] is not None:
+        rep['log_file'] = os.path.join (os.path.dirname (os.path.abspath (xml_file)),
+                                        rep['log_file'])
+    return rep
+
+class sc_log (object):
+# sc_log A SpineCreator binary log, mapped into memory.
+#
+# log = sc_log ('Population_v_logrep.xml')
+#
+# For an analog log:
+#
+#   data, t = log.analog (t_start=100, t_end=200, neurons=[0, 5, 9])
+#
+# gives the values of neurons 0, 5 and 9 at each timestep from 100 ms
+# up to (but not including) 200 ms, as a matrix with a row per timestep
+# and a column per neuron, and t, the time of each row in ms. Leave out
+# t_start, t_end or neurons to get them all. Asking for a neuron which
+# was not logged raises KeyError. To go through a large selection
+# without holding it all in memory:
+#
+#   for t, data in log.analog_chunks (chunk_steps=10000, neurons=[0, 5, 9]):
+#       ...
+#
+# For an event (spike or impulse) log:
+#
+#   t, index, value = log.events (t_start=100, t_end=200, neurons=[0, 5, 9])
+#
+# gives the time, neuron index and (for impulses, else None) value of
+# each event, and log.event_chunks() goes through them a chunk at a
+# time. Events are logged in time order, so a time window is found by
+# bisection without reading the rest of the file.
+
+    def __init__ (self, xml_file):
+        import os
+        import numpy as np
+
+        self.rep = read_logrep (xml_file)
+        if self.rep['file_type'] != 'binary':
+            raise ValueError ('File described by ' + xml_file
+                              + ' is not marked as being in binary format.')
+
+        cols = self.rep['columns']
+        types = [ c['type'] for c in cols ]
+        for ty in types:
+            if ty not in _sc_binary_types:
+                raise ValueError ('Column type ' + str(ty) + ' can not be memory mapped.')
+
+        self.log_class = self.rep['log_class']
+        self.dt = self.rep['dt']
+        self.dtype = np.dtype ([ ('c%d' % i, '=' + _sc_binary_types[ty])
+                                 for i, ty in enumerate(types) ])
+
+        # A log which is still being written may end part way through a
+        # row; as in SpineCreator, only whole rows are used.
+        stride = self.dtype.itemsize
+        self.num_rows = 0
+        if stride > 0:
+            self.num_rows = os.path.getsize (self.rep['log_file']) // stride
+
+        # An analog log of one type (the usual case) is mapped as a
+        # plain matrix, so that columns can be picked out by fancy
+        # indexing; anything else as an array of records.
+        self.matrix = None
+        self.rows = None
+        if self.num_rows > 0:
+            if self.log_class == 'analog' and len(set(types)) == 1:
+                self.matrix = np.memmap (self.rep['log_file'], mode='r',
+                                         dtype='=' + _sc_binary_types[types[0]],
+                                         shape=(self.num_rows, len(cols)))
+            else:
+                self.rows = np.memmap (self.rep['log_file'], mode='r',
+                                       dtype=self.dtype, shape=(self.num_rows,))
+
+        # Which column holds each logged neuron, for analog logs.
+        self.column_of = {}
+        if self.log_class == 'analog':
+            for pos, c in enumerate(cols):
+                self.column_of[c['index']] = pos
+
+    def num_steps (self):
+        # The number of timesteps in an analog log.
+        return self.num_rows if self.log_class == 'analog' else 0
+
+    def _columns (self, neurons):
+        if neurons is None:
+            return list(range(len(self.rep['columns'])))
+        missing = [ n for n in neurons if n not in self.column_of ]
+        if missing:
+            raise KeyError ('Neurons not in this log: ' + str(missing))
+        return [ self.column_of[n] for n in neurons ]
+
+    def _steps (self, t_start, t_end):
+        # Row r holds the values at time r*dt. Allow for rounding in
+        # the times asked for.
+        import math
+        first = 0
+        last = self.num_steps()
+        if t_start is not None:
+            first = max (0, int(math.ceil (t_start / self.dt - 1e-9)))
+        if t_end is not None:
+            last = min (last, int(math.ceil (t_end / self.dt - 1e-9)))
+        return first, max (first, last)
+
+    def _read_steps (self, first, last, cols):
+        import numpy as np
+        if self.matrix is not None:
+            return np.array (self.matrix[first:last, cols], dtype=np.float64)
+        if self.rows is None:
+            return np.zeros ((0, len(cols)))
+        block = self.rows[first:last]
+        return np.column_stack ([ block['c%d' % c].astype(np.float64) for c in cols ]) \
+            if cols else np.zeros ((last - first, 0))
+
+    def analog_chunks (self, chunk_steps=4096, t_start=None, t_end=None, neurons=None):
+        # Yield (t, data) for successive chunks of at most chunk_steps
+        # timesteps of an analog log.
+        import numpy as np
+        if self.log_class != 'analog':
+            raise ValueError ('Not an analog log')
+        cols = self._columns (neurons)
+        first, last = self._steps (t_start, t_end)
+        for a in range(first, last, max (1, int(chunk_steps))):
+            b = min (last, a + max (1, int(chunk_steps)))
+            yield (np.arange (a, b) * self.dt, self._read_steps (a, b, cols))
+
+    def analog (self, t_start=None, t_end=None, neurons=None):
+        # Return (data, t) for a window of an analog log.
+        import numpy as np
+        if self.log_class != 'analog':
+            raise ValueError ('Not an analog log')
+        cols = self._columns (neurons)
+        first, last = self._steps (t_start, t_end)
+        return (self._read_steps (first, last, cols), np.arange (first, last) * self.dt)
+
+    def _event_range (self, t_start, t_end):
+        import numpy as np
+        if self.rows is None:
+            return 0, 0
+        times = self.rows['c0']
+        first = 0 if t_start is None else int(np.searchsorted (times, t_start, side='left'))
+        last = self.num_rows if t_end is None else int(np.searchsorted (times, t_end, side='left'))
+        return first, max (first, last)
+
+    def event_chunks (self, chunk_events=65536, t_start=None, t_end=None, neurons=None):
+        # Yield (t, index, value) for successive chunks of at most
+        # chunk_events events of an event log; value is None for spikes.
+        import numpy as np
+        if self.log_class != 'event':
+            raise ValueError ('Not an event log')
+        if neurons is not None and not self.rep['all_logged'] and self.rep['event_indices']:
+            missing = [ n for n in neurons if n not in set(self.rep['event_indices']) ]
+            if missing:
+                raise KeyError ('Neurons not in this log: ' + str(missing))
+        first, last = self._event_range (t_start, t_end)
+        wanted = None if neurons is None else np.asarray (neurons)
+        has_values = len(self.rep['columns']) > 2
+        for a in range(first, last, max (1, int(chunk_events))):
+            block = self.rows[a:min (last, a + max (1, int(chunk_events)))]
+            t = np.array (block['c0'], dtype=np.float64)
+            index = np.array (block['c1'], dtype=np.int64)
+            value = np.array (block['c2'], dtype=np.float64) if has_values else None
+            if wanted is not None:
+                keep = np.in1d (index, wanted)
+                t = t[keep]
+                index = index[keep]
+                if value is not None:
+                    value = value[keep]
+            yield (t, index, value)
+
+    def events (self, t_start=None, t_end=None, neurons=None, chunk_events=65536):
+        # Return (t, index, value) for the events in a window of an
+        # event log. Neurons are filtered chunk by chunk, so only the
+        # selected events are held in memory.
+        import numpy as np
+        ts = []
+        indices = []
+        values = []
+        for t, index, value in self.event_chunks (chunk_events, t_start, t_end, neurons):
+            ts.append (t)
+            indices.append (index)
+            if value is not None:
+                values.append (value)
+        has_values = len(self.rep['columns']) > 2
+        if not ts:
+            return (np.zeros (0), np.zeros (0, dtype=np.int64),
+                    np.zeros (0) if has_values else None)
+        return (np.concatenate (ts), np.concatenate (indices),
+                np.concatenate (values) if has_values else None)
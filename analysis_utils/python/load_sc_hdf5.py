@@ -0,0 +1,65 @@
+# Functions to read the HDF5 store written by SpineCreator with
+# --export-hdf5 (see SC_hdf5store.h for its layout). Only the parts asked
+# for are read from the file. Needs h5py.
+
+def load_sc_hdf5_connections (h5_file, name):
+# Returns the arrays (src, dst, delay) of the explicit connection list
+# name, for example 'Population 1 to Population 2: Synapse 0'. delay is
+# None if the list has no per-connection delays.
+
+    import h5py
+
+    with h5py.File(h5_file, 'r') as f:
+        group = f['connections'][name]
+        src = group['src'][:]
+        dst = group['dst'][:]
+        delay = group['delay'][:] if 'delay' in group else None
+    return (src, dst, delay)
+
+def load_sc_hdf5_property (h5_file, component, prop):
+# Returns the arrays (indices, values) of an explicit property list.
+# component is the component's name in the exported model.
+
+    import h5py
+
+    with h5py.File(h5_file, 'r') as f:
+        group = f['properties'][component][prop]
+        return (group['indices'][:], group['values'][:])
+
+def load_sc_hdf5_log (h5_file, log, t_range=None, rows=None):
+# Returns (data, t, neurons) for the analog log log (its file name without
+# the .bin). data has a row for each logged neuron and a column per
+# timestep, as from load_sc_data; t is the time of each timestep in ms and
+# neurons the neuron of each row. t_range ([start, end) in ms) and rows (a
+# sorted list of rows of data) limit what is read.
+
+    import h5py
+    import numpy as np
+
+    with h5py.File(h5_file, 'r') as f:
+        group = f['logs'][log]
+        dt = float(group.attrs['dt'])
+        values = group['values']
+        first = 0
+        last = values.shape[1]
+        if t_range is not None:
+            first = max(0, int(np.ceil(t_range[0] / dt - 1e-9)))
+            last = min(last, int(np.ceil(t_range[1] / dt - 1e-9)))
+            last = max(first, last)
+        neurons = group['neurons'][:]
+        if rows is None:
+            data = values[:, first:last]
+        else:
+            data = values[rows, first:last]
+            neurons = neurons[rows]
+    t = (first + np.arange(last - first)) * dt
+    return (data, t, neurons)
+
+def load_sc_hdf5_events (h5_file, log):
+# Returns (times, indices) of the events in the event log log.
+
+    import h5py
+
+    with h5py.File(h5_file, 'r') as f:
+        group = f['logs'][log]
+        return (group['times'][:], group['indices'][:])
@@ -0,0 +1,1507 @@
+/***************************************************************************
+**                                                                        **
+**  This file is part of SpineCreator, an easy to use GUI for             **
+**  describing spiking neural network models.                             **
+**  Copyright (C) 2013-2014 Alex Cope, Paul Richmond, Seb James           **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Alex Cope                                            **
+**  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
+****************************************************************************/
+
+/*
+ * Timings for the data paths which grow with the size of a model: laying
+ * out populations, evaluating layout maths, reading and importing explicit
+ * connection lists, writing and reading explicit property values, reading
+ * logs and plotting rasters, and saving and opening a project. Each is run
+ * on synthetic data of each size asked for (by default 1k and 100k items,
+ * and 10M with --large), a few times, and the fastest and median times are
+ * reported, with the median time per item. Projects given with --project,
+ * such as reference models, are opened, saved, exported and laid out too.
+ * The results can be written as JSON (--json), with the totals of the
+ * profiling probes, and compared with those of an earlier build
+ * (--compare), so that a slower build is caught.
+ *
+ * This is built from the application sources by spinecreatorbench.pro; see
+ * readme.spinecreatorbench for how to build and run it.
+ */
+
+#include <QApplication>
+#include <QDomDocument>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QXmlStreamWriter>
+#include <QStringList>
+#include <QTextStream>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#endif
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include "globalHeader.h"
+#include "CL_layout_classes.h"
+#include "SC_layout_cinterpreter.h"
+#include "NL_connection.h"
+#include "NL_population.h"
+#include "NL_projection_and_synapse.h"
+#include "SC_network_layer_rootdata.h"
+#include "SC_projectobject.h"
+#include "SC_undocommands.h"
+#include "SC_settings.h"
+#include "SC_logged_data.h"
+#include "SC_profiler.h"
+#include "SC_networkgraphwriter.h"
+#include "SC_modelsnapshot.h"
+#include "qcustomplot.h"
+
+#define BENCH_DEFAULT_REPETITIONS 5
+
+// neurons in each population of the project and in the raster log
+#define BENCH_POPULATION_SIZE 1000
+
+// columns in the analog log, and events in each timestep of the event log
+#define BENCH_LOG_COLUMNS 100
+#define BENCH_EVENTS_PER_STEP 10
+
+// --compare reports a median this much slower than the baseline's, and
+// by at least BENCH_REGRESSION_MIN_MS, as a regression
+#define BENCH_REGRESSION_PERCENT 10.0
+#define BENCH_REGRESSION_MIN_MS 0.5
+
+// the format of the --json results, which --compare reads back
+#define BENCH_RESULTS_VERSION 1
+
+// the directory the benchmarks write their files into
+static QDir workDir;
+
+/*!
+ * A small xorshift generator, so the synthetic data are the same on every
+ * platform and from run to run.
+ */
+class benchRandom
+{
+public:
+    explicit benchRandom(quint32 seed) {state = seed ? seed : 1;}
+    quint32 next() {state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state;}
+    int below(int n) {return (int) (next() % (quint32) n);}
+    float uniform() {return (next() >> 8) * (1.0f / 16777216.0f);}
+private:
+    quint32 state;
+};
+
+/*!
+ * \brief The benchmark class is one timed operation. For each size,
+ * prepare() builds the data, then setUp(), run() and tearDown() are called
+ * for each repetition, and only run() is timed. finish() frees the data.
+ * The functions return false, with error set, if something went wrong.
+ */
+class benchmark
+{
+public:
+    explicit benchmark(const QString &name) {this->name = name; this->items = 0; this->sized = true;}
+    virtual ~benchmark() {}
+    virtual bool prepare(int size) = 0;
+    virtual bool setUp() {return true;}
+    virtual bool run() = 0;
+    virtual void tearDown() {}
+    virtual void finish() {}
+
+    QString name;
+    QString error;
+    // what run() works through, for the time per item; prepare() sets it
+    qint64 items;
+    // false for a benchmark on given data, which is run once, at size 0,
+    // rather than at each size
+    bool sized;
+};
+
+/*!
+ * Write connections from numSrc to numDst neurons, in source order as the
+ * generators write them, with a random delay.
+ */
+static void makeConnections(int size, int numSrc, int numDst, QVector<conn> &conns)
+{
+    benchRandom rng(size);
+    conns.resize(size);
+    for (int i = 0; i < size; ++i) {
+        conns[i].src = (int) (((qint64) i * numSrc) / size);
+        conns[i].dst = rng.below(numDst);
+        conns[i].metric = 1.0f + rng.uniform();
+    }
+}
+
+static bool writeFile(const QString &fileName, const QByteArray &bytes)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return f.write(bytes) == bytes.size();
+}
+
+static bool removeDirectory(const QString &path)
+{
+    QDir dir(path);
+    if (!dir.exists()) {
+        return true;
+    }
+    QFileInfoList entries = dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (int i = 0; i < entries.size(); ++i) {
+        if (entries[i].isDir() && !entries[i].isSymLink()) {
+            removeDirectory(entries[i].absoluteFilePath());
+        } else {
+            dir.remove(entries[i].fileName());
+        }
+    }
+    return dir.rmdir(dir.absolutePath());
+}
+
+/*!
+ * NineMLLayoutData::generateLayout for a layout placing neurons uniformly
+ * at random in a cube. Without a minimum distance the neurons are laid out
+ * independently (and in parallel); with one they are placed one at a time,
+ * each checked against those already placed.
+ */
+class layoutBenchmark : public benchmark
+{
+public:
+    layoutBenchmark(const QString &name, double minimumDistance) :
+        benchmark(name)
+    {
+        this->minimumDistance = minimumDistance;
+        this->seed = 0;
+    }
+
+    bool prepare(int size)
+    {
+        QDomDocument doc;
+        doc.setContent(QString(
+            "<SpineML>"
+            " <LayoutClass name=\"benchRandomCube\">"
+            "  <Parameter name=\"side\" dimension=\"?\"/>"
+            "  <Spatial>"
+            "   <Regime name=\"place\">"
+            "    <Transform variable=\"x\" order=\"1\" type=\"translate\"><MathInline>rand()*side</MathInline></Transform>"
+            "    <Transform variable=\"y\" order=\"2\" type=\"translate\"><MathInline>rand()*side</MathInline></Transform>"
+            "    <Transform variable=\"z\" order=\"3\" type=\"translate\"><MathInline>rand()*side</MathInline></Transform>"
+            "   </Regime>"
+            "   <StateVariable name=\"x\" dimension=\"?\"/>"
+            "   <StateVariable name=\"y\" dimension=\"?\"/>"
+            "   <StateVariable name=\"z\" dimension=\"?\"/>"
+            "  </Spatial>"
+            " </LayoutClass>"
+            "</SpineML>"));
+        this->layout = QSharedPointer<NineMLLayout> (new NineMLLayout());
+        this->layout->load(&doc);
+
+        this->layoutData = QSharedPointer<NineMLLayoutData> (new NineMLLayoutData(this->layout));
+        this->layoutData->minimumDistance = this->minimumDistance;
+        // a cube 4 minimum distances a neuron on a side is sparse enough
+        // for the distance constraint rarely to reject a location
+        for (int i = 0; i < this->layoutData->ParameterList.size(); ++i) {
+            if (this->layoutData->ParameterList[i]->name == "side") {
+                this->layoutData->ParameterList[i]->value[0] = 4.0 * pow((double) size, 1.0/3.0);
+            }
+        }
+        this->size = size;
+        this->items = size;
+        return true;
+    }
+
+    bool setUp()
+    {
+        // a new seed each time, so the layout is not taken from the cache
+        this->layoutData->seed = ++this->seed;
+        return true;
+    }
+
+    bool run()
+    {
+        QString err;
+        this->layoutData->generateLayout(this->size, &this->locations, err);
+        if (!err.isEmpty()) {
+            this->error = err;
+            return false;
+        }
+        if (this->locations.size() != this->size) {
+            this->error = "Laid out " + QString::number(this->locations.size()) + " neurons.";
+            return false;
+        }
+        return true;
+    }
+
+    void finish()
+    {
+        this->locations.clear();
+        this->layoutData.clear();
+        this->layout.clear();
+    }
+
+private:
+    double minimumDistance;
+    int seed;
+    int size;
+    QSharedPointer<NineMLLayout> layout;
+    QSharedPointer<NineMLLayoutData> layoutData;
+    QVector<loc> locations;
+};
+
+/*!
+ * One layout style expression evaluated many times, through the stack
+ * interpreter, compiled, or compiled and evaluated a block at a time.
+ */
+class mathsBenchmark : public benchmark
+{
+public:
+    enum mode {
+        Interpreted,
+        Compiled,
+        Blocked
+    };
+
+    mathsBenchmark(const QString &name, mode how) :
+        benchmark(name)
+    {
+        this->how = how;
+        this->result = 0;
+    }
+
+    bool prepare(int size)
+    {
+        // the stack points into varList, so it is filled in first
+        this->varList.clear();
+        this->varList.push_back(lookup("x", 0));
+        this->varList.push_back(lookup("y", 1));
+        this->varList.push_back(lookup("z", 2));
+        this->varList.push_back(lookup("side", 100));
+        this->varList.push_back(lookup("spacing", 2.5));
+        this->varList.push_back(lookup("pi", (float) M_PI));
+
+        this->stack.clear();
+        QString err = createStack("sqrt(pow(x,2)+pow(y,2))*cos(pi/4)+floor(z/spacing)+mod(x+spacing,side)",
+                                  this->varList, &this->stack);
+        if (!err.isEmpty()) {
+            this->error = err;
+            return false;
+        }
+        this->program = compiledMaths();
+        this->program.compile(this->stack);
+        this->program.bindBlock(this->varList);
+        this->blockVars.assign(this->varList.size() * MATHS_BLOCK_SIZE, 0);
+        for (uint k = 0; k < this->varList.size(); ++k) {
+            for (int j = 0; j < MATHS_BLOCK_SIZE; ++j) {
+                this->blockVars[k * MATHS_BLOCK_SIZE + j] = this->varList[k].value;
+            }
+        }
+
+        this->size = size;
+        this->items = size;
+        return true;
+    }
+
+    bool run()
+    {
+        float sum = 0;
+        if (this->how == Blocked) {
+            float out[MATHS_BLOCK_SIZE];
+            counterRandom rngs[MATHS_BLOCK_SIZE];
+            for (int i = 0; i < this->size; i += MATHS_BLOCK_SIZE) {
+                int n = qMin(MATHS_BLOCK_SIZE, this->size - i);
+                for (int j = 0; j < n; ++j) {
+                    this->blockVars[j] = (float) ((i + j) % 1000);
+                }
+                this->program.evaluateBlock(&this->blockVars[0], n, rngs, out);
+                for (int j = 0; j < n; ++j) {
+                    sum += out[j];
+                }
+            }
+            this->result = sum;
+            return true;
+        }
+        for (int i = 0; i < this->size; ++i) {
+            this->varList[0].value = (float) (i % 1000);
+            if (this->how == Compiled) {
+                sum += this->program.evaluate();
+            } else {
+                sum += interpretMaths(this->stack);
+            }
+        }
+        // kept so that the loop is not optimised away
+        this->result = sum;
+        return true;
+    }
+
+private:
+    mode how;
+    int size;
+    vector<lookup> varList;
+    vector<valop> stack;
+    compiledMaths program;
+    vector<float> blockVars;
+    volatile float result;
+};
+
+/*!
+ * Reading an explicit connection list back from its backing store, whole
+ * or a cell at a time in random order, and importing one from a packed
+ * binary file.
+ */
+class connectionBenchmark : public benchmark
+{
+public:
+    enum mode {
+        GetAllData,
+        GetData,
+        ImportPackedBinary
+    };
+
+    connectionBenchmark(const QString &name, mode m) :
+        benchmark(name)
+    {
+        this->m = m;
+        this->list = (csv_connection *) 0;
+        this->result = 0;
+    }
+
+    bool prepare(int size)
+    {
+        QVector<conn> conns;
+        int numNeurons = qMax(1, (int) sqrt((double) size));
+        makeConnections(size, numNeurons, numNeurons, conns);
+
+        this->list = new csv_connection;
+        this->list->setAllData(conns);
+
+        if (this->m == GetData) {
+            benchRandom rng(size + 1);
+            this->rows.resize(size);
+            for (int i = 0; i < size; ++i) {
+                this->rows[i] = rng.below(size);
+            }
+        }
+        if (this->m == ImportPackedBinary) {
+            // the packed binary format is the rows of conn as they are
+            this->packedFile = workDir.absoluteFilePath("packed_connections.bin");
+            QByteArray bytes((const char *) conns.constData(), conns.size() * (int) sizeof(conn));
+            if (!writeFile(this->packedFile, bytes)) {
+                this->error = "Could not write " + this->packedFile;
+                return false;
+            }
+        }
+
+        this->size = size;
+        this->items = size;
+        return true;
+    }
+
+    bool run()
+    {
+        if (this->m == GetAllData) {
+            QVector<conn> conns;
+            this->list->getAllData(conns);
+            if (conns.size() != this->size) {
+                this->error = "Read " + QString::number(conns.size()) + " connections.";
+                return false;
+            }
+        } else if (this->m == GetData) {
+            float sum = 0;
+            for (int i = 0; i < this->rows.size(); ++i) {
+                sum += this->list->getData(this->rows[i], 0) + this->list->getData(this->rows[i], 1);
+            }
+            this->result = sum;
+        } else {
+            QFile fileIn(this->packedFile);
+            if (!fileIn.open(QIODevice::ReadOnly)) {
+                this->error = "Could not open " + this->packedFile;
+                return false;
+            }
+            // import_packed_binary opens the connection's own store in its place
+            QFile fileOut(workDir.absoluteFilePath("connection_store.bin"));
+            this->list->import_packed_binary(fileIn, fileOut);
+            if (this->list->getNumRows() != this->size) {
+                this->error = "Imported " + QString::number(this->list->getNumRows()) + " connections.";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void finish()
+    {
+        delete this->list;
+        this->list = (csv_connection *) 0;
+        this->rows.clear();
+        if (!this->packedFile.isEmpty()) {
+            QFile::remove(this->packedFile);
+        }
+    }
+
+private:
+    mode m;
+    int size;
+    csv_connection * list;
+    QVector<int> rows;
+    QString packedFile;
+    volatile float result;
+};
+
+/*!
+ * Writing an explicit list of property values, which goes into a binary
+ * file beside the network as it does on saving, and reading it back.
+ */
+class explicitListBenchmark : public benchmark
+{
+public:
+    explicitListBenchmark(const QString &name, bool write) :
+        benchmark(name)
+    {
+        this->write = write;
+        this->values = (ParameterInstance *) 0;
+        this->readBack = (ParameterInstance *) 0;
+    }
+
+    bool prepare(int size)
+    {
+        benchRandom rng(size);
+        QVector<double> vals(size);
+        for (int i = 0; i < size; ++i) {
+            vals[i] = rng.uniform();
+        }
+        this->values = new ParameterInstance("?");
+        this->values->name = "w";
+        this->values->currType = ExplicitList;
+        this->values->filename = "explicitDataBinaryFile_bench.bin";
+        this->values->setDenseValues(vals);
+
+        // writing takes the project file name, and reading its directory
+        settingsCache::setCurrentFileName(workDir.absoluteFilePath("bench.proj"));
+        if (!this->write) {
+            if (!this->writeList()) {
+                return false;
+            }
+            QDomDocument doc;
+            doc.setContent(this->xml);
+            this->node = doc.documentElement();
+            settingsCache::setCurrentFileName(workDir.absolutePath());
+        }
+
+        this->size = size;
+        this->items = size;
+        return true;
+    }
+
+    bool setUp()
+    {
+        if (!this->write) {
+            this->readBack = new ParameterInstance("?");
+        }
+        return true;
+    }
+
+    bool run()
+    {
+        if (this->write) {
+            return this->writeList();
+        }
+        this->readBack->readExplicitListNodeData(this->node);
+        if (this->readBack->value.size() != this->size) {
+            this->error = "Read " + QString::number(this->readBack->value.size()) + " values.";
+            return false;
+        }
+        return true;
+    }
+
+    void tearDown()
+    {
+        delete this->readBack;
+        this->readBack = (ParameterInstance *) 0;
+    }
+
+    void finish()
+    {
+        QFile::remove(workDir.absoluteFilePath(this->values->filename));
+        delete this->values;
+        this->values = (ParameterInstance *) 0;
+        this->node.clear();
+        this->xml.clear();
+    }
+
+private:
+    bool writeList()
+    {
+        this->xml.clear();
+        QXmlStreamWriter xmlOut(&this->xml);
+        this->values->writeExplicitListNodeData(xmlOut);
+        if (!QFileInfo(workDir.absoluteFilePath(this->values->filename)).exists()) {
+            this->error = "The values were not written to a binary file.";
+            return false;
+        }
+        return true;
+    }
+
+    bool write;
+    int size;
+    ParameterInstance * values;
+    ParameterInstance * readBack;
+    QByteArray xml;
+    QDomNode node;
+};
+
+/*!
+ * Reading every row of a binary analog log, and plotting a raster of a
+ * spike log of BENCH_POPULATION_SIZE neurons, as the experiment views do.
+ * The raster starts from a log that has not been indexed yet, as it is for
+ * the first plot after a run.
+ */
+class logBenchmark : public benchmark
+{
+public:
+    logBenchmark(const QString &name, bool raster) :
+        benchmark(name)
+    {
+        this->raster = raster;
+        this->log = (logData *) 0;
+        this->plot = (QCustomPlot *) 0;
+        this->result = 0;
+    }
+
+    bool prepare(int size)
+    {
+        this->xmlFile = workDir.absoluteFilePath(this->raster ? "bench_spike_logrep.xml" : "bench_v_logrep.xml");
+        this->logFile = workDir.absoluteFilePath(this->raster ? "bench_spike_log.csv" : "bench_v_log.bin");
+        double dt = 0.1;
+        QString xml;
+        QXmlStreamWriter xmlOut(&xml);
+        xmlOut.writeStartDocument();
+        xmlOut.writeStartElement("LogReport");
+
+        if (this->raster) {
+            // BENCH_EVENTS_PER_STEP spikes each timestep, in time order
+            int steps = qMax(1, size / BENCH_EVENTS_PER_STEP);
+            QFile f(this->logFile);
+            if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                this->error = "Could not write " + this->logFile;
+                return false;
+            }
+            benchRandom rng(size);
+            QByteArray block;
+            for (int i = 0; i < size; ++i) {
+                int step = (int) (((qint64) i * steps) / size);
+                block += QByteArray::number(step * dt) + "," + QByteArray::number(rng.below(BENCH_POPULATION_SIZE)) + "\n";
+                if (block.size() > (1 << 20)) {
+                    f.write(block);
+                    block.clear();
+                }
+            }
+            f.write(block);
+            f.close();
+
+            xmlOut.writeStartElement("EventLog");
+            xmlOut.writeTextElement("LogFile", QFileInfo(this->logFile).fileName());
+            xmlOut.writeTextElement("LogFileType", "csv");
+            xmlOut.writeTextElement("LogPort", "spike");
+            xmlOut.writeTextElement("LogEndTime", QString::number(steps * dt));
+            xmlOut.writeEmptyElement("LogCol");
+            xmlOut.writeAttribute("heading", "t");
+            xmlOut.writeAttribute("dims", "ms");
+            xmlOut.writeAttribute("type", "double");
+            xmlOut.writeEmptyElement("LogCol");
+            xmlOut.writeAttribute("heading", "index");
+            xmlOut.writeAttribute("dims", "");
+            xmlOut.writeAttribute("type", "int");
+            xmlOut.writeEmptyElement("LogAll");
+            xmlOut.writeAttribute("size", QString::number(BENCH_POPULATION_SIZE));
+            xmlOut.writeEmptyElement("TimeStep");
+            xmlOut.writeAttribute("dt", QString::number(dt));
+            xmlOut.writeEndElement(); // EventLog
+
+            this->indices.clear();
+            for (int i = 0; i < BENCH_POPULATION_SIZE; ++i) {
+                this->indices.push_back(i);
+            }
+            this->items = size;
+        } else {
+            // a row of BENCH_LOG_COLUMNS doubles each timestep
+            this->rows = qMax(1, size / BENCH_LOG_COLUMNS);
+            QFile f(this->logFile);
+            if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                this->error = "Could not write " + this->logFile;
+                return false;
+            }
+            QVector<double> row(BENCH_LOG_COLUMNS);
+            for (int r = 0; r < this->rows; ++r) {
+                for (int c = 0; c < BENCH_LOG_COLUMNS; ++c) {
+                    row[c] = sin(0.01 * r + c);
+                }
+                f.write((const char *) row.constData(), BENCH_LOG_COLUMNS * sizeof(double));
+            }
+            f.close();
+
+            xmlOut.writeStartElement("AnalogLog");
+            xmlOut.writeTextElement("LogFile", QFileInfo(this->logFile).fileName());
+            xmlOut.writeTextElement("LogFileType", "binary");
+            xmlOut.writeTextElement("LogEndTime", QString::number(this->rows * dt));
+            xmlOut.writeEmptyElement("LogAll");
+            xmlOut.writeAttribute("size", QString::number(BENCH_LOG_COLUMNS));
+            xmlOut.writeAttribute("headings", "v");
+            xmlOut.writeAttribute("dims", "mV");
+            xmlOut.writeAttribute("type", "double");
+            xmlOut.writeEmptyElement("TimeStep");
+            xmlOut.writeAttribute("dt", QString::number(dt));
+            xmlOut.writeEndElement(); // AnalogLog
+
+            this->items = (qint64) this->rows * BENCH_LOG_COLUMNS;
+        }
+
+        xmlOut.writeEndElement(); // LogReport
+        xmlOut.writeEndDocument();
+        if (!writeFile(this->xmlFile, xml.toUtf8())) {
+            this->error = "Could not write " + this->xmlFile;
+            return false;
+        }
+
+        if (!this->raster) {
+            // the rows are read from the same log every time
+            return this->openLog();
+        }
+        return true;
+    }
+
+    bool setUp()
+    {
+        if (!this->raster) {
+            return true;
+        }
+        QFile::remove(this->logFile + LOG_EVENT_INDEX_SUFFIX);
+        this->plot = new QCustomPlot;
+        return this->openLog();
+    }
+
+    bool run()
+    {
+        if (this->raster) {
+            if (!this->log->plotRaster(this->plot, (QMdiSubWindow *) 0, this->indices)) {
+                this->error = "plotRaster failed.";
+                return false;
+            }
+            return true;
+        }
+        double sum = 0;
+        for (int r = 0; r < this->rows; ++r) {
+            QVector<double> row = this->log->getRow(r);
+            if (row.size() != BENCH_LOG_COLUMNS) {
+                this->error = "Row " + QString::number(r) + " has " + QString::number(row.size()) + " values.";
+                return false;
+            }
+            sum += row[0];
+        }
+        this->result = sum;
+        return true;
+    }
+
+    void tearDown()
+    {
+        if (this->raster) {
+            delete this->plot;
+            this->plot = (QCustomPlot *) 0;
+            delete this->log;
+            this->log = (logData *) 0;
+        }
+    }
+
+    void finish()
+    {
+        delete this->log;
+        this->log = (logData *) 0;
+        QFile::remove(this->logFile);
+        QFile::remove(this->logFile + LOG_EVENT_INDEX_SUFFIX);
+        QFile::remove(this->xmlFile);
+    }
+
+private:
+    bool openLog()
+    {
+        this->log = new logData;
+        this->log->logFileXMLname = this->xmlFile;
+        if (!this->log->setupFromXML()) {
+            this->error = "Could not read " + this->xmlFile;
+            return false;
+        }
+        return true;
+    }
+
+    bool raster;
+    int rows;
+    QString xmlFile;
+    QString logFile;
+    QList<QVariant> indices;
+    logData * log;
+    QCustomPlot * plot;
+    volatile double result;
+};
+
+/*!
+ * Free a project opened into data, as the benchmarks open them.
+ */
+static void closeProject(nl_rootdata * data, projectObject * project)
+{
+    project->copy_back_data(data);
+    delete project;
+    // populations and projections refer to one another
+    for (int i = 0; i < data->populations.size(); ++i) {
+        QSharedPointer<population> pop = data->populations[i];
+        for (int j = 0; j < pop->projections.size(); ++j) {
+            pop->projections[j]->synapses.clear();
+        }
+        pop->projections.clear();
+        pop->reverseProjections.clear();
+    }
+    data->populations.clear();
+    delete data;
+}
+
+/*!
+ * Saving, and opening again, a project of two populations of
+ * BENCH_POPULATION_SIZE neurons joined by an explicit list of as many
+ * connections as the size, built as the network editor builds it.
+ */
+class projectBenchmark : public benchmark
+{
+public:
+    projectBenchmark(const QString &name, bool save) :
+        benchmark(name)
+    {
+        this->save = save;
+        this->data = (nl_rootdata *) 0;
+        this->project = (projectObject *) 0;
+        this->opened = (projectObject *) 0;
+    }
+
+    bool prepare(int size)
+    {
+        QDir projectDir(workDir.absoluteFilePath("project"));
+        if (!projectDir.mkpath(projectDir.absolutePath())) {
+            this->error = "Could not create " + projectDir.absolutePath();
+            return false;
+        }
+        this->fileName = projectDir.absoluteFilePath("bench.proj");
+
+        // as headlessRunner::openProject, for a new project
+        this->data = new nl_rootdata;
+        this->data->main = (MainWindow *) 0;
+        this->project = new projectObject();
+        this->project->name = "Benchmark";
+        this->data->projects.push_back(this->project);
+        this->project->copy_out_data(this->data);
+        this->data->currProject = this->project;
+
+        QSharedPointer<population> src = this->addPopulation("Source", 0);
+        QSharedPointer<population> dst = this->addPopulation("Destination", 4);
+
+        QSharedPointer<projection> proj = QSharedPointer<projection> (new projection());
+        proj->tag = this->data->getIndex();
+        proj->source = src;
+        proj->destination = dst;
+        proj->start = QPointF(0, 0);
+        bezierCurve curve;
+        curve.C1 = QPointF(1, 1);
+        curve.C2 = QPointF(3, 1);
+        curve.end = QPointF(4, 0);
+        proj->curves.push_back(curve);
+        this->project->undoStack->push(new addProjection(this->data, proj));
+
+        // as updateConnection does on choosing an explicit list
+        QSharedPointer<synapse> syn = proj->synapses.back();
+        connection * oldConn = syn->connectionType;
+        csv_connection * list = new csv_connection;
+        list->setSynapseIndex(oldConn->getSynapseIndex());
+        list->setParent(oldConn->parent);
+        syn->connectionType = list;
+        delete oldConn;
+
+        QVector<conn> conns;
+        makeConnections(size, BENCH_POPULATION_SIZE, BENCH_POPULATION_SIZE, conns);
+        list->setAllData(conns);
+
+        settingsCache::setCurrentFileName(this->fileName);
+        if (!this->save && !this->saveProject()) {
+            return false;
+        }
+
+        this->items = size;
+        return true;
+    }
+
+    bool setUp()
+    {
+        if (!this->save) {
+            this->opened = new projectObject();
+        }
+        return true;
+    }
+
+    bool run()
+    {
+        if (this->save) {
+            return this->saveProject();
+        }
+        if (!this->opened->open_project(this->fileName) || this->opened->errorsShown > 0) {
+            this->error = "Could not open " + this->fileName;
+            return false;
+        }
+        // connection lists are copied into their stores in the background
+        QVector<csv_connection*> conns = this->opened->getExplicitConnections();
+        for (int i = 0; i < conns.size(); ++i) {
+            conns[i]->waitForImport();
+        }
+        if (conns.size() != 1 || conns[0]->getNumRows() != this->items) {
+            this->error = "The connections did not come back from " + this->fileName;
+            return false;
+        }
+        return true;
+    }
+
+    void tearDown()
+    {
+        delete this->opened;
+        this->opened = (projectObject *) 0;
+    }
+
+    void finish()
+    {
+        if (this->data == (nl_rootdata *) 0) {
+            return;
+        }
+        closeProject(this->data, this->project);
+        this->data = (nl_rootdata *) 0;
+        this->project = (projectObject *) 0;
+        removeDirectory(workDir.absoluteFilePath("project"));
+    }
+
+private:
+    QSharedPointer<population> addPopulation(const QString &name, float x)
+    {
+        // as nl_rootdata::addPopulation
+        QSharedPointer<population> pop = QSharedPointer<population> (new population(x, 0, 1.0f, 5.0f/3.0f, name));
+        pop->tag = this->data->getIndex();
+        pop->numNeurons = BENCH_POPULATION_SIZE;
+        pop->layoutType = QSharedPointer<NineMLLayoutData> (new NineMLLayoutData(this->data->catalogLayout[0]));
+        pop->neuronType = QSharedPointer<ComponentInstance> (new ComponentInstance(this->data->catalogNrn[0]));
+        pop->neuronType->owner = pop;
+        this->project->undoStack->push(new addPopulationCmd(this->data, pop));
+        return pop;
+    }
+
+    bool saveProject()
+    {
+        // as MainWindow::save_project
+        settingsCache::setCurrentFileName(this->fileName);
+        if (!this->project->save_project(this->fileName, this->data)) {
+            this->error = "Could not save " + this->fileName;
+            return false;
+        }
+        return true;
+    }
+
+    bool save;
+    QString fileName;
+    nl_rootdata * data;
+    projectObject * project;
+    projectObject * opened;
+};
+
+/*!
+ * Opening, saving, exporting the graph of and laying out a project given
+ * with --project, such as one of the reference models the runs of the
+ * builds are compared on. These are run once each rather than at each
+ * size, and the time per item is the time per neuron.
+ */
+class referenceBenchmark : public benchmark
+{
+public:
+    enum mode {Open, Save, ExportGraph, Layout};
+
+    referenceBenchmark(const QString &fileName, mode type) :
+        benchmark(referenceBenchmark::nameFor(fileName, type))
+    {
+        this->fileName = QFileInfo(fileName).absoluteFilePath();
+        this->type = type;
+        this->sized = false;
+        this->seed = 0;
+        this->data = (nl_rootdata *) 0;
+        this->project = (projectObject *) 0;
+        this->opened = (projectObject *) 0;
+    }
+
+    static QString nameFor(const QString &fileName, mode type)
+    {
+        static const char * names[] = {"open_project", "save_project", "export graph", "generateLayout"};
+        return "reference " + QFileInfo(fileName).completeBaseName() + " " + names[type];
+    }
+
+    bool prepare(int)
+    {
+        QDir outDir(workDir.absoluteFilePath("reference"));
+        if (!outDir.mkpath(outDir.absolutePath())) {
+            this->error = "Could not create " + outDir.absolutePath();
+            return false;
+        }
+        this->outName = outDir.absoluteFilePath(QFileInfo(this->fileName).fileName());
+        if (this->type == ExportGraph) {
+            this->outName = outDir.absoluteFilePath(QFileInfo(this->fileName).completeBaseName() + ".dot");
+        }
+
+        // as headlessRunner::openProject
+        this->project = new projectObject();
+        if (!this->project->open_project(this->fileName) || this->project->errorsShown > 0) {
+            delete this->project;
+            this->project = (projectObject *) 0;
+            this->error = "Could not open " + this->fileName;
+            return false;
+        }
+        this->data = new nl_rootdata;
+        this->data->main = (MainWindow *) 0;
+        this->data->projects.push_back(this->project);
+        this->project->copy_out_data(this->data);
+        this->data->currProject = this->project;
+        settingsCache::setCurrentFileName(this->project->filePath);
+        waitForImports(this->project);
+
+        this->items = 0;
+        for (int i = 0; i < this->data->populations.size(); ++i) {
+            this->items += this->data->populations[i]->numNeurons;
+        }
+        return true;
+    }
+
+    bool setUp()
+    {
+        if (this->type == Open) {
+            this->opened = new projectObject();
+        } else if (this->type == ExportGraph) {
+            // the text of each population would otherwise be kept from the
+            // last repetition
+            networkGraphWriter::clearCache();
+        } else if (this->type == Layout) {
+            // copies with a new seed each time, so that neither the cache
+            // nor the file of the project's own locations is used
+            ++this->seed;
+            this->layouts.clear();
+            for (int i = 0; i < this->data->populations.size(); ++i) {
+                QSharedPointer<population> pop = this->data->populations[i];
+                QSharedPointer<NineMLLayoutData> layout;
+                if (pop->layoutType) {
+                    layout = QSharedPointer<NineMLLayoutData> (new NineMLLayoutData(pop->layoutType));
+                    layout->seed = pop->layoutType->seed + this->seed;
+                }
+                this->layouts.push_back(layout);
+            }
+        }
+        return true;
+    }
+
+    bool run()
+    {
+        if (this->type == Open) {
+            if (!this->opened->open_project(this->fileName) || this->opened->errorsShown > 0) {
+                this->error = "Could not open " + this->fileName;
+                return false;
+            }
+            waitForImports(this->opened);
+            return true;
+        }
+        if (this->type == Save) {
+            // as MainWindow::save_project
+            settingsCache::setCurrentFileName(this->outName);
+            if (!this->project->save_project(this->outName, this->data)) {
+                this->error = "Could not save " + this->outName;
+                return false;
+            }
+            return true;
+        }
+        if (this->type == ExportGraph) {
+            return networkGraphWriter::write(modelSnapshot::take(this->data), this->outName,
+                                             networkGraphWriter::dot, this->error);
+        }
+        for (int i = 0; i < this->layouts.size(); ++i) {
+            if (!this->layouts[i]) {
+                continue;
+            }
+            QVector <loc> locations;
+            QString err;
+            this->layouts[i]->generateLayout(this->data->populations[i]->numNeurons, &locations, err);
+            if (!err.isEmpty()) {
+                this->error = this->data->populations[i]->name + ": " + err;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void tearDown()
+    {
+        delete this->opened;
+        this->opened = (projectObject *) 0;
+        this->layouts.clear();
+    }
+
+    void finish()
+    {
+        if (this->data == (nl_rootdata *) 0) {
+            return;
+        }
+        closeProject(this->data, this->project);
+        this->data = (nl_rootdata *) 0;
+        this->project = (projectObject *) 0;
+        removeDirectory(workDir.absoluteFilePath("reference"));
+    }
+
+private:
+    static void waitForImports(projectObject * project)
+    {
+        // connection lists are copied into their stores in the background
+        QVector<csv_connection*> conns = project->getExplicitConnections();
+        for (int i = 0; i < conns.size(); ++i) {
+            conns[i]->waitForImport();
+        }
+    }
+
+    QString fileName;
+    QString outName;
+    mode type;
+    int seed;
+    nl_rootdata * data;
+    projectObject * project;
+    projectObject * opened;
+    QVector <QSharedPointer<NineMLLayoutData> > layouts;
+};
+
+static void printUsage()
+{
+    std::cout << "Usage: spinecreatorbench [options]\n"
+              << "\n"
+              << "Times the data paths which grow with the size of a model, on synthetic data.\n"
+              << "\n"
+              << "  --sizes <n,n,...>  the sizes to run at (default 1000,100000)\n"
+              << "  --large            add a size of 10000000\n"
+              << "  --repetitions <n>  the times each benchmark is run at each size (default "
+              << BENCH_DEFAULT_REPETITIONS << ")\n"
+              << "  --filter <text>    only run the benchmarks with text in their names\n"
+              << "  --dir <dir>        write the data into dir, and leave it there\n"
+              << "  --list             list the benchmarks\n"
+              << "  --project <file>   also open, save, export the graph of and lay out a given\n"
+              << "                     project, once at its own size (may be given more than once)\n"
+              << "  --json <file>      write the results, and the probe totals if\n"
+              << "                     " << PROFILE_SUMMARY_ENVIRONMENT_VARIABLE << " or " << PROFILE_ENVIRONMENT_VARIABLE << " is set, as JSON\n"
+              << "  --compare <file>   compare the median times with those of a --json file, and\n"
+              << "                     exit with status 3 if any is slower by the threshold\n"
+              << "  --threshold <pc>   the percentage slower which is a regression (default "
+              << BENCH_REGRESSION_PERCENT << ")\n"
+              << std::endl;
+}
+
+static QString padded(const QString &text, int width, bool left = false)
+{
+    return left ? text.leftJustified(width) : text.rightJustified(width);
+}
+
+/*!
+ * The times of one benchmark at one size, as printed and as written by
+ * --json.
+ */
+struct benchResult
+{
+    QString name;
+    int size;
+    qint64 items;
+    bool ok;
+    QString error;
+    double minMs;
+    double medianMs;
+    double perItem;
+};
+
+static QString jsonString(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("\\", "\\\\");
+    escaped.replace("\"", "\\\"");
+    escaped.replace("\n", "\\n");
+    return "\"" + escaped + "\"";
+}
+
+/*!
+ * Write the results, and the totals of the profiling probes if they were
+ * recorded, as JSON for --compare to read back from another build.
+ */
+static bool writeResults(const QString &fileName, const QVector <benchResult> &results, int repetitions)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out << "{\"spinecreatorbench\":" << BENCH_RESULTS_VERSION
+        << ",\n\"qt\":" << jsonString(QT_VERSION_STR)
+        << ",\n\"built\":" << jsonString(QString(__DATE__) + " " + __TIME__)
+        << ",\n\"run\":" << jsonString(QDateTime::currentDateTime().toString(Qt::ISODate))
+        << ",\n\"repetitions\":" << repetitions
+        << ",\n\"results\":[";
+    for (int i = 0; i < results.size(); ++i) {
+        const benchResult &result = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "{\"name\":" << jsonString(result.name) << ",\"size\":" << result.size
+            << ",\"items\":" << result.items << ",\"ok\":" << (result.ok ? "true" : "false");
+        if (result.ok) {
+            out << ",\"min_ms\":" << QString::number(result.minMs, 'f', 3)
+                << ",\"median_ms\":" << QString::number(result.medianMs, 'f', 3)
+                << ",\"ns_per_item\":" << QString::number(result.perItem, 'f', 1);
+        } else {
+            out << ",\"error\":" << jsonString(result.error);
+        }
+        out << "}";
+    }
+    out << "\n]";
+    if (profiler::isRecording()) {
+        out << ",\n\"probes\":" << profiler::summaryJson();
+    }
+    out << "}\n";
+    out.flush();
+
+    return file.error() == QFile::NoError;
+}
+
+/*!
+ * Compare the median times of the results with those of a baseline written
+ * by --json, and those of the probes if both have them. Prints each that is
+ * in both, and returns the number which are more than threshold percent
+ * (and BENCH_REGRESSION_MIN_MS) slower, or -1 if the baseline could not be
+ * read.
+ */
+static int compareResults(const QString &baseline, const QVector <benchResult> &results, double threshold)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QFile file(baseline);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not read the baseline '" << baseline.toStdString() << "'." << std::endl;
+        return -1;
+    }
+    QJsonParseError parseError;
+    QJsonObject base = QJsonDocument::fromJson(file.readAll(), &parseError).object();
+    if (parseError.error != QJsonParseError::NoError || !base.contains("spinecreatorbench")) {
+        std::cerr << "The baseline '" << baseline.toStdString() << "' is not the results of spinecreatorbench." << std::endl;
+        return -1;
+    }
+
+    // name and size of each, to the median time
+    QHash <QString, double> before;
+    QJsonArray baseResults = base.value("results").toArray();
+    for (int i = 0; i < baseResults.size(); ++i) {
+        QJsonObject result = baseResults[i].toObject();
+        if (result.value("ok").toBool()) {
+            before.insert(result.value("name").toString() + "@" + QString::number(result.value("size").toInt()),
+                          result.value("median_ms").toDouble());
+        }
+    }
+    QJsonArray baseProbes = base.value("probes").toArray();
+    for (int i = 0; i < baseProbes.size(); ++i) {
+        QJsonObject probe = baseProbes[i].toObject();
+        before.insert("probe " + probe.value("name").toString(), probe.value("median_ms").toDouble());
+    }
+
+    QVector <QString> names;
+    QVector <double> now;
+    QVector <QString> keys;
+    for (int i = 0; i < results.size(); ++i) {
+        if (results[i].ok) {
+            names.push_back(results[i].name + (results[i].size > 0 ? " " + QString::number(results[i].size) : QString()));
+            keys.push_back(results[i].name + "@" + QString::number(results[i].size));
+            now.push_back(results[i].medianMs);
+        }
+    }
+    if (profiler::isRecording()) {
+        QVector <profileSummary> probes = profiler::summarise(INT_MAX);
+        for (int i = 0; i < probes.size(); ++i) {
+            names.push_back("probe " + probes[i].name);
+            keys.push_back("probe " + probes[i].name);
+            now.push_back(probes[i].medianMs);
+        }
+    }
+
+    std::cout << std::endl << "Median times against " << baseline.toStdString()
+              << " (regressions are " << threshold << "% slower):" << std::endl;
+    int regressions = 0;
+    for (int i = 0; i < keys.size(); ++i) {
+        if (!before.contains(keys[i])) {
+            continue;
+        }
+        double was = before.value(keys[i]);
+        double change = was > 0 ? 100.0 * (now[i] - was) / was : 0;
+        bool regressed = change > threshold && now[i] - was >= BENCH_REGRESSION_MIN_MS;
+        if (regressed) {
+            ++regressions;
+        }
+        std::cout << padded(names[i], 50, true).toStdString()
+                  << padded(QString::number(was, 'f', 3), 12).toStdString()
+                  << padded(QString::number(now[i], 'f', 3), 12).toStdString()
+                  << padded((change >= 0 ? "+" : "") + QString::number(change, 'f', 1) + "%", 10).toStdString()
+                  << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+    std::cout << regressions << " regression" << (regressions == 1 ? "" : "s") << "." << std::endl;
+    return regressions;
+#else
+    Q_UNUSED(results);
+    Q_UNUSED(threshold);
+    std::cerr << "Comparing with the baseline '" << baseline.toStdString() << "' needs Qt 5." << std::endl;
+    return -1;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    // the raster benchmark draws into a QCustomPlot, which needs a
+    // QApplication, but not a display
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+    QApplication a(argc, argv);
+    profiler::initFromEnvironment();
+
+    // settings and connection stores kept apart from the application's
+    QCoreApplication::setOrganizationName("SpineML");
+    QCoreApplication::setOrganizationDomain("sheffield.ac.uk");
+    QCoreApplication::setApplicationName("SpineCreatorBench");
+
+    QVector<int> sizes;
+    int repetitions = BENCH_DEFAULT_REPETITIONS;
+    bool large = false;
+    bool list = false;
+    QString filter;
+    QString dir;
+    QStringList projects;
+    QString jsonFile;
+    QString baseline;
+    double threshold = BENCH_REGRESSION_PERCENT;
+
+    QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        QString arg = args[i];
+        QString value;
+        bool hasValue = false;
+        if (arg.startsWith("--") && arg.contains("=")) {
+            value = arg.mid(arg.indexOf("=") + 1);
+            arg = arg.left(arg.indexOf("="));
+            hasValue = true;
+        }
+
+        if (arg == "--large") {
+            large = true;
+        } else if (arg == "--list") {
+            list = true;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        } else if (arg == "--sizes" || arg == "--repetitions" || arg == "--filter" || arg == "--dir"
+                   || arg == "--project" || arg == "--json" || arg == "--compare" || arg == "--threshold") {
+            if (!hasValue) {
+                if (i + 1 >= args.size()) {
+                    std::cerr << arg.toStdString() << " needs a value." << std::endl;
+                    return 2;
+                }
+                value = args[++i];
+            }
+            bool ok = true;
+            if (arg == "--sizes") {
+                QStringList parts = value.split(",", QString::SkipEmptyParts);
+                for (int j = 0; j < parts.size() && ok; ++j) {
+                    int size = parts[j].toInt(&ok);
+                    ok = ok && size > 0;
+                    sizes.push_back(size);
+                }
+            } else if (arg == "--repetitions") {
+                repetitions = value.toInt(&ok);
+                ok = ok && repetitions > 0;
+            } else if (arg == "--filter") {
+                filter = value;
+            } else if (arg == "--project") {
+                ok = QFileInfo(value).exists();
+                projects << value;
+            } else if (arg == "--json") {
+                jsonFile = value;
+            } else if (arg == "--compare") {
+                baseline = value;
+            } else if (arg == "--threshold") {
+                threshold = value.toDouble(&ok);
+                ok = ok && threshold >= 0;
+            } else {
+                dir = value;
+            }
+            if (!ok) {
+                std::cerr << "Bad value '" << value.toStdString() << "' for " << arg.toStdString() << "." << std::endl;
+                return 2;
+            }
+        } else {
+            std::cerr << "Unknown argument '" << args[i].toStdString() << "'." << std::endl;
+            printUsage();
+            return 2;
+        }
+    }
+    if (sizes.isEmpty()) {
+        sizes << 1000 << 100000;
+    }
+    if (large) {
+        sizes << 10000000;
+    }
+
+    QVector<benchmark *> benchmarks;
+    benchmarks.push_back(new layoutBenchmark("generateLayout", 0.0));
+    benchmarks.push_back(new layoutBenchmark("generateLayout minimumDistance", 1.0));
+    benchmarks.push_back(new mathsBenchmark("interpretMaths", mathsBenchmark::Interpreted));
+    benchmarks.push_back(new mathsBenchmark("compiledMaths::evaluate", mathsBenchmark::Compiled));
+    benchmarks.push_back(new mathsBenchmark("compiledMaths::evaluateBlock", mathsBenchmark::Blocked));
+    benchmarks.push_back(new connectionBenchmark("csv_connection::getAllData", connectionBenchmark::GetAllData));
+    benchmarks.push_back(new connectionBenchmark("csv_connection::getData", connectionBenchmark::GetData));
+    benchmarks.push_back(new connectionBenchmark("csv_connection::import_packed_binary", connectionBenchmark::ImportPackedBinary));
+    benchmarks.push_back(new explicitListBenchmark("ParameterInstance write explicit list", true));
+    benchmarks.push_back(new explicitListBenchmark("ParameterInstance read explicit list", false));
+    benchmarks.push_back(new logBenchmark("logData::getRow", false));
+    benchmarks.push_back(new logBenchmark("logData::plotRaster", true));
+    benchmarks.push_back(new projectBenchmark("projectObject::save_project", true));
+    benchmarks.push_back(new projectBenchmark("projectObject::open_project", false));
+    for (int i = 0; i < projects.size(); ++i) {
+        benchmarks.push_back(new referenceBenchmark(projects[i], referenceBenchmark::Open));
+        benchmarks.push_back(new referenceBenchmark(projects[i], referenceBenchmark::Save));
+        benchmarks.push_back(new referenceBenchmark(projects[i], referenceBenchmark::ExportGraph));
+        benchmarks.push_back(new referenceBenchmark(projects[i], referenceBenchmark::Layout));
+    }
+
+    if (list) {
+        for (int i = 0; i < benchmarks.size(); ++i) {
+            std::cout << benchmarks[i]->name.toStdString() << std::endl;
+        }
+        qDeleteAll(benchmarks);
+        return 0;
+    }
+
+    bool keep = !dir.isEmpty();
+    if (!keep) {
+        dir = QDir::temp().absoluteFilePath("spinecreatorbench-" + QString::number(QCoreApplication::applicationPid()));
+    }
+    if (!QDir().mkpath(dir)) {
+        std::cerr << "Could not create the directory '" << dir.toStdString() << "'." << std::endl;
+        return 1;
+    }
+    workDir = QDir(QFileInfo(dir).absoluteFilePath());
+
+    // explicit lists this long go into binary files, as they do by default
+    {
+        QSettings settings;
+        settings.setValue("fileOptions/saveBinaryConnections", QString::number(1.0f));
+        settingsCache::invalidate();
+    }
+
+    std::cout << padded("benchmark", 40, true).toStdString() << padded("size", 10).toStdString()
+              << padded("min ms", 12).toStdString() << padded("median ms", 12).toStdString()
+              << padded("ns/item", 12).toStdString() << std::endl;
+
+    bool allOk = true;
+    QVector <benchResult> results;
+    for (int b = 0; b < benchmarks.size(); ++b) {
+        benchmark * bench = benchmarks[b];
+        if (!filter.isEmpty() && !bench->name.contains(filter, Qt::CaseInsensitive)) {
+            continue;
+        }
+        for (int s = 0; s < (bench->sized ? sizes.size() : 1); ++s) {
+            int size = bench->sized ? sizes[s] : 0;
+            bench->error.clear();
+            bool ok = bench->prepare(size);
+            QVector<qint64> times;
+            for (int r = 0; r < repetitions && ok; ++r) {
+                ok = bench->setUp();
+                if (ok) {
+                    QElapsedTimer timer;
+                    timer.start();
+                    ok = bench->run();
+                    times.push_back(timer.nsecsElapsed());
+                }
+                bench->tearDown();
+            }
+            bench->finish();
+
+            benchResult result;
+            result.name = bench->name;
+            result.size = size;
+            result.items = bench->items;
+            result.ok = ok;
+            result.error = bench->error;
+            result.minMs = result.medianMs = result.perItem = 0;
+
+            std::cout << padded(bench->name, 40, true).toStdString()
+                      << padded(bench->sized ? QString::number(size) : QString("-"), 10).toStdString();
+            if (!ok) {
+                std::cout << "  failed: " << bench->error.toStdString() << std::endl;
+                allOk = false;
+                results.push_back(result);
+                continue;
+            }
+            std::sort(times.begin(), times.end());
+            double minMs = times.front() / 1e6;
+            double medianMs = times[times.size() / 2] / 1e6;
+            double perItem = bench->items > 0 ? (double) times[times.size() / 2] / bench->items : 0;
+            std::cout << padded(QString::number(minMs, 'f', 3), 12).toStdString()
+                      << padded(QString::number(medianMs, 'f', 3), 12).toStdString()
+                      << padded(QString::number(perItem, 'f', 1), 12).toStdString() << std::endl;
+            result.minMs = minMs;
+            result.medianMs = medianMs;
+            result.perItem = perItem;
+            results.push_back(result);
+        }
+    }
+    qDeleteAll(benchmarks);
+
+    if (!jsonFile.isEmpty() && !writeResults(jsonFile, results, repetitions)) {
+        std::cerr << "Could not write the results to '" << jsonFile.toStdString() << "'." << std::endl;
+        allOk = false;
+    }
+    int regressions = 0;
+    if (!baseline.isEmpty()) {
+        regressions = compareResults(baseline, results, threshold);
+        if (regressions < 0) {
+            allOk = false;
+        }
+    }
+
+    if (!keep) {
+        removeDirectory(workDir.absolutePath());
+    }
+    // the connection stores of this program's own data directory
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    removeDirectory(QDesktopServices::storageLocation(QDesktopServices::DataLocation));
+#else
+    removeDirectory(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+#endif
+
+    profiler::writeFromEnvironment();
+    if (!allOk) {
+        return 1;
+    }
+    return regressions > 0 ? 3 : 0;
+}
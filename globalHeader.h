@@ -97,6 +97,10 @@ class projectObject;
 #define DBG() qDebug() << __FUNCTION__ << ": "
 #define DBGBRK() qDebug() << "---";
 
+// rows added at a time to the table models of long lists, as the view
+// scrolls down to them (see QAbstractItemModel::fetchMore)
+#define LIST_MODEL_PAGE_ROWS 65536
+
 /*!
  * Colour definitions used in projection::draw and elsewhere. These
  * were chosen using Hue/Saturation/Lightness/Alpha with Saturation
@@ -176,6 +180,50 @@ struct conn {
                    // structure in a float weight attribute.
 };
 
+/*!
+ * Struct-of-arrays form of an explicit connection list, as filled by
+ * the bulk csv_connection::getAllData/setAllData overloads. delay is
+ * empty if the connection list has no per-connection delays.
+ */
+struct connArrays {
+    QVector<qint32> src;
+    QVector<qint32> dst;
+    QVector<float> delay;
+};
+
+/*!
+ * \brief The connectionAdjacency class indexes a list of connections by
+ * source (compressed sparse row) and by destination (compressed sparse
+ * column), so the connections of one neuron are found in time proportional
+ * to its degree rather than by scanning the whole list. The index holds
+ * positions in the list it was built from.
+ */
+class connectionAdjacency
+{
+public:
+    void build(const QVector <conn> &conns);
+    void build(const connArrays &arrays);
+    void clear();
+    bool isEmpty() const {return outStart.isEmpty();}
+    // the memory held by the index
+    qint64 bytes() const {return (qint64)(outStart.size() + outConns.size() + inStart.size() + inConns.size()) * sizeof(int);}
+    int outDegree(int src) const;
+    int inDegree(int dst) const;
+    // the positions of the connections from src, or to dst, and how many
+    const int * outgoing(int src, int &count) const;
+    const int * incoming(int dst, int &count) const;
+    // raw copies of the index, for keeping alongside a connection list
+    bool read(QIODevice &in);
+    bool write(QIODevice &out) const;
+
+private:
+    void build(const int * src, const int * dst, int stride, int n);
+    QVector <int> outStart;
+    QVector <int> outConns;
+    QVector <int> inStart;
+    QVector <int> inConns;
+};
+
 // Used to store the cursor position in the network view
 struct cursorType {
     GLfloat x;
@@ -24,6 +24,8 @@
 
 #include <QApplication>
 #include "mainwindow.h"
+#include "SC_headless.h"
+#include "SC_profiler.h"
 
 // A global for a fixed qhash, which should work between machines. See:
 // http://stackoverflow.com/questions/27378143/qt-5-produce-random-attribute-order-in-xml
@@ -38,6 +40,16 @@ int main(int argc, char *argv[])
     qt_qhash_seed.store(12345);
 #endif
 
+    profiler::initFromEnvironment();
+
+    // batch jobs, from the command line without a display
+    if (headlessRunner::isRequested(argc, argv)) {
+        QCoreApplication a(argc, argv);
+        headlessRunner runner;
+        int status = runner.exec();
+        profiler::writeFromEnvironment();
+        return status;
+    }
 
     QApplication a(argc, argv);
     a.setAttribute(Qt::AA_DontCreateNativeWidgetSiblings, true);
@@ -51,5 +63,7 @@ int main(int argc, char *argv[])
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps,true);
 #endif
 
-    return a.exec();
+    int status = a.exec();
+    profiler::writeFromEnvironment();
+    return status;
 }
@@ -22,14 +22,6 @@
 **  Website/Contact: http://bimpa.group.shef.ac.uk/                       **
 ****************************************************************************/
 
-#ifdef _DEBUG
-  #undef _DEBUG
-  #include <Python.h>
-  #define _DEBUG
-#else
-  #include <Python.h>
-#endif
-
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "SC_settings.h"
@@ -46,6 +38,10 @@
 #include "SC_versioncontrol.h"
 #include "qcustomplot.h"
 #include "SC_projectobject.h"
+#include "SC_utilities.h"
+#include "SC_profiler.h"
+#include "SC_autosave.h"
+#include "SC_ioservice.h"
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
 #include <QStandardPaths>
 #endif
@@ -63,7 +59,6 @@
 #include "qdebug.h"
 #include "SC_aboutdialog.h"
 
-
 MainWindow::
 MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -81,95 +76,9 @@ MainWindow(QWidget *parent) :
     // initialise GUI
     ui->setupUi(this);
 
-#define PYTHON_NO_DEBUG
-#ifdef PYTHON_NO_DEBUG
-
-    // Initialise Python. To run numba cuda code, it's going to be
-    // necessary to set this up with a user-specifiable path to python
-    // and/or modules.
-    //
-    {
-        QSettings pysettings;
-
-        // Check the python/initialisation setting. If it's "true",
-        // then Py_Initialise() must have failed, in which case reset
-        // the python settings for programname and pythonhome to empty
-        // values.
-        QString python_init = pysettings.value ("python/initialisation", "false").toString();
-
-        if (python_init == "true") {
-            // then Py_Initialise failed
-            pysettings.setValue ("python/programname", "");
-            pysettings.setValue ("python/pythonhome", "");
-            DBG() << "Reset python path/home settings as Py_Initialise crashed.";
-
-        } else {
-            // Py_Initialise was ok last time
-            QString py_programname = pysettings.value("python/programname","").toString();
-
-#if PY_MAJOR_VERSION == 2
-            // Python 2.x API requires chars when calling
-            // Py_SetProgramName() etc, Python 3.x requires wchars.
-            char* py_programname_ca;
-            py_programname_ca = new char[py_programname.length() + 1];
-            memcpy (py_programname_ca, py_programname.toStdString().c_str(), py_programname.length());
-#elif PY_MAJOR_VERSION > 2
-            wchar_t* py_programname_ca;
-            py_programname_ca = new wchar_t[py_programname.length() + 1];
-            py_programname.toWCharArray (py_programname_ca);
-#endif
-            py_programname_ca[py_programname.length()] = 0;
-            if (!py_programname.isEmpty()) {
-                // When using Anaconda, set to /home/seb/anaconda3/bin/python
-                Py_SetProgramName (py_programname_ca);
-                DBG() << "Setting user-specified path to the python binary. Warning: SpineCreator may crash if this setting causes Py_Initialise() to fail. In this case, when SpineCreator re-starts it will erase the content of python path and home.";
-            }
-            delete py_programname_ca;
-
-            QString py_pythonhome = pysettings.value("python/pythonhome","").toString();
-#if PY_MAJOR_VERSION == 2
-            char* py_pythonhome_ca;
-            py_pythonhome_ca = new char[py_pythonhome.length() + 1];
-            memcpy (py_pythonhome_ca, py_pythonhome.toStdString().c_str(), py_pythonhome.length());
-#elif PY_MAJOR_VERSION >= 3
-            wchar_t* py_pythonhome_ca;
-            py_pythonhome_ca = new wchar_t[py_pythonhome.length() + 1];
-            py_pythonhome.toWCharArray (py_pythonhome_ca);
-#endif
-            py_pythonhome_ca[py_pythonhome.length()] = 0;
-
-            if (!py_pythonhome.isEmpty()) {
-                // Seb's value for pythonhome to use Anaconda in home
-                // directory with Numba CUDA:
-                // /home/seb/anaconda3:/home/seb/anaconda3/bin:/home/seb/anaconda3/lib:/home/seb/anaconda3/lib/python3.7:/home/seb/anaconda3/lib/python3.7/lib-dynload:/home/seb/anaconda3/lib/python3.7/site-packages:/home/seb/anaconda3/lib/python3.7/site-packages/numba:/home/seb/anaconda3/lib/python3.7/site-packages/numba/cuda
-                // NB: If python home is set to garbage, it will cause
-                // Py_Initialize() to abort the program. Hence the
-                // python_init scheme to check and see if we've
-                // initialised and crashed on a previous attempt.
-                Py_SetPythonHome(py_pythonhome_ca);
-                DBG() << "Setting user-specified PYTHONHOME. Warning: SpineCreator may crash if this setting causes Py_Initialise() to fail. In this case, when SpineCreator re-starts it will erase the content of python path and home.";
-            }
-            delete py_pythonhome_ca;
-        }
-
-        pysettings.setValue ("python/initialisation", "true");
-    } // ensure pysettings goes out of scope before Py_Initialize()
-
-    Py_Initialize();
-
-    { // New scope to reset python/initialisation to "false"
-        QSettings pysettings2;
-        pysettings2.setValue ("python/initialisation", "false");
-    }
-#endif
-
-#ifdef DEBUG
-    DBG() << "Python interpreter: " << (wchar_t*)Py_GetProgramName();
-    DBG() << "Py_GetPrefix(): " << (wchar_t*)Py_GetPrefix();
-    DBG() << "Py_GetExecPrefix(): " << (wchar_t*)Py_GetExecPrefix();
-    DBG() << "Py_GetPath(): " << (wchar_t*)Py_GetPath();
-    DBG() << "Py_GetProgramFullPath(): " << (wchar_t*)Py_GetProgramFullPath();
-#endif
+    // Python is started when a connectivity script first needs it
+    // (SCUtilities::initPython), so that projects without them do not
+    // wait for the interpreter to load
 
     QSettings settings;
 
@@ -186,6 +95,7 @@ MainWindow(QWidget *parent) :
 #if QT_VERSION > QT_VERSION_CHECK(5, 0, 0)
   #ifdef Q_OS_MAC2
    settings.setValue("dpi",this->windowHandle()->devicePixelRatio());
+   settingsCache::invalidate();
   #endif
 #endif
 
@@ -319,6 +229,7 @@ MainWindow(QWidget *parent) :
     if (settings.value("glOptions/detail", -30).toInt() == -30) {
         settings.setValue("glOptions/detail", 5);
     }
+    settingsCache::invalidate();
 
     // setup undo / redo
     undoStacks = new QUndoGroup(this);
@@ -333,6 +244,9 @@ MainWindow(QWidget *parent) :
     ui->menuEdit->addAction(redoAction);
 
     projectObject * newProject = new projectObject();
+    connect(newProject, SIGNAL(saveProgress(QString,int)), this, SLOT(projectProgress(QString,int)));
+    connect(newProject, SIGNAL(loadProgress(QString,int)), this, SLOT(projectProgress(QString,int)));
+    connect(&newProject->version, SIGNAL(versionChanged()), this, SLOT(configureVCSMenu()));
 
     data.currProject = newProject;
     data.projects.push_back(newProject);
@@ -341,6 +255,8 @@ MainWindow(QWidget *parent) :
     undoStacks->setActiveStack(newProject->undoStack);
 
     connect(undoStacks, SIGNAL(indexChanged(int)), this, SLOT(undoOrRedoPerformed(int)));
+    // any undoable change may alter the drawn model
+    connect(undoStacks, SIGNAL(indexChanged(int)), &(data), SLOT(sceneChanged()));
     connect(undoStacks, SIGNAL(cleanChanged(bool)), this, SLOT(updateTitle()));
 
     // Configure two QActions which will be presented in the Experiment menu.
@@ -355,8 +271,9 @@ MainWindow(QWidget *parent) :
     // EXPERIMENT EDITOR initialisation
     initViewEL();
 
-    // The empty graph view used when there is no open experiment for a project
-    this->initEmptyGV();
+    // The empty graph view used when there is no open experiment for a
+    // project is made when the graph view is first shown
+    this->emptyGV.subWin = (QMainWindow*)0;
 
     // NETWORK LAYER initialisation (there isn't much!)
     ui->butB->setEnabled(false);
@@ -478,11 +395,6 @@ MainWindow(QWidget *parent) :
     QObject::connect(ui->tab3, SIGNAL(clicked()), this, SLOT(viewCLshow()));
     QObject::connect(ui->tab4, SIGNAL(clicked()), this, SLOT(viewGVshow()));
 
-    // for animation
-    QTimer *timer = new QTimer( this );
-    // this creates a Qt timer event
-    connect( timer, SIGNAL(timeout()), ui->viewport, SLOT(animate()) );
-
     QObject::connect(&(data), SIGNAL(updatePanel(nl_rootdata*)), layoutRoot, SLOT(updatePanel(nl_rootdata*)));
     QObject::connect(&(data), SIGNAL(updatePanel(nl_rootdata*)), this, SLOT(updateNetworkButtons(nl_rootdata*)));
     QObject::connect(this, SIGNAL(updatePanel(nl_rootdata*)), layoutRoot, SLOT(updatePanel(nl_rootdata*)));
@@ -490,14 +402,14 @@ MainWindow(QWidget *parent) :
     QObject::connect(layoutRoot, SIGNAL(setCaption(QString)), &(data), SLOT(setModelTitle(QString)));
     QObject::connect(&(data), SIGNAL(statusBarUpdate(QString, int)), ui->statusBar, SLOT(showMessage(QString, int)));
     QObject::connect(this, SIGNAL(statusBarUpdate(QString, int)), ui->statusBar, SLOT(showMessage(QString, int)));
+    // file errors from loops and other threads, which do not stop for the user
+    QObject::connect(ioService::instance(), SIGNAL(errorReported(QString, int)), ui->statusBar, SLOT(showMessage(QString, int)));
 
     // add the library to the component file list
     addComponentsToFileList();
 
     this->createActions();
 
-    timer->start(30);
-
     // force nice startup
     // Construct the menus
     ui->menuBar->clear();
@@ -524,7 +436,7 @@ MainWindow(QWidget *parent) :
     updateTitle();
 
     // redraw
-    this->ui->viewport->changed = 1;
+    this->ui->viewport->scheduleRedraw(1);
     QApplication::processEvents( QEventLoop::ExcludeUserInputEvents );
     layoutRoot->updatePanel(&data);
     data.setCaptionOut("Untitled Project");
@@ -538,6 +450,10 @@ MainWindow(QWidget *parent) :
     // for now
     ui->actionE_xport_network->setEnabled(false);
 
+    // journal unsaved changes, and offer back any left by a crash
+    this->autosave = new autosaver(&data, this);
+    QTimer::singleShot(0, this, SLOT(offerRecovery()));
+
 #ifdef Q_OS_MAC111
     fix.setSingleShot(true);
     connect(&fix, SIGNAL(timeout()), this, SLOT(osxHack()));
@@ -830,6 +746,9 @@ void MainWindow::closeEvent(QCloseEvent * event)
     if (this->viewVZ.OpenGLWidget != NULL) {
         this->viewVZ.OpenGLWidget->clear();
     }
+    // closing cleanly, so there is nothing to recover
+    this->autosave->discardAll();
+
     // disconnect the undo signal
     undoStacks->disconnect();
     //data.undoStack->clear();
@@ -871,7 +790,10 @@ MainWindow::~MainWindow()
 
     settings.setValue("mainwindow/size", size());
     settings.setValue("mainwindow/pos", pos());
-    settings.remove("files/currentFileName");
+    settingsCache::removeCurrentFileName();
+
+    // let any journal being written finish while the model is still here
+    delete this->autosave;
 
     // start investigating the library
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
@@ -910,7 +832,7 @@ MainWindow::~MainWindow()
     }
 
     // clear up python
-    Py_Finalize();
+    SCUtilities::finalizePython();
 
     // Ensure viewELhandler's destructor is called to clean up temporary model directory
     delete this->viewELhandler;
@@ -969,6 +891,7 @@ void MainWindow::setupViewGV (viewGVstruct* vgv)
 
     // add the properties editor
     vgv->properties = new viewGVpropertieslayout(vgv);
+    connect(vgv->properties, SIGNAL(logsLoaded()), this, SLOT(viewGVlogsLoaded()));
     vgv->dock->setWidget(vgv->properties); // the properties should be
                                            // parented to the dock, so
                                            // when the QDockWidget is
@@ -1485,6 +1408,8 @@ void MainWindow::fileListItemChanged(QListWidgetItem * current, QListWidgetItem
         viewCL.root->alPtr = selectedComponent;
         // add undo to undoGroup
         this->undoStacks->addStack(&selectedComponent->undoStack);
+        connect(&selectedComponent->undoStack, SIGNAL(cleanChanged(bool)),
+                data.currProject, SLOT(markChanged()), Qt::UniqueConnection);
         this->undoStacks->setActiveStack(&selectedComponent->undoStack);
     //}
 
@@ -1597,6 +1522,62 @@ void MainWindow::undoOrRedoPerformed(int)
     updateTitle();
 }
 
+void MainWindow::projectProgress(QString msg, int percent)
+{
+    ui->statusBar->showMessage(msg + " (" + QString::number(percent) + "%)", 2000);
+    // paint just the status bar: running the event loop here would let the
+    // autosaver, the 3D view's timers and queued results act on a project
+    // which is half saved or loaded
+    ui->statusBar->repaint();
+}
+
+void MainWindow::offerRecovery()
+{
+    QVector <recoveryJournal> journals = autosaver::findJournals();
+    for (int i = 0; i < journals.size(); ++i) {
+        const recoveryJournal &journal = journals[i];
+        if (!QFileInfo(journal.projectFile).exists()) {
+            // nothing to recover into
+            this->autosave->discard(journal.projectFile);
+            continue;
+        }
+
+        QMessageBox msgBox(this);
+        msgBox.setWindowTitle("Recover unsaved changes");
+        msgBox.setText("SpineCreator did not close cleanly while the project '" + journal.projectName
+                       + "' had unsaved changes. Recover the changes written at "
+                       + journal.written.toString(Qt::SystemLocaleShortDate) + "?");
+        if (!journal.commands.isEmpty()) {
+            msgBox.setDetailedText("Changes made since the project was saved:\n" + journal.commands.join("\n"));
+        }
+        msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+        msgBox.setDefaultButton(QMessageBox::Yes);
+        if (msgBox.exec() != QMessageBox::Yes) {
+            this->autosave->discard(journal.projectFile);
+            continue;
+        }
+
+        this->import_project(journal.projectFile);
+        if (QFileInfo(data.currProject->filePath) != QFileInfo(journal.projectFile)) {
+            // the project did not open; keep the journal for another try
+            continue;
+        }
+        QString error;
+        if (!autosaver::recover(journal, &data, error) || !error.isEmpty()) {
+            QMessageBox::warning(this, "Recover unsaved changes", error);
+        } else {
+            QMessageBox::information(this, "Recover unsaved changes",
+                                     "The property values and connectivity have been recovered. Populations, projections "
+                                     "and inputs added, removed or renamed since the project was saved need to be made again.");
+        }
+        this->autosave->discard(journal.projectFile);
+
+        this->updateTitle();
+        viewNL.layout->updatePanel(&data);
+        this->ui->viewport->scheduleRedraw(1);
+    }
+}
+
 // the actions for the menu
 void MainWindow::createActions()
 {
@@ -1629,6 +1610,8 @@ void MainWindow::createActions()
     // actionRun_experiment is connected up when it is available.
 
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(about()));
+    connect(ui->actionProfiler_overlay, SIGNAL(toggled(bool)), this, SLOT(actionProfilerOverlay_toggled(bool)));
+    connect(ui->actionExport_profile, SIGNAL(triggered()), this, SLOT(actionExportProfile_triggered()));
 
     connect(ui->action_Copy_objects, SIGNAL(triggered()), &data, SLOT(copySelectionToClipboard()));
     connect(ui->actionPaste_objects, SIGNAL(triggered()), &data, SLOT(pasteSelectionFromClipboard()));
@@ -1642,6 +1625,9 @@ void MainWindow::new_project()
 
     // create new project
     projectObject * newProject = new projectObject();
+    connect(newProject, SIGNAL(saveProgress(QString,int)), this, SLOT(projectProgress(QString,int)));
+    connect(newProject, SIGNAL(loadProgress(QString,int)), this, SLOT(projectProgress(QString,int)));
+    connect(&newProject->version, SIGNAL(versionChanged()), this, SLOT(configureVCSMenu()));
 
     newProject->name = "Untitled Project";
 
@@ -1658,7 +1644,7 @@ void MainWindow::new_project()
     emit updatePanel(&data);
 
     // redraw
-    this->ui->viewport->changed = 1;
+    this->ui->viewport->scheduleRedraw(1);
 
     data.cursor.x = 0;
     data.cursor.y = 0;
@@ -1726,6 +1712,9 @@ void MainWindow::import_project(const QString& filePath)
     }
 
     projectObject * newProject = new projectObject();
+    connect(newProject, SIGNAL(saveProgress(QString,int)), this, SLOT(projectProgress(QString,int)));
+    connect(newProject, SIGNAL(loadProgress(QString,int)), this, SLOT(projectProgress(QString,int)));
+    connect(&newProject->version, SIGNAL(versionChanged()), this, SLOT(configureVCSMenu()));
 
     if (newProject->open_project(filePath)) {
 
@@ -1753,7 +1742,7 @@ void MainWindow::import_project(const QString& filePath)
     }
 
     // redraw
-    this->ui->viewport->changed = 1;
+    this->ui->viewport->scheduleRedraw(1);
     configureVCSMenu();
 
     updateNetworkButtons(&data);
@@ -1830,9 +1819,13 @@ void MainWindow::export_project(const QString& filePath)
 #endif
 
     QDir project_dir(filePath);
-    QSettings settings;
-    settings.setValue("files/currentFileName", project_dir.absolutePath());
-    this->data.currProject->save_project(filePath, &this->data);
+    settingsCache::setCurrentFileName(project_dir.absolutePath());
+    QString previousFilePath = this->data.currProject->filePath;
+    if (this->data.currProject->save_project(filePath, &this->data)) {
+        // the journal of a project saved as another is done with too
+        this->autosave->discard(previousFilePath);
+        this->autosave->discard(this->data.currProject->filePath);
+    }
 
     // Clean up the component undostack (the project itself doesn't
     // have access to this as far as I can see (Seb).
@@ -1927,6 +1920,9 @@ void MainWindow::close_project()
             }
             DBG() << "After cleanup, viewGV has size " << this->viewGV.size();
 
+            // its unsaved changes were saved or turned down
+            this->autosave->discard(data.projects[i]->filePath);
+
             // now delete the project. First delete the thing pointed
             // to by the pointer in the QVector<projectObject*>
             // data.projects:
@@ -1982,7 +1978,7 @@ void MainWindow::import_network()
             viewVZ.OpenGLWidget->clear();
         }
         // redraw
-        this->ui->viewport->changed = 1;
+        this->ui->viewport->scheduleRedraw(1);
         configureVCSMenu();
         updateNetworkButtons(&data);
         this->setProjectMenu();
@@ -2156,15 +2152,11 @@ void MainWindow::export_component()
         return;
     }
 
-    // get the 9ML description
-    QDomDocument * doc = new QDomDocument( "SpineML" );
-    viewCL.root->al->write(doc);
-
-    // write out to files
-    QTextStream stream( &file );
-    stream << doc->toString();
-    delete doc;
-    doc = NULL;
+    // stream the 9ML description out to the file
+    QXmlStreamWriter xmlOut;
+    xmlOut.setAutoFormatting(true);
+    xmlOut.setDevice(&file);
+    viewCL.root->al->write(xmlOut);
 
     updateTitle(false);
 }
@@ -2262,15 +2254,11 @@ void MainWindow::export_layout()
         return;
     }
 
-    // get the 9ML description
-    QDomDocument * doc = new QDomDocument( "SpineML" );
-    data.catalogLayout[index]->write(doc);
-
-    // write out to files
-    QTextStream stream( &file );
-    stream << doc->toString();
-    delete doc;
-    doc = NULL;
+    // stream the 9ML description out to the file
+    QXmlStreamWriter xmlOut;
+    xmlOut.setAutoFormatting(true);
+    xmlOut.setDevice(&file);
+    data.catalogLayout[index]->write(xmlOut);
 }
 
 
@@ -2307,7 +2295,7 @@ bool MainWindow::viewGVvisible (void)
         ++vgvi;
     }
 
-    if (this->emptyGV.subWin->isVisible() == true) {
+    if (this->emptyGV.subWin != (QMainWindow*)0 && this->emptyGV.subWin->isVisible() == true) {
         rtn = true;
     }
 
@@ -2326,6 +2314,18 @@ void MainWindow::viewGVreshow (void)
     }
 }
 
+void MainWindow::viewGVlogsLoaded()
+{
+    experiment* e = this->getCurrentExpt();
+    if (e == (experiment*)0 || this->viewVZ.OpenGLWidget == NULL || !this->existsViewGV(e)) {
+        return;
+    }
+    viewGVpropertieslayout* properties = this->viewGV[e]->properties;
+    if (properties == sender()) {
+        this->viewVZ.OpenGLWidget->addLogs(&properties->vLogData);
+    }
+}
+
 void MainWindow::viewGVshow()
 {
     DBG() << "called";
@@ -2388,6 +2388,9 @@ void MainWindow::viewGVshow()
     } else {
         // Do a standard, empty setup?
         DBG() << "make graph area look empty in a nice way.";
+        if (this->emptyGV.subWin == (QMainWindow*)0) {
+            this->initEmptyGV();
+        }
         this->emptyGV.subWin->show();
     }
 
@@ -2466,7 +2469,9 @@ void MainWindow::hideViewGV (void)
         ++vgvi;
     }
     // Hide the emptyViewGV also:
-    this->emptyGV.subWin->hide();
+    if (this->emptyGV.subWin != (QMainWindow*)0) {
+        this->emptyGV.subWin->hide();
+    }
 }
 
 void MainWindow::viewNLshow()
@@ -2526,7 +2531,7 @@ void MainWindow::viewNLshow()
     this->undoStacks->setActiveStack(data.currProject->undoStack);
 
     // redraw
-    this->ui->viewport->changed = 1;
+    this->ui->viewport->scheduleRedraw(1);
     QApplication::processEvents( QEventLoop::ExcludeUserInputEvents );
 }
 
@@ -2571,20 +2576,10 @@ void MainWindow::viewVZshow()
     // clear away old stuff
     this->viewVZ.currObject = (QSharedPointer<systemObject>)0;
     this->viewVZhandler->clearAll();
-    this->viewVZ.OpenGLWidget->clear();
+    this->viewVZ.OpenGLWidget->resetSelection();
 
     // configure TreeView
-    if (!(viewVZ.sysModel == NULL)) {
-        delete viewVZ.sysModel;
-    }
-    viewVZ.sysModel = new systemmodel(&data);
-    viewVZ.treeView->setModel(viewVZ.sysModel);
-    // connect for function
-    connect(viewVZ.treeView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), viewVZhandler, SLOT(selectionChanged(QItemSelection,QItemSelection)));
-    connect(viewVZ.treeView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this->viewVZ.OpenGLWidget, SLOT(selectionChanged(QItemSelection,QItemSelection)));
-
-
-    connect(viewVZ.sysModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this->viewVZ.OpenGLWidget, SLOT(sysSelectionChanged(QModelIndex,QModelIndex)));
+    configureSystemModel();
 
     // ok, there are three possibilities. Current base selection is a population, or a projection, or nothing is selected / there is nothing to select
 
@@ -2619,6 +2614,26 @@ void MainWindow::viewVZshow()
 #endif
 }
 
+void MainWindow::configureSystemModel()
+{
+    if (viewVZ.sysModel != NULL && viewVZ.sysModel->dataPtr == &data) {
+        // the selected object's panel has been cleared
+        viewVZ.treeView->selectionModel()->clearSelection();
+        viewVZ.sysModel->update();
+        return;
+    }
+
+    if (!(viewVZ.sysModel == NULL)) {
+        delete viewVZ.sysModel;
+    }
+    viewVZ.sysModel = new systemmodel(&data);
+    viewVZ.treeView->setModel(viewVZ.sysModel);
+    // connect for function
+    connect(viewVZ.treeView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), viewVZhandler, SLOT(selectionChanged(QItemSelection,QItemSelection)));
+    connect(viewVZ.treeView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this->viewVZ.OpenGLWidget, SLOT(selectionChanged(QItemSelection,QItemSelection)));
+    connect(viewVZ.sysModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this->viewVZ.OpenGLWidget, SLOT(sysSelectionChanged(QModelIndex,QModelIndex)));
+}
+
 void MainWindow::viewCLshow()
 {
     // reset all view buttons to 'inactive' look
@@ -2836,7 +2851,7 @@ void MainWindow::actionDeleteItems_triggered()
     }
 
     experiment* e = this->getCurrentExpt();
-    if (e != (experiment*)0) {
+    if (this->existsViewGV(e)) {
         if (this->viewGV[e]->subWin->isVisible()) {
             this->viewGV[e]->properties->deleteCurrentLog();
         }
@@ -3136,6 +3151,8 @@ void MainWindow::actionNew_triggered()
     data.catalogNrn.back()-> name = "New Component " + QString::number(float(val));
     initialiseModel(data.catalogNrn.back());
     viewCL.root->alPtr = data.catalogNrn.back();
+    connect(&data.catalogNrn.back()->undoStack, SIGNAL(cleanChanged(bool)),
+            data.currProject, SLOT(markChanged()), Qt::UniqueConnection);
 
     // redraw the file list
     viewCL.fileList->disconnect();
@@ -3232,6 +3249,29 @@ void MainWindow::about()
     win.exec();
 }
 
+void MainWindow::actionProfilerOverlay_toggled(bool show)
+{
+    profiler::setOverlayShown(show);
+    if (viewVZ.OpenGLWidget != NULL) {
+        viewVZ.OpenGLWidget->update();
+    }
+}
+
+void MainWindow::actionExportProfile_triggered()
+{
+    if (profiler::events().isEmpty()) {
+        SCUtilities::showMessage("Nothing has been recorded yet: show the profiler overlay to start recording.");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, "Export profile", QDir::homePath() + "/spinecreator_trace.json", tr("Chrome trace files (*.json);; All files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (!profiler::writeChromeTrace(fileName)) {
+        SCUtilities::showMessage("Could not write the profile to " + fileName + ".", QMessageBox::Warning);
+    }
+}
+
 void MainWindow::configureVCSMenu()
 {
     // show or hide menus
@@ -61,6 +61,8 @@ namespace Ui {
     class MainWindow;
 }
 
+class autosaver;
+
 struct viewGVstruct {
     QMainWindow * subWin; // This is the thing which contains the mdiarea.
     QMdiArea * mdiarea; // This is created and then added to the subWin.
@@ -145,6 +147,12 @@ public:
     viewVZLayoutEditHandler * viewVZhandler;
     QShortcut * deleteShortcut;
     void addComponentsToFileList();
+
+    /*!
+     * Give the visualiser's tree a model of the network, bringing the one
+     * it has up to date if there is one, rather than building it again.
+     */
+    void configureSystemModel();
     QString toolbarStyleSheet;
     void setProjectMenu();
 
@@ -227,6 +235,12 @@ private:
      */
     QErrorMessage* emsg;
 
+    /*!
+     * Journals the unsaved changes of the current project for crash
+     * recovery.
+     */
+    autosaver * autosave;
+
     QAction *undoAction;
     QAction *redoAction;
     QDomDocument tempDoc;
@@ -236,7 +250,6 @@ private:
     void connectViewCL();
     void initViewVZ();
     void connectViewVZ();
-    void configureVCSMenu();
     bool isChanged();
     bool promptToSave();
     void clearComponents();
@@ -247,6 +260,7 @@ private:
     void hideViewGV (void);
 
 public slots:
+    void configureVCSMenu();
     void import_project();
     void import_recent_project();
     void clear_recent_projects();
@@ -263,6 +277,11 @@ public slots:
     void export_layout();
     void import_csv();
     void viewGVshow();
+    /*!
+     * Show the logs of the current experiment's graph view in the 3D
+     * view, as they finish loading.
+     */
+    void viewGVlogsLoaded();
     void viewELshow();
     void viewNLshow();
     void viewVZshow();
@@ -274,6 +293,17 @@ public slots:
     void initialiseModel(QSharedPointer<Component>);
     void updateNetworkButtons(nl_rootdata *);
     void undoOrRedoPerformed(int);
+    /*!
+     * Show the progress of a long running project save or load in the
+     * status bar. Only the status bar is repainted; no events are handled
+     * until the save or load is done.
+     */
+    void projectProgress(QString, int);
+    /*!
+     * Offer back the changes journalled by a session which did not close
+     * cleanly. Called once the window is shown.
+     */
+    void offerRecovery();
 
     // AL editor slots
     void actionAs_Image_triggered();
@@ -305,6 +335,8 @@ public slots:
     void actionAddOnImpulse_triggered();
     void actionDuplicate_experiment_triggered();
     void about();
+    void actionProfilerOverlay_toggled(bool show);
+    void actionExportProfile_triggered();
 
     // versioning
     void actionCommitModel_triggered();
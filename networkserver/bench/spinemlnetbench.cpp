@@ -0,0 +1,866 @@
+/*
+ * A synthetic SpineML client for measuring the latency and throughput
+ * of a SpineML network server - the matlab bridge started with
+ * spinemlnetStart, or a program built on spineMLNetworkServer or
+ * spineMLAsyncServer - without running a model.
+ *
+ * It connects, carries out the handshake of protocol.txt (with the
+ * batching, float and shared memory extensions if asked for), then
+ * either sends timesteps of synthetic data (AM_SOURCE, as a model's
+ * output would) or receives them (AM_TARGET, as a model's input
+ * would), optionally paced at a given rate. At the end it reports:
+ *
+ *  - the latency of each frame, p50 and p99. For a source, this is the
+ *    time from sending a frame to getting its RESP_RECVD; for a
+ *    target, the time from sending RESP_RECVD to getting the next
+ *    frame. With a batch depth of 1, a frame is one timestep.
+ *  - the throughput in values (doubles, floats or neurons) per second.
+ *  - the CPU time used, as a share of the wall clock time, by this
+ *    client and, if its pid is given with -P, by the server.
+ *
+ * The first few frames (-w) are left out of the figures, so that the
+ * connection settling in does not count.
+ *
+ * See readme.spinemlnetbench for how to build and run it.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+extern "C" {
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+}
+
+#include "../matlab/SpineMLShmRing.h"
+#include "../matlab/SpineMLSparse.h"
+
+using namespace std;
+
+// SpineML tcp/ip comms flags; see protocol.txt.
+#define RESP_DATA_NUMS       31
+#define RESP_DATA_SPIKES     32
+#define RESP_DATA_NUMS_FLOAT 34
+#define RESP_HELLO           41
+#define RESP_RECVD           42
+#define AM_SOURCE            45
+#define AM_TARGET            46
+#define REQ_BATCH            47
+#define REQ_SHM              48
+
+#define DEFAULT_PORT 50091
+
+// How long to wait for the server before giving up, in ms.
+#define BENCH_TIMEOUT_MS 10000
+
+/*!
+ * The settings, from the command line.
+ */
+struct BenchOptions
+{
+    BenchOptions (void)
+        : host ("localhost")
+        , port (DEFAULT_PORT)
+        , direction (AM_SOURCE)
+        , dataType (RESP_DATA_NUMS)
+        , size (1)
+        , steps (10000)
+        , warmup (100)
+        , rate (0)
+        , batch (1)
+        , useShm (false)
+        , slots (1)
+        , activity (0.05)
+        , name ("bench")
+        , serverPid (0)
+        {
+        };
+
+    string host;
+    int port;
+    int direction;
+    int dataType;
+    uint32_t size;
+    uint32_t steps;
+    uint32_t warmup;
+    /*! Timesteps per second; 0 to go as fast as the server allows. */
+    double rate;
+    uint32_t batch;
+    bool useShm;
+    uint32_t slots;
+    /*! The share of neurons spiking in each timestep. */
+    double activity;
+    string name;
+    pid_t serverPid;
+};
+
+/*!
+ * Monotonic time in nanoseconds.
+ */
+uint64_t
+nowNs (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/*!
+ * Sleep until the monotonic clock reads until (in ns).
+ */
+void
+sleepUntilNs (uint64_t until)
+{
+    struct timespec t;
+    t.tv_sec = (time_t)(until / 1000000000ULL);
+    t.tv_nsec = (long)(until % 1000000000ULL);
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+    }
+}
+
+/*!
+ * CPU time, user plus system, used by this process, in ns.
+ */
+uint64_t
+selfCpuNs (void)
+{
+    struct rusage u;
+    getrusage (RUSAGE_SELF, &u);
+    return ((uint64_t)u.ru_utime.tv_sec + (uint64_t)u.ru_stime.tv_sec) * 1000000000ULL
+        + ((uint64_t)u.ru_utime.tv_usec + (uint64_t)u.ru_stime.tv_usec) * 1000ULL;
+}
+
+/*!
+ * CPU time used by process pid, in ns, read from /proc. Returns 0 if
+ * it can't be read (not Linux, or no such process).
+ */
+uint64_t
+procCpuNs (pid_t pid)
+{
+    stringstream path;
+    path << "/proc/" << pid << "/stat";
+    ifstream f (path.str().c_str());
+    string line;
+    if (!getline (f, line)) {
+        return 0;
+    }
+    // The process name, field 2, is in brackets and may hold spaces;
+    // utime and stime are fields 14 and 15.
+    size_t close = line.rfind (')');
+    if (close == string::npos) {
+        return 0;
+    }
+    stringstream fields (line.substr (close + 2));
+    string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && (fields >> field); ++i) {
+        if (i == 14) {
+            utime = strtoull (field.c_str(), NULL, 10);
+        } else if (i == 15) {
+            stime = strtoull (field.c_str(), NULL, 10);
+        }
+    }
+    long ticks = sysconf (_SC_CLK_TCK);
+    if (ticks <= 0) {
+        return 0;
+    }
+    return (uint64_t)(utime + stime) * 1000000000ULL / (uint64_t)ticks;
+}
+
+/*!
+ * Write or read exactly n bytes on the blocking socket fd. Return
+ * false if the connection failed or timed out first.
+ */
+//@{
+bool
+sendAll (int fd, const char* p, size_t n)
+{
+    while (n > 0) {
+        ssize_t b = send (fd, p, n, MSG_NOSIGNAL);
+        if (b < 0 && errno == EINTR) {
+            continue;
+        }
+        if (b <= 0) {
+            return false;
+        }
+        p += b;
+        n -= (size_t)b;
+    }
+    return true;
+}
+
+bool
+recvAll (int fd, char* p, size_t n)
+{
+    while (n > 0) {
+        ssize_t b = recv (fd, p, n, 0);
+        if (b < 0 && errno == EINTR) {
+            continue;
+        }
+        if (b <= 0) {
+            return false;
+        }
+        p += b;
+        n -= (size_t)b;
+    }
+    return true;
+}
+//@}
+
+/*!
+ * Send a byte and check that the reply is expected.
+ */
+bool
+exchangeByte (int fd, char send, char expected)
+{
+    char reply = 0;
+    if (!sendAll (fd, &send, 1) || !recvAll (fd, &reply, 1)) {
+        return false;
+    }
+    return reply == expected;
+}
+
+/*!
+ * Send a 4 byte int and check for RESP_RECVD.
+ */
+bool
+exchangeInt (int fd, uint32_t v)
+{
+    vector<char> b;
+    spineMLPutLE32 (b, v);
+    char reply = 0;
+    if (!sendAll (fd, &b[0], b.size()) || !recvAll (fd, &reply, 1)) {
+        return false;
+    }
+    return reply == RESP_RECVD;
+}
+
+/*!
+ * Connect to the server, with Nagle turned off and BENCH_TIMEOUT_MS
+ * on reads. Returns the socket, or -1.
+ */
+int
+connectToServer (const BenchOptions& o)
+{
+    struct addrinfo hints;
+    memset (&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    stringstream port;
+    port << o.port;
+    struct addrinfo* res = (struct addrinfo*)0;
+    if (getaddrinfo (o.host.c_str(), port.str().c_str(), &hints, &res) != 0) {
+        cerr << "Can't resolve " << o.host << endl;
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* a = res; a != (struct addrinfo*)0; a = a->ai_next) {
+        fd = socket (a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect (fd, a->ai_addr, a->ai_addrlen) == 0) {
+            break;
+        }
+        ::close (fd);
+        fd = -1;
+    }
+    freeaddrinfo (res);
+    if (fd < 0) {
+        cerr << "Can't connect to " << o.host << ":" << o.port << endl;
+        return -1;
+    }
+    int one = 1;
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv;
+    tv.tv_sec = BENCH_TIMEOUT_MS / 1000;
+    tv.tv_usec = (BENCH_TIMEOUT_MS % 1000) * 1000;
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/*!
+ * The synthetic client.
+ */
+class BenchClient
+{
+public:
+    BenchClient (const BenchOptions& o)
+        : values (0)
+        , wireBytes (0)
+        , elapsed (0)
+        , cpu (0)
+        , serverCpu (0)
+        , opts (o)
+        , fd (-1)
+        , depth (1)
+        , shm ((SpineMLShmRing*)0)
+        , nextSlot ((char*)0)
+        , wireStart (0)
+        {
+        };
+
+    ~BenchClient()
+        {
+            if (this->shm != (SpineMLShmRing*)0) {
+                this->shm->detach();
+                delete this->shm;
+            }
+            if (this->fd >= 0) {
+                ::close (this->fd);
+            }
+        };
+
+    /*!
+     * Connect and carry out the handshake. Returns 0 on success, -1 on
+     * failure.
+     */
+    int start (void);
+
+    /*!
+     * Send or receive opts.steps timesteps, recording the latency of
+     * each frame after the first opts.warmup timesteps. Returns 0 on
+     * success, -1 on failure.
+     */
+    int run (void);
+
+    /*!
+     * Hang up, as a model does at the end of a run.
+     */
+    void finish (void);
+
+    /*!
+     * The results of run(), over the timesteps after the warm up: the
+     * latency of each frame, the values and bytes carried, and the
+     * wall clock, client CPU and server CPU time taken, all times in
+     * ns.
+     */
+    //@{
+    vector<uint64_t> latencies;
+    uint64_t values;
+    uint64_t wireBytes;
+    uint64_t elapsed;
+    uint64_t cpu;
+    uint64_t serverCpu;
+    //@}
+
+    uint32_t getDepth (void) { return this->depth; }
+    bool getUsesSharedMemory (void) { return this->shm != (SpineMLShmRing*)0; }
+
+private:
+    bool isSparse (void) { return this->opts.dataType == RESP_DATA_SPIKES
+                               || this->opts.dataType == RESP_DATA_SPIKES_COMPACT; }
+    size_t valueBytes (void) { return this->opts.dataType == RESP_DATA_NUMS_FLOAT ? 4 : 8; }
+
+    /*!
+     * The most bytes a frame of the agreed depth can take.
+     */
+    size_t maxFrameBytes (void);
+
+    /*!
+     * Fill frame with steps timesteps of synthetic data, starting at
+     * timestep first, laid out as on the wire.
+     */
+    void buildFrame (uint32_t first, uint32_t steps);
+
+    /*!
+     * Note the clocks, and the bytes carried so far, at the start of
+     * the measured timesteps.
+     */
+    void startMeasuring (void);
+
+    /*!
+     * Offer a shared memory ring; see REQ_SHM in protocol.txt.
+     */
+    int offerSharedMemory (void);
+
+    /*!
+     * One frame each way. sendFrame() sends the frame built by
+     * buildFrame() and waits for it to be taken, setting sentAt to the
+     * time it was handed over. recvFrame() returns the number of
+     * timesteps in the next frame, or 0 on failure; ackFrame() then
+     * lets the server send another.
+     */
+    //@{
+    bool sendFrame (uint64_t& sentAt);
+    uint32_t recvFrame (void);
+    bool ackFrame (void);
+    //@}
+
+    BenchOptions opts;
+    int fd;
+    uint32_t depth;
+    SpineMLShmRing* shm;
+    /*! The slot the next frame goes into, for a shared memory source. */
+    char* nextSlot;
+    vector<char> frame;
+    uint64_t wireStart;
+};
+
+size_t
+BenchClient::maxFrameBytes (void)
+{
+    if (this->isSparse()) {
+        return 8 + (size_t)this->depth * spineMLSparseMaxBytes (this->opts.size, false);
+    }
+    return 4 + (size_t)this->depth * this->opts.size * this->valueBytes();
+}
+
+int
+BenchClient::offerSharedMemory (void)
+{
+    stringstream ss;
+    ss << "/spinemlnetbench." << getpid();
+    string name = ss.str();
+    this->shm = new SpineMLShmRing();
+    if (this->shm->create (name, this->opts.slots, (uint32_t)this->maxFrameBytes()) != 0) {
+        cerr << "Can't create the shared memory ring; carrying on over TCP/IP." << endl;
+        delete this->shm;
+        this->shm = (SpineMLShmRing*)0;
+        return 0;
+    }
+    vector<char> b;
+    b.push_back ((char)REQ_SHM);
+    spineMLPutLE32 (b, (uint32_t)name.size());
+    b.insert (b.end(), name.begin(), name.end());
+    char reply[2] = { 0, 0 };
+    if (!sendAll (this->fd, &b[0], b.size()) || !recvAll (this->fd, reply, 2)
+        || reply[0] != RESP_RECVD) {
+        cerr << "Server failed REQ_SHM." << endl;
+        return -1;
+    }
+    if (reply[1] != 1) {
+        cerr << "Server declined shared memory; carrying on over TCP/IP." << endl;
+        this->shm->detach();
+        delete this->shm;
+        this->shm = (SpineMLShmRing*)0;
+    }
+    return 0;
+}
+
+int
+BenchClient::start (void)
+{
+    this->fd = connectToServer (this->opts);
+    if (this->fd < 0) {
+        return -1;
+    }
+
+    if (!exchangeByte (this->fd, (char)this->opts.direction, RESP_HELLO)) {
+        cerr << "No RESP_HELLO from server." << endl;
+        return -1;
+    }
+
+    if (this->opts.batch > 1) {
+        vector<char> b;
+        b.push_back ((char)REQ_BATCH);
+        spineMLPutLE32 (b, this->opts.batch);
+        char reply[5];
+        if (!sendAll (this->fd, &b[0], b.size()) || !recvAll (this->fd, reply, 5)
+            || reply[0] != RESP_RECVD) {
+            cerr << "Server failed REQ_BATCH." << endl;
+            return -1;
+        }
+        this->depth = spineMLGetLE32 (reply + 1);
+        if (this->depth < 1 || this->depth > this->opts.batch) {
+            cerr << "Server agreed to a batch depth of " << this->depth
+                 << ", which is out of range." << endl;
+            return -1;
+        }
+    }
+
+    if (this->opts.useShm && this->offerSharedMemory() != 0) {
+        return -1;
+    }
+
+    if (!exchangeByte (this->fd, (char)this->opts.dataType, RESP_RECVD)) {
+        cerr << "Server refused the data type." << endl;
+        return -1;
+    }
+    if (!exchangeInt (this->fd, this->opts.size)) {
+        cerr << "Server refused the data size." << endl;
+        return -1;
+    }
+    vector<char> b;
+    spineMLPutLE32 (b, (uint32_t)this->opts.name.size());
+    b.insert (b.end(), this->opts.name.begin(), this->opts.name.end());
+    char reply = 0;
+    if (!sendAll (this->fd, &b[0], b.size()) || !recvAll (this->fd, &reply, 1)
+        || reply != RESP_RECVD) {
+        cerr << "Server refused the connection name." << endl;
+        return -1;
+    }
+
+    this->frame.reserve (this->maxFrameBytes());
+    return 0;
+}
+
+void
+BenchClient::buildFrame (uint32_t first, uint32_t steps)
+{
+    this->frame.clear();
+    if (this->depth > 1) {
+        spineMLPutLE32 (this->frame, steps);
+    }
+
+    if (this->isSparse()) {
+        // A fixed share of the neurons spike, spread evenly through
+        // the population and moving along by one each timestep.
+        size_t lengthAt = this->frame.size();
+        spineMLPutLE32 (this->frame, 0);
+        uint32_t count = (uint32_t)(this->opts.activity * this->opts.size);
+        if (count > this->opts.size) {
+            count = this->opts.size;
+        }
+        uint32_t stride = count > 0 ? this->opts.size / count : 1;
+        vector<uint32_t> indices (count > 0 ? count : 1);
+        for (uint32_t s = 0; s < steps; ++s) {
+            uint32_t phase = (first + s) % stride;
+            for (uint32_t i = 0; i < count; ++i) {
+                indices[i] = i * stride + phase;
+            }
+            spineMLEncodeEvents (this->opts.dataType == RESP_DATA_SPIKES_COMPACT, false,
+                                 &indices[0], (const double*)0, count, this->frame);
+        }
+        uint32_t length = (uint32_t)(this->frame.size() - lengthAt - 4);
+        vector<char> l;
+        spineMLPutLE32 (l, length);
+        memcpy (&this->frame[lengthAt], &l[0], 4);
+        return;
+    }
+
+    size_t at = this->frame.size();
+    this->frame.resize (at + (size_t)steps * this->opts.size * this->valueBytes());
+    char* p = &this->frame[at];
+    for (uint32_t s = 0; s < steps; ++s) {
+        for (uint32_t i = 0; i < this->opts.size; ++i) {
+            double d = sin (0.001 * (first + s) + i);
+            if (this->opts.dataType == RESP_DATA_NUMS_FLOAT) {
+                float f = (float)d;
+                memcpy (p, &f, sizeof(f));
+                p += sizeof(f);
+            } else {
+                memcpy (p, &d, sizeof(d));
+                p += sizeof(d);
+            }
+        }
+    }
+}
+
+bool
+BenchClient::sendFrame (uint64_t& sentAt)
+{
+    if (this->shm != (SpineMLShmRing*)0) {
+        if (this->nextSlot == (char*)0) {
+            this->nextSlot = this->shm->beginWrite (BENCH_TIMEOUT_MS);
+            if (this->nextSlot == (char*)0) {
+                return false;
+            }
+        }
+        memcpy (this->nextSlot, &this->frame[0], this->frame.size());
+        sentAt = nowNs();
+        this->shm->endWrite (this->frame.size());
+        // Taking the next slot stands in for waiting on RESP_RECVD. With
+        // more than one slot this returns at once until the ring is full.
+        this->nextSlot = this->shm->beginWrite (BENCH_TIMEOUT_MS);
+        return this->nextSlot != (char*)0;
+    }
+
+    sentAt = nowNs();
+    char reply = 0;
+    if (!sendAll (this->fd, &this->frame[0], this->frame.size())
+        || !recvAll (this->fd, &reply, 1)) {
+        return false;
+    }
+    return reply == RESP_RECVD;
+}
+
+void
+BenchClient::startMeasuring (void)
+{
+    this->elapsed = nowNs();
+    this->cpu = selfCpuNs();
+    this->serverCpu = this->opts.serverPid > 0 ? procCpuNs (this->opts.serverPid) : 0;
+    this->wireStart = this->wireBytes;
+}
+
+uint32_t
+BenchClient::recvFrame (void)
+{
+    uint32_t steps = 1;
+
+    if (this->shm != (SpineMLShmRing*)0) {
+        size_t n = 0;
+        const char* slot = this->shm->beginRead (n, BENCH_TIMEOUT_MS);
+        if (slot == (const char*)0) {
+            return 0;
+        }
+        if (this->depth > 1) {
+            steps = n < 4 ? 0 : spineMLGetLE32 (slot);
+        }
+        this->wireBytes += n;
+        return steps > this->depth ? 0 : steps;
+    }
+
+    char header[4];
+    if (this->depth > 1) {
+        if (!recvAll (this->fd, header, 4)) {
+            return 0;
+        }
+        steps = spineMLGetLE32 (header);
+        this->wireBytes += 4;
+        if (steps < 1 || steps > this->depth) {
+            return 0;
+        }
+    }
+    size_t body = (size_t)steps * this->opts.size * this->valueBytes();
+    if (this->isSparse()) {
+        if (!recvAll (this->fd, header, 4)) {
+            return 0;
+        }
+        body = spineMLGetLE32 (header);
+        this->wireBytes += 4;
+        if (body > this->maxFrameBytes()) {
+            return 0;
+        }
+    }
+    this->frame.resize (body);
+    if (body > 0 && !recvAll (this->fd, &this->frame[0], body)) {
+        return 0;
+    }
+    this->wireBytes += body;
+    return steps;
+}
+
+bool
+BenchClient::ackFrame (void)
+{
+    if (this->shm != (SpineMLShmRing*)0) {
+        this->shm->endRead();
+        return true;
+    }
+    char ack = RESP_RECVD;
+    return sendAll (this->fd, &ack, 1);
+}
+
+int
+BenchClient::run (void)
+{
+    uint64_t start = nowNs();
+    uint32_t done = 0;
+    uint64_t ackedAt = start;
+    if (this->opts.warmup == 0) {
+        this->startMeasuring();
+    }
+
+    while (done < this->opts.steps) {
+
+        uint64_t due = start + (this->opts.rate > 0
+                                ? (uint64_t)(done * 1.0e9 / this->opts.rate) : 0);
+        uint32_t steps = 0;
+        uint64_t latency = 0;
+
+        if (this->opts.direction == AM_SOURCE) {
+            steps = this->opts.steps - done;
+            if (steps > this->depth) {
+                steps = this->depth;
+            }
+            this->buildFrame (done, steps);
+            if (this->opts.rate > 0) {
+                sleepUntilNs (due);
+            }
+            uint64_t sentAt = 0;
+            if (!this->sendFrame (sentAt)) {
+                cerr << "Failed to send a frame at timestep " << done << "." << endl;
+                return -1;
+            }
+            latency = nowNs() - sentAt;
+            this->wireBytes += this->frame.size();
+
+        } else {
+            steps = this->recvFrame();
+            if (steps == 0) {
+                cerr << "Failed to receive a frame at timestep " << done << "." << endl;
+                return -1;
+            }
+            latency = nowNs() - ackedAt;
+            // A model would only ask for the next timestep when it got
+            // there.
+            if (this->opts.rate > 0) {
+                sleepUntilNs (start + (uint64_t)((done + steps) * 1.0e9 / this->opts.rate));
+            }
+            if (!this->ackFrame()) {
+                cerr << "Failed to acknowledge a frame at timestep " << done << "." << endl;
+                return -1;
+            }
+            ackedAt = nowNs();
+        }
+
+        if (done >= this->opts.warmup) {
+            this->latencies.push_back (latency);
+            this->values += (uint64_t)steps * this->opts.size;
+        }
+        done += steps;
+        if (done >= this->opts.warmup && done - steps < this->opts.warmup) {
+            this->startMeasuring();
+        }
+    }
+
+    this->elapsed = nowNs() - this->elapsed;
+    this->cpu = selfCpuNs() - this->cpu;
+    if (this->opts.serverPid > 0) {
+        this->serverCpu = procCpuNs (this->opts.serverPid) - this->serverCpu;
+    }
+    this->wireBytes -= this->wireStart;
+    return 0;
+}
+
+void
+BenchClient::finish (void)
+{
+    if (this->shm != (SpineMLShmRing*)0) {
+        this->shm->close();
+    }
+    if (this->fd >= 0) {
+        ::close (this->fd);
+        this->fd = -1;
+    }
+}
+
+/*!
+ * The value below which a share p of the sorted samples lie.
+ */
+uint64_t
+percentile (const vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = (size_t)ceil (p * sorted.size());
+    return sorted[i > 0 ? i - 1 : 0];
+}
+
+void
+usage (const char* prog)
+{
+    cerr << "Usage: " << prog << " [options]\n"
+         << "  -H host     server host (localhost)\n"
+         << "  -p port     server port (" << DEFAULT_PORT << ")\n"
+         << "  -d dir      source (send to the server, as a model output) or\n"
+         << "              target (receive from it, as a model input) (source)\n"
+         << "  -t type     nums, float, spikes or compact (nums)\n"
+         << "  -n size     values, or neurons, per timestep (1)\n"
+         << "  -s steps    timesteps to send or receive (10000)\n"
+         << "  -w steps    warm up timesteps, not measured (100)\n"
+         << "  -r rate     timesteps per second; 0 for as fast as possible (0)\n"
+         << "  -b depth    ask for this many timesteps per frame (1)\n"
+         << "  -m          offer a shared memory ring\n"
+         << "  -q slots    slots in the ring (1)\n"
+         << "  -a share    share of neurons spiking per timestep (0.05)\n"
+         << "  -c name     connection name (bench)\n"
+         << "  -P pid      also report the CPU use of the server process pid\n";
+}
+
+int
+main (int argc, char** argv)
+{
+    BenchOptions o;
+    int c;
+    while ((c = getopt (argc, argv, "H:p:d:t:n:s:w:r:b:mq:a:c:P:h")) != -1) {
+        switch (c) {
+        case 'H': o.host = optarg; break;
+        case 'p': o.port = atoi (optarg); break;
+        case 'd':
+            if (string (optarg) == "source") {
+                o.direction = AM_SOURCE;
+            } else if (string (optarg) == "target") {
+                o.direction = AM_TARGET;
+            } else {
+                usage (argv[0]);
+                return 1;
+            }
+            break;
+        case 't':
+            if (string (optarg) == "nums") {
+                o.dataType = RESP_DATA_NUMS;
+            } else if (string (optarg) == "float") {
+                o.dataType = RESP_DATA_NUMS_FLOAT;
+            } else if (string (optarg) == "spikes") {
+                o.dataType = RESP_DATA_SPIKES;
+            } else if (string (optarg) == "compact") {
+                o.dataType = RESP_DATA_SPIKES_COMPACT;
+            } else {
+                usage (argv[0]);
+                return 1;
+            }
+            break;
+        case 'n': o.size = (uint32_t)strtoul (optarg, NULL, 10); break;
+        case 's': o.steps = (uint32_t)strtoul (optarg, NULL, 10); break;
+        case 'w': o.warmup = (uint32_t)strtoul (optarg, NULL, 10); break;
+        case 'r': o.rate = atof (optarg); break;
+        case 'b': o.batch = (uint32_t)strtoul (optarg, NULL, 10); break;
+        case 'm': o.useShm = true; break;
+        case 'q': o.slots = (uint32_t)strtoul (optarg, NULL, 10); break;
+        case 'a': o.activity = atof (optarg); break;
+        case 'c': o.name = optarg; break;
+        case 'P': o.serverPid = (pid_t)atoi (optarg); break;
+        default:
+            usage (argv[0]);
+            return 1;
+        }
+    }
+    if (o.size < 1 || o.batch < 1 || o.slots < 1 || o.warmup >= o.steps) {
+        cerr << "The size, batch depth and slots must be at least 1, and there must be"
+             << " more timesteps than warm up timesteps." << endl;
+        return 1;
+    }
+
+    BenchClient client (o);
+    if (client.start() != 0) {
+        return 1;
+    }
+    int rtn = client.run();
+    client.finish();
+    if (rtn != 0) {
+        return 1;
+    }
+
+    sort (client.latencies.begin(), client.latencies.end());
+    double secs = client.elapsed / 1.0e9;
+
+    cout << (o.direction == AM_SOURCE ? "AM_SOURCE" : "AM_TARGET") << ", "
+         << o.size << " per timestep, batch depth " << client.getDepth() << ", "
+         << (client.getUsesSharedMemory() ? "shared memory" : "TCP/IP") << endl;
+    cout << client.latencies.size() << " frames, "
+         << o.steps - o.warmup << " timesteps in " << secs << " s" << endl;
+    cout << "latency per frame: p50 " << percentile (client.latencies, 0.50) / 1000.0
+         << " us, p99 " << percentile (client.latencies, 0.99) / 1000.0
+         << " us, max " << (client.latencies.empty() ? 0 : client.latencies.back() / 1000.0)
+         << " us" << endl;
+    if (secs > 0) {
+        cout << "throughput: " << client.values / secs << " values/s, "
+             << client.wireBytes / secs / 1.0e6 << " MB/s" << endl;
+        cout << "CPU: client " << 100.0 * client.cpu / client.elapsed << "%";
+        if (o.serverPid > 0) {
+            cout << ", server " << 100.0 * client.serverCpu / client.elapsed << "%";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,449 @@
+#include "spinemlasyncserver.h"
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+#include <climits>
+
+// the longest connection name accepted in the handshake
+#define MAX_NAME_LENGTH 1024
+
+spineMLAsyncConnection::spineMLAsyncConnection(QTcpSocket * socket, QObject *parent) :
+    QObject(parent)
+{
+    this->socket = socket;
+    socket->setParent(this);
+    stage = gettingDirection;
+    clientDirection = NOT_SET;
+    type = ANALOG;
+    floatPayload = false;
+    valuesPerStep = 0;
+    depth = 1;
+    nameLength = 0;
+    unwritten = 0;
+    awaitingAck = false;
+    closed = false;
+
+    // every frame waits on a one byte reply, so don't let Nagle hold
+    // either of them back
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readyToRead()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(bytesWritten(qint64)));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
+}
+
+bool spineMLAsyncConnection::isReady() {
+    return stage == handshakeDone && !closed;
+}
+
+bool spineMLAsyncConnection::isSource() {
+    return clientDirection == AM_SOURCE;
+}
+
+bool spineMLAsyncConnection::isTarget() {
+    return clientDirection == AM_TARGET;
+}
+
+QString spineMLAsyncConnection::name() {
+    return connName;
+}
+
+dataTypes spineMLAsyncConnection::dataType() {
+    return type;
+}
+
+int spineMLAsyncConnection::size() {
+    return valuesPerStep;
+}
+
+int spineMLAsyncConnection::batchDepth() {
+    return depth;
+}
+
+bool spineMLAsyncConnection::canSend() {
+    return isReady() && isTarget() && !awaitingAck && unwritten == 0;
+}
+
+bool spineMLAsyncConnection::send(const double * values, int steps) {
+
+    if (!canSend()) {
+        return false;
+    }
+    if (steps < 1 || steps > depth) {
+        qDebug() << "Bad number of timesteps in spineMLAsyncConnection::send";
+        return false;
+    }
+
+    // fill the preallocated frame: the timestep count if batched, then
+    // the values
+    int header = depth > 1 ? 4 : 0;
+    int count = steps*valuesPerStep;
+    int valueBytes = floatPayload ? sizeof(float) : sizeof(double);
+    int frameBytes = header + count*valueBytes;
+    char * out = sendBuf.data();
+    if (header) {
+        qToLittleEndian((quint32) steps, (uchar *) out);
+    }
+    if (floatPayload) {
+        float * f = (float *) (out + header);
+        for (int i = 0; i < count; ++i) {
+            f[i] = (float) values[i];
+        }
+    } else {
+        memcpy(out + header, values, count*sizeof(double));
+    }
+
+    qint64 w = socket->write(sendBuf.constData(), frameBytes);
+    if (w != frameBytes) {
+        fail("Error writing frame");
+        return false;
+    }
+    unwritten += w;
+    awaitingAck = true;
+    return true;
+}
+
+void spineMLAsyncConnection::abort() {
+    if (!closed) {
+        socket->abort();
+        disconnected();
+    }
+}
+
+void spineMLAsyncConnection::readyToRead() {
+
+    if (closed) {
+        return;
+    }
+
+    if (stage != handshakeDone) {
+        if (!doHandshake()) {
+            return;
+        }
+        if (stage != handshakeDone) {
+            // waiting for more of the handshake
+            return;
+        }
+    }
+
+    if (isSource()) {
+        doReadFrames();
+    } else {
+        doReadAcknowledgements();
+    }
+}
+
+void spineMLAsyncConnection::bytesWritten(qint64 bytes) {
+    unwritten -= bytes;
+    if (unwritten < 0) {
+        unwritten = 0;
+    }
+    checkReadyToSend();
+}
+
+void spineMLAsyncConnection::disconnected() {
+    if (closed) {
+        return;
+    }
+    closed = true;
+    emit finished(this);
+}
+
+void spineMLAsyncConnection::checkReadyToSend() {
+    if (canSend()) {
+        emit readyToSend(this);
+    }
+}
+
+bool spineMLAsyncConnection::reply(const char * data, int count) {
+    if (socket->write(data, count) != count) {
+        fail("Error writing reply");
+        return false;
+    }
+    return true;
+}
+
+void spineMLAsyncConnection::fail(const QString& why) {
+    qDebug() << "spineMLAsyncConnection" << connName << ":" << why;
+    abort();
+}
+
+bool spineMLAsyncConnection::doHandshake() {
+
+    // each stage takes what it needs if it has all arrived, and leaves
+    // it for the next readyRead() otherwise
+    while (stage != handshakeDone) {
+
+        char c;
+        quint32 v;
+        switch (stage) {
+
+        case gettingDirection:
+            if (socket->bytesAvailable() < 1) {
+                return true;
+            }
+            socket->read(&c, 1);
+            if (c != AM_SOURCE && c != AM_TARGET) {
+                fail("Error handshaking: bad data " + QString::number(c));
+                return false;
+            }
+            clientDirection = c;
+            c = RESP_HELLO;
+            if (!reply(&c, 1)) {
+                return false;
+            }
+            stage = gettingDataType;
+            break;
+
+        case gettingDataType:
+            if (socket->bytesAvailable() < 1) {
+                return true;
+            }
+            socket->read(&c, 1);
+            if (c == REQ_BATCH) {
+                stage = gettingBatchDepth;
+                break;
+            }
+            if (c == REQ_SHM) {
+                stage = gettingRingNameLength;
+                break;
+            }
+            if (c == RESP_DATA_NUMS || c == RESP_DATA_NUMS_FLOAT) {
+                type = ANALOG;
+                floatPayload = (c == RESP_DATA_NUMS_FLOAT);
+            } else if (c == RESP_DATA_SPIKES || c == RESP_DATA_SPIKES_COMPACT
+                       || c == RESP_DATA_IMPULSES || c == RESP_DATA_IMPULSES_COMPACT) {
+                // the sparse frames vary in length, which the framing
+                // here does not handle; spineMLNetworkServer does
+                fail("Spike and impulse connections are not supported");
+                return false;
+            } else {
+                fail("Bad data type " + QString::number(c));
+                return false;
+            }
+            c = RESP_RECVD;
+            if (!reply(&c, 1)) {
+                return false;
+            }
+            stage = gettingSize;
+            break;
+
+        case gettingBatchDepth: {
+            if (socket->bytesAvailable() < 4) {
+                return true;
+            }
+            socket->read((char *) &v, 4);
+            v = qFromLittleEndian(v);
+            depth = (int) qBound((quint32) 1, v, (quint32) MAX_BATCH_DEPTH);
+            char r[5];
+            r[0] = RESP_RECVD;
+            qToLittleEndian((quint32) depth, (uchar *) r+1);
+            if (!reply(r, 5)) {
+                return false;
+            }
+            stage = gettingDataType;
+            break;
+        }
+
+        case gettingRingNameLength:
+            if (socket->bytesAvailable() < 4) {
+                return true;
+            }
+            socket->read((char *) &v, 4);
+            v = qFromLittleEndian(v);
+            if (v > SPINEMLSHM_MAX_NAME) {
+                fail("Ring name too long (" + QString::number(v) + " bytes)");
+                return false;
+            }
+            nameLength = (int) v;
+            stage = gettingRingName;
+            break;
+
+        case gettingRingName: {
+            if (socket->bytesAvailable() < nameLength) {
+                return true;
+            }
+            socket->read(nameLength);
+            // the ring's semaphores can only be waited on by blocking, so
+            // decline it and keep to the socket
+            char r[2];
+            r[0] = RESP_RECVD;
+            r[1] = 0;
+            if (!reply(r, 2)) {
+                return false;
+            }
+            stage = gettingDataType;
+            break;
+        }
+
+        case gettingSize:
+            if (socket->bytesAvailable() < 4) {
+                return true;
+            }
+            socket->read((char *) &v, 4);
+            v = qFromLittleEndian(v);
+            if (v == 0 || v > (quint32) (INT_MAX / sizeof(double) / MAX_BATCH_DEPTH)) {
+                fail("Bad data size " + QString::number(v));
+                return false;
+            }
+            valuesPerStep = (int) v;
+            c = RESP_RECVD;
+            if (!reply(&c, 1)) {
+                return false;
+            }
+            stage = gettingNameLength;
+            break;
+
+        case gettingNameLength:
+            if (socket->bytesAvailable() < 4) {
+                return true;
+            }
+            socket->read((char *) &v, 4);
+            v = qFromLittleEndian(v);
+            if (v > MAX_NAME_LENGTH) {
+                fail("Insanely long name (" + QString::number(v) + " bytes)");
+                return false;
+            }
+            nameLength = (int) v;
+            stage = gettingName;
+            break;
+
+        case gettingName: {
+            if (socket->bytesAvailable() < nameLength) {
+                return true;
+            }
+            connName = QString::fromLatin1(socket->read(nameLength));
+            c = RESP_RECVD;
+            if (!reply(&c, 1)) {
+                return false;
+            }
+
+            // size the buffers for the largest frame, once
+            int header = depth > 1 ? 4 : 0;
+            int valueBytes = floatPayload ? sizeof(float) : sizeof(double);
+            int frameBytes = header + depth*valuesPerStep*valueBytes;
+            recvBuf.resize(frameBytes);
+            sendBuf.resize(frameBytes);
+            recvValues.resize(depth*valuesPerStep);
+
+            stage = handshakeDone;
+            emit ready(this);
+            checkReadyToSend();
+            break;
+        }
+
+        case handshakeDone:
+            break;
+        }
+    }
+    return true;
+}
+
+bool spineMLAsyncConnection::doReadFrames() {
+
+    int header = depth > 1 ? 4 : 0;
+    int valueBytes = floatPayload ? sizeof(float) : sizeof(double);
+
+    // deliver every whole frame that has arrived
+    while (!closed) {
+        int steps = 1;
+        if (header) {
+            if (socket->bytesAvailable() < header) {
+                return true;
+            }
+            quint32 count;
+            socket->peek((char *) &count, header);
+            steps = (int) qFromLittleEndian(count);
+            if (steps < 1 || steps > depth) {
+                fail("Bad timestep count " + QString::number(steps));
+                return false;
+            }
+        }
+        int frameBytes = header + steps*valuesPerStep*valueBytes;
+        if (socket->bytesAvailable() < frameBytes) {
+            return true;
+        }
+        socket->read(recvBuf.data(), frameBytes);
+
+        // hand out a view of the frame's values
+        const double * values;
+        int count = steps*valuesPerStep;
+        if (floatPayload) {
+            const float * f = (const float *) (recvBuf.constData() + header);
+            for (int i = 0; i < count; ++i) {
+                recvValues[i] = (double) f[i];
+            }
+            values = recvValues.constData();
+        } else {
+            // the values follow the 4 byte header, or start the frame,
+            // so are aligned for doubles as far as the platforms we
+            // build on are concerned
+            values = (const double *) (recvBuf.constData() + header);
+        }
+
+        char c = RESP_RECVD;
+        if (!reply(&c, 1)) {
+            return false;
+        }
+        emit framesReceived(this, values, steps);
+    }
+    return true;
+}
+
+bool spineMLAsyncConnection::doReadAcknowledgements() {
+
+    while (!closed && socket->bytesAvailable() > 0) {
+        char c;
+        socket->read(&c, 1);
+        if (c == RESP_ABORT) {
+            fail("Aborted by client");
+            return false;
+        }
+        if (c != RESP_RECVD || !awaitingAck) {
+            fail("Unexpected response " + QString::number(c));
+            return false;
+        }
+        awaitingAck = false;
+    }
+    checkReadyToSend();
+    return true;
+}
+
+spineMLAsyncServer::spineMLAsyncServer(QObject *parent) :
+    QObject(parent)
+{
+    connect(&server, SIGNAL(newConnection()), this, SLOT(acceptConnections()));
+}
+
+bool spineMLAsyncServer::listen(quint16 port) {
+    return server.listen(QHostAddress::Any, port);
+}
+
+void spineMLAsyncServer::close() {
+    server.close();
+    QList <spineMLAsyncConnection *> open = conns;
+    for (int i = 0; i < open.size(); ++i) {
+        open[i]->abort();
+    }
+}
+
+QList <spineMLAsyncConnection *> spineMLAsyncServer::connections() {
+    return conns;
+}
+
+void spineMLAsyncServer::acceptConnections() {
+
+    while (server.hasPendingConnections()) {
+        QTcpSocket * socket = server.nextPendingConnection();
+        spineMLAsyncConnection * conn = new spineMLAsyncConnection(socket, this);
+        conns.push_back(conn);
+        connect(conn, SIGNAL(ready(spineMLAsyncConnection*)), this, SIGNAL(connectionReady(spineMLAsyncConnection*)));
+        connect(conn, SIGNAL(finished(spineMLAsyncConnection*)), this, SLOT(connectionDone(spineMLAsyncConnection*)));
+    }
+}
+
+void spineMLAsyncServer::connectionDone(spineMLAsyncConnection * conn) {
+    conns.removeAll(conn);
+    emit connectionFinished(conn);
+    conn->deleteLater();
+}
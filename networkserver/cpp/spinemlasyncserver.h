@@ -0,0 +1,156 @@
+#ifndef SPINEMLASYNCSERVER_H
+#define SPINEMLASYNCSERVER_H
+
+#include <QObject>
+#include <QList>
+#include <QByteArray>
+#include <QVector>
+
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// the protocol codes and dataTypes
+#include "spinemlnetworkserver.h"
+
+class spineMLAsyncServer;
+
+/*!
+ * One model connection to a spineMLAsyncServer. Unlike
+ * spineMLNetworkServer, which is driven by blocking calls, all of the
+ * handshake and data transfer here happens in slots connected to the
+ * socket's readyRead() and bytesWritten() signals, so many of these can
+ * run on one thread's event loop.
+ *
+ * The send and receive buffers are sized for a whole frame when the
+ * handshake completes, and are reused for every frame after that.
+ * Received timesteps are not copied out: framesReceived() hands out a
+ * pointer into the receive buffer, valid until the slot returns.
+ *
+ * Only analog (nums) connections are accepted.
+ */
+class spineMLAsyncConnection : public QObject {
+Q_OBJECT
+
+public:
+    spineMLAsyncConnection(QTcpSocket * socket, QObject *parent=0);
+    ~spineMLAsyncConnection() {}
+
+    // true once the handshake has completed
+    bool isReady();
+    // true if the model sends us data (it is AM_SOURCE)
+    bool isSource();
+    // true if we send the model data (it is AM_TARGET)
+    bool isTarget();
+    // what the handshake told us
+    QString name();
+    dataTypes dataType();
+    int size();
+    int batchDepth();
+
+    /*!
+     * Send steps timesteps of size() values each, as one frame. Only for
+     * a target, and only when canSend() is true - that is, the last
+     * frame has been written and acknowledged. steps must be between 1
+     * and batchDepth().
+     */
+    bool send(const double * values, int steps);
+    bool canSend();
+
+    // close the connection; finished() follows
+    void abort();
+
+signals:
+    // the handshake completed
+    void ready(spineMLAsyncConnection * conn);
+    // a frame of steps timesteps arrived from a source. values points
+    // into the connection's receive buffer and is only valid during
+    // the call, so connect with Qt::DirectConnection (the default on
+    // one thread)
+    void framesReceived(spineMLAsyncConnection * conn, const double * values, int steps);
+    // a target may be sent its next frame
+    void readyToSend(spineMLAsyncConnection * conn);
+    // the model hung up, or the connection failed
+    void finished(spineMLAsyncConnection * conn);
+
+private slots:
+    void readyToRead();
+    void bytesWritten(qint64 bytes);
+    void disconnected();
+
+private:
+    enum handshakeStage {
+        gettingDirection,
+        gettingDataType,
+        gettingBatchDepth,
+        gettingRingNameLength,
+        gettingRingName,
+        gettingSize,
+        gettingNameLength,
+        gettingName,
+        handshakeDone
+    };
+
+    // returns false if the connection failed
+    bool doHandshake();
+    bool doReadFrames();
+    bool doReadAcknowledgements();
+    bool reply(const char * data, int count);
+    void fail(const QString& why);
+    void checkReadyToSend();
+
+    QTcpSocket * socket;
+    handshakeStage stage;
+
+    char clientDirection;
+    dataTypes type;
+    bool floatPayload;
+    int valuesPerStep;
+    int depth;
+    int nameLength;
+    QString connName;
+
+    // frames on the wire, and the values of a received frame
+    QByteArray recvBuf;
+    QByteArray sendBuf;
+    QVector <double> recvValues;
+
+    // bytes of sendBuf not yet reported by bytesWritten()
+    qint64 unwritten;
+    bool awaitingAck;
+    bool closed;
+};
+
+/*!
+ * A server for SpineML model connections that accepts any number of them
+ * at once and services them all from the event loop. Each incoming
+ * socket is set to low delay (TCP_NODELAY), since every frame is
+ * answered by a one byte acknowledgement before the next.
+ */
+class spineMLAsyncServer : public QObject {
+Q_OBJECT
+
+public:
+    spineMLAsyncServer(QObject *parent=0);
+    ~spineMLAsyncServer() {}
+
+    bool listen(quint16 port);
+    void close();
+    QList <spineMLAsyncConnection *> connections();
+
+signals:
+    // a connection completed its handshake and may be used
+    void connectionReady(spineMLAsyncConnection * conn);
+    // a connection finished; it is deleted once control returns to the
+    // event loop
+    void connectionFinished(spineMLAsyncConnection * conn);
+
+private slots:
+    void acceptConnections();
+    void connectionDone(spineMLAsyncConnection * conn);
+
+private:
+    QTcpServer server;
+    QList <spineMLAsyncConnection *> conns;
+};
+
+#endif // SPINEMLASYNCSERVER_H
@@ -1,4 +1,6 @@
 #include "spinemlnetworkserver.h"
+#include <QtEndian>
+#include <algorithm>
 
 spineMLNetworkServer::spineMLNetworkServer(QTcpServer * server, QObject *parent) :
     QObject(parent)
@@ -7,6 +9,10 @@ spineMLNetworkServer::spineMLNetworkServer(QTcpServer * server, QObject *parent)
     connection = NULL;
     serverType = NOT_SET;
     has_sent = false;
+    batchDepth = 1;
+    floatPayload = false;
+    compactEvents = false;
+    shm = NULL;
 }
 
 bool spineMLNetworkServer::isSource() {
@@ -55,6 +61,15 @@ bool spineMLNetworkServer::getClient() {
 
     qDebug() << "got size";
 
+    // a ring's slots must hold the largest frame; sparse frames vary,
+    // and are checked as they are sent
+    if (shm && dataType == ANALOG && shm->getSlotBytes() < (uint32_t) ((batchDepth > 1 ? 4 : 0)
+            + batchDepth*this->size*(floatPayload ? sizeof(float) : sizeof(double)))) {
+        qDebug() << "Shared memory slots too small for a frame";
+        this->disconnectServer();
+        return false;
+    }
+
     // for debug
     //connect(this->connection, SIGNAL(readyRead()), this, SLOT(readyToRead()));
 
@@ -69,6 +84,11 @@ bool spineMLNetworkServer::connectServer() {
     //qDebug() << "connect";
 
     has_sent = false;
+    batchDepth = 1;
+    floatPayload = false;
+    compactEvents = false;
+    delete shm;
+    shm = NULL;
 
     if (server->isListening() && connection == NULL) {
         connection = server->nextPendingConnection();
@@ -222,6 +242,45 @@ dataTypes spineMLNetworkServer::recvDataType(bool &ok) {
         return ANALOG;
     }
 
+    // the client may first ask for batched frames, or offer shared
+    // memory
+    while (returnVal == REQ_BATCH || returnVal == REQ_SHM) {
+        bool extended = (returnVal == REQ_BATCH) ? recvBatchRequest() : recvSharedMemoryOffer();
+        if (!extended) {
+            disconnectServer();
+            ok = false;
+            return ANALOG;
+        }
+        connection->flush();
+
+        if (!waitForBytes(1, 1000)) {
+            qDebug() << "Timeout reading in recvDataType";
+            disconnectServer();
+            ok = false;
+            return ANALOG;
+        }
+        n = connection->read(&(returnVal),1);
+        if (n < 0) {
+            qDebug() << "Error reading in recvDataType";
+            disconnectServer();
+            ok = false;
+            return ANALOG;
+        }
+    }
+
+    if (returnVal == RESP_DATA_NUMS_FLOAT) {
+        floatPayload = true;
+        returnVal = RESP_DATA_NUMS;
+    }
+    if (returnVal == RESP_DATA_SPIKES_COMPACT) {
+        compactEvents = true;
+        returnVal = RESP_DATA_SPIKES;
+    }
+    if (returnVal == RESP_DATA_IMPULSES_COMPACT) {
+        compactEvents = true;
+        returnVal = RESP_DATA_IMPULSES;
+    }
+
     if (returnVal != RESP_DATA_NUMS && returnVal != RESP_DATA_SPIKES && returnVal != RESP_DATA_IMPULSES){
         qDebug() << "Bad data in recvDataType";
         disconnectServer();
@@ -360,10 +419,72 @@ int spineMLNetworkServer::recvSize(bool &ok) {
 
 }
 
+bool spineMLNetworkServer::recvBatchRequest() {
+
+    quint32 requested;
+    if (!waitForBytes(sizeof(requested), 1000)
+        || connection->read((char *) &requested, sizeof(requested)) != sizeof(requested)) {
+        qDebug() << "Error reading batch depth in recvDataType";
+        return false;
+    }
+    requested = qFromLittleEndian(requested);
+    batchDepth = qBound(1, (int) qMin(requested, (quint32) MAX_BATCH_DEPTH), MAX_BATCH_DEPTH);
+    char reply[5];
+    reply[0] = RESP_RECVD;
+    qToLittleEndian((quint32) batchDepth, (uchar *) reply+1);
+    if (!writeAll(reply, sizeof(reply))) {
+        qDebug() << "Error writing batch depth in recvDataType";
+        return false;
+    }
+    return true;
+}
+
+bool spineMLNetworkServer::recvSharedMemoryOffer() {
+
+    quint32 length;
+    if (!waitForBytes(sizeof(length), 1000)
+        || connection->read((char *) &length, sizeof(length)) != sizeof(length)) {
+        qDebug() << "Error reading ring name length in recvDataType";
+        return false;
+    }
+    length = qFromLittleEndian(length);
+    if (length > SPINEMLSHM_MAX_NAME) {
+        qDebug() << "Ring name too long in recvDataType";
+        return false;
+    }
+    if (!waitForBytes(length, 1000)) {
+        qDebug() << "Timeout reading ring name in recvDataType";
+        return false;
+    }
+    QByteArray name = connection->read(length);
+
+    // attach if we can; if not, the data carry on over the socket
+    delete shm;
+    shm = new SpineMLShmRing;
+    if (shm->attach(std::string(name.constData(), name.size())) != 0) {
+        qDebug() << "Could not attach to shared memory" << name;
+        delete shm;
+        shm = NULL;
+    }
+
+    char reply[2];
+    reply[0] = RESP_RECVD;
+    reply[1] = shm ? 1 : 0;
+    if (!writeAll(reply, sizeof(reply))) {
+        qDebug() << "Error writing ring reply in recvDataType";
+        return false;
+    }
+    return true;
+}
+
 bool spineMLNetworkServer::hasSent() {
     return this->has_sent;
 }
 
+bool spineMLNetworkServer::usesSharedMemory() {
+    return shm != NULL;
+}
+
 bool spineMLNetworkServer::sendData(char * ptr, int size) {
 
     if (!connection) {
@@ -371,11 +492,14 @@ bool spineMLNetworkServer::sendData(char * ptr, int size) {
         return false;
     }
 
+    // with batched frames, float values or shared memory the wire
+    // format differs
+    if (batchDepth > 1 || floatPayload || shm) {
+        return sendFrame((const double *) ptr, this->size > 0 ? size / this->size : 1);
+    }
+
     // send data
-    int sent_bytes = 0;
-    while (sent_bytes < sizeof(double)*size)
-        sent_bytes += connection->write(ptr+sent_bytes,sizeof(double)*size);
-    if (n < 0) {
+    if (!writeAll(ptr, sizeof(double)*size)) {
         qDebug() << "Error writing in sendData";
         disconnectServer();
         return false;
@@ -437,6 +561,12 @@ bool spineMLNetworkServer::recvData(char * data, int size) {
         qDebug() << "No connection";
         return false;
     }
+
+    // with batched frames, float values or shared memory the wire
+    // format differs; data must then hold batchDepth timesteps
+    if (batchDepth > 1 || floatPayload || shm) {
+        return recvFrame((double *) data) > 0;
+    }
     connection->flush();
 
     // if we haven't already bytes in the buffer, then wait until there are some
@@ -482,6 +612,10 @@ bool spineMLNetworkServer::isDataAvailable() {
         return false;
     }
 
+    if (shm) {
+        return shm->canRead();
+    }
+
     return (connection->bytesAvailable() > 0);
 }
 
@@ -492,6 +626,10 @@ bool spineMLNetworkServer::disconnectServer() {
         return false;
     }
 
+    // lets the client know we are done with the ring
+    delete shm;
+    shm = NULL;
+
     connection->close();
     delete connection;
     connection = NULL;
@@ -499,6 +637,364 @@ bool spineMLNetworkServer::disconnectServer() {
     return true;
 }
 
+bool spineMLNetworkServer::waitForBytes(qint64 count, int msecs) {
+
+    while (connection->bytesAvailable() < count) {
+        if (!connection->waitForReadyRead(msecs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool spineMLNetworkServer::writeAll(const char * ptr, qint64 count) {
+
+    qint64 sent_bytes = 0;
+    while (sent_bytes < count) {
+        qint64 w = connection->write(ptr+sent_bytes, count-sent_bytes);
+        if (w < 0) {
+            return false;
+        }
+        sent_bytes += w;
+    }
+    return true;
+}
+
+bool spineMLNetworkServer::sendFrame(const double * values, int steps) {
+
+    if (!connection) {
+        qDebug() << "No connection";
+        return false;
+    }
+
+    if (steps < 1 || steps > batchDepth) {
+        qDebug() << "Bad number of timesteps in sendFrame";
+        return false;
+    }
+
+    // build the frame: the timestep count if batched, then the values;
+    // in the next free slot of the ring, if there is one
+    int header = batchDepth > 1 ? 4 : 0;
+    int count = steps*size;
+    int valueBytes = floatPayload ? sizeof(float) : sizeof(double);
+    char * out;
+    if (shm) {
+        out = shm->beginWrite(1000);
+        if (!out) {
+            qDebug() << "No free shared memory slot in sendFrame";
+            disconnectServer();
+            return false;
+        }
+    } else {
+        wireBuf.resize(header + count*valueBytes);
+        out = wireBuf.data();
+    }
+    if (header) {
+        qToLittleEndian((quint32) steps, (uchar *) out);
+    }
+    if (floatPayload) {
+        float * f = (float *) (out + header);
+        for (int i = 0; i < count; ++i) {
+            f[i] = (float) values[i];
+        }
+    } else {
+        memcpy(out + header, values, count*sizeof(double));
+    }
+
+    if (shm) {
+        // the client frees the slot rather than replying
+        shm->endWrite(header + count*valueBytes);
+        return true;
+    }
+
+    if (!writeAll(wireBuf.constData(), wireBuf.size())) {
+        qDebug() << "Error writing in sendFrame";
+        disconnectServer();
+        return false;
+    }
+
+    connection->waitForBytesWritten();
+
+    has_sent = true;
+
+    return true;
+}
+
+int spineMLNetworkServer::recvFrame(double * values) {
+
+    if (!connection) {
+        qDebug() << "No connection";
+        return -1;
+    }
+
+    if (shm) {
+        return recvSharedMemoryFrame(values);
+    }
+
+    // how many timesteps are in this frame
+    int steps = 1;
+    if (batchDepth > 1) {
+        quint32 count;
+        if (!waitForBytes(sizeof(count), 30)) {
+            return -1;
+        }
+        connection->read((char *) &count, sizeof(count));
+        steps = (int) qFromLittleEndian(count);
+        if (steps < 1 || steps > batchDepth) {
+            qDebug() << "Bad timestep count in recvFrame";
+            disconnectServer();
+            return -1;
+        }
+    }
+
+    // then the values; the rest of the frame follows its header
+    // straight away, so can be waited for
+    int count = steps*size;
+    int valueBytes = floatPayload ? sizeof(float) : sizeof(double);
+    if (!waitForBytes(count*valueBytes, 1000)) {
+        qDebug() << "Timeout reading in recvFrame";
+        disconnectServer();
+        return -1;
+    }
+    if (floatPayload) {
+        wireBuf.resize(count*valueBytes);
+        connection->read(wireBuf.data(), wireBuf.size());
+        const float * f = (const float *) wireBuf.constData();
+        for (int i = 0; i < count; ++i) {
+            values[i] = (double) f[i];
+        }
+    } else {
+        connection->read((char *) values, count*sizeof(double));
+    }
+
+    // one acknowledgement per frame
+    sendVal = RESP_RECVD;
+    if (!writeAll(&sendVal, 1)) {
+        qDebug() << "Error writing in recvFrame";
+        disconnectServer();
+        return -1;
+    }
+
+    connection->waitForBytesWritten();
+
+    return steps;
+}
+
+int spineMLNetworkServer::recvSharedMemoryFrame(double * values) {
+
+    size_t bytes = 0;
+    const char * frame = shm->beginRead(bytes, 30);
+    if (!frame) {
+        if (shm->isClosed()) {
+            disconnectServer();
+        }
+        return -1;
+    }
+
+    int header = batchDepth > 1 ? 4 : 0;
+    int steps = 1;
+    if (header) {
+        steps = (int) qFromLittleEndian<quint32>((const uchar *) frame);
+    }
+    int count = steps*size;
+    int valueBytes = floatPayload ? sizeof(float) : sizeof(double);
+    if (steps < 1 || steps > batchDepth || bytes != (size_t) (header + count*valueBytes)) {
+        qDebug() << "Bad frame in recvFrame";
+        shm->endRead();
+        disconnectServer();
+        return -1;
+    }
+    if (floatPayload) {
+        const float * f = (const float *) (frame + header);
+        for (int i = 0; i < count; ++i) {
+            values[i] = (double) f[i];
+        }
+    } else {
+        memcpy(values, frame + header, count*sizeof(double));
+    }
+
+    // handing the slot back is the acknowledgement
+    shm->endRead();
+
+    return steps;
+}
+
+bool spineMLNetworkServer::sendEvents(const int * indices, const double * values, int count) {
+
+    if (!connection) {
+        qDebug() << "No connection";
+        return false;
+    }
+
+    if (dataType == ANALOG || count < 0 || count > this->size) {
+        qDebug() << "Bad events in sendEvents";
+        return false;
+    }
+    bool withValues = (dataType == IMPULSE);
+
+    // the compact encoding sends each index as the gap from the last,
+    // so needs them in order; values follow their indices
+    std::vector <std::pair <uint32_t, double> > events(count);
+    for (int i = 0; i < count; ++i) {
+        if (indices[i] < 0 || indices[i] >= this->size) {
+            qDebug() << "Bad index in sendEvents";
+            return false;
+        }
+        events[i] = std::make_pair((uint32_t) indices[i], withValues ? values[i] : 1.0);
+    }
+    if (compactEvents) {
+        std::sort(events.begin(), events.end());
+    }
+    std::vector <uint32_t> sortedIndices(count);
+    std::vector <double> sortedValues(count);
+    for (int i = 0; i < count; ++i) {
+        sortedIndices[i] = events[i].first;
+        sortedValues[i] = events[i].second;
+    }
+
+    // one timestep per frame: the count if batched, the length, then
+    // the timestep
+    int header = batchDepth > 1 ? 4 : 0;
+    std::vector <char> frame;
+    if (header) {
+        spineMLPutLE32(frame, 1);
+    }
+    spineMLPutLE32(frame, 0);
+    spineMLEncodeEvents(compactEvents, withValues,
+                        count ? &sortedIndices[0] : NULL, count ? &sortedValues[0] : NULL,
+                        count, frame);
+    qToLittleEndian((quint32) (frame.size() - header - 4), (uchar *) &frame[header]);
+
+    if (shm) {
+        char * out = shm->beginWrite(1000);
+        if (!out || frame.size() > shm->getSlotBytes()) {
+            qDebug() << "No room in shared memory in sendEvents";
+            disconnectServer();
+            return false;
+        }
+        memcpy(out, &frame[0], frame.size());
+        shm->endWrite(frame.size());
+        return true;
+    }
+
+    if (!writeAll(&frame[0], frame.size())) {
+        qDebug() << "Error writing in sendEvents";
+        disconnectServer();
+        return false;
+    }
+
+    connection->waitForBytesWritten();
+
+    has_sent = true;
+
+    return true;
+}
+
+int spineMLNetworkServer::recvEvents(QVector <int> &indices, QVector <double> &values, QVector <int> &counts) {
+
+    if (!connection) {
+        qDebug() << "No connection";
+        return -1;
+    }
+
+    indices.clear();
+    values.clear();
+    counts.clear();
+
+    int header = batchDepth > 1 ? 4 : 0;
+
+    if (shm) {
+        size_t bytes = 0;
+        const char * frame = shm->beginRead(bytes, 30);
+        if (!frame) {
+            if (shm->isClosed()) {
+                disconnectServer();
+            }
+            return -1;
+        }
+        int steps = header ? (int) qFromLittleEndian<quint32>((const uchar *) frame) : 1;
+        quint32 length = bytes >= (size_t) (header + 4)
+                ? qFromLittleEndian<quint32>((const uchar *) frame + header) : 0;
+        bool ok = bytes == header + 4 + length
+                && decodeEvents(frame + header + 4, length, steps, indices, values, counts);
+        shm->endRead();
+        if (!ok) {
+            qDebug() << "Bad frame in recvEvents";
+            disconnectServer();
+            return -1;
+        }
+        return steps;
+    }
+
+    // the frame header: how many timesteps, and how many bytes of them
+    char head[8];
+    if (!waitForBytes(header + 4, 30)) {
+        return -1;
+    }
+    connection->read(head, header + 4);
+    int steps = header ? (int) qFromLittleEndian<quint32>((const uchar *) head) : 1;
+    quint32 length = qFromLittleEndian<quint32>((const uchar *) head + header);
+    bool withValues = (dataType == IMPULSE);
+    if (steps < 1 || steps > batchDepth
+        || length > steps*spineMLSparseMaxBytes(this->size, withValues)) {
+        qDebug() << "Bad frame header in recvEvents";
+        disconnectServer();
+        return -1;
+    }
+
+    if (!waitForBytes(length, 1000)) {
+        qDebug() << "Timeout reading in recvEvents";
+        disconnectServer();
+        return -1;
+    }
+    wireBuf = connection->read(length);
+    if (!decodeEvents(wireBuf.constData(), wireBuf.size(), steps, indices, values, counts)) {
+        qDebug() << "Bad frame in recvEvents";
+        disconnectServer();
+        return -1;
+    }
+
+    // one acknowledgement per frame
+    sendVal = RESP_RECVD;
+    if (!writeAll(&sendVal, 1)) {
+        qDebug() << "Error writing in recvEvents";
+        disconnectServer();
+        return -1;
+    }
+
+    connection->waitForBytesWritten();
+
+    return steps;
+}
+
+bool spineMLNetworkServer::decodeEvents(const char * body, int length, int steps,
+                                        QVector <int> &indices, QVector <double> &values, QVector <int> &counts) {
+
+    if (steps < 1 || steps > batchDepth) {
+        return false;
+    }
+    bool withValues = (dataType == IMPULSE);
+    const char * p = body;
+    const char * end = body + length;
+    std::vector <uint32_t> stepIndices;
+    std::vector <double> stepValues;
+    for (int s = 0; s < steps; ++s) {
+        stepIndices.clear();
+        stepValues.clear();
+        if (!spineMLDecodeEvents(compactEvents, withValues, this->size, p, end, stepIndices, stepValues)) {
+            return false;
+        }
+        counts.push_back(stepIndices.size());
+        for (uint i = 0; i < stepIndices.size(); ++i) {
+            indices.push_back(stepIndices[i]);
+            if (withValues) {
+                values.push_back(stepValues[i]);
+            }
+        }
+    }
+    return p == end;
+}
+
 void spineMLNetworkServer::readyToRead() {
     qDebug() << "Data available";
 }
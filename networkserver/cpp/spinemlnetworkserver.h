@@ -2,21 +2,33 @@
 #define SPINEMLNETWORKSERVER_H
 
 #include <QObject>
+#include <QVector>
 
 #include <QTcpServer>
 #include <QTcpSocket>
 
+// the shared memory ring offered with REQ_SHM; link with -lrt on Linux
+#include "../matlab/SpineMLShmRing.h"
+// the sparse spike and impulse timesteps, and their codes
+#include "../matlab/SpineMLSparse.h"
+
 #define RESP_DATA_NUMS 31
 #define RESP_DATA_SPIKES 32
 #define RESP_DATA_IMPULSES 33
+#define RESP_DATA_NUMS_FLOAT 34
 #define RESP_HELLO 41
 #define RESP_RECVD 42
 #define RESP_ABORT 43
 #define RESP_FINISHED 44
 #define AM_SOURCE 45
 #define AM_TARGET 46
+#define REQ_BATCH 47
+#define REQ_SHM 48
 #define NOT_SET 99
 
+// the most timesteps per frame agreed to when a client sends REQ_BATCH
+#define MAX_BATCH_DEPTH 1024
+
 enum dataTypes {
     ANALOG,
     EVENT,
@@ -42,16 +54,40 @@ public:
     bool sendData(char * ptr, int size);
     bool sendDataConfirm();
     bool recvData(char * data, int size);
+    // send steps timesteps of this->size doubles each as one frame
+    // (see protocol.txt); steps must not exceed batchDepth
+    bool sendFrame(const double * values, int steps);
+    // receive one frame into values, which must hold batchDepth
+    // timesteps; returns the number of timesteps, or -1 on failure
+    int recvFrame(double * values);
+    // for spike and impulse connections (see protocol.txt): send one
+    // timestep of count events as a frame; values are only sent for
+    // impulses, and may be NULL for spikes
+    bool sendEvents(const int * indices, const double * values, int count);
+    // receive one frame of events: the indices (and, for impulses,
+    // values) of all its timesteps back to back, and the number in
+    // each timestep in counts; returns the number of timesteps, or -1
+    // on failure
+    int recvEvents(QVector <int> &indices, QVector <double> &values, QVector <int> &counts);
     bool disconnectServer();
     bool isSource();
     bool isTarget();
     bool isConnected();
     bool isDataAvailable();
     bool hasSent();
+    // true if the frames go through a shared memory ring the client
+    // offered (see protocol.txt) rather than the socket
+    bool usesSharedMemory();
     QTcpServer * server;
 
     dataTypes dataType;
     int size;
+    // timesteps per frame, and whether values are floats on the wire,
+    // as agreed in recvDataType()
+    int batchDepth;
+    bool floatPayload;
+    // spike and impulse timesteps are varint encoded
+    bool compactEvents;
 
 private:
     QTcpSocket * connection;
@@ -60,6 +96,16 @@ private:
     char serverType;
     int n;
     bool has_sent;
+    QByteArray wireBuf;
+    SpineMLShmRing * shm;
+
+    bool recvBatchRequest();
+    bool recvSharedMemoryOffer();
+    int recvSharedMemoryFrame(double * values);
+    bool decodeEvents(const char * body, int length, int steps,
+                      QVector <int> &indices, QVector <double> &values, QVector <int> &counts);
+    bool waitForBytes(qint64 count, int msecs);
+    bool writeAll(const char * ptr, qint64 count);
 
 public slots:
     void readyToRead();
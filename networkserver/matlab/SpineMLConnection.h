@@ -7,13 +7,16 @@
  * This code is used by spinemlnetStart.cpp, a matlab mex function,
  * and friends. spinemlnetStart.cpp creates a main thread which
  * listens for incoming TCP/IP connections. When a new connection is
- * received, the main thread creates a SpineMLConnection object, which
- * has its own thread.
+ * received, the main thread creates a SpineMLConnection object and a
+ * short-lived thread which carries out the handshake. Once the
+ * connection is established, all of its data I/O is done by the main
+ * thread, which poll()s every connection's socket at once and calls
+ * doInputOutput() on those which are ready.
  *
  * This class contains the data relating to the connection; the
  * numbers being transferred to and from the SpineML experiment. It
- * also holds a reference to its thread and manages the handshake and
- * associated information (data direction, type, etc).
+ * also holds a reference to its handshake thread and manages the
+ * handshake and associated information (data direction, type, etc).
  *
  * The connection state starts out as !established and !failed. Once
  * the handshake with the SpineML client is completed, established is
@@ -33,15 +36,23 @@
 #define _SPINEMLCONNECTION_H_
 
 #include <iostream>
-#include <deque>
 #include <vector>
 
 extern "C" {
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <stdint.h>
+#ifdef __linux__
+# include <sys/eventfd.h>
+#endif
 }
 
 #include "SpineMLDebug.h"
+#include "SpineMLDataQueue.h"
+#include "SpineMLShmRing.h"
+#include "SpineMLSparse.h"
 
 using namespace std;
 
@@ -49,12 +60,15 @@ using namespace std;
 #define RESP_DATA_NUMS     31 // a non-printable character
 #define RESP_DATA_SPIKES   32 // ' ' (space)
 #define RESP_DATA_IMPULSES 33 // '!'
+#define RESP_DATA_NUMS_FLOAT 34 // '"' nums sent as 4 byte floats
 #define RESP_HELLO         41 // ')'
 #define RESP_RECVD         42 // '*'
 #define RESP_ABORT         43 // '+'
 #define RESP_FINISHED      44 // ','
 #define AM_SOURCE          45 // '-'
 #define AM_TARGET          46 // '.'
+#define REQ_BATCH          47 // '/' client asks for batched frames
+#define REQ_SHM            48 // '0' client offers a shared memory ring
 #define NOT_SET            99 // 'c'
 
 // SpineML tcp/ip comms data types
@@ -71,6 +85,13 @@ enum dataTypes {
 #define CS_HS_GETTINGNAME       3
 #define CS_HS_DONE              4
 
+// The most timesteps the server agrees to carry in one frame.
+#define MAX_BATCH_DEPTH    1024
+
+// The longest a connection using shared memory waits for a slot, or
+// for matlab to add data, before checking whether it should stop.
+#define SHM_WAIT_MS        100
+
 // How many times to fail to read a byte before calling the session a
 // failure:
 #define NO_DATA_MAX_COUNT     10000
@@ -79,14 +100,106 @@ enum dataTypes {
 #ifdef DATACACHE_MAP_DEFINED
 // We have a "real" data cache object, externally defined, probably in
 // the mex cpp file.
-extern map<string, deque<double>*>* dataCache;
+extern map<string, SpineMLDataQueue*>* dataCache;
 extern pthread_mutex_t dataCacheMutex;
 #else
 // We need a dummy dataCache object.
-map<string, deque<double>*>* dataCache = (map<string, deque<double>*>*)0;
+map<string, SpineMLDataQueue*>* dataCache = (map<string, SpineMLDataQueue*>*)0;
 pthread_mutex_t dataCacheMutex;
 #endif
 
+/*!
+ * Wakes the main thread out of poll() when there is something new for
+ * it to do - matlab has added data for a connection to send, or a
+ * handshake has completed. On Linux this is an eventfd; elsewhere it
+ * is a pipe. Both ends are non-blocking.
+ */
+class SpineMLWakeChannel
+{
+public:
+    SpineMLWakeChannel (void)
+        : readFd (-1)
+        , writeFd (-1)
+        {
+        };
+
+    ~SpineMLWakeChannel()
+        {
+            this->close();
+        };
+
+    /*!
+     * Create the channel. Returns 0 on success, -1 on failure.
+     */
+    int open (void)
+        {
+#ifdef __linux__
+            this->readFd = eventfd (0, EFD_NONBLOCK);
+            this->writeFd = this->readFd;
+            return this->readFd < 0 ? -1 : 0;
+#else
+            int fds[2];
+            if (pipe (fds) != 0) {
+                return -1;
+            }
+            fcntl (fds[0], F_SETFL, fcntl (fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl (fds[1], F_SETFL, fcntl (fds[1], F_GETFL) | O_NONBLOCK);
+            this->readFd = fds[0];
+            this->writeFd = fds[1];
+            return 0;
+#endif
+        };
+
+    void close (void)
+        {
+            if (this->writeFd >= 0 && this->writeFd != this->readFd) {
+                ::close (this->writeFd);
+            }
+            if (this->readFd >= 0) {
+                ::close (this->readFd);
+            }
+            this->readFd = -1;
+            this->writeFd = -1;
+        };
+
+    /*!
+     * Make the read end readable. May be called from any thread. If
+     * the channel is already signalled (a full pipe), the write fails
+     * harmlessly.
+     */
+    void signal (void)
+        {
+            if (this->writeFd < 0) {
+                return;
+            }
+#ifdef __linux__
+            uint64_t one = 1;
+            ssize_t b = write (this->writeFd, &one, sizeof(one));
+#else
+            char one = 1;
+            ssize_t b = write (this->writeFd, &one, 1);
+#endif
+            (void)b;
+        };
+
+    /*!
+     * Clear the signalled state. Main thread only.
+     */
+    void drain (void)
+        {
+            char buf[64];
+            while (read (this->readFd, buf, sizeof(buf)) > 0) {}
+        };
+
+    /*!
+     * The descriptor to poll() for POLLIN.
+     */
+    int readFd;
+
+private:
+    int writeFd;
+};
+
 /*!
  * A connection class. The SpineML client code connects to this server
  * with a separate connection for each stream of data. For example,
@@ -96,17 +209,17 @@ pthread_mutex_t dataCacheMutex;
  * plus information (obtained during the connection handshake) about
  * the data direction, data type and data size.
  *
- * Each one of these connections is expected to run on a separate
- * thread, which means you can use blocking i/o for reading and
- * writing to the network.
+ * The handshake runs on a thread of its own and uses blocking
+ * i/o. After that, doInputOutput() is called from the main thread only
+ * when poll() reports the socket ready, so a read never waits for the
+ * client.
  */
 class SpineMLConnection
 {
 public:
 
     /*!
-     * The constructor initialises some variables and initialises the
-     * data mutex.
+     * The constructor initialises some variables.
      */
     SpineMLConnection()
         : connectingSocket (0)
@@ -119,16 +232,24 @@ public:
         , clientDataDirection (NOT_SET)
         , clientDataType (NOT_SET)
         , clientDataSize (1)
-        , data ((deque<double>*)0)
+        , batchDepth (1)
+        , floatPayload (false)
+        , compactEvents (false)
+        , data ((SpineMLDataQueue*)0)
         , doublebuf ((double*)0)
+        , wirebuf ((char*)0)
+        , frameSteps (0)
+        , bytesRead (0)
+        , sparseLength (0)
         , totalWritten (0)
+        , wake ((SpineMLWakeChannel*)0)
+        , shm ((SpineMLShmRing*)0)
         {
-            pthread_mutex_init (&this->dataMutex, NULL);
         };
 
     /*!
      * The destructor closes the connecting socket (if necessary) then
-     * destroys the data mutex.
+     * frees the data.
      */
     ~SpineMLConnection()
         {
@@ -137,12 +258,17 @@ public:
                      << " in destructor");
                 this->closeSocket();
             }
-            pthread_mutex_destroy(&this->dataMutex);
-            if (this->data != (deque<double>*)0) {
+            if (this->data != (SpineMLDataQueue*)0) {
                 delete this->data;
             }
             if (this->doublebuf != (double*)0) {
-                delete this->doublebuf;
+                delete[] this->doublebuf;
+            }
+            if (this->wirebuf != (char*)0) {
+                delete[] this->wirebuf;
+            }
+            if (this->shm != (SpineMLShmRing*)0) {
+                delete this->shm;
             }
         };
 
@@ -159,6 +285,7 @@ public:
     bool getEstablished (void);
     bool getFailed (void);
     bool getFinished (void);
+    bool getUsesSharedMemory (void);
     //@}
 
     /*!
@@ -173,7 +300,9 @@ public:
     int doHandshake (void);
 
     /*!
-     * If the client has data for us, then read it.
+     * The client has sent us something; read what is there. A
+     * timestep may arrive over several calls, and is acknowledged once
+     * it is complete.
      *
      * Returns 0 on success, -1 on failure and 1 if the connection
      * completed.
@@ -181,47 +310,78 @@ public:
     int doReadFromClient (void);
 
     /*!
-     * If we have data to write, then write it to the client.
+     * As doReadFromClient, for a spike or impulse connection, whose
+     * frames are sparse and vary in length (see protocol.txt). The
+     * events are queued in data as dense timesteps - a 1 for each
+     * neuron which spiked, or the impulse value - so that matlab sees
+     * the same clientDataSize by timesteps matrix as for nums.
+     */
+    int doReadSparseFromClient (void);
+
+    /*!
+     * If readable, read the client's acknowledgement of the last
+     * timestep. Then, if nothing is awaiting acknowledgement and we
+     * have a whole timestep of data, write it to the client.
      *
      * Returns 0 on success, -1 on failure and 1 if the connection
      * completed.
      */
-    int doWriteToClient (void);
+    int doWriteToClient (bool readable);
 
     /*!
-     * Perform input/output with the client. This will call either
-     * doWriteToClient or doReadFromClient.
+     * Perform input/output with the client, given the poll() revents
+     * for its socket (0 if the socket was not polled). This will call
+     * either doWriteToClient or doReadFromClient.
      *
      * Returns 0 on success, -1 on failure and 1 if the connection
      * completed.
      */
-    int doInputOutput (void);
+    int doInputOutput (short revents);
 
     /*!
-     * Close the connecting socket, set the connectingSocket value to
-     * 0 and set established to false.
+     * For a connection whose client offered a shared memory ring
+     * (REQ_SHM), move all of the data through the ring, until the
+     * client finishes or the socket is closed. This is called from the
+     * connection's own thread once the handshake is done, and blocks
+     * on the ring's semaphores; the main thread leaves such a
+     * connection alone.
+     *
+     * Returns 0 when the connection completed, -1 on failure.
      */
-    void closeSocket (void);
+    int doSharedMemoryIO (void);
 
     /*!
-     * Obtain a lock on the data mutex.
+     * The poll() events to wait for on the connecting socket, or 0 if
+     * the socket should not be polled (not established, or finished).
      */
-    void lockDataMutex (void);
+    short getPollEvents (void);
 
     /*!
-     * Release lock on the data mutex.
+     * Whether doInputOutput() could do something without the socket
+     * being ready - a whole timestep is waiting to be sent.
      */
-    void unlockDataMutex (void);
+    bool getHasDataToSend (void);
 
     /*!
-     * Add the double precision number d to the data deque, using
-     * push_back().
+     * Set the channel used to wake the main thread when data are
+     * added or the handshake completes.
+     */
+    void setWakeChannel (SpineMLWakeChannel* w);
+
+    /*!
+     * Close the connecting socket, set the connectingSocket value to
+     * 0 and set established to false.
+     */
+    void closeSocket (void);
+
+    /*!
+     * Add the double precision number d to the data queue.
      */
     void addNum (double& d);
 
     /*!
      * Add dataSize elements from the double array d to the data
-     * deque. Calls push_back dataSize times.
+     * queue, in one copy.
      */
     void addData (const double* d, size_t dataSize);
 
@@ -233,13 +393,25 @@ public:
     size_t getDataSize (void);
 
     /*!
-     * Pop a value from the front of the data deque and return
-     * it. This returns this->data->at(0) and calls
-     * this->data->pop_front();
-     *
-     * May throw std::out_of_range.
+     * Remove up to n values from the front of the data queue, copying
+     * them into out. Returns the number of values copied.
+     */
+    size_t popN (double* out, size_t n);
+
+    /*!
+     * Remove steps whole timesteps, of clientDataSize values each,
+     * from the front of the data queue, putting timestep s at out +
+     * s*stride. This lets several connections fill the rows of one
+     * column major matrix. Returns the number of timesteps copied.
      */
-    double popFront (void);
+    size_t popSteps (double* out, size_t steps, size_t stride);
+
+    /*!
+     * Add steps timesteps of clientDataSize values each to the data
+     * queue, taking timestep s from d + s*stride, and wake the sender
+     * once.
+     */
+    void addSteps (const double* d, size_t steps, size_t stride);
 
 public:
 
@@ -300,7 +472,7 @@ private:
 
     /*!
      * There are 3 possible data types; nums(analog), spikes(events)
-     * or impulses. Only nums implemented.
+     * or impulses. Spikes and impulses travel as sparse timesteps.
      */
     char clientDataType;
 
@@ -311,15 +483,32 @@ private:
     unsigned int clientDataSize;
 
     /*!
-     * A mutex for access to the data deque.
+     * The number of timesteps per frame, agreed during the handshake
+     * if the client sends REQ_BATCH. With a depth of 1, frames are
+     * bare timesteps, as in the original protocol; otherwise each
+     * frame starts with its timestep count (see protocol.txt).
+     */
+    unsigned int batchDepth;
+
+    /*!
+     * Set if the client asked for RESP_DATA_NUMS_FLOAT - values are 4
+     * byte floats on the wire, and doubles everywhere else.
      */
-    pthread_mutex_t dataMutex;
+    bool floatPayload;
 
     /*!
-     * The data which is accessed on the matlab side. This is a double
-     * ended queue, and we use it as a first-in first-out
-     * container. Data coming into the class object is pushed to the
-     * back of the deque; data being retrieved from the object is
+     * Set if the client asked for RESP_DATA_SPIKES_COMPACT or
+     * RESP_DATA_IMPULSES_COMPACT - sparse timesteps are varint and gap
+     * encoded (see SpineMLSparse.h).
+     */
+    bool compactEvents;
+
+    /*!
+     * The data which is accessed on the matlab side. This is a
+     * first-in first-out queue with one producer and one consumer (see
+     * SpineMLDataQueue.h), so neither matlab nor the connection thread
+     * needs a lock to reach it. Data coming into the class object is
+     * pushed to the back; data being retrieved from the object is
      * popped from the front.
      *
      * Note that this is a pointer to the data. The data may be
@@ -329,7 +518,7 @@ private:
      * the instantiation of an object of this class which matches the
      * connection name.
      */
-    std::deque<double>* data;
+    SpineMLDataQueue* data;
 
     /*!
      * A small buffer for use with data comms.
@@ -337,19 +526,130 @@ private:
     char smallbuf[16];
 
     /*!
-     * A buffer used for reading data from the TCP/IP wire. Data is
-     * read into this buffer, then transferred into the deque
-     * data. This buffer is allocated during the connection handshake,
-     * after the data size has been successfully received from the
-     * client.
+     * A buffer holding up to a frame's worth of doubles, on their way
+     * between data and wirebuf. This buffer is allocated during the
+     * connection handshake, after the data size has been successfully
+     * received from the client.
      */
     double* doublebuf;
 
+    /*!
+     * A frame as it is on the TCP/IP wire: the timestep count if
+     * batchDepth > 1, then the values as doubles or floats. Allocated
+     * with doublebuf.
+     */
+    char* wirebuf;
+
+    /*!
+     * The number of timesteps in the frame being read, or 0 while its
+     * count has yet to arrive.
+     */
+    unsigned int frameSteps;
+
+    /*!
+     * How many bytes of the frame being read into wirebuf have
+     * arrived so far.
+     */
+    size_t bytesRead;
+
+    /*!
+     * For a spike or impulse connection: the frame being read or
+     * written, after its header, and the length the header gave for
+     * it. Events of a timestep are gathered in eventIndices and
+     * eventValues on their way to or from the queue.
+     */
+    //@{
+    vector<char> sparsebuf;
+    size_t sparseLength;
+    vector<uint32_t> eventIndices;
+    vector<double> eventValues;
+    //@}
+
     /*!
      * Total bytes of data written to the client (doesn't include any
      * protocol bytes, such as acknowledgements, etc)
      */
     unsigned int totalWritten;
+
+    /*!
+     * The size in bytes of one value on the wire.
+     */
+    size_t valueBytes (void);
+
+    /*!
+     * The size in bytes of a frame header: the timestep count when
+     * frames are batched, nothing otherwise.
+     */
+    size_t headerBytes (void);
+
+    /*!
+     * Whether this is a spike or impulse connection, and the size of
+     * its frame header: the timestep count if batched, then the length
+     * in bytes of the timesteps which follow.
+     */
+    //@{
+    bool isSparse (void);
+    size_t sparseHeaderBytes (void);
+    //@}
+
+    /*!
+     * Pop steps dense timesteps from data and encode them as a whole
+     * sparse frame, header included, in sparsebuf.
+     */
+    void buildSparseFrame (size_t steps);
+
+    /*!
+     * Decode the steps sparse timesteps in body, which is length bytes
+     * long, and push them to data as dense timesteps. Returns false if
+     * the frame is malformed.
+     */
+    bool unpackSparseFrame (const char* body, size_t length, unsigned int steps);
+
+    /*!
+     * Write RESP_RECVD for a frame read from the client. Returns 0 on
+     * success, -1 on failure and 1 if the client has gone.
+     */
+    int acknowledgeFrame (void);
+
+    /*!
+     * Copy n values between doublebuf and the values part of frame
+     * (wirebuf, or a slot of the shared memory ring), converting if
+     * the payload is float.
+     */
+    //@{
+    void unpackValues (const char* frame, size_t n);
+    void packValues (char* frame, size_t n);
+    //@}
+
+    /*!
+     * Read and write 4 byte ints, least significant byte first.
+     */
+    //@{
+    static unsigned int getLE32 (const char* p);
+    static void putLE32 (char* p, unsigned int v);
+    //@}
+
+    /*!
+     * Signalled when the main thread has something new to do for this
+     * connection.
+     */
+    SpineMLWakeChannel* wake;
+
+    /*!
+     * The ring, if the client offered one and we could attach to it,
+     * and the channel on which addData() wakes this connection's
+     * thread when it is using the ring.
+     */
+    //@{
+    SpineMLShmRing* shm;
+    SpineMLWakeChannel shmWake;
+    //@}
+
+    /*!
+     * Wait up to timeoutMs for the socket (or shmWake) to become
+     * readable, and return true if the client has hung up.
+     */
+    bool waitForHangUp (int timeoutMs);
 };
 
 /*!
@@ -401,6 +701,16 @@ SpineMLConnection::getFinished (void)
 {
     return this->finished;
 }
+bool
+SpineMLConnection::getUsesSharedMemory (void)
+{
+    return this->shm != (SpineMLShmRing*)0;
+}
+void
+SpineMLConnection::setWakeChannel (SpineMLWakeChannel* w)
+{
+    this->wake = w;
+}
 //@}
 
 int
@@ -448,8 +758,84 @@ SpineMLConnection::doHandshake (void)
             b = read (this->connectingSocket, (void*)this->smallbuf, 1);
             if (b == 1) {
                 // Got byte.
-                if (this->smallbuf[0] == RESP_DATA_NUMS) {
-                    this->clientDataType = this->smallbuf[0];
+                if (this->smallbuf[0] == REQ_BATCH) {
+                    // The client would like several timesteps per
+                    // frame; read how many, and reply with what we
+                    // agree to. The data type follows.
+                    char depthbuf[5];
+                    if (read (this->connectingSocket, (void*)depthbuf, 4) != 4) {
+                        INFO ("SpineMLConnection::doHandshake: Failed to read batch depth.");
+                        this->failed = true;
+                        return -1;
+                    }
+                    unsigned int requested = getLE32 (depthbuf);
+                    this->batchDepth = requested < 1 ? 1 : requested;
+                    if (this->batchDepth > MAX_BATCH_DEPTH) {
+                        this->batchDepth = MAX_BATCH_DEPTH;
+                    }
+                    depthbuf[0] = RESP_RECVD;
+                    putLE32 (depthbuf+1, this->batchDepth);
+                    if (write (this->connectingSocket, depthbuf, 5) != 5) {
+                        INFO ("SpineMLConnection::doHandshake: "
+                              "Failed to write batch depth to client.");
+                        this->failed = true;
+                        return -1;
+                    }
+                    INFO ("SpineMLConnection::doHandshake: " << this->batchDepth
+                          << " timesteps per frame (client asked for " << requested << ")");
+                    this->noData = 0;
+
+                } else if (this->smallbuf[0] == REQ_SHM) {
+                    // The client is on this host and has made a
+                    // shared memory ring for the data. Read its name
+                    // and try to attach; either way the data type
+                    // follows.
+                    if (read (this->connectingSocket, (void*)this->smallbuf, 4) != 4) {
+                        INFO ("SpineMLConnection::doHandshake: Failed to read ring name length.");
+                        this->failed = true;
+                        return -1;
+                    }
+                    unsigned int nameSize = getLE32 (this->smallbuf);
+                    if (nameSize > SPINEMLSHM_MAX_NAME) {
+                        INFO ("SpineMLConnection::doHandshake: Insanely long ring name ("
+                              << nameSize << " bytes)");
+                        this->failed = true;
+                        return -1;
+                    }
+                    char namebuf[1+nameSize];
+                    if (read (this->connectingSocket, (void*)namebuf, nameSize) != (ssize_t)nameSize) {
+                        INFO ("SpineMLConnection::doHandshake: Failed to read ring name.");
+                        this->failed = true;
+                        return -1;
+                    }
+                    namebuf[nameSize] = '\0';
+                    SpineMLShmRing* ring = new SpineMLShmRing();
+                    if (ring->attach (namebuf) == 0) {
+                        INFO ("SpineMLConnection::doHandshake: Data will go through shared memory '"
+                              << namebuf << "'");
+                        if (this->shm != (SpineMLShmRing*)0) {
+                            delete this->shm;
+                        }
+                        this->shm = ring;
+                    } else {
+                        INFO ("SpineMLConnection::doHandshake: Could not attach to shared memory '"
+                              << namebuf << "'; data will go over TCP/IP.");
+                        delete ring;
+                    }
+                    this->smallbuf[0] = RESP_RECVD;
+                    this->smallbuf[1] = this->shm != (SpineMLShmRing*)0 ? 1 : 0;
+                    if (write (this->connectingSocket, this->smallbuf, 2) != 2) {
+                        INFO ("SpineMLConnection::doHandshake: "
+                              "Failed to write ring reply to client.");
+                        this->failed = true;
+                        return -1;
+                    }
+                    this->noData = 0;
+
+                } else if (this->smallbuf[0] == RESP_DATA_NUMS
+                           || this->smallbuf[0] == RESP_DATA_NUMS_FLOAT) {
+                    this->clientDataType = RESP_DATA_NUMS;
+                    this->floatPayload = (this->smallbuf[0] == RESP_DATA_NUMS_FLOAT);
                     this->smallbuf[0] = RESP_RECVD;
                     if (write (this->connectingSocket, this->smallbuf, 1) != 1) {
                         INFO ("SpineMLConnection::doHandshake: "
@@ -461,11 +847,23 @@ SpineMLConnection::doHandshake (void)
                     this->noData = 0;
 
                 } else if (this->smallbuf[0] == RESP_DATA_SPIKES
-                           || this->smallbuf[0] == RESP_DATA_IMPULSES) {
-                    // These are not yet implemented.
-                    INFO ("SpineMLConnection::doHandshake: Spikes/Impulses not yet implemented.");
-                    this->failed = true;
-                    return -1;
+                           || this->smallbuf[0] == RESP_DATA_SPIKES_COMPACT
+                           || this->smallbuf[0] == RESP_DATA_IMPULSES
+                           || this->smallbuf[0] == RESP_DATA_IMPULSES_COMPACT) {
+                    this->compactEvents = (this->smallbuf[0] == RESP_DATA_SPIKES_COMPACT
+                                           || this->smallbuf[0] == RESP_DATA_IMPULSES_COMPACT);
+                    this->clientDataType = (this->smallbuf[0] == RESP_DATA_SPIKES
+                                            || this->smallbuf[0] == RESP_DATA_SPIKES_COMPACT)
+                        ? RESP_DATA_SPIKES : RESP_DATA_IMPULSES;
+                    this->smallbuf[0] = RESP_RECVD;
+                    if (write (this->connectingSocket, this->smallbuf, 1) != 1) {
+                        INFO ("SpineMLConnection::doHandshake: "
+                              "Failed to write RESP_RECVD to client.");
+                        this->failed = true;
+                        return -1;
+                    }
+                    handshakeStage++;
+                    this->noData = 0;
 
                 } else {
                     // Wrong/unexpected character.
@@ -498,8 +896,22 @@ SpineMLConnection::doHandshake (void)
                 INFO ("SpineMLConnection::doHandshake: client data size: "
                      << this->clientDataSize << " doubles/timestep");
 
-                // Can now allocate doublebuf.
-                this->doublebuf = new double[clientDataSize];
+                // Can now allocate doublebuf and wirebuf, which
+                // hold a frame.
+                this->doublebuf = new double[this->clientDataSize * this->batchDepth];
+                this->wirebuf = new char[this->headerBytes()
+                                         + this->clientDataSize * this->batchDepth * this->valueBytes()];
+
+                // A ring's slots must hold the largest frame. Sparse
+                // frames vary, and are checked as they are sent.
+                if (this->shm != (SpineMLShmRing*)0 && !this->isSparse()
+                    && this->shm->getSlotBytes() < this->headerBytes()
+                    + this->clientDataSize * this->batchDepth * this->valueBytes()) {
+                    INFO ("SpineMLConnection::doHandshake: Shared memory slots of "
+                          << this->shm->getSlotBytes() << " bytes are too small for a frame.");
+                    this->failed = true;
+                    return -1;
+                }
 
                 this->smallbuf[0] = RESP_RECVD;
                 if (write (this->connectingSocket, this->smallbuf, 1) != 1) {
@@ -566,9 +978,9 @@ SpineMLConnection::doHandshake (void)
                 // Now we have the name, lets see if any data has been
                 // supplied for this connection already and stored in
                 // dataCache.
-                if (dataCache != (map<string, deque<double>*>*)0) {
+                if (dataCache != (map<string, SpineMLDataQueue*>*)0) {
                     pthread_mutex_lock (&dataCacheMutex);
-                    map<string, deque<double>*>::iterator entry = dataCache->find(this->clientConnectionName);
+                    map<string, SpineMLDataQueue*>::iterator entry = dataCache->find(this->clientConnectionName);
                     if (entry != dataCache->end()) {
                         INFO ("Using cached data for connection '" << this->clientConnectionName << "'");
                         // Use connectionName->at(this->clientConnectionName).second as data.
@@ -581,13 +993,13 @@ SpineMLConnection::doHandshake (void)
                     } else {
                         // No pre-existing data; allocate new data
                         INFO ("No cached data for connection '" << this->clientConnectionName << "', allocate new store.");
-                        this->data = new deque<double>();
+                        this->data = new SpineMLDataQueue();
                     }
                     pthread_mutex_unlock (&dataCacheMutex);
                 } else {
                     // There's no dataCache object, go straight to allocating new data.
                     INFO ("Allocating new data store for this connection.");
-                    this->data = new deque<double>();
+                    this->data = new SpineMLDataQueue();
                 }
 
                 handshakeStage++;
@@ -619,65 +1031,160 @@ SpineMLConnection::doHandshake (void)
         return -1;
     }
 
-    // This connection is now established:
+    // A connection using shared memory is serviced by its own thread,
+    // which matlab wakes when it adds data.
+    SpineMLWakeChannel* mainWake = this->wake;
+    if (this->shm != (SpineMLShmRing*)0) {
+        if (this->shmWake.open() != 0) {
+            INFO ("SpineMLConnection::doHandshake: Failed to open wake channel.");
+            this->failed = true;
+            return -1;
+        }
+        this->wake = &this->shmWake;
+    }
+
+    // This connection is now established; let the main thread know
+    // it has a new socket to poll.
     this->established = true;
+    if (mainWake != (SpineMLWakeChannel*)0) {
+        mainWake->signal();
+    }
 
     return 0;
 }
 
+size_t
+SpineMLConnection::valueBytes (void)
+{
+    return this->floatPayload ? sizeof(float) : sizeof(double);
+}
+
+size_t
+SpineMLConnection::headerBytes (void)
+{
+    return this->batchDepth > 1 ? 4 : 0;
+}
+
 void
-SpineMLConnection::lockDataMutex (void)
+SpineMLConnection::unpackValues (const char* frame, size_t n)
 {
-    pthread_mutex_lock (&this->dataMutex);
+    const char* values = frame + this->headerBytes();
+    if (!this->floatPayload) {
+        memcpy (this->doublebuf, values, n * sizeof(double));
+        return;
+    }
+    const float* f = (const float*)values;
+    for (size_t i = 0; i < n; ++i) {
+        this->doublebuf[i] = (double)f[i];
+    }
 }
 
 void
-SpineMLConnection::unlockDataMutex (void)
+SpineMLConnection::packValues (char* frame, size_t n)
 {
-    pthread_mutex_unlock (&this->dataMutex);
+    char* values = frame + this->headerBytes();
+    if (!this->floatPayload) {
+        memcpy (values, this->doublebuf, n * sizeof(double));
+        return;
+    }
+    float* f = (float*)values;
+    for (size_t i = 0; i < n; ++i) {
+        f[i] = (float)this->doublebuf[i];
+    }
+}
+
+unsigned int
+SpineMLConnection::getLE32 (const char* p)
+{
+    return (unsigned char)p[0]
+        | (unsigned char)p[1] << 8
+        | (unsigned char)p[2] << 16
+        | (unsigned int)(unsigned char)p[3] << 24;
+}
+
+void
+SpineMLConnection::putLE32 (char* p, unsigned int v)
+{
+    p[0] = (char)(v & 0xff);
+    p[1] = (char)((v >> 8) & 0xff);
+    p[2] = (char)((v >> 16) & 0xff);
+    p[3] = (char)((v >> 24) & 0xff);
 }
 
 int
 SpineMLConnection::doReadFromClient (void)
 {
     // NB: Can't read directly into this->data, as it is not backed by
-    // contiguous memory region.
-    size_t datachunk = sizeof(double)*this->clientDataSize;
-    int b = read (this->connectingSocket, this->doublebuf, datachunk);
+    // contiguous memory region. A frame is read into wirebuf, then
+    // unpacked into doublebuf and from there pushed into data.
+    size_t header = this->headerBytes();
+    if (header == 0) {
+        this->frameSteps = 1;
+    }
+    size_t framechunk = (this->frameSteps == 0)
+        ? header
+        : header + this->frameSteps * this->clientDataSize * this->valueBytes();
+
+    ssize_t b = read (this->connectingSocket,
+                      this->wirebuf + this->bytesRead,
+                      framechunk - this->bytesRead);
     if (b < 0) {
         int theError = errno;
-        INFO ("SpineMLConnection::doReadFromClient: Read wrong number of bytes ("
-              << b << " not " << datachunk << "). errno: "
+        if (theError == EINTR || theError == EAGAIN) {
+            return 0;
+        }
+        INFO ("SpineMLConnection::doReadFromClient: Read failed. errno: "
               << theError);
+        if (theError == ECONNRESET) {
+            return 1;
+        }
         return -1;
-    } else if (b == datachunk) {
-        // Correct amount of data was read. Transfer it into data.
-        this->lockDataMutex();
-        int i = 0;
-        double* p = this->doublebuf;
-        while (i<this->clientDataSize) {
-            this->data->push_back (*p++);
-            ++i;
+    } else if (b == 0) {
+        // The socket was readable but held nothing: the client has
+        // hung up.
+        if (this->bytesRead > 0) {
+            INFO ("SpineMLConnection:doReadFromClient: Client hung up part way through a frame.");
         }
-        this->noData = 0;
-        this->unlockDataMutex();
-    } else if (b == 0 && this->noData < NO_DATA_MAX_COUNT) {
-        ++this->noData;
-        return 0;
-    } else if (b == 0 && this->noData == NO_DATA_MAX_COUNT) {
-        // Nothing was available to read. Need to count up a-la
-        // doWriteToClient and then say "ok, done".
-        INFO ("SpineMLConnection:doReadFromClient: No data available, assume finished.");
+        INFO ("SpineMLConnection:doReadFromClient: Client disconnected, finished.");
         return 1;
     }
 
-    // Now write RESP_RECVD
+    this->bytesRead += b;
+    if (this->bytesRead < framechunk) {
+        // The rest of the frame is still on its way.
+        return 0;
+    }
+
+    if (this->frameSteps == 0) {
+        // We have the header; now we know how long the frame is.
+        this->frameSteps = getLE32 (this->wirebuf);
+        if (this->frameSteps < 1 || this->frameSteps > this->batchDepth) {
+            INFO ("SpineMLConnection::doReadFromClient: Frame of " << this->frameSteps
+                  << " timesteps; the agreed depth is " << this->batchDepth);
+            return -1;
+        }
+        return 0;
+    }
+
+    // A whole frame was read. Transfer it into data.
+    size_t n = this->frameSteps * this->clientDataSize;
+    this->unpackValues (this->wirebuf, n);
+    this->data->push (this->doublebuf, n);
+    this->bytesRead = 0;
+    this->frameSteps = 0;
+
+    return this->acknowledgeFrame();
+}
+
+int
+SpineMLConnection::acknowledgeFrame (void)
+{
     this->smallbuf[0] = RESP_RECVD;
     if (write (this->connectingSocket, this->smallbuf, 1) != 1) {
         int theError = errno;
-        INFO ("SpineMLConnection::doReadFromClient: Failed to write RESP_RECVD to client. errno: "
+        INFO ("SpineMLConnection::acknowledgeFrame: Failed to write RESP_RECVD to client. errno: "
               << theError);
-        if (theError == ECONNRESET) {
+        if (theError == ECONNRESET || theError == EPIPE) {
             // This isn't really an error - it means the client disconnected.
             return 1;
         } else {
@@ -688,49 +1195,180 @@ SpineMLConnection::doReadFromClient (void)
     return 0;
 }
 
+bool
+SpineMLConnection::isSparse (void)
+{
+    return this->clientDataType == RESP_DATA_SPIKES
+        || this->clientDataType == RESP_DATA_IMPULSES;
+}
+
+size_t
+SpineMLConnection::sparseHeaderBytes (void)
+{
+    return this->headerBytes() + 4;
+}
+
+void
+SpineMLConnection::buildSparseFrame (size_t steps)
+{
+    bool withValues = (this->clientDataType == RESP_DATA_IMPULSES);
+    size_t n = steps * this->clientDataSize;
+    this->data->pop (this->doublebuf, n);
+
+    this->sparsebuf.clear();
+    if (this->headerBytes() > 0) {
+        spineMLPutLE32 (this->sparsebuf, (uint32_t)steps);
+    }
+    // The length goes in once the timesteps are encoded.
+    spineMLPutLE32 (this->sparsebuf, 0);
+
+    for (size_t s = 0; s < steps; ++s) {
+        const double* step = this->doublebuf + s * this->clientDataSize;
+        this->eventIndices.clear();
+        this->eventValues.clear();
+        for (unsigned int i = 0; i < this->clientDataSize; ++i) {
+            if (step[i] != 0.0) {
+                this->eventIndices.push_back (i);
+                this->eventValues.push_back (step[i]);
+            }
+        }
+        uint32_t count = (uint32_t)this->eventIndices.size();
+        spineMLEncodeEvents (this->compactEvents, withValues,
+                             count > 0 ? &this->eventIndices[0] : (const uint32_t*)0,
+                             count > 0 ? &this->eventValues[0] : (const double*)0,
+                             count, this->sparsebuf);
+    }
+
+    putLE32 (&this->sparsebuf[this->headerBytes()],
+             (unsigned int)(this->sparsebuf.size() - this->sparseHeaderBytes()));
+}
+
+bool
+SpineMLConnection::unpackSparseFrame (const char* body, size_t length, unsigned int steps)
+{
+    bool withValues = (this->clientDataType == RESP_DATA_IMPULSES);
+    size_t n = steps * this->clientDataSize;
+    memset (this->doublebuf, 0, n * sizeof(double));
+
+    const char* p = body;
+    const char* end = body + length;
+    for (unsigned int s = 0; s < steps; ++s) {
+        this->eventIndices.clear();
+        this->eventValues.clear();
+        if (!spineMLDecodeEvents (this->compactEvents, withValues, this->clientDataSize,
+                                  p, end, this->eventIndices, this->eventValues)) {
+            return false;
+        }
+        double* step = this->doublebuf + s * this->clientDataSize;
+        for (size_t e = 0; e < this->eventIndices.size(); ++e) {
+            if (withValues) {
+                step[this->eventIndices[e]] += this->eventValues[e];
+            } else {
+                step[this->eventIndices[e]] = 1.0;
+            }
+        }
+    }
+    if (p != end) {
+        return false;
+    }
+
+    this->data->push (this->doublebuf, n);
+    return true;
+}
+
 int
-SpineMLConnection::doWriteToClient (void)
+SpineMLConnection::doReadSparseFromClient (void)
+{
+    // A frame arrives in two parts: its header into smallbuf, then
+    // the timesteps, whose length the header gives, into sparsebuf.
+    size_t header = this->sparseHeaderBytes();
+    bool inHeader = this->bytesRead < header;
+    size_t framechunk = inHeader ? header : header + this->sparseLength;
+    char* dest = inHeader
+        ? this->smallbuf + this->bytesRead
+        : &this->sparsebuf[0] + (this->bytesRead - header);
+
+    ssize_t b = read (this->connectingSocket, dest, framechunk - this->bytesRead);
+    if (b < 0) {
+        int theError = errno;
+        if (theError == EINTR || theError == EAGAIN) {
+            return 0;
+        }
+        INFO ("SpineMLConnection::doReadSparseFromClient: Read failed. errno: "
+              << theError);
+        if (theError == ECONNRESET) {
+            return 1;
+        }
+        return -1;
+    } else if (b == 0) {
+        if (this->bytesRead > 0) {
+            INFO ("SpineMLConnection:doReadSparseFromClient: Client hung up part way through a frame.");
+        }
+        INFO ("SpineMLConnection:doReadSparseFromClient: Client disconnected, finished.");
+        return 1;
+    }
+
+    this->bytesRead += b;
+    if (this->bytesRead < framechunk) {
+        return 0;
+    }
+
+    if (inHeader) {
+        this->frameSteps = this->headerBytes() > 0 ? getLE32 (this->smallbuf) : 1;
+        this->sparseLength = getLE32 (this->smallbuf + this->headerBytes());
+        bool withValues = (this->clientDataType == RESP_DATA_IMPULSES);
+        if (this->frameSteps < 1 || this->frameSteps > this->batchDepth
+            || this->sparseLength < this->frameSteps
+            || this->sparseLength > this->frameSteps
+            * spineMLSparseMaxBytes (this->clientDataSize, withValues)) {
+            INFO ("SpineMLConnection::doReadSparseFromClient: Bad frame header ("
+                  << this->frameSteps << " timesteps, " << this->sparseLength << " bytes)");
+            return -1;
+        }
+        this->sparsebuf.resize (this->sparseLength);
+        return 0;
+    }
+
+    if (!this->unpackSparseFrame (&this->sparsebuf[0], this->sparseLength, this->frameSteps)) {
+        INFO ("SpineMLConnection::doReadSparseFromClient: Malformed frame.");
+        return -1;
+    }
+    this->bytesRead = 0;
+    this->frameSteps = 0;
+    this->sparseLength = 0;
+
+    return this->acknowledgeFrame();
+}
+
+int
+SpineMLConnection::doWriteToClient (bool readable)
 {
     DBG2 ("SpineMLConnection::doWriteToClient called");
 
-    // Expect an acknowledgement from the client if we sent data:
-    if (this->unacknowledgedDataSent == true) {
-        DBG2 ("About to read acknowledgement from client...");
-        int b = read (this->connectingSocket, (void*)this->smallbuf, 1);
+    if (readable) {
+        // The client only ever sends us acknowledgements, or hangs up.
+        ssize_t b = read (this->connectingSocket, (void*)this->smallbuf, 1);
         if (b == 1) {
-            // Good; we got data.
-            if (this->smallbuf[0] != RESP_RECVD) {
+            if (this->smallbuf[0] != RESP_RECVD || this->unacknowledgedDataSent == false) {
                 INFO ("SpineMLConnection::doWriteToClient: Wrong response from client.");
                 return -1;
             }
             // Got the acknowledgement, set this to false again:
             this->unacknowledgedDataSent = false;
-            // And reset our noData variable:
-            this->noData = 0;
-
-        } else if (b == 0 && this->noData < NO_DATA_MAX_COUNT) {
-            // No data available yet, so simply return 0; that means
-            // we'll come back to trying to read the acknowledgement
-            // later.
-            DBG2 ("SpineMLConnection::doWriteToClient: No data on wire right now.");
-            this->noData++;
-            return 0;
 
-        } else if (b == 0 && this->noData == NO_DATA_MAX_COUNT) {
-            int theError = errno;
-            INFO ("SpineMLConnection::doWriteToClient: Failed to read RESP_RECVD from client. "
-                  << "Hit max number of tries. errno: " << theError);
-            if (theError == 0) {
-                // Ok, there's just no data.
-                return 1;
-            } else {
-                return -1;
-            }
+        } else if (b == 0) {
+            INFO ("SpineMLConnection::doWriteToClient: Client disconnected after "
+                  << this->totalWritten << " bytes to connection '"
+                  << this->clientConnectionName << "', finished.");
+            return 1;
 
         } else {
             int theError = errno;
+            if (theError == EINTR || theError == EAGAIN) {
+                return 0;
+            }
             INFO ("SpineMLConnection::doWriteToClient: Failed to read 1 byte from client. errno: "
-                 << theError << " bytes read: " << b);
+                 << theError);
             if (theError == ECONNRESET) {
                 // This isn't really an error - it means the client disconnected.
                 return 1;
@@ -738,31 +1376,58 @@ SpineMLConnection::doWriteToClient (void)
                 return -1;
             }
         }
-    } // else we're not waiting for a RESP_RECVD response from the client.
+    }
 
-    // We're going to update some data in memory
-    this->lockDataMutex();
-    if (this->data->size() >= this->clientDataSize) {
+    if (this->unacknowledgedDataSent == true) {
+        // Wait for the acknowledgement before the next timestep.
+        return 0;
+    }
+
+    // Send as many whole timesteps as we have, up to a frame's worth.
+    size_t steps = this->data->size() / this->clientDataSize;
+    if (steps > this->batchDepth) {
+        steps = this->batchDepth;
+    }
+    if (steps > 0) {
 
         // We have enough data to write some to the client:
-        int j = 0;
-        double* p = this->doublebuf;
-        while (j < this->clientDataSize) {
-            *p++ = this->data->at(0);
-            ++j; this->data->pop_front();
+        const char* frame = this->wirebuf;
+        size_t framechunk = 0;
+        if (this->isSparse()) {
+            this->buildSparseFrame (steps);
+            frame = &this->sparsebuf[0];
+            framechunk = this->sparsebuf.size();
+        } else {
+            size_t n = steps * this->clientDataSize;
+            this->data->pop (this->doublebuf, n);
+            if (this->headerBytes() > 0) {
+                putLE32 (this->wirebuf, (unsigned int)steps);
+            }
+            this->packValues (this->wirebuf, n);
+            framechunk = this->headerBytes() + n * this->valueBytes();
+        }
+
+        ssize_t bytesWritten = 0;
+        while (bytesWritten < (ssize_t)framechunk) {
+            ssize_t b = write (this->connectingSocket,
+                               frame + bytesWritten,
+                               framechunk - bytesWritten);
+            if (b < 0 && errno == EINTR) {
+                continue;
+            }
+            if (b <= 0) {
+                break;
+            }
+            bytesWritten += b;
         }
-        ssize_t bytesWritten = write (this->connectingSocket,
-                                      this->doublebuf,
-                                      this->clientDataSize*sizeof(double));
 
-        if (bytesWritten != this->clientDataSize*sizeof(double)) {
+        if (bytesWritten != (ssize_t)framechunk) {
             int theError = errno;
             INFO ("SpineMLConnection::doWriteToClient: Failed. Wrote " << bytesWritten
-                  << " bytes. Tried to write " << (this->clientDataSize*sizeof(double))
+                  << " bytes. Tried to write " << framechunk
                   << ". errno: " << theError);
             // Note: We'll get ECONNRESET (errno 104) when the client
             // has finished its experiment and needs no more data.
-            this->unlockDataMutex();
             return -1;
         } // else carry on
 
@@ -772,31 +1437,13 @@ SpineMLConnection::doWriteToClient (void)
 
         // Set that we now need an acknowledgement from the client:
         this->unacknowledgedDataSent = true;
-
-        this->noData = 0;
-
-    } else {
-        // No more data to write
-        if (this->noData >= NO_DATA_MAX_COUNT) {
-            INFO ("SpineMLConnection::doWriteToClient: "
-                  << "No data left to write to connection '"
-                  << this->clientConnectionName << "', assume finished. Wrote "
-                  << this->totalWritten << " bytes total.");
-            this->unlockDataMutex();
-            return 1;
-        }
-        DBG2 ("No data to write (have " << this->data->size()
-              << " < clientDataSize=" << this->clientDataSize << "). noData = " << this->noData
-              << " is still less than NO_DATA_MAX_COUNT so increment noData.");
-        this->noData++;
     }
-    this->unlockDataMutex();
 
     return 0;
 }
 
 int
-SpineMLConnection::doInputOutput (void)
+SpineMLConnection::doInputOutput (short revents)
 {
     // Check if this is an established connection.
     if (this->established == false) {
@@ -804,11 +1451,15 @@ SpineMLConnection::doInputOutput (void)
         return 0;
     }
 
+    // A hang up or error is reported as readable too, and shows up as
+    // a read of 0 bytes or a failed read.
+    bool readable = (revents & (POLLIN | POLLPRI | POLLHUP | POLLERR)) != 0;
+
     // Update the buffer by reading/writing from network.
     if (this->clientDataDirection == AM_TARGET) {
         // Client is a target, I need to write data to the client, if I have anything to write.
         DBG2 ("SpineMLConnection::doInputOutput: clientDataDirection: AM_TARGET.");
-        int drc = this->doWriteToClient();
+        int drc = this->doWriteToClient (readable);
         if (drc == -1) {
             INFO ("SpineMLConnection::doInputOutput: Error writing to client.");
             this->failed = true;
@@ -824,7 +1475,10 @@ SpineMLConnection::doInputOutput (void)
     } else if (this->clientDataDirection == AM_SOURCE) {
         // Client is a source, I need to read data from the client.
         DBG2 ("SpineMLConnection::doInputOutput: clientDataDirection: AM_SOURCE.");
-        int drc = this->doReadFromClient();
+        if (!readable) {
+            return 0;
+        }
+        int drc = this->isSparse() ? this->doReadSparseFromClient() : this->doReadFromClient();
         if (drc == -1) {
             INFO ("SpineMLConnection::doInputOutput: Error reading from client.");
             this->failed = true;
@@ -846,10 +1500,178 @@ SpineMLConnection::doInputOutput (void)
     return 0;
 }
 
+int
+SpineMLConnection::doSharedMemoryIO (void)
+{
+    size_t header = this->headerBytes();
+
+    while (this->established == true && this->finished == false) {
+
+        if (this->clientDataDirection == AM_SOURCE) {
+            // Take each frame straight out of its slot.
+            size_t n = 0;
+            const char* frame = this->shm->beginRead (n, SHM_WAIT_MS);
+            if (frame != (const char*)0 && this->isSparse()) {
+                unsigned int steps = header > 0 ? getLE32 (frame) : 1;
+                size_t length = n >= this->sparseHeaderBytes()
+                    ? getLE32 (frame + header) : 0;
+                if (steps < 1 || steps > this->batchDepth
+                    || n != this->sparseHeaderBytes() + length
+                    || !this->unpackSparseFrame (frame + this->sparseHeaderBytes(), length, steps)) {
+                    INFO ("SpineMLConnection::doSharedMemoryIO: Bad frame of " << n
+                          << " bytes in shared memory.");
+                    this->shm->endRead();
+                    this->failed = true;
+                    this->finished = true;
+                    return -1;
+                }
+                this->shm->endRead();
+                continue;
+            }
+            if (frame != (const char*)0) {
+                unsigned int steps = header > 0 ? getLE32 (frame) : 1;
+                if (steps < 1 || steps > this->batchDepth
+                    || n != header + steps * this->clientDataSize * this->valueBytes()) {
+                    INFO ("SpineMLConnection::doSharedMemoryIO: Bad frame of " << n
+                          << " bytes in shared memory.");
+                    this->shm->endRead();
+                    this->failed = true;
+                    this->finished = true;
+                    return -1;
+                }
+                size_t count = steps * this->clientDataSize;
+                this->unpackValues (frame, count);
+                this->shm->endRead();
+                this->data->push (this->doublebuf, count);
+                continue;
+            }
+            if (this->shm->isClosed() || this->waitForHangUp (0)) {
+                INFO ("SpineMLConnection::doSharedMemoryIO: Client finished.");
+                this->finished = true;
+            }
+
+        } else if (this->clientDataDirection == AM_TARGET) {
+            // Send as many whole timesteps as we have, up to a frame's
+            // worth, building the frame in its slot.
+            size_t steps = this->data->size() / this->clientDataSize;
+            if (steps > this->batchDepth) {
+                steps = this->batchDepth;
+            }
+            if (steps == 0) {
+                // Wait for matlab to add data, or the client to go.
+                if (this->waitForHangUp (SHM_WAIT_MS)) {
+                    INFO ("SpineMLConnection::doSharedMemoryIO: Client disconnected after "
+                          << this->totalWritten << " bytes to connection '"
+                          << this->clientConnectionName << "', finished.");
+                    this->finished = true;
+                }
+                continue;
+            }
+            char* frame = this->shm->beginWrite (SHM_WAIT_MS);
+            if (frame != (char*)0 && this->isSparse()) {
+                this->buildSparseFrame (steps);
+                if (this->sparsebuf.size() > this->shm->getSlotBytes()) {
+                    INFO ("SpineMLConnection::doSharedMemoryIO: A frame of "
+                          << this->sparsebuf.size() << " bytes will not fit a shared memory slot.");
+                    this->failed = true;
+                    this->finished = true;
+                    return -1;
+                }
+                memcpy (frame, &this->sparsebuf[0], this->sparsebuf.size());
+                this->shm->endWrite (this->sparsebuf.size());
+                this->totalWritten += this->sparsebuf.size();
+                continue;
+            }
+            if (frame != (char*)0) {
+                size_t count = steps * this->clientDataSize;
+                this->data->pop (this->doublebuf, count);
+                if (header > 0) {
+                    putLE32 (frame, (unsigned int)steps);
+                }
+                this->packValues (frame, count);
+                size_t framechunk = header + count * this->valueBytes();
+                this->shm->endWrite (framechunk);
+                this->totalWritten += framechunk;
+                continue;
+            }
+            if (this->shm->isClosed() || this->waitForHangUp (0)) {
+                INFO ("SpineMLConnection::doSharedMemoryIO: Client finished.");
+                this->finished = true;
+            }
+
+        } else {
+            INFO ("SpineMLConnection::doSharedMemoryIO: clientDataDirection has wrong value: "
+                  << (int)this->clientDataDirection);
+            this->failed = true;
+            this->finished = true;
+            return -1;
+        }
+    }
+
+    this->shm->close();
+    return 0;
+}
+
+bool
+SpineMLConnection::waitForHangUp (int timeoutMs)
+{
+    struct pollfd p[2];
+    p[0].fd = this->connectingSocket;
+    p[0].events = POLLIN;
+    p[0].revents = 0;
+    p[1].fd = this->shmWake.readFd;
+    p[1].events = POLLIN;
+    p[1].revents = 0;
+    if (poll (p, 2, timeoutMs) <= 0) {
+        return false;
+    }
+    if (p[1].revents & POLLIN) {
+        this->shmWake.drain();
+    }
+    if (p[0].revents & POLLNVAL) {
+        // The socket was closed under us - we are being stopped.
+        return true;
+    }
+    if (p[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+        // Nothing more is expected on the socket, so a read of 0 bytes
+        // or a failed read means the client has gone.
+        ssize_t b = read (this->connectingSocket, (void*)this->smallbuf, 1);
+        if (b == 0 || (b < 0 && errno != EINTR && errno != EAGAIN)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+short
+SpineMLConnection::getPollEvents (void)
+{
+    if (this->established == false || this->finished == true || this->connectingSocket <= 0
+        || this->shm != (SpineMLShmRing*)0) {
+        return 0;
+    }
+    // Always poll for input, so that a hang up is seen promptly.
+    return POLLIN;
+}
+
+bool
+SpineMLConnection::getHasDataToSend (void)
+{
+    return this->established == true
+        && this->finished == false
+        && this->shm == (SpineMLShmRing*)0
+        && this->clientDataDirection == AM_TARGET
+        && this->unacknowledgedDataSent == false
+        && this->data->size() >= this->clientDataSize;
+}
+
 void
 SpineMLConnection::closeSocket (void)
 {
-    if (close (this->connectingSocket)) {
+    if (this->connectingSocket <= 0) {
+        // Already closed (a connection using shared memory closes its
+        // own socket when it finishes).
+    } else if (close (this->connectingSocket)) {
         int theError = errno;
         INFO ("SpineMLConnection::closeSocket: Error closing connecting socket "
               << this->connectingSocket << ": " << theError);
@@ -867,9 +1689,10 @@ SpineMLConnection::addNum (double& d)
         INFO ("addNum(): connection not yet established or connection failed");
         return;
     }
-    this->lockDataMutex();
-    this->data->push_back (d);
-    this->unlockDataMutex();
+    this->data->push (&d, 1);
+    if (this->wake != (SpineMLWakeChannel*)0) {
+        this->wake->signal();
+    }
 }
 
 void
@@ -879,33 +1702,67 @@ SpineMLConnection::addData (const double* d, size_t dataSize)
         INFO ("addData(): connection not yet established or connection failed");
         return;
     }
-    this->lockDataMutex();
-    size_t i = 0;
-    while (i < dataSize) {
-        this->data->push_back (*d);
-        ++d;
-        ++i;
+    this->data->push (d, dataSize);
+    if (this->wake != (SpineMLWakeChannel*)0) {
+        this->wake->signal();
     }
-    this->unlockDataMutex();
 }
 
 size_t
 SpineMLConnection::getDataSize (void)
 {
-    this->lockDataMutex();
-    size_t sz = this->data->size();
-    this->unlockDataMutex();
-    return sz;
+    if (this->data == (SpineMLDataQueue*)0) {
+        return 0;
+    }
+    return this->data->size();
+}
+
+size_t
+SpineMLConnection::popN (double* out, size_t n)
+{
+    if (this->data == (SpineMLDataQueue*)0) {
+        return 0;
+    }
+    return this->data->pop (out, n);
+}
+
+size_t
+SpineMLConnection::popSteps (double* out, size_t steps, size_t stride)
+{
+    if (this->data == (SpineMLDataQueue*)0) {
+        return 0;
+    }
+    size_t avail = this->data->size() / this->clientDataSize;
+    if (steps > avail) {
+        steps = avail;
+    }
+    if (stride == this->clientDataSize) {
+        // Contiguous; one copy.
+        this->data->pop (out, steps * this->clientDataSize);
+        return steps;
+    }
+    for (size_t s = 0; s < steps; ++s) {
+        this->data->pop (out + s * stride, this->clientDataSize);
+    }
+    return steps;
 }
 
-double
-SpineMLConnection::popFront (void)
+void
+SpineMLConnection::addSteps (const double* d, size_t steps, size_t stride)
 {
-    double rtn;
-    this->lockDataMutex();
-    rtn = this->data->at(0);
-    this->data->pop_front();
-    this->unlockDataMutex();
-    return rtn;
+    if ((!this->established && !this->finished) || this->failed) {
+        INFO ("addSteps(): connection not yet established or connection failed");
+        return;
+    }
+    if (stride == this->clientDataSize) {
+        this->data->push (d, steps * this->clientDataSize);
+    } else {
+        for (size_t s = 0; s < steps; ++s) {
+            this->data->push (d + s * stride, this->clientDataSize);
+        }
+    }
+    if (this->wake != (SpineMLWakeChannel*)0) {
+        this->wake->signal();
+    }
 }
 #endif // _SPINEMLCONNECTION_H_
@@ -0,0 +1,196 @@
+/* -*-c++-*- */
+
+/*
+ * A first-in first-out store of doubles shared by exactly two
+ * threads: one which only adds data (the producer) and one which only
+ * removes data (the consumer).
+ *
+ * For a connection which is an AM_TARGET, the producer is the matlab
+ * thread (spinemlnetAddData) and the consumer is the connection
+ * thread, which writes to the client. For an AM_SOURCE connection,
+ * the roles are reversed and spinemlnetGetData is the consumer.
+ *
+ * The data are held in a chain of fixed size segments. The producer
+ * copies into the last segment and, when that is full, appends a new
+ * one; the consumer copies out of the first segment and frees it once
+ * it has been read to the end. Each segment's fill count and link are
+ * published with release stores and read with acquire loads, so
+ * neither side ever takes a lock, and whole timesteps move with a
+ * memcpy. The chain means an AM_SOURCE connection can keep a whole
+ * run's output until matlab collects it, and matlab can queue a whole
+ * run's input before the experiment starts, without either side ever
+ * having to wait for room.
+ *
+ * Like SpineMLConnection.h, this is header-only so that each mex
+ * function compiles without any linking.
+ */
+
+#ifndef _SPINEMLDATAQUEUE_H_
+#define _SPINEMLDATAQUEUE_H_
+
+#include <cstddef>
+#include <cstring>
+
+// The number of doubles in a segment, unless a single addition is
+// larger than this, in which case that addition gets a segment of its
+// own size.
+#define SPINEMLDATAQUEUE_SEGMENT 65536
+
+// Memory ordering for the values shared between producer and consumer.
+#define SPINEML_LOAD_ACQUIRE(v)     __atomic_load_n (&(v), __ATOMIC_ACQUIRE)
+#define SPINEML_STORE_RELEASE(v, x) __atomic_store_n (&(v), (x), __ATOMIC_RELEASE)
+
+class SpineMLDataQueue
+{
+public:
+    SpineMLDataQueue (void)
+        : pushed (0)
+        , popped (0)
+        , headRead (0)
+        {
+            this->head = this->newSegment (SPINEMLDATAQUEUE_SEGMENT);
+            this->tail = this->head;
+        };
+
+    ~SpineMLDataQueue()
+        {
+            while (this->head != (segment*)0) {
+                segment* next = this->head->next;
+                delete[] this->head->d;
+                delete this->head;
+                this->head = next;
+            }
+        };
+
+    /*!
+     * Append n doubles from d. Producer thread only.
+     */
+    void push (const double* d, size_t n);
+
+    /*!
+     * Copy up to n doubles from the front of the queue into out and
+     * remove them. Returns the number copied, which is less than n if
+     * the queue held fewer. Consumer thread only.
+     */
+    size_t pop (double* out, size_t n);
+
+    /*!
+     * The number of doubles in the queue. May be called from either
+     * thread; the other thread may change it straight afterwards.
+     */
+    size_t size (void);
+
+private:
+
+    struct segment {
+        double* d;
+        size_t capacity;
+        // The number of doubles written into d. Written by the
+        // producer only.
+        size_t written;
+        // The segment after this one, set by the producer only once
+        // written == capacity.
+        segment* next;
+    };
+
+    segment* newSegment (size_t capacity)
+        {
+            segment* s = new segment;
+            s->d = new double[capacity];
+            s->capacity = capacity;
+            s->written = 0;
+            s->next = (segment*)0;
+            return s;
+        };
+
+    /*!
+     * Running totals of doubles added and removed, for size().
+     */
+    //@{
+    size_t pushed;
+    size_t popped;
+    //@}
+
+    /*!
+     * The first segment, and how far into it has been read. Consumer
+     * only.
+     */
+    //@{
+    segment* head;
+    size_t headRead;
+    //@}
+
+    /*!
+     * The last segment. Producer only.
+     */
+    segment* tail;
+};
+
+void
+SpineMLDataQueue::push (const double* d, size_t n)
+{
+    size_t remaining = n;
+    while (remaining > 0) {
+        size_t space = this->tail->capacity - this->tail->written;
+        if (space == 0) {
+            size_t capacity = remaining > SPINEMLDATAQUEUE_SEGMENT ? remaining : SPINEMLDATAQUEUE_SEGMENT;
+            segment* s = this->newSegment (capacity);
+            SPINEML_STORE_RELEASE (this->tail->next, s);
+            this->tail = s;
+            continue;
+        }
+        size_t chunk = remaining < space ? remaining : space;
+        memcpy (this->tail->d + this->tail->written, d, chunk * sizeof(double));
+        SPINEML_STORE_RELEASE (this->tail->written, this->tail->written + chunk);
+        d += chunk;
+        remaining -= chunk;
+    }
+    SPINEML_STORE_RELEASE (this->pushed, this->pushed + n);
+}
+
+size_t
+SpineMLDataQueue::pop (double* out, size_t n)
+{
+    size_t got = 0;
+    while (got < n) {
+        size_t written = SPINEML_LOAD_ACQUIRE (this->head->written);
+        if (written > this->headRead) {
+            size_t chunk = written - this->headRead;
+            if (chunk > n - got) {
+                chunk = n - got;
+            }
+            memcpy (out + got, this->head->d + this->headRead, chunk * sizeof(double));
+            this->headRead += chunk;
+            got += chunk;
+            continue;
+        }
+        // This segment has been read as far as it has been written. If
+        // the producer has moved on, it wrote the last of this segment
+        // before linking the next, so one more look here is enough.
+        segment* next = SPINEML_LOAD_ACQUIRE (this->head->next);
+        if (next == (segment*)0) {
+            break;
+        }
+        if (SPINEML_LOAD_ACQUIRE (this->head->written) > this->headRead) {
+            continue;
+        }
+        delete[] this->head->d;
+        delete this->head;
+        this->head = next;
+        this->headRead = 0;
+    }
+    SPINEML_STORE_RELEASE (this->popped, this->popped + got);
+    return got;
+}
+
+size_t
+SpineMLDataQueue::size (void)
+{
+    // popped is read first: data can be popped before the producer has
+    // counted it in pushed, but never the other way round.
+    size_t out = SPINEML_LOAD_ACQUIRE (this->popped);
+    size_t in = SPINEML_LOAD_ACQUIRE (this->pushed);
+    return in > out ? in - out : 0;
+}
+
+#endif // _SPINEMLDATAQUEUE_H_
@@ -0,0 +1,458 @@
+/* -*-c++-*- */
+
+/*
+ * A ring of frames in POSIX shared memory, for a SpineML client and
+ * server which are running on the same host. The client asks for it
+ * during the handshake with REQ_SHM (see protocol.txt); after that,
+ * every frame which would have gone over TCP/IP is put into a slot of
+ * the ring instead, and the TCP/IP connection carries nothing more
+ * until it is closed.
+ *
+ * The client creates the shared memory object and lays it out; the
+ * server attaches to it by name. The object starts with a
+ * SpineMLShmHeader, then holds a number of slots, each big enough for
+ * one frame exactly as it would be on the wire (the timestep count if
+ * batched, then the values). There is one producer and one consumer:
+ * for an AM_SOURCE client, the client produces; for an AM_TARGET
+ * client, the server produces.
+ *
+ * Two process-shared semaphores in the header count the slots. The
+ * producer waits on free, fills the next slot and posts full; the
+ * consumer waits on full, reads the slot and posts free. Posting free
+ * stands in for RESP_RECVD, so with more than one slot the producer
+ * may run as many frames ahead of the consumer as there are slots.
+ * Either end sets closed, and posts both semaphores, when it is done,
+ * so that the other end is not left waiting; frames already in the
+ * ring can still be read after that.
+ *
+ * The process-shared semaphores are only available on Linux. On other
+ * platforms create() and attach() fail, and a server declines
+ * REQ_SHM, so the client carries on over TCP/IP.
+ *
+ * Like SpineMLConnection.h, this is header-only; its functions are
+ * inline, as the Qt network server in ../cpp includes it from more
+ * than one file. On Linux, link with -lrt.
+ */
+
+#ifndef _SPINEMLSHMRING_H_
+#define _SPINEMLSHMRING_H_
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+extern "C" {
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <semaphore.h>
+}
+
+#ifdef __linux__
+# define SPINEML_SHM_SUPPORTED 1
+#endif
+
+// "SPML", and the layout version, at the start of the shared memory.
+#define SPINEMLSHM_MAGIC   0x4c4d5053
+#define SPINEMLSHM_VERSION 1
+
+// The longest shared memory object name accepted with REQ_SHM.
+#define SPINEMLSHM_MAX_NAME 255
+
+/*!
+ * The start of the shared memory object. The slots follow at
+ * SpineMLShmRing::headerSize().
+ */
+struct SpineMLShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    // The most bytes a slot can hold - the largest frame.
+    uint32_t slotBytes;
+    // Set by either end when it is done with the ring.
+    volatile uint32_t closed;
+    // Frames the producer has put in the ring, ever (wrapping).
+    volatile uint32_t produced;
+    uint32_t reserved[2];
+    // Slots holding a frame, and slots free for one.
+    sem_t full;
+    sem_t free;
+};
+
+class SpineMLShmRing
+{
+public:
+    SpineMLShmRing (void)
+        : base ((char*)0)
+        , mapBytes (0)
+        , header ((SpineMLShmHeader*)0)
+        , writeIndex (0)
+        , readIndex (0)
+        , readCount (0)
+        , creator (false)
+        {
+        };
+
+    ~SpineMLShmRing()
+        {
+            this->detach();
+        };
+
+    /*!
+     * Create the shared memory object name (which should start
+     * with '/'), holding slots slots of slotBytes bytes. This is what
+     * a client does before it sends REQ_SHM. Returns 0 on success, -1
+     * on failure.
+     */
+    int create (const std::string& name, uint32_t slots, uint32_t slotBytes);
+
+    /*!
+     * Attach to the shared memory object name, created by the other
+     * end. Returns 0 on success, -1 on failure.
+     */
+    int attach (const std::string& name);
+
+    /*!
+     * Mark the ring closed, and unmap it. The creator also removes
+     * the name.
+     */
+    void detach (void);
+
+    /*!
+     * Mark the ring closed and wake the other end.
+     */
+    void close (void);
+
+    bool isAttached (void) { return this->header != (SpineMLShmHeader*)0; }
+    bool isClosed (void);
+    uint32_t getSlotBytes (void);
+
+    /*!
+     * The producer's side. beginWrite() waits up to timeoutMs for a
+     * free slot and returns it, or returns 0 if there was none in time
+     * or the ring was closed. Write up to getSlotBytes() bytes into
+     * it, then call endWrite() with the number written.
+     */
+    //@{
+    char* beginWrite (int timeoutMs);
+    void endWrite (size_t n);
+    //@}
+
+    /*!
+     * The consumer's side. beginRead() waits up to timeoutMs for a
+     * full slot and returns it, with its size in n, or returns 0 if
+     * there was none in time or the ring was closed. The slot stays
+     * valid until endRead(), which hands it back to the producer.
+     */
+    //@{
+    const char* beginRead (size_t& n, int timeoutMs);
+    void endRead (void);
+    //@}
+
+    /*!
+     * Whether beginRead() would return a frame straight away.
+     */
+    bool canRead (void);
+
+    /*!
+     * Where the slots start, and how far apart they are. Each slot is
+     * a 4 byte count of the bytes it holds, padded to 8 bytes, then
+     * the frame.
+     */
+    //@{
+    static size_t headerSize (void);
+    static size_t slotStride (uint32_t slotBytes);
+    //@}
+
+private:
+
+    /*!
+     * Wait on s for up to timeoutMs. Returns 0 if s was taken, 1 on
+     * timeout and -1 if the wait failed.
+     */
+    int wait (sem_t* s, int timeoutMs);
+
+    char* slot (uint32_t i);
+
+    char* base;
+    size_t mapBytes;
+    SpineMLShmHeader* header;
+
+    /*!
+     * The next slot to fill (producer) or to read (consumer). Each
+     * end only uses one of these.
+     */
+    //@{
+    uint32_t writeIndex;
+    uint32_t readIndex;
+    //@}
+
+    /*!
+     * Frames the consumer has taken, to tell a frame from the post
+     * made by close().
+     */
+    uint32_t readCount;
+
+    /*!
+     * Set if this end created the object, and so removes its name.
+     */
+    bool creator;
+    std::string shmName;
+};
+
+inline size_t
+SpineMLShmRing::headerSize (void)
+{
+    return (sizeof(SpineMLShmHeader) + 63) & ~(size_t)63;
+}
+
+inline size_t
+SpineMLShmRing::slotStride (uint32_t slotBytes)
+{
+    return 8 + (((size_t)slotBytes + 7) & ~(size_t)7);
+}
+
+inline char*
+SpineMLShmRing::slot (uint32_t i)
+{
+    return this->base + headerSize() + (size_t)i * slotStride (this->header->slotBytes);
+}
+
+inline int
+SpineMLShmRing::create (const std::string& name, uint32_t slots, uint32_t slotBytes)
+{
+#ifdef SPINEML_SHM_SUPPORTED
+    this->detach();
+    if (slots < 1 || slotBytes < 1) {
+        return -1;
+    }
+    shm_unlink (name.c_str());
+    int fd = shm_open (name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t bytes = headerSize() + (size_t)slots * slotStride (slotBytes);
+    if (ftruncate (fd, (off_t)bytes) != 0) {
+        ::close (fd);
+        shm_unlink (name.c_str());
+        return -1;
+    }
+    void* m = mmap (0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (m == MAP_FAILED) {
+        shm_unlink (name.c_str());
+        return -1;
+    }
+
+    this->base = (char*)m;
+    this->mapBytes = bytes;
+    this->header = (SpineMLShmHeader*)m;
+    this->header->slots = slots;
+    this->header->slotBytes = slotBytes;
+    this->header->closed = 0;
+    this->header->produced = 0;
+    if (sem_init (&this->header->full, 1, 0) != 0
+        || sem_init (&this->header->free, 1, slots) != 0) {
+        munmap (m, bytes);
+        shm_unlink (name.c_str());
+        this->base = (char*)0;
+        this->header = (SpineMLShmHeader*)0;
+        return -1;
+    }
+    this->header->version = SPINEMLSHM_VERSION;
+    // The magic goes in last, so that the layout is complete before
+    // anyone can take it for a ring.
+    __atomic_store_n (&this->header->magic, (uint32_t)SPINEMLSHM_MAGIC, __ATOMIC_RELEASE);
+
+    this->creator = true;
+    this->shmName = name;
+    this->writeIndex = 0;
+    this->readIndex = 0;
+    this->readCount = 0;
+    return 0;
+#else
+    (void)name; (void)slots; (void)slotBytes;
+    return -1;
+#endif
+}
+
+inline int
+SpineMLShmRing::attach (const std::string& name)
+{
+#ifdef SPINEML_SHM_SUPPORTED
+    this->detach();
+    int fd = shm_open (name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // The object must at least hold a header which describes slots it
+    // also holds.
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t)st.st_size < headerSize()) {
+        ::close (fd);
+        return -1;
+    }
+    size_t bytes = (size_t)st.st_size;
+    void* m = mmap (0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (m == MAP_FAILED) {
+        return -1;
+    }
+    SpineMLShmHeader* h = (SpineMLShmHeader*)m;
+    if (__atomic_load_n (&h->magic, __ATOMIC_ACQUIRE) != SPINEMLSHM_MAGIC
+        || h->version != SPINEMLSHM_VERSION
+        || h->slots < 1 || h->slotBytes < 1
+        || headerSize() + (size_t)h->slots * slotStride (h->slotBytes) > bytes) {
+        munmap (m, bytes);
+        return -1;
+    }
+
+    this->base = (char*)m;
+    this->mapBytes = bytes;
+    this->header = h;
+    this->creator = false;
+    this->shmName = name;
+    this->writeIndex = 0;
+    this->readIndex = 0;
+    this->readCount = 0;
+    return 0;
+#else
+    (void)name;
+    return -1;
+#endif
+}
+
+inline void
+SpineMLShmRing::close (void)
+{
+    if (this->header == (SpineMLShmHeader*)0) {
+        return;
+    }
+    __atomic_store_n (&this->header->closed, (uint32_t)1, __ATOMIC_RELEASE);
+    sem_post (&this->header->full);
+    sem_post (&this->header->free);
+}
+
+inline void
+SpineMLShmRing::detach (void)
+{
+    if (this->header == (SpineMLShmHeader*)0) {
+        return;
+    }
+    this->close();
+    munmap (this->base, this->mapBytes);
+    if (this->creator) {
+        shm_unlink (this->shmName.c_str());
+    }
+    this->base = (char*)0;
+    this->header = (SpineMLShmHeader*)0;
+    this->mapBytes = 0;
+    this->creator = false;
+}
+
+inline bool
+SpineMLShmRing::isClosed (void)
+{
+    return this->header == (SpineMLShmHeader*)0
+        || __atomic_load_n (&this->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+inline uint32_t
+SpineMLShmRing::getSlotBytes (void)
+{
+    return this->header == (SpineMLShmHeader*)0 ? 0 : this->header->slotBytes;
+}
+
+inline int
+SpineMLShmRing::wait (sem_t* s, int timeoutMs)
+{
+#ifdef SPINEML_SHM_SUPPORTED
+    struct timespec until;
+    clock_gettime (CLOCK_REALTIME, &until);
+    until.tv_sec += timeoutMs / 1000;
+    until.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec += 1;
+        until.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait (s, &until) != 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == ETIMEDOUT ? 1 : -1;
+    }
+    return 0;
+#else
+    (void)s; (void)timeoutMs;
+    return -1;
+#endif
+}
+
+inline char*
+SpineMLShmRing::beginWrite (int timeoutMs)
+{
+    if (this->isClosed() || this->wait (&this->header->free, timeoutMs) != 0) {
+        return (char*)0;
+    }
+    if (this->isClosed()) {
+        // Woken by close(). Leave the post for any other waiter.
+        sem_post (&this->header->free);
+        return (char*)0;
+    }
+    return this->slot (this->writeIndex) + 8;
+}
+
+inline void
+SpineMLShmRing::endWrite (size_t n)
+{
+    char* s = this->slot (this->writeIndex);
+    uint32_t used = (uint32_t)n;
+    memcpy (s, &used, sizeof(used));
+    this->writeIndex = (this->writeIndex + 1) % this->header->slots;
+    __atomic_store_n (&this->header->produced, this->header->produced + 1, __ATOMIC_RELEASE);
+    sem_post (&this->header->full);
+}
+
+const inline char*
+SpineMLShmRing::beginRead (size_t& n, int timeoutMs)
+{
+    if (this->header == (SpineMLShmHeader*)0
+        || this->wait (&this->header->full, timeoutMs) != 0) {
+        return (const char*)0;
+    }
+    // Frames put in before the producer closed the ring are still
+    // read; a post with no frame behind it came from close().
+    if (this->readCount == __atomic_load_n (&this->header->produced, __ATOMIC_ACQUIRE)) {
+        sem_post (&this->header->full);
+        return (const char*)0;
+    }
+    const char* s = this->slot (this->readIndex);
+    uint32_t used;
+    memcpy (&used, s, sizeof(used));
+    n = used > this->header->slotBytes ? this->header->slotBytes : used;
+    return s + 8;
+}
+
+inline void
+SpineMLShmRing::endRead (void)
+{
+    this->readIndex = (this->readIndex + 1) % this->header->slots;
+    ++this->readCount;
+    sem_post (&this->header->free);
+}
+
+inline bool
+SpineMLShmRing::canRead (void)
+{
+    if (this->header == (SpineMLShmHeader*)0) {
+        return false;
+    }
+    return this->readCount != __atomic_load_n (&this->header->produced, __ATOMIC_ACQUIRE);
+}
+
+#endif // _SPINEMLSHMRING_H_
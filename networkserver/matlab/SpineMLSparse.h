@@ -0,0 +1,182 @@
+/* -*-c++-*- */
+
+/*
+ * Encoding and decoding of the sparse timesteps carried by spike
+ * (RESP_DATA_SPIKES) and impulse (RESP_DATA_IMPULSES) connections;
+ * see protocol.txt. A timestep lists only the neurons which spiked,
+ * or which received an impulse, so its size follows the activity
+ * rather than the size of the population.
+ *
+ * In the plain encoding, a timestep is an int count followed by count
+ * ints, the indices (and, for impulses, a double value after each
+ * index). In the compact encoding (RESP_DATA_SPIKES_COMPACT and
+ * RESP_DATA_IMPULSES_COMPACT) the count and the indices are varints -
+ * 7 bits per byte, least significant first, the top bit set on every
+ * byte but the last - and the indices must be in ascending order; each
+ * is sent as the gap from the one before it, less one (the first is
+ * sent as it is). A tightly clustered spike train then costs a byte a
+ * spike.
+ *
+ * Header-only, with inline functions, so that both the mex functions
+ * and the Qt network server in ../cpp can include it.
+ */
+
+#ifndef _SPINEMLSPARSE_H_
+#define _SPINEMLSPARSE_H_
+
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+#define RESP_DATA_SPIKES_COMPACT   35
+#define RESP_DATA_IMPULSES_COMPACT 36
+
+/*!
+ * The most bytes one timestep of count events can take in any of the
+ * encodings.
+ */
+inline size_t
+spineMLSparseMaxBytes (uint32_t count, bool withValues)
+{
+    return 5 + (size_t)count * (5 + (withValues ? sizeof(double) : 0));
+}
+
+inline void
+spineMLPutVarint (std::vector<char>& out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out.push_back ((char)((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back ((char)v);
+}
+
+inline bool
+spineMLGetVarint (const char*& p, const char* end, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        unsigned char b = (unsigned char)*p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void
+spineMLPutLE32 (std::vector<char>& out, uint32_t v)
+{
+    out.push_back ((char)(v & 0xff));
+    out.push_back ((char)((v >> 8) & 0xff));
+    out.push_back ((char)((v >> 16) & 0xff));
+    out.push_back ((char)((v >> 24) & 0xff));
+}
+
+inline uint32_t
+spineMLGetLE32 (const char* p)
+{
+    return (unsigned char)p[0]
+        | (unsigned char)p[1] << 8
+        | (unsigned char)p[2] << 16
+        | (uint32_t)(unsigned char)p[3] << 24;
+}
+
+/*!
+ * Append one timestep of count events to out. values is only read if
+ * withValues (impulses); it may be null for spikes. For the compact
+ * encoding, indices must be ascending.
+ */
+inline void
+spineMLEncodeEvents (bool compact, bool withValues,
+                     const uint32_t* indices, const double* values, uint32_t count,
+                     std::vector<char>& out)
+{
+    if (compact) {
+        spineMLPutVarint (out, count);
+    } else {
+        spineMLPutLE32 (out, count);
+    }
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (compact) {
+            spineMLPutVarint (out, indices[i] - next);
+            next = indices[i] + 1;
+        } else {
+            spineMLPutLE32 (out, indices[i]);
+        }
+        if (withValues) {
+            // Values are sent as they are in memory, like the doubles
+            // of an analog timestep.
+            const char* v = (const char*)&values[i];
+            out.insert (out.end(), v, v + sizeof(double));
+        }
+    }
+}
+
+/*!
+ * Read one timestep from p, moving p past it, and append its events to
+ * indices (and values, if withValues). Returns false if the timestep
+ * runs past end, or holds an index not less than limit.
+ */
+inline bool
+spineMLDecodeEvents (bool compact, bool withValues, uint32_t limit,
+                     const char*& p, const char* end,
+                     std::vector<uint32_t>& indices, std::vector<double>& values)
+{
+    uint32_t count = 0;
+    if (compact) {
+        if (!spineMLGetVarint (p, end, count)) {
+            return false;
+        }
+    } else {
+        if (end - p < 4) {
+            return false;
+        }
+        count = spineMLGetLE32 (p);
+        p += 4;
+    }
+    if (count > limit) {
+        return false;
+    }
+    uint64_t next = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index = 0;
+        if (compact) {
+            uint32_t gap = 0;
+            if (!spineMLGetVarint (p, end, gap)) {
+                return false;
+            }
+            uint64_t at = next + gap;
+            if (at >= limit) {
+                return false;
+            }
+            index = (uint32_t)at;
+            next = at + 1;
+        } else {
+            if (end - p < 4) {
+                return false;
+            }
+            index = spineMLGetLE32 (p);
+            p += 4;
+            if (index >= limit) {
+                return false;
+            }
+        }
+        indices.push_back (index);
+        if (withValues) {
+            if (end - p < (ptrdiff_t)sizeof(double)) {
+                return false;
+            }
+            double v;
+            memcpy (&v, p, sizeof(double));
+            p += sizeof(double);
+            values.push_back (v);
+        }
+    }
+    return true;
+}
+
+#endif // _SPINEMLSPARSE_H_
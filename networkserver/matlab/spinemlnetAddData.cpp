@@ -15,6 +15,20 @@
  * spinemlnetStart, 'realtime' is the name of the connection and the
  * third argument is a one dimensional array of numbers (can be a row
  * or a column vector).
+ *
+ * To feed several connections in one call, pass a cell array of names
+ * and a matrix with a column per timestep, the rows of the first
+ * connection first:
+ *
+ * [rtn errormsg] = spinemlnetAddData (context, {'popA', 'popB'}, data)
+ *
+ * The connections must be established, so that their sizes are known
+ * and the rows can be shared out; the second element of rtn is then
+ * the smallest amount of data in any of them.
+ *
+ * For a spike or impulse connection, the data are still a value per
+ * neuron per timestep: any non-zero value is a spike (or an impulse of
+ * that value), and only those are sent over the network.
  */
 
 #ifdef COMPILE_OCTFILE
@@ -30,7 +44,6 @@ typedef unsigned short char16_t;
 
 #include <iostream>
 #include <map>
-#include <deque>
 #include <string.h>
 
 extern "C" {
@@ -76,7 +89,7 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     val = context(3);
     map<pthread_t, SpineMLConnection*>* connections = (map<pthread_t, SpineMLConnection*>*) val;
     val = context(4);
-    map<string, deque<double>*>* dCache = (map <string, deque<double>*>*) val;
+    map<string, SpineMLDataQueue*>* dCache = (map<string, SpineMLDataQueue*>*) val;
     val = context(5);
     pthread_mutex_t* dCacheMutex = (pthread_mutex_t*) val;
     val = context(6);
@@ -93,7 +106,7 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
     // NB: Don't name this local variable dataCache, else it will
     // clash with the one in the SpineMLConnection class.
-    map<string, deque<double>*>* dCache = (map <string, deque<double>*>*) context[4];
+    map<string, SpineMLDataQueue*>* dCache = (map<string, SpineMLDataQueue*>*) context[4];
     pthread_mutex_t* dCacheMutex = (pthread_mutex_t*)context[5];
 
     // It's very important to get coutMutex set up from the context,
@@ -105,18 +118,41 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
                                // of the thing pointed to by
                                // threadFinished.
 
-    // Get connection name from input arguments.
+    string errormsg("");
+
+    // Get connection name, or a cell array of names, from input arguments.
+    string targetConnection("");
+    vector<string> targetConnections;
 #ifdef COMPILE_OCTFILE
-    string targetConnection = rhs(1).string_value();
+    if (rhs(1).iscellstr()) {
+        Array<std::string> names = rhs(1).cellstr_value();
+        for (octave_idx_type n = 0; n < names.numel(); ++n) {
+            targetConnections.push_back (names(n));
+        }
+    } else {
+        targetConnection = rhs(1).string_value();
+    }
 #else
-    char* targetConn = mxArrayToString(prhs[1]);
-    // Lazily stick the char array into a string, as strings are easier to manipulate.
-    string targetConnection(targetConn); // get from input args
-    mxFree (targetConn);
+    if (mxIsCell (prhs[1])) {
+        size_t nnames = mxGetNumberOfElements (prhs[1]);
+        for (size_t n = 0; n < nnames; ++n) {
+            const mxArray* name = mxGetCell (prhs[1], n);
+            char* targetConn = (name == (const mxArray*)0) ? (char*)0 : mxArrayToString (name);
+            if (targetConn == (char*)0) {
+                errormsg = "Connection names must be strings.";
+                break;
+            }
+            targetConnections.push_back (string (targetConn));
+            mxFree (targetConn);
+        }
+    } else {
+        char* targetConn = mxArrayToString(prhs[1]);
+        // Lazily stick the char array into a string, as strings are easier to manipulate.
+        targetConnection = targetConn; // get from input args
+        mxFree (targetConn);
+    }
 #endif
 
-    string errormsg("");
-
 #ifdef COMPILE_OCTFILE
     const double* inputData = (const double*)0;
 #else
@@ -165,7 +201,45 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     // This will be used to retrieve the amount of data stored in the connection.
     unsigned int connectionDataSize = 0;
 
-    if (!tf && errormsg.empty()) {
+    if (!tf && errormsg.empty() && !targetConnections.empty()) {
+
+        // Several connections: share the rows of each column out
+        // between them, in the order they were named.
+        vector<SpineMLConnection*> matched;
+        size_t rows = 0;
+        for (size_t n = 0; n < targetConnections.size() && errormsg.empty(); ++n) {
+            SpineMLConnection* c = (SpineMLConnection*)0;
+            map<pthread_t, SpineMLConnection*>::iterator connIter = connections->begin();
+            while (connIter != connections->end()) {
+                if (connIter->second->getClientConnectionName() == targetConnections[n]) {
+                    c = connIter->second;
+                    break;
+                }
+                ++connIter;
+            }
+            if (c == (SpineMLConnection*)0 || c->getEstablished() == false) {
+                errormsg = "Connection '" + targetConnections[n] + "' is not established.";
+            } else {
+                matched.push_back (c);
+                rows += c->getClientDataSize();
+            }
+        }
+        if (errormsg.empty() && rows != nrows) {
+            errormsg = "The data have the wrong number of rows for these connections.";
+        }
+        if (errormsg.empty()) {
+            size_t row = 0;
+            for (size_t n = 0; n < matched.size(); ++n) {
+                matched[n]->addSteps (inputData + row, ncols, nrows);
+                row += matched[n]->getClientDataSize();
+                unsigned int sz = matched[n]->getDataSize();
+                if (n == 0 || sz < connectionDataSize) {
+                    connectionDataSize = sz;
+                }
+            }
+        }
+
+    } else if (!tf && errormsg.empty()) {
 
         bool added = false;
 
@@ -191,30 +265,18 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
             // Get dCache mutex
             pthread_mutex_lock (dCacheMutex);
 
-            if (dCache != (map<string, deque<double>*>*)0) {
-                map<string, deque<double>*>::iterator targ = dCache->find (targetConnection);
+            if (dCache != (map<string, SpineMLDataQueue*>*)0) {
+                map<string, SpineMLDataQueue*>::iterator targ = dCache->find (targetConnection);
                 if (targ != dCache->end()) {
                     // We already have data for that connection name; add to it.
-
-                    // targ->second is a deque<double>*. We need a mutex on dataCache.
-                    nrows = 0; // re-use as iterator
-                    while (nrows < inputDataLength) {
-                        targ->second->push_back (*inputData);
-                        ++inputData;
-                        ++nrows;
-                    }
+                    targ->second->push (inputData, inputDataLength);
 
                     INFO ("Inserted data (" << targ->second->size() << " doubles) into existing dataCache entry.");
 
                 } else {
                     // No existing cache of data for targetConnection.
-                    deque<double>* dc = new deque<double>();
-                    nrows = 0; // re-use as iterator
-                    while (nrows < inputDataLength) {
-                        dc->push_back (*inputData);
-                        ++inputData;
-                        ++nrows;
-                    }
+                    SpineMLDataQueue* dc = new SpineMLDataQueue();
+                    dc->push (inputData, inputDataLength);
 
                     dCache->insert (make_pair (targetConnection, dc));
                     INFO ("Inserted data (" << dc->size() << " doubles) into new dataCache entry.");
@@ -11,6 +11,20 @@
  *
  * where context is the SpineMLNet context structure, as created by
  * spinemlnetStart and 'realtime' is the name of the connection.
+ *
+ * Each column of the matrix is a timestep, and all of the whole
+ * timesteps buffered for the connection are returned. To collect
+ * several connections in one call, pass a cell array of names:
+ *
+ * alldata = spinemlnetGetData (context, {'popA', 'popB'});
+ *
+ * The rows of popA's data then come first, followed by popB's, and the
+ * matrix has as many timesteps as every one of the connections has
+ * buffered; any more are left for the next call.
+ *
+ * For a spike connection, each column holds a 1 for each neuron which
+ * spiked in that timestep; for impulses, the impulse values. Both are
+ * sent sparsely over the network (see protocol.txt).
  */
 
 #ifdef COMPILE_OCTFILE
@@ -26,7 +40,6 @@ typedef unsigned short char16_t;
 
 #include <iostream>
 #include <map>
-#include <deque>
 #include <string.h>
 #include <stdexcept>
 
@@ -83,97 +96,122 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 #endif
     bool tf = *threadFinished;
 
-    // Get connection name from input arguments.
+    string errormsg("");
+    bool gotdata = false, gotmatch = false, notready = false;
+
+    // Get connection names from input arguments; either a string or a
+    // cell array of strings.
+    vector<string> targetConnections;
 #ifdef COMPILE_OCTFILE
-    string targetConnection = rhs(1).string_value();
+    if (rhs(1).iscellstr()) {
+        Array<std::string> names = rhs(1).cellstr_value();
+        for (octave_idx_type n = 0; n < names.numel(); ++n) {
+            targetConnections.push_back (names(n));
+        }
+    } else {
+        targetConnections.push_back (rhs(1).string_value());
+    }
 #else
-    char* targetConn = mxArrayToString(prhs[1]);
-    string targetConnection(targetConn);
-    mxFree (targetConn);
+    if (mxIsCell (prhs[1])) {
+        size_t nnames = mxGetNumberOfElements (prhs[1]);
+        for (size_t n = 0; n < nnames; ++n) {
+            const mxArray* name = mxGetCell (prhs[1], n);
+            char* targetConn = (name == (const mxArray*)0) ? (char*)0 : mxArrayToString (name);
+            if (targetConn == (char*)0) {
+                errormsg = "Connection names must be strings.";
+                break;
+            }
+            targetConnections.push_back (string (targetConn));
+            mxFree (targetConn);
+        }
+    } else {
+        char* targetConn = mxArrayToString(prhs[1]);
+        targetConnections.push_back (string (targetConn));
+        mxFree (targetConn);
+    }
 #endif
-
-    string errormsg("");
-    unsigned int connectionDataSize = 0;
-    bool gotdata = false, gotmatch = false, notready = false;
+    if (targetConnections.empty() && errormsg.empty()) {
+        errormsg = "No connection names given.";
+    }
 
 #ifdef COMPILE_OCTFILE
     NDArray lhs;
 # ifdef ANNOUNCE_VERSION
-    INFO ("octfile-version of getdata for target connection '" << targetConnection << "'....");
+    INFO ("octfile-version of getdata for target connection '" << targetConnections[0] << "'....");
 # endif
 #endif
 
-    if (!tf) {
+    if (!tf && errormsg.empty()) {
 
-        // First, see if we can add the inputData to a connection.
-        map<pthread_t, SpineMLConnection*>::iterator connIter = connections->begin();
-        if (connIter == connections->end()) {
+        if (connections->empty()) {
             errormsg = "No connections available.";
         }
-        while (connIter != connections->end()) {
-            if (connIter->second->getClientConnectionName() == targetConnection) {
-
-                DBG2 ("Matched connection!");
-                gotmatch = true;
-
-                // Test if the connection is neither established nor
-                // finished, in which case it's a matched connection
-                // which is not yet ready to return data.
-                if (connIter->second->getEstablished() == false
-                    && connIter->second->getFinished() == false) {
-                    // We got a matched connection, but it's not ready yet, so break out.
-                    notready = true;
+
+        // Find every named connection, and how many whole timesteps
+        // all of them have.
+        vector<SpineMLConnection*> matched;
+        unsigned int matrixRows = 0;
+        size_t matrixCols = 0;
+        for (size_t n = 0; n < targetConnections.size() && errormsg.empty(); ++n) {
+            SpineMLConnection* c = (SpineMLConnection*)0;
+            map<pthread_t, SpineMLConnection*>::iterator connIter = connections->begin();
+            while (connIter != connections->end()) {
+                if (connIter->second->getClientConnectionName() == targetConnections[n]) {
+                    DBG2 ("Matched connection!");
+                    c = connIter->second;
                     break;
                 }
+                ++connIter;
+            }
+            if (c == (SpineMLConnection*)0) {
+                gotmatch = false;
+                break;
+            }
+            gotmatch = true;
+
+            // Test if the connection is neither established nor
+            // finished, in which case it's a matched connection
+            // which is not yet ready to return data.
+            if (c->getEstablished() == false && c->getFinished() == false) {
+                notready = true;
+                break;
+            }
 
-                // Find out how much data there is in the matched connection.
-                connectionDataSize = connIter->second->getDataSize();
-                DBG2 ("connectionDataSize: " << connectionDataSize);
-                // We'll make a clientDataSize by connectionDataSize/clientDataSize matrix.
-                unsigned int matrixRows = connIter->second->getClientDataSize();
-                unsigned int matrixCols = connectionDataSize/matrixRows;
-                DBG2 ("rows: " << matrixRows << " cols: " << matrixCols);
-                // Now need to copy this data into our output.
-                unsigned int i = 0;
+            size_t steps = c->getDataSize() / c->getClientDataSize();
+            if (matched.empty() || steps < matrixCols) {
+                matrixCols = steps;
+            }
+            matrixRows += c->getClientDataSize();
+            matched.push_back (c);
+        }
+        DBG2 ("rows: " << matrixRows << " cols: " << matrixCols);
+
+        if (errormsg.empty() && !notready && matched.size() == targetConnections.size()
+            && matrixCols > 0) {
+            // The matrix is column major, one timestep per column. Each
+            // connection's timesteps are queued in that order, so fill
+            // its rows of every column straight from its queue; with
+            // one connection, that is a single copy.
+            double* outPtr = (double*)0;
 #ifdef COMPILE_OCTFILE
-                dim_vector datadv(1, 2);
-                datadv(0) = matrixRows; datadv(1) = matrixCols;
-                lhs.resize(datadv);
-                octave_idx_type row_idx = 0;
-                octave_idx_type col_idx = 0;
-                while (i < connectionDataSize && col_idx < matrixCols) {
-                    while (i < connectionDataSize && row_idx < matrixRows) {
-                        lhs (row_idx, col_idx) = connIter->second->popFront();
-                        ++i; ++row_idx;
-                    }
-                    ++col_idx;
-                    row_idx = 0;
-                }
+            dim_vector datadv(1, 2);
+            datadv(0) = matrixRows; datadv(1) = matrixCols;
+            lhs.resize(datadv);
+            outPtr = lhs.fortran_vec();
 #else
-                const mwSize res[2] = { (int)matrixRows, (int)matrixCols };
-                plhs[0] = mxCreateNumericArray (2, res, mxDOUBLE_CLASS, mxREAL);
-                // set up a pointer to the output array
-                double* outPtr = (double*) mxGetData (plhs[0]); // plhs[0] is an mxArray.
-                // copy new data into the output structure
-                while (i < connectionDataSize) {
-                    try {
-                        // This just works, whatever the dimensionality of the matrix:
-                        *outPtr++ = connIter->second->popFront();
-                    } catch (std::out_of_range& e) {
-                        break;
-                    }
-                    ++i;
-                }
+            const mwSize res[2] = { (mwSize)matrixRows, (mwSize)matrixCols };
+            plhs[0] = mxCreateNumericArray (2, res, mxDOUBLE_CLASS, mxREAL);
+            outPtr = (double*) mxGetData (plhs[0]); // plhs[0] is an mxArray.
 #endif
-                if (i>0) {
-                    gotdata = true;
-                }
-                break;
+            size_t row = 0;
+            for (size_t n = 0; n < matched.size(); ++n) {
+                matched[n]->popSteps (outPtr + row, matrixCols, matrixRows);
+                row += matched[n]->getClientDataSize();
             }
-            ++connIter;
+            gotdata = true;
         }
 
-    } else {
+    } else if (tf) {
         errormsg = "Can't get data; the main thread has finished.";
     }
 
@@ -14,7 +14,6 @@ typedef unsigned short char16_t;
 
 #include <iostream>
 #include <map>
-#include <deque>
 #include <vector>
 #include <stdexcept>
 
@@ -47,7 +46,8 @@ using namespace std;
 // dataCache pointer will be instantiated at global scope.
 //
 #define DATACACHE_MAP_DEFINED 1
-map<string, deque<double>*>* dataCache;
+#include "SpineMLDataQueue.h"
+map<string, SpineMLDataQueue*>* dataCache;
 pthread_mutex_t dataCacheMutex;
 
 // A mutex to keep our dbg output messages from being garbled.
@@ -63,10 +63,19 @@ pthread_mutex_t* coutMutex;
 #define LISTENQ 1024
 
 // The thread handle. This is the main server thread. Each incoming
-// connection then gets its own thread in addition to this one. This
-// global handle is accessed from other mex functions via its address.
+// connection gets a thread of its own for the handshake; after that
+// this thread does all the connections' I/O. This global handle is
+// accessed from other mex functions via its address.
 pthread_t thread;
 
+// Wakes the main thread from poll() when matlab adds data or a
+// handshake completes. Given to each connection.
+SpineMLWakeChannel wakeChannel;
+
+// The longest the main thread waits in poll() before checking
+// stopRequested and tidying up finished connections.
+#define POLL_TIMEOUT_MS 100
+
 // Server state flags
 volatile bool stopRequested;          // User requested stop from matlab space
 volatile bool connectionsFinished;    // All running connections completed.
@@ -180,119 +189,146 @@ int initServer (void)
 }
 
 /*!
- * Code executed for each accepted connection.
+ * Code executed for each accepted connection: carry out the
+ * handshake, then leave the connection to the main thread. A
+ * connection whose data go through shared memory is instead serviced
+ * here until it finishes.
  */
-void* connectionThread (void*)
+void* connectionThread (void* conn)
 {
     INFO ("start-connectionThread: New thread starting.");
 
-    /*
-     * First job is to get connected - that is to complete the handshake.
-     */
-    pthread_t myThread = pthread_self(); // Figure out own thread ID to get correct connection.
-    SpineMLConnection* c;
-
-    // spin until connection got added to connections. See ***
-    bool setup = false;
-    while (!setup) {
-        try {
-            c = (*connections)[myThread];
-            setup = true;
-        } catch (const exception& e) {
-            INFO ("start-connectionThread: No connection for myThread ("
-                  << (long unsigned int*)myThread << ") yet...");
-        }
-        usleep (1000);
-    }
-
-    while (!stopRequested) {
+    SpineMLConnection* c = (SpineMLConnection*)conn;
 
-        // Is the connection established?
-        if (!c->getEstablished()) {
-
-            // Yes, it is established.
-            if (c->doHandshake() < 0) {
-                INFO ("start-pollForConnection: Failed to complete SpineML handshake.");
-                // Close the socket to clean up
-                c->closeSocket();
-                break;
-            }
-            INFO ("start-pollForConnection: Completed handshake.");
-
-        } else {
-
-            // Now do data I/O
-            int retval = c->doInputOutput();
-            if (retval == -1) {
-                // Read or write to that connection failed. Do we now set stopRequested true?
-                INFO ("start-connectionThread: doInputOutput failed for thread 0x"
-                     << hex << (unsigned long long int)myThread << dec);
-                c->closeSocket();
-                break;
-            } else if (retval == 1) {
-                // Connection finished; client disconnected.
-                INFO ("start-connectionThread: Connection "
-                      << c->getClientConnectionName() << " finished.");
-                c->closeSocket();
-                break;
+    if (c->doHandshake() < 0) {
+        INFO ("start-connectionThread: Failed to complete SpineML handshake.");
+        // Close the socket to clean up
+        c->closeSocket();
+    } else {
+        INFO ("start-connectionThread: Completed handshake.");
+        if (c->getUsesSharedMemory()) {
+            if (c->doSharedMemoryIO() < 0) {
+                INFO ("start-connectionThread: Shared memory I/O failed for connection "
+                      << c->getClientConnectionName());
             }
+            c->closeSocket();
         }
-
-        // Sleep to allow the octave environment some CPU time to do
-        // anything it needs to do (such as gaining a lock on the data
-        // in spinemlnetAddData)
-        usleep (100);
     }
 
     return NULL;
 }
 
 /*!
- * Poll for a connection on listening socket. If one is found, do the
- * handshake and create an entry in the connections map.
+ * Accept a connection on listening socket, which poll() has reported
+ * as readable. Create an entry in the connections map and start the
+ * thread which does the handshake.
  */
-int pollForConnection (int& listening_socket, struct pollfd& p)
+int acceptConnection (int& listening_socket)
 {
-    int retval = 0;
-    p.revents = 0;
-    if ((retval = poll (&p, 1, 0)) == -1) {
+    int connecting_socket = accept (listening_socket, NULL, NULL);
+    if (connecting_socket < 0) {
         int theError = errno;
-        INFO ("start-pollForConnection: error with poll(), errno: "
+        INFO ("start-acceptConnection: Failed to accept on listening socket. errno: "
              << theError);
         return -1;
-    } // else 0 or +ve return from poll() is ok.
-
-    if (p.revents & POLLIN || p.revents & POLLPRI) {
-        // Data is ready to read...
-        int connecting_socket = accept (listening_socket, NULL, NULL);
-        if (connecting_socket < 0) {
-            int theError = errno;
-            INFO ("start-pollForConnection: Failed to accept on listening socket. errno: "
-                 << theError);
-            return -1;
-        } // else connected ok.
+    } // else connected ok.
+
+    // Create a new connection instance and insert it into our map container
+    SpineMLConnection* c = new SpineMLConnection();
+    c->setConnectingSocket (connecting_socket);
+    c->setWakeChannel (&wakeChannel);
+
+    // Create a thread for this connection's handshake
+    int rtn = pthread_create (&c->thread, NULL, &connectionThread, c);
+    if (rtn != 0) {
+        INFO ("start-acceptConnection: Failed to create connection thread.");
+        delete c;
+        return -1;
+    }
+    connections->insert (make_pair (c->thread, c));
 
-        // Create a new connection instance and insert it into our map container
-        SpineMLConnection* c = new SpineMLConnection();
-        c->setConnectingSocket (connecting_socket);
+    INFO ("start-acceptConnection: Accepted a connection.");
 
-        // Create a thread for this connection to operate in
-        int rtn = pthread_create (&c->thread, NULL, &connectionThread, NULL);
-        if (rtn < 0) {
-            INFO ("start-pollForConnection: Failed to create connection thread.");
-            return -1;
+    // Reset this flag (it may have been set to true when all
+    // previous connections finished).
+    connectionsFinished = false;
+
+    return 0;
+}
+
+/*!
+ * Wait until the listening socket, the wake channel or any
+ * established connection is ready, or POLL_TIMEOUT_MS passes, then
+ * service whatever is ready. This replaces polling each of them in
+ * turn with sleeps in between, so a timestep is passed on as soon as
+ * it arrives.
+ */
+int serviceSockets (int& listening_socket)
+{
+    vector<struct pollfd> fds;
+    vector<SpineMLConnection*> polled;
+
+    struct pollfd p;
+    p.fd = listening_socket;
+    p.events = POLLIN|POLLPRI;
+    p.revents = 0;
+    fds.push_back (p);
+    p.fd = wakeChannel.readFd;
+    p.events = POLLIN;
+    fds.push_back (p);
+
+    // A connection with a timestep ready to send need not wait for its
+    // socket.
+    int timeout = POLL_TIMEOUT_MS;
+    map<pthread_t, SpineMLConnection*>::iterator connIter = connections->begin();
+    while (connIter != connections->end()) {
+        SpineMLConnection* c = connIter->second;
+        short events = c->getPollEvents();
+        if (events != 0) {
+            p.fd = c->getConnectingSocket();
+            p.events = events;
+            fds.push_back (p);
+            polled.push_back (c);
+            if (c->getHasDataToSend()) {
+                timeout = 0;
+            }
         }
-        connections->insert (make_pair (c->thread, c)); // *** connectionThread needs to wait until
-                                                        // this insert completes before getting on
-                                                        // with its business.
+        ++connIter;
+    }
 
-        INFO ("start-pollForConnection: Accepted a connection.");
+    int retval = poll (&fds[0], fds.size(), timeout);
+    if (retval == -1) {
+        int theError = errno;
+        if (theError == EINTR) {
+            return 0;
+        }
+        INFO ("start-serviceSockets: error with poll(), errno: " << theError);
+        return -1;
+    }
 
-        // Reset this flag (it may have been set to true when all
-        // previous connections finished).
-        connectionsFinished = false;
+    if (fds[1].revents & POLLIN) {
+        wakeChannel.drain();
+    }
 
-    } // else no new connections available on the listening socket
+    for (unsigned int i = 0; i < polled.size(); ++i) {
+        SpineMLConnection* c = polled[i];
+        int rtn = c->doInputOutput (fds[i+2].revents);
+        if (rtn == -1) {
+            INFO ("start-serviceSockets: doInputOutput failed for connection "
+                  << c->getClientConnectionName());
+            c->closeSocket();
+        } else if (rtn == 1) {
+            INFO ("start-serviceSockets: Connection "
+                  << c->getClientConnectionName() << " finished.");
+            c->closeSocket();
+        }
+    }
+
+    if (fds[0].revents & (POLLIN|POLLPRI)) {
+        if (acceptConnection (listening_socket) != 0) {
+            return -1;
+        }
+    }
 
     return 0;
 }
@@ -312,9 +348,10 @@ void cleanupFailedConnections (void)
             // deallocate the SpineMLConnection object
             delete connectionsIter->second;
             // Remove pointer from map
-            connections->erase (connectionsIter);
+            connections->erase (connectionsIter++);
+        } else {
+            ++connectionsIter;
         }
-        ++connectionsIter;
     }
 }
 
@@ -387,12 +424,14 @@ void* theThread (void* nothing)
         threadFinished = true;
         return NULL;
     }
-    // We poll for activity on the connection, so that if the user
-    // Ctrl-Cs we don't block on an accept() call.
-    struct pollfd p;
-    p.fd = listening_socket;
-    p.events = POLLIN|POLLPRI;
-    p.revents = 0;
+    if (wakeChannel.open() != 0) {
+        INFO ("start-theThread: Failed to create the wake channel.");
+        closeSocket (listening_socket);
+        threadFinished = true;
+        return NULL;
+    }
+    // We poll for activity on the sockets with a timeout, so that if
+    // the user Ctrl-Cs we don't block on an accept() call.
     int retval = 0;
 
     // The main thread is now initialised.
@@ -401,9 +440,9 @@ void* theThread (void* nothing)
     // loop until we get the termination signal
     while (!stopRequested /* && !connectionsFinished*/) {
 
-        // First job in the loop is to see if we have any more
-        // connections coming in from the client.
-        retval = pollForConnection (listening_socket, p);
+        // First job in the loop is to wait for, then handle, data
+        // from or for the client and any more connections coming in.
+        retval = serviceSockets (listening_socket);
         if (retval != 0) {
             threadFinished = true;
             return NULL;
@@ -418,8 +457,6 @@ void* theThread (void* nothing)
         // with. Matlab env can then request stop (or user can ctrl-c)
         checkForAllFinished();
 
-        usleep (10000);
-
     } // while (!stopRequested && !connectionsFinished)
 
     // After finishing, if any connections are AM_SOURCE connections,
@@ -444,6 +481,7 @@ void* theThread (void* nothing)
     deleteConnections();
     INFO("Connections all deleted, now close listening socket " << listening_socket);
     closeSocket (listening_socket);
+    wakeChannel.close();
 
     threadFinished = true;
 
@@ -464,7 +502,7 @@ void mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     threadFinished = false;
 
     // Allocate the dataCache memory
-    dataCache = new map<string, deque<double>*>();
+    dataCache = new map<string, SpineMLDataQueue*>();
     pthread_mutex_init (&dataCacheMutex, NULL);
 
     // init the mutex for our output debugging.
@@ -14,7 +14,7 @@ typedef unsigned short char16_t;
 
 #include <iostream>
 #include <map>
-#include <deque>
+#include "SpineMLDataQueue.h"
 
 extern "C" {
 #include <pthread.h>
@@ -55,7 +55,7 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     val = context(1);
     volatile bool *stopRequested = (volatile bool*) val;
     val = context(4);
-    map<string, deque<double>*>* dCache = (map <string, deque<double>*>*) val;
+    map<string, SpineMLDataQueue*>* dCache = (map<string, SpineMLDataQueue*>*) val;
     val = context(5);
     pthread_mutex_t* dCacheMutex = (pthread_mutex_t*) val;
     val = context(6);
@@ -64,7 +64,7 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     unsigned long long int* context = (unsigned long long int*)mxGetData(prhs[0]);
     pthread_t *thread = ((pthread_t*) context[0]);
     volatile bool *stopRequested = ((volatile bool*) context[1]);
-    map<string, deque<double>*>* dCache = (map <string, deque<double>*>*) context[4];
+    map<string, SpineMLDataQueue*>* dCache = (map<string, SpineMLDataQueue*>*) context[4];
     pthread_mutex_t* dCacheMutex = (pthread_mutex_t*)context[5];
     coutMutex = (pthread_mutex_t*)context[6];
 #endif
@@ -85,6 +85,11 @@ mexFunction (int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
     // free the dataCache memory (allocated in spinemlnetStart.cpp)
     cout << "SpineMLNet: stop-" << __FUNCTION__<< ": deallocate dataCache memory" << endl;
+    map<string, SpineMLDataQueue*>::iterator entry = dCache->begin();
+    while (entry != dCache->end()) {
+        delete entry->second;
+        ++entry;
+    }
     delete dCache;
     // And the mutex:
     pthread_mutex_destroy(dCacheMutex);
@@ -46,6 +46,26 @@ SOURCES += main.cpp \
     SC_export_network_image.cpp \
     NL_genericinput.cpp \
     SC_python_connection_generate_dialog.cpp \
+    SC_headless.cpp \
+    SC_hdf5store.cpp \
+    SC_animationscheduler.cpp \
+    SC_profiler.cpp \
+    SC_residency.cpp \
+    SC_modelvalidator.cpp \
+    SC_clipboard.cpp \
+    NL_kernelconnectivity.cpp \
+    SC_modelsnapshot.cpp \
+    SC_autosave.cpp \
+    SC_runcache.cpp \
+    SC_executionbackend.cpp \
+    SC_liveactivity.cpp \
+    SC_networkgraphwriter.cpp \
+    SC_indexset.cpp \
+    SC_ioservice.cpp \
+    SC_counterrandom.cpp \
+    SC_batchexperimentrunner.cpp \
+    SC_batchexperimentwindow.cpp \
+    SC_outputcapture.cpp \
     SC_logged_data.cpp \
     SC_component_scene.cpp \
     SC_component_view.cpp \
@@ -62,7 +82,9 @@ SOURCES += main.cpp \
     SC_viewVZlayoutedithandler.cpp \
     SC_layout_cinterpreter.cpp \
     SC_network_2d_visualiser_panel.cpp \
-    SC_network_3d_visualiser_panel.cpp
+    SC_network_2d_sceneindex.cpp \
+    SC_network_3d_visualiser_panel.cpp \
+    SC_network_3d_renderer.cpp
 
 HEADERS += mainwindow.h \
     globalHeader.h \
@@ -95,6 +117,26 @@ HEADERS += mainwindow.h \
     SC_export_network_image.h \
     NL_genericinput.h \
     SC_python_connection_generate_dialog.h \
+    SC_headless.h \
+    SC_hdf5store.h \
+    SC_animationscheduler.h \
+    SC_profiler.h \
+    SC_residency.h \
+    SC_modelvalidator.h \
+    SC_clipboard.h \
+    NL_kernelconnectivity.h \
+    SC_modelsnapshot.h \
+    SC_autosave.h \
+    SC_runcache.h \
+    SC_executionbackend.h \
+    SC_liveactivity.h \
+    SC_networkgraphwriter.h \
+    SC_indexset.h \
+    SC_ioservice.h \
+    SC_counterrandom.h \
+    SC_batchexperimentrunner.h \
+    SC_batchexperimentwindow.h \
+    SC_outputcapture.h \
     SC_logged_data.h \
     SC_component_scene.h \
     SC_component_view.h \
@@ -111,7 +153,9 @@ HEADERS += mainwindow.h \
     SC_viewVZlayoutedithandler.h \
     SC_layout_cinterpreter.h \
     SC_network_2d_visualiser_panel.h \
-    SC_network_3d_visualiser_panel.h
+    SC_network_2d_sceneindex.h \
+    SC_network_3d_visualiser_panel.h \
+    SC_network_3d_renderer.h
 
 FORMS += mainwindow.ui \
     valuelistdialog.ui \
@@ -121,7 +165,8 @@ FORMS += mainwindow.ui \
     aboutdialog.ui \
     settings_window.ui \
     export_component_image.ui \
-    export_network_image.ui
+    export_network_image.ui \
+    batchexperimentwindow.ui
 
 RESOURCES += icons.qrc
 
@@ -197,6 +242,14 @@ linux {
     INSTALLS += documentation icons desktop
 }
 
+# Live activity in the 3D view (see SC_liveactivity.h) is received with the event driven
+# SpineML network server, whose protocol header needs the POSIX shared memory headers.
+unix {
+    DEFINES += USE_LIVE_ACTIVITY
+    SOURCES += networkserver/cpp/spinemlasyncserver.cpp
+    HEADERS += networkserver/cpp/spinemlasyncserver.h
+}
+
 # Use of the cgraph API from graphviz version 2.32 and above is the default. Can configure
 # to build with the deprecated libgraph API, if required (for Debian 7 and older Linux
 # distros). To do this, add "CONFIG+=use_libgraph_not_libcgraph" to the "Additional
@@ -209,6 +262,22 @@ CONFIG(use_libgraph_not_libcgraph) {
     LIBS += -lgvc -lcgraph
 }
 
+# HDF5 import and export of a project's explicit data and logs (see SC_hdf5store.h) is
+# optional. To build it in, install the HDF5 C library and call qmake like this:
+# qmake "CONFIG+=use_hdf5"
+CONFIG(use_hdf5) {
+    DEFINES += USE_HDF5
+    linux {
+        # Debian and Ubuntu keep the serial build of HDF5 here
+        INCLUDEPATH += /usr/include/hdf5/serial
+        LIBS += -L/usr/lib/x86_64-linux-gnu/hdf5/serial
+    }
+    macx {
+        INCLUDEPATH += /opt/local/include
+    }
+    LIBS += -lhdf5
+}
+
 OTHER_FILES += spinecreator.pro.user
 
 target.path = /usr/bin
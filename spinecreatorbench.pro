@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# The benchmark program in bench/, built from the application sources with
+# its own main(). See bench/readme.spinecreatorbench.
+#
+#-------------------------------------------------
+
+include(spinecreator.pro)
+
+TARGET = spinecreatorbench
+
+SOURCES -= main.cpp
+SOURCES += bench/spinecreatorbench.cpp
+
+OTHER_FILES += bench/readme.spinecreatorbench
+
+# not installed
+INSTALLS =